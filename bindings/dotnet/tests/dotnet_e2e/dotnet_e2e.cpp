@@ -129,6 +129,9 @@ TEST_FUNCTION(GW_dotnet_binding_e2e_Managed2Managed)
 	managedModuleSender.module_name = "Sender";
 	managedModuleSender.module_path = "..\\..\\..\\Debug\\dotnet_hl.dll";
 	managedModuleSender.module_configuration = "{\"dotnet_module_path\":\"E2ETestModule\",\"dotnet_module_entry_class\":\"E2ETestModule.DotNetE2ETestModule\",\"dotnet_module_args\":\"Sender\"}";
+	managedModuleSender.module_options = NULL;
+	managedModuleSender.instances = 1;
+	managedModuleSender.partition_key = NULL;
 	e2eGatewayInstance = Gateway_LL_Create(NULL);
 
 	MODULE_HANDLE managedModuleSenderHandle = Gateway_LL_AddModule(e2eGatewayInstance, &managedModuleSender);
@@ -139,6 +142,9 @@ TEST_FUNCTION(GW_dotnet_binding_e2e_Managed2Managed)
 	managedModuleReceiver.module_name = "Receiver";
 	managedModuleReceiver.module_path = "..\\..\\..\\Debug\\dotnet_hl.dll";
 	managedModuleReceiver.module_configuration = "{\"dotnet_module_path\":\"E2ETestModule\",\"dotnet_module_entry_class\":\"E2ETestModule.DotNetE2ETestModule\",\"dotnet_module_args\":\"Receiver\"}";
+	managedModuleReceiver.module_options = NULL;
+	managedModuleReceiver.instances = 1;
+	managedModuleReceiver.partition_key = NULL;
 
 	MODULE_HANDLE managedModuleReceiverHandle = Gateway_LL_AddModule(e2eGatewayInstance, &managedModuleReceiver);
 
@@ -160,6 +166,7 @@ TEST_FUNCTION(GW_dotnet_binding_e2e_Managed2Managed)
 	BROKER_LINK_DATA fromSenderToTestProbe;
 	fromSenderToTestProbe.module_source_handle = managedModuleSenderHandle;
 	fromSenderToTestProbe.module_sink_handle = myProbeTestModule.module_handle;
+	fromSenderToTestProbe.filter = NULL;
 
 	myBrokerResult = Broker_AddLink(gatewayHandleData->broker, &fromSenderToTestProbe);
 	ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, myBrokerResult);
@@ -167,6 +174,7 @@ TEST_FUNCTION(GW_dotnet_binding_e2e_Managed2Managed)
 	BROKER_LINK_DATA fromSenderToReceiver;
 	fromSenderToReceiver.module_source_handle = managedModuleSenderHandle;
 	fromSenderToReceiver.module_sink_handle = managedModuleReceiverHandle;
+	fromSenderToReceiver.filter = NULL;
 
 	myBrokerResult = Broker_AddLink(gatewayHandleData->broker, &fromSenderToReceiver);
 	ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, myBrokerResult);
@@ -174,6 +182,7 @@ TEST_FUNCTION(GW_dotnet_binding_e2e_Managed2Managed)
 	BROKER_LINK_DATA fromReceiverToTestProbe;
 	fromReceiverToTestProbe.module_source_handle = managedModuleReceiverHandle;
 	fromReceiverToTestProbe.module_sink_handle = myProbeTestModule.module_handle;
+	fromReceiverToTestProbe.filter = NULL;
 
 	myBrokerResult = Broker_AddLink(gatewayHandleData->broker, &fromReceiverToTestProbe);
 	ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, myBrokerResult);
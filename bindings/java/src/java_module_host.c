@@ -339,7 +339,9 @@ static void JavaModuleHost_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
 		JAVA_MODULE_HANDLE_DATA* moduleHandle = (JAVA_MODULE_HANDLE_DATA*)module;
 
 		/*Codes_SRS_JAVA_MODULE_HOST_14_023: [This function shall serialize message.]*/
-		int32_t size = Message_ToByteArray(message, NULL, 0);
+		/*the content is copied straight from the message into the jbyteArray instead of going through an intermediate buffer*/
+		MESSAGE_IOVEC segments[MESSAGE_IOVEC_COUNT];
+		int32_t size = Message_ToIoVec(message, segments);
 
 		if (size < 0)
 		{
@@ -348,69 +350,69 @@ static void JavaModuleHost_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
 		}
 		else
 		{
-			unsigned char* serialized_message = (unsigned char*)malloc(size);
-			if (serialized_message == NULL)
-			{
-				LogError("Could not allocate byte array for message.");
-			}
-			else
-			{
-				Message_ToByteArray(message, serialized_message, size);
-
-				/*Codes_SRS_JAVA_MODULE_HOST_14_042: [This function shall attach the JVM to the current thread.]*/
-				jint jni_result = JNIFunc(moduleHandle->jvm, AttachCurrentThread, (void**)(&(moduleHandle->env)), NULL);
+			/*Codes_SRS_JAVA_MODULE_HOST_14_042: [This function shall attach the JVM to the current thread.]*/
+			jint jni_result = JNIFunc(moduleHandle->jvm, AttachCurrentThread, (void**)(&(moduleHandle->env)), NULL);
 
-				if (jni_result == JNI_OK)
+			if (jni_result == JNI_OK)
+			{
+				/*Codes_SRS_JAVA_MODULE_HOST_14_043: [This function shall create a new jbyteArray for the serialized message.]*/
+				jbyteArray arr = JNIFunc(moduleHandle->env, NewByteArray, size);
+				if (arr == NULL)
+				{
+					/*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
+					LogError("New jbyteArray could not be constructed.");
+				}
+				else
 				{
-					/*Codes_SRS_JAVA_MODULE_HOST_14_043: [This function shall create a new jbyteArray for the serialized message.]*/
-					jbyteArray arr = JNIFunc(moduleHandle->env, NewByteArray, size);
-					if (arr == NULL)
+					/*Codes_SRS_JAVA_MODULE_HOST_14_044: [This function shall set the contents of the jbyteArray to the serialized message, one segment at a time.]*/
+					jthrowable exception = NULL;
+					jsize offset = 0;
+					size_t i;
+					for (i = 0; (i < MESSAGE_IOVEC_COUNT) && (exception == NULL); i++)
+					{
+						if (segments[i].size > 0)
+						{
+							JNIFunc(moduleHandle->env, SetByteArrayRegion, arr, offset, (jsize)segments[i].size, (const jbyte*)segments[i].buffer);
+							exception = JNIFunc(moduleHandle->env, ExceptionOccurred);
+							offset += (jsize)segments[i].size;
+						}
+					}
+					if (exception)
 					{
 						/*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-						LogError("New jbyteArray could not be constructed.");
+						LogError("Exception occurred in SetByteArrayRegion.");
+						JNIFunc(moduleHandle->env, ExceptionDescribe);
+						JNIFunc(moduleHandle->env, ExceptionClear);
 					}
 					else
 					{
-						/*Codes_SRS_JAVA_MODULE_HOST_14_044: [This function shall set the contents of the jbyteArray to the serialized_message.]*/
-						JNIFunc(moduleHandle->env, SetByteArrayRegion, arr, 0, size, serialized_message);
-						jthrowable exception = JNIFunc(moduleHandle->env, ExceptionOccurred);
-						if (exception)
+						/*Codes_SRS_JAVA_MODULE_HOST_14_045: [This function shall get the user - defined Java module class using the module parameter and get the receive() method.]*/
+						jmethodID jModule_receive = get_module_method(moduleHandle, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_DESCRIPTOR);
+						if (jModule_receive == NULL)
 						{
 							/*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-							LogError("Exception occurred in SetByteArrayRegion.");
-							JNIFunc(moduleHandle->env, ExceptionDescribe);
-							JNIFunc(moduleHandle->env, ExceptionClear);
+							LogError("Failed to get the %s receive() method.", moduleHandle->moduleName);
 						}
 						else
 						{
-							/*Codes_SRS_JAVA_MODULE_HOST_14_045: [This function shall get the user - defined Java module class using the module parameter and get the receive() method.]*/
-							jmethodID jModule_receive = get_module_method(moduleHandle, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_DESCRIPTOR);
-							if (jModule_receive == NULL)
+							/*Codes_SRS_JAVA_MODULE_HOST_14_024: [This function shall call the void receive(byte[] source) method of the Java module object passing the serialized message.]*/
+							CallVoidMethodInternal(moduleHandle->env, moduleHandle->module, jModule_receive, 1, arr);
+							exception = JNIFunc(moduleHandle->env, ExceptionOccurred);
+							if (exception)
 							{
 								/*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-								LogError("Failed to get the %s receive() method.", moduleHandle->moduleName);
-							}
-							else
-							{
-								/*Codes_SRS_JAVA_MODULE_HOST_14_024: [This function shall call the void receive(byte[] source) method of the Java module object passing the serialized message.]*/
-								CallVoidMethodInternal(moduleHandle->env, moduleHandle->module, jModule_receive, 1, arr);
-								exception = JNIFunc(moduleHandle->env, ExceptionOccurred);
-								if (exception)
-								{
-									/*Codes_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-									LogError("Exception occurred in receive() of %s.", moduleHandle->moduleName);
-									JNIFunc(moduleHandle->env, ExceptionDescribe);
-									JNIFunc(moduleHandle->env, ExceptionClear);
-								}
+								LogError("Exception occurred in receive() of %s.", moduleHandle->moduleName);
+								JNIFunc(moduleHandle->env, ExceptionDescribe);
+								JNIFunc(moduleHandle->env, ExceptionClear);
 							}
 						}
-						JNIFunc(moduleHandle->env, DeleteLocalRef, arr);
 					}
-					/*Codes_SRS_JAVA_MODULE_HOST_14_046: [This function shall detach the JVM from the current thread.]*/
-					JNIFunc(moduleHandle->jvm, DetachCurrentThread);
+					JNIFunc(moduleHandle->env, DeleteLocalRef, arr);
 				}
-				free(serialized_message);
+				/*Codes_SRS_JAVA_MODULE_HOST_14_046: [This function shall detach the JVM from the current thread.]*/
+				JNIFunc(moduleHandle->jvm, DetachCurrentThread);
 			}
+			Message_FreeIoVec(segments);
 		}
 	}
 
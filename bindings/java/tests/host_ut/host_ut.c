@@ -99,11 +99,25 @@ MESSAGE_HANDLE my_Message_CreateFromByteArray(const unsigned char* source, int32
 {
 	return (MESSAGE_HANDLE)malloc(1);
 }
-MOCKABLE_FUNCTION(, int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char*, buf, int32_t, size);
-int32_t my_MessageToByteArray(MESSAGE_HANDLE messageHandle, unsigned char* buf, int32_t size)
+static const unsigned char serialized_message[] =
 {
-	return 1;
-}
+	0xA1, 0x60,             /*header*/
+	0x00, 0x00, 0x00, 14,   /*size of this array*/
+	0x00, 0x00, 0x00, 0x00, /*zero properties*/
+	0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+};
+MOCKABLE_FUNCTION(, int32_t, Message_ToIoVec, MESSAGE_HANDLE, messageHandle, MESSAGE_IOVEC*, segments);
+static const unsigned char* serialized_content;
+static size_t serialized_content_size;
+int32_t my_Message_ToIoVec(MESSAGE_HANDLE messageHandle, MESSAGE_IOVEC* segments)
+{
+	segments[0].buffer = serialized_message;
+	segments[0].size = sizeof(serialized_message);
+	segments[1].buffer = serialized_content;
+	segments[1].size = serialized_content_size;
+	return (int32_t)(sizeof(serialized_message) + serialized_content_size);
+}
+MOCKABLE_FUNCTION(, void, Message_FreeIoVec, MESSAGE_IOVEC*, segments);
 MOCKABLE_FUNCTION(, void, Message_Destroy, MESSAGE_HANDLE, message);
 void my_Message_Destroy(MESSAGE_HANDLE message)
 {
@@ -506,7 +520,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 
 	//Message Hooks
 	REGISTER_GLOBAL_MOCK_HOOK(Message_CreateFromByteArray, my_Message_CreateFromByteArray);
-	REGISTER_GLOBAL_MOCK_HOOK(Message_ToByteArray, my_MessageToByteArray);
+	REGISTER_GLOBAL_MOCK_HOOK(Message_ToIoVec, my_Message_ToIoVec);
 	REGISTER_GLOBAL_MOCK_HOOK(Message_Destroy, my_Message_Destroy);
 
 	//JavaModuleHostManager Hooks
@@ -523,6 +537,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_UMOCK_ALIAS_TYPE(MODULE_HANDLE, void*);
 
 	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_IOVEC*, void*);
 
 	REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
 
@@ -1420,7 +1435,7 @@ TEST_FUNCTION(JavaModuleHost_Create_gets_previously_created_JVM_success)
 /*Tests_SRS_JAVA_MODULE_HOST_14_023: [This function shall serialize message.]*/
 /*Tests_SRS_JAVA_MODULE_HOST_14_042: [This function shall attach the JVM to the current thread.]*/
 /*Tests_SRS_JAVA_MODULE_HOST_14_043: [This function shall create a new jbyteArray for the serialized message.]*/
-/*Tests_SRS_JAVA_MODULE_HOST_14_044: [This function shall set the contents of the jbyteArray to the serialized_message.]*/
+/*Tests_SRS_JAVA_MODULE_HOST_14_044: [This function shall set the contents of the jbyteArray to the serialized message, one segment at a time.]*/
 /*Tests_SRS_JAVA_MODULE_HOST_14_045: [This function shall get the user - defined Java module class using the module parameter and get the receive() method.]*/
 /*Tests_SRS_JAVA_MODULE_HOST_14_024: [This function shall call the void receive(byte[] source) method of the Java module object passing the serialized message.]*/
 /*Tests_SRS_JAVA_MODULE_HOST_14_046: [This function shall detach the JVM from the current thread.]*/
@@ -1439,12 +1454,8 @@ TEST_FUNCTION(JavaModuleHost_Receive_success)
 	MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
 	umock_c_reset_all_calls();
 
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL,0));
-	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-		.IgnoreArgument(2)
-		.IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(Message_ToIoVec(message, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
 
 	STRICT_EXPECTED_CALL(AttachCurrentThread(IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL))
 		.IgnoreArgument(1)
@@ -1487,7 +1498,7 @@ TEST_FUNCTION(JavaModuleHost_Receive_success)
 	STRICT_EXPECTED_CALL(DetachCurrentThread(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
-	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Message_FreeIoVec(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
 	//Act
@@ -1501,10 +1512,11 @@ TEST_FUNCTION(JavaModuleHost_Receive_success)
 	JavaModuleHost_Destroy(module);
 }
 
-/*Tests_SRS_JAVA_MODULE_HOST_14_022: [ This function shall do nothing if module or message is NULL. ]*/
-TEST_FUNCTION(JavaModuleHost_Receive_module_NULL_failure)
+/*Tests_SRS_JAVA_MODULE_HOST_14_044: [This function shall set the contents of the jbyteArray to the serialized message, one segment at a time.]*/
+TEST_FUNCTION(JavaModuleHost_Receive_copies_every_segment_success)
 {
 	//Arrange
+	const unsigned char content[] = { 'a', 'b', 'c' };
 	const unsigned char msg[] =
 	{
 		0xA1, 0x60,             /*header*/
@@ -1513,38 +1525,55 @@ TEST_FUNCTION(JavaModuleHost_Receive_module_NULL_failure)
 		0x00, 0x00, 0x00, 0x00  /*zero message content size*/
 	};
 
+	MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
 	MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
+	serialized_content = content;
+	serialized_content_size = sizeof(content);
 	umock_c_reset_all_calls();
 
-	//Act
-	JavaModuleHost_Receive(NULL, message);
-
-	//Assert
-	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-	//Cleanup
-	Message_Destroy(message);
-}
+	STRICT_EXPECTED_CALL(Message_ToIoVec(message, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(NewByteArray(global_env, sizeof(serialized_message) + sizeof(content)));
+	STRICT_EXPECTED_CALL(SetByteArrayRegion(global_env, IGNORED_PTR_ARG, 0, sizeof(serialized_message), IGNORED_PTR_ARG))
+		.IgnoreArgument(2)
+		.IgnoreArgument(5);
+	STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+	STRICT_EXPECTED_CALL(SetByteArrayRegion(global_env, IGNORED_PTR_ARG, sizeof(serialized_message), sizeof(content), (const jbyte*)content))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+	STRICT_EXPECTED_CALL(GetObjectClass(global_env, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(GetMethodID(global_env, IGNORED_PTR_ARG, MODULE_RECEIVE_METHOD_NAME, MODULE_RECEIVE_DESCRIPTOR))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+	STRICT_EXPECTED_CALL(CallVoidMethodV(global_env, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(2)
+		.IgnoreArgument(3)
+		.IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(ExceptionOccurred(global_env));
+	STRICT_EXPECTED_CALL(DeleteLocalRef(global_env, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
+	STRICT_EXPECTED_CALL(Message_FreeIoVec(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
 
-/*Tests_SRS_JAVA_MODULE_HOST_14_022: [ This function shall do nothing if module or message is NULL. ]*/
-TEST_FUNCTION(JavaModuleHost_Receive_message_NULL_failure)
-{
-	//Arrange
-	MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
-	umock_c_reset_all_calls();
-	
 	//Act
-	JavaModuleHost_Receive(module, NULL);
+	JavaModuleHost_Receive(module, message);
 
 	//Assert
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	//Cleanup
+	serialized_content = NULL;
+	serialized_content_size = 0;
+	Message_Destroy(message);
 	JavaModuleHost_Destroy(module);
 }
 
-/*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-TEST_FUNCTION(JavaModuleHost_Receive_Message_ToByteArray_failure)
+/*Tests_SRS_JAVA_MODULE_HOST_14_022: [ This function shall do nothing if module or message is NULL. ]*/
+TEST_FUNCTION(JavaModuleHost_Receive_module_NULL_failure)
 {
 	//Arrange
 	const unsigned char msg[] =
@@ -1555,37 +1584,38 @@ TEST_FUNCTION(JavaModuleHost_Receive_Message_ToByteArray_failure)
 		0x00, 0x00, 0x00, 0x00  /*zero message content size*/
 	};
 
-	MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
 	MESSAGE_HANDLE message = Message_CreateFromByteArray(msg, sizeof(msg));
 	umock_c_reset_all_calls();
 
-	int result = 0;
-	result = umock_c_negative_tests_init();
-	ASSERT_ARE_EQUAL(int, 0, result);
-
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0))
-		.SetFailReturn(-1);
+	//Act
+	JavaModuleHost_Receive(NULL, message);
 
+	//Assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-	umock_c_negative_tests_snapshot();
+	//Cleanup
+	Message_Destroy(message);
+}
 
+/*Tests_SRS_JAVA_MODULE_HOST_14_022: [ This function shall do nothing if module or message is NULL. ]*/
+TEST_FUNCTION(JavaModuleHost_Receive_message_NULL_failure)
+{
+	//Arrange
+	MODULE_HANDLE module = JavaModuleHost_Create((BROKER_HANDLE)0x42, &config);
+	umock_c_reset_all_calls();
+	
 	//Act
-	umock_c_negative_tests_fail_call(0);
-	JavaModuleHost_Receive(module, message);
+	JavaModuleHost_Receive(module, NULL);
 
 	//Assert
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	//Cleanup
-	Message_Destroy(message);
 	JavaModuleHost_Destroy(module);
-
-	umock_c_negative_tests_deinit();
-
 }
 
 /*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
-TEST_FUNCTION(JavaModuleHost_Receive_Message_allocate_failure)
+TEST_FUNCTION(JavaModuleHost_Receive_Message_ToIoVec_failure)
 {
 	//Arrange
 	const unsigned char msg[] =
@@ -1604,15 +1634,15 @@ TEST_FUNCTION(JavaModuleHost_Receive_Message_allocate_failure)
 	result = umock_c_negative_tests_init();
 	ASSERT_ARE_EQUAL(int, 0, result);
 
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-		.IgnoreArgument(1)
-		.SetFailReturn(NULL);
+	STRICT_EXPECTED_CALL(Message_ToIoVec(message, IGNORED_PTR_ARG))
+		.IgnoreArgument(2)
+		.SetFailReturn(-1);
+
 
 	umock_c_negative_tests_snapshot();
 
 	//Act
-	umock_c_negative_tests_fail_call(1);
+	umock_c_negative_tests_fail_call(0);
 	JavaModuleHost_Receive(module, message);
 
 	//Assert
@@ -1625,6 +1655,7 @@ TEST_FUNCTION(JavaModuleHost_Receive_Message_allocate_failure)
 	umock_c_negative_tests_deinit();
 
 }
+
 /*Tests_SRS_JAVA_MODULE_HOST_14_047: [This function shall exit if any underlying function fails.]*/
 TEST_FUNCTION(JavaModuleHost_Receive_AttachCurrentThread_failure)
 {
@@ -1645,21 +1676,17 @@ TEST_FUNCTION(JavaModuleHost_Receive_AttachCurrentThread_failure)
 	result = umock_c_negative_tests_init();
 	ASSERT_ARE_EQUAL(int, 0, result);
 
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-		.IgnoreArgument(2)
-		.IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(Message_ToIoVec(message, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
 		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Message_FreeIoVec(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
 	umock_c_negative_tests_snapshot();
 
 	//Act
-	umock_c_negative_tests_fail_call(3);
+	umock_c_negative_tests_fail_call(1);
 	JavaModuleHost_Receive(module, message);
 
 	//Assert
@@ -1692,12 +1719,8 @@ TEST_FUNCTION(JavaModuleHost_Receive_NewByteArray_failure)
 	result = umock_c_negative_tests_init();
 	ASSERT_ARE_EQUAL(int, 0, result);
 
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-		.IgnoreArgument(2)
-		.IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(Message_ToIoVec(message, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
@@ -1705,13 +1728,13 @@ TEST_FUNCTION(JavaModuleHost_Receive_NewByteArray_failure)
 
 	STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
 
-	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Message_FreeIoVec(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
 	umock_c_negative_tests_snapshot();
 
 	//Act
-	umock_c_negative_tests_fail_call(4);
+	umock_c_negative_tests_fail_call(2);
 	JavaModuleHost_Receive(module, message);
 
 	//Assert
@@ -1744,12 +1767,8 @@ TEST_FUNCTION(JavaModuleHost_Receive_SetByteArrayRegion_failure)
 	result = umock_c_negative_tests_init();
 	ASSERT_ARE_EQUAL(int, 0, result);
 
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-		.IgnoreArgument(2)
-		.IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(Message_ToIoVec(message, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
@@ -1765,13 +1784,13 @@ TEST_FUNCTION(JavaModuleHost_Receive_SetByteArrayRegion_failure)
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
 
-	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Message_FreeIoVec(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
 	umock_c_negative_tests_snapshot();
 
 	//Act
-	umock_c_negative_tests_fail_call(6);
+	umock_c_negative_tests_fail_call(4);
 	JavaModuleHost_Receive(module, message);
 
 	//Assert
@@ -1804,12 +1823,8 @@ TEST_FUNCTION(JavaModuleHost_Receive_GetObjectClass_failure)
 	result = umock_c_negative_tests_init();
 	ASSERT_ARE_EQUAL(int, 0, result);
 
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-		.IgnoreArgument(2)
-		.IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(Message_ToIoVec(message, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
@@ -1825,13 +1840,13 @@ TEST_FUNCTION(JavaModuleHost_Receive_GetObjectClass_failure)
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
 
-	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Message_FreeIoVec(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
 	umock_c_negative_tests_snapshot();
 
 	//Act
-	umock_c_negative_tests_fail_call(7);
+	umock_c_negative_tests_fail_call(5);
 	JavaModuleHost_Receive(module, message);
 
 	//Assert
@@ -1864,12 +1879,8 @@ TEST_FUNCTION(JavaModuleHost_Receive_GetMethodID_failure)
 	result = umock_c_negative_tests_init();
 	ASSERT_ARE_EQUAL(int, 0, result);
 
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-		.IgnoreArgument(2)
-		.IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(Message_ToIoVec(message, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
@@ -1890,13 +1901,13 @@ TEST_FUNCTION(JavaModuleHost_Receive_GetMethodID_failure)
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
 
-	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Message_FreeIoVec(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
 	umock_c_negative_tests_snapshot();
 
 	//Act
-	umock_c_negative_tests_fail_call(8);
+	umock_c_negative_tests_fail_call(6);
 	JavaModuleHost_Receive(module, message);
 
 	//Assert
@@ -1929,12 +1940,8 @@ TEST_FUNCTION(JavaModuleHost_Receive_CallVoidMethod_failure)
 	result = umock_c_negative_tests_init();
 	ASSERT_ARE_EQUAL(int, 0, result);
 
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, NULL, 0));
-	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(message, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-		.IgnoreArgument(2)
-		.IgnoreArgument(3);
+	STRICT_EXPECTED_CALL(Message_ToIoVec(message, IGNORED_PTR_ARG))
+		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(AttachCurrentThread(global_vm, IGNORED_PTR_ARG, NULL))
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(NewByteArray(global_env, IGNORED_NUM_ARG))
@@ -1960,13 +1967,13 @@ TEST_FUNCTION(JavaModuleHost_Receive_CallVoidMethod_failure)
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(DetachCurrentThread(global_vm));
 
-	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(Message_FreeIoVec(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
 	umock_c_negative_tests_snapshot();
 
 	//Act
-	umock_c_negative_tests_fail_call(11);
+	umock_c_negative_tests_fail_call(9);
 	JavaModuleHost_Receive(module, message);
 
 	//Assert
@@ -1070,6 +1070,16 @@ static void on_run_receive_message(
     Message_Destroy(message);
 }
 
+static void post_receive_message(MODULE_HANDLE module, MESSAGE_HANDLE message)
+{
+    // run on node's event thread; on_run_receive_message destroys the message
+    nodejs_module::NodeJSIdle::Get()->AddCallback([module, message]() {
+        nodejs_module::NodeJSUtils::RunWithNodeContext([module, message](v8::Isolate* isolate, v8::Local<v8::Context> context) {
+            on_run_receive_message(isolate, context, module, message);
+        });
+    });
+}
+
 void NODEJS_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
 {
     /*Codes_SRS_NODEJS_13_020: [ NodeJS_Receive shall do nothing if module is NULL. ]*/
@@ -1090,12 +1100,37 @@ void NODEJS_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
             // inc ref the message handle
             message = Message_Clone(message);
 
-            // run on node's event thread
-            nodejs_module::NodeJSIdle::Get()->AddCallback([module, message]() {
-                nodejs_module::NodeJSUtils::RunWithNodeContext([module, message](v8::Isolate* isolate, v8::Local<v8::Context> context) {
-                    on_run_receive_message(isolate, context, module, message);
-                });
-            });
+            /*Codes_SRS_NODEJS_13_038: [ NodeJS_Receive shall schedule a callback to be invoked on Node JS's event loop. ]*/
+            post_receive_message(module, message);
+        }
+    }
+}
+
+void NODEJS_ReceiveOwned(MODULE_HANDLE module, MESSAGE_HANDLE message)
+{
+    if (message == nullptr)
+    {
+        /*Codes_SRS_NODEJS_13_041: [ NodeJS_ReceiveOwned shall do nothing if message is NULL. ]*/
+        LogError("message handle is nullptr");
+    }
+    else if (module == nullptr)
+    {
+        /*Codes_SRS_NODEJS_13_042: [ NodeJS_ReceiveOwned shall destroy message if module is NULL or has not been initialized. ]*/
+        LogError("module handle is nullptr");
+        Message_Destroy(message);
+    }
+    else
+    {
+        NODEJS_MODULE_HANDLE_DATA* handle_data = reinterpret_cast<NODEJS_MODULE_HANDLE_DATA*>(module);
+        if (handle_data->GetModuleState() != NodeModuleState::initialized)
+        {
+            LogError("Module has not been initialized correctly: %s", handle_data->main_path.c_str());
+            Message_Destroy(message);
+        }
+        else
+        {
+            /*Codes_SRS_NODEJS_13_043: [ NodeJS_ReceiveOwned shall schedule the same callback as NodeJS_Receive without cloning message and the callback shall destroy message once GatewayModule.receive returns. ]*/
+            post_receive_message(module, message);
         }
     }
 }
@@ -1282,7 +1317,9 @@ static const MODULE_APIS NODEJS_APIS_all =
     NODEJS_Create,
     NODEJS_Destroy,
     NODEJS_Receive, 
-	NODEJS_Start
+	NODEJS_Start,
+    NULL,
+    NODEJS_ReceiveOwned
 };
 
 #ifdef BUILD_MODULE_TYPE_STATIC
@@ -119,6 +119,14 @@ static void NODEJS_HL_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE message
 	apis.Module_Receive(moduleHandle, messageHandle);
 }
 
+static void NODEJS_HL_ReceiveOwned(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    /*Codes_SRS_NODEJS_HL_13_015: [ NODEJS_HL_ReceiveOwned shall pass the received parameters to the underlying module's _ReceiveOwned function. ]*/
+	MODULE_APIS apis;
+	MODULE_STATIC_GETAPIS(NODEJS_MODULE)(&apis);
+	apis.Module_ReceiveOwned(moduleHandle, messageHandle);
+}
+
 /*
  *	Required for all modules:  the public API and the designated implementation functions.
  */
@@ -127,7 +135,9 @@ static const MODULE_APIS NODEJS_HL_APIS_all =
     NODEJS_HL_Create,
     NODEJS_HL_Destroy,
     NODEJS_HL_Receive,
-    NODEJS_HL_Start
+    NODEJS_HL_Start,
+    NULL,
+    NODEJS_HL_ReceiveOwned
 };
 
 #ifdef BUILD_MODULE_TYPE_STATIC
@@ -242,13 +242,16 @@ void NODEJS_Destroy(MODULE_HANDLE moduleHandle);
 /*this is the module's callback function - gets called when a message is to be received by the module*/
 void NODEJS_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle);
 void NODEJS_Start(MODULE_HANDLE moduleHandle);
+void NODEJS_ReceiveOwned(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle);
 
 static MODULE_APIS NODEJS_APIS =
 {
     NODEJS_Create,
     NODEJS_Destroy,
     NODEJS_Receive,
-	NODEJS_Start
+	NODEJS_Start,
+    NULL,
+    NODEJS_ReceiveOwned
 };
 
 TYPED_MOCK_CLASS(CNODEJSHLMocks, CGlobalMock)
@@ -355,6 +358,9 @@ public:
     
     MOCK_STATIC_METHOD_2(, void, NODEJS_Receive, MODULE_HANDLE, moduleHandle, MESSAGE_HANDLE, messageHandle)
     MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, void, NODEJS_ReceiveOwned, MODULE_HANDLE, moduleHandle, MESSAGE_HANDLE, messageHandle)
+    MOCK_VOID_METHOD_END()
 };
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CNODEJSHLMocks, , JSON_Value*, json_parse_file, const char *, filename);
@@ -378,6 +384,7 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CNODEJSHLMocks, , MODULE_HANDLE, NODEJS_Create, BRO
 DECLARE_GLOBAL_MOCK_METHOD_1(CNODEJSHLMocks, , void, NODEJS_Destroy, MODULE_HANDLE, moduleHandle);
 DECLARE_GLOBAL_MOCK_METHOD_2(CNODEJSHLMocks, , void, NODEJS_Receive, MODULE_HANDLE, moduleHandle, MESSAGE_HANDLE, messageHandle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CNODEJSHLMocks, , void, NODEJS_Start, MODULE_HANDLE, moduleHandle);
+DECLARE_GLOBAL_MOCK_METHOD_2(CNODEJSHLMocks, , void, NODEJS_ReceiveOwned, MODULE_HANDLE, moduleHandle, MESSAGE_HANDLE, messageHandle);
 
 MODULE_HANDLE (*NODEJS_HL_Create)(BROKER_HANDLE broker, const void* configuration);
 /*this destroys (frees resources) of the module parameter*/
@@ -385,6 +392,7 @@ void (*NODEJS_HL_Destroy)(MODULE_HANDLE moduleHandle);
 /*this is the module's callback function - gets called when a message is to be received by the module*/
 void (*NODEJS_HL_Receive)(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle);
 void(*NODEJS_HL_Start)(MODULE_HANDLE moduleHandle);
+void (*NODEJS_HL_ReceiveOwned)(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle);
 
 static BROKER_HANDLE validBrokerHandle = (BROKER_HANDLE)0x1;
 static MESSAGE_HANDLE VALID_MESSAGE_HANDLE  = (MESSAGE_HANDLE)0x02;
@@ -411,6 +419,7 @@ BEGIN_TEST_SUITE(nodejs_hl_ut)
         NODEJS_HL_Destroy = apis.Module_Destroy;
 		NODEJS_HL_Receive = apis.Module_Receive;
 		NODEJS_HL_Start = apis.Module_Start;
+        NODEJS_HL_ReceiveOwned = apis.Module_ReceiveOwned;
     }
 
     TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -659,6 +668,27 @@ BEGIN_TEST_SUITE(nodejs_hl_ut)
         NODEJS_HL_Destroy(handle);
     }
 
+    /*Tests_SRS_NODEJS_HL_13_015: [ NODEJS_HL_ReceiveOwned shall pass the received parameters to the underlying module's _ReceiveOwned function. ]*/
+    TEST_FUNCTION(NODEJS_HL_ReceiveOwned_passthrough_succeeds)
+    {
+        ///arrage
+        CNODEJSHLMocks mocks;
+        MODULE_HANDLE handle = NODEJS_HL_Create(validBrokerHandle, VALID_CONFIG_STRING);
+        mocks.ResetAllCalls();
+
+        EXPECTED_CALL(mocks, MODULE_STATIC_GETAPIS(NODEJS_MODULE)(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mocks, NODEJS_ReceiveOwned(handle, VALID_MESSAGE_HANDLE));
+
+        ///act
+        NODEJS_HL_ReceiveOwned(handle, VALID_MESSAGE_HANDLE);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        NODEJS_HL_Destroy(handle);
+    }
+
     /*Tests_SRS_NODEJS_HL_13_010: [ NODEJS_HL_Destroy shall destroy all used resources. ]*/
     TEST_FUNCTION(NODEJS_HL_Destroy_passthrough_succeeds)
     {
@@ -694,6 +724,7 @@ BEGIN_TEST_SUITE(nodejs_hl_ut)
         ASSERT_IS_TRUE(apis.Module_Create != NULL);
 		ASSERT_IS_TRUE(apis.Module_Receive != NULL);
 		ASSERT_IS_TRUE(apis.Module_Start != NULL);
+        ASSERT_IS_TRUE(apis.Module_ReceiveOwned != NULL);
 
         ///cleanup
     }
@@ -23,12 +23,73 @@ typedef struct BROKER_HANDLE_DATA_TAG* BROKER_HANDLE;
 
 #ifdef __cplusplus
 #include <cstddef>
+#include <cstdint>
+#include <ctime>
 extern "C"
 {
 #else
 #include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 #endif
 
+#define BROKER_FILTER_OPERATION_VALUES \
+    BROKER_FILTER_EQUALS, \
+    BROKER_FILTER_PREFIX, \
+    BROKER_FILTER_EXISTS, \
+    BROKER_FILTER_PARTITION
+
+/** @brief	Enumeration describing the test a #BROKER_FILTER_CONDITION makes
+*			on a property of a message.
+*
+*	@details	#BROKER_FILTER_EQUALS passes when the property has the given
+*				value, #BROKER_FILTER_PREFIX when its value starts with the
+*				given value and #BROKER_FILTER_EXISTS when the message has
+*				the property, whatever its value. #BROKER_FILTER_PARTITION
+*				passes when the hash of the value of the property, an empty
+*				value for a message without it, falls in the given partition,
+*				so that all the messages with the same value take the same
+*				link.
+*/
+DEFINE_ENUM(BROKER_FILTER_OPERATION, BROKER_FILTER_OPERATION_VALUES);
+
+/** @brief	A test on one property of the messages routed by a link. */
+typedef struct BROKER_FILTER_CONDITION_TAG
+{
+    /** @brief	The test made on the property. */
+    BROKER_FILTER_OPERATION operation;
+
+    /** @brief	The name of the property. */
+    const char* name;
+
+    /** @brief	The value the property is compared with, ignored by
+    *			#BROKER_FILTER_EXISTS and #BROKER_FILTER_PARTITION.
+    */
+    const char* value;
+
+    /** @brief	The partition a #BROKER_FILTER_PARTITION condition passes,
+    *			less than @c partition_count. Ignored by the other operations.
+    */
+    size_t partition;
+
+    /** @brief	The number of partitions the values of the property are
+    *			spread over. Ignored by the other operations.
+    */
+    size_t partition_count;
+} BROKER_FILTER_CONDITION;
+
+/** @brief	The conditions a message has to pass to be routed by a link.
+*			A message is routed only if it passes all of them.
+*/
+typedef struct BROKER_LINK_FILTER_TAG
+{
+    /** @brief	Array of @c condition_count conditions. */
+    const BROKER_FILTER_CONDITION* conditions;
+
+    /** @brief	Number of elements of @c conditions, at least 1. */
+    size_t condition_count;
+} BROKER_LINK_FILTER;
+
 /** @brief	Link Data with #MODULE_HANDLE for source and sink. 
 */
 typedef struct BROKER_LINK_DATA_TAG {
@@ -38,6 +99,11 @@ typedef struct BROKER_LINK_DATA_TAG {
     /** @brief	#MODULE_HANDLE representing the module receiving messages. 
     */
     MODULE_HANDLE module_sink_handle;
+    /** @brief	The #BROKER_LINK_FILTER the messages have to pass to be
+    *			delivered to the sink, or @c NULL to deliver all of them. The
+    *			broker copies it.
+    */
+    const BROKER_LINK_FILTER* filter;
 } BROKER_LINK_DATA;
 
 #define BROKER_RESULT_VALUES \
@@ -45,19 +111,259 @@ typedef struct BROKER_LINK_DATA_TAG {
     BROKER_ERROR, \
     BROKER_ADD_LINK_ERROR, \
     BROKER_REMOVE_LINK_ERROR, \
-    BROKER_INVALIDARG
+    BROKER_INVALIDARG, \
+    BROKER_BUSY
 
 /** @brief	Enumeration describing the result of ::Broker_Publish, 
 *			::Broker_AddModule, ::Broker_AddLink, and ::Broker_RemoveModule.
+*
+*	@details	::Broker_Publish returns #BROKER_BUSY when the message was not
+*				queued for at least one module because that module's queue
+*				is full, or, with the PubSub broker, not sent at all because
+*				a lossless module has no room for it. Producers may use it
+*				to shed load.
 */
 DEFINE_ENUM(BROKER_RESULT, BROKER_RESULT_VALUES);
 
+#define BROKER_QUEUE_POLICY_VALUES \
+    BROKER_QUEUE_DROP_NEWEST, \
+    BROKER_QUEUE_DROP_OLDEST, \
+    BROKER_QUEUE_BLOCK
+
+/** @brief	Enumeration describing what the broker does with a message
+*			published to a module whose queue is full.
+*
+*	@details	#BROKER_QUEUE_DROP_NEWEST refuses the new message,
+*				#BROKER_QUEUE_DROP_OLDEST discards the oldest queued messages
+*				to make room for it and #BROKER_QUEUE_BLOCK makes the publisher
+*				wait for room for at most
+*				BROKER_QUEUE_OPTIONS::block_timeout_ms before refusing it.
+*/
+DEFINE_ENUM(BROKER_QUEUE_POLICY, BROKER_QUEUE_POLICY_VALUES);
+
+/** @brief	Bounds of the queue of messages waiting to be delivered to a
+*			module.
+*/
+typedef struct BROKER_QUEUE_OPTIONS_TAG
+{
+    /** @brief	Maximum number of queued messages, 0 for no limit. */
+    size_t max_depth;
+
+    /** @brief	Maximum number of bytes of queued message content, 0 for no
+    *			limit. A message is always accepted by an empty queue.
+    */
+    size_t max_bytes;
+
+    /** @brief	What to do with a message that does not fit in the queue. */
+    BROKER_QUEUE_POLICY policy;
+
+    /** @brief	How long a publisher waits for room with
+    *			#BROKER_QUEUE_BLOCK, must be greater than 0. Adding or
+    *			removing modules and links may wait for a publisher that
+    *			is waiting for room for as long.
+    */
+    unsigned int block_timeout_ms;
+
+    /** @brief	Maximum number of queued messages handed to a module's
+    *			Module_ReceiveBatch in one call, 0 for the broker's default.
+    *			Ignored for modules that only implement Module_Receive.
+    */
+    size_t max_batch_size;
+
+    /** @brief	Nonzero to let the broker hand the module its messages on
+    *			the thread publishing them, bypassing the queue, when the
+    *			module is only linked from one module and to at most one
+    *			module. Only the Direct broker delivers inline; it still
+    *			queues a message when the module is receiving another one.
+    *			The module's receive functions then run on the publisher's
+    *			thread, and ::Broker_Publish returns after they do. They
+    *			do not run with the module's thread options, and they
+    *			cannot add or remove modules or links of the broker: those
+    *			calls fail, since they would wait for the routing snapshot
+    *			the publisher holds. The messages delivered inline are
+    *			counted as enqueued but not held to the bounds of the
+    *			queue: the publisher hands them to the module before it
+    *			returns, so they never wait in the queue.
+    */
+    int inline_delivery;
+} BROKER_QUEUE_OPTIONS;
+
+#define BROKER_THREAD_POLICY_VALUES \
+    BROKER_THREAD_POLICY_DEFAULT, \
+    BROKER_THREAD_POLICY_FIFO, \
+    BROKER_THREAD_POLICY_ROUND_ROBIN
+
+/** @brief	Enumeration describing the scheduling class of a module's
+*			threads.
+*
+*	@details	#BROKER_THREAD_POLICY_DEFAULT keeps the class and priority
+*				the thread was created with. #BROKER_THREAD_POLICY_FIFO and
+*				#BROKER_THREAD_POLICY_ROUND_ROBIN are the POSIX real-time
+*				classes, which usually need privileges; on Windows both only
+*				set the priority of the thread.
+*/
+DEFINE_ENUM(BROKER_THREAD_POLICY, BROKER_THREAD_POLICY_VALUES);
+
+/** @brief	Size of BROKER_THREAD_OPTIONS::name, including the terminating
+*			null character. Linux does not name threads with longer names.
+*/
+#define BROKER_THREAD_NAME_SIZE 16
+
+/** @brief	Placement, scheduling and name of the threads running a
+*			module's code.
+*/
+typedef struct BROKER_THREAD_OPTIONS_TAG
+{
+    /** @brief	Processors the threads may run on, bit @c i standing for
+    *			processor @c i, 0 for any processor.
+    */
+    uint64_t cpu_affinity;
+
+    /** @brief	Scheduling class of the threads. */
+    BROKER_THREAD_POLICY policy;
+
+    /** @brief	Priority of the threads in their scheduling class, ignored
+    *			with #BROKER_THREAD_POLICY_DEFAULT.
+    */
+    int priority;
+
+    /** @brief	Name of the threads, as shown by debuggers and tools such as
+    *			@c top, an empty string keeping the name they have.
+    */
+    char name[BROKER_THREAD_NAME_SIZE];
+} BROKER_THREAD_OPTIONS;
+
+/** @brief	Options applied to a module when it is added to the broker. */
+typedef struct BROKER_MODULE_OPTIONS_TAG
+{
+    /** @brief	Bounds of the module's message queue. */
+    BROKER_QUEUE_OPTIONS queue;
+
+    /** @brief	Options of the threads running the module's code, applied
+    *			by the PubSub broker to the thread delivering the module's
+    *			messages and by the module to its own threads through
+    *			::Broker_ApplyModuleThreadOptions.
+    */
+    BROKER_THREAD_OPTIONS thread;
+} BROKER_MODULE_OPTIONS;
+
+/** @brief	Options applied to the broker when it is created. */
+typedef struct BROKER_OPTIONS_TAG
+{
+    /** @brief	Number of threads delivering messages to the modules, 0 for
+    *			one per online processor. The PubSub broker runs one thread
+    *			per module and ignores it.
+    */
+    size_t worker_count;
+} BROKER_OPTIONS;
+
+/** @brief	Number of buckets of a #BROKER_LATENCY_HISTOGRAM. */
+#define BROKER_LATENCY_BUCKET_COUNT 20
+
+/** @brief	Distribution of durations measured by the broker.
+*
+*	@details	Bucket 0 counts the durations shorter than 1 microsecond and
+*				bucket @c i, up to #BROKER_LATENCY_BUCKET_COUNT - 2, the
+*				durations of at least 2^(i-1) and less than 2^i microseconds.
+*				The last bucket counts the longer ones.
+*/
+typedef struct BROKER_LATENCY_HISTOGRAM_TAG
+{
+    /** @brief	Number of durations that fell in each bucket. */
+    uint64_t buckets[BROKER_LATENCY_BUCKET_COUNT];
+} BROKER_LATENCY_HISTOGRAM;
+
+/** @brief	Counters of the messages the broker delivered to a module since
+*			the module was added, returned by ::Broker_GetStatistics.
+*
+*	@details	The counters are read while the broker runs and the ones
+*				maintained by the module's delivery thread are not read
+*				atomically with the others, so they are a close picture
+*				rather than a consistent snapshot.
+*/
+typedef struct BROKER_MODULE_STATISTICS_TAG
+{
+    /** @brief	The module the counters belong to. */
+    MODULE_HANDLE module_handle;
+
+    /** @brief	Number of messages queued for the module, including the
+    *			messages the Direct broker delivered inline.
+    */
+    uint64_t enqueued;
+
+    /** @brief	Number of messages handed to the module. */
+    uint64_t delivered;
+
+    /** @brief	Number of messages refused by or discarded from the module's
+    *			queue because it was full, or that the module's thread
+    *			could not decode. The PubSub broker counts the messages
+    *			missing from the sequence of a source, dropped by a full
+    *			socket.
+    */
+    uint64_t dropped;
+
+    /** @brief	Number of bytes of content of the messages queued for the
+    *			module.
+    */
+    uint64_t enqueued_bytes;
+
+    /** @brief	Number of messages waiting in the module's queue. */
+    size_t queue_depth;
+
+    /** @brief	Number of bytes of content of the messages waiting in the
+    *			module's queue.
+    */
+    size_t queued_bytes;
+
+    /** @brief	Highest number of messages the module's queue has held. */
+    size_t queue_high_water_mark;
+
+    /** @brief	How long the oldest message taken from the queue at once
+    *			waited there, one sample each time the module's thread takes
+    *			the queue.
+    */
+    BROKER_LATENCY_HISTOGRAM queue_wait;
+
+    /** @brief	How long each call to the module's Module_Receive,
+    *			Module_ReceiveOwned or Module_ReceiveBatch took.
+    */
+    BROKER_LATENCY_HISTOGRAM receive_duration;
+} BROKER_MODULE_STATISTICS;
+
+/** @brief	Counters of the messages the broker routed over a link since
+*			its route was created, returned by ::Broker_GetLinkStatistics.
+*/
+typedef struct BROKER_LINK_STATISTICS_TAG
+{
+    /** @brief	Number of messages routed from the source to the sink. */
+    uint64_t messages;
+
+    /** @brief	Number of bytes of content of those messages. */
+    uint64_t bytes;
+
+    /** @brief	When the last of those messages was routed, 0 if none was. */
+    time_t last_activity;
+} BROKER_LINK_STATISTICS;
+
 /** @brief	    Creates a new message broker.
-*   
+*
 *	@return	    A valid #BROKER_HANDLE upon success, or @c NULL upon failure.
 */
 extern BROKER_HANDLE Broker_Create(void);
 
+/** @brief	    Creates a new message broker with the given options.
+*
+*	@details	::Broker_Create is equivalent to calling this function with
+*				@c NULL options, which delivers messages on one thread per
+*				online processor.
+*
+*	@param		options	The #BROKER_OPTIONS for the broker (optional, may
+*						be NULL).
+*
+*	@return	    A valid #BROKER_HANDLE upon success, or @c NULL upon failure.
+*/
+extern BROKER_HANDLE Broker_CreateWithOptions(const BROKER_OPTIONS* options);
+
 /** @brief		Increments the reference count of a message broker.
 *
 *	@details	This function will simply increment the internal reference
@@ -95,6 +401,25 @@ extern void Broker_DecRef(BROKER_HANDLE broker);
 */
 extern BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_HANDLE message);
 
+/** @brief		Publishes a batch of messages to the message broker.
+*
+*	@details	Behaves as calling ::Broker_Publish for every message of the
+*				batch, in order, except that the broker routes the whole
+*				batch under one acquisition of its lock and hands it to
+*				every receiving module at once. The caller keeps the
+*				ownership of the batch.
+*
+*	@param		broker	The #BROKER_HANDLE onto which the messages will be
+*						published.
+*	@param		source	The #MODULE_HANDLE from which the messages will be
+*						published.
+*	@param		batch	The #MESSAGE_BATCH_HANDLE holding the messages to be
+*						published.
+*
+*	@return		A #BROKER_RESULT describing the result of the function.
+*/
+extern BROKER_RESULT Broker_PublishBatch(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_BATCH_HANDLE batch);
+
 /** @brief		Adds a module to the message broker.
 *
 *	@details	For details about threading with regard to the message broker
@@ -110,6 +435,25 @@ extern BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source,
 */
 extern BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module);
 
+/** @brief		Adds a module to the message broker with the given options.
+*
+*	@details	::Broker_AddModule is equivalent to calling this function with
+*				@c NULL options, which leaves the module's queue unbounded.
+*				The PubSub broker cannot bound its queues by depth and only
+*				maps BROKER_QUEUE_OPTIONS::max_bytes to the receive buffer
+*				size of the module's socket.
+*
+*	@param		broker          The #BROKER_HANDLE onto which the module will be 
+*								added.
+*	@param		module			The #MODULE for the module that will be added 
+*								to this message broker.
+*	@param		options			The #BROKER_MODULE_OPTIONS for the module
+*								(optional, may be NULL).
+*
+*	@return		A #BROKER_RESULT describing the result of the function.
+*/
+extern BROKER_RESULT Broker_AddModuleWithOptions(BROKER_HANDLE broker, const MODULE* module, const BROKER_MODULE_OPTIONS* options);
+
 /** @brief	    Removes a module from the message broker.
 *   
 *	@param	    broker	The #BROKER_HANDLE from which the module will be removed.
@@ -124,6 +468,13 @@ extern BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* mod
 *	@details	For details about threading with regard to the message broker
 *				and modules connected to it, see
 *				<a href="https://github.com/Azure/azure-iot-gateway-sdk/blob/develop/core/devdoc/broker_hld.md">Broker High Level Design Documentation</a>.
+*				The Broadcast and Direct brokers evaluate the filter of the
+*				link before they clone or queue a message for the sink.
+*				Adding a link that already exists increments its count and
+*				fails if the filters differ. The PubSub broker routes with
+*				nanomsg subscriptions, which cannot test the properties of a
+*				message, so the thread of the sink tests them instead and
+*				drops the messages the filter rejects before delivering.
 *
 *	@param		broker          The #BROKER_HANDLE onto which the module will be
 *								added.
@@ -136,6 +487,9 @@ extern BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA
 
 /** @brief	    Removes a route from the message broker.
 *
+*	@details	The filter of @c link is ignored, a route is identified by
+*				its source and sink.
+*
 *	@param	    broker	The #BROKER_HANDLE from which the link will be removed.
 *	@param	    link	The #BROKER_LINK_DATA of the link to be removed.
 *
@@ -143,6 +497,73 @@ extern BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA
 */
 extern BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link);
 
+/** @brief		Reads the counters of the modules of the message broker.
+*
+*	@details	Fills @c statistics with the counters of at most
+*				@c *module_count modules and sets @c *module_count to the
+*				number of modules attached to the broker, so calling it
+*				with a @c *module_count of 0 tells how much room is needed.
+*				The PubSub broker queues messages inside nanomsg: it does
+*				not see the depth of a queue nor how long a message waited,
+*				and reports 0 for them. It reports the messages dropped by
+*				a full socket once the module receives a later message of
+*				the same source.
+*
+*	@param		broker			The #BROKER_HANDLE to read.
+*	@param		statistics		Array of @c *module_count
+*								#BROKER_MODULE_STATISTICS to fill (may be
+*								NULL when @c *module_count is 0).
+*	@param		module_count	Number of elements of @c statistics on
+*								entry, number of modules of the broker on
+*								return.
+*
+*	@return		#BROKER_OK, or #BROKER_INVALIDARG if a parameter is not
+*				valid, or #BROKER_ERROR upon failure.
+*/
+extern BROKER_RESULT Broker_GetStatistics(BROKER_HANDLE broker, BROKER_MODULE_STATISTICS* statistics, size_t* module_count);
+
+/** @brief		Reads the counters of a link of the message broker.
+*
+*	@details	The filter of @c link is ignored, a route is identified by
+*				its source and sink, and the counters of a route are kept
+*				while links to it remain. The direct and broadcast brokers
+*				count the messages they queue for the sink; the PubSub broker
+*				counts the messages the sink's thread receives from the
+*				source, so the messages a full socket dropped are not
+*				counted.
+*
+*	@param		broker		The #BROKER_HANDLE to read.
+*	@param		link		The #BROKER_LINK_DATA of the link to read.
+*	@param		statistics	The #BROKER_LINK_STATISTICS to fill.
+*
+*	@return		#BROKER_OK, or #BROKER_INVALIDARG if a parameter is not
+*				valid, or #BROKER_ERROR if the link does not exist or upon
+*				failure.
+*/
+extern BROKER_RESULT Broker_GetLinkStatistics(BROKER_HANDLE broker, const BROKER_LINK_DATA* link, BROKER_LINK_STATISTICS* statistics);
+
+/** @brief		Applies the thread options a module was added with to the
+*				calling thread.
+*
+*	@details	Modules call it from the threads they start in
+*				Module_Start, when the broker knows them, so that the
+*				affinity, scheduling class and name given to the module in
+*				the gateway configuration also apply to their own threads.
+*				The PubSub broker applies the options to the thread
+*				delivering the module's messages itself; the Broadcast and
+*				Direct brokers deliver the messages of all modules from a
+*				shared pool of threads and only keep the options for this
+*				function.
+*
+*	@param		broker		The #BROKER_HANDLE the module was added to.
+*	@param		module		The #MODULE_HANDLE of the module.
+*
+*	@return		#BROKER_OK, or #BROKER_INVALIDARG if a parameter is not
+*				valid, or #BROKER_ERROR if the module was not added to the
+*				broker or the options cannot be applied.
+*/
+extern BROKER_RESULT Broker_ApplyModuleThreadOptions(BROKER_HANDLE broker, MODULE_HANDLE module);
+
 /** @brief      Disposes of resources allocated by a message broker.
 *
 *	@param      broker  The #BROKER_HANDLE to be destroyed.
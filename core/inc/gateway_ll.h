@@ -50,6 +50,10 @@ typedef struct GATEWAY_LINK_ENTRY_TAG
 
 	/** @brief The name of the module which is going to receive messages. */
 	const char* module_sink;
+
+	/** @brief The (possibly @c NULL) conditions a message has to pass to be
+	*          delivered to the sink; the gateway copies it. */
+	const BROKER_LINK_FILTER* filter;
 } GATEWAY_LINK_ENTRY;
 
 /** @brief Struct representing a particular gateway. */
@@ -66,6 +70,24 @@ typedef struct GATEWAY_MODULES_ENTRY_TAG
 	
 	/** @brief The user-defined configuration object for the module */
 	const void* module_configuration;
+
+	/** @brief The (possibly @c NULL) broker options for the module, such as
+	*	the bounds of its message queue. @c NULL leaves the queue unbounded.
+	*/
+	const BROKER_MODULE_OPTIONS* module_options;
+
+	/** @brief The number of instances of the module to create, 0 meaning 1.
+	*	Links to the module spread the messages over the instances by the
+	*	value of @c partition_key, so that the messages with the same value
+	*	are received by the same instance, in order.
+	*/
+	size_t instances;
+
+	/** @brief The name of the message property whose value picks the
+	*	instance that receives a message, required when @c instances is more
+	*	than 1. The messages without the property all go to one instance.
+	*/
+	const char* partition_key;
 } GATEWAY_MODULES_ENTRY;
 
 /** @brief	Struct representing the properties that should be used when 
@@ -79,6 +101,12 @@ typedef struct GATEWAY_PROPERTIES_DATA_TAG
 
 	/** @brief Vector of #GATEWAY_LINK_ENTRY objects. */
 	VECTOR_HANDLE gateway_links;
+
+	/** @brief The (possibly @c NULL) options of the gateway's broker, such as
+	*	its number of delivery threads. @c NULL creates the broker with
+	*	::Broker_Create.
+	*/
+	const BROKER_OPTIONS* broker_options;
 } GATEWAY_PROPERTIES;
 
 /** @brief Struct representing current information about a single module */
@@ -95,6 +123,25 @@ typedef struct GATEWAY_MODULE_INFO_TAG
 	VECTOR_HANDLE module_sources;
 } GATEWAY_MODULE_INFO;
 
+/** @brief Struct representing the traffic over a single link */
+typedef struct GATEWAY_LINK_STATISTICS_TAG
+{
+	/** @brief The name of the source module, "*" for a link from every other module */
+	const char* module_source;
+
+	/** @brief The name of the sink module */
+	const char* module_sink;
+
+	/** @brief The number of messages routed over the link */
+	uint64_t messages;
+
+	/** @brief The number of bytes of content of the messages routed over the link */
+	uint64_t bytes;
+
+	/** @brief The time the last message was routed over the link, 0 if none was */
+	time_t last_activity;
+} GATEWAY_LINK_STATISTICS;
+
 /** @brief  Enum representing different gateway events that have support for callbacks. */
 typedef enum GATEWAY_EVENT_TAG
 {
@@ -218,6 +265,24 @@ extern VECTOR_HANDLE Gateway_LL_GetModuleList(GATEWAY_HANDLE gw);
 */
 extern void Gateway_LL_DestroyModuleList(VECTOR_HANDLE module_list);
 
+/** @brief		Returns a snapshot of the traffic over the links of a gateway.
+*
+*				The names in the snapshot belong to the gateway and are only
+*				valid until the modules are removed. The vector handle should be
+*				destroyed with @c Gateway_LL_DestroyLinkStatistics.
+*
+*   @param 		gw			Pointer to a #GATEWAY_HANDLE from which the link statistics should be snapshoted
+*
+*   @return					A #VECTOR_HANDLE of #GATEWAY_LINK_STATISTICS, one per link. NULL if function errored.
+*/
+extern VECTOR_HANDLE Gateway_LL_GetLinkStatistics(GATEWAY_HANDLE gw);
+
+/** @brief 		Destroys the vector returned by @c Gateway_LL_GetLinkStatistics
+*
+*   @param 		link_statistics	A vector handle as returned from @c Gateway_LL_GetLinkStatistics
+*/
+extern void Gateway_LL_DestroyLinkStatistics(VECTOR_HANDLE link_statistics);
+
 /** @brief		Adds a link to a gateway message broker.
 *
 *	@param		gw		    Pointer to a #GATEWAY_HANDLE from which link is going to be added.
@@ -0,0 +1,64 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       atomic_ops.h
+*   @brief      Header file with the atomic operations the core uses where
+*               a lock would serialize the threads of different modules.
+*
+*   @details    The operations are sequentially consistent. They map to the
+*               Interlocked functions on Windows and to the @c __atomic
+*               builtins of GCC and Clang elsewhere, the same way the
+*               @c INC_REF and @c DEC_REF macros of the shared utility
+*               library do.
+*/
+
+#ifndef ATOMIC_OPS_H
+#define ATOMIC_OPS_H
+
+#ifdef _WIN32
+#include <windows.h>
+
+/*returns the pointer stored at address*/
+#define ATOMIC_LOAD_POINTER(address) InterlockedCompareExchangePointer((PVOID volatile*)(address), NULL, NULL)
+
+/*stores value at address and returns the pointer stored there before*/
+#define ATOMIC_EXCHANGE_POINTER(address, value) InterlockedExchangePointer((PVOID volatile*)(address), (PVOID)(value))
+
+/*stores desired at address if expected is stored there, returns nonzero if it did*/
+#define ATOMIC_COMPARE_EXCHANGE_POINTER(address, expected, desired) \
+    (InterlockedCompareExchangePointer((PVOID volatile*)(address), (PVOID)(desired), (PVOID)(expected)) == (PVOID)(expected))
+
+/*the counters are long, which is the LONG of the Interlocked functions*/
+
+/*returns the counter stored at address*/
+#define ATOMIC_LOAD_COUNTER(address) InterlockedCompareExchange((LONG volatile*)(address), 0, 0)
+
+/*adds one to the counter at address and returns the new value*/
+#define ATOMIC_INCREMENT_COUNTER(address) InterlockedIncrement((LONG volatile*)(address))
+
+/*subtracts one from the counter at address and returns the new value*/
+#define ATOMIC_DECREMENT_COUNTER(address) InterlockedDecrement((LONG volatile*)(address))
+
+/*gives up the processor in a spin wait, so that a preempted thread the spin waits for can run*/
+#define ATOMIC_SPIN_YIELD() (void)SwitchToThread()
+
+#else
+#include <sched.h>
+
+#define ATOMIC_LOAD_POINTER(address) __atomic_load_n((address), __ATOMIC_SEQ_CST)
+
+#define ATOMIC_EXCHANGE_POINTER(address, value) __atomic_exchange_n((address), (value), __ATOMIC_SEQ_CST)
+
+#define ATOMIC_COMPARE_EXCHANGE_POINTER(address, expected, desired) __sync_bool_compare_and_swap((address), (expected), (desired))
+
+#define ATOMIC_LOAD_COUNTER(address) __atomic_load_n((address), __ATOMIC_SEQ_CST)
+
+#define ATOMIC_INCREMENT_COUNTER(address) __atomic_add_fetch((address), 1, __ATOMIC_SEQ_CST)
+
+#define ATOMIC_DECREMENT_COUNTER(address) __atomic_sub_fetch((address), 1, __ATOMIC_SEQ_CST)
+
+#define ATOMIC_SPIN_YIELD() (void)sched_yield()
+
+#endif
+
+#endif /*ATOMIC_OPS_H*/
@@ -0,0 +1,159 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       broker_statistics.h
+*   @brief      Header file with internal API for the counters the brokers
+*               keep for ::Broker_GetStatistics.
+*
+*   @details    A broker keeps two sets of counters for every module. The
+*               counters of its queue are updated by the publishers under the
+*               lock of the queue, which they hold anyway. The counters of
+*               its deliveries are only written by the thread delivering the
+*               module's messages, one at a time, and sit on cache lines of
+*               their own so that the publishers, who write the fields next
+*               to them, do not make that thread miss its cache.
+*/
+
+#ifndef BROKER_STATISTICS_H
+#define BROKER_STATISTICS_H
+
+#include "broker.h"
+
+#ifdef __cplusplus
+#include <cstdint>
+extern "C"
+{
+#else
+#include <stdint.h>
+#endif // __cplusplus
+
+/*size of the cache lines the delivery counters are kept apart from the other fields by*/
+#define BROKER_STATISTICS_CACHE_LINE_SIZE 64
+
+/** @brief      Counters of a module's queue, protected by the lock of the
+*               queue.
+*/
+typedef struct BROKER_QUEUE_COUNTERS_TAG
+{
+    /** @brief  Number of messages queued for the module. */
+    uint64_t    enqueued;
+
+    /** @brief  Number of messages refused by or discarded from the full
+    *           queue.
+    */
+    uint64_t    dropped;
+
+    /** @brief  Number of bytes of content of the messages queued. */
+    uint64_t    enqueued_bytes;
+
+    /** @brief  Highest number of messages the queue has held. */
+    size_t      high_water_mark;
+
+    /** @brief  Time, from ::BrokerStatistics_GetTime, the oldest message
+    *           waiting in the queue was queued at.
+    */
+    uint64_t    oldest_enqueue_time;
+} BROKER_QUEUE_COUNTERS;
+
+/** @brief      Counters of the deliveries to a module, only written by the
+*               thread delivering the module's messages.
+*/
+typedef struct BROKER_DELIVERY_COUNTERS_TAG
+{
+    unsigned char               leading_padding[BROKER_STATISTICS_CACHE_LINE_SIZE];
+
+    /** @brief  Number of messages the thread received from a queue it
+    *           cannot see the counters of, the socket of the PubSub broker.
+    */
+    uint64_t                    received;
+
+    /** @brief  Number of bytes the thread received from that queue. */
+    uint64_t                    received_bytes;
+
+    /** @brief  Number of received messages the thread could not decode
+    *           or hand to the module, and of the messages it found
+    *           missing from the sequence of a source.
+    */
+    uint64_t                    discarded;
+
+    /** @brief  Number of messages handed to the module. */
+    uint64_t                    delivered;
+
+    /** @brief  How long the oldest message of a delivery waited. */
+    BROKER_LATENCY_HISTOGRAM    queue_wait;
+
+    /** @brief  How long the module's receive functions took. */
+    BROKER_LATENCY_HISTOGRAM    receive_duration;
+
+    unsigned char               trailing_padding[BROKER_STATISTICS_CACHE_LINE_SIZE];
+} BROKER_DELIVERY_COUNTERS;
+
+/** @brief      Counters of a link, updated by the publishers under the lock
+*               of the queue of the link's sink.
+*/
+typedef struct BROKER_LINK_COUNTERS_TAG
+{
+    /** @brief  Number of messages routed over the link. */
+    uint64_t    messages;
+
+    /** @brief  Number of bytes of content of the messages routed. */
+    uint64_t    bytes;
+
+    /** @brief  Time, from ::BrokerStatistics_GetTime, the last message was
+    *           routed at, 0 if none was.
+    */
+    uint64_t    last_activity_time;
+} BROKER_LINK_COUNTERS;
+
+/** @brief      Reads a monotonic clock.
+*
+*   @return     The number of microseconds elapsed since an unspecified
+*               point in the past, that does not change while the process
+*               runs.
+*/
+extern uint64_t BrokerStatistics_GetTime(void);
+
+/** @brief      Counts a duration in the bucket of a histogram it falls in.
+*
+*   @param      histogram   The #BROKER_LATENCY_HISTOGRAM to update.
+*   @param      start       When the measured operation started, from
+*                           ::BrokerStatistics_GetTime.
+*   @param      end         When the measured operation ended, from
+*                           ::BrokerStatistics_GetTime. An @c end before
+*                           @c start counts as no time.
+*/
+extern void BrokerStatistics_RecordDuration(BROKER_LATENCY_HISTOGRAM* histogram, uint64_t start, uint64_t end);
+
+/** @brief      Copies the counters of a module to the statistics returned by
+*               ::Broker_GetStatistics.
+*
+*   @details    The queue depth and the number of queued bytes, which the
+*               counters do not hold, are set to 0.
+*
+*   @param      statistics          The #BROKER_MODULE_STATISTICS to fill.
+*   @param      module_handle       The module the counters belong to.
+*   @param      queue_counters      The #BROKER_QUEUE_COUNTERS of the module,
+*                                   or @c NULL when the broker does not see
+*                                   its queue.
+*   @param      delivery_counters   The #BROKER_DELIVERY_COUNTERS of the
+*                                   module.
+*/
+extern void BrokerStatistics_Fill(BROKER_MODULE_STATISTICS* statistics, MODULE_HANDLE module_handle, const BROKER_QUEUE_COUNTERS* queue_counters, const BROKER_DELIVERY_COUNTERS* delivery_counters);
+
+/** @brief      Copies the counters of a link to the statistics returned by
+*               ::Broker_GetLinkStatistics.
+*
+*   @details    The time of the last message, read from the monotonic clock,
+*               is converted to the calendar time by subtracting its age
+*               from the current time.
+*
+*   @param      statistics      The #BROKER_LINK_STATISTICS to fill.
+*   @param      link_counters   The #BROKER_LINK_COUNTERS of the link.
+*/
+extern void BrokerStatistics_FillLink(BROKER_LINK_STATISTICS* statistics, const BROKER_LINK_COUNTERS* link_counters);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // !BROKER_STATISTICS_H
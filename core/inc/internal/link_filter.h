@@ -0,0 +1,147 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       link_filter.h
+*   @brief      Header file with internal API for the compiled filters of the
+*               links of a broker.
+*
+*   @details    A link filter is a copy of a #BROKER_LINK_FILTER, made in one
+*               allocation together with the lengths of the values it
+*               compares properties with. The broker tests every message
+*               against the filter of a route before it clones and queues
+*               it for the sink, so a sink is never woken for a message it
+*               would discard. A filter is immutable, publishers read it
+*               without any lock.
+*
+*               The routes of a source share a #LINK_FILTER_MESSAGE per
+*               message, which remembers the properties the filters looked
+*               up and the hashes of their values, so that a message is
+*               searched and hashed once however many routes test it.
+*/
+
+#ifndef LINK_FILTER_H
+#define LINK_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "message.h"
+#include "broker.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+typedef struct LINK_FILTER_TAG* LINK_FILTER_HANDLE;
+
+/** @brief      The number of properties a #LINK_FILTER_MESSAGE remembers,
+*               the others are looked up every time a condition needs them.
+*/
+#define LINK_FILTER_MESSAGE_PROPERTY_COUNT 4
+
+/** @brief      A property a #LINK_FILTER_MESSAGE remembers. */
+typedef struct LINK_FILTER_PROPERTY_TAG
+{
+    /** @brief  The name of the property, owned by the filter that looked
+    *           it up first.
+    */
+    const char* name;
+
+    /** @brief  The value of the property, @c NULL if the message does not
+    *           have it.
+    */
+    const char* value;
+
+    /** @brief  The hash of the value, valid when @c hashed is nonzero. */
+    uint32_t    hash;
+    int         hashed;
+} LINK_FILTER_PROPERTY;
+
+/** @brief      What the filters of the routes of a source learned about a
+*               message while testing it. It lives on the stack of the
+*               publisher and is valid as long as the message and the
+*               filters that tested it are.
+*/
+typedef struct LINK_FILTER_MESSAGE_TAG
+{
+    MESSAGE_HANDLE          message;
+    size_t                  property_count;
+    LINK_FILTER_PROPERTY    properties[LINK_FILTER_MESSAGE_PROPERTY_COUNT];
+} LINK_FILTER_MESSAGE;
+
+/** @brief      Compiles a filter.
+*
+*   @param      definition  The #BROKER_LINK_FILTER to compile. Its conditions
+*                           and strings are copied.
+*
+*   @return     A valid #LINK_FILTER_HANDLE upon success, or @c NULL if
+*               @c definition is not valid or upon failure.
+*/
+extern LINK_FILTER_HANDLE LinkFilter_Create(const BROKER_LINK_FILTER* definition);
+
+/** @brief      Frees a filter.
+*
+*   @param      filter  The #LINK_FILTER_HANDLE to destroy.
+*/
+extern void LinkFilter_Destroy(LINK_FILTER_HANDLE filter);
+
+/** @brief      Returns the definition a filter was compiled from.
+*
+*   @param      filter  The #LINK_FILTER_HANDLE to read.
+*
+*   @return     The copy of the #BROKER_LINK_FILTER, valid as long as the
+*               filter is, or @c NULL if @c filter is @c NULL.
+*/
+extern const BROKER_LINK_FILTER* LinkFilter_GetDefinition(LINK_FILTER_HANDLE filter);
+
+/** @brief      Tells whether a filter was compiled from a definition equal
+*               to the given one.
+*
+*   @param      filter      The #LINK_FILTER_HANDLE to compare, @c NULL for
+*                           no filter.
+*   @param      definition  The #BROKER_LINK_FILTER to compare, @c NULL for no
+*                           filter.
+*
+*   @return     A non-zero value if both have the same conditions in the same
+*               order or are both @c NULL, 0 otherwise.
+*/
+extern int LinkFilter_IsSameAs(LINK_FILTER_HANDLE filter, const BROKER_LINK_FILTER* definition);
+
+/** @brief      Tests a message against a filter.
+*
+*   @param      filter      The #LINK_FILTER_HANDLE to test with, @c NULL
+*                           passes every message.
+*   @param      message     The #MESSAGE_HANDLE to test.
+*
+*   @return     A non-zero value if the message passes all the conditions of
+*               the filter, 0 otherwise.
+*/
+extern int LinkFilter_Matches(LINK_FILTER_HANDLE filter, MESSAGE_HANDLE message);
+
+/** @brief      Prepares a message to be tested by the filters of several
+*               routes with ::LinkFilter_MatchesMessage.
+*
+*   @param      filter_message  The #LINK_FILTER_MESSAGE to initialize.
+*   @param      message         The #MESSAGE_HANDLE it is about.
+*/
+extern void LinkFilter_InitMessage(LINK_FILTER_MESSAGE* filter_message, MESSAGE_HANDLE message);
+
+/** @brief      Tests a message against a filter, reusing the properties and
+*               the hashes the filters that tested it before looked up.
+*
+*   @param      filter          The #LINK_FILTER_HANDLE to test with, @c NULL
+*                               passes every message.
+*   @param      filter_message  The #LINK_FILTER_MESSAGE of the message,
+*                               initialized by ::LinkFilter_InitMessage.
+*
+*   @return     A non-zero value if the message passes all the conditions of
+*               the filter, 0 otherwise.
+*/
+extern int LinkFilter_MatchesMessage(LINK_FILTER_HANDLE filter, LINK_FILTER_MESSAGE* filter_message);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // !LINK_FILTER_H
@@ -0,0 +1,85 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       message_queue.h
+*   @brief      Header file with internal API for the message queues used by
+*               the brokers to hold the messages waiting to be delivered to a
+*               module.
+*
+*   @details    A message queue is a growable ring buffer of MESSAGE_HANDLEs.
+*               Pushing and popping a message are O(1) operations and the
+*               entire content of two queues can be exchanged in O(1) with
+*               MessageQueue_Swap. The queue does not synchronize access;
+*               callers are expected to hold the appropriate lock.
+*/
+
+#ifndef MESSAGE_QUEUE_H
+#define MESSAGE_QUEUE_H
+
+#include <stddef.h>
+
+#include "message.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+typedef struct MESSAGE_QUEUE_TAG* MESSAGE_QUEUE_HANDLE;
+
+/** @brief      Creates a new, empty message queue.
+*
+*   @return     A valid #MESSAGE_QUEUE_HANDLE upon success, or @c NULL upon
+*               failure.
+*/
+extern MESSAGE_QUEUE_HANDLE MessageQueue_Create(void);
+
+/** @brief      Destroys the queue, calling Message_Destroy on every message
+*               still in it.
+*
+*   @param      queue   The #MESSAGE_QUEUE_HANDLE to destroy.
+*/
+extern void MessageQueue_Destroy(MESSAGE_QUEUE_HANDLE queue);
+
+/** @brief      Appends a message at the back of the queue. The queue takes
+*               ownership of the message upon success.
+*
+*   @param      queue   The #MESSAGE_QUEUE_HANDLE to append to.
+*   @param      message The #MESSAGE_HANDLE to append.
+*
+*   @return     0 upon success, a non-zero value otherwise.
+*/
+extern int MessageQueue_Push(MESSAGE_QUEUE_HANDLE queue, MESSAGE_HANDLE message);
+
+/** @brief      Removes the message at the front of the queue and hands its
+*               ownership to the caller.
+*
+*   @param      queue   The #MESSAGE_QUEUE_HANDLE to pop from.
+*
+*   @return     The #MESSAGE_HANDLE that was at the front of the queue, or
+*               @c NULL if the queue is empty.
+*/
+extern MESSAGE_HANDLE MessageQueue_Pop(MESSAGE_QUEUE_HANDLE queue);
+
+/** @brief      Returns the number of messages in the queue.
+*
+*   @param      queue   The #MESSAGE_QUEUE_HANDLE to query.
+*
+*   @return     The number of messages in the queue, 0 if @c queue is
+*               @c NULL.
+*/
+extern size_t MessageQueue_Size(MESSAGE_QUEUE_HANDLE queue);
+
+/** @brief      Exchanges the content of two queues without copying or
+*               reallocating any message.
+*
+*   @param      queue1  The first #MESSAGE_QUEUE_HANDLE.
+*   @param      queue2  The second #MESSAGE_QUEUE_HANDLE.
+*/
+extern void MessageQueue_Swap(MESSAGE_QUEUE_HANDLE queue1, MESSAGE_QUEUE_HANDLE queue2);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // !MESSAGE_QUEUE_H
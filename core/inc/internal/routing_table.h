@@ -0,0 +1,169 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       routing_table.h
+*   @brief      Header file with internal API for the routing snapshots the
+*               brokers publish with.
+*
+*   @details    A routing snapshot is an immutable copy of the modules
+*               attached to a broker and of the sinks each of them routes
+*               messages to. The broker builds a new snapshot whenever a
+*               module or a link is added or removed and installs it in its
+*               routing table; publishers acquire the current snapshot and
+*               route every message through it without holding the lock
+*               that serializes the topology changes, so publishes from
+*               different modules proceed in parallel. Installing a snapshot
+*               waits until every publisher that acquired the previous one
+*               has released it, so that the modules it references can be
+*               freed safely afterwards. Acquired snapshots are reference
+*               counted and the current one is read with an atomic load, so
+*               acquiring and releasing one take no lock.
+*/
+
+#ifndef ROUTING_TABLE_H
+#define ROUTING_TABLE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+typedef struct ROUTING_TABLE_TAG* ROUTING_TABLE_HANDLE;
+typedef struct ROUTING_SNAPSHOT_TAG* ROUTING_SNAPSHOT_HANDLE;
+
+/** @brief      A route of a module of a routing snapshot. */
+typedef struct ROUTING_SINK_TAG
+{
+    /** @brief  The broker's data for the module the route leads to. */
+    void*           sink;
+
+    /** @brief  The broker's filter of the route, @c NULL if it has none. */
+    const void*     filter;
+
+    /** @brief  The broker's traffic counters of the route. */
+    void*           counters;
+
+    /** @brief  Nonzero if the broker may deliver the messages of the route
+    *           on the thread publishing them.
+    */
+    int             inline_delivery;
+} ROUTING_SINK;
+
+/** @brief      A module of a routing snapshot. */
+typedef struct ROUTING_ENTRY_TAG
+{
+    /** @brief  The value the module is found by, its module handle. */
+    const void*     key;
+
+    /** @brief  The broker's data for the module. */
+    void*           module;
+
+    /** @brief  The routes of the module. */
+    ROUTING_SINK*   sinks;
+
+    /** @brief  Number of elements of @c sinks. */
+    size_t          sink_count;
+} ROUTING_ENTRY;
+
+/** @brief      Creates a routing table without a snapshot.
+*
+*   @return     A valid #ROUTING_TABLE_HANDLE upon success, or @c NULL upon
+*               failure.
+*/
+extern ROUTING_TABLE_HANDLE RoutingTable_Create(void);
+
+/** @brief      Frees the routing table and its current snapshot. No
+*               snapshot of the table may be acquired.
+*
+*   @param      table   The #ROUTING_TABLE_HANDLE to destroy.
+*/
+extern void RoutingTable_Destroy(ROUTING_TABLE_HANDLE table);
+
+/** @brief      Installs a snapshot as the current snapshot of the table,
+*               waits until the previous snapshot is released by every
+*               publisher and frees it. If the table lock cannot be taken,
+*               the previous snapshot is leaked rather than freed.
+*
+*   @param      table       The #ROUTING_TABLE_HANDLE to update.
+*   @param      snapshot    The #ROUTING_SNAPSHOT_HANDLE to install, the table
+*                           takes its ownership. May be @c NULL to remove
+*                           every module from the table.
+*/
+extern void RoutingTable_Swap(ROUTING_TABLE_HANDLE table, ROUTING_SNAPSHOT_HANDLE snapshot);
+
+/** @brief      Acquires the current snapshot of the table. The snapshot is
+*               not freed before it is released with ::RoutingTable_Release.
+*
+*   @param      table   The #ROUTING_TABLE_HANDLE to read.
+*
+*   @return     The current #ROUTING_SNAPSHOT_HANDLE, or @c NULL if the table
+*               has no snapshot or upon failure.
+*/
+extern ROUTING_SNAPSHOT_HANDLE RoutingTable_Acquire(ROUTING_TABLE_HANDLE table);
+
+/** @brief      Releases a snapshot acquired with ::RoutingTable_Acquire.
+*
+*   @param      table       The #ROUTING_TABLE_HANDLE the snapshot was
+*                           acquired from.
+*   @param      snapshot    The #ROUTING_SNAPSHOT_HANDLE to release.
+*/
+extern void RoutingTable_Release(ROUTING_TABLE_HANDLE table, ROUTING_SNAPSHOT_HANDLE snapshot);
+
+/** @brief      Creates an empty snapshot with room for the given number of
+*               modules and sinks, in one allocation.
+*
+*   @param      entry_count The number of modules of the snapshot.
+*   @param      sink_count  The total number of sinks of the modules.
+*
+*   @return     A valid #ROUTING_SNAPSHOT_HANDLE upon success, or @c NULL upon
+*               failure.
+*/
+extern ROUTING_SNAPSHOT_HANDLE RoutingSnapshot_Create(size_t entry_count, size_t sink_count);
+
+/** @brief      Frees a snapshot that was not installed in a table.
+*
+*   @param      snapshot    The #ROUTING_SNAPSHOT_HANDLE to destroy.
+*/
+extern void RoutingSnapshot_Destroy(ROUTING_SNAPSHOT_HANDLE snapshot);
+
+/** @brief      Appends a module to a snapshot being built.
+*
+*   @param      snapshot    The #ROUTING_SNAPSHOT_HANDLE being built.
+*   @param      key         The value the module is found by.
+*   @param      module      The broker's data for the module.
+*   @param      sink_count  The number of sinks of the module's routes.
+*
+*   @return     The array of @c sink_count #ROUTING_SINK of the module, which
+*               the caller fills before installing the snapshot, or @c NULL
+*               if the snapshot has no room for the module or its sinks.
+*/
+extern ROUTING_SINK* RoutingSnapshot_AddEntry(ROUTING_SNAPSHOT_HANDLE snapshot, const void* key, void* module, size_t sink_count);
+
+/** @brief      Finds a module of a snapshot.
+*
+*   @param      snapshot    The #ROUTING_SNAPSHOT_HANDLE to search.
+*   @param      key         The value the module is found by.
+*
+*   @return     The #ROUTING_ENTRY of the module, or @c NULL if the snapshot
+*               does not have it.
+*/
+extern const ROUTING_ENTRY* RoutingSnapshot_Find(ROUTING_SNAPSHOT_HANDLE snapshot, const void* key);
+
+/** @brief      Returns every module of a snapshot, in the order they were
+*               added.
+*
+*   @param      snapshot    The #ROUTING_SNAPSHOT_HANDLE to read.
+*   @param      entry_count Receives the number of modules.
+*
+*   @return     The array of #ROUTING_ENTRY of the snapshot, or @c NULL if the
+*               snapshot is @c NULL or empty.
+*/
+extern const ROUTING_ENTRY* RoutingSnapshot_GetEntries(ROUTING_SNAPSHOT_HANDLE snapshot, size_t* entry_count);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // !ROUTING_TABLE_H
@@ -0,0 +1,49 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       thread_options.h
+*   @brief      Header file with internal API for applying the
+*               #BROKER_THREAD_OPTIONS of a module to a thread.
+*
+*   @details    The options are applied by the thread they concern, the
+*               thread delivering a module's messages or a thread the module
+*               started, since the thread handles of the shared utility
+*               library do not expose the handles of the platform.
+*/
+
+#ifndef THREAD_OPTIONS_H
+#define THREAD_OPTIONS_H
+
+#include "broker.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+/** @brief      Tells whether thread options change anything.
+*
+*   @param      options     The #BROKER_THREAD_OPTIONS to test.
+*
+*   @return     Nonzero if @c options is @c NULL or keeps the affinity, the
+*               scheduling class and the name of the thread, 0 otherwise.
+*/
+extern int ThreadOptions_IsDefault(const BROKER_THREAD_OPTIONS* options);
+
+/** @brief      Applies thread options to the calling thread.
+*
+*   @details    Every option is attempted even when an earlier one fails,
+*               so that, for instance, a thread is still named when it is
+*               not allowed a real-time scheduling class.
+*
+*   @param      options     The #BROKER_THREAD_OPTIONS to apply.
+*
+*   @return     0 if all the options were applied, nonzero otherwise.
+*/
+extern int ThreadOptions_Apply(const BROKER_THREAD_OPTIONS* options);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // !THREAD_OPTIONS_H
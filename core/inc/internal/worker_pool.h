@@ -0,0 +1,94 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       worker_pool.h
+*   @brief      Header file with internal API for the pool of worker threads
+*               the brokers use to deliver messages to the modules.
+*
+*   @details    A worker pool runs a fixed number of threads that execute
+*               strands. A strand is a function and its context that is run
+*               by at most one worker at a time: scheduling a strand that is
+*               already queued does nothing and scheduling a strand that is
+*               running makes it run once more when it returns. A module
+*               gets one strand, so its messages are delivered serially and
+*               in order while the deliveries of many modules share the
+*               workers. Each worker has its own run queue and an idle
+*               worker steals strands queued on the other workers.
+*/
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+typedef struct WORKER_POOL_TAG* WORKER_POOL_HANDLE;
+typedef struct STRAND_TAG* STRAND_HANDLE;
+
+/** @brief      Function run by a worker when a strand is scheduled.
+*
+*   @param      context The context given to WorkerPool_CreateStrand.
+*/
+typedef void(*STRAND_FUNCTION)(void* context);
+
+/** @brief      Creates a worker pool and starts its threads.
+*
+*   @param      worker_count    The number of worker threads, or 0 for one
+*                               worker per online processor.
+*
+*   @return     A valid #WORKER_POOL_HANDLE upon success, or @c NULL upon
+*               failure.
+*/
+extern WORKER_POOL_HANDLE WorkerPool_Create(size_t worker_count);
+
+/** @brief      Stops and joins the worker threads and frees the pool. Every
+*               strand of the pool must have been destroyed.
+*
+*   @param      pool    The #WORKER_POOL_HANDLE to destroy.
+*/
+extern void WorkerPool_Destroy(WORKER_POOL_HANDLE pool);
+
+/** @brief      Returns the number of worker threads of the pool.
+*
+*   @param      pool    The #WORKER_POOL_HANDLE to query.
+*
+*   @return     The number of workers, 0 if @c pool is @c NULL.
+*/
+extern size_t WorkerPool_GetWorkerCount(WORKER_POOL_HANDLE pool);
+
+/** @brief      Creates a new, idle strand on the pool.
+*
+*   @param      pool        The #WORKER_POOL_HANDLE that runs the strand.
+*   @param      function    The #STRAND_FUNCTION to run when the strand is
+*                           scheduled.
+*   @param      context     The context passed to @c function.
+*
+*   @return     A valid #STRAND_HANDLE upon success, or @c NULL upon failure.
+*/
+extern STRAND_HANDLE WorkerPool_CreateStrand(WORKER_POOL_HANDLE pool, STRAND_FUNCTION function, void* context);
+
+/** @brief      Schedules the strand to run on one of the pool's workers.
+*
+*   @param      strand  The #STRAND_HANDLE to schedule.
+*
+*   @return     0 upon success, a non-zero value otherwise.
+*/
+extern int WorkerPool_Schedule(STRAND_HANDLE strand);
+
+/** @brief      Unschedules the strand, waits for the function to return if
+*               it is running and frees the strand. This must not be called
+*               from the strand's own function.
+*
+*   @param      strand  The #STRAND_HANDLE to destroy.
+*/
+extern void WorkerPool_DestroyStrand(STRAND_HANDLE strand);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // !WORKER_POOL_H
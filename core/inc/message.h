@@ -44,6 +44,27 @@ extern "C"
 /** @brief Struct representing a particular message. */
 typedef struct MESSAGE_HANDLE_DATA_TAG* MESSAGE_HANDLE;
 
+#define MESSAGE_PROPERTY_ID_VALUES \
+    MESSAGE_PROPERTY_SOURCE, \
+    MESSAGE_PROPERTY_MAC_ADDRESS, \
+    MESSAGE_PROPERTY_DEVICENAME, \
+    MESSAGE_PROPERTY_DEVICEKEY, \
+    MESSAGE_PROPERTY_BLE_CONTROLLER_INDEX, \
+    MESSAGE_PROPERTY_TIMESTAMP, \
+    MESSAGE_PROPERTY_CHARACTERISTIC_UUID, \
+    MESSAGE_PROPERTY_ID_COUNT
+
+/** @brief	Enumeration of the well-known message properties that can be
+*			fetched with ::Message_GetPropertyById.
+*
+*	@details	The properties are, in order, "source", "macAddress",
+*				"deviceName", "deviceKey", "bleControllerIndex", "timestamp"
+*				and "characteristicUUID", the names used by the modules in
+*				modules/common/messageproperties.h. #MESSAGE_PROPERTY_ID_COUNT
+*				is not a property.
+*/
+DEFINE_ENUM(MESSAGE_PROPERTY_ID, MESSAGE_PROPERTY_ID_VALUES);
+
 /** @brief	Struct defining the Message configuration; messages are constructed 
 *			using this structure.
 */
@@ -84,13 +105,28 @@ typedef struct MESSAGE_BUFFER_CONFIG_TAG
     MAP_HANDLE sourceProperties;
 }MESSAGE_BUFFER_CONFIG;
 
+/** @brief A change to the properties of a message made by
+*          ::Message_CloneWithPropertyEdits.
+*/
+typedef struct MESSAGE_PROPERTY_EDIT_TAG
+{
+    /** @brief	The name of the property. This field must not be @c NULL. */
+    const char* key;
+
+    /** @brief	The new value of the property, or @c NULL to remove the
+    *			property from the message.
+    */
+    const char* value;
+}MESSAGE_PROPERTY_EDIT;
+
 /** @brief		Creates a new reference counted message from a #MESSAGE_CONFIG
 *				structure with the reference count initialized to 1.
 *
-*	@details	This function will create its own @c CONSTBUFFER and @c ConstMap
-*				with copies of the @c source and @c sourceProperties contained
-*				within the #MESSAGE_CONFIG structure parameter. It is the
-*				responsibility of the Message to dispose of these resources.
+*	@details	This function will copy the @c source and the @c
+*				sourceProperties contained within the #MESSAGE_CONFIG
+*				structure parameter into the same allocation as the message.
+*				It is the responsibility of the Message to dispose of these
+*				resources.
 *
 *	@param		cfg		Pointer to a #MESSAGE_CONFIG structure.
 *
@@ -113,6 +149,34 @@ extern MESSAGE_HANDLE Message_Create(const MESSAGE_CONFIG* cfg);
 */
 extern MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t size);
 
+/** @brief		Function called by a message created by
+*				::Message_CreateFromByteArrayNoCopy to release its byte array
+*				when the message is destroyed.
+*/
+typedef void(*MESSAGE_BYTE_ARRAY_RELEASE)(void* context);
+
+/** @brief		Creates a new reference counted message that references a byte
+*				array containing the serialized form of a message instead of
+*				copying it.
+*
+*	@details	The properties and the content of the newly created message
+*				point into @c source, which must stay unchanged until the
+*				message releases it. On success the message owns the byte array
+*				and calls @c release with @c context when its reference count
+*				drops to 0. On failure @c release is not called and the caller
+*				still owns the byte array.
+*
+*	@param		source		Pointer to a byte array.
+*   @param      size        size in bytes of the array
+*	@param		release		Function releasing the byte array (optional, may
+*							be NULL).
+*	@param		context		Argument passed to @c release.
+*
+*	@return		A non-NULL #MESSAGE_HANDLE for the newly created message, or NULL
+*				upon failure.
+*/
+extern MESSAGE_HANDLE Message_CreateFromByteArrayNoCopy(const unsigned char* source, int32_t size, MESSAGE_BYTE_ARRAY_RELEASE release, void* context);
+
 /** @brief		Creates a byte array representation of a MESSAGE_HANDLE. 
 *
 *	@details	The byte array created can be used with function #Message_CreateFromByteArray
@@ -130,13 +194,87 @@ extern MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, i
 */
 extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char* buf, int32_t size);
 
+#define MESSAGE_WIRE_FORMAT_VALUES \
+    MESSAGE_WIRE_FORMAT_V1, \
+    MESSAGE_WIRE_FORMAT_V2
+
+/** @brief	Enumeration of the byte array representations of a message.
+*
+*	@details	#MESSAGE_WIRE_FORMAT_V1 is the format produced by
+*				::Message_ToByteArray. #MESSAGE_WIRE_FORMAT_V2 stores lengths
+*				as varints and has an offset table, so it is smaller for
+*				small messages and a reader finds any property without
+*				scanning the others. ::Message_CreateFromByteArray and
+*				::Message_CreateFromByteArrayNoCopy read both.
+*/
+DEFINE_ENUM(MESSAGE_WIRE_FORMAT, MESSAGE_WIRE_FORMAT_VALUES);
+
+/** @brief		Creates a byte array representation of a MESSAGE_HANDLE in
+*				a given format.
+*
+*	@details	Behaves as ::Message_ToByteArray, which it is equivalent to
+*				when @c format is #MESSAGE_WIRE_FORMAT_V1. Only use
+*				#MESSAGE_WIRE_FORMAT_V2 when the reader is known to be built
+*				with this version of the gateway, language bindings only read
+*				#MESSAGE_WIRE_FORMAT_V1.
+*
+*	@param		messageHandle		A #MESSAGE_HANDLE. This parameter cannot be NULL.
+*	@param		format				The #MESSAGE_WIRE_FORMAT to produce.
+*	@param		buf					A pointer to a byte array in memory, may be NULL.
+*   @param      size                An int32_t that specifies the size of buf.
+*
+*	@return		The size of the serialized message when "buf" is not NULL,
+*				the size required for the serialization when "buf" is NULL,
+*				or a negative value when an error occurs.
+*/
+extern int32_t Message_ToByteArrayWithFormat(MESSAGE_HANDLE messageHandle, MESSAGE_WIRE_FORMAT format, unsigned char* buf, int32_t size);
+
+/** @brief	Number of segments filled in by ::Message_ToIoVec. */
+#define MESSAGE_IOVEC_COUNT 2
+
+/** @brief	A segment of a serialized message, see ::Message_ToIoVec. */
+typedef struct MESSAGE_IOVEC_TAG
+{
+	/** @brief	Pointer to the bytes of the segment. */
+	const unsigned char* buffer;
+	/** @brief	Number of bytes in the segment. */
+	size_t size;
+} MESSAGE_IOVEC;
+
+/** @brief		Serializes a MESSAGE_HANDLE as a list of segments without
+*				copying its content.
+*
+*	@details	The concatenation of the segments is the byte array
+*				::Message_ToByteArray would produce. The first segment holds
+*				the header, the properties and the size of the content and is
+*				allocated by this function; the second segment points to the
+*				content of the message, so it is only valid as long as
+*				@c messageHandle is. The segments can be handed to @c writev
+*				or a similar gather write. Release them with
+*				::Message_FreeIoVec.
+*
+*	@param		messageHandle		A #MESSAGE_HANDLE. This parameter cannot be NULL.
+*	@param		segments			Array of #MESSAGE_IOVEC_COUNT segments to fill in.
+*
+*	@return		The total size in bytes of the segments, or a negative value
+*				when an error occurs.
+*/
+extern int32_t Message_ToIoVec(MESSAGE_HANDLE messageHandle, MESSAGE_IOVEC segments[MESSAGE_IOVEC_COUNT]);
+
+/** @brief		Frees the segments filled in by ::Message_ToIoVec.
+*
+*	@param		segments	The segments passed to a successful call of
+*							::Message_ToIoVec.
+*/
+extern void Message_FreeIoVec(MESSAGE_IOVEC segments[MESSAGE_IOVEC_COUNT]);
+
 /** @brief		Creates a new message from a @c CONSTBUFFER source and @c MAP_HANDLE.
 *
-*	@details	This function will create a new message its own @c CONSTBUFFER 
-*               and @c ConstMap with copies of the @c source and @c 
-*               sourceProperties contained within the #MESSAGE_CONFIG structure 
-*               parameter. The message will be created with the reference count 
-*               initialized to 1. It is the responsibility of the Message to 
+*	@details	This function will create a new message holding a clone of
+*               the @c CONSTBUFFER source and a copy of the sourceProperties
+*               contained within the #MESSAGE_BUFFER_CONFIG structure parameter.
+*               The message will be created with the reference count
+*               initialized to 1. It is the responsibility of the Message to
 *               dispose of these resources.
 *
 *	@param		cfg		Pointer to a #MESSAGE_BUFFER_CONFIG structure.
@@ -158,9 +296,37 @@ extern MESSAGE_HANDLE Message_CreateFromBuffer(const MESSAGE_BUFFER_CONFIG* cfg)
 */
 extern MESSAGE_HANDLE Message_Clone(MESSAGE_HANDLE message);
 
+/** @brief		Creates a new message with the content and properties of a
+*				message, changed by a set of property edits.
+*
+*	@details	The new message shares the content and the properties of
+*				@c message and only stores the edits, so the cost does not
+*				depend on the number of properties of @c message. When
+*				several edits have the same key the last one wins. Editing a
+*				message that was itself created by this function combines
+*				both sets of edits over the original message.
+*				::Message_GetPropertyById and ::Message_ToByteArray see the
+*				edited properties, and so does the @c CONSTMAP that
+*				::Message_GetProperties builds.
+*
+*	@param		message		The #MESSAGE_HANDLE whose content and properties
+*							the new message shares.
+*	@param		edits		Array of #MESSAGE_PROPERTY_EDIT, may be @c NULL
+*							when @c editCount is zero. The strings are
+*							copied.
+*	@param		editCount	Number of elements in @c edits.
+*
+*	@return		A non-NULL #MESSAGE_HANDLE with a reference count of 1, or
+*				@c NULL upon failure.
+*/
+extern MESSAGE_HANDLE Message_CloneWithPropertyEdits(MESSAGE_HANDLE message, const MESSAGE_PROPERTY_EDIT* edits, size_t editCount);
+
 /** @brief		Gets the properties of a message.
 *
-*	@details	The returned @c CONSTMAP handle should be destroyed when no 
+*	@details	The first call builds a @c CONSTMAP holding copies of the
+*               properties and keeps it in the message; every call returns a
+*               clone of it, so only the first call copies the properties.
+*               The returned @c CONSTMAP handle should be destroyed when no
 *               longer needed.
 *
 *	@param		message		The #MESSAGE_HANDLE from which properties will be
@@ -172,6 +338,41 @@ extern MESSAGE_HANDLE Message_Clone(MESSAGE_HANDLE message);
 */
 extern CONSTMAP_HANDLE Message_GetProperties(MESSAGE_HANDLE message);
 
+/** @brief		Gets the value of a well-known property of a message.
+*
+*	@details	The well-known properties of a message are looked up once
+*				when the message is created, so this function takes constant
+*				time and, unlike ::Message_GetProperties, does not copy the
+*				properties of the message. The returned string belongs to
+*				the message and is valid as long as the message is.
+*
+*	@param		message		The #MESSAGE_HANDLE from which the property will
+*							be fetched.
+*	@param		id			The #MESSAGE_PROPERTY_ID of the property.
+*
+*	@return		The value of the property, or @c NULL if the message does not
+*				have it or upon failure.
+*/
+extern const char* Message_GetPropertyById(MESSAGE_HANDLE message, MESSAGE_PROPERTY_ID id);
+
+/** @brief		Gets the value of a property of a message.
+*
+*	@details	Unlike ::Message_GetProperties, this function does not copy
+*				the properties of the message; it searches them, which takes
+*				a time proportional to their number. Use
+*				::Message_GetPropertyById for the well-known properties. The
+*				returned string belongs to the message and is valid as long
+*				as the message is.
+*
+*	@param		message		The #MESSAGE_HANDLE from which the property will
+*							be fetched.
+*	@param		key			The name of the property.
+*
+*	@return		The value of the property, or @c NULL if the message does not
+*				have it or upon failure.
+*/
+extern const char* Message_GetProperty(MESSAGE_HANDLE message, const char* key);
+
 /** @brief		Gets the content of a message.
 *
 *	@details	The returned @c CONSTBUFFER need not be freed by the caller.
@@ -187,7 +388,15 @@ extern const CONSTBUFFER* Message_GetContent(MESSAGE_HANDLE message);
 /** @brief		Gets the @c CONSTBUFFER handle that may be used to access the 
 *               message content.
 *
-*	@details	This handle must be destroyed when no longer needed.
+*	@details	This handle must be destroyed when no longer needed. Only a
+*				message created by ::Message_CreateFromBuffer holds its content
+*				in a @c CONSTBUFFER, which is cloned. Any other message stores
+*				its content in its own allocation or in the byte array it was
+*				created from, and a @c CONSTBUFFER cannot refer to memory it
+*				does not own, so every call allocates a new @c CONSTBUFFER
+*				and copies the whole content into it. Use ::Message_GetContent,
+*				which neither allocates nor copies, when the content is only
+*				read while the message is alive.
 *
 *	@param		message		The #MESSAGE_HANDLE from which the content will be
 *							fetched.
@@ -203,6 +412,77 @@ extern CONSTBUFFER_HANDLE Message_GetContentHandle(MESSAGE_HANDLE message);
 */
 extern void Message_Destroy(MESSAGE_HANDLE message);
 
+/** @brief	Struct representing a batch of messages published together with
+*			::Broker_PublishBatch.
+*/
+typedef struct MESSAGE_BATCH_HANDLE_DATA_TAG* MESSAGE_BATCH_HANDLE;
+
+/** @brief		Creates a new, empty batch of messages.
+*
+*	@details	The messages created by ::MessageBatch_AddContent share one
+*				read-only copy of @c sharedProperties instead of copying the
+*				properties once per message.
+*
+*	@param		sharedProperties	The properties of the messages created by
+*									::MessageBatch_AddContent (optional, may
+*									be NULL).
+*
+*	@return		A valid #MESSAGE_BATCH_HANDLE upon success, or @c NULL upon
+*				failure.
+*/
+extern MESSAGE_BATCH_HANDLE MessageBatch_Create(MAP_HANDLE sharedProperties);
+
+/** @brief		Appends a clone of a message to the batch.
+*
+*	@param		batch		The #MESSAGE_BATCH_HANDLE to append to.
+*	@param		message		The #MESSAGE_HANDLE to append.
+*
+*	@return		0 upon success, a non-zero value otherwise.
+*/
+extern int MessageBatch_Add(MESSAGE_BATCH_HANDLE batch, MESSAGE_HANDLE message);
+
+/** @brief		Appends a new message with the given content and the shared
+*				properties of the batch.
+*
+*	@details	Fails if the batch was created without shared properties.
+*
+*	@param		batch		The #MESSAGE_BATCH_HANDLE to append to.
+*	@param		source		The content of the message, copied into it.
+*	@param		size		The size of @c source.
+*
+*	@return		0 upon success, a non-zero value otherwise.
+*/
+extern int MessageBatch_AddContent(MESSAGE_BATCH_HANDLE batch, const unsigned char* source, size_t size);
+
+/** @brief		Returns the number of messages in the batch.
+*
+*	@param		batch		The #MESSAGE_BATCH_HANDLE to query.
+*
+*	@return		The number of messages in the batch, 0 if @c batch is
+*				@c NULL.
+*/
+extern size_t MessageBatch_GetCount(MESSAGE_BATCH_HANDLE batch);
+
+/** @brief		Returns the messages of the batch.
+*
+*	@details	The batch keeps the ownership of the messages; call
+*				::Message_Clone to keep one after the batch is destroyed.
+*				Adding to the batch invalidates the returned array.
+*
+*	@param		batch		The #MESSAGE_BATCH_HANDLE to query.
+*
+*	@return		The ::MessageBatch_GetCount messages of the batch in the order
+*				they were added, or @c NULL if the batch is @c NULL or empty.
+*/
+extern const MESSAGE_HANDLE* MessageBatch_GetMessages(MESSAGE_BATCH_HANDLE batch);
+
+/** @brief		Destroys the batch, calling ::Message_Destroy on every message
+*				in it.
+*
+*	@param		batch		The #MESSAGE_BATCH_HANDLE to destroy.
+*/
+extern void MessageBatch_Destroy(MESSAGE_BATCH_HANDLE batch);
+
 #ifdef __cplusplus
 }
 #else
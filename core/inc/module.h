@@ -112,6 +112,44 @@ extern "C"
 	*/
 	typedef void(*pfModule_Start)(MODULE_HANDLE moduleHandle);
 
+    /** @brief		The module's callback function that is called upon receipt
+    *				of several messages at once.
+    *
+    *	@details	This function is to be implemented by the module creator
+    *				(optional). When it is provided, the broker hands the module
+    *				up to BROKER_QUEUE_OPTIONS::max_batch_size queued messages
+    *				per call, in order, instead of calling #Module_Receive once
+    *				per message. The broker destroys the messages after the
+    *				call returns, so a module that keeps one must clone it.
+    *
+    *	@param		moduleHandle	The #MODULE_HANDLE of the module receiving the
+    *								messages.
+    *	@param		messageHandles	The #MESSAGE_HANDLE array of the messages
+    *								being sent to the module.
+    *	@param		messageCount	The number of messages in
+    *								@p messageHandles, always greater than 0.
+    */
+    typedef void(*pfModule_ReceiveBatch)(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE* messageHandles, size_t messageCount);
+
+    /** @brief		The module's callback function that is called upon message
+    *				receipt and that takes ownership of the message.
+    *
+    *	@details	This function is to be implemented by the module creator
+    *				(optional). When it is provided, the broker calls it instead
+    *				of #Module_Receive and does not destroy the message
+    *				afterwards: the module must call Message_Destroy on
+    *				@p messageHandle once it is done with it. Modules that keep
+    *				messages past the call can implement it instead of cloning
+    *				every message they receive. #Module_ReceiveBatch takes
+    *				precedence when a module implements both.
+    *
+    *	@param		moduleHandle	The #MODULE_HANDLE of the module receiving the
+    *								message.
+    *	@param		messageHandle	The #MESSAGE_HANDLE of the message being sent
+    *								to the module, now owned by the module.
+    */
+    typedef void(*pfModule_ReceiveOwned)(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle);
+
     /** @brief	Structure returned by ::Module_GetAPIS containing the function
     *			pointers of the module-specific implementations of the interface.
     */
@@ -128,6 +166,12 @@ extern "C"
 
 		/** @brief Function pointer to the #Module_Start function (optional). */
 		pfModule_Start Module_Start;
+
+        /** @brief Function pointer to the #Module_ReceiveBatch function (optional). */
+        pfModule_ReceiveBatch Module_ReceiveBatch;
+
+        /** @brief Function pointer to the #Module_ReceiveOwned function (optional). */
+        pfModule_ReceiveOwned Module_ReceiveOwned;
     };
 
     /** @brief	This is the only function exported by a module. Using the
@@ -8,13 +8,14 @@
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 #include <signal.h>
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/lock.h"
 #include "azure_c_shared_utility/condition.h"
-#include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/refcount.h"
 #include "azure_c_shared_utility/list.h"
@@ -22,16 +23,32 @@
 #include "message.h"
 #include "module.h"
 #include "broker.h"
+#include "internal/message_queue.h"
+#include "internal/worker_pool.h"
+#include "internal/routing_table.h"
+#include "internal/link_filter.h"
+#include "internal/broker_statistics.h"
+#include "internal/thread_options.h"
 
 /*The structure backing the message broker handle*/
 typedef struct BROKER_HANDLE_DATA_TAG
 {
     LIST_HANDLE                modules;
     LOCK_HANDLE             modules_lock;
+    WORKER_POOL_HANDLE      worker_pool;
+    /**
+    * Snapshot of 'modules' and of their routes that Broker_Publish routes
+    * messages with, without acquiring 'modules_lock'. Rebuilt under
+    * 'modules_lock' whenever a module or a route is added or removed.
+    */
+    ROUTING_TABLE_HANDLE    routing_table;
 }BROKER_HANDLE_DATA;
 
 DEFINE_REFCOUNT_TYPE(BROKER_HANDLE_DATA);
 
+/*Number of messages handed to Module_ReceiveBatch at once when the module's options do not say*/
+#define DEFAULT_MAX_BATCH_SIZE 64
+
 typedef struct BROKER_MODULEINFO_TAG
 {
     /**
@@ -40,36 +57,137 @@ typedef struct BROKER_MODULEINFO_TAG
     MODULE*             module;
 
     /**
-    * Handle to the thread on which this module's message processing loop is
-    * running.
+    * Handle to the strand that delivers this module's messages on the
+    * broker's worker pool.
     */
-    THREAD_HANDLE           thread;
+    STRAND_HANDLE           strand;
 
     /**
     * Handle to the queue of messages to be delivered to this module.
     */
-    VECTOR_HANDLE           mq;
+    MESSAGE_QUEUE_HANDLE    mq;
 
     /**
-    * Lock used to synchronize access to the 'mq' field.
+    * Handle to the queue of messages the worker is delivering. The worker
+    * swaps it with 'mq' to take the whole backlog at once and then drains it
+    * without holding 'mq_lock'. Only accessed by the module's strand.
     */
-    LOCK_HANDLE             mq_lock;
+    MESSAGE_QUEUE_HANDLE    delivery_mq;
 
     /**
-    * A condition variable that is signaled when there are new messages.
+    * Lock used to synchronize access to the 'mq' field.
     */
-    COND_HANDLE             mq_cond;
+    LOCK_HANDLE             mq_lock;
 
     /**
     * Message publish worker will keep running while this is false.
     */
     volatile sig_atomic_t   quit_worker;
+
+    /**
+    * Bounds of 'mq' and what to do with a message that does not fit.
+    */
+    BROKER_QUEUE_OPTIONS    queue_options;
+
+    /**
+    * Options of the threads running the module's code, only applied by
+    * Broker_ApplyModuleThreadOptions since the worker pool is shared.
+    */
+    BROKER_THREAD_OPTIONS   thread_options;
+
+    /**
+    * Number of bytes of message content in 'mq'. Protected by 'mq_lock'.
+    */
+    size_t                  mq_bytes;
+
+    /**
+    * Counters of 'mq' for Broker_GetStatistics. Protected by 'mq_lock'.
+    */
+    BROKER_QUEUE_COUNTERS   queue_counters;
+
+    /**
+    * A condition variable that is signaled when the worker empties 'mq'. It
+    * is only created for the BROKER_QUEUE_BLOCK policy and is NULL otherwise.
+    */
+    COND_HANDLE             space_cond;
+
+    /**
+    * Set by Broker_RemoveModule before it rebuilds the routing snapshot, so
+    * that the publishers waiting on 'space_cond' give up instead of holding
+    * the snapshot the rebuild waits for. Protected by 'mq_lock'.
+    */
+    bool                    removing;
+
+    /**
+    * The messages being handed to the module's Module_ReceiveBatch, room for
+    * 'batch_capacity' handles. It is NULL when the module does not implement
+    * Module_ReceiveBatch. Only accessed by the module's strand.
+    */
+    MESSAGE_HANDLE*         batch;
+
+    /**
+    * Number of handles 'batch' can hold.
+    */
+    size_t                  batch_capacity;
+
+    /**
+    * The routes (of type BROKER_ROUTE) to the modules linked to this module as
+    * a source. This is NULL until the first link from this module is added.
+    * Protected by BROKER_HANDLE_DATA::modules_lock.
+    */
+    VECTOR_HANDLE           routes;
+
+    /**
+    * Number of routes from other modules that have this module as their sink,
+    * not counting the routes being removed. Protected by
+    * BROKER_HANDLE_DATA::modules_lock.
+    */
+    size_t                  inbound_routes;
+
+    /**
+    * Counters of the deliveries for Broker_GetStatistics. Only written by the
+    * module's strand, on cache lines of their own.
+    */
+    BROKER_DELIVERY_COUNTERS    delivery_counters;
 }BROKER_MODULEINFO;
 
+/*A route from a source module to one of its sinks*/
+typedef struct BROKER_ROUTE_TAG
+{
+    BROKER_MODULEINFO*      sink;
+
+    /**
+    * The filter of the link, NULL when every message is delivered. It does
+    * not change for the lifetime of the route and is referenced by the
+    * routing snapshots that hold the route.
+    */
+    LINK_FILTER_HANDLE      filter;
+
+    /**
+    * The traffic counters of the route, allocated on their own because the
+    * routes move when the vector grows while the routing snapshots point at
+    * them. They are updated by the publishers under the mq_lock of the sink.
+    */
+    BROKER_LINK_COUNTERS*   counters;
+
+    /**
+    * Number of times the same link has been added. The route is dropped when
+    * this reaches 0. A route whose count is 0 is being removed: it is left
+    * out of the next routing snapshot and erased once that is installed.
+    */
+    size_t                  link_count;
+}BROKER_ROUTE;
+
 // This variable is used only for unit testing purposes.
 size_t BROKER_offsetof_quit_worker = offsetof(BROKER_MODULEINFO, quit_worker);
 
 BROKER_HANDLE Broker_Create(void)
+{
+    /*Codes_SRS_BCAST_BROKER_13_142: [Broker_Create shall behave as Broker_CreateWithOptions called with NULL options.]*/
+    return Broker_CreateWithOptions(NULL);
+}
+
+BROKER_HANDLE Broker_CreateWithOptions(const BROKER_OPTIONS* options)
 {
     BROKER_HANDLE_DATA* result;
 
@@ -103,6 +221,31 @@ BROKER_HANDLE Broker_Create(void)
                 free(result);
                 result = NULL;
             }
+            else
+            {
+                /*Codes_SRS_BCAST_BROKER_13_143: [Broker_CreateWithOptions shall initialize BROKER_HANDLE_DATA::worker_pool by calling WorkerPool_Create with options->worker_count, or 0 when options is NULL.]*/
+                result->worker_pool = WorkerPool_Create((options == NULL) ? 0 : options->worker_count);
+                if (result->worker_pool == NULL)
+                {
+                    /*Codes_SRS_BCAST_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]*/
+                    LogError("WorkerPool_Create failed");
+                    Lock_Deinit(result->modules_lock);
+                    list_destroy(result->modules);
+                    free(result);
+                    result = NULL;
+                }
+                /*Codes_SRS_BCAST_BROKER_13_152: [Broker_CreateWithOptions shall initialize BROKER_HANDLE_DATA::routing_table by calling RoutingTable_Create.]*/
+                else if ((result->routing_table = RoutingTable_Create()) == NULL)
+                {
+                    /*Codes_SRS_BCAST_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]*/
+                    LogError("RoutingTable_Create failed");
+                    WorkerPool_Destroy(result->worker_pool);
+                    Lock_Deinit(result->modules_lock);
+                    list_destroy(result->modules);
+                    free(result);
+                    result = NULL;
+                }
+            }
         }
     }
 
@@ -124,14 +267,48 @@ void Broker_IncRef(BROKER_HANDLE broker)
     }
 }
 
+#ifndef UWP_BINDING
+/*hands the messages taken by module_publish_worker to Module_ReceiveBatch, BROKER_MODULEINFO::batch_capacity at a time*/
+static void deliver_batches(BROKER_MODULEINFO* module_info)
+{
+    size_t count;
+    do
+    {
+        MESSAGE_HANDLE msg;
+        size_t i;
+
+        count = 0;
+        while ((count < module_info->batch_capacity) &&
+               ((msg = MessageQueue_Pop(module_info->delivery_mq)) != NULL))
+        {
+            module_info->batch[count++] = msg;
+        }
+
+        if ((count > 0) && (module_info->quit_worker == 0))
+        {
+            uint64_t start = BrokerStatistics_GetTime();
+            module_info->module->module_apis->Module_ReceiveBatch(module_info->module->module_handle, module_info->batch, count);
+            BrokerStatistics_RecordDuration(&module_info->delivery_counters.receive_duration, start, BrokerStatistics_GetTime());
+            module_info->delivery_counters.delivered += count;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            Message_Destroy(module_info->batch[i]);
+        }
+    } while (count == module_info->batch_capacity);
+}
+#endif // UWP_BINDING
+
 /**
-* This is the worker function that runs for each module. The module_publish_worker
-* function is passed in a pointer to the relevant MODULE_INFO object as it's
-* thread context parameter. The function's job is to basically wait on the
-* mq_cond condition variable and process messages in module.mq when the
-* condition is signaled.
+* This is the strand function that delivers the messages of a module. The
+* broker schedules the module's strand on its worker pool whenever a message
+* is appended to module.mq and the pool runs it on one worker at a time, so
+* the module receives its messages serially and in order. The whole backlog is
+* taken in one critical section by swapping module.mq with module.delivery_mq
+* and is then delivered without holding the lock.
 */
-static int module_publish_worker(void * user_data)
+static void module_publish_worker(void * user_data)
 {
     /*Codes_SRS_BCAST_BROKER_13_026: [This function shall assign `user_data` to a local variable called `module_info` of type `BROKER_MODULEINFO*`.]*/
     BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)user_data;
@@ -144,37 +321,66 @@ static int module_publish_worker(void * user_data)
     }
     else
     {
-        /*Codes_SRS_BCAST_BROKER_13_068: [This function shall run a loop that keeps running while module_info->quit_worker is equal to 0.]*/
-        while (module_info->quit_worker == 0)
-        {
-            /*Codes_SRS_BCAST_BROKER_13_071: [For every iteration of the loop the function will first wait on module_info->mq_cond using module_info->mq_lock as the corresponding mutex to be used by the condition variable.]*/
-            /*Codes_SRS_BCAST_BROKER_04_001: [This function shall immediately start processing messages when `module->mq` is not empty without waiting on `module->mq_cond`.] */
+        MESSAGE_HANDLE msg;
+        uint64_t oldest_enqueue_time = 0;
+        bool taken = false;
 
-            /*this condition accounts for the case where the message has been enqueued in the past, and the condition has been signalled in the past, and this thread */
-            /*is still at static int module_publish_worker(void * user_data), that is, didn't get to execute Lock(...)*/
-            if ((VECTOR_size(module_info->mq) > 0) || (Condition_Wait(module_info->mq_cond, module_info->mq_lock, 0) == COND_OK))
+        /*Codes_SRS_BCAST_BROKER_13_090: [If module_info->quit_worker is equal to 0, this function shall take every message in module_info->mq by swapping it with the empty module_info->delivery_mq.]*/
+        if ((module_info->quit_worker == 0) && (MessageQueue_Size(module_info->mq) > 0))
+        {
+            MessageQueue_Swap(module_info->mq, module_info->delivery_mq);
+            module_info->mq_bytes = 0;
+            oldest_enqueue_time = module_info->queue_counters.oldest_enqueue_time;
+            taken = true;
+
+            /*Codes_SRS_BCAST_BROKER_13_134: [If BROKER_MODULEINFO::space_cond is not NULL, the function shall signal it after taking the messages.]*/
+            if (module_info->space_cond != NULL &&
+                Condition_Post(module_info->space_cond) != COND_OK)
             {
-                /*Codes_SRS_BCAST_BROKER_13_090: [When module_info->mq_cond has been signaled this function shall kick off another loop predicated on module_info->quit_worker being equal to 0 and module_info->mq not being empty.This thread has the lock on module_info->mq_lock at this point.]*/
-                LOCK_RESULT lock_result = LOCK_OK;
-                while ((module_info->quit_worker == 0) && VECTOR_size(module_info->mq) > 0)
-                {
-                    /*Codes_SRS_BCAST_BROKER_13_069: [The function shall dequeue a message from the module's message queue. ]*/
-                    MESSAGE_HANDLE *pmsg = (MESSAGE_HANDLE*)VECTOR_front(module_info->mq);
-                    MESSAGE_HANDLE msg = *pmsg;
-                    VECTOR_erase(module_info->mq, pmsg, 1);
+                LogError("Condition_Post failed for module [%p]", module_info);
+            }
+        }
 
-                    /*Codes_SRS_BCAST_BROKER_13_091: [The function shall unlock module_info->mq_lock.]*/
-                    if (Unlock(module_info->mq_lock) != LOCK_OK)
-                    {
-                        LogError("unable to unlock");
+        /*Codes_SRS_BCAST_BROKER_13_091: [The function shall unlock module_info->mq_lock.]*/
+        if (Unlock(module_info->mq_lock) != LOCK_OK)
+        {
+            LogError("unable to unlock");
+        }
 
-                        /*Codes_SRS_BCAST_BROKER_13_093: [The function shall destroy the message that was dequeued by calling Message_Destroy.]*/
-                        Message_Destroy(msg);
+        /*Codes_SRS_BCAST_BROKER_13_165: [After taking the messages, the function shall record in BROKER_MODULEINFO::delivery_counters how long the oldest of them waited in the queue.]*/
+        if (taken)
+        {
+            BrokerStatistics_RecordDuration(&module_info->delivery_counters.queue_wait, oldest_enqueue_time, BrokerStatistics_GetTime());
+        }
 
-                        continue;
-                    }
-                    else
+#ifndef UWP_BINDING
+        /*Codes_SRS_BCAST_BROKER_13_146: [If BROKER_MODULEINFO::batch is not NULL, the function shall hand the messages in module_info->delivery_mq to the module's Module_ReceiveBatch in order, at most BROKER_MODULEINFO::batch_capacity at a time, and destroy them after each call.]*/
+        if (module_info->batch != NULL)
+        {
+            deliver_batches(module_info);
+        }
+        else
+#endif // UWP_BINDING
+        {
+            /*Codes_SRS_BCAST_BROKER_13_069: [The function shall dequeue every message from module_info->delivery_mq without acquiring module_info->mq_lock.]*/
+            while ((msg = MessageQueue_Pop(module_info->delivery_mq)) != NULL)
+            {
+                /*Codes_SRS_BCAST_BROKER_13_133: [The function shall not deliver the remaining messages once module_info->quit_worker is not equal to 0.]*/
+#ifndef UWP_BINDING
+                /*Codes_SRS_BCAST_BROKER_13_148: [If the module implements Module_ReceiveOwned, the function shall deliver the message through it and shall not destroy the message.]*/
+                if (module_info->quit_worker == 0 && module_info->module->module_apis->Module_ReceiveOwned != NULL)
+                {
+                    uint64_t start = BrokerStatistics_GetTime();
+                    module_info->module->module_apis->Module_ReceiveOwned(module_info->module->module_handle, msg);
+                    BrokerStatistics_RecordDuration(&module_info->delivery_counters.receive_duration, start, BrokerStatistics_GetTime());
+                    module_info->delivery_counters.delivered++;
+                }
+                else
+#endif // UWP_BINDING
+                {
+                    if (module_info->quit_worker == 0)
                     {
+                        uint64_t start = BrokerStatistics_GetTime();
 #ifdef UWP_BINDING
                         /*Codes_SRS_BCAST_BROKER_99_012: [The function shall deliver the message to the module's Receive function via the IInternalGatewayModule interface. ]*/
                         module_info->module->module_instance->Module_Receive(msg);
@@ -182,39 +388,57 @@ static int module_publish_worker(void * user_data)
                         /*Codes_SRS_BCAST_BROKER_13_092: [The function shall deliver the message to the module's callback function via module_info->module_apis. ]*/
                         module_info->module->module_apis->Module_Receive(module_info->module->module_handle, msg);
 #endif // UWP_BINDING
-
-                        /*Codes_SRS_BCAST_BROKER_13_093: [The function shall destroy the message that was dequeued by calling Message_Destroy.]*/
-                        Message_Destroy(msg);
-
-                        /*Codes_SRS_BCAST_BROKER_13_094: [The function shall re - acquire the lock on module_info->mq_lock.]*/
-                        if ((lock_result = Lock(module_info->mq_lock)) != LOCK_OK)
-                        {
-                            LogError("unable to lock");
-                            break;
-                        }
+                        /*Codes_SRS_BCAST_BROKER_13_166: [The function shall count every message it hands to the module and record how long each call to the module's receive functions took in BROKER_MODULEINFO::delivery_counters.]*/
+                        BrokerStatistics_RecordDuration(&module_info->delivery_counters.receive_duration, start, BrokerStatistics_GetTime());
+                        module_info->delivery_counters.delivered++;
                     }
-                } 
-            }
-            else
-            {
-                LogError("Lock/Condition_Wait has failed. Bailing.");
-                break;
+
+                    /*Codes_SRS_BCAST_BROKER_13_093: [The function shall destroy the message that was dequeued by calling Message_Destroy.]*/
+                    Message_Destroy(msg);
+                }
             }
         }
+    }
+}
 
-        /*Codes_SRS_BCAST_BROKER_13_095: [When the function exits the outer loop predicated on module_info->quit_worker being 0 it shall unlock module_info->mq_lock before exiting from the function.]*/
-        if (Unlock(module_info->mq_lock) != LOCK_OK)
+/*allocates BROKER_MODULEINFO::batch for a module that implements Module_ReceiveBatch; returns 0 on success*/
+static int init_batch(BROKER_MODULEINFO* module_info)
+{
+    int result;
+
+    module_info->batch = NULL;
+    module_info->batch_capacity = 0;
+#ifdef UWP_BINDING
+    result = 0;
+#else
+    if (module_info->module->module_apis->Module_ReceiveBatch == NULL)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t capacity = (module_info->queue_options.max_batch_size == 0) ?
+            DEFAULT_MAX_BATCH_SIZE :
+            module_info->queue_options.max_batch_size;
+
+        module_info->batch = (MESSAGE_HANDLE*)malloc(capacity * sizeof(MESSAGE_HANDLE));
+        if (module_info->batch == NULL)
+        {
+            LogError("malloc of the batch failed");
+            result = __LINE__;
+        }
+        else
         {
-            LogError("unable to unlock - module worker was terminating");
+            module_info->batch_capacity = capacity;
+            result = 0;
         }
     }
+#endif // UWP_BINDING
 
-    
-
-    return 0;
+    return result;
 }
 
-static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* module)
+static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* module, const BROKER_MODULE_OPTIONS* options)
 {
     BROKER_RESULT result;
 
@@ -234,11 +458,17 @@ static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* m
 		module_info->module->module_handle = module->module_handle;
 #endif // UWP_BINDING
 
-        /*Codes_SRS_BCAST_BROKER_13_098: [The function shall initialize BROKER_MODULEINFO::mq with a valid vector handle.]*/
-        module_info->mq = VECTOR_create(sizeof(MESSAGE_HANDLE));
+        /*Codes_SRS_BCAST_BROKER_13_098: [The function shall initialize BROKER_MODULEINFO::mq and BROKER_MODULEINFO::delivery_mq with valid message queue handles.]*/
+        module_info->mq = MessageQueue_Create();
         if (module_info->mq == NULL)
         {
-            LogError("VECTOR_create failed");
+            LogError("MessageQueue_Create failed");
+            result = BROKER_ERROR;
+        }
+        else if ((module_info->delivery_mq = MessageQueue_Create()) == NULL)
+        {
+            LogError("MessageQueue_Create failed");
+            MessageQueue_Destroy(module_info->mq);
             result = BROKER_ERROR;
         }
         else
@@ -248,24 +478,75 @@ static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* m
             if (module_info->mq_lock == NULL)
             {
                 LogError("Lock_Init failed");
-                VECTOR_destroy(module_info->mq);
+                MessageQueue_Destroy(module_info->delivery_mq);
+                MessageQueue_Destroy(module_info->mq);
                 result = BROKER_ERROR;
             }
             else
             {
-                /*Codes_SRS_BCAST_BROKER_13_100: [The function shall initialize BROKER_MODULEINFO::mq_cond with a valid condition handle.]*/
-                module_info->mq_cond = Condition_Init();
-                if (module_info->mq_cond == NULL)
+                /*Codes_SRS_BCAST_BROKER_13_135: [The function shall copy the queue options to BROKER_MODULEINFO::queue_options, leaving the queue unbounded when `options` is NULL.]*/
+                if (options == NULL)
+                {
+                    module_info->queue_options.max_depth = 0;
+                    module_info->queue_options.max_bytes = 0;
+                    module_info->queue_options.policy = BROKER_QUEUE_DROP_NEWEST;
+                    module_info->queue_options.block_timeout_ms = 0;
+                    module_info->queue_options.max_batch_size = 0;
+                    module_info->queue_options.inline_delivery = 0;
+                }
+                else
+                {
+                    module_info->queue_options = options->queue;
+                }
+                /*Codes_SRS_BCAST_BROKER_13_180: [The function shall copy the thread options of `options`, when `options` is not NULL, to BROKER_MODULEINFO::thread_options, and set them to 0 otherwise.]*/
+                if (options == NULL)
+                {
+                    (void)memset(&module_info->thread_options, 0, sizeof(BROKER_THREAD_OPTIONS));
+                }
+                else
+                {
+                    module_info->thread_options = options->thread;
+                }
+                module_info->mq_bytes = 0;
+                module_info->space_cond = NULL;
+                module_info->removing = false;
+                /*Codes_SRS_BCAST_BROKER_13_164: [The function shall set BROKER_MODULEINFO::queue_counters and BROKER_MODULEINFO::delivery_counters to 0.]*/
+                (void)memset(&module_info->queue_counters, 0, sizeof(BROKER_QUEUE_COUNTERS));
+                (void)memset(&module_info->delivery_counters, 0, sizeof(BROKER_DELIVERY_COUNTERS));
+
+                /*Codes_SRS_BCAST_BROKER_13_136: [If the queue is bounded and the policy is BROKER_QUEUE_BLOCK, the function shall initialize BROKER_MODULEINFO::space_cond with a valid condition handle.]*/
+                if (module_info->queue_options.policy == BROKER_QUEUE_BLOCK &&
+                    (module_info->queue_options.max_depth != 0 || module_info->queue_options.max_bytes != 0) &&
+                    (module_info->space_cond = Condition_Init()) == NULL)
                 {
                     LogError("Condition_Init failed");
                     Lock_Deinit(module_info->mq_lock);
-                    VECTOR_destroy(module_info->mq);
+                    MessageQueue_Destroy(module_info->delivery_mq);
+                    MessageQueue_Destroy(module_info->mq);
+                    result = BROKER_ERROR;
+                }
+                /*Codes_SRS_BCAST_BROKER_13_145: [If the module implements Module_ReceiveBatch, the function shall allocate BROKER_MODULEINFO::batch with room for queue_options.max_batch_size message handles, or a default number of handles when it is 0.]*/
+                else if (init_batch(module_info) != 0)
+                {
+                    LogError("unable to allocate the module's batch");
+                    if (module_info->space_cond != NULL)
+                    {
+                        Condition_Deinit(module_info->space_cond);
+                    }
+                    Lock_Deinit(module_info->mq_lock);
+                    MessageQueue_Destroy(module_info->delivery_mq);
+                    MessageQueue_Destroy(module_info->mq);
                     result = BROKER_ERROR;
                 }
                 else
                 {
                     /*Codes_SRS_BCAST_BROKER_13_101: [The function shall assign 0 to BROKER_MODULEINFO::quit_worker.]*/
                     module_info->quit_worker = 0;
+
+                    /*Codes_SRS_BCAST_BROKER_13_114: [The function shall assign NULL to BROKER_MODULEINFO::routes and 0 to BROKER_MODULEINFO::inbound_routes.]*/
+                    module_info->routes = NULL;
+                    module_info->inbound_routes = 0;
+                    module_info->strand = NULL;
                     result = BROKER_OK;
                 }
             }
@@ -278,24 +559,52 @@ static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* m
 static void deinit_module(BROKER_MODULEINFO* module_info)
 {
     /*Codes_SRS_BCAST_BROKER_13_057: [The function shall free all members of the MODULE_INFO object.]*/
-    VECTOR_destroy(module_info->mq);
-    Condition_Deinit(module_info->mq_cond);
+    MessageQueue_Destroy(module_info->mq);
+    MessageQueue_Destroy(module_info->delivery_mq);
+    if (module_info->space_cond != NULL)
+    {
+        Condition_Deinit(module_info->space_cond);
+    }
     Lock_Deinit(module_info->mq_lock);
+    if (module_info->batch != NULL)
+    {
+        free(module_info->batch);
+    }
     free(module_info->module);
 }
 
-static BROKER_RESULT start_module(BROKER_MODULEINFO* module_info)
+/*destroys the routes of a module that no routing snapshot references anymore*/
+static void destroy_routes(BROKER_MODULEINFO* module_info)
+{
+    if (module_info->routes != NULL)
+    {
+        size_t route_count = VECTOR_size(module_info->routes);
+        size_t i;
+        for (i = 0; i < route_count; i++)
+        {
+            BROKER_ROUTE* route = (BROKER_ROUTE*)VECTOR_element(module_info->routes, i);
+            if (route->link_count != 0)
+            {
+                route->sink->inbound_routes--;
+            }
+            /*Codes_SRS_BCAST_BROKER_13_163: [The broker shall destroy the filter of a route by calling LinkFilter_Destroy only after it has installed a routing snapshot that does not reference the route.]*/
+            LinkFilter_Destroy(route->filter);
+            free(route->counters);
+        }
+        VECTOR_destroy(module_info->routes);
+        module_info->routes = NULL;
+    }
+}
+
+static BROKER_RESULT start_module(BROKER_HANDLE_DATA* broker_data, BROKER_MODULEINFO* module_info)
 {
     BROKER_RESULT result;
 
-    /*Codes_SRS_BCAST_BROKER_13_102: [The function shall create a new thread for the module by calling ThreadAPI_Create using module_publish_worker as the thread callback and using the newly allocated BROKER_MODULEINFO object as the thread context.*/
-    if (ThreadAPI_Create(
-        &(module_info->thread),
-        module_publish_worker,
-        (void*)module_info
-        ) != THREADAPI_OK)
+    /*Codes_SRS_BCAST_BROKER_13_102: [The function shall create a strand for the module on BROKER_HANDLE_DATA::worker_pool by calling WorkerPool_CreateStrand using module_publish_worker as the strand function and using the newly allocated BROKER_MODULEINFO object as the strand context.]*/
+    module_info->strand = WorkerPool_CreateStrand(broker_data->worker_pool, module_publish_worker, (void*)module_info);
+    if (module_info->strand == NULL)
     {
-        LogError("ThreadAPI_Create failed");
+        LogError("WorkerPool_CreateStrand failed");
         result = BROKER_ERROR;
     }
     else
@@ -306,17 +615,15 @@ static BROKER_RESULT start_module(BROKER_MODULEINFO* module_info)
     return result;
 }
 
-/*stop module means: stop the thread that feeds messages to Module_Receive function + deletion of all queued messages */
-/*returns 0 if success, otherwise __LINE__*/
-static int stop_module(BROKER_MODULEINFO* module_info)
+/*stop module means: stop the strand that feeds messages to Module_Receive function + deletion of all queued messages */
+static void stop_module(BROKER_MODULEINFO* module_info)
 {
-    int thread_result, result;
-    size_t len, i;
+    MESSAGE_HANDLE msg;
     /*Codes_SRS_BCAST_BROKER_02_001: [ Broker_RemoveModule shall lock `BROKER_MODULEINFO::mq_lock`. ]*/
     if (Lock(module_info->mq_lock) != LOCK_OK)
     {
+        /*Codes_SRS_BCAST_BROKER_02_002: [ If locking fails, the function shall still assign 1 to BROKER_MODULEINFO::quit_worker and destroy the strand. ]*/
         module_info->quit_worker = 1; /*at the cost of a data race, still try to stop the module*/
-        /*Codes_SRS_BCAST_BROKER_02_002: [ If locking fails, then terminating the thread shall not be attempted (signalling the condition and joining the thread). ]*/
         LogError("unable to lock mq_lock");
     }
     else
@@ -324,46 +631,166 @@ static int stop_module(BROKER_MODULEINFO* module_info)
         /*Codes_SRS_BCAST_BROKER_13_103: [The function shall assign 1 to BROKER_MODULEINFO::quit_worker.]*/
         module_info->quit_worker = 1;
 
-        /*Codes_SRS_BCAST_BROKER_17_001: [The function shall signal BROKER_MODULEINFO::mq_cond to release module from waiting.]*/
-        if (Condition_Post(module_info->mq_cond) != COND_OK)
+        /*Codes_SRS_BCAST_BROKER_02_003: [ Broker_RemoveModule shall then unlock BROKER_MODULEINFO::mq_lock. ]*/
+        if (Unlock(module_info->mq_lock) != LOCK_OK)
+        {
+            LogError("unable to unlock mq_lock");
+        }
+    }
+
+    /*Codes_SRS_BCAST_BROKER_13_104: [The function shall destroy BROKER_MODULEINFO::strand by calling WorkerPool_DestroyStrand, which waits for a delivery in progress to finish.]*/
+    WorkerPool_DestroyStrand(module_info->strand);
+
+    /*Codes_SRS_BCAST_BROKER_13_056: [If BROKER_MODULEINFO::mq is not empty then this function shall call Message_Destroy on every message still left in the collection.]*/
+    while ((msg = MessageQueue_Pop(module_info->mq)) != NULL)
+    {
+        Message_Destroy(msg);
+    }
+}
+
+/*makes the publishers waiting for room in the queue of a module being removed give up, so that they release the routing snapshot the removal waits for*/
+static void wake_blocked_publishers(BROKER_MODULEINFO* module_info)
+{
+    if (module_info->space_cond != NULL)
+    {
+        if (Lock(module_info->mq_lock) != LOCK_OK)
         {
-            LogError("Condition_Post failed for module at  item [%p] failed", module_info);
+            LogError("unable to lock mq_lock");
         }
         else
         {
-            /*all is fine, thread will eventually stop and be joined*/
+            module_info->removing = true;
+            /*the publisher woken signals the next one*/
+            if (Condition_Post(module_info->space_cond) != COND_OK)
+            {
+                LogError("Condition_Post failed for module [%p]", module_info);
+            }
+            (void)Unlock(module_info->mq_lock);
         }
+    }
+}
 
-        /*Codes_SRS_BCAST_BROKER_02_003: [ After signaling the condition, Broker_RemoveModule shall unlock BROKER_MODULEINFO::mq_lock. ]*/
-        if (Unlock(module_info->mq_lock) != LOCK_OK)
+/*returns true when the queue options cannot be honored*/
+static bool queue_options_are_invalid(const BROKER_MODULE_OPTIONS* options)
+{
+    return (options != NULL) &&
+        ((options->queue.policy != BROKER_QUEUE_DROP_NEWEST &&
+          options->queue.policy != BROKER_QUEUE_DROP_OLDEST &&
+          options->queue.policy != BROKER_QUEUE_BLOCK) ||
+         (options->queue.policy == BROKER_QUEUE_BLOCK && options->queue.block_timeout_ms == 0) ||
+         (options->queue.max_batch_size > SIZE_MAX / sizeof(MESSAGE_HANDLE)));
+}
+
+/*returns the value a module is found by in the routing snapshot*/
+static const void* get_module_key(const BROKER_MODULEINFO* module_info)
+{
+#ifdef UWP_BINDING
+    return (const void*)module_info->module->module_instance;
+#else
+    return (const void*)module_info->module->module_handle;
+#endif // UWP_BINDING
+}
+
+/*returns the number of routes of the module that are not being removed*/
+static size_t get_route_count(BROKER_MODULEINFO* module_info)
+{
+    size_t result = 0;
+    if (module_info->routes != NULL)
+    {
+        size_t route_count = VECTOR_size(module_info->routes);
+        size_t i;
+        for (i = 0; i < route_count; i++)
         {
-            LogError("unable to unlock mq_lock");
+            if (((BROKER_ROUTE*)VECTOR_element(module_info->routes, i))->link_count != 0)
+            {
+                result++;
+            }
         }
     }
+    return result;
+}
+
+/*builds a routing snapshot of the modules and their routes and installs it; the caller holds modules_lock; returns 0 on success*/
+static int update_routing_table(BROKER_HANDLE_DATA* broker_data)
+{
+    int result;
+    size_t module_count = 0;
+    size_t sink_count = 0;
+    LIST_ITEM_HANDLE current_module;
+    ROUTING_SNAPSHOT_HANDLE snapshot;
+
+    for (current_module = list_get_head_item(broker_data->modules);
+         current_module != NULL;
+         current_module = list_get_next_item(current_module))
+    {
+        BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)list_item_get_value(current_module);
+        module_count++;
+        sink_count += get_route_count(module_info);
+    }
 
-    /*Codes_SRS_BCAST_BROKER_13_104: [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]*/
-    if (ThreadAPI_Join(module_info->thread, &thread_result) != THREADAPI_OK)
+    /*Codes_SRS_BCAST_BROKER_13_153: [The broker shall rebuild its routing snapshot by calling RoutingSnapshot_Create and RoutingSnapshot_AddEntry with every module of BROKER_HANDLE_DATA::modules, in order, and the sinks of its routes, and install it by calling RoutingTable_Swap.]*/
+    snapshot = RoutingSnapshot_Create(module_count, sink_count);
+    if (snapshot == NULL)
     {
+        LogError("RoutingSnapshot_Create failed");
         result = __LINE__;
-        LogError("ThreadAPI_Join() returned an error.");
     }
     else
     {
         result = 0;
-    }
+        for (current_module = list_get_head_item(broker_data->modules);
+             current_module != NULL;
+             current_module = list_get_next_item(current_module))
+        {
+            BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)list_item_get_value(current_module);
+            ROUTING_SINK* sinks = RoutingSnapshot_AddEntry(snapshot, get_module_key(module_info), module_info, get_route_count(module_info));
+            if (sinks == NULL)
+            {
+                LogError("RoutingSnapshot_AddEntry failed for module [%p]", module_info);
+                result = __LINE__;
+                break;
+            }
+            else
+            {
+                size_t route_count = (module_info->routes == NULL) ? 0 : VECTOR_size(module_info->routes);
+                size_t i;
+                for (i = 0; i < route_count; i++)
+                {
+                    BROKER_ROUTE* route = (BROKER_ROUTE*)VECTOR_element(module_info->routes, i);
+                    if (route->link_count != 0)
+                    {
+                        sinks->sink = route->sink;
+                        sinks->filter = route->filter;
+                        sinks->counters = route->counters;
+                        /*the Broadcast broker always queues the messages for the workers*/
+                        sinks->inline_delivery = 0;
+                        sinks++;
+                    }
+                }
+            }
+        }
 
-    /*Codes_SRS_BCAST_BROKER_13_056: [If BROKER_MODULEINFO::mq is not empty then this function shall call Message_Destroy on every message still left in the collection.]*/
-    len = VECTOR_size(module_info->mq);
-    for (i = 0; i < len; i++)
-    {
-        // this MUST NOT be NULL
-        MESSAGE_HANDLE* msg = (MESSAGE_HANDLE*)VECTOR_element(module_info->mq, i);
-        Message_Destroy(*msg);
+        if (result != 0)
+        {
+            RoutingSnapshot_Destroy(snapshot);
+        }
+        else
+        {
+            /*RoutingTable_Swap returns once no publisher reads the previous snapshot*/
+            RoutingTable_Swap(broker_data->routing_table, snapshot);
+        }
     }
+
     return result;
 }
 
 BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
+{
+    /*Codes_SRS_BCAST_BROKER_13_137: [Broker_AddModule shall behave as Broker_AddModuleWithOptions called with NULL options.]*/
+    return Broker_AddModuleWithOptions(broker, module, NULL);
+}
+
+BROKER_RESULT Broker_AddModuleWithOptions(BROKER_HANDLE broker, const MODULE* module, const BROKER_MODULE_OPTIONS* options)
 {
     BROKER_RESULT result;
 
@@ -373,6 +800,13 @@ BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
         result = BROKER_INVALIDARG;
         LogError("invalid parameter (NULL).");
     }
+    /*Codes_SRS_BCAST_BROKER_13_147: [If `options` is not NULL and its max_batch_size is too large to allocate BROKER_MODULEINFO::batch, the function shall return BROKER_INVALIDARG.]*/
+    /*Codes_SRS_BCAST_BROKER_13_138: [If `options` is not NULL and its queue policy is not a BROKER_QUEUE_POLICY value, or is BROKER_QUEUE_BLOCK with a block_timeout_ms of 0, the function shall return BROKER_INVALIDARG.]*/
+    else if (queue_options_are_invalid(options))
+    {
+        result = BROKER_INVALIDARG;
+        LogError("invalid queue options.");
+    }
 #ifdef UWP_BINDING
 	/*Codes_SRS_BCAST_BROKER_99_015: [If `module_instance` is `NULL` the function shall return `BROKER_INVALIDARG`.]*/
 	else if (module->module_instance == NULL)
@@ -398,7 +832,7 @@ BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
         }
         else
         {
-            if (init_module(module_info, module) != BROKER_OK)
+            if (init_module(module_info, module, options) != BROKER_OK)
             {
                 /*Codes_SRS_BCAST_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
                 LogError("start_module failed");
@@ -432,7 +866,7 @@ BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
                     }
                     else
                     {
-                        if (start_module(module_info) != BROKER_OK)
+                        if (start_module(broker_data, module_info) != BROKER_OK)
                         {
                             LogError("start_module failed");
                             deinit_module(module_info);
@@ -440,6 +874,16 @@ BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
                             free(module_info);
                             result = BROKER_ERROR;
                         }
+                        /*Codes_SRS_BCAST_BROKER_13_154: [Broker_AddModule shall rebuild the broker's routing snapshot, and remove and free the module and return BROKER_ERROR if it fails.]*/
+                        else if (update_routing_table(broker_data) != 0)
+                        {
+                            LogError("unable to update the routing table");
+                            list_remove(broker_data->modules, moduleListItem);
+                            stop_module(module_info);
+                            deinit_module(module_info);
+                            free(module_info);
+                            result = BROKER_ERROR;
+                        }
                         else
                         {
                             /*Codes_SRS_BCAST_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
@@ -468,20 +912,119 @@ static bool find_module_predicate(LIST_ITEM_HANDLE list_item, const void* value)
 #endif // UWP_BINDING
 }
 
-BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* module)
+static bool find_module_by_handle_predicate(LIST_ITEM_HANDLE list_item, const void* value)
 {
-    /*Codes_SRS_BCAST_BROKER_13_048: [If `broker` or `module` is NULL the function shall return BROKER_INVALIDARG.]*/
-    BROKER_RESULT result;
-    if (broker == NULL || module == NULL)
+    BROKER_MODULEINFO* element = (BROKER_MODULEINFO*)list_item_get_value(list_item);
+#ifdef UWP_BINDING
+    return (const void*)element->module->module_instance == value;
+#else
+    return (const void*)element->module->module_handle == value;
+#endif // UWP_BINDING
+}
+
+static BROKER_MODULEINFO* broker_locate_handle(BROKER_HANDLE_DATA* broker_data, MODULE_HANDLE handle)
+{
+    BROKER_MODULEINFO* result;
+    LIST_ITEM_HANDLE module_info_item = list_find(broker_data->modules, find_module_by_handle_predicate, handle);
+    if (module_info_item == NULL)
     {
-        result = BROKER_INVALIDARG;
-        LogError("invalid parameter (NULL).");
+        result = NULL;
     }
     else
     {
-        /*Codes_SRS_BCAST_BROKER_13_088: [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]*/
-        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
-        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        result = (BROKER_MODULEINFO*)list_item_get_value(module_info_item);
+    }
+    return result;
+}
+
+static BROKER_ROUTE* find_route(BROKER_MODULEINFO* source_info, BROKER_MODULEINFO* sink_info)
+{
+    BROKER_ROUTE* result = NULL;
+    if (source_info->routes != NULL)
+    {
+        size_t route_count = VECTOR_size(source_info->routes);
+        size_t i;
+        for (i = 0; i < route_count; i++)
+        {
+            BROKER_ROUTE* route = (BROKER_ROUTE*)VECTOR_element(source_info->routes, i);
+            if (route->sink == sink_info)
+            {
+                result = route;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+/*erases the routes of the module that are being removed and destroys their filters; the caller holds modules_lock and has installed a routing snapshot without them*/
+static void erase_removed_routes(BROKER_MODULEINFO* module_info)
+{
+    if (module_info->routes != NULL)
+    {
+        size_t i = 0;
+        while (i < VECTOR_size(module_info->routes))
+        {
+            BROKER_ROUTE* route = (BROKER_ROUTE*)VECTOR_element(module_info->routes, i);
+            if (route->link_count == 0)
+            {
+                /*Codes_SRS_BCAST_BROKER_13_163: [The broker shall destroy the filter of a route by calling LinkFilter_Destroy only after it has installed a routing snapshot that does not reference the route.]*/
+                LinkFilter_Destroy(route->filter);
+                free(route->counters);
+                VECTOR_erase(module_info->routes, route, 1);
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+}
+
+/*marks every route that leads to sink_info as being removed; the caller holds modules_lock*/
+static void remove_routes_to_module(BROKER_HANDLE_DATA* broker_data, BROKER_MODULEINFO* sink_info)
+{
+    LIST_ITEM_HANDLE current_module;
+    for (current_module = list_get_head_item(broker_data->modules);
+         current_module != NULL && sink_info->inbound_routes > 0;
+         current_module = list_get_next_item(current_module))
+    {
+        BROKER_MODULEINFO* source_info = (BROKER_MODULEINFO*)list_item_get_value(current_module);
+        BROKER_ROUTE* route = find_route(source_info, sink_info);
+        if (route != NULL)
+        {
+            route->link_count = 0;
+            sink_info->inbound_routes--;
+        }
+    }
+}
+
+/*erases the routes of every module that are being removed; the caller holds modules_lock*/
+static void erase_removed_routes_of_modules(BROKER_HANDLE_DATA* broker_data)
+{
+    LIST_ITEM_HANDLE current_module;
+    for (current_module = list_get_head_item(broker_data->modules);
+         current_module != NULL;
+         current_module = list_get_next_item(current_module))
+    {
+        erase_removed_routes((BROKER_MODULEINFO*)list_item_get_value(current_module));
+    }
+}
+
+BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* module)
+{
+    /*Codes_SRS_BCAST_BROKER_13_048: [If `broker` or `module` is NULL the function shall return BROKER_INVALIDARG.]*/
+    BROKER_RESULT result;
+    if (broker == NULL || module == NULL)
+    {
+        result = BROKER_INVALIDARG;
+        LogError("invalid parameter (NULL).");
+    }
+    else
+    {
+        /*Codes_SRS_BCAST_BROKER_13_088: [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]*/
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
         {
             /*Codes_SRS_BCAST_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
             LogError("Lock on broker_data->modules_lock failed");
@@ -501,21 +1044,43 @@ BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* module)
             else
             {
                 BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)list_item_get_value(module_info_item);
-                if (stop_module(module_info) == 0)
+                bool has_inbound_routes = (module_info->inbound_routes > 0);
+
+                /*Codes_SRS_BCAST_BROKER_13_115: [The function shall remove every route that has the module as a source or as a sink.]*/
+                if (has_inbound_routes)
                 {
-                    deinit_module(module_info);
+                    remove_routes_to_module(broker_data, module_info);
+                }
+
+                /*Codes_SRS_BCAST_BROKER_13_052: [The function shall remove the module from BROKER_HANDLE_DATA::modules.]*/
+                list_remove(broker_data->modules, module_info_item);
+
+                /*Codes_SRS_BCAST_BROKER_13_187: [If BROKER_MODULEINFO::space_cond is not NULL, Broker_RemoveModule shall mark the module as being removed under BROKER_MODULEINFO::mq_lock and signal BROKER_MODULEINFO::space_cond before it rebuilds the routing snapshot, so that the publishers waiting for room in its queue return BROKER_BUSY instead of holding the snapshot until block_timeout_ms elapses.]*/
+                wake_blocked_publishers(module_info);
+
+                /*Codes_SRS_BCAST_BROKER_13_155: [Broker_RemoveModule shall rebuild the broker's routing snapshot before stopping the module, so that no publisher references the module when it is freed.]*/
+                if (update_routing_table(broker_data) != 0)
+                {
+                    /*Codes_SRS_BCAST_BROKER_13_156: [If rebuilding the routing snapshot fails, Broker_RemoveModule shall install an empty routing snapshot by calling RoutingTable_Swap with NULL, still remove the module and return BROKER_ERROR.]*/
+                    LogError("unable to update the routing table, no message is routed until the next change");
+                    RoutingTable_Swap(broker_data->routing_table, NULL);
+                    result = BROKER_ERROR;
                 }
                 else
                 {
-                    LogError("unable to stop module");
+                    /*Codes_SRS_BCAST_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                    result = BROKER_OK;
                 }
 
-                /*Codes_SRS_BCAST_BROKER_13_052: [The function shall remove the module from BROKER_HANDLE_DATA::modules.]*/
-                list_remove(broker_data->modules, module_info_item);
+                /*the routes are destroyed once no snapshot references them*/
+                if (has_inbound_routes)
+                {
+                    erase_removed_routes_of_modules(broker_data);
+                }
+                destroy_routes(module_info);
+                stop_module(module_info);
+                deinit_module(module_info);
                 free(module_info);
-
-                /*Codes_SRS_BCAST_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                result = BROKER_OK;
             }
 
             /*Codes_SRS_BCAST_BROKER_13_054: [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]*/
@@ -541,6 +1106,10 @@ static void broker_decrement_ref(BROKER_HANDLE broker)
                 LogError("WARNING: There are still active modules connected to the broker and the broker is being destroyed.");
             }
 
+            /*Codes_SRS_BCAST_BROKER_13_144: [Broker_Destroy shall destroy BROKER_HANDLE_DATA::worker_pool by calling WorkerPool_Destroy.]*/
+            WorkerPool_Destroy(broker_data->worker_pool);
+            /*Codes_SRS_BCAST_BROKER_13_159: [Broker_Destroy shall destroy BROKER_HANDLE_DATA::routing_table by calling RoutingTable_Destroy.]*/
+            RoutingTable_Destroy(broker_data->routing_table);
             list_destroy(broker_data->modules);
             Lock_Deinit(broker_data->modules_lock);
             free(broker_data);
@@ -551,16 +1120,206 @@ static void broker_decrement_ref(BROKER_HANDLE broker)
         LogError("broker handle is NULL");
     }
 }
+
+/*allocates the zeroed traffic counters of a new route*/
+static BROKER_LINK_COUNTERS* create_link_counters(void)
+{
+    BROKER_LINK_COUNTERS* result = (BROKER_LINK_COUNTERS*)malloc(sizeof(BROKER_LINK_COUNTERS));
+    if (result == NULL)
+    {
+        LogError("malloc failed");
+    }
+    else
+    {
+        (void)memset(result, 0, sizeof(BROKER_LINK_COUNTERS));
+    }
+    return result;
+}
+
 BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
 {
-    /*Codes_SRS_BCAST_BROKER_17_003: [ Broker_AddLink shall return BROKER_OK. ]*/
-    return BROKER_OK;
+    BROKER_RESULT result;
+    /*Codes_SRS_BCAST_BROKER_13_116: [If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_AddLink shall return BROKER_INVALIDARG.]*/
+    if (broker == NULL || link == NULL || link->module_sink_handle == NULL || link->module_source_handle == NULL)
+    {
+        LogError("Broker_AddLink, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BCAST_BROKER_13_117: [Broker_AddLink shall lock the modules_lock.]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BCAST_BROKER_13_118: [Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR.]*/
+            LogError("Broker_AddLink, Lock on broker_data->modules_lock failed");
+            result = BROKER_ADD_LINK_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_BCAST_BROKER_13_119: [Broker_AddLink shall find the BROKER_MODULEINFO for link->module_sink_handle and link->module_source_handle.]*/
+            BROKER_MODULEINFO* sink_info = broker_locate_handle(broker_data, link->module_sink_handle);
+            BROKER_MODULEINFO* source_info = broker_locate_handle(broker_data, link->module_source_handle);
+
+            if (sink_info == NULL || source_info == NULL)
+            {
+                /*Codes_SRS_BCAST_BROKER_13_118: [Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR.]*/
+                LogError("Link->sink or link->source is not attached to the broker");
+                result = BROKER_ADD_LINK_ERROR;
+            }
+            else
+            {
+                BROKER_ROUTE* route = find_route(source_info, sink_info);
+                if (route != NULL)
+                {
+                    if (!LinkFilter_IsSameAs(route->filter, link->filter))
+                    {
+                        /*Codes_SRS_BCAST_BROKER_13_160: [If the route from source to sink already exists and LinkFilter_IsSameAs tells that its filter is not link->filter, Broker_AddLink shall return BROKER_ADD_LINK_ERROR.]*/
+                        LogError("the link already exists with another filter");
+                        result = BROKER_ADD_LINK_ERROR;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_BCAST_BROKER_13_120: [If the route from source to sink already exists, Broker_AddLink shall increment its link count.]*/
+                        /*the routes of the snapshot do not change, it is not rebuilt*/
+                        route->link_count++;
+                        result = BROKER_OK;
+                    }
+                }
+                else
+                {
+                    /*Codes_SRS_BCAST_BROKER_13_121: [Broker_AddLink shall create BROKER_MODULEINFO::routes of the source if it does not exist yet.]*/
+                    if (source_info->routes == NULL &&
+                        (source_info->routes = VECTOR_create(sizeof(BROKER_ROUTE))) == NULL)
+                    {
+                        /*Codes_SRS_BCAST_BROKER_13_118: [Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR.]*/
+                        LogError("VECTOR_create failed");
+                        result = BROKER_ADD_LINK_ERROR;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_BCAST_BROKER_13_122: [Broker_AddLink shall append a new route to the sink to BROKER_MODULEINFO::routes of the source.]*/
+                        BROKER_ROUTE new_route;
+                        new_route.sink = sink_info;
+                        new_route.link_count = 1;
+                        /*Codes_SRS_BCAST_BROKER_13_161: [If link->filter is not NULL, Broker_AddLink shall compile it for the new route by calling LinkFilter_Create.]*/
+                        new_route.filter = (link->filter == NULL) ? NULL : LinkFilter_Create(link->filter);
+                        if (link->filter != NULL && new_route.filter == NULL)
+                        {
+                            /*Codes_SRS_BCAST_BROKER_13_118: [Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR.]*/
+                            LogError("unable to create the filter of the link");
+                            result = BROKER_ADD_LINK_ERROR;
+                        }
+                        /*Codes_SRS_BCAST_BROKER_13_174: [Broker_AddLink shall allocate zeroed BROKER_LINK_COUNTERS for the new route.]*/
+                        else if ((new_route.counters = create_link_counters()) == NULL)
+                        {
+                            /*Codes_SRS_BCAST_BROKER_13_118: [Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR.]*/
+                            LogError("unable to create the counters of the link");
+                            LinkFilter_Destroy(new_route.filter);
+                            result = BROKER_ADD_LINK_ERROR;
+                        }
+                        else if (VECTOR_push_back(source_info->routes, &new_route, 1) != 0)
+                        {
+                            /*Codes_SRS_BCAST_BROKER_13_118: [Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR.]*/
+                            LogError("Unable to make link in Broker");
+                            LinkFilter_Destroy(new_route.filter);
+                            free(new_route.counters);
+                            result = BROKER_ADD_LINK_ERROR;
+                        }
+                        /*Codes_SRS_BCAST_BROKER_13_157: [After appending a new route, Broker_AddLink shall rebuild the broker's routing snapshot, and remove the route and return BROKER_ADD_LINK_ERROR if it fails.]*/
+                        else if (update_routing_table(broker_data) != 0)
+                        {
+                            LogError("unable to update the routing table");
+                            VECTOR_erase(source_info->routes, VECTOR_back(source_info->routes), 1);
+                            LinkFilter_Destroy(new_route.filter);
+                            free(new_route.counters);
+                            result = BROKER_ADD_LINK_ERROR;
+                        }
+                        else
+                        {
+                            sink_info->inbound_routes++;
+                            result = BROKER_OK;
+                        }
+                    }
+                }
+            }
+            /*Codes_SRS_BCAST_BROKER_13_123: [Broker_AddLink shall unlock the modules_lock.]*/
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
 }
 
 BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
 {
-    /*Codes_SRS_BCAST_BROKER_17_004: [ Broker_RemoveLink shall return BROKER_OK. ]*/
-    return BROKER_OK;    
+    BROKER_RESULT result;
+    /*Codes_SRS_BCAST_BROKER_13_124: [If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_RemoveLink shall return BROKER_INVALIDARG.]*/
+    if (broker == NULL || link == NULL || link->module_sink_handle == NULL || link->module_source_handle == NULL)
+    {
+        LogError("Broker_RemoveLink, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BCAST_BROKER_13_125: [Broker_RemoveLink shall lock the modules_lock.]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BCAST_BROKER_13_126: [Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR.]*/
+            LogError("Broker_RemoveLink, Lock on broker_data->modules_lock failed");
+            result = BROKER_REMOVE_LINK_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_BCAST_BROKER_13_127: [Broker_RemoveLink shall find the BROKER_MODULEINFO for link->module_sink_handle and link->module_source_handle.]*/
+            BROKER_MODULEINFO* sink_info = broker_locate_handle(broker_data, link->module_sink_handle);
+            BROKER_MODULEINFO* source_info = broker_locate_handle(broker_data, link->module_source_handle);
+            BROKER_ROUTE* route;
+
+            if (sink_info == NULL || source_info == NULL)
+            {
+                /*Codes_SRS_BCAST_BROKER_13_126: [Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR.]*/
+                LogError("Link->sink or link->source is not attached to the broker");
+                result = BROKER_REMOVE_LINK_ERROR;
+            }
+            else if ((route = find_route(source_info, sink_info)) == NULL)
+            {
+                /*Codes_SRS_BCAST_BROKER_13_126: [Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR.]*/
+                LogError("Link does not exist in Broker");
+                result = BROKER_REMOVE_LINK_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BCAST_BROKER_13_128: [Broker_RemoveLink shall decrement the link count of the route and remove the route when the count reaches 0.]*/
+                route->link_count--;
+                if (route->link_count != 0)
+                {
+                    result = BROKER_OK;
+                }
+                else
+                {
+                    sink_info->inbound_routes--;
+
+                    /*Codes_SRS_BCAST_BROKER_13_158: [When the route is removed, Broker_RemoveLink shall rebuild the broker's routing snapshot; if that fails it shall install an empty routing snapshot by calling RoutingTable_Swap with NULL and return BROKER_REMOVE_LINK_ERROR.]*/
+                    if (update_routing_table(broker_data) != 0)
+                    {
+                        LogError("unable to update the routing table, no message is routed until the next change");
+                        RoutingTable_Swap(broker_data->routing_table, NULL);
+                        result = BROKER_REMOVE_LINK_ERROR;
+                    }
+                    else
+                    {
+                        result = BROKER_OK;
+                    }
+
+                    erase_removed_routes(source_info);
+                }
+            }
+            /*Codes_SRS_BCAST_BROKER_13_129: [Broker_RemoveLink shall unlock the modules_lock.]*/
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
 }
 
 extern void Broker_Destroy(BROKER_HANDLE broker)
@@ -574,6 +1333,363 @@ extern void Broker_DecRef(BROKER_HANDLE broker)
     broker_decrement_ref(broker);
 }
 
+/*returns the number of bytes of content of a message*/
+static size_t get_message_size(MESSAGE_HANDLE message)
+{
+    const CONSTBUFFER* content = Message_GetContent(message);
+    return (content == NULL) ? 0 : content->size;
+}
+
+/*returns true when a message of 'message_size' bytes does not fit in the module's queue; the caller holds mq_lock*/
+static bool is_queue_full(BROKER_MODULEINFO* module_info, size_t message_size)
+{
+    bool result;
+    if (module_info->queue_options.max_depth == 0 && module_info->queue_options.max_bytes == 0)
+    {
+        /*an unbounded queue is never full*/
+        result = false;
+    }
+    else
+    {
+        size_t depth = MessageQueue_Size(module_info->mq);
+        result = (depth > 0) &&
+            ((module_info->queue_options.max_depth != 0 && depth >= module_info->queue_options.max_depth) ||
+             (module_info->queue_options.max_bytes != 0 && module_info->mq_bytes + message_size > module_info->queue_options.max_bytes));
+    }
+    return result;
+}
+
+/*appends a clone of the message to the module's queue, applying the queue's bounds; the caller holds mq_lock*/
+static BROKER_RESULT enqueue_message(BROKER_MODULEINFO* module_info, BROKER_LINK_COUNTERS* link_counters, MESSAGE_HANDLE message)
+{
+    BROKER_RESULT result;
+    size_t message_size = get_message_size(message);
+    bool is_full = is_queue_full(module_info, message_size);
+    bool schedule_failed = false;
+
+    if (is_full && module_info->queue_options.policy == BROKER_QUEUE_DROP_OLDEST)
+    {
+        /*Codes_SRS_BCAST_BROKER_13_139: [If the message does not fit in BROKER_MODULEINFO::mq and the policy is BROKER_QUEUE_DROP_OLDEST, the function shall destroy the oldest queued messages until it fits.]*/
+        do
+        {
+            MESSAGE_HANDLE oldest = MessageQueue_Pop(module_info->mq);
+            module_info->mq_bytes -= get_message_size(oldest);
+            module_info->queue_counters.dropped++;
+            Message_Destroy(oldest);
+        } while (is_queue_full(module_info, message_size));
+        is_full = false;
+    }
+    else if (is_full && module_info->queue_options.policy == BROKER_QUEUE_BLOCK)
+    {
+        /*the strand is otherwise only scheduled once the messages are appended, so an idle module would not make room*/
+        /*Codes_SRS_BCAST_BROKER_13_185: [Before it waits, the function shall schedule BROKER_MODULEINFO::strand by calling WorkerPool_Schedule, so that the module drains the messages already queued, and shall not wait if that fails.]*/
+        if (WorkerPool_Schedule(module_info->strand) != 0)
+        {
+            LogError("WorkerPool_Schedule failed for module [%p]", module_info);
+            schedule_failed = true;
+        }
+        else
+        {
+            /*Codes_SRS_BCAST_BROKER_13_140: [If the message does not fit in BROKER_MODULEINFO::mq and the policy is BROKER_QUEUE_BLOCK, the function shall wait on BROKER_MODULEINFO::space_cond until the message fits, the module is being removed or block_timeout_ms has elapsed since it started waiting.]*/
+            uint64_t deadline = BrokerStatistics_GetTime() + (uint64_t)module_info->queue_options.block_timeout_ms * 1000;
+            int timeout_ms = (int)module_info->queue_options.block_timeout_ms;
+            while (is_full && !module_info->removing && timeout_ms > 0)
+            {
+                COND_RESULT wait_result = Condition_Wait(module_info->space_cond, module_info->mq_lock, timeout_ms);
+                is_full = is_queue_full(module_info, message_size);
+                if (wait_result != COND_OK)
+                {
+                    if (wait_result != COND_TIMEOUT)
+                    {
+                        LogError("Condition_Wait failed for module [%p]", module_info);
+                    }
+                    break;
+                }
+                else
+                {
+                    /*the wakeup may be spurious or the room taken by another publisher*/
+                    uint64_t now = BrokerStatistics_GetTime();
+                    timeout_ms = (now >= deadline) ? 0 : (int)((deadline - now + 999) / 1000);
+                }
+            }
+
+            if (is_full && module_info->removing)
+            {
+                /*Codes_SRS_BCAST_BROKER_13_188: [If the module is being removed, the function shall signal BROKER_MODULEINFO::space_cond again, so that the next publisher waiting on it gives up as well.]*/
+                if (Condition_Post(module_info->space_cond) != COND_OK)
+                {
+                    LogError("Condition_Post failed for module [%p]", module_info);
+                }
+            }
+        }
+    }
+    else
+    {
+        /*the message fits or is refused right away*/
+    }
+
+    if (schedule_failed)
+    {
+        /*Codes_SRS_BCAST_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+        module_info->queue_counters.dropped++;
+        result = BROKER_ERROR;
+    }
+    else if (is_full)
+    {
+        /*Codes_SRS_BCAST_BROKER_13_141: [If the message still does not fit in BROKER_MODULEINFO::mq, the function shall not enqueue it and shall return BROKER_BUSY.]*/
+        module_info->queue_counters.dropped++;
+        result = BROKER_BUSY;
+    }
+    else
+    {
+        /*Codes_SRS_BCAST_BROKER_13_034: [The function shall then append message to BROKER_MODULEINFO::mq by calling Message_Clone and MessageQueue_Push.]*/
+        MESSAGE_HANDLE msg = Message_Clone(message);
+        if (MessageQueue_Push(module_info->mq, msg) != 0)
+        {
+            /*Codes_SRS_BCAST_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+            LogError("MessageQueue_Push failed for module [%p]", module_info);
+            Message_Destroy(msg);
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_BCAST_BROKER_13_167: [The function shall count the messages it appends, their bytes, the messages it drops and the highest depth of BROKER_MODULEINFO::mq in BROKER_MODULEINFO::queue_counters, and note when a message is appended to an empty queue.]*/
+            size_t depth = MessageQueue_Size(module_info->mq);
+            if (depth == 1)
+            {
+                module_info->queue_counters.oldest_enqueue_time = BrokerStatistics_GetTime();
+            }
+            if (depth > module_info->queue_counters.high_water_mark)
+            {
+                module_info->queue_counters.high_water_mark = depth;
+            }
+            module_info->queue_counters.enqueued++;
+            module_info->queue_counters.enqueued_bytes += message_size;
+            module_info->mq_bytes += message_size;
+            if (link_counters != NULL)
+            {
+                /*Codes_SRS_BCAST_BROKER_13_175: [When it publishes over a route, the function shall count the messages it appends and their bytes in the BROKER_LINK_COUNTERS of the route, and the time it appended the last of them.]*/
+                link_counters->messages++;
+                link_counters->bytes += message_size;
+            }
+            result = BROKER_OK;
+        }
+    }
+
+    return result;
+}
+
+/*an error publishing to any module wins over a module being busy*/
+static BROKER_RESULT merge_publish_result(BROKER_RESULT result, BROKER_RESULT module_result)
+{
+    BROKER_RESULT merged;
+    if (result == BROKER_ERROR || module_result == BROKER_ERROR)
+    {
+        merged = BROKER_ERROR;
+    }
+    else if (result == BROKER_BUSY || module_result == BROKER_BUSY)
+    {
+        merged = BROKER_BUSY;
+    }
+    else
+    {
+        merged = BROKER_OK;
+    }
+    return merged;
+}
+
+/*prepares the messages to be tested by the filters of the routes of source_entry, returns NULL when no route has a filter or the messages cannot be prepared*/
+static LINK_FILTER_MESSAGE* init_filter_messages(const ROUTING_ENTRY* source_entry, const MESSAGE_HANDLE* messages, size_t message_count, LINK_FILTER_MESSAGE* single_filter_message)
+{
+    LINK_FILTER_MESSAGE* result = NULL;
+    size_t i;
+    for (i = 0; i < source_entry->sink_count; i++)
+    {
+        if (source_entry->sinks[i].filter != NULL)
+        {
+            break;
+        }
+    }
+
+    if (i < source_entry->sink_count)
+    {
+        result = (message_count == 1) ?
+            single_filter_message :
+            (LINK_FILTER_MESSAGE*)malloc(message_count * sizeof(LINK_FILTER_MESSAGE));
+        if (result == NULL)
+        {
+            /*the filters look the properties up for every route*/
+            LogError("unable to allocate the filter messages of a batch of %zu messages", message_count);
+        }
+        else
+        {
+            for (i = 0; i < message_count; i++)
+            {
+                LinkFilter_InitMessage(&result[i], messages[i]);
+            }
+        }
+    }
+    return result;
+}
+
+/*returns nonzero when message i passes filter, reusing what the filters of the other routes learned about it when filter_messages is not NULL*/
+static int passes_filter(LINK_FILTER_HANDLE filter, LINK_FILTER_MESSAGE* filter_messages, const MESSAGE_HANDLE* messages, size_t i)
+{
+    return (filter == NULL) ||
+        ((filter_messages == NULL) ? LinkFilter_Matches(filter, messages[i]) : LinkFilter_MatchesMessage(filter, &filter_messages[i]));
+}
+
+/*appends clones of the messages that pass filter to the module's queue, counts them in link_counters unless it is NULL and schedules the module's strand once*/
+static BROKER_RESULT publish_to_module(BROKER_MODULEINFO* module_info, LINK_FILTER_HANDLE filter, LINK_FILTER_MESSAGE* filter_messages, BROKER_LINK_COUNTERS* link_counters, const MESSAGE_HANDLE* messages, size_t message_count)
+{
+    BROKER_RESULT result;
+    size_t first_match = 0;
+
+    /*Codes_SRS_BCAST_BROKER_13_162: [When it publishes to the sinks of source, if the route has a filter, the function shall test the messages against it by calling LinkFilter_MatchesMessage, skip the sink without acquiring its lock if none of them passes, and only append the messages that pass.]*/
+    while (first_match < message_count && !passes_filter(filter, filter_messages, messages, first_match))
+    {
+        first_match++;
+    }
+
+    if (first_match == message_count)
+    {
+        /*the module does not want any of the messages, it is not woken*/
+        result = BROKER_OK;
+    }
+    /*Codes_SRS_BCAST_BROKER_13_033: [In the loop, the function shall first acquire the lock on BROKER_MODULEINFO::mq_lock.]*/
+    else if (Lock(module_info->mq_lock) != LOCK_OK)
+    {
+        /*Codes_SRS_BCAST_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+        LogError("Lock on module_info->mq_lock for module [%p] failed", module_info);
+        result = BROKER_ERROR;
+    }
+    else
+    {
+        size_t enqueued_count = 0;
+        size_t i;
+
+        result = BROKER_OK;
+        for (i = first_match; i < message_count; i++)
+        {
+            if (i == first_match || passes_filter(filter, filter_messages, messages, i))
+            {
+                BROKER_RESULT enqueue_result = enqueue_message(module_info, link_counters, messages[i]);
+                if (enqueue_result == BROKER_OK)
+                {
+                    enqueued_count++;
+                }
+                result = merge_publish_result(result, enqueue_result);
+            }
+        }
+
+        if (enqueued_count == 0)
+        {
+            Unlock(module_info->mq_lock);
+        }
+        else
+        {
+            if (link_counters != NULL)
+            {
+                /*Codes_SRS_BCAST_BROKER_13_175: [When it publishes over a route, the function shall count the messages it appends and their bytes in the BROKER_LINK_COUNTERS of the route, and the time it appended the last of them.]*/
+                link_counters->last_activity_time = BrokerStatistics_GetTime();
+            }
+
+            /*Codes_SRS_BCAST_BROKER_13_096: [The function shall then schedule BROKER_MODULEINFO::strand by calling WorkerPool_Schedule.]*/
+            if (WorkerPool_Schedule(module_info->strand) != 0)
+            {
+                /*Codes_SRS_BCAST_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                LogError("WorkerPool_Schedule failed for module [%p]", module_info);
+                result = BROKER_ERROR;
+            }
+
+            /*Codes_SRS_BCAST_BROKER_13_035: [The function shall then release BROKER_MODULEINFO::mq_lock.]*/
+            if (Unlock(module_info->mq_lock) != LOCK_OK)
+            {
+                LogError("unable to unlock");
+            }
+        }
+    }
+
+    return result;
+}
+
+/*publishes the messages to the modules linked to source, or to every module when it is a broadcast*/
+static BROKER_RESULT publish_messages(BROKER_HANDLE_DATA* broker_data, MODULE_HANDLE source, const MESSAGE_HANDLE* messages, size_t message_count)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BCAST_BROKER_13_031: [Broker_Publish shall acquire the broker's routing snapshot by calling RoutingTable_Acquire, and shall not acquire BROKER_HANDLE_DATA::modules_lock.]*/
+    ROUTING_SNAPSHOT_HANDLE snapshot = RoutingTable_Acquire(broker_data->routing_table);
+
+    /*Codes_SRS_BCAST_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+    result = BROKER_OK;
+
+    // NOTE: This is a best-effort delivery bus which means that we offer no
+    // delivery guarantees. If message delivery for a particular module fails,
+    // we log the fact and go on our merry way trying to deliver messages to
+    // other modules on the bus. We will however return BROKER_ERROR when this
+    // happens, or BROKER_BUSY when a module's queue refused the message.
+#ifdef UWP_BINDING
+    /*the UWP gateway does not add links, so messages are always broadcast there*/
+    bool broadcast = true;
+#else
+    bool broadcast = (source == NULL);
+#endif // UWP_BINDING
+    if (broadcast)
+    {
+        /*Codes_SRS_BCAST_BROKER_13_032: [If source is NULL, Broker_Publish shall start a processing loop for every module of the routing snapshot, as returned by RoutingSnapshot_GetEntries.]*/
+        size_t entry_count;
+        const ROUTING_ENTRY* entries = RoutingSnapshot_GetEntries(snapshot, &entry_count);
+        size_t i;
+        for (i = 0; i < entry_count; i++)
+        {
+#ifdef UWP_BINDING
+            /*Codes_SRS_BCAST_BROKER_17_002: [ If source is not NULL, Broker_Publish shall not publish the message to the BROKER_MODULEINFO::module which matches source. ]*/
+            if (source == NULL || entries[i].key != (const void*)source)
+#endif // UWP_BINDING
+            {
+                result = merge_publish_result(result, publish_to_module((BROKER_MODULEINFO*)entries[i].module, NULL, NULL, NULL, messages, message_count));
+            }
+        }
+    }
+    else
+    {
+        /*Codes_SRS_BCAST_BROKER_13_130: [If source is not NULL, Broker_Publish shall find the routing entry of source by calling RoutingSnapshot_Find.]*/
+        const ROUTING_ENTRY* source_entry = RoutingSnapshot_Find(snapshot, source);
+        if (source_entry == NULL)
+        {
+            /*Codes_SRS_BCAST_BROKER_13_131: [If source is not attached to the broker, Broker_Publish shall return BROKER_ERROR.]*/
+            LogError("source module is not attached to the broker");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_BCAST_BROKER_13_186: [If a sink of the routing entry of the source has a filter, Broker_Publish shall initialize a LINK_FILTER_MESSAGE for every message by calling LinkFilter_InitMessage before the loop, so that the filters of all the sinks share the properties and the hashes they look up; if it cannot allocate them for a batch, the function shall test the messages by calling LinkFilter_Matches instead.]*/
+            LINK_FILTER_MESSAGE single_filter_message;
+            LINK_FILTER_MESSAGE* filter_messages = init_filter_messages(source_entry, messages, message_count, &single_filter_message);
+            size_t i;
+
+            /*Codes_SRS_BCAST_BROKER_13_132: [Broker_Publish shall start a processing loop for every sink of the routing entry of the source, and shall not publish the message to any other module.]*/
+            for (i = 0; i < source_entry->sink_count; i++)
+            {
+                result = merge_publish_result(result, publish_to_module((BROKER_MODULEINFO*)source_entry->sinks[i].sink, (LINK_FILTER_HANDLE)source_entry->sinks[i].filter, filter_messages, (BROKER_LINK_COUNTERS*)source_entry->sinks[i].counters, messages, message_count));
+            }
+
+            if (filter_messages != &single_filter_message)
+            {
+                free(filter_messages);
+            }
+        }
+    }
+
+    /*Codes_SRS_BCAST_BROKER_13_040: [Broker_Publish shall release the routing snapshot by calling RoutingTable_Release after the loop.]*/
+    if (snapshot != NULL)
+    {
+        RoutingTable_Release(broker_data->routing_table, snapshot);
+    }
+
+    return result;
+}
+
 BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_HANDLE message)
 {
     BROKER_RESULT result;
@@ -585,82 +1701,234 @@ BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE
     }
     else
     {
-        /*Codes_SRS_BCAST_BROKER_13_031: [Broker_Publish shall acquire the lock BROKER_HANDLE_DATA::modules_lock.]*/
+        result = publish_messages((BROKER_HANDLE_DATA*)broker, source, &message, 1);
+    }
+
+    return result;
+}
+
+BROKER_RESULT Broker_PublishBatch(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_BATCH_HANDLE batch)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BCAST_BROKER_13_149: [If broker or batch is NULL the function shall return BROKER_INVALIDARG.]*/
+    if (broker == NULL || batch == NULL)
+    {
+        result = BROKER_INVALIDARG;
+        LogError("Broker handle and/or batch handle is NULL");
+    }
+    else
+    {
+        size_t message_count = MessageBatch_GetCount(batch);
+        if (message_count == 0)
+        {
+            /*Codes_SRS_BCAST_BROKER_13_150: [If the batch is empty, Broker_PublishBatch shall return BROKER_OK without acquiring any lock.]*/
+            result = BROKER_OK;
+        }
+        else
+        {
+            /*Codes_SRS_BCAST_BROKER_13_151: [Broker_PublishBatch shall publish the messages of the batch as Broker_Publish does, acquiring the routing snapshot and the BROKER_MODULEINFO::mq_lock of every receiving module once, appending all the messages to the module's queue in order and scheduling the module's strand once.]*/
+            result = publish_messages((BROKER_HANDLE_DATA*)broker, source, MessageBatch_GetMessages(batch), message_count);
+        }
+    }
+
+    return result;
+}
+
+/*fills statistics with the counters of a module; the caller holds BROKER_HANDLE_DATA::modules_lock*/
+static void get_module_statistics(BROKER_MODULEINFO* module_info, BROKER_MODULE_STATISTICS* statistics)
+{
+    BROKER_QUEUE_COUNTERS queue_counters;
+    size_t queue_depth;
+    size_t queued_bytes;
+
+    /*Codes_SRS_BCAST_BROKER_13_172: [Broker_GetStatistics shall read BROKER_MODULEINFO::queue_counters, the depth of BROKER_MODULEINFO::mq and its bytes under BROKER_MODULEINFO::mq_lock, and BROKER_MODULEINFO::delivery_counters without acquiring any lock.]*/
+    if (Lock(module_info->mq_lock) != LOCK_OK)
+    {
+        LogError("unable to lock mq_lock of module [%p], its counters may be torn", module_info);
+        queue_counters = module_info->queue_counters;
+        queue_depth = MessageQueue_Size(module_info->mq);
+        queued_bytes = module_info->mq_bytes;
+    }
+    else
+    {
+        queue_counters = module_info->queue_counters;
+        queue_depth = MessageQueue_Size(module_info->mq);
+        queued_bytes = module_info->mq_bytes;
+        if (Unlock(module_info->mq_lock) != LOCK_OK)
+        {
+            LogError("unable to unlock mq_lock");
+        }
+    }
+
+    BrokerStatistics_Fill(statistics, (MODULE_HANDLE)get_module_key(module_info), &queue_counters, &module_info->delivery_counters);
+    statistics->queue_depth = queue_depth;
+    statistics->queued_bytes = queued_bytes;
+}
+
+BROKER_RESULT Broker_GetStatistics(BROKER_HANDLE broker, BROKER_MODULE_STATISTICS* statistics, size_t* module_count)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BCAST_BROKER_13_168: [If broker or module_count is NULL, or statistics is NULL and *module_count is not 0, Broker_GetStatistics shall return BROKER_INVALIDARG.]*/
+    if (broker == NULL || module_count == NULL || (statistics == NULL && *module_count != 0))
+    {
+        LogError("invalid arg broker=%p statistics=%p module_count=%p", broker, statistics, module_count);
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
         BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BCAST_BROKER_13_169: [Broker_GetStatistics shall lock BROKER_HANDLE_DATA::modules_lock, so that no module is removed while its counters are read.]*/
         if (Lock(broker_data->modules_lock) != LOCK_OK)
         {
+            /*Codes_SRS_BCAST_BROKER_13_173: [If an underlying API call fails, Broker_GetStatistics shall return BROKER_ERROR.]*/
             LogError("Lock on broker_data->modules_lock failed");
             result = BROKER_ERROR;
         }
         else
         {
-            /*Codes_SRS_BCAST_BROKER_13_032: [Broker_Publish shall start a processing loop for every module in BROKER_HANDLE_DATA::modules.]*/
+            LIST_ITEM_HANDLE current_module;
+            size_t count = 0;
 
-            /*Codes_SRS_BCAST_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+            /*Codes_SRS_BCAST_BROKER_13_170: [Broker_GetStatistics shall fill the first *module_count elements of statistics with the counters of the modules of BROKER_HANDLE_DATA::modules, in the order they were added.]*/
+            for (current_module = list_get_head_item(broker_data->modules);
+                 current_module != NULL;
+                 current_module = list_get_next_item(current_module))
+            {
+                if (count < *module_count)
+                {
+                    get_module_statistics((BROKER_MODULEINFO*)list_item_get_value(current_module), &statistics[count]);
+                }
+                count++;
+            }
+
+            /*Codes_SRS_BCAST_BROKER_13_171: [Broker_GetStatistics shall set *module_count to the number of modules of the broker, unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_OK.]*/
+            *module_count = count;
+            if (Unlock(broker_data->modules_lock) != LOCK_OK)
+            {
+                LogError("unable to unlock modules_lock");
+            }
             result = BROKER_OK;
+        }
+    }
 
-            // NOTE: This is a best-effort delivery bus which means that we offer no
-            // delivery guarantees. If message delivery for a particular module fails,
-            // we log the fact and go on our merry way trying to deliver messages to
-            // other modules on the bus. We will however return BROKER_ERROR when this
-            // happens.
-            for (LIST_ITEM_HANDLE current_module = list_get_head_item(broker_data->modules);
-                 current_module != NULL; 
-                 current_module = list_get_next_item(current_module))
+    return result;
+}
+
+BROKER_RESULT Broker_ApplyModuleThreadOptions(BROKER_HANDLE broker, MODULE_HANDLE module)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BCAST_BROKER_13_181: [If broker or module is NULL, Broker_ApplyModuleThreadOptions shall return BROKER_INVALIDARG.]*/
+    if (broker == NULL || module == NULL)
+    {
+        LogError("invalid arg broker=%p module=%p", broker, module);
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BCAST_BROKER_13_182: [Broker_ApplyModuleThreadOptions shall lock BROKER_HANDLE_DATA::modules_lock and copy the BROKER_MODULEINFO::thread_options of module.]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BCAST_BROKER_13_184: [If the module was not added to the broker, the options cannot be applied or an underlying API call fails, Broker_ApplyModuleThreadOptions shall return BROKER_ERROR.]*/
+            LogError("Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            BROKER_THREAD_OPTIONS thread_options;
+            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, module);
+            if (module_info != NULL)
             {
+                thread_options = module_info->thread_options;
+            }
 
-                BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)list_item_get_value(current_module);
+            if (Unlock(broker_data->modules_lock) != LOCK_OK)
+            {
+                LogError("unable to unlock modules_lock");
+            }
 
-                /*Codes_SRS_BCAST_BROKER_17_002: [ If source is not NULL, Broker_Publish shall not publish the message to the BROKER_MODULEINFO::module which matches source. ]*/
-#ifdef UWP_BINDING
-				if (source == NULL || module_info->module->module_instance != source)
-#else
-				if (source == NULL || module_info->module->module_handle != source)
-#endif // UWP_BINDING
+            if (module_info == NULL)
+            {
+                /*Codes_SRS_BCAST_BROKER_13_184: [If the module was not added to the broker, the options cannot be applied or an underlying API call fails, Broker_ApplyModuleThreadOptions shall return BROKER_ERROR.]*/
+                LogError("module [%p] was not added to the broker", module);
+                result = BROKER_ERROR;
+            }
+            /*Codes_SRS_BCAST_BROKER_13_183: [Broker_ApplyModuleThreadOptions shall apply the thread options to the calling thread by calling ThreadOptions_Apply after releasing the lock, and return BROKER_OK.]*/
+            else if (ThreadOptions_Apply(&thread_options) != 0)
+            {
+                /*Codes_SRS_BCAST_BROKER_13_184: [If the module was not added to the broker, the options cannot be applied or an underlying API call fails, Broker_ApplyModuleThreadOptions shall return BROKER_ERROR.]*/
+                LogError("unable to apply the thread options of module [%p]", module);
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                result = BROKER_OK;
+            }
+        }
+    }
+
+    return result;
+}
+
+BROKER_RESULT Broker_GetLinkStatistics(BROKER_HANDLE broker, const BROKER_LINK_DATA* link, BROKER_LINK_STATISTICS* statistics)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BCAST_BROKER_13_176: [If broker, link, link->module_source_handle, link->module_sink_handle or statistics is NULL, Broker_GetLinkStatistics shall return BROKER_INVALIDARG.]*/
+    if (broker == NULL || link == NULL || link->module_source_handle == NULL || link->module_sink_handle == NULL || statistics == NULL)
+    {
+        LogError("invalid arg broker=%p link=%p statistics=%p", broker, link, statistics);
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BCAST_BROKER_13_177: [Broker_GetLinkStatistics shall lock BROKER_HANDLE_DATA::modules_lock and find the route from link->module_source_handle to link->module_sink_handle.]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BCAST_BROKER_13_179: [If the route does not exist or an underlying API call fails, Broker_GetLinkStatistics shall return BROKER_ERROR.]*/
+            LogError("Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            BROKER_MODULEINFO* sink_info = broker_locate_handle(broker_data, link->module_sink_handle);
+            BROKER_MODULEINFO* source_info = broker_locate_handle(broker_data, link->module_source_handle);
+            BROKER_ROUTE* route = (sink_info == NULL || source_info == NULL) ? NULL : find_route(source_info, sink_info);
+            if (route == NULL || route->link_count == 0)
+            {
+                /*Codes_SRS_BCAST_BROKER_13_179: [If the route does not exist or an underlying API call fails, Broker_GetLinkStatistics shall return BROKER_ERROR.]*/
+                LogError("Link does not exist in Broker");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                BROKER_LINK_COUNTERS link_counters;
+
+                /*Codes_SRS_BCAST_BROKER_13_178: [Broker_GetLinkStatistics shall read the BROKER_LINK_COUNTERS of the route under BROKER_MODULEINFO::mq_lock of the sink, fill statistics by calling BrokerStatistics_FillLink and return BROKER_OK.]*/
+                if (Lock(sink_info->mq_lock) != LOCK_OK)
                 {
-                    /*Codes_SRS_BCAST_BROKER_13_033: [In the loop, the function shall first acquire the lock on BROKER_MODULEINFO::mq_lock.]*/
-                    if (Lock(module_info->mq_lock) != LOCK_OK)
-                    {
-                        /*Codes_SRS_BCAST_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                        LogError("Lock on module_info->mq_lock for module at item [%p] failed", current_module);
-                        result = BROKER_ERROR;
-                    }
-                    else
+                    LogError("unable to lock mq_lock of module [%p], the counters of the link may be torn", sink_info);
+                    link_counters = *route->counters;
+                }
+                else
+                {
+                    link_counters = *route->counters;
+                    if (Unlock(sink_info->mq_lock) != LOCK_OK)
                     {
-                        /*Codes_SRS_BCAST_BROKER_13_034: [The function shall then append message to BROKER_MODULEINFO::mq by calling Message_Clone and VECTOR_push_back.]*/
-                        MESSAGE_HANDLE msg = Message_Clone(message);
-                        if (VECTOR_push_back(module_info->mq, &msg, 1) != 0)
-                        {
-                            /*Codes_SRS_BCAST_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                            LogError("VECTOR_push_back failed for module at  item [%p] failed", current_module);
-                            Message_Destroy(msg);
-                            Unlock(module_info->mq_lock);
-                            result = BROKER_ERROR;
-                        }
-                        else
-                        {
-                            /*Codes_SRS_BCAST_BROKER_13_096: [The function shall then signal BROKER_MODULEINFO::mq_cond.]*/
-                            if (Condition_Post(module_info->mq_cond) != COND_OK)
-                            {
-                                /*Codes_SRS_BCAST_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                                LogError("Condition_Post failed for module at  item [%p] failed", current_module);
-                                result = BROKER_ERROR;
-                            }
-
-                            /*Codes_SRS_BCAST_BROKER_13_035: [The function shall then release BROKER_MODULEINFO::mq_lock.]*/
-                            if (Unlock(module_info->mq_lock) != LOCK_OK)
-                            {
-                                LogError("unable to unlock");
-                            }
-                        }
+                        LogError("unable to unlock mq_lock");
                     }
                 }
+
+                BrokerStatistics_FillLink(statistics, &link_counters);
+                result = BROKER_OK;
             }
 
-            /*Codes_SRS_BCAST_BROKER_13_040: [Broker_Publish shall release the lock BROKER_HANDLE_DATA::modules_lock after the loop.]*/
-            Unlock(broker_data->modules_lock);
+            if (Unlock(broker_data->modules_lock) != LOCK_OK)
+            {
+                LogError("unable to unlock modules_lock");
+            }
         }
     }
 
     return result;
-}
\ No newline at end of file
+}
@@ -8,12 +8,17 @@
 #endif
 
 #include <stddef.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
 #include <signal.h>
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/refcount.h"
@@ -26,12 +31,26 @@
 #include "message.h"
 #include "module.h"
 #include "broker.h"
+#include "internal/broker_statistics.h"
+#include "internal/thread_options.h"
+#include "internal/link_filter.h"
 
 /* minimum size for a guid string, 36 characters + null terminator */
 #define BROKER_GUID_SIZE            37
 #define INPROC_URL_HEAD "inproc://"
 #define INPROC_URL_HEAD_SIZE  9
 #define URL_SIZE (INPROC_URL_HEAD_SIZE + BROKER_GUID_SIZE +1)
+/* every frame starts with the source, the topic the modules subscribe to,
+   followed by the sequence number of its first message among the messages
+   published by that source */
+#define FRAME_HEADER_SIZE (sizeof(MODULE_HANDLE) + sizeof(uint32_t))
+/* first byte after the header of a frame sent by Broker_PublishBatch, a frame
+   holding a single message continues with the message header instead */
+#define BATCH_FRAME_MARKER 0xBA
+#define BATCH_FRAME_HEADER_SIZE (FRAME_HEADER_SIZE + 1 + sizeof(int32_t))
+/* longest a module worker waits for a message before checking whether it is
+   being removed, bounding the removal when the quit message is not received */
+#define MODULE_WORKER_POLL_TIMEOUT_MS 100
 
 /*The structure backing the message broker handle*/
 typedef struct BROKER_HANDLE_DATA_TAG
@@ -40,10 +59,94 @@ typedef struct BROKER_HANDLE_DATA_TAG
     LOCK_HANDLE             modules_lock;
 	int                     publish_socket;
 	STRING_HANDLE           url;
+	/**
+	* Protects publishers, lossless_module_count and space_waiters.
+	* Publishers only take it while a lossless module is attached.
+	*/
+	LOCK_HANDLE             publish_lock;
+	/**
+	* The started modules, chained by BROKER_MODULEINFO::next_publisher.
+	*/
+	struct BROKER_MODULEINFO_TAG*	publishers;
+	/**
+	* Number of publishers whose messages in flight are bounded, read by
+	* the publishers without publish_lock to decide whether they take it.
+	*/
+	volatile size_t         lossless_module_count;
+	/**
+	* The modules that have been started on the broker, one entry per
+	* module handle. Entries are prepended under modules_lock once
+	* initialized and read by the publishers without a lock: they are only
+	* freed with the broker.
+	*/
+	struct BROKER_SOURCE_TAG* volatile	sources;
+	/**
+	* Signaled with publish_lock held when a lossless module receives
+	* messages, created with the first lossless module, once for each of
+	* the space_waiters publishers waiting on it.
+	*/
+	COND_HANDLE             space_cond;
+	size_t                  space_waiters;
 }BROKER_HANDLE_DATA;
 
 DEFINE_REFCOUNT_TYPE(BROKER_HANDLE_DATA);
 
+/*Numbering of the messages published by one module*/
+typedef struct BROKER_SOURCE_TAG
+{
+	MODULE_HANDLE						source;
+	/**
+	* Held to number and send a frame of the source, so that its frames are
+	* sent in the order of their sequence numbers.
+	*/
+	LOCK_HANDLE							send_lock;
+	/**
+	* Sequence number of the next message the source publishes, written
+	* under send_lock.
+	*/
+	volatile uint32_t					next_sequence;
+	struct BROKER_SOURCE_TAG*			next;
+}BROKER_SOURCE;
+
+/*A filter a link no longer uses, kept until the module is freed*/
+typedef struct BROKER_RETIRED_FILTER_TAG
+{
+	LINK_FILTER_HANDLE					filter;
+	struct BROKER_RETIRED_FILTER_TAG*	next;
+}BROKER_RETIRED_FILTER;
+
+/*Traffic of the links from one source to a module*/
+typedef struct BROKER_LINK_TRAFFIC_TAG
+{
+	MODULE_HANDLE						source;
+	/**
+	* Number of times the link has been added, protected by
+	* BROKER_HANDLE_DATA::modules_lock. The entry stays in the list when it
+	* reaches 0 and the counters restart when the link is added again.
+	*/
+	size_t								link_count;
+	/**
+	* Only written by module_worker of the sink.
+	*/
+	BROKER_LINK_COUNTERS				counters;
+	/**
+	* Sequence number of the next message expected from the source, only
+	* written by module_worker of the sink once it has received a message
+	* since the link was added.
+	*/
+	volatile uint32_t					next_sequence;
+	volatile bool						sequence_synced;
+	/**
+	* Filter of the links, NULL when every message is delivered. Replaced
+	* by Broker_AddLink under modules_lock while link_count is 0 and read by
+	* module_worker without a lock, so the filters it replaces are kept in
+	* retired_filters until the module is freed.
+	*/
+	LINK_FILTER_HANDLE volatile			filter;
+	BROKER_RETIRED_FILTER*				retired_filters;
+	struct BROKER_LINK_TRAFFIC_TAG*		next;
+}BROKER_LINK_TRAFFIC;
+
 typedef struct BROKER_MODULEINFO_TAG
 {
     /**
@@ -62,13 +165,53 @@ typedef struct BROKER_MODULEINFO_TAG
 	*/
 	int                     receive_socket;
 	/**
-	* lock to prevent nanomsg race condition
+	* set by stop_module, module_worker checks it between messages and after
+	* every wait on receive_socket.
 	*/
-	LOCK_HANDLE				socket_lock;
+	volatile sig_atomic_t	quit_requested;
 	/**
 	* guid sent to moduel worker thread to close task.
 	*/
 	STRING_HANDLE			quit_message_guid;
+	/**
+	* size of receive_socket's receive buffer, 0 for the nanomsg default.
+	*/
+	int						receive_buffer_size;
+	/**
+	* options of the threads running the module's code, applied by
+	* module_worker to itself and by Broker_ApplyModuleThreadOptions.
+	*/
+	BROKER_THREAD_OPTIONS	thread_options;
+	/**
+	* Counters of the messages received and delivered for
+	* Broker_GetStatistics. Only written by module_worker, on cache lines of
+	* their own.
+	*/
+	BROKER_DELIVERY_COUNTERS	delivery_counters;
+	/**
+	* Traffic of the links to this module, one entry per source. Entries are
+	* prepended by Broker_AddLink under modules_lock once initialized, and
+	* read by module_worker without a lock: they are only freed with the
+	* module, after its thread has exited.
+	*/
+	BROKER_LINK_TRAFFIC* volatile	links;
+	/**
+	* Next module of BROKER_HANDLE_DATA::publishers, protected by
+	* publish_lock.
+	*/
+	struct BROKER_MODULEINFO_TAG*	next_publisher;
+	/**
+	* Maximum number of messages of a source sent to the module and not yet
+	* received by its thread, 0 when they are not bounded, and how long a
+	* publisher waits for room.
+	*/
+	size_t					max_in_flight;
+	unsigned int			block_timeout_ms;
+	/**
+	* The broker, set when the module is started, for its publish_lock and
+	* space_cond.
+	*/
+	BROKER_HANDLE_DATA*		broker_data;
 
 }BROKER_MODULEINFO;
 
@@ -109,6 +252,13 @@ static STRING_HANDLE construct_url()
 	return result;
 }
 
+BROKER_HANDLE Broker_CreateWithOptions(const BROKER_OPTIONS* options)
+{
+    /*Codes_SRS_BROKER_13_117: [Broker_CreateWithOptions shall behave as Broker_Create; the worker_count option is ignored because every module has its own receiving thread.]*/
+    (void)options;
+    return Broker_Create();
+}
+
 BROKER_HANDLE Broker_Create(void)
 {
     BROKER_HANDLE_DATA* result;
@@ -142,9 +292,25 @@ BROKER_HANDLE Broker_Create(void)
                 list_destroy(result->modules);
                 free(result);
                 result = NULL;
+            }
+            /*Codes_SRS_BROKER_13_154: [ Broker_Create shall initialize BROKER_HANDLE_DATA::publish_lock with a valid LOCK_HANDLE and set BROKER_HANDLE_DATA::publishers and BROKER_HANDLE_DATA::space_cond to NULL. ]*/
+            else if ((result->publish_lock = Lock_Init()) == NULL)
+            {
+                /*Codes_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]*/
+                LogError("Lock_Init failed");
+                Lock_Deinit(result->modules_lock);
+                list_destroy(result->modules);
+                free(result);
+                result = NULL;
             }
 			else
 			{
+				result->publishers = NULL;
+				result->lossless_module_count = 0;
+				result->sources = NULL;
+				result->space_cond = NULL;
+				result->space_waiters = 0;
+
 				/*Codes_SRS_BROKER_17_001: [ Broker_Create shall initialize a socket for publishing messages. ]*/
 				result->publish_socket = nn_socket(AF_SP, NN_PUB);
 				if (result->publish_socket < 0)
@@ -153,6 +319,7 @@ BROKER_HANDLE Broker_Create(void)
 					LogError("nanomsg puclish socket create failedL %d", result->publish_socket);
 					list_destroy(result->modules);
 					Lock_Deinit(result->modules_lock);
+					Lock_Deinit(result->publish_lock);
 					free(result);
 					result = NULL;
 				}
@@ -164,6 +331,7 @@ BROKER_HANDLE Broker_Create(void)
 						/*Codes_SRS_BROKER_13_003: [ This function shall return NULL if an underlying API call to the platform causes an error. ]*/
 						list_destroy(result->modules);
 						Lock_Deinit(result->modules_lock);
+						Lock_Deinit(result->publish_lock);
 						nn_close(result->publish_socket);
 						free(result);
 						LogError("Unable to generate unique url.");
@@ -178,6 +346,7 @@ BROKER_HANDLE Broker_Create(void)
 							LogError("nanomsg bind failed");
 							list_destroy(result->modules);
 							Lock_Deinit(result->modules_lock);
+							Lock_Deinit(result->publish_lock);
 							nn_close(result->publish_socket);
 							STRING_delete(result->url);				
 							free(result);
@@ -207,91 +376,375 @@ void Broker_IncRef(BROKER_HANDLE broker)
     }
 }
 
-/**
-* This function runs for each module. It receives a pointer to a MODULE_INFO
-* object that describes the module. Its job is to call the Receive function on
-* the associated module whenever it receives a message.
-*/
-static int module_worker(void * user_data)
+/*releases the buffer received by module_worker when the message referencing it is destroyed*/
+static void release_received_buffer(void* buf)
 {
-    /*Codes_SRS_BROKER_13_026: [This function shall assign `user_data` to a local variable called `module_info` of type `BROKER_MODULEINFO*`.]*/
-    BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)user_data;
+	(void)nn_freemsg(buf);
+}
 
-	int should_continue = 1;
-	while (should_continue)
+/*counts message_count messages of nbytes bytes received from the source in the header of buf on the link they came over, and the messages of that source missing before them; returns the traffic of that link, NULL if the module has none from the source*/
+static BROKER_LINK_TRAFFIC* count_link_traffic(BROKER_MODULEINFO* module_info, const unsigned char* buf, uint64_t message_count, size_t nbytes)
+{
+	MODULE_HANDLE source;
+	uint32_t sequence;
+	BROKER_LINK_TRAFFIC* traffic;
+	memcpy(&source, buf, sizeof(MODULE_HANDLE));
+	memcpy(&sequence, buf + sizeof(MODULE_HANDLE), sizeof(uint32_t));
+	for (traffic = module_info->links; traffic != NULL; traffic = traffic->next)
 	{
-		/*Codes_SRS_BROKER_13_089: [ This function shall acquire the lock on module_info->socket_lock. ]*/
-		if (Lock(module_info->socket_lock))
+		if (traffic->source == source)
 		{
-			/*Codes_SRS_BROKER_02_004: [ If acquiring the lock fails, then module_worker shall return. ]*/
-			LogError("unable to Lock");
-			should_continue = 0;
-			break;
-		}
-		int nn_fd = module_info->receive_socket;
-		int nbytes;
-		unsigned char *buf = NULL;
+			/*Codes_SRS_BROKER_13_146: [ The function shall count the messages and the bytes it receives from a source in the BROKER_LINK_COUNTERS of the link from that source, and the time it received the last of them. ]*/
+			traffic->counters.messages += message_count;
+			traffic->counters.bytes += (uint64_t)nbytes;
+			traffic->counters.last_activity_time = BrokerStatistics_GetTime();
 
-		/*Codes_SRS_BROKER_17_005: [ For every iteration of the loop, the function shall wait on the receive_socket for messages. ]*/
-		nbytes = nn_recv(nn_fd, (void *)&buf, NN_MSG, 0);
-		/*Codes_SRS_BROKER_13_091: [ The function shall unlock module_info->socket_lock. ]*/
-		if (Unlock(module_info->socket_lock) != LOCK_OK)
-		{
-			/*Codes_SRS_BROKER_17_016: [ If releasing the lock fails, then module_worker shall return. ]*/
-			should_continue = 0;
-			if (nbytes > 0)
+			if (!traffic->sequence_synced)
+			{
+				/*Codes_SRS_BROKER_13_161: [ The first frame the function receives from a source since the link was added shall set the sequence number it expects next from that source. ]*/
+				traffic->next_sequence = sequence + (uint32_t)message_count;
+				traffic->sequence_synced = true;
+			}
+			else
+			{
+				/*the frames sent before the link was added may still be received, they are older than the expected one*/
+				int32_t gap = (int32_t)(sequence - traffic->next_sequence);
+				if (gap > 0)
+				{
+					/*Codes_SRS_BROKER_13_162: [ When the sequence number of a frame is past the one expected, the function shall count the missing messages, dropped by nanomsg, as discarded in BROKER_MODULEINFO::delivery_counters. ]*/
+					module_info->delivery_counters.discarded += (uint64_t)gap;
+				}
+				if (gap >= 0)
+				{
+					traffic->next_sequence = sequence + (uint32_t)message_count;
+				}
+			}
+
+			if (module_info->max_in_flight > 0)
 			{
-				/*Codes_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]*/
-				nn_freemsg(buf);
+				/*Codes_SRS_BROKER_13_163: [ If the messages in flight to the module are bounded, the function shall signal BROKER_HANDLE_DATA::space_cond with BROKER_HANDLE_DATA::publish_lock held after it counts a frame, once for each publisher waiting on it. ]*/
+				BROKER_HANDLE_DATA* broker_data = module_info->broker_data;
+				if (Lock(broker_data->publish_lock) != LOCK_OK)
+				{
+					LogError("unable to lock the publish lock");
+				}
+				else
+				{
+					/*Condition_Post wakes one waiter, the waiters may be waiting for room at different sinks*/
+					size_t waiter;
+					for (waiter = 0; waiter < broker_data->space_waiters; waiter++)
+					{
+						if (Condition_Post(broker_data->space_cond) != COND_OK)
+						{
+							LogError("Condition_Post failed for module [%p]", module_info);
+							break;
+						}
+					}
+					(void)Unlock(broker_data->publish_lock);
+				}
 			}
 			break;
 		}
+	}
+	return traffic;
+}
+
+/*returns nonzero when msg, received over the link of traffic, passes the filter of the link*/
+static int passes_link_filter(const BROKER_LINK_TRAFFIC* traffic, MESSAGE_HANDLE msg)
+{
+	/*Codes_SRS_BROKER_13_178: [ If the link a message is received over has a filter, the function shall test the message against it by calling LinkFilter_Matches before delivering it, and shall destroy the messages that do not pass without delivering them. ]*/
+	LINK_FILTER_HANDLE filter = (traffic == NULL) ? NULL : traffic->filter;
+	return (filter == NULL) || LinkFilter_Matches(filter, msg);
+}
+
+/*delivers a message received by module_worker to the module, destroying it unless the module takes its ownership*/
+static void deliver_message(BROKER_MODULEINFO* module_info, MESSAGE_HANDLE msg)
+{
+	uint64_t start = BrokerStatistics_GetTime();
+#ifdef UWP_BINDING
+	/*Codes_SRS_BROKER_99_012: [The function shall deliver the message to the module's Receive function via the IInternalGatewayModule interface. ]*/
+	module_info->module->module_instance->Module_Receive(msg);
+	/*Codes_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]*/
+	Message_Destroy(msg);
+#else
+	if (module_info->module->module_apis->Module_ReceiveBatch != NULL)
+	{
+		/*Codes_SRS_BROKER_13_118: [If the module implements Module_ReceiveBatch, the function shall deliver the message through it as a batch of one message.]*/
+		module_info->module->module_apis->Module_ReceiveBatch(module_info->module->module_handle, &msg, 1);
+		/*Codes_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]*/
+		Message_Destroy(msg);
+	}
+	else if (module_info->module->module_apis->Module_ReceiveOwned != NULL)
+	{
+		/*Codes_SRS_BROKER_13_119: [If the module implements Module_ReceiveOwned, the function shall deliver the message through it and shall not destroy the message.]*/
+		module_info->module->module_apis->Module_ReceiveOwned(module_info->module->module_handle, msg);
+	}
+	else
+	{
+		/*Codes_SRS_BROKER_13_092: [The function shall deliver the message to the module's callback function via module_info->module_apis. ]*/
+		module_info->module->module_apis->Module_Receive(module_info->module->module_handle, msg);
+		/*Codes_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]*/
+		Message_Destroy(msg);
+	}
+#endif // UWP_BINDING
+	/*Codes_SRS_BROKER_13_139: [ The function shall count every message it delivers and record how long each call to the module's receive functions took in BROKER_MODULEINFO::delivery_counters. ]*/
+	BrokerStatistics_RecordDuration(&module_info->delivery_counters.receive_duration, start, BrokerStatistics_GetTime());
+	module_info->delivery_counters.delivered++;
+}
+
+/*buffer received by module_worker that is referenced by all the messages of a batch frame*/
+typedef struct RECEIVED_BUFFER_TAG
+{
+	void* buf;
+}RECEIVED_BUFFER;
+
+DEFINE_REFCOUNT_TYPE(RECEIVED_BUFFER);
+
+/*releases one reference to a received batch frame, freeing it with the last one*/
+static void release_received_batch_buffer(void* context)
+{
+	RECEIVED_BUFFER* received = (RECEIVED_BUFFER*)context;
+	if (DEC_REF(RECEIVED_BUFFER, received) == DEC_RETURN_ZERO)
+	{
+		(void)nn_freemsg(received->buf);
+		free(received);
+	}
+}
+
+/*delivers the messages of a frame sent by Broker_PublishBatch, buf is the frame as received and nbytes its size*/
+static void deliver_batch_frame(BROKER_MODULEINFO* module_info, unsigned char* buf, size_t nbytes)
+{
+	int32_t count = 0;
+	if (nbytes >= BATCH_FRAME_HEADER_SIZE)
+	{
+		memcpy(&count, buf + FRAME_HEADER_SIZE + 1, sizeof(int32_t));
+	}
 
-		if (nbytes < 0)
+	/*every message takes at least its size*/
+	if (count <= 0 || (size_t)count > (nbytes - BATCH_FRAME_HEADER_SIZE) / sizeof(int32_t))
+	{
+		/*Codes_SRS_BROKER_13_126: [ If the batch frame is malformed, the function shall free the buffer received and the message loop shall continue. ]*/
+		LogError("received a malformed batch frame");
+		module_info->delivery_counters.received++;
+		module_info->delivery_counters.discarded++;
+		count_link_traffic(module_info, buf, 1, nbytes);
+		nn_freemsg(buf);
+	}
+	else
+	{
+		MESSAGE_HANDLE* messages;
+		RECEIVED_BUFFER* received = REFCOUNT_TYPE_CREATE(RECEIVED_BUFFER);
+		BROKER_LINK_TRAFFIC* traffic;
+		module_info->delivery_counters.received += (uint64_t)count;
+		traffic = count_link_traffic(module_info, buf, (uint64_t)count, nbytes);
+		if (received == NULL)
 		{
-			/*Codes_SRS_BROKER_17_006: [ An error on receiving a message shall terminate the loop. ]*/
-			should_continue = 0;
+			/*Codes_SRS_BROKER_13_127: [ If any allocation fails, the function shall free the buffer received and the message loop shall continue. ]*/
+			LogError("unable to allocate the batch frame reference");
+			module_info->delivery_counters.discarded += (uint64_t)count;
+			nn_freemsg(buf);
+		}
+		else if ((messages = (MESSAGE_HANDLE*)malloc(count * sizeof(MESSAGE_HANDLE))) == NULL)
+		{
+			/*Codes_SRS_BROKER_13_127: [ If any allocation fails, the function shall free the buffer received and the message loop shall continue. ]*/
+			LogError("unable to allocate the messages of a batch frame");
+			module_info->delivery_counters.discarded += (uint64_t)count;
+			free(received);
+			nn_freemsg(buf);
 		}
 		else
 		{
-			if (nbytes == BROKER_GUID_SIZE &&
-				(strncmp(STRING_c_str(module_info->quit_message_guid), (const char *)buf, BROKER_GUID_SIZE-1)==0))
+			size_t position = BATCH_FRAME_HEADER_SIZE;
+			size_t message_count = 0;
+			int32_t i;
+			received->buf = buf;
+			for (i = 0; i < count; i++)
 			{
-				/*Codes_SRS_BROKER_13_068: [ This function shall run a loop that keeps running until module_info->quit_message_guid is sent to the thread. ]*/
-				/* received special quit message for this module */
-				should_continue = 0;
+				int32_t size;
+				if (nbytes - position < sizeof(int32_t))
+				{
+					LogError("batch frame is truncated");
+					break;
+				}
+				memcpy(&size, buf + position, sizeof(int32_t));
+				position += sizeof(int32_t);
+				if (size <= 0 || (size_t)size > nbytes - position)
+				{
+					LogError("batch frame is truncated");
+					break;
+				}
+
+				/*Codes_SRS_BROKER_13_124: [ The function shall deserialize every message of the batch frame by calling Message_CreateFromByteArrayNoCopy, so that the messages reference the buffer received, and shall free the buffer when the last of them is destroyed. ]*/
+				INC_REF(RECEIVED_BUFFER, received);
+				messages[message_count] = Message_CreateFromByteArrayNoCopy(buf + position, size, release_received_batch_buffer, received);
+				if (messages[message_count] == NULL)
+				{
+					/*Codes_SRS_BROKER_13_125: [ If the deserialization of a message of the batch frame is not successful, the function shall skip that message. ]*/
+					LogError("unable to deserialize message %d of a batch frame", (int)i);
+					module_info->delivery_counters.discarded++;
+					(void)DEC_REF(RECEIVED_BUFFER, received);
+				}
+				else if (!passes_link_filter(traffic, messages[message_count]))
+				{
+					/*the message is not for this module, destroying it releases its reference to the buffer*/
+					Message_Destroy(messages[message_count]);
+				}
+				else
+				{
+					message_count++;
+				}
+				position += size;
 			}
-			else
+			/*the messages after a truncation are lost*/
+			module_info->delivery_counters.discarded += (uint64_t)(count - i);
+
+#ifndef UWP_BINDING
+			if (message_count > 0 && module_info->module->module_apis->Module_ReceiveBatch != NULL)
 			{
-				/*Codes_SRS_BROKER_17_024: [ The function shall strip off the topic from the message. ]*/
-				const unsigned char*buf_bytes = (const unsigned char*)buf;
-				buf_bytes += sizeof(MODULE_HANDLE);
-				/*Codes_SRS_BROKER_17_017: [ The function shall deserialize the message received. ]*/
-				MESSAGE_HANDLE msg = Message_CreateFromByteArray(buf_bytes, nbytes - sizeof(MODULE_HANDLE));
-				/*Codes_SRS_BROKER_17_018: [ If the deserialization is not successful, the message loop shall continue. ]*/
-				if (msg != NULL)
+				/*Codes_SRS_BROKER_13_128: [ If the module implements Module_ReceiveBatch, the function shall deliver all the messages of the batch frame through one call to it and shall then destroy them. ]*/
+				uint64_t start = BrokerStatistics_GetTime();
+				module_info->module->module_apis->Module_ReceiveBatch(module_info->module->module_handle, messages, message_count);
+				BrokerStatistics_RecordDuration(&module_info->delivery_counters.receive_duration, start, BrokerStatistics_GetTime());
+				module_info->delivery_counters.delivered += message_count;
+				for (i = 0; i < (int32_t)message_count; i++)
 				{
-					/*Codes_SRS_BROKER_13_092: [ The function shall deliver the message to the module's callback function via module_info->module_apis. ]*/
-#ifdef UWP_BINDING
-					/*Codes_SRS_BROKER_99_012: [The function shall deliver the message to the module's Receive function via the IInternalGatewayModule interface. ]*/
-					module_info->module->module_instance->Module_Receive(msg);
-#else
-					/*Codes_SRS_BROKER_13_092: [The function shall deliver the message to the module's callback function via module_info->module_apis. ]*/
-					module_info->module->module_apis->Module_Receive(module_info->module->module_handle, msg);
+					Message_Destroy(messages[i]);
+				}
+			}
+			else
 #endif // UWP_BINDING
-					/*Codes_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]*/
-					Message_Destroy(msg);
+			{
+				size_t j;
+				for (j = 0; j < message_count; j++)
+				{
+					/*Codes_SRS_BROKER_13_129: [ Otherwise, the function shall deliver the messages of the batch frame one at a time, in order, as it delivers a single message. ]*/
+					deliver_message(module_info, messages[j]);
 				}
 			}
-			/*Codes_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]*/
+
+			free(messages);
+			release_received_batch_buffer(received);
+		}
+	}
+}
+
+/*handles a frame received by module_worker, returns 0 when it is the quit message*/
+static int receive_frame(BROKER_MODULEINFO* module_info, unsigned char* buf, int nbytes)
+{
+	int result = 1;
+	if (nbytes == BROKER_GUID_SIZE &&
+		(strncmp(STRING_c_str(module_info->quit_message_guid), (const char *)buf, BROKER_GUID_SIZE-1)==0))
+	{
+		/*Codes_SRS_BROKER_13_068: [ This function shall run a loop that keeps running until module_info->quit_message_guid is sent to the thread. ]*/
+		/* received special quit message for this module */
+		result = 0;
+		/*Codes_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket when no message references it. ]*/
+		nn_freemsg(buf);
+	}
+	else if ((size_t)nbytes < FRAME_HEADER_SIZE)
+	{
+		/*Codes_SRS_BROKER_13_164: [ If the frame received is shorter than its header, the function shall count it as discarded, free it and the message loop shall continue. ]*/
+		LogError("received a truncated frame");
+		module_info->delivery_counters.received++;
+		module_info->delivery_counters.discarded++;
+		module_info->delivery_counters.received_bytes += (uint64_t)nbytes;
+		nn_freemsg(buf);
+	}
+	else if ((size_t)nbytes > FRAME_HEADER_SIZE && buf[FRAME_HEADER_SIZE] == BATCH_FRAME_MARKER)
+	{
+		/*Codes_SRS_BROKER_13_138: [ The function shall count the messages and the bytes it receives, other than the quit message, in BROKER_MODULEINFO::delivery_counters, and the messages it cannot deliver as discarded. ]*/
+		module_info->delivery_counters.received_bytes += (uint64_t)nbytes;
+		/*Codes_SRS_BROKER_13_123: [ If the byte following the header of the frame is the batch frame marker, the function shall deliver the messages of the batch frame. ]*/
+		deliver_batch_frame(module_info, buf, (size_t)nbytes);
+	}
+	else
+	{
+		/*Codes_SRS_BROKER_13_138: [ The function shall count the messages and the bytes it receives, other than the quit message, in BROKER_MODULEINFO::delivery_counters, and the messages it cannot deliver as discarded. ]*/
+		BROKER_LINK_TRAFFIC* traffic;
+		module_info->delivery_counters.received++;
+		module_info->delivery_counters.received_bytes += (uint64_t)nbytes;
+		traffic = count_link_traffic(module_info, buf, 1, (size_t)nbytes);
+		/*Codes_SRS_BROKER_17_024: [ The function shall strip off the topic and the sequence number from the message. ]*/
+		const unsigned char*buf_bytes = (const unsigned char*)buf;
+		buf_bytes += FRAME_HEADER_SIZE;
+		/*Codes_SRS_BROKER_17_017: [ The function shall deserialize the message received by calling Message_CreateFromByteArrayNoCopy, so that the message references the buffer received instead of copying it. ]*/
+		/*Codes_SRS_BROKER_13_120: [ The message shall free the buffer received by calling nn_freemsg when it is destroyed. ]*/
+		MESSAGE_HANDLE msg = Message_CreateFromByteArrayNoCopy(buf_bytes, nbytes - FRAME_HEADER_SIZE, release_received_buffer, buf);
+		/*Codes_SRS_BROKER_17_018: [ If the deserialization is not successful, the message loop shall continue. ]*/
+		if (msg == NULL)
+		{
+			module_info->delivery_counters.discarded++;
+			/*Codes_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket when no message references it. ]*/
 			nn_freemsg(buf);
-		}	
+		}
+		else if (!passes_link_filter(traffic, msg))
+		{
+			/*the message is not for this module*/
+			Message_Destroy(msg);
+		}
+		else
+		{
+			/*Codes_SRS_BROKER_13_092: [ The function shall deliver the message to the module's callback function via module_info->module_apis. ]*/
+			deliver_message(module_info, msg);
+		}
+	}
+	return result;
+}
+
+/**
+* This function runs for each module. It receives a pointer to a MODULE_INFO
+* object that describes the module. Its job is to call the Receive function on
+* the associated module whenever it receives a message.
+*/
+static int module_worker(void * user_data)
+{
+    /*Codes_SRS_BROKER_13_026: [This function shall assign `user_data` to a local variable called `module_info` of type `BROKER_MODULEINFO*`.]*/
+    BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)user_data;
+
+	/*Codes_SRS_BROKER_13_170: [ If BROKER_MODULEINFO::thread_options are not the default ones, the function shall apply them to its thread by calling ThreadOptions_Apply before receiving any message, and shall go on receiving messages if they cannot be applied. ]*/
+	if (!ThreadOptions_IsDefault(&module_info->thread_options) &&
+		ThreadOptions_Apply(&module_info->thread_options) != 0)
+	{
+		LogError("unable to apply the thread options of module [%p]", module_info);
+	}
+
+	int should_continue = 1;
+	/*Codes_SRS_BROKER_13_166: [ The function shall stop before receiving the next message once BROKER_MODULEINFO::quit_requested is set. ]*/
+	while (should_continue && !module_info->quit_requested)
+	{
+		unsigned char *buf = NULL;
+
+		/*Codes_SRS_BROKER_17_005: [ For every iteration of the loop, the function shall receive the next message pending on the receive_socket with NN_DONTWAIT. ]*/
+		int nbytes = nn_recv(module_info->receive_socket, (void *)&buf, NN_MSG, NN_DONTWAIT);
+		if (nbytes >= 0)
+		{
+			should_continue = receive_frame(module_info, buf, nbytes);
+		}
+		else if (nn_errno() == EAGAIN)
+		{
+			/*Codes_SRS_BROKER_13_167: [ Once no message is pending, the function shall wait on the receive_socket with nn_poll for at most MODULE_WORKER_POLL_TIMEOUT_MS milliseconds. ]*/
+			struct nn_pollfd poll_fd;
+			poll_fd.fd = module_info->receive_socket;
+			poll_fd.events = NN_POLLIN;
+			poll_fd.revents = 0;
+			if (nn_poll(&poll_fd, 1, MODULE_WORKER_POLL_TIMEOUT_MS) < 0 && nn_errno() != EINTR)
+			{
+				/*Codes_SRS_BROKER_13_168: [ An error on waiting for a message, other than an interruption by a signal, shall terminate the loop. ]*/
+				LogError("nn_poll failed");
+				should_continue = 0;
+			}
+		}
+		else
+		{
+			/*Codes_SRS_BROKER_17_006: [ An error on receiving a message shall terminate the loop. ]*/
+			should_continue = 0;
+		}
 	}
 
     return 0;
 }
 
-static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* module)
+static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* module, const BROKER_MODULE_OPTIONS* options)
 {
     BROKER_RESULT result;
 
@@ -313,40 +766,64 @@ static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* m
 #endif // UWP_BINDING
 
 
-		/*Codes_SRS_BROKER_13_099: [The function shall initialize BROKER_MODULEINFO::socket_lock with a valid lock handle.]*/
-		module_info->socket_lock = Lock_Init();
-		if (module_info->socket_lock == NULL)
+		/*Codes_SRS_BROKER_13_099: [The function shall set BROKER_MODULEINFO::quit_requested to 0.]*/
+		module_info->quit_requested = 0;
+		char uuid[BROKER_GUID_SIZE];
+		memset(uuid, 0, BROKER_GUID_SIZE);
+		/*Codes_SRS_BROKER_17_020: [ The function shall create a unique ID used as a quit signal. ]*/
+		if (UniqueId_Generate(uuid, BROKER_GUID_SIZE) != UNIQUEID_OK)
 		{
 			/*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-			LogError("Lock_Init for socket lock failed");
+			LogError("UniqueId_Generate failed");
 			result = BROKER_ERROR;
 		}
 		else
 		{
-			char uuid[BROKER_GUID_SIZE];
-			memset(uuid, 0, BROKER_GUID_SIZE);
-			/*Codes_SRS_BROKER_17_020: [ The function shall create a unique ID used as a quit signal. ]*/
-			if (UniqueId_Generate(uuid, BROKER_GUID_SIZE) != UNIQUEID_OK)
+			module_info->quit_message_guid = STRING_construct(uuid);
+			if (module_info->quit_message_guid == NULL)
 			{
 				/*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-				LogError("Lock_Init for socket lock failed");
-				Lock_Deinit(module_info->socket_lock);
+				LogError("String construct failed for module guid");
 				result = BROKER_ERROR;
 			}
 			else
 			{
-				module_info->quit_message_guid = STRING_construct(uuid);
-				if (module_info->quit_message_guid == NULL)
+				/*Codes_SRS_BROKER_13_114: [The function shall use the queue's max_bytes, when `options` is not NULL and it is not 0, as the receive buffer size of the module's socket.]*/
+				/*nanomsg sockets cannot be bounded by message count, max_depth is only used by the lossless modules*/
+				if (options == NULL || options->queue.max_bytes == 0)
 				{
-					/*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
-					LogError("String construct failed for module guid");
-					Lock_Deinit(module_info->socket_lock);
-					result = BROKER_ERROR;
+					module_info->receive_buffer_size = 0;
 				}
 				else
 				{
-					result = BROKER_OK;
+					module_info->receive_buffer_size = (options->queue.max_bytes > INT_MAX) ? INT_MAX : (int)options->queue.max_bytes;
+				}
+				/*Codes_SRS_BROKER_13_169: [ The function shall copy the thread options of options, when options is not NULL, to BROKER_MODULEINFO::thread_options, and set them to 0 otherwise. ]*/
+				if (options == NULL)
+				{
+					(void)memset(&module_info->thread_options, 0, sizeof(BROKER_THREAD_OPTIONS));
+				}
+				else
+				{
+					module_info->thread_options = options->thread;
+				}
+				/*Codes_SRS_BROKER_13_140: [ The function shall set BROKER_MODULEINFO::delivery_counters to 0. ]*/
+				(void)memset(&module_info->delivery_counters, 0, sizeof(BROKER_DELIVERY_COUNTERS));
+				module_info->links = NULL;
+				module_info->next_publisher = NULL;
+				module_info->broker_data = NULL;
+				/*Codes_SRS_BROKER_13_156: [ If options is not NULL, the queue's policy is BROKER_QUEUE_BLOCK and its max_depth is not 0, the function shall bound the messages of every source in flight to the module to max_depth. ]*/
+				if (options != NULL && options->queue.policy == BROKER_QUEUE_BLOCK && options->queue.max_depth != 0)
+				{
+					module_info->max_in_flight = options->queue.max_depth;
+					module_info->block_timeout_ms = options->queue.block_timeout_ms;
 				}
+				else
+				{
+					module_info->max_in_flight = 0;
+					module_info->block_timeout_ms = 0;
+				}
+				result = BROKER_OK;
 			}
 		}
 	}
@@ -356,8 +833,22 @@ static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* m
 static void deinit_module(BROKER_MODULEINFO* module_info)
 {
     /*Codes_SRS_BROKER_13_057: [The function shall free all members of the MODULE_INFO object.]*/
-	Lock_Deinit(module_info->socket_lock);
 	STRING_delete(module_info->quit_message_guid);
+	while (module_info->links != NULL)
+	{
+		BROKER_LINK_TRAFFIC* next = module_info->links->next;
+		/*Codes_SRS_BROKER_13_179: [ The function shall destroy the filters of the links to the module, and the filters they replaced, by calling LinkFilter_Destroy. ]*/
+		LinkFilter_Destroy(module_info->links->filter);
+		while (module_info->links->retired_filters != NULL)
+		{
+			BROKER_RETIRED_FILTER* next_retired = module_info->links->retired_filters->next;
+			LinkFilter_Destroy(module_info->links->retired_filters->filter);
+			free(module_info->links->retired_filters);
+			module_info->links->retired_filters = next_retired;
+		}
+		free(module_info->links);
+		module_info->links = next;
+	}
 	free(module_info->module);
 }
 
@@ -398,6 +889,16 @@ static BROKER_RESULT start_module(BROKER_MODULEINFO* module_info, STRING_HANDLE
 				module_info->receive_socket = -1;
 				result = BROKER_ERROR;
 			}
+			/*Codes_SRS_BROKER_13_115: [If BROKER_MODULEINFO::receive_buffer_size is not 0, the function shall set it as the NN_RCVBUF option of the socket.]*/
+			else if (module_info->receive_buffer_size != 0 &&
+				nn_setsockopt(module_info->receive_socket, NN_SOL_SOCKET, NN_RCVBUF, &(module_info->receive_buffer_size), sizeof(int)) < 0)
+			{
+				/*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+				LogError("nn_setsockopt NN_RCVBUF failed");
+				nn_close(module_info->receive_socket);
+				module_info->receive_socket = -1;
+				result = BROKER_ERROR;
+			}
 			else
 			{
 				/*Codes_SRS_BROKER_13_102: [The function shall create a new thread for the module by calling ThreadAPI_Create using module_worker as the thread callback and using the newly allocated BROKER_MODULEINFO object as the thread context.*/
@@ -427,46 +928,19 @@ static BROKER_RESULT start_module(BROKER_MODULEINFO* module_info, STRING_HANDLE
 /*returns 0 if success, otherwise __LINE__*/
 static int stop_module(int publish_socket, BROKER_MODULEINFO* module_info)
 {
-    int  quit_result, close_result, thread_result, result;
+    int  quit_result, thread_result, result;
+
+	/*Codes_SRS_BROKER_02_001: [ This function shall set BROKER_MODULEINFO::quit_requested. ]*/
+	module_info->quit_requested = 1;
 
 	/*Codes_SRS_BROKER_17_021: [ This function shall send a quit signal to the worker thread by sending BROKER_MODULEINFO::quit_message_guid to the publish_socket. ]*/
-	/* send the unique quite id for this module */
+	/* send the unique quite id for this module, it wakes the thread up before its wait times out */
 	if ((quit_result = nn_send(publish_socket, STRING_c_str(module_info->quit_message_guid), BROKER_GUID_SIZE, 0)) < 0)
 	{
-		/*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
-		/* at the cost of a data race, we will close the socket to terminate the thread */
-		nn_close(module_info->receive_socket);
-		LogError("unable to peacefully close thread for module [%p], nn_send error [%d], taking harsher methods", module_info, quit_result);
-	}
-	else
-	{
-		/*Codes_SRS_BROKER_02_001: [ Broker_RemoveModule shall lock BROKER_MODULEINFO::socket_lock. ]*/
-		if (Lock(module_info->socket_lock) != LOCK_OK)
-		{
-			/*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
-			/* at the cost of a data race, we will close the socket to terminate the thread */
-			nn_close(module_info->receive_socket);
-			LogError("unable to peacefully close thread for module [%p], Lock error, taking harsher methods", module_info );
-		}
-		else
-		{
-			/*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
-			close_result = nn_close(module_info->receive_socket);
-			if (close_result < 0)
-			{
-				LogError("Receive socket close failed for module at  item [%p] failed", module_info);
-			}
-			else
-			{
-				/*all is fine, thread will eventually stop and be joined*/
-			}
-			/*Codes_SRS_BROKER_02_003: [ After closing the socket, Broker_RemoveModule shall unlock BROKER_MODULEINFO::info_lock. ]*/
-			if (Unlock(module_info->socket_lock) != LOCK_OK)
-			{
-				LogError("unable to unlock socket lock");
-			}
-		}
+		/*Codes_SRS_BROKER_02_003: [ If sending the quit signal fails, the thread shall stop once its wait on the receive_socket times out. ]*/
+		LogError("unable to send the quit signal to module [%p], nn_send error [%d], waiting for the thread to time out", module_info, quit_result);
 	}
+
 	/*Codes_SRS_BROKER_13_104: [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]*/
 	if (ThreadAPI_Join(module_info->thread, &thread_result) != THREADAPI_OK)
 	{
@@ -477,16 +951,143 @@ static int stop_module(int publish_socket, BROKER_MODULEINFO* module_info)
 	{
 		result = 0;
 	}
+
+	/*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket once the thread is joined. ]*/
+	if (nn_close(module_info->receive_socket) < 0)
+	{
+		LogError("Receive socket close failed for module at  item [%p] failed", module_info);
+	}
     return result;
 }
 
-BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
+/*finds the numbering of the messages published by source; the entries are only prepended*/
+static BROKER_SOURCE* find_source(BROKER_HANDLE_DATA* broker_data, MODULE_HANDLE source)
 {
-    BROKER_RESULT result;
-
-    /*Codes_SRS_BROKER_99_013: [If `broker` or `module` is NULL the function shall return BROKER_INVALIDARG.]*/
-    if (broker == NULL || module == NULL)
-    {
+	BROKER_SOURCE* result;
+	for (result = broker_data->sources; result != NULL; result = result->next)
+	{
+		if (result->source == source)
+		{
+			break;
+		}
+	}
+	return result;
+}
+
+/*adds the numbering of the messages published by source unless the module has been started before; the caller holds modules_lock*/
+static int add_source(BROKER_HANDLE_DATA* broker_data, MODULE_HANDLE source)
+{
+	int result;
+	/*Codes_SRS_BROKER_13_176: [ The first time a module handle is started on the broker, Broker_AddModuleWithOptions shall add to BROKER_HANDLE_DATA::sources an entry with a send_lock numbering the messages the module publishes; the entry is kept until the broker is destroyed. ]*/
+	/*only Broker_AddModuleWithOptions adds entries, under modules_lock*/
+	if (find_source(broker_data, source) != NULL)
+	{
+		result = 0;
+	}
+	else
+	{
+		BROKER_SOURCE* entry = (BROKER_SOURCE*)malloc(sizeof(BROKER_SOURCE));
+		if (entry == NULL)
+		{
+			LogError("malloc failed for the source of module [%p]", source);
+			result = __LINE__;
+		}
+		else if ((entry->send_lock = Lock_Init()) == NULL)
+		{
+			LogError("Lock_Init failed");
+			free(entry);
+			result = __LINE__;
+		}
+		else
+		{
+			entry->source = source;
+			entry->next_sequence = 0;
+			entry->next = broker_data->sources;
+			broker_data->sources = entry;
+			result = 0;
+		}
+	}
+	return result;
+}
+
+/*adds a started module to BROKER_HANDLE_DATA::publishers, creating space_cond with the first lossless module; the caller holds modules_lock*/
+static int add_publisher(BROKER_HANDLE_DATA* broker_data, BROKER_MODULEINFO* module_info)
+{
+	int result;
+	if (module_info->max_in_flight > 0 && broker_data->space_cond == NULL &&
+		(broker_data->space_cond = Condition_Init()) == NULL)
+	{
+		LogError("Condition_Init failed");
+		result = __LINE__;
+	}
+	else if (add_source(broker_data, module_info->module->module_handle) != 0)
+	{
+		LogError("unable to number the messages of module [%p]", module_info);
+		result = __LINE__;
+	}
+	else if (Lock(broker_data->publish_lock) != LOCK_OK)
+	{
+		LogError("unable to lock the publish lock");
+		result = __LINE__;
+	}
+	else
+	{
+		module_info->broker_data = broker_data;
+		module_info->next_publisher = broker_data->publishers;
+		broker_data->publishers = module_info;
+		if (module_info->max_in_flight > 0)
+		{
+			broker_data->lossless_module_count++;
+		}
+		(void)Unlock(broker_data->publish_lock);
+		result = 0;
+	}
+	return result;
+}
+
+/*removes a module from BROKER_HANDLE_DATA::publishers; the caller holds modules_lock*/
+static int remove_publisher(BROKER_HANDLE_DATA* broker_data, BROKER_MODULEINFO* module_info)
+{
+	int result;
+	if (Lock(broker_data->publish_lock) != LOCK_OK)
+	{
+		LogError("unable to lock the publish lock");
+		result = __LINE__;
+	}
+	else
+	{
+		BROKER_MODULEINFO** previous = &(broker_data->publishers);
+		while (*previous != NULL && *previous != module_info)
+		{
+			previous = &((*previous)->next_publisher);
+		}
+		if (*previous != NULL)
+		{
+			*previous = module_info->next_publisher;
+			if (module_info->max_in_flight > 0)
+			{
+				broker_data->lossless_module_count--;
+			}
+		}
+		(void)Unlock(broker_data->publish_lock);
+		result = 0;
+	}
+	return result;
+}
+
+BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
+{
+    /*Codes_SRS_BROKER_13_116: [Broker_AddModule shall behave as Broker_AddModuleWithOptions called with NULL options.]*/
+    return Broker_AddModuleWithOptions(broker, module, NULL);
+}
+
+BROKER_RESULT Broker_AddModuleWithOptions(BROKER_HANDLE broker, const MODULE* module, const BROKER_MODULE_OPTIONS* options)
+{
+    BROKER_RESULT result;
+
+    /*Codes_SRS_BROKER_99_013: [If `broker` or `module` is NULL the function shall return BROKER_INVALIDARG.]*/
+    if (broker == NULL || module == NULL)
+    {
         result = BROKER_INVALIDARG;
         LogError("invalid parameter (NULL).");
     }
@@ -515,7 +1116,7 @@ BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
         }
         else
         {
-            if (init_module(module_info, module) != BROKER_OK)
+            if (init_module(module_info, module, options) != BROKER_OK)
             {
                 /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
                 LogError("start_module failed");
@@ -557,6 +1158,19 @@ BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
                             free(module_info);
                             result = BROKER_ERROR;
                         }
+                        /*Codes_SRS_BROKER_13_155: [ Broker_AddModuleWithOptions shall add the started module to BROKER_HANDLE_DATA::publishers under BROKER_HANDLE_DATA::publish_lock, creating BROKER_HANDLE_DATA::space_cond with the first module whose messages in flight are bounded. ]*/
+                        else if (add_publisher(broker_data, module_info) != 0)
+                        {
+                            /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                            LogError("unable to add the module to the publishers");
+                            if (stop_module(broker_data->publish_socket, module_info) == 0)
+                            {
+                                deinit_module(module_info);
+                                free(module_info);
+                            }
+                            list_remove(broker_data->modules, moduleListItem);
+                            result = BROKER_ERROR;
+                        }
                         else
                         {
                             /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
@@ -619,19 +1233,29 @@ BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* module)
             else
             {
                 BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)list_item_get_value(module_info_item);
-                if (stop_module(broker_data->publish_socket, module_info) == 0)
+                if (stop_module(broker_data->publish_socket, module_info) != 0)
                 {
-                    deinit_module(module_info);
+                    LogError("unable to stop module");
+                    /*Codes_SRS_BROKER_13_052: [The function shall remove the module from BROKER_HANDLE_DATA::modules.]*/
+                    list_remove(broker_data->modules, module_info_item);
+                    free(module_info);
+                }
+                /*Codes_SRS_BROKER_13_157: [ Broker_RemoveModule shall remove the module from BROKER_HANDLE_DATA::publishers under BROKER_HANDLE_DATA::publish_lock after its thread has exited and before freeing it. ]*/
+                else if (remove_publisher(broker_data, module_info) != 0)
+                {
+                    /*the publishers may still read the module, it is leaked*/
+                    LogError("unable to remove the module from the publishers");
+                    /*Codes_SRS_BROKER_13_052: [The function shall remove the module from BROKER_HANDLE_DATA::modules.]*/
+                    list_remove(broker_data->modules, module_info_item);
                 }
                 else
                 {
-                    LogError("unable to stop module");
+                    deinit_module(module_info);
+                    /*Codes_SRS_BROKER_13_052: [The function shall remove the module from BROKER_HANDLE_DATA::modules.]*/
+                    list_remove(broker_data->modules, module_info_item);
+                    free(module_info);
                 }
 
-                /*Codes_SRS_BROKER_13_052: [The function shall remove the module from BROKER_HANDLE_DATA::modules.]*/
-                list_remove(broker_data->modules, module_info_item);
-                free(module_info);
-
                 /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
                 result = BROKER_OK;
             }
@@ -663,6 +1287,218 @@ BROKER_MODULEINFO* broker_locate_handle(BROKER_HANDLE_DATA* broker_data, MODULE_
 	return result;
 }
 
+/*finds the traffic of the links from source to the module; the caller holds modules_lock or publish_lock, the entries are only prepended*/
+static BROKER_LINK_TRAFFIC* find_link_traffic(BROKER_MODULEINFO* module_info, MODULE_HANDLE source)
+{
+	BROKER_LINK_TRAFFIC* result;
+	for (result = module_info->links; result != NULL; result = result->next)
+	{
+		if (result->source == source)
+		{
+			break;
+		}
+	}
+	return result;
+}
+
+/*finds or creates the traffic of the links from source to the module, without adding a link; the caller holds modules_lock*/
+static BROKER_LINK_TRAFFIC* get_link_traffic(BROKER_MODULEINFO* module_info, MODULE_HANDLE source)
+{
+	BROKER_LINK_TRAFFIC* result = find_link_traffic(module_info, source);
+	if (result == NULL)
+	{
+		result = (BROKER_LINK_TRAFFIC*)malloc(sizeof(BROKER_LINK_TRAFFIC));
+		if (result == NULL)
+		{
+			LogError("malloc failed");
+		}
+		else
+		{
+			(void)memset(result, 0, sizeof(BROKER_LINK_TRAFFIC));
+			result->source = source;
+			result->next = module_info->links;
+			/*the entry is complete before module_worker can see it*/
+			module_info->links = result;
+		}
+	}
+	return result;
+}
+
+/*returns nonzero when the links of traffic use the filter compiled from definition*/
+static int has_link_filter(const BROKER_LINK_TRAFFIC* traffic, const BROKER_LINK_FILTER* definition)
+{
+	return (traffic->filter == NULL && definition == NULL) || LinkFilter_IsSameAs(traffic->filter, definition);
+}
+
+/*makes the links of traffic use the filter compiled from definition, keeping the filter it replaces since module_worker may be testing a message with it; the caller holds modules_lock and the link count is 0*/
+static int set_link_filter(BROKER_LINK_TRAFFIC* traffic, const BROKER_LINK_FILTER* definition)
+{
+	int result;
+	if (has_link_filter(traffic, definition))
+	{
+		result = 0;
+	}
+	else
+	{
+		LINK_FILTER_HANDLE filter = NULL;
+		BROKER_RETIRED_FILTER* retired = NULL;
+		if (definition != NULL && (filter = LinkFilter_Create(definition)) == NULL)
+		{
+			LogError("unable to create the filter of the link");
+			result = __LINE__;
+		}
+		else if (traffic->filter != NULL && (retired = (BROKER_RETIRED_FILTER*)malloc(sizeof(BROKER_RETIRED_FILTER))) == NULL)
+		{
+			LogError("unable to retire the previous filter of the link");
+			LinkFilter_Destroy(filter);
+			result = __LINE__;
+		}
+		else
+		{
+			if (retired != NULL)
+			{
+				retired->filter = traffic->filter;
+				retired->next = traffic->retired_filters;
+				traffic->retired_filters = retired;
+			}
+			/*the filter is complete before module_worker can see it*/
+			traffic->filter = filter;
+			result = 0;
+		}
+	}
+	return result;
+}
+
+/*finds a lossless module linked from the source that has no room for count more of its messages; the caller holds publish_lock*/
+static BROKER_MODULEINFO* find_full_sink(BROKER_HANDLE_DATA* broker_data, const BROKER_SOURCE* source_entry, size_t count)
+{
+	BROKER_MODULEINFO* result;
+	for (result = broker_data->publishers; result != NULL; result = result->next_publisher)
+	{
+		if (result->max_in_flight > 0)
+		{
+			BROKER_LINK_TRAFFIC* traffic = find_link_traffic(result, source_entry->source);
+			/*the messages in flight are only known once the sink has received a frame of the source*/
+			if (traffic != NULL && traffic->link_count > 0 && traffic->sequence_synced)
+			{
+				int32_t in_flight = (int32_t)(source_entry->next_sequence - traffic->next_sequence);
+				if (in_flight > 0 && (size_t)in_flight + count > result->max_in_flight)
+				{
+					break;
+				}
+			}
+		}
+	}
+	return result;
+}
+
+/*numbers and sends a frame of count messages published by source; the frame is freed unless it is sent*/
+static BROKER_RESULT send_numbered_frame(BROKER_HANDLE_DATA* broker_data, BROKER_SOURCE* source_entry, void* nn_msg, size_t buf_size, size_t count)
+{
+	BROKER_RESULT result;
+	/*Codes_SRS_BROKER_13_158: [ Broker_Publish and Broker_PublishBatch shall hold the send_lock of the source while they number and send the frame. ]*/
+	if (source_entry != NULL && Lock(source_entry->send_lock) != LOCK_OK)
+	{
+		LogError("unable to lock the send lock of module [%p]", source_entry->source);
+		nn_freemsg(nn_msg);
+		result = BROKER_ERROR;
+	}
+	else
+	{
+		/*Codes_SRS_BROKER_13_165: [ Broker_Publish and Broker_PublishBatch shall write after the source the sequence number of the first message of the frame among the messages published by the source, 0 for a source that has never been attached to the broker. ]*/
+		uint32_t sequence = (source_entry == NULL) ? 0 : source_entry->next_sequence;
+		memcpy((unsigned char*)nn_msg + sizeof(MODULE_HANDLE), &sequence, sizeof(uint32_t));
+
+		/*Codes_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ]*/
+		/*Codes_SRS_BROKER_13_133: [ Broker_PublishBatch shall send the whole batch with one call to nn_send on the publish_socket. ]*/
+		if (nn_send(broker_data->publish_socket, &nn_msg, NN_MSG, 0) != (int)buf_size)
+		{
+			LogError("unable to send a frame of %zu messages", count);
+			nn_freemsg(nn_msg);
+			result = BROKER_ERROR;
+		}
+		else
+		{
+			if (source_entry != NULL)
+			{
+				source_entry->next_sequence = sequence + (uint32_t)count;
+			}
+			result = BROKER_OK;
+		}
+
+		if (source_entry != NULL)
+		{
+			(void)Unlock(source_entry->send_lock);
+		}
+	}
+	return result;
+}
+
+/*numbers and sends a frame of count messages published by source, waiting for room at the lossless modules; the frame is freed unless it is sent*/
+static BROKER_RESULT send_frame(BROKER_HANDLE_DATA* broker_data, MODULE_HANDLE source, void* nn_msg, size_t buf_size, size_t count)
+{
+	BROKER_RESULT result;
+	BROKER_SOURCE* source_entry = find_source(broker_data, source);
+	/*Codes_SRS_BROKER_13_175: [ Broker_Publish and Broker_PublishBatch shall only acquire BROKER_HANDLE_DATA::publish_lock when a module whose messages in flight are bounded is attached to the broker. ]*/
+	if (source_entry == NULL || broker_data->lossless_module_count == 0)
+	{
+		result = send_numbered_frame(broker_data, source_entry, nn_msg, buf_size, count);
+	}
+	else if (Lock(broker_data->publish_lock) != LOCK_OK)
+	{
+		LogError("unable to lock the publish lock");
+		nn_freemsg(nn_msg);
+		result = BROKER_ERROR;
+	}
+	else
+	{
+		BROKER_MODULEINFO* full_sink = find_full_sink(broker_data, source_entry, count);
+		/*a timeout of 0 would make Condition_Wait wait forever*/
+		if (full_sink != NULL && full_sink->block_timeout_ms > 0)
+		{
+			/*Codes_SRS_BROKER_13_159: [ If a lossless module linked from the source has max_depth messages of the source in flight, Broker_Publish and Broker_PublishBatch shall wait on BROKER_HANDLE_DATA::space_cond until there is room or the block_timeout_ms of that module has elapsed since they started waiting. ]*/
+			uint64_t deadline = BrokerStatistics_GetTime() + (uint64_t)full_sink->block_timeout_ms * 1000;
+			int timeout_ms = (int)full_sink->block_timeout_ms;
+			while (full_sink != NULL && timeout_ms > 0)
+			{
+				COND_RESULT wait_result;
+				broker_data->space_waiters++;
+				wait_result = Condition_Wait(broker_data->space_cond, broker_data->publish_lock, timeout_ms);
+				broker_data->space_waiters--;
+				full_sink = find_full_sink(broker_data, source_entry, count);
+				if (wait_result != COND_OK)
+				{
+					if (wait_result != COND_TIMEOUT)
+					{
+						LogError("Condition_Wait failed for module [%p]", full_sink);
+					}
+					break;
+				}
+				else
+				{
+					/*the post may have been for another sink or taken by another publisher*/
+					uint64_t now = BrokerStatistics_GetTime();
+					timeout_ms = (now >= deadline) ? 0 : (int)((deadline - now + 999) / 1000);
+				}
+			}
+		}
+
+		if (full_sink != NULL)
+		{
+			/*Codes_SRS_BROKER_13_160: [ If there is still no room, Broker_Publish and Broker_PublishBatch shall not send the frame and shall return BROKER_BUSY. ]*/
+			nn_freemsg(nn_msg);
+			result = BROKER_BUSY;
+		}
+		else
+		{
+			/*publish_lock is held while the frame is numbered so that the messages in flight do not change under the check*/
+			result = send_numbered_frame(broker_data, source_entry, nn_msg, buf_size, count);
+		}
+		(void)Unlock(broker_data->publish_lock);
+	}
+	return result;
+}
+
 BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
 {
 	BROKER_RESULT result;
@@ -697,26 +1533,51 @@ BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
 			{
 				/*Codes_SRS_BROKER_17_041: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->module_source_handle. ]*/
 				BROKER_MODULEINFO* source_module = broker_locate_handle(broker_data, link->module_source_handle);
+				BROKER_LINK_TRAFFIC* traffic;
 
 				if (source_module == NULL)
 				{
 					LogError("Link->source is not attached to the broker");
 					result = BROKER_ADD_LINK_ERROR;
 				}
+				/*Codes_SRS_BROKER_13_147: [ Broker_AddLink shall find or allocate the BROKER_LINK_TRAFFIC of link->module_source_handle in BROKER_MODULEINFO::links of the sink before subscribing. ]*/
+				else if ((traffic = get_link_traffic(module_info, link->module_source_handle)) == NULL)
+				{
+					/*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
+					LogError("unable to create the counters of the link");
+					result = BROKER_ADD_LINK_ERROR;
+				}
+				else if (traffic->link_count > 0 && !has_link_filter(traffic, link->filter))
+				{
+					/*Codes_SRS_BROKER_13_137: [ If the link already exists and LinkFilter_IsSameAs tells that its filter is not link->filter, Broker_AddLink shall return BROKER_ADD_LINK_ERROR without subscribing. ]*/
+					LogError("the link already exists with another filter");
+					result = BROKER_ADD_LINK_ERROR;
+				}
+				/*Codes_SRS_BROKER_13_177: [ If the link count of the BROKER_LINK_TRAFFIC is 0 and link->filter is not the filter of its previous links, Broker_AddLink shall compile link->filter by calling LinkFilter_Create before subscribing, and keep the filter it replaces until the sink is removed. ]*/
+				else if (traffic->link_count == 0 && set_link_filter(traffic, link->filter) != 0)
+				{
+					/*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
+					result = BROKER_ADD_LINK_ERROR;
+				}
+				/*Codes_SRS_BROKER_17_032: [ Broker_AddLink shall subscribe module_info->receive_socket to the link->source module handle. ]*/
+				else if (nn_setsockopt(
+					module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, &(link->module_source_handle), sizeof(MODULE_HANDLE)) < 0)
+				{
+					/*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
+					LogError("Unable to make link in Broker");
+					result = BROKER_ADD_LINK_ERROR;
+				}
 				else
 				{
-					/*Codes_SRS_BROKER_17_032: [ Broker_AddLink shall subscribe module_info->receive_socket to the link->source module handle. ]*/
-					if (nn_setsockopt(
-						module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, &(link->module_source_handle), sizeof(MODULE_HANDLE)) < 0)
+					/*Codes_SRS_BROKER_13_148: [ Broker_AddLink shall increment the link count of the BROKER_LINK_TRAFFIC, and reset its counters and the sequence number it expects when the count was 0. ]*/
+					if (traffic->link_count == 0)
 					{
-						/*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
-						LogError("Unable to make link in Broker");
-						result = BROKER_ADD_LINK_ERROR;
-					}
-					else
-					{
-						result = BROKER_OK;
+						(void)memset(&traffic->counters, 0, sizeof(BROKER_LINK_COUNTERS));
+						/*the frames of the source missed while unlinked are not dropped*/
+						traffic->sequence_synced = false;
 					}
+					traffic->link_count++;
+					result = BROKER_OK;
 				}
 			}
 			/*Codes_SRS_BROKER_17_033: [ Broker_AddLink shall unlock the modules_lock. ]*/
@@ -777,6 +1638,12 @@ BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* li
 					}
 					else
 					{
+						/*Codes_SRS_BROKER_13_149: [ Broker_RemoveLink shall decrement the link count of the BROKER_LINK_TRAFFIC of link->module_source_handle in BROKER_MODULEINFO::links of the sink. ]*/
+						BROKER_LINK_TRAFFIC* traffic = find_link_traffic(module_info, link->module_source_handle);
+						if (traffic != NULL && traffic->link_count > 0)
+						{
+							traffic->link_count--;
+						}
 						result = BROKER_OK;
 					}
 				}
@@ -807,6 +1674,18 @@ static void broker_decrement_ref(BROKER_HANDLE broker)
 			STRING_delete(broker_data->url);
             list_destroy(broker_data->modules);
             Lock_Deinit(broker_data->modules_lock);
+            Lock_Deinit(broker_data->publish_lock);
+            while (broker_data->sources != NULL)
+            {
+                BROKER_SOURCE* source_entry = broker_data->sources;
+                broker_data->sources = source_entry->next;
+                Lock_Deinit(source_entry->send_lock);
+                free(source_entry);
+            }
+            if (broker_data->space_cond != NULL)
+            {
+                Condition_Deinit(broker_data->space_cond);
+            }
             free(broker_data);
         }
     }
@@ -839,72 +1718,284 @@ BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE
     else
     {
 		BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
-		/*Codes_SRS_BROKER_17_022: [ Broker_Publish shall Lock the modules lock. ]*/
-		if (Lock(broker_data->modules_lock) != LOCK_OK)
+		/*Codes_SRS_BROKER_13_136: [ Broker_Publish and Broker_PublishBatch shall not acquire BROKER_HANDLE_DATA::modules_lock, they only hold the send_lock of the source to number and send the frame, and BROKER_HANDLE_DATA::publish_lock while a lossless module is attached. ]*/
+		int32_t msg_size;
+		int32_t buf_size;
+		/*Codes_SRS_BROKER_17_007: [ Broker_Publish shall clone the message. ]*/
+		MESSAGE_HANDLE msg = Message_Clone(message);
+		/*Codes_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message. ]*/
+		/*Codes_SRS_BROKER_13_121: [ Broker_Publish shall serialize the message with MESSAGE_WIRE_FORMAT_V2. ]*/
+		msg_size = Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, NULL, 0);
+		if (msg_size < 0)
 		{
 			/*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-			LogError("Lock on broker_data->modules_lock failed");
+			LogError("unable to serialize a message [%p]", msg);
+			Message_Destroy(msg);
 			result = BROKER_ERROR;
 		}
 		else
 		{
-			int32_t msg_size;
-			int32_t buf_size;
-			/*Codes_SRS_BROKER_17_007: [ Broker_Publish shall clone the message. ]*/
-			MESSAGE_HANDLE msg = Message_Clone(message);
-			/*Codes_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message. ]*/
-			msg_size = Message_ToByteArray(message, NULL, 0);
-			if (msg_size < 0)
+			/*Codes_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE) + sizeof(uint32_t). ]*/
+			buf_size = msg_size + FRAME_HEADER_SIZE;
+			void* nn_msg = nn_allocmsg(buf_size, 0);
+			if (nn_msg == NULL)
 			{
 				/*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
 				LogError("unable to serialize a message [%p]", msg);
-				Message_Destroy(msg);
 				result = BROKER_ERROR;
 			}
 			else
 			{
-				/*Codes_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE). ]*/
-				buf_size = msg_size + sizeof(MODULE_HANDLE);
-				void* nn_msg = nn_allocmsg(buf_size, 0);
-				if (nn_msg == NULL)
-				{
-					/*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-					LogError("unable to serialize a message [%p]", msg);
-					result = BROKER_ERROR;
-				}
-				else
-				{
-					/*Codes_SRS_BROKER_17_026: [ Broker_Publish shall copy source into the beginning of the nanomsg buffer. ]*/
-					unsigned char *nn_msg_bytes = (unsigned char *)nn_msg;
-					memcpy(nn_msg_bytes, &source, sizeof(MODULE_HANDLE));
-					/*Codes_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ]*/
-					nn_msg_bytes += sizeof(MODULE_HANDLE);
-					Message_ToByteArray(message, nn_msg_bytes, msg_size);
+				/*Codes_SRS_BROKER_17_026: [ Broker_Publish shall copy source into the beginning of the nanomsg buffer. ]*/
+				unsigned char *nn_msg_bytes = (unsigned char *)nn_msg;
+				memcpy(nn_msg_bytes, &source, sizeof(MODULE_HANDLE));
+				/*Codes_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ]*/
+				nn_msg_bytes += FRAME_HEADER_SIZE;
+				Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, nn_msg_bytes, msg_size);
 
-					/*Codes_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ]*/
-					int nbytes = nn_send(broker_data->publish_socket, &nn_msg, NN_MSG, 0);
-					if (nbytes != buf_size)
-					{
-						/*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-						LogError("unable to send a message [%p]", msg);
-						/*Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]*/
-						nn_freemsg(nn_msg);
-						result = BROKER_ERROR;
-					}
-					else
-					{
-						result = BROKER_OK;
-					}
-				}
-				/*Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]*/
-				Message_Destroy(msg);
-				/*Codes_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ]*/
+				/*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+				result = send_frame(broker_data, source, nn_msg, (size_t)buf_size, 1);
 			}
-			/*Codes_SRS_BROKER_17_023: [ Broker_Publish shall Unlock the modules lock. ]*/
-			Unlock(broker_data->modules_lock);
+			/*Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]*/
+			Message_Destroy(msg);
+			/*Codes_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ]*/
 		}
 
     }
 	/*Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
     return result;
-}
\ No newline at end of file
+}
+BROKER_RESULT Broker_PublishBatch(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_BATCH_HANDLE batch)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_13_122: [ If broker, source or batch is NULL the function shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || source == NULL || batch == NULL)
+    {
+        result = BROKER_INVALIDARG;
+        LogError("Broker handle, source, and/or batch handle is NULL");
+    }
+    else
+    {
+        size_t count = MessageBatch_GetCount(batch);
+        if (count == 0)
+        {
+            /*Codes_SRS_BROKER_13_130: [ If the batch is empty the function shall return BROKER_OK without sending anything. ]*/
+            result = BROKER_OK;
+        }
+        else if (count > INT32_MAX)
+        {
+            LogError("batch of %zu messages is too large", count);
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+            /*Codes_SRS_BROKER_13_136: [ Broker_Publish and Broker_PublishBatch shall not acquire BROKER_HANDLE_DATA::modules_lock, they only hold the send_lock of the source to number and send the frame, and BROKER_HANDLE_DATA::publish_lock while a lossless module is attached. ]*/
+            const MESSAGE_HANDLE* messages = MessageBatch_GetMessages(batch);
+            /*Codes_SRS_BROKER_13_132: [ Broker_PublishBatch shall allocate one nanomsg buffer holding the source, the sequence number, the batch frame marker, the number of messages and, for every message, its size followed by the message serialized with MESSAGE_WIRE_FORMAT_V2. ]*/
+            size_t buf_size = BATCH_FRAME_HEADER_SIZE;
+            size_t i;
+            for (i = 0; i < count; i++)
+            {
+                int32_t msg_size = Message_ToByteArrayWithFormat(messages[i], MESSAGE_WIRE_FORMAT_V2, NULL, 0);
+                if (msg_size < 0 || (size_t)msg_size + sizeof(int32_t) > INT_MAX - buf_size)
+                {
+                    LogError("unable to serialize message %zu of a batch", i);
+                    break;
+                }
+                buf_size += sizeof(int32_t) + msg_size;
+            }
+
+            if (i < count)
+            {
+                /*Codes_SRS_BROKER_13_135: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                unsigned char* nn_msg = (unsigned char*)nn_allocmsg(buf_size, 0);
+                if (nn_msg == NULL)
+                {
+                    /*Codes_SRS_BROKER_13_135: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                    LogError("unable to allocate a batch frame of %zu bytes", buf_size);
+                    result = BROKER_ERROR;
+                }
+                else
+                {
+                    int32_t count32 = (int32_t)count;
+                    size_t position = BATCH_FRAME_HEADER_SIZE;
+                    memcpy(nn_msg, &source, sizeof(MODULE_HANDLE));
+                    nn_msg[FRAME_HEADER_SIZE] = BATCH_FRAME_MARKER;
+                    memcpy(nn_msg + FRAME_HEADER_SIZE + 1, &count32, sizeof(int32_t));
+                    for (i = 0; i < count; i++)
+                    {
+                        int32_t msg_size = Message_ToByteArrayWithFormat(messages[i], MESSAGE_WIRE_FORMAT_V2, nn_msg + position + sizeof(int32_t), (int32_t)(buf_size - position - sizeof(int32_t)));
+                        memcpy(nn_msg + position, &msg_size, sizeof(int32_t));
+                        position += sizeof(int32_t) + msg_size;
+                    }
+
+                    /*Codes_SRS_BROKER_13_135: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                    result = send_frame(broker_data, source, nn_msg, buf_size, count);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_GetStatistics(BROKER_HANDLE broker, BROKER_MODULE_STATISTICS* statistics, size_t* module_count)
+{
+	BROKER_RESULT result;
+	/*Codes_SRS_BROKER_13_141: [ If broker or module_count is NULL, or statistics is NULL and *module_count is not 0, Broker_GetStatistics shall return BROKER_INVALIDARG. ]*/
+	if (broker == NULL || module_count == NULL || (statistics == NULL && *module_count != 0))
+	{
+		LogError("invalid arg broker=%p statistics=%p module_count=%p", broker, statistics, module_count);
+		result = BROKER_INVALIDARG;
+	}
+	else
+	{
+		BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+		/*Codes_SRS_BROKER_13_142: [ Broker_GetStatistics shall lock BROKER_HANDLE_DATA::modules_lock, so that no module is removed while its counters are read. ]*/
+		if (Lock(broker_data->modules_lock) != LOCK_OK)
+		{
+			/*Codes_SRS_BROKER_13_145: [ If an underlying API call fails, Broker_GetStatistics shall return BROKER_ERROR. ]*/
+			LogError("Lock on broker_data->modules_lock failed");
+			result = BROKER_ERROR;
+		}
+		else
+		{
+			LIST_ITEM_HANDLE current_module;
+			size_t count = 0;
+
+			for (current_module = list_get_head_item(broker_data->modules);
+				current_module != NULL;
+				current_module = list_get_next_item(current_module))
+			{
+				if (count < *module_count)
+				{
+					BROKER_MODULEINFO* module_info = (BROKER_MODULEINFO*)list_item_get_value(current_module);
+					/*Codes_SRS_BROKER_13_143: [ Broker_GetStatistics shall fill the first *module_count elements of statistics with the BROKER_MODULEINFO::delivery_counters of the modules of BROKER_HANDLE_DATA::modules, read without acquiring any other lock, and report a queue depth, queued bytes and high-water mark of 0 because the queues are kept by nanomsg. ]*/
+#ifdef UWP_BINDING
+					BrokerStatistics_Fill(&statistics[count], (MODULE_HANDLE)module_info->module->module_instance, NULL, &module_info->delivery_counters);
+#else
+					BrokerStatistics_Fill(&statistics[count], module_info->module->module_handle, NULL, &module_info->delivery_counters);
+#endif // UWP_BINDING
+				}
+				count++;
+			}
+
+			/*Codes_SRS_BROKER_13_144: [ Broker_GetStatistics shall set *module_count to the number of modules of the broker, unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_OK. ]*/
+			*module_count = count;
+			if (Unlock(broker_data->modules_lock) != LOCK_OK)
+			{
+				LogError("unable to unlock modules_lock");
+			}
+			result = BROKER_OK;
+		}
+	}
+
+	return result;
+}
+
+BROKER_RESULT Broker_ApplyModuleThreadOptions(BROKER_HANDLE broker, MODULE_HANDLE module)
+{
+	BROKER_RESULT result;
+	/*Codes_SRS_BROKER_13_171: [ If broker or module is NULL, Broker_ApplyModuleThreadOptions shall return BROKER_INVALIDARG. ]*/
+	if (broker == NULL || module == NULL)
+	{
+		LogError("invalid arg broker=%p module=%p", broker, module);
+		result = BROKER_INVALIDARG;
+	}
+	else
+	{
+		BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+		/*Codes_SRS_BROKER_13_172: [ Broker_ApplyModuleThreadOptions shall lock BROKER_HANDLE_DATA::modules_lock and copy the BROKER_MODULEINFO::thread_options of module. ]*/
+		if (Lock(broker_data->modules_lock) != LOCK_OK)
+		{
+			/*Codes_SRS_BROKER_13_174: [ If the module was not added to the broker, the options cannot be applied or an underlying API call fails, Broker_ApplyModuleThreadOptions shall return BROKER_ERROR. ]*/
+			LogError("Lock on broker_data->modules_lock failed");
+			result = BROKER_ERROR;
+		}
+		else
+		{
+			BROKER_THREAD_OPTIONS thread_options;
+			BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, module);
+			if (module_info != NULL)
+			{
+				thread_options = module_info->thread_options;
+			}
+
+			if (Unlock(broker_data->modules_lock) != LOCK_OK)
+			{
+				LogError("unable to unlock modules_lock");
+			}
+
+			if (module_info == NULL)
+			{
+				/*Codes_SRS_BROKER_13_174: [ If the module was not added to the broker, the options cannot be applied or an underlying API call fails, Broker_ApplyModuleThreadOptions shall return BROKER_ERROR. ]*/
+				LogError("module [%p] was not added to the broker", module);
+				result = BROKER_ERROR;
+			}
+			/*Codes_SRS_BROKER_13_173: [ Broker_ApplyModuleThreadOptions shall apply the thread options to the calling thread by calling ThreadOptions_Apply after releasing the lock, and return BROKER_OK. ]*/
+			else if (ThreadOptions_Apply(&thread_options) != 0)
+			{
+				/*Codes_SRS_BROKER_13_174: [ If the module was not added to the broker, the options cannot be applied or an underlying API call fails, Broker_ApplyModuleThreadOptions shall return BROKER_ERROR. ]*/
+				LogError("unable to apply the thread options of module [%p]", module);
+				result = BROKER_ERROR;
+			}
+			else
+			{
+				result = BROKER_OK;
+			}
+		}
+	}
+
+	return result;
+}
+
+BROKER_RESULT Broker_GetLinkStatistics(BROKER_HANDLE broker, const BROKER_LINK_DATA* link, BROKER_LINK_STATISTICS* statistics)
+{
+	BROKER_RESULT result;
+	/*Codes_SRS_BROKER_13_150: [ If broker, link, link->module_source_handle, link->module_sink_handle or statistics is NULL, Broker_GetLinkStatistics shall return BROKER_INVALIDARG. ]*/
+	if (broker == NULL || link == NULL || link->module_source_handle == NULL || link->module_sink_handle == NULL || statistics == NULL)
+	{
+		LogError("invalid arg broker=%p link=%p statistics=%p", broker, link, statistics);
+		result = BROKER_INVALIDARG;
+	}
+	else
+	{
+		BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+		/*Codes_SRS_BROKER_13_151: [ Broker_GetLinkStatistics shall lock BROKER_HANDLE_DATA::modules_lock and find the BROKER_LINK_TRAFFIC of link->module_source_handle in BROKER_MODULEINFO::links of link->module_sink_handle. ]*/
+		if (Lock(broker_data->modules_lock) != LOCK_OK)
+		{
+			/*Codes_SRS_BROKER_13_153: [ If the link does not exist or an underlying API call fails, Broker_GetLinkStatistics shall return BROKER_ERROR. ]*/
+			LogError("Lock on broker_data->modules_lock failed");
+			result = BROKER_ERROR;
+		}
+		else
+		{
+			BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, link->module_sink_handle);
+			BROKER_LINK_TRAFFIC* traffic = (module_info == NULL) ? NULL : find_link_traffic(module_info, link->module_source_handle);
+			if (traffic == NULL || traffic->link_count == 0)
+			{
+				/*Codes_SRS_BROKER_13_153: [ If the link does not exist or an underlying API call fails, Broker_GetLinkStatistics shall return BROKER_ERROR. ]*/
+				LogError("Link does not exist in Broker");
+				result = BROKER_ERROR;
+			}
+			else
+			{
+				/*Codes_SRS_BROKER_13_152: [ Broker_GetLinkStatistics shall fill statistics by calling BrokerStatistics_FillLink with the counters of the BROKER_LINK_TRAFFIC, read without acquiring any other lock, and return BROKER_OK. ]*/
+				BROKER_LINK_COUNTERS link_counters = traffic->counters;
+				BrokerStatistics_FillLink(statistics, &link_counters);
+				result = BROKER_OK;
+			}
+
+			if (Unlock(broker_data->modules_lock) != LOCK_OK)
+			{
+				LogError("unable to unlock modules_lock");
+			}
+		}
+	}
+
+	return result;
+}
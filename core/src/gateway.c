@@ -1,6 +1,9 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#include <string.h>
+#include <limits.h>
+
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/macro_utils.h"
@@ -11,10 +14,45 @@
 #define MODULE_NAME_KEY "module name"
 #define MODULE_PATH_KEY "module path"
 #define ARG_KEY "args"
+#define MODULE_INSTANCES_KEY "instances"
+#define MODULE_PARTITION_KEY "partition key"
+
+#define QUEUE_KEY "queue"
+#define QUEUE_MAX_DEPTH_KEY "max depth"
+#define QUEUE_MAX_BYTES_KEY "max bytes"
+#define QUEUE_POLICY_KEY "policy"
+#define QUEUE_TIMEOUT_KEY "timeout"
+#define QUEUE_BATCH_SIZE_KEY "batch size"
+#define QUEUE_INLINE_KEY "inline"
+
+#define QUEUE_POLICY_DROP_NEWEST "drop newest"
+#define QUEUE_POLICY_DROP_OLDEST "drop oldest"
+#define QUEUE_POLICY_BLOCK "block"
+
+#define THREAD_KEY "thread"
+#define THREAD_NAME_KEY "name"
+#define THREAD_CPU_AFFINITY_KEY "cpu affinity"
+#define THREAD_POLICY_KEY "policy"
+#define THREAD_PRIORITY_KEY "priority"
+
+#define THREAD_POLICY_DEFAULT "default"
+#define THREAD_POLICY_FIFO "fifo"
+#define THREAD_POLICY_ROUND_ROBIN "round robin"
+
+/*number of processors BROKER_THREAD_OPTIONS::cpu_affinity can name*/
+#define THREAD_CPU_COUNT 64
+
+#define BROKER_KEY "broker"
+#define BROKER_WORKERS_KEY "workers"
 
 #define LINKS_KEY "links"
 #define SOURCE_KEY "source"
 #define SINK_KEY "sink"
+#define FILTER_KEY "filter"
+#define FILTER_PROPERTY_KEY "property"
+#define FILTER_EQUALS_KEY "equals"
+#define FILTER_PREFIX_KEY "prefix"
+#define FILTER_EXISTS_KEY "exists"
 
 #define PARSE_JSON_RESULT_VALUES \
     PARSE_JSON_SUCCESS, \
@@ -26,6 +64,10 @@
 DEFINE_ENUM(PARSE_JSON_RESULT, PARSE_JSON_RESULT_VALUES);
 
 static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties, JSON_Value *root);
+static PARSE_JSON_RESULT parse_module_options(JSON_Object* module, BROKER_MODULE_OPTIONS** out_options);
+static PARSE_JSON_RESULT parse_module_instances(JSON_Object* module, size_t* out_instances, const char** out_partition_key);
+static PARSE_JSON_RESULT parse_broker_options(JSON_Object* document, BROKER_OPTIONS** out_options);
+static PARSE_JSON_RESULT parse_link_filter(JSON_Object* route, BROKER_LINK_FILTER** out_filter);
 static void destroy_properties_internal(GATEWAY_PROPERTIES* properties);
 
 GATEWAY_HANDLE Gateway_Create_From_JSON(const char* file_path)
@@ -47,6 +89,7 @@ GATEWAY_HANDLE Gateway_Create_From_JSON(const char* file_path)
             {
 				properties->gateway_modules = NULL;
 				properties->gateway_links = NULL;
+				properties->broker_options = NULL;
                 if (parse_json_internal(properties, root_value) == PARSE_JSON_SUCCESS)
                 {
                     /*Codes_SRS_GATEWAY_14_007: [The function shall use the GATEWAY_PROPERTIES instance to create and return a GATEWAY_HANDLE using the lower level API.]*/
@@ -114,6 +157,10 @@ static void destroy_properties_internal(GATEWAY_PROPERTIES* properties)
 		{
 			GATEWAY_MODULES_ENTRY* element = (GATEWAY_MODULES_ENTRY*)VECTOR_element(properties->gateway_modules, element_index);
 			json_free_serialized_string((char*)(element->module_configuration));
+			if (element->module_options != NULL)
+			{
+				free((void*)element->module_options);
+			}
 		}
 
 		VECTOR_destroy(properties->gateway_modules);
@@ -122,9 +169,25 @@ static void destroy_properties_internal(GATEWAY_PROPERTIES* properties)
     
 	if (properties->gateway_links != NULL)
 	{
+		size_t vector_size = VECTOR_size(properties->gateway_links);
+		for (size_t element_index = 0; element_index < vector_size; ++element_index)
+		{
+			GATEWAY_LINK_ENTRY* element = (GATEWAY_LINK_ENTRY*)VECTOR_element(properties->gateway_links, element_index);
+			if (element->filter != NULL)
+			{
+				free((void*)element->filter);
+			}
+		}
+
 		VECTOR_destroy(properties->gateway_links);
 		properties->gateway_links = NULL;
 	}
+
+	if (properties->broker_options != NULL)
+	{
+		free((void*)properties->broker_options);
+		properties->broker_options = NULL;
+	}
 }
 
 static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties, JSON_Value *root)
@@ -155,24 +218,61 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
                         /*Codes_SRS_GATEWAY_14_005: [The function shall set the value of const void* module_properties in the GATEWAY_PROPERTIES instance to a char* representing the serialized args value for the particular module.]*/
                         JSON_Value *args = json_object_get_value(module, ARG_KEY);
                         char* args_str = json_serialize_to_string(args);
+                        BROKER_MODULE_OPTIONS* module_options;
 
-                        GATEWAY_MODULES_ENTRY entry = {
-                            module_name,
-                            module_path,
-                            args_str
-                        };
-
-                        /*Codes_SRS_GATEWAY_14_006: [The function shall return NULL if the JSON_Value contains incomplete information.]*/
-                        if (VECTOR_push_back(out_properties->gateway_modules, &entry, 1) == 0)
+                        /*Codes_SRS_GATEWAY_13_001: [The function shall set the module_options of the GATEWAY_MODULES_ENTRY from the module's "queue" and "thread" objects, or to NULL if the module has neither.]*/
+                        result = parse_module_options(module, &module_options);
+                        if (result != PARSE_JSON_SUCCESS)
                         {
-                            result = PARSE_JSON_SUCCESS;
+                            json_free_serialized_string(args_str);
+                            LogError("Failed to parse the broker options of the module.");
+                            break;
                         }
                         else
                         {
-                            json_free_serialized_string(args_str);
-                            result = PARSE_JSON_VECTOR_FAILURE;
-                            LogError("Failed to push data into properties vector.");
-                            break;
+                            size_t instances;
+                            const char* partition_key;
+
+                            /*Codes_SRS_GATEWAY_13_015: [The function shall set the instances and partition_key of the GATEWAY_MODULES_ENTRY from the module's "instances" and "partition key" values.]*/
+                            result = parse_module_instances(module, &instances, &partition_key);
+                            if (result != PARSE_JSON_SUCCESS)
+                            {
+                                json_free_serialized_string(args_str);
+                                if (module_options != NULL)
+                                {
+                                    free(module_options);
+                                }
+                                LogError("Failed to parse the instances of the module.");
+                                break;
+                            }
+                            else
+                            {
+                                GATEWAY_MODULES_ENTRY entry = {
+                                    module_name,
+                                    module_path,
+                                    args_str,
+                                    module_options,
+                                    instances,
+                                    partition_key
+                                };
+
+                                /*Codes_SRS_GATEWAY_14_006: [The function shall return NULL if the JSON_Value contains incomplete information.]*/
+                                if (VECTOR_push_back(out_properties->gateway_modules, &entry, 1) == 0)
+                                {
+                                    result = PARSE_JSON_SUCCESS;
+                                }
+                                else
+                                {
+                                    json_free_serialized_string(args_str);
+                                    if (module_options != NULL)
+                                    {
+                                        free(module_options);
+                                    }
+                                    result = PARSE_JSON_VECTOR_FAILURE;
+                                    LogError("Failed to push data into properties vector.");
+                                    break;
+                                }
+                            }
                         }
                     }
                     /*Codes_SRS_GATEWAY_14_006: [The function shall return NULL if the JSON_Value contains incomplete information.]*/
@@ -200,21 +300,38 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
 
 							if (module_source != NULL && module_sink != NULL)
 							{
-								GATEWAY_LINK_ENTRY entry = {
-									module_source,
-									module_sink
-								};
+								BROKER_LINK_FILTER* filter;
 
-								/* Codes_SRS_GATEWAY_04_002: [ The function shall add all modules source and sink to GATEWAY_PROPERTIES inside gateway_links. ] */
-								if (VECTOR_push_back(out_properties->gateway_links, &entry, 1) == 0)
+								/*Codes_SRS_GATEWAY_13_007: [The function shall set the filter of the GATEWAY_LINK_ENTRY from the link's "filter" array, or to NULL if the link has none.]*/
+								result = parse_link_filter(route, &filter);
+								if (result != PARSE_JSON_SUCCESS)
 								{
-									result = PARSE_JSON_SUCCESS;
+									LogError("Failed to parse the filter of the link.");
+									break;
 								}
 								else
 								{
-									result = PARSE_JSON_VECTOR_FAILURE;
-									LogError("Failed to push data into links vector.");
-									break;
+									GATEWAY_LINK_ENTRY entry = {
+										module_source,
+										module_sink,
+										filter
+									};
+
+									/* Codes_SRS_GATEWAY_04_002: [ The function shall add all modules source and sink to GATEWAY_PROPERTIES inside gateway_links. ] */
+									if (VECTOR_push_back(out_properties->gateway_links, &entry, 1) == 0)
+									{
+										result = PARSE_JSON_SUCCESS;
+									}
+									else
+									{
+										if (filter != NULL)
+										{
+											free(filter);
+										}
+										result = PARSE_JSON_VECTOR_FAILURE;
+										LogError("Failed to push data into links vector.");
+										break;
+									}
 								}
 							}
 							/*Codes_SRS_GATEWAY_14_006: [The function shall return NULL if the JSON_Value contains incomplete information.]*/
@@ -233,6 +350,22 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
 						LogError("Failed to create links vector. ");
 					}
 				}
+
+				if (result == PARSE_JSON_SUCCESS)
+				{
+					BROKER_OPTIONS* broker_options;
+
+					/*Codes_SRS_GATEWAY_13_005: [The function shall set the broker_options of the GATEWAY_PROPERTIES from the top level "broker" object, or to NULL if the configuration has none.]*/
+					result = parse_broker_options(json_document, &broker_options);
+					if (result == PARSE_JSON_SUCCESS)
+					{
+						out_properties->broker_options = broker_options;
+					}
+					else
+					{
+						LogError("Failed to parse the broker options.");
+					}
+				}
             }
 			/* Codes_SRS_GATEWAY_14_008: [ This function shall return NULL upon any memory allocation failure. ] */
             else
@@ -257,3 +390,419 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
     return result;
 }
 
+
+/*returns 0 and sets out_policy if policy names a queue policy, a missing policy meaning "drop newest"*/
+static int parse_queue_policy(const char* policy, BROKER_QUEUE_POLICY* out_policy)
+{
+    int result = 0;
+
+    if (policy == NULL || strcmp(policy, QUEUE_POLICY_DROP_NEWEST) == 0)
+    {
+        *out_policy = BROKER_QUEUE_DROP_NEWEST;
+    }
+    else if (strcmp(policy, QUEUE_POLICY_DROP_OLDEST) == 0)
+    {
+        *out_policy = BROKER_QUEUE_DROP_OLDEST;
+    }
+    else if (strcmp(policy, QUEUE_POLICY_BLOCK) == 0)
+    {
+        *out_policy = BROKER_QUEUE_BLOCK;
+    }
+    else
+    {
+        result = __LINE__;
+    }
+
+    return result;
+}
+
+static PARSE_JSON_RESULT parse_queue_options(JSON_Object* queue, BROKER_QUEUE_OPTIONS* out_queue)
+{
+    PARSE_JSON_RESULT result;
+
+    if (queue == NULL)
+    {
+        out_queue->max_depth = 0;
+        out_queue->max_bytes = 0;
+        out_queue->policy = BROKER_QUEUE_DROP_NEWEST;
+        out_queue->block_timeout_ms = 0;
+        out_queue->max_batch_size = 0;
+        out_queue->inline_delivery = 0;
+        result = PARSE_JSON_SUCCESS;
+    }
+    else
+    {
+        double max_depth = json_object_get_number(queue, QUEUE_MAX_DEPTH_KEY);
+        double max_bytes = json_object_get_number(queue, QUEUE_MAX_BYTES_KEY);
+        double timeout = json_object_get_number(queue, QUEUE_TIMEOUT_KEY);
+        double batch_size = json_object_get_number(queue, QUEUE_BATCH_SIZE_KEY);
+        const char* policy = json_object_get_string(queue, QUEUE_POLICY_KEY);
+        int inline_delivery = json_object_get_boolean(queue, QUEUE_INLINE_KEY);
+        BROKER_QUEUE_POLICY queue_policy;
+
+        /*Codes_SRS_GATEWAY_13_002: [The "max depth", "max bytes", "timeout" and "batch size" values of the "queue" object shall be non-negative numbers, a missing value meaning 0.]*/
+        if (max_depth < 0 || max_bytes < 0 || timeout < 0 || timeout > UINT_MAX || batch_size < 0)
+        {
+            result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+            LogError("\"queue\" limits must be non-negative numbers.");
+        }
+        /*Codes_SRS_GATEWAY_13_003: [The "policy" value of the "queue" object shall be "drop newest", "drop oldest" or "block", a missing value meaning "drop newest".]*/
+        else if (parse_queue_policy(policy, &queue_policy) != 0)
+        {
+            result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+            LogError("Unknown \"queue\" policy [%s].", policy);
+        }
+        /*Codes_SRS_GATEWAY_13_004: [The "block" policy shall require a "timeout" greater than 0.]*/
+        else if (queue_policy == BROKER_QUEUE_BLOCK && timeout < 1)
+        {
+            result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+            LogError("\"queue\" policy \"block\" requires a \"timeout\".");
+        }
+        else
+        {
+            out_queue->max_depth = (size_t)max_depth;
+            out_queue->max_bytes = (size_t)max_bytes;
+            out_queue->policy = queue_policy;
+            out_queue->block_timeout_ms = (unsigned int)timeout;
+            out_queue->max_batch_size = (size_t)batch_size;
+            /*Codes_SRS_GATEWAY_13_014: [The "inline" value of the "queue" object shall let the broker deliver the module's messages inline when it is true, a missing or non-boolean value meaning false.]*/
+            out_queue->inline_delivery = (inline_delivery == 1) ? 1 : 0;
+            result = PARSE_JSON_SUCCESS;
+        }
+    }
+
+    return result;
+}
+
+static int parse_thread_policy(const char* policy, BROKER_THREAD_POLICY* out_policy)
+{
+    int result = 0;
+
+    if (policy == NULL || strcmp(policy, THREAD_POLICY_DEFAULT) == 0)
+    {
+        *out_policy = BROKER_THREAD_POLICY_DEFAULT;
+    }
+    else if (strcmp(policy, THREAD_POLICY_FIFO) == 0)
+    {
+        *out_policy = BROKER_THREAD_POLICY_FIFO;
+    }
+    else if (strcmp(policy, THREAD_POLICY_ROUND_ROBIN) == 0)
+    {
+        *out_policy = BROKER_THREAD_POLICY_ROUND_ROBIN;
+    }
+    else
+    {
+        result = __LINE__;
+    }
+
+    return result;
+}
+
+static int parse_cpu_affinity(JSON_Array* cpus, uint64_t* out_affinity)
+{
+    int result;
+
+    *out_affinity = 0;
+    if (cpus == NULL)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t cpu_count = json_array_get_count(cpus);
+        if (cpu_count == 0)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            result = 0;
+            for (size_t cpu_index = 0; cpu_index < cpu_count; ++cpu_index)
+            {
+                double cpu = json_array_get_number(cpus, cpu_index);
+                if (cpu < 0 || cpu >= THREAD_CPU_COUNT || cpu != (double)(int)cpu)
+                {
+                    result = __LINE__;
+                    break;
+                }
+                *out_affinity |= (uint64_t)1 << (int)cpu;
+            }
+        }
+    }
+
+    return result;
+}
+
+static PARSE_JSON_RESULT parse_thread_options(JSON_Object* thread, BROKER_THREAD_OPTIONS* out_thread)
+{
+    PARSE_JSON_RESULT result;
+
+    (void)memset(out_thread, 0, sizeof(BROKER_THREAD_OPTIONS));
+    if (thread == NULL)
+    {
+        result = PARSE_JSON_SUCCESS;
+    }
+    else
+    {
+        const char* name = json_object_get_string(thread, THREAD_NAME_KEY);
+        JSON_Array* cpus = json_object_get_array(thread, THREAD_CPU_AFFINITY_KEY);
+        const char* policy = json_object_get_string(thread, THREAD_POLICY_KEY);
+        double priority = json_object_get_number(thread, THREAD_PRIORITY_KEY);
+
+        /*Codes_SRS_GATEWAY_13_013: [The "name" value of the "thread" object shall be a string shorter than BROKER_THREAD_NAME_SIZE characters, a missing value keeping the names of the threads.]*/
+        if (name != NULL && strlen(name) >= BROKER_THREAD_NAME_SIZE)
+        {
+            result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+            LogError("\"thread\" name [%s] is longer than %d characters.", name, BROKER_THREAD_NAME_SIZE - 1);
+        }
+        /*Codes_SRS_GATEWAY_13_011: [The "cpu affinity" value of the "thread" object shall be a non-empty array of processor indices from 0 to 63, a missing value meaning any processor.]*/
+        else if (parse_cpu_affinity(cpus, &out_thread->cpu_affinity) != 0)
+        {
+            result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+            LogError("\"thread\" cpu affinity must list processors from 0 to %d.", THREAD_CPU_COUNT - 1);
+        }
+        /*Codes_SRS_GATEWAY_13_012: [The "policy" value of the "thread" object shall be "default", "fifo" or "round robin", a missing value meaning "default", and its "priority" value shall be an integer, a missing value meaning 0.]*/
+        else if (parse_thread_policy(policy, &out_thread->policy) != 0)
+        {
+            result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+            LogError("Unknown \"thread\" policy [%s].", policy);
+        }
+        else if (priority < INT_MIN || priority > INT_MAX || priority != (double)(int)priority)
+        {
+            result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+            LogError("\"thread\" priority must be an integer.");
+        }
+        else
+        {
+            out_thread->priority = (int)priority;
+            if (name != NULL)
+            {
+                (void)strcpy(out_thread->name, name);
+            }
+            result = PARSE_JSON_SUCCESS;
+        }
+    }
+
+    return result;
+}
+
+static PARSE_JSON_RESULT parse_module_options(JSON_Object* module, BROKER_MODULE_OPTIONS** out_options)
+{
+    PARSE_JSON_RESULT result;
+
+    JSON_Object *queue = json_object_get_object(module, QUEUE_KEY);
+    JSON_Object *thread = json_object_get_object(module, THREAD_KEY);
+    *out_options = NULL;
+    if (queue == NULL && thread == NULL)
+    {
+        result = PARSE_JSON_SUCCESS;
+    }
+    else
+    {
+        BROKER_MODULE_OPTIONS options;
+
+        result = parse_queue_options(queue, &options.queue);
+        if (result == PARSE_JSON_SUCCESS)
+        {
+            result = parse_thread_options(thread, &options.thread);
+        }
+
+        if (result == PARSE_JSON_SUCCESS)
+        {
+            *out_options = (BROKER_MODULE_OPTIONS*)malloc(sizeof(BROKER_MODULE_OPTIONS));
+            if (*out_options == NULL)
+            {
+                /*Codes_SRS_GATEWAY_14_008: [This function shall return NULL upon any memory allocation failure.]*/
+                result = PARSE_JSON_FAILURE;
+                LogError("Failed to allocate module options.");
+            }
+            else
+            {
+                **out_options = options;
+            }
+        }
+    }
+
+    return result;
+}
+
+static PARSE_JSON_RESULT parse_module_instances(JSON_Object* module, size_t* out_instances, const char** out_partition_key)
+{
+    PARSE_JSON_RESULT result;
+
+    double instances = json_object_get_number(module, MODULE_INSTANCES_KEY);
+
+    *out_instances = 1;
+    *out_partition_key = NULL;
+
+    /*Codes_SRS_GATEWAY_13_016: [The "instances" value of a module shall be a non-negative integer, a missing value or 0 meaning 1, and a module with more than 1 instance shall have a "partition key" string.]*/
+    if (instances < 0 || instances > INT_MAX || instances != (double)(int)instances)
+    {
+        result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+        LogError("\"instances\" must be a non-negative integer.");
+    }
+    else if (instances <= 1)
+    {
+        result = PARSE_JSON_SUCCESS;
+    }
+    else
+    {
+        *out_partition_key = json_object_get_string(module, MODULE_PARTITION_KEY);
+        if (*out_partition_key == NULL)
+        {
+            result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+            LogError("A module with several \"instances\" must have a \"partition key\".");
+        }
+        else
+        {
+            *out_instances = (size_t)instances;
+            result = PARSE_JSON_SUCCESS;
+        }
+    }
+
+    return result;
+}
+
+static PARSE_JSON_RESULT parse_broker_options(JSON_Object* document, BROKER_OPTIONS** out_options)
+{
+    PARSE_JSON_RESULT result;
+
+    JSON_Object *broker = json_object_get_object(document, BROKER_KEY);
+    if (broker == NULL)
+    {
+        *out_options = NULL;
+        result = PARSE_JSON_SUCCESS;
+    }
+    else
+    {
+        double workers = json_object_get_number(broker, BROKER_WORKERS_KEY);
+
+        *out_options = NULL;
+
+        /*Codes_SRS_GATEWAY_13_006: [The "workers" value of the "broker" object shall be a non-negative number, a missing value meaning 0.]*/
+        if (workers < 0)
+        {
+            result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+            LogError("\"broker\" \"workers\" must be a non-negative number.");
+        }
+        else
+        {
+            *out_options = (BROKER_OPTIONS*)malloc(sizeof(BROKER_OPTIONS));
+            if (*out_options == NULL)
+            {
+                /*Codes_SRS_GATEWAY_14_008: [This function shall return NULL upon any memory allocation failure.]*/
+                result = PARSE_JSON_FAILURE;
+                LogError("Failed to allocate broker options.");
+            }
+            else
+            {
+                (*out_options)->worker_count = (size_t)workers;
+                result = PARSE_JSON_SUCCESS;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*fills condition from one object of a "filter" array, returns 0 if the object is a valid condition*/
+static int parse_filter_condition(JSON_Object* condition_object, BROKER_FILTER_CONDITION* condition)
+{
+    int result;
+    const char* equals = json_object_get_string(condition_object, FILTER_EQUALS_KEY);
+    const char* prefix = json_object_get_string(condition_object, FILTER_PREFIX_KEY);
+    int exists = json_object_get_boolean(condition_object, FILTER_EXISTS_KEY);
+
+    condition->name = json_object_get_string(condition_object, FILTER_PROPERTY_KEY);
+    /*Codes_SRS_GATEWAY_13_009: [Every object of the "filter" array shall have a "property" string and exactly one of an "equals" string, a "prefix" string or an "exists" value of true.]*/
+    if (condition->name == NULL || (equals != NULL) + (prefix != NULL) + (exists == 1) != 1)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_13_010: [The operation of the condition shall be BROKER_FILTER_EQUALS, BROKER_FILTER_PREFIX or BROKER_FILTER_EXISTS respectively.]*/
+        if (equals != NULL)
+        {
+            condition->operation = BROKER_FILTER_EQUALS;
+            condition->value = equals;
+        }
+        else if (prefix != NULL)
+        {
+            condition->operation = BROKER_FILTER_PREFIX;
+            condition->value = prefix;
+        }
+        else
+        {
+            condition->operation = BROKER_FILTER_EXISTS;
+            condition->value = NULL;
+        }
+        result = 0;
+    }
+
+    return result;
+}
+
+static PARSE_JSON_RESULT parse_link_filter(JSON_Object* route, BROKER_LINK_FILTER** out_filter)
+{
+    PARSE_JSON_RESULT result;
+
+    JSON_Value *filter_value = json_object_get_value(route, FILTER_KEY);
+    *out_filter = NULL;
+    if (filter_value == NULL)
+    {
+        result = PARSE_JSON_SUCCESS;
+    }
+    else
+    {
+        JSON_Array *conditions = json_value_get_array(filter_value);
+        size_t condition_count = json_array_get_count(conditions);
+
+        /*Codes_SRS_GATEWAY_13_008: [The "filter" value of a link shall be a non-empty array.]*/
+        if (conditions == NULL || condition_count == 0)
+        {
+            result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+            LogError("\"filter\" must be a non-empty array.");
+        }
+        else
+        {
+            /*the conditions follow the filter in the same allocation, their strings stay in the JSON document*/
+            *out_filter = (BROKER_LINK_FILTER*)malloc(sizeof(BROKER_LINK_FILTER) + condition_count * sizeof(BROKER_FILTER_CONDITION));
+            if (*out_filter == NULL)
+            {
+                /*Codes_SRS_GATEWAY_14_008: [This function shall return NULL upon any memory allocation failure.]*/
+                result = PARSE_JSON_FAILURE;
+                LogError("Failed to allocate link filter.");
+            }
+            else
+            {
+                BROKER_FILTER_CONDITION* filter_conditions = (BROKER_FILTER_CONDITION*)(*out_filter + 1);
+                size_t condition_index;
+
+                result = PARSE_JSON_SUCCESS;
+                for (condition_index = 0; condition_index < condition_count; ++condition_index)
+                {
+                    if (parse_filter_condition(json_array_get_object(conditions, condition_index), &filter_conditions[condition_index]) != 0)
+                    {
+                        result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+                        LogError("\"filter\" condition %zu must have a \"property\" and one of \"equals\", \"prefix\" or \"exists\".", condition_index);
+                        break;
+                    }
+                }
+
+                if (result == PARSE_JSON_SUCCESS)
+                {
+                    (*out_filter)->conditions = filter_conditions;
+                    (*out_filter)->condition_count = condition_count;
+                }
+                else
+                {
+                    free(*out_filter);
+                    *out_filter = NULL;
+                }
+            }
+        }
+    }
+
+    return result;
+}
@@ -15,6 +15,7 @@
 #include "broker.h"
 #include "module_loader.h"
 #include "internal/event_system.h"
+#include "internal/link_filter.h"
 
 #define GATEWAY_ALL "*"
 
@@ -42,8 +43,17 @@ typedef struct MODULE_DATA_TAG {
 	/** @brief The MODULE_LIBRARY_HANDLE associated with 'module'*/
 	MODULE_LIBRARY_HANDLE module_library_handle;
 
-	/** @brief The MODULE_HANDLE of the same module that lives on the message broker.*/
+	/** @brief The MODULE_HANDLE of the same module that lives on the message broker, its first instance when it has several.*/
 	MODULE_HANDLE module;
+
+	/** @brief The MODULE_HANDLEs of all the instances of the module, starting with 'module'. It points to 'module' when the module has a single instance. */
+	MODULE_HANDLE* instances;
+
+	/** @brief The number of elements of 'instances'. */
+	size_t instance_count;
+
+	/** @brief The copy of the name of the property whose value picks the instance receiving a message, NULL when the module has a single instance. */
+	char* partition_key;
 } MODULE_DATA;
 
 #ifndef UWP_BINDING
@@ -52,6 +62,8 @@ typedef struct LINK_DATA_TAG {
 	bool from_any_source;
 	MODULE_DATA *module_source;
 	MODULE_DATA *module_sink;
+	/** @brief The copy of the filter of the link, NULL if it has none. It is kept to add the link again for the modules that join an any source link. */
+	LINK_FILTER_HANDLE filter;
 } LINK_DATA;
 
 static MODULE_DATA *no_module = NULL;
@@ -60,7 +72,7 @@ static bool module_info_name_find(const void* element, const void* module_name);
 
 static void gateway_destroymodulelist_internal(GATEWAY_MODULE_INFO* infos, size_t count);
 
-static MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, const char* module_path, const void* module_configuration, const char* module_name);
+static MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, const char* module_path, const void* module_configuration, const char* module_name, const BROKER_MODULE_OPTIONS* module_options, size_t instance_count, const char* partition_key);
 
 static void gateway_removemodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA** module);
 
@@ -80,9 +92,11 @@ static bool link_data_find(const void* element, const void* link_data);
 
 static int add_module_to_any_source(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* module);
 static void remove_module_from_any_source(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* module);
-static int add_one_link_to_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_HANDLE source, MODULE_HANDLE sink);
+static int add_one_link_to_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_HANDLE source, MODULE_HANDLE sink, const BROKER_LINK_FILTER* filter);
 static int remove_one_link_from_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_HANDLE source, MODULE_HANDLE sink);
-static int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry);
+static int add_links_to_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* source, MODULE_DATA* sink, LINK_FILTER_HANDLE filter);
+static int remove_links_from_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* source, MODULE_DATA* sink);
+static int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry, LINK_FILTER_HANDLE filter);
 static void remove_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, LINK_DATA* link_entry);
 
 VECTOR_HANDLE Gateway_LL_GetModuleList(GATEWAY_HANDLE gw)
@@ -201,6 +215,127 @@ void Gateway_LL_DestroyModuleList(VECTOR_HANDLE module_list)
 	VECTOR_destroy(module_list);
 }
 
+static int gateway_accumulate_link_statistics(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* source, MODULE_DATA* sink, GATEWAY_LINK_STATISTICS* link_statistics)
+{
+	int result = 0;
+	size_t source_index;
+	size_t sink_index;
+
+	/*Codes_SRS_GATEWAY_LL_13_018: [ For a module with several instances, the function shall add up the statistics of the broker links of all its instances. ]*/
+	for (sink_index = 0; sink_index < sink->instance_count && result == 0; sink_index++)
+	{
+		for (source_index = 0; source_index < source->instance_count && result == 0; source_index++)
+		{
+			BROKER_LINK_STATISTICS broker_statistics;
+			BROKER_LINK_DATA broker_link =
+			{
+				source->instances[source_index],
+				sink->instances[sink_index],
+				NULL
+			};
+
+			if (Broker_GetLinkStatistics(gateway_handle->broker, &broker_link, &broker_statistics) != BROKER_OK)
+			{
+				LogError("Could not get the statistics of the link [%s] -> [%s]", source->module_name, sink->module_name);
+				result = __LINE__;
+			}
+			else
+			{
+				/*Codes_SRS_GATEWAY_LL_13_010: [ For a link with "*" as its source, the function shall add up the messages and bytes of the links from every other module to the sink and take the latest of their last activities. ]*/
+				link_statistics->messages += broker_statistics.messages;
+				link_statistics->bytes += broker_statistics.bytes;
+				if (broker_statistics.last_activity > link_statistics->last_activity)
+				{
+					link_statistics->last_activity = broker_statistics.last_activity;
+				}
+			}
+		}
+	}
+	return result;
+}
+
+VECTOR_HANDLE Gateway_LL_GetLinkStatistics(GATEWAY_HANDLE gw)
+{
+	VECTOR_HANDLE result;
+
+	/*Codes_SRS_GATEWAY_LL_13_007: [ If gw is NULL, the function shall return NULL. ]*/
+	if (gw == NULL)
+	{
+		LogError("NULL gateway handle given to GetLinkStatistics");
+		result = NULL;
+	}
+	else
+	{
+		result = VECTOR_create(sizeof(GATEWAY_LINK_STATISTICS));
+		if (result == NULL)
+		{
+			/*Codes_SRS_GATEWAY_LL_13_011: [ If any underlying call fails, the function shall free the vector and return NULL. ]*/
+			LogError("Failed to create the link statistics vector");
+		}
+		else
+		{
+			size_t links_count = VECTOR_size(gw->links);
+			size_t i;
+
+			/*Codes_SRS_GATEWAY_LL_13_008: [ The function shall return a vector with a GATEWAY_LINK_STATISTICS for every link of the gateway, in the order the links were added. ]*/
+			for (i = 0; i < links_count; i++)
+			{
+				LINK_DATA *link_data = (LINK_DATA*)VECTOR_element(gw->links, i);
+				GATEWAY_LINK_STATISTICS link_statistics;
+				int failed = 0;
+
+				link_statistics.module_source = link_data->from_any_source ? GATEWAY_ALL : link_data->module_source->module_name;
+				link_statistics.module_sink = link_data->module_sink->module_name;
+				link_statistics.messages = 0;
+				link_statistics.bytes = 0;
+				link_statistics.last_activity = 0;
+
+				if (!link_data->from_any_source)
+				{
+					/*Codes_SRS_GATEWAY_LL_13_009: [ The function shall read the messages, bytes and last activity of every link by calling Broker_GetLinkStatistics. ]*/
+					failed = gateway_accumulate_link_statistics(gw, link_data->module_source, link_data->module_sink, &link_statistics);
+				}
+				else
+				{
+					size_t num_modules = VECTOR_size(gw->modules);
+					size_t m;
+					for (m = 0; m < num_modules && failed == 0; m++)
+					{
+						MODULE_DATA *source_module_data = *(MODULE_DATA **)VECTOR_element(gw->modules, m);
+						if (source_module_data != link_data->module_sink)
+						{
+							failed = gateway_accumulate_link_statistics(gw, source_module_data, link_data->module_sink, &link_statistics);
+						}
+					}
+				}
+
+				if (failed != 0)
+				{
+					/*Codes_SRS_GATEWAY_LL_13_011: [ If any underlying call fails, the function shall free the vector and return NULL. ]*/
+					VECTOR_destroy(result);
+					result = NULL;
+					break;
+				}
+				else if (VECTOR_push_back(result, &link_statistics, 1) != 0)
+				{
+					/*Codes_SRS_GATEWAY_LL_13_011: [ If any underlying call fails, the function shall free the vector and return NULL. ]*/
+					LogError("Failed to push_back the statistics of a link");
+					VECTOR_destroy(result);
+					result = NULL;
+					break;
+				}
+			}
+		}
+	}
+	return result;
+}
+
+void Gateway_LL_DestroyLinkStatistics(VECTOR_HANDLE link_statistics)
+{
+	/*Codes_SRS_GATEWAY_LL_13_012: [ The function shall destroy the vector returned by Gateway_LL_GetLinkStatistics. ]*/
+	VECTOR_destroy(link_statistics);
+}
+
 void Gateway_LL_AddEventCallback(GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, GATEWAY_CALLBACK callback, void* user_param)
 {
 	/* Codes_SRS_GATEWAY_LL_26_006: [ This function shall log a failure and do nothing else when `gw` parameter is NULL. ] */
@@ -225,7 +360,10 @@ GATEWAY_HANDLE Gateway_LL_Create(const GATEWAY_PROPERTIES* properties)
 		memset(gateway, 0, sizeof(GATEWAY_HANDLE_DATA));
 
 		/*Codes_SRS_GATEWAY_LL_14_003: [This function shall create a new BROKER_HANDLE for the gateway representing this gateway's message broker. ]*/
-		gateway->broker = Broker_Create();
+		/*Codes_SRS_GATEWAY_LL_13_002: [If properties is not NULL and its broker_options is not NULL, this function shall create the broker with Broker_CreateWithOptions.]*/
+		gateway->broker = (properties != NULL && properties->broker_options != NULL) ?
+			Broker_CreateWithOptions(properties->broker_options) :
+			Broker_Create();
 		if (gateway->broker == NULL) 
 		{
 			/*Codes_SRS_GATEWAY_LL_14_004: [This function shall return NULL if a BROKER_HANDLE cannot be created.]*/
@@ -265,13 +403,13 @@ GATEWAY_HANDLE Gateway_LL_Create(const GATEWAY_PROPERTIES* properties)
 						{
 							//Add the first module, if successfull add others
 							GATEWAY_MODULES_ENTRY* entry = (GATEWAY_MODULES_ENTRY*)VECTOR_element(properties->gateway_modules, 0);
-							MODULE_HANDLE module = gateway_addmodule_internal(gateway, entry->module_path, entry->module_configuration, entry->module_name);
+							MODULE_HANDLE module = gateway_addmodule_internal(gateway, entry->module_path, entry->module_configuration, entry->module_name, entry->module_options, entry->instances, entry->partition_key);
 
 							//Continue adding modules until all are added or one fails
 							for (size_t properties_index = 1; properties_index < entries_count && module != NULL; ++properties_index)
 							{
 								entry = (GATEWAY_MODULES_ENTRY*)VECTOR_element(properties->gateway_modules, properties_index);
-								module = gateway_addmodule_internal(gateway, entry->module_path, entry->module_configuration, entry->module_name);
+								module = gateway_addmodule_internal(gateway, entry->module_path, entry->module_configuration, entry->module_name, entry->module_options, entry->instances, entry->partition_key);
 							}
 
 							/*Codes_SRS_GATEWAY_LL_14_036: [ If any MODULE_HANDLE is unable to be created from a GATEWAY_MODULES_ENTRY the GATEWAY_HANDLE will be destroyed. ]*/
@@ -364,8 +502,13 @@ GATEWAY_START_RESULT Gateway_LL_Start(GATEWAY_HANDLE gw)
 			pfModule_Start pfStart = ModuleLoader_GetModuleAPIs((*module_data)->module_library_handle)->Module_Start;
 			if (pfStart != NULL)
 			{
+				size_t i;
 				/*Codes_SRS_GATEWAY_17_002: [ This function shall call Module_Start for every module which defines the start function. ]*/
-				(pfStart)((*module_data)->module);
+				/*Codes_SRS_GATEWAY_LL_13_016: [ The functions starting a module shall start every instance of the module. ]*/
+				for (i = 0; i < (*module_data)->instance_count; i++)
+				{
+					(pfStart)((*module_data)->instances[i]);
+				}
 			}
 		}
 		/*Codes_SRS_GATEWAY_LL_17_012: [ This function shall report a GATEWAY_STARTED event. ]*/
@@ -392,7 +535,7 @@ MODULE_HANDLE Gateway_LL_AddModule(GATEWAY_HANDLE gw, const GATEWAY_MODULES_ENTR
 	/*Codes_SRS_GATEWAY_LL_14_011: [ If gw, entry, or GATEWAY_MODULES_ENTRY's module_path is NULL the function shall return NULL. ]*/
 	if (gw != NULL && entry != NULL)
 	{
-		module = gateway_addmodule_internal(gw, entry->module_path, entry->module_configuration, entry->module_name);
+		module = gateway_addmodule_internal(gw, entry->module_path, entry->module_configuration, entry->module_name, entry->module_options, entry->instances, entry->partition_key);
 
 		if (module == NULL)
 		{
@@ -424,8 +567,13 @@ extern void Gateway_LL_StartModule(GATEWAY_HANDLE gw, MODULE_HANDLE module)
 			pfModule_Start pfStart = ModuleLoader_GetModuleAPIs((*module_data)->module_library_handle)->Module_Start;
 			if (pfStart != NULL)
 			{
+				size_t i;
 				/*Codes_SRS_GATEWAY_LL_17_008: [ When module is found, if the Module_Start function is defined for this module, the Module_Start function shall be called. ]*/
-				(pfStart)((*module_data)->module);
+				/*Codes_SRS_GATEWAY_LL_13_016: [ The functions starting a module shall start every instance of the module. ]*/
+				for (i = 0; i < (*module_data)->instance_count; i++)
+				{
+					(pfStart)((*module_data)->instances[i]);
+				}
 			}
 		}
 		else
@@ -589,10 +737,128 @@ bool check_if_link_exists(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LIN
 	return link_data == NULL ? false : true;
 }
 
-static MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, const char* module_path, const void* module_configuration, const char* module_name)
+/*detaches and destroys the instances of a module after its first one*/
+static void remove_other_instances(GATEWAY_HANDLE_DATA* gateway_handle, const MODULE_APIS* module_apis, MODULE_HANDLE* instances, size_t instance_count)
+{
+	size_t i;
+	for (i = 1; i < instance_count; i++)
+	{
+		MODULE module;
+		module.module_apis = module_apis;
+		module.module_handle = instances[i];
+		if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
+		{
+			LogError("Failed to remove instance [%p] from the message broker. This instance will remain attached.", instances[i]);
+		}
+		Broker_DecRef(gateway_handle->broker);
+		module_apis->Module_Destroy(instances[i]);
+	}
+}
+
+/*creates the instances of a module after its first one, which is already attached to the broker, and attaches them; returns 0 on success*/
+static int add_other_instances(GATEWAY_HANDLE_DATA* gateway_handle, const MODULE_APIS* module_apis, const void* module_configuration, const BROKER_MODULE_OPTIONS* module_options, MODULE_HANDLE* instances, size_t instance_count)
+{
+	int result = 0;
+	size_t i;
+	for (i = 1; i < instance_count; i++)
+	{
+		MODULE module;
+		module.module_apis = module_apis;
+		module.module_handle = module_apis->Module_Create(gateway_handle->broker, module_configuration);
+		if (module.module_handle == NULL)
+		{
+			LogError("Module_Create failed for instance %zu.", i);
+			result = __LINE__;
+			break;
+		}
+		else if (((module_options == NULL) ?
+			Broker_AddModule(gateway_handle->broker, &module) :
+			Broker_AddModuleWithOptions(gateway_handle->broker, &module, module_options)) != BROKER_OK)
+		{
+			module_apis->Module_Destroy(module.module_handle);
+			LogError("Failed to add instance %zu to the gateway's broker.", i);
+			result = __LINE__;
+			break;
+		}
+		else
+		{
+			Broker_IncRef(gateway_handle->broker);
+			instances[i] = module.module_handle;
+		}
+	}
+
+	if (result != 0)
+	{
+		remove_other_instances(gateway_handle, module_apis, instances, i);
+	}
+	return result;
+}
+
+/*creates the instances a module has besides 'first' and copies its partition key; does nothing for a single instance*/
+static int create_instances(GATEWAY_HANDLE_DATA* gateway_handle, const MODULE_APIS* module_apis, const void* module_configuration, const BROKER_MODULE_OPTIONS* module_options, MODULE_HANDLE first, size_t instance_count, const char* partition_key, MODULE_HANDLE** out_instances, char** out_partition_key)
+{
+	int result;
+	*out_instances = NULL;
+	*out_partition_key = NULL;
+	if (instance_count == 1)
+	{
+		result = 0;
+	}
+	else if (instance_count > SIZE_MAX / sizeof(MODULE_HANDLE) ||
+		(*out_instances = (MODULE_HANDLE*)malloc(instance_count * sizeof(MODULE_HANDLE))) == NULL)
+	{
+		LogError("Failed to allocate %zu instances.", instance_count);
+		result = __LINE__;
+	}
+	else if (mallocAndStrcpy_s(out_partition_key, partition_key) != 0)
+	{
+		LogError("Unable to malloc for the partition key");
+		free(*out_instances);
+		*out_instances = NULL;
+		*out_partition_key = NULL;
+		result = __LINE__;
+	}
+	else
+	{
+		(*out_instances)[0] = first;
+		/*Codes_SRS_GATEWAY_LL_13_014: [ If the GATEWAY_MODULES_ENTRY's instances is more than 1, the function shall create and attach that many instances of the module, with the same module_configuration and module_options, and return the MODULE_HANDLE of the first one. ]*/
+		if (add_other_instances(gateway_handle, module_apis, module_configuration, module_options, *out_instances, instance_count) != 0)
+		{
+			free(*out_partition_key);
+			free(*out_instances);
+			*out_partition_key = NULL;
+			*out_instances = NULL;
+			result = __LINE__;
+		}
+		else
+		{
+			result = 0;
+		}
+	}
+	return result;
+}
+
+/*undoes create_instances*/
+static void destroy_instances(GATEWAY_HANDLE_DATA* gateway_handle, const MODULE_APIS* module_apis, MODULE_HANDLE* instances, size_t instance_count, char* partition_key)
+{
+	if (instances != NULL)
+	{
+		remove_other_instances(gateway_handle, module_apis, instances, instance_count);
+		free(instances);
+		free(partition_key);
+	}
+}
+
+static MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, const char* module_path, const void* module_configuration, const char* module_name, const BROKER_MODULE_OPTIONS* module_options, size_t instance_count, const char* partition_key)
 {
 	MODULE_HANDLE module_result;
 
+	/*an entry that leaves the number of instances at 0 asks for one*/
+	if (instance_count == 0)
+	{
+		instance_count = 1;
+	}
+
 	/*Codes_SRS_GATEWAY_LL_14_011: [If gw, entry, or GATEWAY_MODULES_ENTRY's module_path is NULL the function shall return NULL. ]*/
 	if (gateway_handle == NULL || module_path == NULL || module_name == NULL)		
 	{
@@ -605,6 +871,12 @@ static MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_han
 		module_result = NULL;
 		LogError("Failed to add module because the module_name is invalid [%s]", module_name);
 	}
+	else if (instance_count > 1 && partition_key == NULL)
+	{
+		/*Codes_SRS_GATEWAY_LL_13_013: [ If the GATEWAY_MODULES_ENTRY's instances is more than 1 and its partition_key is NULL, the function shall return NULL. ]*/
+		module_result = NULL;
+		LogError("Failed to add module [%s] because its %zu instances have no partition key", module_name, instance_count);
+	}
 	else	
 	{
 		//First check if a module with a given name already exists.
@@ -655,8 +927,12 @@ static MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_han
 						module.module_handle = module_handle;
 
 						/*Codes_SRS_GATEWAY_LL_14_017: [The function shall attach the module to the GATEWAY_HANDLE_DATA's broker using a call to Broker_AddModule. ]*/
+						/*Codes_SRS_GATEWAY_LL_13_001: [If the GATEWAY_MODULES_ENTRY's module_options is not NULL, the function shall attach the module using a call to Broker_AddModuleWithOptions instead. ]*/
+						BROKER_RESULT add_result = (module_options == NULL) ?
+							Broker_AddModule(gateway_handle->broker, &module) :
+							Broker_AddModuleWithOptions(gateway_handle->broker, &module, module_options);
 						/*Codes_SRS_GATEWAY_LL_14_018: [If the function cannot attach the module to the message broker, the function shall return NULL.]*/
-						if (Broker_AddModule(gateway_handle->broker, &module) != BROKER_OK)
+						if (add_result != BROKER_OK)
 						{
 							free(new_module_data);
 							module_result = NULL;
@@ -664,10 +940,9 @@ static MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_han
 						}
 						else
 						{
-							char* name_copied = NULL;
-							/*Codes_SRS_GATEWAY_LL_26_020: [ The function shall make a copy of the name of the module for internal use. ]*/
-							mallocAndStrcpy_s(&name_copied, module_name);
-							if (name_copied == NULL)
+							MODULE_HANDLE* instances;
+							char* partition_key_copied;
+							if (create_instances(gateway_handle, module_apis, module_configuration, module_options, module_handle, instance_count, partition_key, &instances, &partition_key_copied) != 0)
 							{
 								free(new_module_data);
 								module_result = NULL;
@@ -675,55 +950,81 @@ static MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_han
 								{
 									LogError("Failed to remove module [%p] from the gateway message broker. This module will remain attached.", &module);
 								}
-								LogError("Unable to malloc for module name");
+								LogError("Unable to create the instances of module [%s].", module_name);
 							}
 							else
 							{
-								strcpy(name_copied, module_name);
-								/*Codes_SRS_GATEWAY_LL_14_039: [ The function shall increment the BROKER_HANDLE reference count if the MODULE_HANDLE was successfully added to the GATEWAY_HANDLE_DATA's broker. ]*/
-								Broker_IncRef(gateway_handle->broker);
-								/*Codes_SRS_GATEWAY_LL_14_029: [The function shall create a new MODULE_DATA containing the MODULE_HANDLE and MODULE_LIBRARY_HANDLE if the module was successfully attached to the message broker.]*/
-								MODULE_DATA module_data =
+								char* name_copied = NULL;
+								/*Codes_SRS_GATEWAY_LL_26_020: [ The function shall make a copy of the name of the module for internal use. ]*/
+								mallocAndStrcpy_s(&name_copied, module_name);
+								if (name_copied == NULL)
 								{
-									name_copied,
-									module_library_handle,
-									module_handle,
-								};
-								*new_module_data = module_data;
-								/*Codes_SRS_GATEWAY_LL_14_032: [The function shall add the new MODULE_DATA to GATEWAY_HANDLE_DATA's modules if the module was successfully attached to the message broker. ]*/
-								if (VECTOR_push_back(gateway_handle->modules, &new_module_data, 1) != 0)
-								{
-									/*Codes_SRS_GATEWAY_LL_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
-									Broker_DecRef(gateway_handle->broker);
 									free(new_module_data);
-									free(name_copied);
 									module_result = NULL;
 									if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
 									{
 										LogError("Failed to remove module [%p] from the gateway message broker. This module will remain attached.", &module);
 									}
-									LogError("Unable to add MODULE_DATA* to the gateway module vector.");
+									destroy_instances(gateway_handle, module_apis, instances, instance_count, partition_key_copied);
+									LogError("Unable to malloc for module name");
 								}
 								else
 								{
-									if (add_module_to_any_source(gateway_handle, *(MODULE_DATA**)VECTOR_back(gateway_handle->modules)) != 0)
+									strcpy(name_copied, module_name);
+									/*Codes_SRS_GATEWAY_LL_14_039: [ The function shall increment the BROKER_HANDLE reference count if the MODULE_HANDLE was successfully added to the GATEWAY_HANDLE_DATA's broker. ]*/
+									Broker_IncRef(gateway_handle->broker);
+									/*Codes_SRS_GATEWAY_LL_14_029: [The function shall create a new MODULE_DATA containing the MODULE_HANDLE and MODULE_LIBRARY_HANDLE if the module was successfully attached to the message broker.]*/
+									MODULE_DATA module_data =
+									{
+										name_copied,
+										module_library_handle,
+										module_handle,
+										instances,
+										instance_count,
+										partition_key_copied
+									};
+									*new_module_data = module_data;
+									if (new_module_data->instances == NULL)
+									{
+										new_module_data->instances = &new_module_data->module;
+									}
+									/*Codes_SRS_GATEWAY_LL_14_032: [The function shall add the new MODULE_DATA to GATEWAY_HANDLE_DATA's modules if the module was successfully attached to the message broker. ]*/
+									if (VECTOR_push_back(gateway_handle->modules, &new_module_data, 1) != 0)
 									{
 										/*Codes_SRS_GATEWAY_LL_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
 										Broker_DecRef(gateway_handle->broker);
+										free(new_module_data);
+										free(name_copied);
 										module_result = NULL;
 										if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
 										{
 											LogError("Failed to remove module [%p] from the gateway message broker. This module will remain attached.", &module);
 										}
-										VECTOR_erase(gateway_handle->modules, VECTOR_back(gateway_handle->modules), 1);
-										free(new_module_data);
-										free(name_copied);
-										LogError("Unable to add MODULE_DATA* to existing broker links.");
+										destroy_instances(gateway_handle, module_apis, instances, instance_count, partition_key_copied);
+										LogError("Unable to add MODULE_DATA* to the gateway module vector.");
 									}
 									else
 									{
-										/*Codes_SRS_GATEWAY_LL_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
-										module_result = module_handle;
+										if (add_module_to_any_source(gateway_handle, *(MODULE_DATA**)VECTOR_back(gateway_handle->modules)) != 0)
+										{
+											/*Codes_SRS_GATEWAY_LL_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
+											Broker_DecRef(gateway_handle->broker);
+											module_result = NULL;
+											if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
+											{
+												LogError("Failed to remove module [%p] from the gateway message broker. This module will remain attached.", &module);
+											}
+											VECTOR_erase(gateway_handle->modules, VECTOR_back(gateway_handle->modules), 1);
+											free(new_module_data);
+											free(name_copied);
+											destroy_instances(gateway_handle, module_apis, instances, instance_count, partition_key_copied);
+											LogError("Unable to add MODULE_DATA* to existing broker links.");
+										}
+										else
+										{
+											/*Codes_SRS_GATEWAY_LL_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
+											module_result = module_handle;
+										}
 									}
 								}
 							}
@@ -749,13 +1050,14 @@ static MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_han
 	return module_result;
 }
 
-static int add_one_link_to_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_HANDLE source, MODULE_HANDLE sink)
+static int add_one_link_to_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_HANDLE source, MODULE_HANDLE sink, const BROKER_LINK_FILTER* filter)
 {
 	int result;
 	BROKER_LINK_DATA broker_link_entry =
 	{
 		source,
-		sink
+		sink,
+		filter
 	};
 	if (Broker_AddLink(gateway_handle->broker, &broker_link_entry) != BROKER_OK)
 	{
@@ -775,7 +1077,8 @@ static int remove_one_link_from_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODU
 	BROKER_LINK_DATA broker_link_entry =
 	{
 		source,
-		sink
+		sink,
+		NULL
 	};
 	if (Broker_RemoveLink(gateway_handle->broker, &broker_link_entry) != BROKER_OK)
 	{
@@ -789,6 +1092,101 @@ static int remove_one_link_from_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODU
 	return result;
 }
 
+/*removes the broker links from every instance of source to every instance of sink, returns 0 if all of them were removed*/
+static int remove_links_from_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* source, MODULE_DATA* sink)
+{
+	int result = 0;
+	size_t source_index;
+	size_t sink_index;
+	for (sink_index = 0; sink_index < sink->instance_count; sink_index++)
+	{
+		for (source_index = 0; source_index < source->instance_count; source_index++)
+		{
+			if (remove_one_link_from_broker(gateway_handle, source->instances[source_index], sink->instances[sink_index]) != 0)
+			{
+				result = __LINE__;
+			}
+		}
+	}
+	return result;
+}
+
+/*adds the broker links from every instance of source to every instance of sink, returns 0 on success and removes the links it added otherwise*/
+static int add_links_to_broker(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* source, MODULE_DATA* sink, LINK_FILTER_HANDLE filter)
+{
+	int result;
+	/*Codes_SRS_GATEWAY_LL_13_005: [ The gateway shall pass the copy of the filter of the link to the broker as the filter of every BROKER_LINK_DATA it adds for the link. ]*/
+	const BROKER_LINK_FILTER* definition = (filter == NULL) ? NULL : LinkFilter_GetDefinition(filter);
+	size_t condition_count = (definition == NULL) ? 0 : definition->condition_count;
+	BROKER_FILTER_CONDITION* conditions = NULL;
+	BROKER_LINK_FILTER partitioned;
+
+	if (sink->instance_count > 1 &&
+		(condition_count >= SIZE_MAX / sizeof(BROKER_FILTER_CONDITION) ||
+		(conditions = (BROKER_FILTER_CONDITION*)malloc((condition_count + 1) * sizeof(BROKER_FILTER_CONDITION))) == NULL))
+	{
+		LogError("Failed to allocate the filter of the links to the instances of [%s]", sink->module_name);
+		result = __LINE__;
+	}
+	else
+	{
+		size_t added = 0;
+		size_t source_index;
+		size_t sink_index;
+
+		if (conditions != NULL)
+		{
+			/*Codes_SRS_GATEWAY_LL_13_015: [ For a sink with several instances, the gateway shall add the conditions of the filter of the link and a BROKER_FILTER_PARTITION condition on the partition key of the sink to the link to every instance, the instance being the partition. ]*/
+			if (condition_count > 0)
+			{
+				(void)memcpy(conditions, definition->conditions, condition_count * sizeof(BROKER_FILTER_CONDITION));
+			}
+			conditions[condition_count].operation = BROKER_FILTER_PARTITION;
+			conditions[condition_count].name = sink->partition_key;
+			conditions[condition_count].value = NULL;
+			conditions[condition_count].partition = 0;
+			conditions[condition_count].partition_count = sink->instance_count;
+			partitioned.conditions = conditions;
+			partitioned.condition_count = condition_count + 1;
+		}
+
+		result = 0;
+		for (sink_index = 0; sink_index < sink->instance_count && result == 0; sink_index++)
+		{
+			if (conditions != NULL)
+			{
+				conditions[condition_count].partition = sink_index;
+			}
+			for (source_index = 0; source_index < source->instance_count && result == 0; source_index++)
+			{
+				result = add_one_link_to_broker(gateway_handle, source->instances[source_index], sink->instances[sink_index], (conditions == NULL) ? definition : &partitioned);
+				if (result == 0)
+				{
+					added++;
+				}
+			}
+		}
+
+		if (result != 0)
+		{
+			/*the links were added sink by sink*/
+			for (sink_index = 0; added > 0; sink_index++)
+			{
+				for (source_index = 0; source_index < source->instance_count && added > 0; source_index++, added--)
+				{
+					(void)remove_one_link_from_broker(gateway_handle, source->instances[source_index], sink->instances[sink_index]);
+				}
+			}
+		}
+
+		if (conditions != NULL)
+		{
+			free(conditions);
+		}
+	}
+	return result;
+}
+
 static int add_module_to_any_source(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* module)
 {
 	int result = 0;
@@ -808,7 +1206,7 @@ static int add_module_to_any_source(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_
 			}
 			else
 			{
-				if (add_one_link_to_broker(gateway_handle, module->module, (*module_sink)->module) != 0)
+				if (add_links_to_broker(gateway_handle, module, *module_sink, link_data->filter) != 0)
 				{
 					result = __LINE__;
 					break;
@@ -958,7 +1356,7 @@ static void remove_module_from_any_source(GATEWAY_HANDLE_DATA* gateway_handle, M
 			}
 			else
 			{
-				if (remove_one_link_from_broker(gateway_handle, module->module, (*module_sink)->module) != 0)
+				if (remove_links_from_broker(gateway_handle, module, *module_sink) != 0)
 				{
 					LogError("Unable to remove link to Broker.");
 				}
@@ -991,6 +1389,11 @@ static void gateway_removemodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, M
 	Broker_DecRef(gateway_handle->broker);
 	/*Codes_SRS_GATEWAY_LL_14_024: [ The function shall use the MODULE_DATA's module_library_handle to retrieve the MODULE_APIS and destroy module. ]*/
 	ModuleLoader_GetModuleAPIs((*module_data_pptr)->module_library_handle)->Module_Destroy((*module_data_pptr)->module);
+	if ((*module_data_pptr)->instance_count > 1)
+	{
+		/*Codes_SRS_GATEWAY_LL_13_017: [ The function shall detach and destroy every other instance of the module the same way. ]*/
+		destroy_instances(gateway_handle, ModuleLoader_GetModuleAPIs((*module_data_pptr)->module_library_handle), (*module_data_pptr)->instances, (*module_data_pptr)->instance_count, (*module_data_pptr)->partition_key);
+	}
 	/*Codes_SRS_GATEWAY_LL_14_025: [The function shall unload MODULE_DATA's module_library_handle. ]*/
 	ModuleLoader_Unload((*module_data_pptr)->module_library_handle);
 	/*Codes_SRS_GATEWAY_LL_14_026:[The function shall remove that MODULE_DATA from GATEWAY_HANDLE_DATA's modules. ]*/
@@ -999,7 +1402,7 @@ static void gateway_removemodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, M
 	free(module_data_ptr);
 }
 
-static int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry)
+static int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry, LINK_FILTER_HANDLE filter)
 {
 	int result;
 	MODULE_DATA** module_sink_data = (MODULE_DATA**)VECTOR_find_if(gateway_handle->modules, module_name_find, link_entry->module_sink);
@@ -1017,7 +1420,8 @@ static int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWA
 		{
 			true,
 			no_module,
-			*module_sink_data
+			*module_sink_data,
+			filter
 		};
 
 		/*Codes_SRS_GATEWAY_LL_04_012: [ This function shall add the entryLink to the gw->links ] */
@@ -1036,8 +1440,9 @@ static int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWA
 			{
 				MODULE_DATA **source_module_data = (MODULE_DATA **)VECTOR_element(gateway_handle->modules, m);
 				/*Codes_SRS_GATEWAY_LL_17_005: [ For this link, the sink shall receive all messages publish by other modules. ]*/
-				if ((*source_module_data)->module != (*module_sink_data)->module &&
-					add_one_link_to_broker(gateway_handle, (*source_module_data)->module, (*module_sink_data)->module) != 0)
+				/*Codes_SRS_GATEWAY_LL_13_019: [ The instances of a module shall not receive the messages of each other over a link with "*" as its source. ]*/
+				if (*source_module_data != *module_sink_data &&
+					add_links_to_broker(gateway_handle, *source_module_data, *module_sink_data, filter) != 0)
 				{
 					result = __LINE__;
 					break;
@@ -1053,7 +1458,7 @@ static int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWA
 	return result;
 }
 
-static int add_regular_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry)
+static int add_regular_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry, LINK_FILTER_HANDLE filter)
 {
 	int result;
 	MODULE_DATA** module_source_handle = (MODULE_DATA**)VECTOR_find_if(gateway_handle->modules, module_name_find, link_entry->module_source);
@@ -1076,7 +1481,7 @@ static int add_regular_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_L
 		}
 		else
 		{
-			if (add_one_link_to_broker(gateway_handle, (*module_source_handle)->module, (*module_sink_handle)->module) != 0)
+			if (add_links_to_broker(gateway_handle, *module_source_handle, *module_sink_handle, filter) != 0)
 			{
 				LogError("Unable to add link to Broker.");
 				result = __LINE__;
@@ -1087,14 +1492,15 @@ static int add_regular_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_L
 				{
 					false,
 					*module_source_handle,
-					*module_sink_handle
+					*module_sink_handle,
+					filter
 				};
 
 				/*Codes_SRS_GATEWAY_LL_04_012: [ This function shall add the entryLink to the gw->links ] */
 				if (VECTOR_push_back(gateway_handle->links, &link_data, 1) != 0)
 				{
 					LogError("Unable to add LINK_DATA* to the gateway links vector.");
-					remove_one_link_from_broker(gateway_handle, (*module_source_handle)->module, (*module_sink_handle)->module);
+					remove_links_from_broker(gateway_handle, *module_source_handle, *module_sink_handle);
 					result = __LINE__;
 				}
 				else
@@ -1118,12 +1524,25 @@ static bool gateway_addlink_internal(GATEWAY_HANDLE_DATA* gateway_handle, const
 
 	if (!linkExist)
 	{
-		if (strcmp(GATEWAY_ALL, link_entry->module_source) == 0)
+		/*Codes_SRS_GATEWAY_LL_13_003: [ If entryLink->filter is not NULL, the function shall copy it by calling LinkFilter_Create. ]*/
+		LINK_FILTER_HANDLE filter = (link_entry->filter == NULL) ? NULL : LinkFilter_Create(link_entry->filter);
+
+		if (link_entry->filter != NULL && filter == NULL)
+		{
+			/*Codes_SRS_GATEWAY_LL_13_004: [ If LinkFilter_Create fails, the function shall return GATEWAY_ADD_LINK_ERROR. ]*/
+			LogError("Failed to copy the filter of the link. Source_name: %s, Sink_name: %s", link_entry->module_source, link_entry->module_sink);
+			result = false;
+		}
+		else if (strcmp(GATEWAY_ALL, link_entry->module_source) == 0)
 		{
 			/*Codes_SRS_GATEWAY_LL_17_002: [ The gateway shall accept a link with a source of "*" and a sink of a valid module. ]*/
-			if (add_any_source_link(gateway_handle, link_entry) != 0)
+			if (add_any_source_link(gateway_handle, link_entry, filter) != 0)
 			{
 				LogError("Failed to add a any_source link sink = %s", link_entry->module_sink);
+				if (filter != NULL)
+				{
+					LinkFilter_Destroy(filter);
+				}
 				result = false;
 			}
 			else
@@ -1133,9 +1552,13 @@ static bool gateway_addlink_internal(GATEWAY_HANDLE_DATA* gateway_handle, const
 		}
 		else
 		{
-			if (add_regular_link(gateway_handle, link_entry) != 0)
+			if (add_regular_link(gateway_handle, link_entry, filter) != 0)
 			{
 				LogError("Failed to add a any_source link sink = %s", link_entry->module_sink);
+				if (filter != NULL)
+				{
+					LinkFilter_Destroy(filter);
+				}
 				result = false;
 			}
 			else
@@ -1164,8 +1587,8 @@ static void remove_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, LINK_DAT
 		for (m = 0; m < num_modules; m++)
 		{
 			MODULE_DATA **source_module_data = (MODULE_DATA **)VECTOR_element(gateway_handle->modules, m);
-			if ((*source_module_data)->module != (*module_sink_data)->module &&
-				remove_one_link_from_broker(gateway_handle, (*source_module_data)->module, (*module_sink_data)->module) != 0)
+			if (*source_module_data != *module_sink_data &&
+				remove_links_from_broker(gateway_handle, *source_module_data, *module_sink_data) != 0)
 			{
 				LogError("Unable to remove link to Broker.");
 			}
@@ -1180,6 +1603,8 @@ static void remove_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, LINK_DAT
 
 static void gateway_removelink_internal(GATEWAY_HANDLE_DATA* gateway_handle, LINK_DATA* link_data)
 {
+	LINK_FILTER_HANDLE filter = link_data->filter;
+
 	/*Codes_SRS_GATEWAY_LL_04_007: [The functional shall remove that LINK_DATA from GATEWAY_HANDLE_DATA's links. ]*/
 
 	if (link_data->from_any_source)
@@ -1188,17 +1613,15 @@ static void gateway_removelink_internal(GATEWAY_HANDLE_DATA* gateway_handle, LIN
 	}
 	else
 	{
-
-		BROKER_LINK_DATA broker_data =
-		{
-			link_data->module_source->module,
-			link_data->module_sink->module
-		};
-
-		Broker_RemoveLink(gateway_handle->broker, &broker_data);
+		(void)remove_links_from_broker(gateway_handle, link_data->module_source, link_data->module_sink);
 	}
 
 	VECTOR_erase(gateway_handle->links, link_data, 1);
+	/*Codes_SRS_GATEWAY_LL_13_006: [ The function shall destroy the copy of the filter of the link by calling LinkFilter_Destroy. ]*/
+	if (filter != NULL)
+	{
+		LinkFilter_Destroy(filter);
+	}
 }
 #else
 
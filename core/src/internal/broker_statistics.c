@@ -0,0 +1,139 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "internal/broker_statistics.h"
+
+uint64_t BrokerStatistics_GetTime(void)
+{
+    uint64_t result;
+#ifdef _WIN32
+    /*Codes_SRS_BROKER_STATISTICS_13_001: [ BrokerStatistics_GetTime shall return the number of microseconds read from a monotonic clock, QueryPerformanceCounter on Windows and clock_gettime with CLOCK_MONOTONIC elsewhere. ]*/
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (!QueryPerformanceFrequency(&frequency) || !QueryPerformanceCounter(&counter))
+    {
+        /*Codes_SRS_BROKER_STATISTICS_13_002: [ If the clock cannot be read, BrokerStatistics_GetTime shall return 0. ]*/
+        LogError("unable to read the performance counter");
+        result = 0;
+    }
+    else
+    {
+        uint64_t ticks = (uint64_t)counter.QuadPart;
+        uint64_t ticks_per_second = (uint64_t)frequency.QuadPart;
+        result = (ticks / ticks_per_second) * 1000000 + ((ticks % ticks_per_second) * 1000000) / ticks_per_second;
+    }
+#else
+    /*Codes_SRS_BROKER_STATISTICS_13_001: [ BrokerStatistics_GetTime shall return the number of microseconds read from a monotonic clock, QueryPerformanceCounter on Windows and clock_gettime with CLOCK_MONOTONIC elsewhere. ]*/
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+    {
+        /*Codes_SRS_BROKER_STATISTICS_13_002: [ If the clock cannot be read, BrokerStatistics_GetTime shall return 0. ]*/
+        LogError("clock_gettime failed");
+        result = 0;
+    }
+    else
+    {
+        result = (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+    }
+#endif
+    return result;
+}
+
+void BrokerStatistics_RecordDuration(BROKER_LATENCY_HISTOGRAM* histogram, uint64_t start, uint64_t end)
+{
+    /*Codes_SRS_BROKER_STATISTICS_13_003: [ If histogram is NULL, BrokerStatistics_RecordDuration shall do nothing. ]*/
+    if (histogram != NULL)
+    {
+        /*Codes_SRS_BROKER_STATISTICS_13_004: [ BrokerStatistics_RecordDuration shall take a duration of 0 when end is before start. ]*/
+        uint64_t duration = (end > start) ? end - start : 0;
+        size_t bucket = 0;
+
+        /*Codes_SRS_BROKER_STATISTICS_13_005: [ BrokerStatistics_RecordDuration shall increment bucket 0 for a duration of 0 microseconds, bucket i for a duration of at least 2^(i-1) and less than 2^i microseconds, and the last bucket for the longer durations. ]*/
+        while (duration != 0 && bucket < BROKER_LATENCY_BUCKET_COUNT - 1)
+        {
+            duration >>= 1;
+            bucket++;
+        }
+        histogram->buckets[bucket]++;
+    }
+}
+
+void BrokerStatistics_Fill(BROKER_MODULE_STATISTICS* statistics, MODULE_HANDLE module_handle, const BROKER_QUEUE_COUNTERS* queue_counters, const BROKER_DELIVERY_COUNTERS* delivery_counters)
+{
+    /*Codes_SRS_BROKER_STATISTICS_13_006: [ If statistics or delivery_counters is NULL, BrokerStatistics_Fill shall do nothing. ]*/
+    if (statistics == NULL || delivery_counters == NULL)
+    {
+        LogError("invalid arg statistics=%p delivery_counters=%p", statistics, delivery_counters);
+    }
+    else
+    {
+        statistics->module_handle = module_handle;
+        if (queue_counters == NULL)
+        {
+            /*Codes_SRS_BROKER_STATISTICS_13_007: [ If queue_counters is NULL, BrokerStatistics_Fill shall take the messages and bytes received by the delivering thread as the messages and bytes enqueued, the messages it discarded as the messages dropped, and 0 as the high-water mark. ]*/
+            statistics->enqueued = delivery_counters->received;
+            statistics->dropped = delivery_counters->discarded;
+            statistics->enqueued_bytes = delivery_counters->received_bytes;
+            statistics->queue_high_water_mark = 0;
+        }
+        else
+        {
+            /*Codes_SRS_BROKER_STATISTICS_13_008: [ Otherwise, BrokerStatistics_Fill shall copy the messages and bytes enqueued and the high-water mark of queue_counters, and add the messages the delivering thread discarded to its messages dropped. ]*/
+            statistics->enqueued = queue_counters->enqueued;
+            statistics->dropped = queue_counters->dropped + delivery_counters->discarded;
+            statistics->enqueued_bytes = queue_counters->enqueued_bytes;
+            statistics->queue_high_water_mark = queue_counters->high_water_mark;
+        }
+
+        /*Codes_SRS_BROKER_STATISTICS_13_009: [ BrokerStatistics_Fill shall copy the messages delivered and both histograms of delivery_counters, and set the queue depth and the queued bytes to 0. ]*/
+        statistics->delivered = delivery_counters->delivered;
+        statistics->queue_depth = 0;
+        statistics->queued_bytes = 0;
+        (void)memcpy(&statistics->queue_wait, &delivery_counters->queue_wait, sizeof(BROKER_LATENCY_HISTOGRAM));
+        (void)memcpy(&statistics->receive_duration, &delivery_counters->receive_duration, sizeof(BROKER_LATENCY_HISTOGRAM));
+    }
+}
+
+void BrokerStatistics_FillLink(BROKER_LINK_STATISTICS* statistics, const BROKER_LINK_COUNTERS* link_counters)
+{
+    /*Codes_SRS_BROKER_STATISTICS_13_010: [ If statistics or link_counters is NULL, BrokerStatistics_FillLink shall do nothing. ]*/
+    if (statistics == NULL || link_counters == NULL)
+    {
+        LogError("invalid arg statistics=%p link_counters=%p", statistics, link_counters);
+    }
+    else
+    {
+        /*Codes_SRS_BROKER_STATISTICS_13_011: [ BrokerStatistics_FillLink shall copy the messages and bytes of link_counters. ]*/
+        statistics->messages = link_counters->messages;
+        statistics->bytes = link_counters->bytes;
+
+        if (link_counters->last_activity_time == 0)
+        {
+            /*Codes_SRS_BROKER_STATISTICS_13_012: [ If no message was routed over the link, BrokerStatistics_FillLink shall set the last activity to 0. ]*/
+            statistics->last_activity = 0;
+        }
+        else
+        {
+            /*Codes_SRS_BROKER_STATISTICS_13_013: [ Otherwise, BrokerStatistics_FillLink shall set the last activity to the current calendar time minus the seconds elapsed on the monotonic clock since the last message was routed. ]*/
+            uint64_t now = BrokerStatistics_GetTime();
+            uint64_t age = (now > link_counters->last_activity_time) ? now - link_counters->last_activity_time : 0;
+            statistics->last_activity = time(NULL) - (time_t)(age / 1000000);
+        }
+    }
+}
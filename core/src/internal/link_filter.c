@@ -0,0 +1,344 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "internal/link_filter.h"
+
+/*The structure backing the link filter handle. The conditions, the lengths of
+their values and the strings follow the structure in the same allocation.*/
+typedef struct LINK_FILTER_TAG
+{
+    BROKER_LINK_FILTER      definition;
+    /*the lengths of the values of the conditions, so that a prefix is not measured for every message*/
+    size_t*                 value_lengths;
+} LINK_FILTER;
+
+/*returns nonzero when the operation of condition does not compare the property with a value*/
+static int ignores_value(const BROKER_FILTER_CONDITION* condition)
+{
+    return condition->operation == BROKER_FILTER_EXISTS || condition->operation == BROKER_FILTER_PARTITION;
+}
+
+/*returns the length of the value of condition that is copied, 0 when the operation ignores it*/
+static size_t get_copied_value_length(const BROKER_FILTER_CONDITION* condition)
+{
+    return ignores_value(condition) ? 0 : strlen(condition->value);
+}
+
+/*32 bit FNV-1a, cheap and stable across runs so that a value always picks the same partition*/
+static uint32_t hash_value(const char* value)
+{
+    uint32_t hash = 2166136261u;
+    const unsigned char* c;
+    for (c = (const unsigned char*)value; *c != '\0'; c++)
+    {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*returns the property of the message called name, looking it up and remembering it unless filter_message remembers it already or is full, in which case scratch receives it*/
+static LINK_FILTER_PROPERTY* get_property(LINK_FILTER_MESSAGE* filter_message, const char* name, LINK_FILTER_PROPERTY* scratch)
+{
+    LINK_FILTER_PROPERTY* result = NULL;
+    size_t i;
+    for (i = 0; i < filter_message->property_count; i++)
+    {
+        if (filter_message->properties[i].name == name || strcmp(filter_message->properties[i].name, name) == 0)
+        {
+            result = &filter_message->properties[i];
+            break;
+        }
+    }
+
+    if (result == NULL)
+    {
+        result = (filter_message->property_count < LINK_FILTER_MESSAGE_PROPERTY_COUNT) ?
+            &filter_message->properties[filter_message->property_count++] :
+            scratch;
+        result->name = name;
+        /*Codes_SRS_LINK_FILTER_13_010: [ LinkFilter_Matches shall get the value of the property of every condition by calling Message_GetProperty, in order, and return 0 as soon as a condition does not pass. ]*/
+        result->value = Message_GetProperty(filter_message->message, name);
+        result->hashed = 0;
+    }
+    return result;
+}
+
+/*returns nonzero when the value of property falls in the partition of condition*/
+static int is_in_partition(const BROKER_FILTER_CONDITION* condition, LINK_FILTER_PROPERTY* property)
+{
+    /*Codes_SRS_LINK_FILTER_13_017: [ LinkFilter_MatchesMessage shall hash the value of a property at most once per LINK_FILTER_MESSAGE, and test every BROKER_FILTER_PARTITION condition on that property against the same hash. ]*/
+    if (!property->hashed)
+    {
+        property->hash = hash_value((property->value == NULL) ? "" : property->value);
+        property->hashed = 1;
+    }
+    /*Codes_SRS_LINK_FILTER_13_014: [ A BROKER_FILTER_PARTITION condition shall pass when the 32 bit FNV-1a hash of the value of the property, or of an empty value if the message does not have the property, modulo partition_count is partition. ]*/
+    return (property->hash % condition->partition_count) == condition->partition;
+}
+
+/*returns 0 when the condition can be compiled*/
+static int validate_condition(const BROKER_FILTER_CONDITION* condition)
+{
+    int result;
+    if (condition->name == NULL)
+    {
+        LogError("a filter condition has no property name");
+        result = __LINE__;
+    }
+    else if (condition->operation != BROKER_FILTER_EQUALS &&
+             condition->operation != BROKER_FILTER_PREFIX &&
+             condition->operation != BROKER_FILTER_EXISTS &&
+             condition->operation != BROKER_FILTER_PARTITION)
+    {
+        LogError("the filter condition on property [%s] has an invalid operation %d", condition->name, (int)condition->operation);
+        result = __LINE__;
+    }
+    else if (!ignores_value(condition) && condition->value == NULL)
+    {
+        LogError("the filter condition on property [%s] has no value", condition->name);
+        result = __LINE__;
+    }
+    /*Codes_SRS_LINK_FILTER_13_013: [ If a condition has the operation BROKER_FILTER_PARTITION and its partition_count is 0 or its partition is not less than its partition_count, LinkFilter_Create shall return NULL. ]*/
+    else if (condition->operation == BROKER_FILTER_PARTITION &&
+             (condition->partition_count == 0 || condition->partition >= condition->partition_count))
+    {
+        LogError("the filter condition on property [%s] has partition %zu of %zu", condition->name, condition->partition, condition->partition_count);
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+LINK_FILTER_HANDLE LinkFilter_Create(const BROKER_LINK_FILTER* definition)
+{
+    LINK_FILTER* result;
+    if (definition == NULL || definition->conditions == NULL || definition->condition_count == 0)
+    {
+        /*Codes_SRS_LINK_FILTER_13_001: [ If definition is NULL, or it has no condition, LinkFilter_Create shall return NULL. ]*/
+        LogError("invalid arg: definition=%p", definition);
+        result = NULL;
+    }
+    else if (definition->condition_count > (SIZE_MAX - sizeof(LINK_FILTER)) / (sizeof(BROKER_FILTER_CONDITION) + sizeof(size_t)))
+    {
+        /*Codes_SRS_LINK_FILTER_13_003: [ If the size of the filter overflows or the allocation fails, LinkFilter_Create shall return NULL. ]*/
+        LogError("filter of %zu conditions is too large", definition->condition_count);
+        result = NULL;
+    }
+    else
+    {
+        size_t count = definition->condition_count;
+        size_t size = sizeof(LINK_FILTER) + count * (sizeof(BROKER_FILTER_CONDITION) + sizeof(size_t));
+        size_t i;
+
+        for (i = 0; i < count; i++)
+        {
+            /*Codes_SRS_LINK_FILTER_13_002: [ If a condition has no name, has an operation that is not a BROKER_FILTER_OPERATION or, unless its operation is BROKER_FILTER_EXISTS or BROKER_FILTER_PARTITION, has no value, LinkFilter_Create shall return NULL. ]*/
+            if (validate_condition(&definition->conditions[i]) != 0)
+            {
+                break;
+            }
+            else
+            {
+                size_t strings_size = strlen(definition->conditions[i].name) + 1 + get_copied_value_length(&definition->conditions[i]) + 1;
+                if (strings_size > SIZE_MAX - size)
+                {
+                    LogError("filter is too large");
+                    break;
+                }
+                size += strings_size;
+            }
+        }
+
+        if (i < count)
+        {
+            result = NULL;
+        }
+        /*Codes_SRS_LINK_FILTER_13_004: [ LinkFilter_Create shall copy the conditions of definition, their strings and the lengths of their values in one allocation. ]*/
+        else if ((result = (LINK_FILTER*)malloc(size)) == NULL)
+        {
+            /*Codes_SRS_LINK_FILTER_13_003: [ If the size of the filter overflows or the allocation fails, LinkFilter_Create shall return NULL. ]*/
+            LogError("malloc failed for a filter of %zu conditions", count);
+        }
+        else
+        {
+            /*the conditions are aligned for pointers as they start right after the structure, and so are the lengths after them*/
+            BROKER_FILTER_CONDITION* conditions = (BROKER_FILTER_CONDITION*)(result + 1);
+            char* strings;
+
+            result->value_lengths = (size_t*)(conditions + count);
+            strings = (char*)(result->value_lengths + count);
+            for (i = 0; i < count; i++)
+            {
+                const BROKER_FILTER_CONDITION* condition = &definition->conditions[i];
+                size_t name_length = strlen(condition->name);
+                size_t value_length = get_copied_value_length(condition);
+
+                conditions[i].operation = condition->operation;
+                conditions[i].name = strings;
+                (void)memcpy(strings, condition->name, name_length + 1);
+                strings += name_length + 1;
+
+                /*a condition that ignores its value gets an empty one*/
+                conditions[i].value = strings;
+                if (value_length > 0)
+                {
+                    (void)memcpy(strings, condition->value, value_length);
+                }
+                strings[value_length] = '\0';
+                strings += value_length + 1;
+
+                conditions[i].partition = (condition->operation == BROKER_FILTER_PARTITION) ? condition->partition : 0;
+                conditions[i].partition_count = (condition->operation == BROKER_FILTER_PARTITION) ? condition->partition_count : 0;
+
+                result->value_lengths[i] = value_length;
+            }
+            result->definition.conditions = conditions;
+            result->definition.condition_count = count;
+        }
+    }
+
+    return result;
+}
+
+void LinkFilter_Destroy(LINK_FILTER_HANDLE filter)
+{
+    /*Codes_SRS_LINK_FILTER_13_005: [ LinkFilter_Destroy shall free the filter, and do nothing if it is NULL. ]*/
+    free(filter);
+}
+
+const BROKER_LINK_FILTER* LinkFilter_GetDefinition(LINK_FILTER_HANDLE filter)
+{
+    /*Codes_SRS_LINK_FILTER_13_006: [ LinkFilter_GetDefinition shall return the copy of the definition held by filter, or NULL if filter is NULL. ]*/
+    return (filter == NULL) ? NULL : &filter->definition;
+}
+
+int LinkFilter_IsSameAs(LINK_FILTER_HANDLE filter, const BROKER_LINK_FILTER* definition)
+{
+    int result;
+    if (filter == NULL || definition == NULL)
+    {
+        /*Codes_SRS_LINK_FILTER_13_007: [ If filter or definition is NULL, LinkFilter_IsSameAs shall return a non-zero value if both are NULL and 0 otherwise. ]*/
+        result = (filter == NULL && definition == NULL);
+    }
+    else if (filter->definition.condition_count != definition->condition_count)
+    {
+        /*Codes_SRS_LINK_FILTER_13_008: [ Otherwise LinkFilter_IsSameAs shall return a non-zero value if definition has the same number of conditions as filter and each of them has the same operation, name and, unless the operation is BROKER_FILTER_EXISTS or BROKER_FILTER_PARTITION, value as the condition of filter at the same position, and 0 otherwise. ]*/
+        result = 0;
+    }
+    else
+    {
+        size_t i;
+        result = 1;
+        for (i = 0; i < definition->condition_count; i++)
+        {
+            const BROKER_FILTER_CONDITION* mine = &filter->definition.conditions[i];
+            const BROKER_FILTER_CONDITION* theirs = &definition->conditions[i];
+            if (mine->operation != theirs->operation ||
+                theirs->name == NULL ||
+                strcmp(mine->name, theirs->name) != 0 ||
+                (!ignores_value(mine) &&
+                 (theirs->value == NULL || strcmp(mine->value, theirs->value) != 0)) ||
+                /*Codes_SRS_LINK_FILTER_13_015: [ Two BROKER_FILTER_PARTITION conditions shall only be the same if they have the same partition and partition_count. ]*/
+                (mine->operation == BROKER_FILTER_PARTITION &&
+                 (mine->partition != theirs->partition || mine->partition_count != theirs->partition_count)))
+            {
+                result = 0;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+int LinkFilter_Matches(LINK_FILTER_HANDLE filter, MESSAGE_HANDLE message)
+{
+    int result;
+    if (filter == NULL)
+    {
+        /*Codes_SRS_LINK_FILTER_13_009: [ If filter is NULL, LinkFilter_Matches shall return a non-zero value. ]*/
+        result = 1;
+    }
+    else
+    {
+        LINK_FILTER_MESSAGE filter_message;
+        LinkFilter_InitMessage(&filter_message, message);
+        result = LinkFilter_MatchesMessage(filter, &filter_message);
+    }
+    return result;
+}
+
+void LinkFilter_InitMessage(LINK_FILTER_MESSAGE* filter_message, MESSAGE_HANDLE message)
+{
+    if (filter_message == NULL)
+    {
+        LogError("invalid arg: filter_message is NULL");
+    }
+    else
+    {
+        /*Codes_SRS_LINK_FILTER_13_016: [ LinkFilter_InitMessage shall set the message of filter_message and forget every property, and do nothing if filter_message is NULL. ]*/
+        filter_message->message = message;
+        filter_message->property_count = 0;
+    }
+}
+
+int LinkFilter_MatchesMessage(LINK_FILTER_HANDLE filter, LINK_FILTER_MESSAGE* filter_message)
+{
+    int result;
+    if (filter == NULL)
+    {
+        /*Codes_SRS_LINK_FILTER_13_009: [ If filter is NULL, LinkFilter_Matches shall return a non-zero value. ]*/
+        result = 1;
+    }
+    else if (filter_message == NULL)
+    {
+        /*Codes_SRS_LINK_FILTER_13_018: [ If filter is not NULL and filter_message is NULL, LinkFilter_MatchesMessage shall return 0. ]*/
+        LogError("invalid arg: filter_message is NULL");
+        result = 0;
+    }
+    else
+    {
+        size_t i;
+        /*Codes_SRS_LINK_FILTER_13_011: [ A BROKER_FILTER_EXISTS condition shall pass when the message has the property, a BROKER_FILTER_EQUALS condition when the value of the property is the value of the condition and a BROKER_FILTER_PREFIX condition when the value of the property starts with the value of the condition. ]*/
+        /*Codes_SRS_LINK_FILTER_13_012: [ LinkFilter_Matches shall return a non-zero value if all the conditions pass. ]*/
+        result = 1;
+        for (i = 0; i < filter->definition.condition_count; i++)
+        {
+            const BROKER_FILTER_CONDITION* condition = &filter->definition.conditions[i];
+            LINK_FILTER_PROPERTY scratch;
+            /*Codes_SRS_LINK_FILTER_13_019: [ LinkFilter_MatchesMessage shall call Message_GetProperty only for the properties filter_message does not remember, and shall remember the first LINK_FILTER_MESSAGE_PROPERTY_COUNT properties it looks up. ]*/
+            LINK_FILTER_PROPERTY* property = get_property(filter_message, condition->name, &scratch);
+            const char* value = property->value;
+            if (condition->operation == BROKER_FILTER_PARTITION)
+            {
+                if (!is_in_partition(condition, property))
+                {
+                    result = 0;
+                    break;
+                }
+            }
+            else if (value == NULL ||
+                (condition->operation == BROKER_FILTER_EQUALS && strcmp(value, condition->value) != 0) ||
+                (condition->operation == BROKER_FILTER_PREFIX && strncmp(value, condition->value, filter->value_lengths[i]) != 0))
+            {
+                result = 0;
+                break;
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,173 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "message.h"
+#include "internal/message_queue.h"
+
+#define MESSAGE_QUEUE_INITIAL_CAPACITY 16
+
+/*The structure backing the message queue handle. The messages live in
+'buffer[head]' to 'buffer[(head + count - 1) % capacity]'.*/
+typedef struct MESSAGE_QUEUE_TAG
+{
+    MESSAGE_HANDLE*     buffer;
+    size_t              capacity;
+    size_t              head;
+    size_t              count;
+}MESSAGE_QUEUE;
+
+MESSAGE_QUEUE_HANDLE MessageQueue_Create(void)
+{
+    /*Codes_SRS_MESSAGE_QUEUE_13_001: [MessageQueue_Create shall allocate a new MESSAGE_QUEUE and return NULL if it fails.]*/
+    MESSAGE_QUEUE* result = (MESSAGE_QUEUE*)malloc(sizeof(MESSAGE_QUEUE));
+    if (result == NULL)
+    {
+        LogError("malloc failed");
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_13_002: [MessageQueue_Create shall return an empty queue that has no storage allocated.]*/
+        result->buffer = NULL;
+        result->capacity = 0;
+        result->head = 0;
+        result->count = 0;
+    }
+    return result;
+}
+
+void MessageQueue_Destroy(MESSAGE_QUEUE_HANDLE queue)
+{
+    /*Codes_SRS_MESSAGE_QUEUE_13_003: [If queue is NULL, MessageQueue_Destroy shall do nothing.]*/
+    if (queue == NULL)
+    {
+        LogError("queue handle is NULL");
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_13_004: [MessageQueue_Destroy shall call Message_Destroy on every message still in the queue.]*/
+        while (queue->count > 0)
+        {
+            Message_Destroy(MessageQueue_Pop(queue));
+        }
+
+        /*Codes_SRS_MESSAGE_QUEUE_13_005: [MessageQueue_Destroy shall free all the resources used by the queue.]*/
+        free(queue->buffer);
+        free(queue);
+    }
+}
+
+/*doubles the capacity of a full queue, unwrapping the messages that wrapped around the end of the buffer*/
+static int grow_queue(MESSAGE_QUEUE* queue)
+{
+    int result;
+    size_t new_capacity = (queue->capacity == 0) ? MESSAGE_QUEUE_INITIAL_CAPACITY : queue->capacity * 2;
+    MESSAGE_HANDLE* new_buffer;
+
+    if (new_capacity < queue->capacity || new_capacity > ((size_t)-1) / sizeof(MESSAGE_HANDLE))
+    {
+        LogError("message queue capacity overflow");
+        result = __LINE__;
+    }
+    else if ((new_buffer = (MESSAGE_HANDLE*)realloc(queue->buffer, new_capacity * sizeof(MESSAGE_HANDLE))) == NULL)
+    {
+        LogError("realloc failed");
+        result = __LINE__;
+    }
+    else
+    {
+        /*the queue is full, so it wraps around whenever head is not at the start of the buffer*/
+        if (queue->head > 0)
+        {
+            (void)memcpy(new_buffer + queue->capacity, new_buffer, queue->head * sizeof(MESSAGE_HANDLE));
+        }
+        queue->buffer = new_buffer;
+        queue->capacity = new_capacity;
+        result = 0;
+    }
+
+    return result;
+}
+
+int MessageQueue_Push(MESSAGE_QUEUE_HANDLE queue, MESSAGE_HANDLE message)
+{
+    int result;
+
+    /*Codes_SRS_MESSAGE_QUEUE_13_006: [If queue or message is NULL, MessageQueue_Push shall fail and return a non-zero value.]*/
+    if (queue == NULL || message == NULL)
+    {
+        LogError("invalid arg queue=%p, message=%p", queue, message);
+        result = __LINE__;
+    }
+    /*Codes_SRS_MESSAGE_QUEUE_13_007: [If the queue is full, MessageQueue_Push shall double its capacity, keeping the messages in order.]*/
+    else if (queue->count == queue->capacity && grow_queue(queue) != 0)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_13_008: [If growing the queue fails, MessageQueue_Push shall fail and return a non-zero value, leaving the queue unchanged.]*/
+        LogError("unable to grow the message queue");
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_13_009: [MessageQueue_Push shall store message at the back of the queue and return 0.]*/
+        queue->buffer[(queue->head + queue->count) % queue->capacity] = message;
+        queue->count++;
+        result = 0;
+    }
+
+    return result;
+}
+
+MESSAGE_HANDLE MessageQueue_Pop(MESSAGE_QUEUE_HANDLE queue)
+{
+    MESSAGE_HANDLE result;
+
+    /*Codes_SRS_MESSAGE_QUEUE_13_010: [If queue is NULL or empty, MessageQueue_Pop shall return NULL.]*/
+    if (queue == NULL || queue->count == 0)
+    {
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_13_011: [MessageQueue_Pop shall remove the message at the front of the queue and return it.]*/
+        result = queue->buffer[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        if (queue->count == 0)
+        {
+            queue->head = 0;
+        }
+    }
+
+    return result;
+}
+
+size_t MessageQueue_Size(MESSAGE_QUEUE_HANDLE queue)
+{
+    /*Codes_SRS_MESSAGE_QUEUE_13_012: [MessageQueue_Size shall return the number of messages in the queue, or 0 if queue is NULL.]*/
+    return (queue == NULL) ? 0 : queue->count;
+}
+
+void MessageQueue_Swap(MESSAGE_QUEUE_HANDLE queue1, MESSAGE_QUEUE_HANDLE queue2)
+{
+    /*Codes_SRS_MESSAGE_QUEUE_13_013: [If queue1 or queue2 is NULL, MessageQueue_Swap shall do nothing.]*/
+    if (queue1 == NULL || queue2 == NULL)
+    {
+        LogError("invalid arg queue1=%p, queue2=%p", queue1, queue2);
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_13_014: [MessageQueue_Swap shall exchange the content of queue1 and queue2 without copying any message.]*/
+        MESSAGE_QUEUE temp = *queue1;
+        *queue1 = *queue2;
+        *queue2 = temp;
+    }
+}
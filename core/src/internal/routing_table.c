@@ -0,0 +1,361 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <stdint.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/refcount.h"
+
+#include "internal/atomic_ops.h"
+#include "internal/routing_table.h"
+
+/*An immutable snapshot. The entries and the sinks of all the entries follow
+the structure in the same allocation.*/
+typedef struct ROUTING_SNAPSHOT_TAG
+{
+    ROUTING_ENTRY*      entries;
+    size_t              entry_count;
+    size_t              entry_capacity;
+    ROUTING_SINK*       sinks;
+    size_t              sink_used;
+    size_t              sink_capacity;
+} ROUTING_SNAPSHOT;
+
+/*The ref count of a snapshot is the number of publishers that acquired it,
+plus one for the table while the snapshot is current (or for its builder
+before it is installed). It is only changed with INC_REF and DEC_REF, so
+acquiring and releasing a snapshot take no lock.*/
+DEFINE_REFCOUNT_TYPE(ROUTING_SNAPSHOT);
+
+#define SNAPSHOT_REFERENCES(snapshot) (((REFCOUNT_TYPE(ROUTING_SNAPSHOT)*)(snapshot))->count)
+
+/*how long RoutingTable_Swap waits for a signal before it checks the ref count
+of the previous snapshot again; the last reader signals under the table lock,
+so this only bounds the wait when it could not take the lock and the signal
+came between the check and the wait*/
+#define RELEASE_WAIT_MS 1000
+
+/*The structure backing the routing table handle. The lock serializes the
+swaps and guards the signal of the condition, publishers never take it.*/
+typedef struct ROUTING_TABLE_TAG
+{
+    LOCK_HANDLE         lock;
+    /*signaled when the last reader of a replaced snapshot releases it*/
+    COND_HANDLE         released_cond;
+    /*only read and written with the atomic operations*/
+    ROUTING_SNAPSHOT*   current;
+    /*the publishers between reading current and taking their reference to
+    it, counted in the slot of the phase they started in; a swap flips the
+    phase, so it only waits for the publishers that started before*/
+    long                phase;
+    long                acquiring[2];
+} ROUTING_TABLE;
+
+ROUTING_TABLE_HANDLE RoutingTable_Create(void)
+{
+    /*Codes_SRS_ROUTING_TABLE_13_001: [ RoutingTable_Create shall allocate the table and create its lock and condition. ]*/
+    ROUTING_TABLE* result = (ROUTING_TABLE*)malloc(sizeof(ROUTING_TABLE));
+    if (result == NULL)
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_002: [ If any allocation or resource creation fails, RoutingTable_Create shall free every resource it created and return NULL. ]*/
+        LogError("malloc failed for routing table");
+    }
+    else if ((result->lock = Lock_Init()) == NULL)
+    {
+        LogError("Lock_Init failed");
+        free(result);
+        result = NULL;
+    }
+    else if ((result->released_cond = Condition_Init()) == NULL)
+    {
+        LogError("Condition_Init failed");
+        (void)Lock_Deinit(result->lock);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_003: [ The table shall not have a snapshot. ]*/
+        result->current = NULL;
+        result->phase = 0;
+        result->acquiring[0] = 0;
+        result->acquiring[1] = 0;
+    }
+
+    return result;
+}
+
+void RoutingTable_Destroy(ROUTING_TABLE_HANDLE table)
+{
+    if (table == NULL)
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_004: [ If table is NULL, RoutingTable_Destroy shall do nothing. ]*/
+        LogError("invalid arg: table is NULL");
+    }
+    else
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_005: [ RoutingTable_Destroy shall free the current snapshot and all the resources used by the table. ]*/
+        RoutingSnapshot_Destroy(table->current);
+        Condition_Deinit(table->released_cond);
+        (void)Lock_Deinit(table->lock);
+        free(table);
+    }
+}
+
+/*Waits until every publisher that may have read the previous snapshot has
+taken its reference to it. A publisher that read the phase before the flip
+may count itself in the slot of the other phase, hence the second round; a
+publisher that counts itself after a slot is seen empty reads the current
+snapshot after the exchange.*/
+static void wait_for_acquiring_publishers(ROUTING_TABLE* table)
+{
+    int round;
+    for (round = 0; round < 2; round++)
+    {
+        long previous_phase = ATOMIC_INCREMENT_COUNTER(&table->phase) - 1;
+        while (ATOMIC_LOAD_COUNTER(&table->acquiring[previous_phase & 1]) != 0)
+        {
+            /*a publisher is in RoutingTable_Acquire for a few instructions, it does not block there unless it is preempted*/
+            ATOMIC_SPIN_YIELD();
+        }
+    }
+}
+
+void RoutingTable_Swap(ROUTING_TABLE_HANDLE table, ROUTING_SNAPSHOT_HANDLE snapshot)
+{
+    if (table == NULL)
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_006: [ If table is NULL, RoutingTable_Swap shall destroy snapshot and return. ]*/
+        LogError("invalid arg: table is NULL");
+        RoutingSnapshot_Destroy(snapshot);
+    }
+    else
+    {
+        if (Lock(table->lock) != LOCK_OK)
+        {
+            /*Codes_SRS_ROUTING_TABLE_13_026: [ If acquiring the table lock fails, RoutingTable_Swap shall still make snapshot the current snapshot and leak the previous snapshot instead of freeing it. ]*/
+            LogError("unable to lock the routing table, the previous snapshot is leaked");
+            (void)ATOMIC_EXCHANGE_POINTER(&table->current, snapshot);
+        }
+        else
+        {
+            ROUTING_SNAPSHOT* previous;
+            int wait_failed = 0;
+
+            /*Codes_SRS_ROUTING_TABLE_13_007: [ RoutingTable_Swap shall make snapshot the current snapshot of the table with an atomic exchange under the table lock. ]*/
+            previous = (ROUTING_SNAPSHOT*)ATOMIC_EXCHANGE_POINTER(&table->current, snapshot);
+
+            /*Codes_SRS_ROUTING_TABLE_13_028: [ RoutingTable_Swap shall then flip the phase of the table and wait until no publisher counted in the previous phase is acquiring, twice, so that no publisher is between reading the previous snapshot and taking its reference to it. ]*/
+            wait_for_acquiring_publishers(table);
+
+            /*Codes_SRS_ROUTING_TABLE_13_008: [ RoutingTable_Swap shall drop the reference of the table to the previous snapshot and wait on the table condition until the previous snapshot has no reader. ]*/
+            if (previous != NULL && DEC_REF(ROUTING_SNAPSHOT, previous) != DEC_RETURN_ZERO)
+            {
+                while (SNAPSHOT_REFERENCES(previous) != 0)
+                {
+                    /*Codes_SRS_ROUTING_TABLE_13_027: [ If waiting on the table condition fails, RoutingTable_Swap shall check the ref count of the previous snapshot again. ]*/
+                    if (Condition_Wait(table->released_cond, table->lock, RELEASE_WAIT_MS) == COND_ERROR && !wait_failed)
+                    {
+                        wait_failed = 1;
+                        LogError("Condition_Wait failed, polling the readers of the routing snapshot");
+                    }
+                }
+            }
+            (void)Unlock(table->lock);
+
+            /*Codes_SRS_ROUTING_TABLE_13_009: [ RoutingTable_Swap shall then free the previous snapshot. ]*/
+            RoutingSnapshot_Destroy(previous);
+        }
+    }
+}
+
+ROUTING_SNAPSHOT_HANDLE RoutingTable_Acquire(ROUTING_TABLE_HANDLE table)
+{
+    ROUTING_SNAPSHOT* result;
+    if (table == NULL)
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_010: [ If table is NULL, RoutingTable_Acquire shall return NULL. ]*/
+        LogError("invalid arg: table is NULL");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_011: [ RoutingTable_Acquire shall not take the table lock. ]*/
+        /*Codes_SRS_ROUTING_TABLE_13_012: [ RoutingTable_Acquire shall count itself in the publishers of the current phase of the table that are acquiring, read the current snapshot with an atomic load, increment its ref count, stop counting itself and return it, or return NULL if the table has no snapshot. ]*/
+        long* acquiring = &table->acquiring[ATOMIC_LOAD_COUNTER(&table->phase) & 1];
+        (void)ATOMIC_INCREMENT_COUNTER(acquiring);
+        result = (ROUTING_SNAPSHOT*)ATOMIC_LOAD_POINTER(&table->current);
+        if (result != NULL)
+        {
+            INC_REF(ROUTING_SNAPSHOT, result);
+        }
+        (void)ATOMIC_DECREMENT_COUNTER(acquiring);
+    }
+
+    return result;
+}
+
+void RoutingTable_Release(ROUTING_TABLE_HANDLE table, ROUTING_SNAPSHOT_HANDLE snapshot)
+{
+    if (table == NULL || snapshot == NULL)
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_013: [ If table or snapshot is NULL, RoutingTable_Release shall do nothing. ]*/
+        LogError("invalid arg: table=%p, snapshot=%p", table, snapshot);
+    }
+    /*Codes_SRS_ROUTING_TABLE_13_014: [ RoutingTable_Release shall decrement the ref count of snapshot without taking the table lock. ]*/
+    else if (DEC_REF(ROUTING_SNAPSHOT, snapshot) == DEC_RETURN_ZERO)
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_015: [ If that drops the last reference to snapshot, which is then no longer current, RoutingTable_Release shall signal the table condition under the table lock. ]*/
+        int locked = (Lock(table->lock) == LOCK_OK);
+        if (!locked)
+        {
+            /*Codes_SRS_ROUTING_TABLE_13_029: [ If acquiring the table lock fails, RoutingTable_Release shall signal the table condition without it. ]*/
+            LogError("unable to lock the routing table, signaling without the lock");
+        }
+
+        if (Condition_Post(table->released_cond) != COND_OK)
+        {
+            LogError("Condition_Post failed");
+        }
+
+        if (locked)
+        {
+            (void)Unlock(table->lock);
+        }
+    }
+    else
+    {
+        /*other publishers, or the table, still hold the snapshot*/
+    }
+}
+
+ROUTING_SNAPSHOT_HANDLE RoutingSnapshot_Create(size_t entry_count, size_t sink_count)
+{
+    ROUTING_SNAPSHOT* result;
+    REFCOUNT_TYPE(ROUTING_SNAPSHOT)* ref_counted;
+    size_t entries_size = entry_count * sizeof(ROUTING_ENTRY);
+    size_t sinks_size = sink_count * sizeof(ROUTING_SINK);
+
+    if (entry_count > SIZE_MAX / sizeof(ROUTING_ENTRY) ||
+        sink_count > SIZE_MAX / sizeof(ROUTING_SINK) ||
+        sinks_size > SIZE_MAX - sizeof(REFCOUNT_TYPE(ROUTING_SNAPSHOT)) ||
+        entries_size > SIZE_MAX - sizeof(REFCOUNT_TYPE(ROUTING_SNAPSHOT)) - sinks_size)
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_017: [ If the size of the snapshot overflows or the allocation fails, RoutingSnapshot_Create shall return NULL. ]*/
+        LogError("snapshot of %zu entries and %zu sinks is too large", entry_count, sink_count);
+        result = NULL;
+    }
+    /*Codes_SRS_ROUTING_TABLE_13_016: [ RoutingSnapshot_Create shall allocate an empty snapshot with room for entry_count entries and sink_count sinks in one allocation. ]*/
+    else if ((ref_counted = (REFCOUNT_TYPE(ROUTING_SNAPSHOT)*)malloc(sizeof(REFCOUNT_TYPE(ROUTING_SNAPSHOT)) + entries_size + sinks_size)) == NULL)
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_017: [ If the size of the snapshot overflows or the allocation fails, RoutingSnapshot_Create shall return NULL. ]*/
+        LogError("malloc failed for routing snapshot");
+        result = NULL;
+    }
+    else
+    {
+        /*same as REFCOUNT_TYPE_CREATE, with the entries and the sinks after the ref count*/
+        ref_counted->count = 1;
+        result = &ref_counted->counted;
+        /*the entries are aligned for pointers as they start right after the ref counted structure, and so are the sinks after them*/
+        result->entries = (ROUTING_ENTRY*)(ref_counted + 1);
+        result->entry_count = 0;
+        result->entry_capacity = entry_count;
+        result->sinks = (ROUTING_SINK*)(result->entries + entry_count);
+        result->sink_used = 0;
+        result->sink_capacity = sink_count;
+    }
+
+    return result;
+}
+
+void RoutingSnapshot_Destroy(ROUTING_SNAPSHOT_HANDLE snapshot)
+{
+    /*Codes_SRS_ROUTING_TABLE_13_018: [ RoutingSnapshot_Destroy shall free the snapshot, and do nothing if it is NULL. ]*/
+    free(snapshot);
+}
+
+ROUTING_SINK* RoutingSnapshot_AddEntry(ROUTING_SNAPSHOT_HANDLE snapshot, const void* key, void* module, size_t sink_count)
+{
+    ROUTING_SINK* result;
+    if (snapshot == NULL ||
+        snapshot->entry_count == snapshot->entry_capacity ||
+        sink_count > snapshot->sink_capacity - snapshot->sink_used)
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_019: [ If snapshot is NULL, or it has no room for one more entry or for sink_count more sinks, RoutingSnapshot_AddEntry shall return NULL. ]*/
+        LogError("no room in the routing snapshot");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_020: [ RoutingSnapshot_AddEntry shall append an entry with key, module and the next sink_count sinks of the snapshot, and return those sinks. ]*/
+        ROUTING_ENTRY* entry = &snapshot->entries[snapshot->entry_count];
+        result = snapshot->sinks + snapshot->sink_used;
+        entry->key = key;
+        entry->module = module;
+        entry->sinks = result;
+        entry->sink_count = sink_count;
+        snapshot->entry_count++;
+        snapshot->sink_used += sink_count;
+    }
+
+    return result;
+}
+
+const ROUTING_ENTRY* RoutingSnapshot_Find(ROUTING_SNAPSHOT_HANDLE snapshot, const void* key)
+{
+    const ROUTING_ENTRY* result = NULL;
+    if (snapshot == NULL)
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_021: [ If snapshot is NULL, RoutingSnapshot_Find shall return NULL. ]*/
+        LogError("invalid arg: snapshot is NULL");
+    }
+    else
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_022: [ RoutingSnapshot_Find shall return the first entry of the snapshot whose key is key, or NULL if there is none. ]*/
+        size_t i;
+        for (i = 0; i < snapshot->entry_count; i++)
+        {
+            if (snapshot->entries[i].key == key)
+            {
+                result = &snapshot->entries[i];
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+const ROUTING_ENTRY* RoutingSnapshot_GetEntries(ROUTING_SNAPSHOT_HANDLE snapshot, size_t* entry_count)
+{
+    const ROUTING_ENTRY* result;
+    if (entry_count == NULL)
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_023: [ If entry_count is NULL, RoutingSnapshot_GetEntries shall return NULL. ]*/
+        LogError("invalid arg: entry_count is NULL");
+        result = NULL;
+    }
+    else if (snapshot == NULL || snapshot->entry_count == 0)
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_024: [ If snapshot is NULL or empty, RoutingSnapshot_GetEntries shall set entry_count to 0 and return NULL. ]*/
+        *entry_count = 0;
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_ROUTING_TABLE_13_025: [ Otherwise RoutingSnapshot_GetEntries shall set entry_count to the number of entries and return them in the order they were added. ]*/
+        *entry_count = snapshot->entry_count;
+        result = snapshot->entries;
+    }
+
+    return result;
+}
@@ -0,0 +1,181 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __linux__
+/*pthread_setaffinity_np and pthread_setname_np are GNU extensions*/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#endif
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "internal/thread_options.h"
+
+/*number of processors BROKER_THREAD_OPTIONS::cpu_affinity can name*/
+#define THREAD_OPTIONS_CPU_COUNT 64
+
+int ThreadOptions_IsDefault(const BROKER_THREAD_OPTIONS* options)
+{
+    /*Codes_SRS_THREAD_OPTIONS_13_001: [ ThreadOptions_IsDefault shall return nonzero if options is NULL, or if its cpu_affinity is 0, its policy is BROKER_THREAD_POLICY_DEFAULT and its name is empty, and 0 otherwise. ]*/
+    return options == NULL ||
+        (options->cpu_affinity == 0 && options->policy == BROKER_THREAD_POLICY_DEFAULT && options->name[0] == '\0');
+}
+
+#if defined(UWP_BINDING)
+
+int ThreadOptions_Apply(const BROKER_THREAD_OPTIONS* options)
+{
+    int result;
+    /*Codes_SRS_THREAD_OPTIONS_13_002: [ If options is NULL, ThreadOptions_Apply shall fail and return a non-zero value. ]*/
+    if (options == NULL)
+    {
+        LogError("invalid arg options=NULL");
+        result = __LINE__;
+    }
+    /*Codes_SRS_THREAD_OPTIONS_13_008: [ On platforms that cannot apply an option, ThreadOptions_Apply shall fail and return a non-zero value if that option is not its default. ]*/
+    else if (options->cpu_affinity != 0 || options->policy != BROKER_THREAD_POLICY_DEFAULT)
+    {
+        /*Codes_SRS_THREAD_OPTIONS_13_006: [ On platforms that cannot name threads, ThreadOptions_Apply shall ignore name. ]*/
+        LogError("UWP applications cannot change the affinity or the scheduling of their threads");
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+#elif defined(_WIN32)
+
+int ThreadOptions_Apply(const BROKER_THREAD_OPTIONS* options)
+{
+    int result;
+    /*Codes_SRS_THREAD_OPTIONS_13_002: [ If options is NULL, ThreadOptions_Apply shall fail and return a non-zero value. ]*/
+    if (options == NULL)
+    {
+        LogError("invalid arg options=NULL");
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+
+        /*Codes_SRS_THREAD_OPTIONS_13_003: [ If cpu_affinity is not 0, ThreadOptions_Apply shall restrict the calling thread to the processors of cpu_affinity, with SetThreadAffinityMask on Windows and pthread_setaffinity_np on Linux. ]*/
+        if (options->cpu_affinity != 0 &&
+            SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)options->cpu_affinity) == 0)
+        {
+            /*Codes_SRS_THREAD_OPTIONS_13_007: [ If an option cannot be applied, ThreadOptions_Apply shall still apply the other options and return a non-zero value. ]*/
+            LogError("SetThreadAffinityMask failed for affinity 0x%llx", (unsigned long long)options->cpu_affinity);
+            result = __LINE__;
+        }
+
+        /*Codes_SRS_THREAD_OPTIONS_13_004: [ If policy is not BROKER_THREAD_POLICY_DEFAULT, ThreadOptions_Apply shall set the scheduling class of the calling thread to SCHED_FIFO or SCHED_RR with priority as its priority, and on Windows only set its priority with SetThreadPriority. ]*/
+        if (options->policy != BROKER_THREAD_POLICY_DEFAULT &&
+            !SetThreadPriority(GetCurrentThread(), options->priority))
+        {
+            /*Codes_SRS_THREAD_OPTIONS_13_007: [ If an option cannot be applied, ThreadOptions_Apply shall still apply the other options and return a non-zero value. ]*/
+            LogError("SetThreadPriority failed for priority %d", options->priority);
+            result = __LINE__;
+        }
+
+        /*Codes_SRS_THREAD_OPTIONS_13_006: [ On platforms that cannot name threads, ThreadOptions_Apply shall ignore name. ]*/
+    }
+    return result;
+}
+
+#else
+
+int ThreadOptions_Apply(const BROKER_THREAD_OPTIONS* options)
+{
+    int result;
+    /*Codes_SRS_THREAD_OPTIONS_13_002: [ If options is NULL, ThreadOptions_Apply shall fail and return a non-zero value. ]*/
+    if (options == NULL)
+    {
+        LogError("invalid arg options=NULL");
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+
+        if (options->cpu_affinity != 0)
+        {
+#ifdef __linux__
+            /*Codes_SRS_THREAD_OPTIONS_13_003: [ If cpu_affinity is not 0, ThreadOptions_Apply shall restrict the calling thread to the processors of cpu_affinity, with SetThreadAffinityMask on Windows and pthread_setaffinity_np on Linux. ]*/
+            cpu_set_t cpus;
+            size_t cpu;
+            CPU_ZERO(&cpus);
+            for (cpu = 0; cpu < THREAD_OPTIONS_CPU_COUNT; cpu++)
+            {
+                if ((options->cpu_affinity >> cpu) & 1)
+                {
+                    CPU_SET(cpu, &cpus);
+                }
+            }
+            if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus) != 0)
+            {
+                /*Codes_SRS_THREAD_OPTIONS_13_007: [ If an option cannot be applied, ThreadOptions_Apply shall still apply the other options and return a non-zero value. ]*/
+                LogError("pthread_setaffinity_np failed for affinity 0x%llx", (unsigned long long)options->cpu_affinity);
+                result = __LINE__;
+            }
+#else
+            /*Codes_SRS_THREAD_OPTIONS_13_008: [ On platforms that cannot apply an option, ThreadOptions_Apply shall fail and return a non-zero value if that option is not its default. ]*/
+            LogError("thread affinity is not supported on this platform");
+            result = __LINE__;
+#endif
+        }
+
+        /*Codes_SRS_THREAD_OPTIONS_13_004: [ If policy is not BROKER_THREAD_POLICY_DEFAULT, ThreadOptions_Apply shall set the scheduling class of the calling thread to SCHED_FIFO or SCHED_RR with priority as its priority, and on Windows only set its priority with SetThreadPriority. ]*/
+        if (options->policy != BROKER_THREAD_POLICY_DEFAULT)
+        {
+            struct sched_param parameters;
+            int policy = (options->policy == BROKER_THREAD_POLICY_FIFO) ? SCHED_FIFO : SCHED_RR;
+            memset(&parameters, 0, sizeof(parameters));
+            parameters.sched_priority = options->priority;
+            if (pthread_setschedparam(pthread_self(), policy, &parameters) != 0)
+            {
+                /*Codes_SRS_THREAD_OPTIONS_13_007: [ If an option cannot be applied, ThreadOptions_Apply shall still apply the other options and return a non-zero value. ]*/
+                LogError("pthread_setschedparam failed for policy %d priority %d", policy, options->priority);
+                result = __LINE__;
+            }
+        }
+
+        if (options->name[0] != '\0')
+        {
+#ifdef __linux__
+            /*Codes_SRS_THREAD_OPTIONS_13_005: [ If name is not empty, ThreadOptions_Apply shall name the calling thread with pthread_setname_np on Linux. ]*/
+            char name[BROKER_THREAD_NAME_SIZE];
+            (void)memcpy(name, options->name, BROKER_THREAD_NAME_SIZE);
+            name[BROKER_THREAD_NAME_SIZE - 1] = '\0';
+            if (pthread_setname_np(pthread_self(), name) != 0)
+            {
+                /*Codes_SRS_THREAD_OPTIONS_13_007: [ If an option cannot be applied, ThreadOptions_Apply shall still apply the other options and return a non-zero value. ]*/
+                LogError("pthread_setname_np failed for name [%s]", name);
+                result = __LINE__;
+            }
+#else
+            /*Codes_SRS_THREAD_OPTIONS_13_006: [ On platforms that cannot name threads, ThreadOptions_Apply shall ignore name. ]*/
+#endif
+        }
+    }
+    return result;
+}
+
+#endif
@@ -0,0 +1,466 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+
+#include "internal/worker_pool.h"
+
+typedef enum STRAND_STATE_TAG
+{
+    STRAND_IDLE,
+    STRAND_QUEUED,
+    STRAND_RUNNING,
+    STRAND_RUNNING_RESCHEDULED
+} STRAND_STATE;
+
+typedef struct WORKER_POOL_TAG WORKER_POOL;
+
+typedef struct STRAND_TAG
+{
+    WORKER_POOL*        pool;
+    STRAND_FUNCTION     function;
+    void*               context;
+    STRAND_STATE        state;
+    /*the worker whose run queue holds the strand while it is queued*/
+    size_t              worker_index;
+    struct STRAND_TAG*  next;
+    int                 destroying;
+    COND_HANDLE         idle_cond;
+} STRAND;
+
+typedef struct WORKER_TAG
+{
+    WORKER_POOL*        pool;
+    size_t              index;
+    THREAD_HANDLE       thread;
+    /*FIFO run queue of the strands queued on this worker*/
+    STRAND*             head;
+    STRAND*             tail;
+} WORKER;
+
+/*The structure backing the worker pool handle. A single lock protects the
+run queues and the state of every strand of the pool; it is only held to
+queue and dequeue strands, never while a strand function runs.*/
+struct WORKER_POOL_TAG
+{
+    LOCK_HANDLE         lock;
+    COND_HANDLE         work_cond;
+    WORKER*             workers;
+    size_t              worker_count;
+    size_t              next_worker;
+    size_t              sleeping_workers;
+    int                 quit;
+};
+
+static size_t get_processor_count(void)
+{
+    size_t result;
+#ifdef _WIN32
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    result = (size_t)system_info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    result = (count > 0) ? (size_t)count : 0;
+#endif
+    return (result == 0) ? 1 : result;
+}
+
+static void push_strand(WORKER* worker, STRAND* strand)
+{
+    strand->state = STRAND_QUEUED;
+    strand->worker_index = worker->index;
+    strand->next = NULL;
+    if (worker->tail == NULL)
+    {
+        worker->head = strand;
+    }
+    else
+    {
+        worker->tail->next = strand;
+    }
+    worker->tail = strand;
+}
+
+static STRAND* pop_strand(WORKER* worker)
+{
+    STRAND* result = worker->head;
+    if (result != NULL)
+    {
+        worker->head = result->next;
+        if (worker->head == NULL)
+        {
+            worker->tail = NULL;
+        }
+        result->next = NULL;
+    }
+    return result;
+}
+
+static void remove_strand(WORKER* worker, STRAND* strand)
+{
+    STRAND* previous = NULL;
+    STRAND* current = worker->head;
+    while (current != NULL && current != strand)
+    {
+        previous = current;
+        current = current->next;
+    }
+
+    if (current != NULL)
+    {
+        if (previous == NULL)
+        {
+            worker->head = current->next;
+        }
+        else
+        {
+            previous->next = current->next;
+        }
+        if (worker->tail == current)
+        {
+            worker->tail = previous;
+        }
+        current->next = NULL;
+    }
+}
+
+/*takes the next strand of the worker's own run queue or, if it is empty, steals one from the other workers*/
+static STRAND* take_strand(WORKER_POOL* pool, size_t index)
+{
+    STRAND* result = NULL;
+    size_t i;
+    for (i = 0; i < pool->worker_count && result == NULL; i++)
+    {
+        result = pop_strand(&pool->workers[(index + i) % pool->worker_count]);
+    }
+    return result;
+}
+
+static int worker_thread(void* param)
+{
+    WORKER* worker = (WORKER*)param;
+    WORKER_POOL* pool = worker->pool;
+
+    if (Lock(pool->lock) != LOCK_OK)
+    {
+        LogError("unable to lock the worker pool");
+    }
+    else
+    {
+        /*Codes_SRS_WORKER_POOL_13_021: [ A worker shall run until the pool is destroyed. ]*/
+        while (pool->quit == 0)
+        {
+            /*Codes_SRS_WORKER_POOL_13_022: [ A worker shall take the strand at the front of its own run queue or, if that queue is empty, steal the strand at the front of another worker's run queue. ]*/
+            STRAND* strand = take_strand(pool, worker->index);
+            if (strand == NULL)
+            {
+                /*Codes_SRS_WORKER_POOL_13_023: [ A worker that finds no queued strand shall wait on the pool's work condition. ]*/
+                COND_RESULT wait_result;
+                pool->sleeping_workers++;
+                wait_result = Condition_Wait(pool->work_cond, pool->lock, 0);
+                pool->sleeping_workers--;
+                if (wait_result != COND_OK)
+                {
+                    /*Codes_SRS_WORKER_POOL_13_031: [ If waiting on the work condition fails, the worker shall stop; the strands queued on it are run by the other workers. ]*/
+                    LogError("Condition_Wait failed, stopping worker %zu", worker->index);
+                    break;
+                }
+            }
+            else
+            {
+                strand->state = STRAND_RUNNING;
+                strand->worker_index = worker->index;
+
+                /*Codes_SRS_WORKER_POOL_13_024: [ A worker shall call the strand function with the strand context without holding the pool lock. ]*/
+                (void)Unlock(pool->lock);
+                strand->function(strand->context);
+                (void)Lock(pool->lock);
+
+                if (strand->state == STRAND_RUNNING_RESCHEDULED && strand->destroying == 0)
+                {
+                    /*Codes_SRS_WORKER_POOL_13_025: [ If the strand was scheduled while it ran, the worker shall queue it at the back of its own run queue. ]*/
+                    push_strand(worker, strand);
+                }
+                else
+                {
+                    /*Codes_SRS_WORKER_POOL_13_026: [ Otherwise the worker shall mark the strand idle and, if the strand is being destroyed, signal its idle condition. ]*/
+                    strand->state = STRAND_IDLE;
+                    if (strand->destroying != 0)
+                    {
+                        (void)Condition_Post(strand->idle_cond);
+                    }
+                }
+            }
+        }
+        (void)Unlock(pool->lock);
+    }
+
+    return 0;
+}
+
+/*stops and joins the first 'started' workers; the pool lock must not be held*/
+static void stop_workers(WORKER_POOL* pool, size_t started)
+{
+    size_t i;
+
+    (void)Lock(pool->lock);
+    pool->quit = 1;
+    for (i = 0; i < started; i++)
+    {
+        (void)Condition_Post(pool->work_cond);
+    }
+    (void)Unlock(pool->lock);
+
+    for (i = 0; i < started; i++)
+    {
+        int thread_result;
+        if (ThreadAPI_Join(pool->workers[i].thread, &thread_result) != THREADAPI_OK)
+        {
+            LogError("unable to join worker thread %zu", i);
+        }
+    }
+}
+
+WORKER_POOL_HANDLE WorkerPool_Create(size_t worker_count)
+{
+    WORKER_POOL* result;
+
+    /*Codes_SRS_WORKER_POOL_13_001: [ If worker_count is 0, WorkerPool_Create shall create one worker per online processor, and at least one worker. ]*/
+    if (worker_count == 0)
+    {
+        worker_count = get_processor_count();
+    }
+
+    /*Codes_SRS_WORKER_POOL_13_002: [ WorkerPool_Create shall allocate the pool and an array of worker_count workers. ]*/
+    if (worker_count > ((size_t)-1) / sizeof(WORKER))
+    {
+        /*Codes_SRS_WORKER_POOL_13_003: [ If any allocation or resource creation fails, WorkerPool_Create shall free every resource it created and return NULL. ]*/
+        LogError("worker count %zu is too large", worker_count);
+        result = NULL;
+    }
+    else if ((result = (WORKER_POOL*)malloc(sizeof(WORKER_POOL))) == NULL)
+    {
+        LogError("malloc failed for worker pool");
+    }
+    else if ((result->workers = (WORKER*)malloc(worker_count * sizeof(WORKER))) == NULL)
+    {
+        LogError("malloc failed for %zu workers", worker_count);
+        free(result);
+        result = NULL;
+    }
+    /*Codes_SRS_WORKER_POOL_13_004: [ WorkerPool_Create shall create the pool lock and work condition. ]*/
+    else if ((result->lock = Lock_Init()) == NULL)
+    {
+        LogError("Lock_Init failed");
+        free(result->workers);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->work_cond = Condition_Init()) == NULL)
+    {
+        LogError("Condition_Init failed");
+        (void)Lock_Deinit(result->lock);
+        free(result->workers);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        size_t started;
+
+        result->worker_count = worker_count;
+        result->next_worker = 0;
+        result->sleeping_workers = 0;
+        result->quit = 0;
+
+        /*Codes_SRS_WORKER_POOL_13_005: [ WorkerPool_Create shall start one thread per worker, each with an empty run queue. ]*/
+        for (started = 0; started < worker_count; started++)
+        {
+            WORKER* worker = &result->workers[started];
+            worker->pool = result;
+            worker->index = started;
+            worker->head = NULL;
+            worker->tail = NULL;
+            if (ThreadAPI_Create(&worker->thread, worker_thread, worker) != THREADAPI_OK)
+            {
+                LogError("ThreadAPI_Create failed for worker %zu", started);
+                break;
+            }
+        }
+
+        if (started < worker_count)
+        {
+            stop_workers(result, started);
+            Condition_Deinit(result->work_cond);
+            (void)Lock_Deinit(result->lock);
+            free(result->workers);
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+void WorkerPool_Destroy(WORKER_POOL_HANDLE pool)
+{
+    /*Codes_SRS_WORKER_POOL_13_006: [ If pool is NULL, WorkerPool_Destroy shall do nothing. ]*/
+    if (pool == NULL)
+    {
+        LogError("pool handle is NULL");
+    }
+    else
+    {
+        /*Codes_SRS_WORKER_POOL_13_007: [ WorkerPool_Destroy shall signal every worker to stop and join its thread. ]*/
+        stop_workers(pool, pool->worker_count);
+
+        /*Codes_SRS_WORKER_POOL_13_008: [ WorkerPool_Destroy shall free all the resources used by the pool. ]*/
+        Condition_Deinit(pool->work_cond);
+        (void)Lock_Deinit(pool->lock);
+        free(pool->workers);
+        free(pool);
+    }
+}
+
+size_t WorkerPool_GetWorkerCount(WORKER_POOL_HANDLE pool)
+{
+    /*Codes_SRS_WORKER_POOL_13_009: [ WorkerPool_GetWorkerCount shall return the number of workers of the pool, or 0 if pool is NULL. ]*/
+    return (pool == NULL) ? 0 : pool->worker_count;
+}
+
+STRAND_HANDLE WorkerPool_CreateStrand(WORKER_POOL_HANDLE pool, STRAND_FUNCTION function, void* context)
+{
+    STRAND* result;
+
+    /*Codes_SRS_WORKER_POOL_13_010: [ If pool or function is NULL, WorkerPool_CreateStrand shall fail and return NULL. ]*/
+    if (pool == NULL || function == NULL)
+    {
+        LogError("invalid arg pool=%p, function=%p", pool, function);
+        result = NULL;
+    }
+    /*Codes_SRS_WORKER_POOL_13_011: [ WorkerPool_CreateStrand shall allocate a new strand and create its idle condition. ]*/
+    else if ((result = (STRAND*)malloc(sizeof(STRAND))) == NULL)
+    {
+        /*Codes_SRS_WORKER_POOL_13_012: [ If any allocation or resource creation fails, WorkerPool_CreateStrand shall free every resource it created and return NULL. ]*/
+        LogError("malloc failed for strand");
+    }
+    else if ((result->idle_cond = Condition_Init()) == NULL)
+    {
+        LogError("Condition_Init failed");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_WORKER_POOL_13_013: [ WorkerPool_CreateStrand shall return an idle strand that runs function with context. ]*/
+        result->pool = pool;
+        result->function = function;
+        result->context = context;
+        result->state = STRAND_IDLE;
+        result->worker_index = 0;
+        result->next = NULL;
+        result->destroying = 0;
+    }
+
+    return result;
+}
+
+int WorkerPool_Schedule(STRAND_HANDLE strand)
+{
+    int result;
+
+    /*Codes_SRS_WORKER_POOL_13_014: [ If strand is NULL, WorkerPool_Schedule shall fail and return a non-zero value. ]*/
+    if (strand == NULL)
+    {
+        LogError("strand handle is NULL");
+        result = __LINE__;
+    }
+    else if (Lock(strand->pool->lock) != LOCK_OK)
+    {
+        /*Codes_SRS_WORKER_POOL_13_015: [ If the pool lock cannot be acquired, WorkerPool_Schedule shall fail and return a non-zero value. ]*/
+        LogError("unable to lock the worker pool");
+        result = __LINE__;
+    }
+    else
+    {
+        WORKER_POOL* pool = strand->pool;
+        if (strand->state == STRAND_IDLE)
+        {
+            /*Codes_SRS_WORKER_POOL_13_016: [ If the strand is idle, WorkerPool_Schedule shall queue it at the back of the next worker's run queue in round-robin order. ]*/
+            push_strand(&pool->workers[pool->next_worker], strand);
+            pool->next_worker = (pool->next_worker + 1) % pool->worker_count;
+
+            /*Codes_SRS_WORKER_POOL_13_017: [ WorkerPool_Schedule shall signal the work condition if any worker is waiting for work. ]*/
+            if (pool->sleeping_workers > 0)
+            {
+                (void)Condition_Post(pool->work_cond);
+            }
+        }
+        else if (strand->state == STRAND_RUNNING)
+        {
+            /*Codes_SRS_WORKER_POOL_13_018: [ If the strand is running, WorkerPool_Schedule shall mark it to run once more after the strand function returns. ]*/
+            strand->state = STRAND_RUNNING_RESCHEDULED;
+        }
+        else
+        {
+            /*Codes_SRS_WORKER_POOL_13_019: [ If the strand is already queued or rescheduled, WorkerPool_Schedule shall leave it unchanged. ]*/
+        }
+
+        (void)Unlock(pool->lock);
+        /*Codes_SRS_WORKER_POOL_13_020: [ WorkerPool_Schedule shall return 0 upon success. ]*/
+        result = 0;
+    }
+
+    return result;
+}
+
+void WorkerPool_DestroyStrand(STRAND_HANDLE strand)
+{
+    /*Codes_SRS_WORKER_POOL_13_027: [ If strand is NULL, WorkerPool_DestroyStrand shall do nothing. ]*/
+    if (strand == NULL)
+    {
+        LogError("strand handle is NULL");
+    }
+    else
+    {
+        WORKER_POOL* pool = strand->pool;
+
+        (void)Lock(pool->lock);
+        strand->destroying = 1;
+        if (strand->state == STRAND_QUEUED)
+        {
+            /*Codes_SRS_WORKER_POOL_13_028: [ If the strand is queued, WorkerPool_DestroyStrand shall remove it from its run queue. ]*/
+            remove_strand(&pool->workers[strand->worker_index], strand);
+            strand->state = STRAND_IDLE;
+        }
+        else
+        {
+            /*Codes_SRS_WORKER_POOL_13_029: [ If the strand is running, WorkerPool_DestroyStrand shall wait on the strand's idle condition until the strand function returns. ]*/
+            while (strand->state != STRAND_IDLE)
+            {
+                (void)Condition_Wait(strand->idle_cond, pool->lock, 0);
+            }
+        }
+        (void)Unlock(pool->lock);
+
+        /*Codes_SRS_WORKER_POOL_13_030: [ WorkerPool_DestroyStrand shall free all the resources used by the strand. ]*/
+        Condition_Deinit(strand->idle_cond);
+        free(strand);
+    }
+}
@@ -8,6 +8,7 @@
 #include "azure_c_shared_utility/gballoc.h"
 
 #include <stddef.h>
+#include <string.h>
 #include <inttypes.h>
 
 #include "message.h"
@@ -18,58 +19,239 @@
 
 #include "azure_c_shared_utility/refcount.h"
 
+#include "internal/atomic_ops.h"
+
 #define FIRST_MESSAGE_BYTE 0xA1  /*0xA1 comes from (A)zure (I)oT*/
 #define SECOND_MESSAGE_BYTE 0x60 /*0x60 comes from (G)ateway*/
 
 #define MIN_MESSAGE_BUFFER_LENGTH 14 /*14 is the minimum message length that is still valid*/
 
+#define SECOND_MESSAGE_BYTE_V2 0x61 /*version 2 of the serialization, see message_requirements.md*/
+#define MIN_MESSAGE_V2_BUFFER_LENGTH 6 /*header, total size, number of properties, size of the properties and content size*/
+#define MAX_VARINT_LENGTH 5 /*7 bits per byte, so an int32_t never takes more than 5 bytes*/
+
 typedef struct MESSAGE_HANDLE_DATA_TAG
 {
+    /*the content of the message, its buffer follows the message in the same allocation unless content_handle is not NULL*/
+    CONSTBUFFER content;
+    /*the CONSTBUFFER_HANDLE owning the content of a message created by Message_CreateFromBuffer, NULL otherwise*/
+    CONSTBUFFER_HANDLE content_handle;
+    /*the values of the well-known properties, pointing into values or edits; NULL when the message does not have them*/
+    const char* well_known_values[MESSAGE_PROPERTY_ID_COUNT];
+    /*the message whose properties and content a message created by Message_CloneWithPropertyEdits shares, NULL otherwise*/
+    struct MESSAGE_HANDLE_DATA_TAG* base;
+    /*the properties such a message adds, replaces or (value is NULL) removes from the properties of base; they follow the message in the same allocation*/
+    MESSAGE_PROPERTY_EDIT* edits;
+    /*the lengths of the keys and values of the edits, without their '\0', laid out like lengths*/
+    size_t* edit_lengths;
+    size_t edit_count;
+    /*the keys and values of the properties. The arrays follow the message in the same allocation, and so do the strings unless the message
+    was created by Message_CreateFromByteArrayNoCopy, whose strings are in its byte array, or shares the properties of another message*/
+    const char* const* keys;
+    const char* const* values;
+    /*the lengths of the keys and values, without their '\0': lengths[2 * i] is the length of keys[i] and lengths[2 * i + 1] the length
+    of values[i]. They are kept with the arrays so that serializing a message does not measure its strings again*/
+    const size_t* lengths;
+    size_t property_count;
+    /*the message whose properties a message created by MessageBatch_AddContent shares, NULL otherwise*/
+    struct MESSAGE_HANDLE_DATA_TAG* properties_owner;
+    /*the CONSTMAP built by the first call to Message_GetProperties, NULL until then; it is set atomically since
+    the modules a message is delivered to may call Message_GetProperties on different threads*/
     CONSTMAP_HANDLE properties;
-    CONSTBUFFER_HANDLE content;
+    /*releases the byte array of such a message, NULL for other messages*/
+    MESSAGE_BYTE_ARRAY_RELEASE release;
+    void* release_context;
 }MESSAGE_HANDLE_DATA;
 
+/*the keys of the well-known properties, indexed by MESSAGE_PROPERTY_ID. They are the names in modules/common/messageproperties.h*/
+static const char* const WELL_KNOWN_PROPERTY_KEYS[MESSAGE_PROPERTY_ID_COUNT] =
+{
+    "source",
+    "macAddress",
+    "deviceName",
+    "deviceKey",
+    "bleControllerIndex",
+    "timestamp",
+    "characteristicUUID"
+};
+
 DEFINE_REFCOUNT_TYPE(MESSAGE_HANDLE_DATA);
 
+/*the bytes allocated after the ref count of a message by Message_Allocate*/
+#define MESSAGE_INLINE_BYTES(message) ((unsigned char*)(message) + sizeof(REFCOUNT_TYPE(MESSAGE_HANDLE_DATA)))
+
+/*same as REFCOUNT_TYPE_CREATE, with room for extraSize bytes after the ref count*/
+static MESSAGE_HANDLE_DATA* Message_Allocate(size_t extraSize)
+{
+    MESSAGE_HANDLE_DATA* result;
+    if (extraSize > SIZE_MAX - sizeof(REFCOUNT_TYPE(MESSAGE_HANDLE_DATA)))
+    {
+        LogError("message content is too large");
+        result = NULL;
+    }
+    else
+    {
+        REFCOUNT_TYPE(MESSAGE_HANDLE_DATA)* refCounted = (REFCOUNT_TYPE(MESSAGE_HANDLE_DATA)*)malloc(sizeof(REFCOUNT_TYPE(MESSAGE_HANDLE_DATA)) + extraSize);
+        if (refCounted == NULL)
+        {
+            LogError("malloc returned NULL");
+            result = NULL;
+        }
+        else
+        {
+            refCounted->count = 1;
+            result = &refCounted->counted;
+            result->content_handle = NULL;
+            result->base = NULL;
+            result->edits = NULL;
+            result->edit_lengths = NULL;
+            result->edit_count = 0;
+            result->keys = NULL;
+            result->values = NULL;
+            result->lengths = NULL;
+            result->property_count = 0;
+            result->properties_owner = NULL;
+            result->properties = NULL;
+            result->release = NULL;
+            result->release_context = NULL;
+        }
+    }
+    return result;
+}
+
+/*looks up the well-known properties of the message among its count properties*/
+static void Message_FindWellKnownValues(MESSAGE_HANDLE_DATA* message, const char* const* keys, const char* const* values, size_t count)
+{
+    size_t i;
+    int id;
+    for (id = 0; id < MESSAGE_PROPERTY_ID_COUNT; id++)
+    {
+        message->well_known_values[id] = NULL;
+    }
+    for (i = 0; i < count; i++)
+    {
+        for (id = 0; id < MESSAGE_PROPERTY_ID_COUNT; id++)
+        {
+            if (strcmp(keys[i], WELL_KNOWN_PROPERTY_KEYS[id]) == 0)
+            {
+                message->well_known_values[id] = values[i];
+                break;
+            }
+        }
+    }
+}
+
+/*allocates a message holding a copy of the properties of sourceProperties, with room for contentSize bytes of content that *content
+points to. The arrays of the keys, values and lengths follow the message in the same allocation, then the content, then the strings*/
+static MESSAGE_HANDLE_DATA* Message_AllocateWithProperties(MAP_HANDLE sourceProperties, size_t contentSize, unsigned char** content)
+{
+    MESSAGE_HANDLE_DATA* result;
+    const char* const* keys;
+    const char* const* values;
+    size_t count;
+    /*Codes_SRS_MESSAGE_13_003: [Message_Create, Message_CreateFromBuffer and Message_CreateFromByteArray shall get the properties of sourceProperties by calling Map_GetInternals.]*/
+    if (Map_GetInternals(sourceProperties, &keys, &values, &count) != MAP_OK)
+    {
+        /*Codes_SRS_MESSAGE_13_004: [If Map_GetInternals fails, then creating the message shall fail.]*/
+        LogError("Map_GetInternals failed");
+        result = NULL;
+    }
+    else if (count > SIZE_MAX / (2 * (sizeof(const char*) + sizeof(size_t))))
+    {
+        LogError("too many properties");
+        result = NULL;
+    }
+    else
+    {
+        size_t arraysSize = count * 2 * (sizeof(const char*) + sizeof(size_t));
+        size_t stringsSize = 0;
+        size_t i;
+        for (i = 0; i < count; i++)
+        {
+            stringsSize += strlen(keys[i]) + 1 + strlen(values[i]) + 1;
+        }
+
+        if (contentSize > SIZE_MAX - arraysSize - stringsSize)
+        {
+            LogError("message content is too large");
+            result = NULL;
+        }
+        else if ((result = Message_Allocate(arraysSize + contentSize + stringsSize)) == NULL)
+        {
+            /*return as is*/
+        }
+        else
+        {
+            const char** copiedKeys = (const char**)MESSAGE_INLINE_BYTES(result);
+            const char** copiedValues = copiedKeys + count;
+            size_t* lengths = (size_t*)(copiedValues + count);
+            char* strings;
+            *content = (unsigned char*)(lengths + 2 * count);
+            strings = (char*)(*content + contentSize);
+            for (i = 0; i < count; i++)
+            {
+                lengths[2 * i] = strlen(keys[i]);
+                lengths[2 * i + 1] = strlen(values[i]);
+                memcpy(strings, keys[i], lengths[2 * i] + 1);
+                copiedKeys[i] = strings;
+                strings += lengths[2 * i] + 1;
+                memcpy(strings, values[i], lengths[2 * i + 1] + 1);
+                copiedValues[i] = strings;
+                strings += lengths[2 * i + 1] + 1;
+            }
+            result->keys = copiedKeys;
+            result->values = copiedValues;
+            result->lengths = lengths;
+            result->property_count = count;
+            Message_FindWellKnownValues(result, copiedKeys, copiedValues, count);
+        }
+    }
+    return result;
+}
+
+/*returns the edit of the message for key, NULL if key is not edited*/
+static const MESSAGE_PROPERTY_EDIT* Message_FindEdit(const MESSAGE_PROPERTY_EDIT* edits, size_t editCount, const char* key)
+{
+    const MESSAGE_PROPERTY_EDIT* result = NULL;
+    size_t i;
+    for (i = 0; i < editCount; i++)
+    {
+        if (strcmp(edits[i].key, key) == 0)
+        {
+            result = &edits[i];
+            break;
+        }
+    }
+    return result;
+}
+
 static MESSAGE_HANDLE_DATA* Message_CreateImpl(const MESSAGE_CONFIG * cfg)
 {
     MESSAGE_HANDLE_DATA* result;
+    unsigned char* content;
     /*Codes_SRS_MESSAGE_02_006: [Otherwise, Message_Create shall return a non-NULL handle and shall set the internal ref count to "1".]*/
-    result = REFCOUNT_TYPE_CREATE(MESSAGE_HANDLE_DATA);
+    /*Codes_SRS_MESSAGE_02_019: [Message_Create shall copy the properties of sourceProperties into the same allocation as the message.]*/
+    result = Message_AllocateWithProperties(cfg->sourceProperties, cfg->size, &content);
     if (result == NULL)
     {
-        LogError("malloc returned NULL");
+        /*Codes_SRS_MESSAGE_02_005: [If Message_Create encounters an error while building the internal structures of the message, then it shall return NULL.] */
         /*return as is*/
     }
     else
     {
         /*Codes_SRS_MESSAGE_02_004: [Mesages shall be allowed to be created from zero-size content.]*/
         /*Codes_SRS_MESSAGE_02_015: [The MESSAGE_CONTENT's field size shall have the same value as the cfg's field size.]*/
-        /*Codes_SRS_MESSAGE_17_003: [Message_Create shall copy the source to a readonly CONSTBUFFER.]*/
-        result->content = CONSTBUFFER_Create(cfg->source, cfg->size);
-        if (result->content == NULL)
+        /*Codes_SRS_MESSAGE_17_003: [Message_Create shall copy the source into the same allocation as the message.]*/
+        if (cfg->size == 0)
         {
-            LogError("CONSBUFFER_Create failed");
-            free(result);
-            result = NULL;
+            result->content.buffer = NULL;
         }
         else
         {
-            /*Codes_SRS_MESSAGE_02_019: [Message_Create shall clone the sourceProperties to a readonly CONSTMAP.]*/
-            result->properties = ConstMap_Create(cfg->sourceProperties);
-            if (result->properties == NULL)
-            {
-                /*Codes_SRS_MESSAGE_02_005: [If Message_Create encounters an error while building the internal structures of the message, then it shall return NULL.] */
-                LogError("ConstMap_Create failed");
-                CONSTBUFFER_Destroy(result->content);
-                free(result);
-                result = NULL;
-            }
-            else
-            {
-                /*all is fine, return as is.*/
-            }
+            memcpy(content, cfg->source, cfg->size);
+            result->content.buffer = content;
         }
+        result->content.size = cfg->size;
     }
     return result;
 }
@@ -120,19 +302,20 @@ MESSAGE_HANDLE Message_CreateFromBuffer(const MESSAGE_BUFFER_CONFIG* cfg)
     }
     else
     {
+        unsigned char* content;
         /*Codes_SRS_MESSAGE_17_011: [If Message_CreateFromBuffer encounters an error while building the internal structures of the message, then it shall return NULL.]*/
         /*Codes_SRS_MESSAGE_17_014: [On success, Message_CreateFromBuffer shall return a non-NULL handle and set the internal ref count to "1".]*/
-        result = REFCOUNT_TYPE_CREATE(MESSAGE_HANDLE_DATA);
+        /*Codes_SRS_MESSAGE_17_012: [Message_CreateFromBuffer shall copy the properties of sourceProperties into the same allocation as the message.]*/
+        result = Message_AllocateWithProperties(cfg->sourceProperties, 0, &content);
         if (result == NULL)
         {
-            LogError("malloc returned NULL");
             /*return as is*/
         }
         else
         {
             /*Codes_SRS_MESSAGE_17_013: [Message_CreateFromBuffer shall clone the CONSTBUFFER sourceBuffer.]*/
-            result->content = CONSTBUFFER_Clone(cfg->sourceContent);
-            if (result->content == NULL)
+            result->content_handle = CONSTBUFFER_Clone(cfg->sourceContent);
+            if (result->content_handle == NULL)
             {
                 LogError("CONSBUFFER Clone failed");
                 free(result);
@@ -140,19 +323,7 @@ MESSAGE_HANDLE Message_CreateFromBuffer(const MESSAGE_BUFFER_CONFIG* cfg)
             }
             else
             {
-                /*Codes_SRS_MESSAGE_17_012: [Message_CreateFromBuffer shall copy the sourceProperties to a readonly CONSTMAP.]*/
-                result->properties = ConstMap_Create(cfg->sourceProperties);
-                if (result->properties == NULL)
-                {
-                    LogError("ConstMap_Create failed");
-                    CONSTBUFFER_Destroy(result->content);
-                    free(result);
-                    result = NULL;
-                }
-                else
-                {
-                    /*all is fine, return as is.*/
-                }
+                result->content = *CONSTBUFFER_GetContent(result->content_handle);
             }
         }
     }
@@ -169,167 +340,802 @@ MESSAGE_HANDLE Message_Clone(MESSAGE_HANDLE message)
     else
     {
         /*Codes_SRS_MESSAGE_02_008: [Otherwise, Message_Clone shall increment the internal ref count.] */
+        /*Codes_SRS_MESSAGE_13_001: [Message_Clone shall not copy the properties and shall not clone the CONSTBUFFER handle held by the message.]*/
         INC_REF(MESSAGE_HANDLE_DATA, message);
-        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
-        /*Codes_SRS_MESSAGE_17_001: [Message_Clone shall clone the CONSTMAP handle.]*/
-        (void)ConstMap_Clone(messageData->properties);
-        /*Codes_SRS_MESSAGE_17_004: [Message_Clone shall clone the CONSTBUFFER handle]*/
-        (void)CONSTBUFFER_Clone(messageData->content);
     }
     /*Codes_SRS_MESSAGE_02_010: [Message_Clone shall return messageHandle.]*/
     return message;
 }
 
-CONSTMAP_HANDLE Message_GetProperties(MESSAGE_HANDLE message)
+/*copies edit, whose key and value are keyLength and valueLength characters long, to the edits of message, its strings go to *strings*/
+static void Message_AddEdit(MESSAGE_HANDLE_DATA* message, char** strings, const MESSAGE_PROPERTY_EDIT* edit, size_t keyLength, size_t valueLength)
 {
-    CONSTMAP_HANDLE result;
-    /*Codes_SRS_MESSAGE_02_011: [If message is NULL then Message_GetProperties shall return NULL.] */
-    if (message == NULL)
+    MESSAGE_PROPERTY_EDIT* copy = &message->edits[message->edit_count];
+    memcpy(*strings, edit->key, keyLength + 1);
+    copy->key = *strings;
+    *strings += keyLength + 1;
+    if (edit->value == NULL)
     {
-        LogError("invalid arg: message is NULL");
-        result = NULL;
+        copy->value = NULL;
+        valueLength = 0;
     }
     else
     {
-        /*Codes_SRS_MESSAGE_02_012: [Otherwise, Message_GetProperties shall shall clone and return the CONSTMAP handle representing the properties of the message.]*/
-        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
-        result = ConstMap_Clone(messageData->properties);
+        memcpy(*strings, edit->value, valueLength + 1);
+        copy->value = *strings;
+        *strings += valueLength + 1;
     }
-    return result;
+    message->edit_lengths[2 * message->edit_count] = keyLength;
+    message->edit_lengths[2 * message->edit_count + 1] = valueLength;
+    message->edit_count++;
 }
 
-const CONSTBUFFER * Message_GetContent(MESSAGE_HANDLE message)
+MESSAGE_HANDLE Message_CloneWithPropertyEdits(MESSAGE_HANDLE message, const MESSAGE_PROPERTY_EDIT* edits, size_t editCount)
 {
-    const CONSTBUFFER* result;
-    /*Codes_SRS_MESSAGE_02_013: [If message is NULL then Message_GetContent shall return NULL.] */
-    if (message == NULL)
+    MESSAGE_HANDLE_DATA* result;
+    size_t i;
+    /*Codes_SRS_MESSAGE_13_008: [If message is NULL, or edits is NULL and editCount is not zero, then Message_CloneWithPropertyEdits shall fail and return NULL.]*/
+    if (
+        (message == NULL) ||
+        ((edits == NULL) && (editCount != 0))
+        )
     {
-        LogError("invalid argument, message is NULL");
+        LogError("invalid arg: message=%p, edits=%p, editCount=%zu", message, edits, editCount);
         result = NULL;
     }
     else
     {
-        /*Codes_SRS_MESSAGE_02_014: [Otherwise, Message_GetContent shall return a non-NULL const pointer to a structure of type MESSAGE_CONTENT.]*/
-        /*Codes_SRS_MESSAGE_02_016: [The CONSTBUFFER's field buffer shall compare equal byte-by-byte to the cfg's field source.]*/
-        result = CONSTBUFFER_GetContent(((MESSAGE_HANDLE_DATA*)message)->content);
+        for (i = 0; i < editCount; i++)
+        {
+            if (edits[i].key == NULL)
+            {
+                break;
+            }
+        }
+
+        if (i < editCount)
+        {
+            /*Codes_SRS_MESSAGE_13_009: [If the key of an edit is NULL then Message_CloneWithPropertyEdits shall fail and return NULL.]*/
+            LogError("invalid arg: the key of edit %zu is NULL", i);
+            result = NULL;
+        }
+        else
+        {
+            MESSAGE_HANDLE_DATA* parent = (MESSAGE_HANDLE_DATA*)message;
+            /*Codes_SRS_MESSAGE_13_010: [If message was itself created by Message_CloneWithPropertyEdits, the new message shall share the properties and content of the message message was created from, and apply the edits of message that edits does not override.]*/
+            MESSAGE_HANDLE_DATA* base = (parent->base != NULL) ? parent->base : parent;
+            size_t mergedCount = 0;
+            size_t stringsSize = 0;
+
+            /*the last edit of a key wins*/
+            for (i = editCount; i > 0; i--)
+            {
+                if (Message_FindEdit(edits + i, editCount - i, edits[i - 1].key) == NULL)
+                {
+                    mergedCount++;
+                    stringsSize += strlen(edits[i - 1].key) + 1 + ((edits[i - 1].value == NULL) ? 0 : strlen(edits[i - 1].value) + 1);
+                }
+            }
+            for (i = 0; i < parent->edit_count; i++)
+            {
+                if (Message_FindEdit(edits, editCount, parent->edits[i].key) == NULL)
+                {
+                    mergedCount++;
+                    stringsSize += parent->edit_lengths[2 * i] + 1 + ((parent->edits[i].value == NULL) ? 0 : parent->edit_lengths[2 * i + 1] + 1);
+                }
+            }
+
+            /*Codes_SRS_MESSAGE_13_011: [Message_CloneWithPropertyEdits shall copy the edits into the same allocation as the new message.]*/
+            result = Message_Allocate(mergedCount * (sizeof(MESSAGE_PROPERTY_EDIT) + 2 * sizeof(size_t)) + stringsSize);
+            if (result == NULL)
+            {
+                /*Codes_SRS_MESSAGE_13_012: [If Message_CloneWithPropertyEdits fails to allocate the new message, it shall return NULL.]*/
+                /*return as is*/
+            }
+            else
+            {
+                char* strings;
+                int id;
+
+                result->edits = (MESSAGE_PROPERTY_EDIT*)MESSAGE_INLINE_BYTES(result);
+                result->edit_lengths = (size_t*)(result->edits + mergedCount);
+                strings = (char*)(result->edit_lengths + 2 * mergedCount);
+                for (i = editCount; i > 0; i--)
+                {
+                    if (Message_FindEdit(edits + i, editCount - i, edits[i - 1].key) == NULL)
+                    {
+                        Message_AddEdit(result, &strings, &edits[i - 1], strlen(edits[i - 1].key), (edits[i - 1].value == NULL) ? 0 : strlen(edits[i - 1].value));
+                    }
+                }
+                for (i = 0; i < parent->edit_count; i++)
+                {
+                    if (Message_FindEdit(edits, editCount, parent->edits[i].key) == NULL)
+                    {
+                        Message_AddEdit(result, &strings, &parent->edits[i], parent->edit_lengths[2 * i], parent->edit_lengths[2 * i + 1]);
+                    }
+                }
+
+                /*Codes_SRS_MESSAGE_13_013: [Message_GetPropertyById shall return the values of the well-known properties of the new message as edited.]*/
+                for (id = 0; id < MESSAGE_PROPERTY_ID_COUNT; id++)
+                {
+                    const MESSAGE_PROPERTY_EDIT* edit = Message_FindEdit(result->edits, result->edit_count, WELL_KNOWN_PROPERTY_KEYS[id]);
+                    result->well_known_values[id] = (edit == NULL) ? base->well_known_values[id] : edit->value;
+                }
+
+                /*Codes_SRS_MESSAGE_13_014: [The new message shall share the properties and the content of message, and hold a reference to it until the new message is destroyed.]*/
+                INC_REF(MESSAGE_HANDLE_DATA, base);
+                result->base = base;
+                result->keys = base->keys;
+                result->values = base->values;
+                result->lengths = base->lengths;
+                result->property_count = base->property_count;
+                result->content = base->content;
+            }
+        }
     }
-    return result;
+    /*Codes_SRS_MESSAGE_13_015: [On success, Message_CloneWithPropertyEdits shall return a non-NULL handle with its internal ref count set to "1".]*/
+    return (MESSAGE_HANDLE)result;
 }
 
-CONSTBUFFER_HANDLE Message_GetContentHandle(MESSAGE_HANDLE message) 
+/*builds a CONSTMAP with the properties of message, as edited by message*/
+static CONSTMAP_HANDLE Message_MergeProperties(const MESSAGE_HANDLE_DATA* message)
 {
-    CONSTBUFFER_HANDLE result;
-    if (message == NULL)
+    CONSTMAP_HANDLE result;
+    MAP_HANDLE merged = Map_Create(NULL);
+    if (merged == NULL)
     {
-        /*Codes_SRS_MESSAGE_17_006: [If message is NULL then Message_GetContentHandle shall return NULL.] */
-        LogError("invalid argument, message is NULL");
+        /*Codes_SRS_MESSAGE_13_067: [If building the CONSTMAP fails, Message_GetProperties shall return NULL.]*/
+        LogError("Map_Create failed");
         result = NULL;
     }
     else
     {
-        /*Codes_SRS_MESSAGE_17_007: [Otherwise, Message_GetContentHandle shall shall clone and return the CONSTBUFFER_HANDLE representing the message content.]*/
-        result = CONSTBUFFER_Clone(((MESSAGE_HANDLE_DATA*)message)->content);
+        size_t i;
+        int failed = 0;
+        for (i = 0; (i < message->property_count) && (failed == 0); i++)
+        {
+            if (
+                (Message_FindEdit(message->edits, message->edit_count, message->keys[i]) == NULL) &&
+                (Map_Add(merged, message->keys[i], message->values[i]) != MAP_OK)
+                )
+            {
+                failed = 1;
+            }
+        }
+        for (i = 0; (i < message->edit_count) && (failed == 0); i++)
+        {
+            if (
+                (message->edits[i].value != NULL) &&
+                (Map_Add(merged, message->edits[i].key, message->edits[i].value) != MAP_OK)
+                )
+            {
+                failed = 1;
+            }
+        }
+
+        if (failed != 0)
+        {
+            /*Codes_SRS_MESSAGE_13_067: [If building the CONSTMAP fails, Message_GetProperties shall return NULL.]*/
+            LogError("Map_Add failed");
+            result = NULL;
+        }
+        else
+        {
+            result = ConstMap_Create(merged);
+            if (result == NULL)
+            {
+                /*Codes_SRS_MESSAGE_13_067: [If building the CONSTMAP fails, Message_GetProperties shall return NULL.]*/
+                LogError("ConstMap_Create failed");
+            }
+        }
+        Map_Destroy(merged);
     }
     return result;
 }
 
-void Message_Destroy(MESSAGE_HANDLE message)
+CONSTMAP_HANDLE Message_GetProperties(MESSAGE_HANDLE message)
 {
-    /*Codes_SRS_MESSAGE_02_017: [If message is NULL then Message_Destroy shall do nothing.] */
+    CONSTMAP_HANDLE result;
+    /*Codes_SRS_MESSAGE_02_011: [If message is NULL then Message_GetProperties shall return NULL.] */
     if (message == NULL)
     {
         LogError("invalid arg: message is NULL");
+        result = NULL;
     }
     else
     {
         MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
-        /*Codes_SRS_MESSAGE_17_002: [Message_Destroy shall destroy the CONSTMAP properties.]*/
-        ConstMap_Destroy(messageData->properties);
-        /*Codes_SRS_MESSAGE_17_005: [Message_Destroy shall destroy the CONSTBUFFER.]*/
-        CONSTBUFFER_Destroy(messageData->content);
-        /*Codes_SRS_MESSAGE_02_020: [Otherwise, Message_Destroy shall decrement the internal ref count of the message.]*/
-        if (DEC_REF(MESSAGE_HANDLE_DATA, message) == DEC_RETURN_ZERO)
+        CONSTMAP_HANDLE properties;
+        if (messageData->properties_owner != NULL)
         {
-            /*Codes_SRS_MESSAGE_02_021: [If the ref count is zero then the allocated resources are freed.]*/
-            free(message);
+            /*Codes_SRS_MESSAGE_13_069: [If the message was created by MessageBatch_AddContent, Message_GetProperties shall use the CONSTMAP of the message holding the shared properties of the batch.]*/
+            messageData = messageData->properties_owner;
         }
-    }
-}
 
-/*this function parses the buffer pointed to by source, having size sourceSize, starting at index position for a int32_t value*/
-/*if the parsing succeeds then *parsed is updated to reflect how many characters have been consumed*/
-/*and *value is updated to the parsed value and the function return 0*/
-/*if parsing fails, the function returns different than 0*/
-static int parse_int32_t(const unsigned char* source, int32_t sourceSize, int32_t position, int32_t *parsed, int32_t* value)
-{
-    int result;
-    if (position + 4 > sourceSize)
-    {
-        /*Codes_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
-        LogError("unable to parse a int32_t because it would go past the end of the source");
-        result = __LINE__;
-    }
-    else
-    {
-        *parsed = 4;
-        *value = 
-            (source[position + 0] << 24) |
-            (source[position + 1] << 16) |
-            (source[position + 2] <<  8) |
-            (source[position + 3]);
-        result = 0;
+        properties = (CONSTMAP_HANDLE)ATOMIC_LOAD_POINTER(&messageData->properties);
+        if (properties == NULL)
+        {
+            /*Codes_SRS_MESSAGE_02_012: [Otherwise, the first call to Message_GetProperties shall build a CONSTMAP holding copies of the properties of the message and keep it in the message.]*/
+            /*Codes_SRS_MESSAGE_13_016: [If the message was created by Message_CloneWithPropertyEdits, the CONSTMAP shall hold the properties of the message it was created from, as edited.]*/
+            /*Codes_SRS_MESSAGE_13_025: [If the message was created by Message_CreateFromByteArrayNoCopy, the CONSTMAP shall hold copies of its properties.]*/
+            CONSTMAP_HANDLE built = Message_MergeProperties(messageData);
+            if (built == NULL)
+            {
+                /*return as is*/
+            }
+            else if (ATOMIC_COMPARE_EXCHANGE_POINTER(&messageData->properties, NULL, built))
+            {
+                properties = built;
+            }
+            else
+            {
+                /*Codes_SRS_MESSAGE_13_070: [If another thread kept its CONSTMAP in the message first, Message_GetProperties shall destroy the one it built and use the one kept in the message.]*/
+                ConstMap_Destroy(built);
+                properties = (CONSTMAP_HANDLE)ATOMIC_LOAD_POINTER(&messageData->properties);
+            }
+        }
+
+        if (properties == NULL)
+        {
+            /*Codes_SRS_MESSAGE_13_067: [If building the CONSTMAP fails, Message_GetProperties shall return NULL.]*/
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_13_068: [Message_GetProperties shall return a clone of the CONSTMAP kept in the message, obtained by calling ConstMap_Clone.]*/
+            result = ConstMap_Clone(properties);
+            if (result == NULL)
+            {
+                LogError("ConstMap_Clone failed");
+            }
+        }
     }
     return result;
 }
 
-static int parse_null_terminated_const_char(const unsigned char* source, int32_t sourceSize, int32_t position, int32_t *parsed, const char** value)
+const char* Message_GetPropertyById(MESSAGE_HANDLE message, MESSAGE_PROPERTY_ID id)
 {
-    int result;
-    const unsigned char* whereIsnull = (unsigned char*)memchr(source + position, '\0', sourceSize - position);
-    
-    if (whereIsnull == NULL)
+    const char* result;
+    /*Codes_SRS_MESSAGE_13_005: [If message is NULL then Message_GetPropertyById shall return NULL.]*/
+    if (message == NULL)
     {
-        /*Codes_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
-        LogError("was not able to find the end of the string");
-        result = __LINE__;
+        LogError("invalid arg: message is NULL");
+        result = NULL;
+    }
+    /*Codes_SRS_MESSAGE_13_006: [If id is not a well-known property then Message_GetPropertyById shall return NULL.]*/
+    else if ((int)id < 0 || id >= MESSAGE_PROPERTY_ID_COUNT)
+    {
+        LogError("invalid arg: id=%d is not a well-known property", (int)id);
+        result = NULL;
     }
     else
     {
-        *parsed = whereIsnull - ( source + position - 1);
-        *value = (const char*)source + position;
-        result = 0;
+        /*Codes_SRS_MESSAGE_13_007: [Otherwise, Message_GetPropertyById shall return the value of the property, or NULL if the message does not have it, without copying the properties of the message.]*/
+        result = ((MESSAGE_HANDLE_DATA*)message)->well_known_values[id];
     }
     return result;
 }
 
-/*creates a MESSAGE_HANDLE from a serialized byte array*/
-MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t size)
+const char* Message_GetProperty(MESSAGE_HANDLE message, const char* key)
 {
-    MESSAGE_HANDLE_DATA* result;
-    /*Codes_SRS_MESSAGE_02_022: [ If source is NULL then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    /*Codes_SRS_MESSAGE_02_023: [ If source is not NULL and and size parameter is smaller than 14 then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    if (
-        (source == NULL) ||
-        (size < MIN_MESSAGE_BUFFER_LENGTH)
-        )
+    const char* result;
+    /*Codes_SRS_MESSAGE_13_063: [If message or key is NULL then Message_GetProperty shall return NULL.]*/
+    if (message == NULL || key == NULL)
     {
-        LogError("invalid parameter source=[%p] size=%" PRId32, source, size);
+        LogError("invalid arg: message=%p, key=%p", message, key);
         result = NULL;
     }
     else
     {
-        /*Codes_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 then Message_CreateFromByteArray shall fail and return NULL. ]*/
-        if (
-            (source[0] != FIRST_MESSAGE_BYTE) ||
-            (source[1] != SECOND_MESSAGE_BYTE)
-            )
+        const MESSAGE_HANDLE_DATA* messageData = (const MESSAGE_HANDLE_DATA*)message;
+        /*Codes_SRS_MESSAGE_13_064: [If the message was created by Message_CloneWithPropertyEdits and key is edited, Message_GetProperty shall return the value of the edit.]*/
+        const MESSAGE_PROPERTY_EDIT* edit = Message_FindEdit(messageData->edits, messageData->edit_count, key);
+        if (edit != NULL)
         {
-            LogError("byte array is not a gateway message serialization");
-            result = NULL;
+            result = edit->value;
         }
         else
         {
-            int32_t currentPosition = 2; /*current position is always the first character that "we are about to look at"*/
+            size_t i;
+            /*Codes_SRS_MESSAGE_13_065: [Otherwise Message_GetProperty shall search the properties of the message for key, without copying them, and return its value, or NULL if the message does not have it.]*/
+            result = NULL;
+            for (i = 0; i < messageData->property_count; i++)
+            {
+                if (strcmp(messageData->keys[i], key) == 0)
+                {
+                    result = messageData->values[i];
+                    break;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+const CONSTBUFFER * Message_GetContent(MESSAGE_HANDLE message)
+{
+    const CONSTBUFFER* result;
+    /*Codes_SRS_MESSAGE_02_013: [If message is NULL then Message_GetContent shall return NULL.] */
+    if (message == NULL)
+    {
+        LogError("invalid argument, message is NULL");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_02_014: [Otherwise, Message_GetContent shall return a non-NULL const pointer to a structure of type MESSAGE_CONTENT.]*/
+        /*Codes_SRS_MESSAGE_02_016: [The CONSTBUFFER's field buffer shall compare equal byte-by-byte to the cfg's field source.]*/
+        result = &((MESSAGE_HANDLE_DATA*)message)->content;
+    }
+    return result;
+}
+
+CONSTBUFFER_HANDLE Message_GetContentHandle(MESSAGE_HANDLE message) 
+{
+    CONSTBUFFER_HANDLE result;
+    if (message == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_006: [If message is NULL then Message_GetContentHandle shall return NULL.] */
+        LogError("invalid argument, message is NULL");
+        result = NULL;
+    }
+    else
+    {
+        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
+        if (messageData->base != NULL)
+        {
+            /*a message created by Message_CloneWithPropertyEdits has the content of its base*/
+            messageData = messageData->base;
+        }
+
+        if (messageData->content_handle != NULL)
+        {
+            /*Codes_SRS_MESSAGE_17_007: [If the message was created by Message_CreateFromBuffer, Message_GetContentHandle shall clone and return the CONSTBUFFER_HANDLE representing the message content.]*/
+            result = CONSTBUFFER_Clone(messageData->content_handle);
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_13_002: [Otherwise, Message_GetContentHandle shall return a new CONSTBUFFER_HANDLE holding a copy of the message content.]*/
+            result = CONSTBUFFER_Create(messageData->content.buffer, messageData->content.size);
+        }
+
+        if (result == NULL)
+        {
+            LogError("unable to get a CONSTBUFFER_HANDLE for the message content");
+        }
+    }
+    return result;
+}
+
+void Message_Destroy(MESSAGE_HANDLE message)
+{
+    /*Codes_SRS_MESSAGE_02_017: [If message is NULL then Message_Destroy shall do nothing.] */
+    if (message == NULL)
+    {
+        LogError("invalid arg: message is NULL");
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_02_020: [Otherwise, Message_Destroy shall decrement the internal ref count of the message.]*/
+        if (DEC_REF(MESSAGE_HANDLE_DATA, message) == DEC_RETURN_ZERO)
+        {
+            MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
+            if (messageData->base != NULL)
+            {
+                /*Codes_SRS_MESSAGE_13_017: [If the ref count is zero and the message was created by Message_CloneWithPropertyEdits, Message_Destroy shall destroy the message it was created from.]*/
+                Message_Destroy((MESSAGE_HANDLE)messageData->base);
+            }
+            else
+            {
+                if (messageData->properties_owner != NULL)
+                {
+                    /*Codes_SRS_MESSAGE_17_002: [If the ref count is zero and the message was created by MessageBatch_AddContent, Message_Destroy shall destroy the message holding the shared properties of the batch.]*/
+                    Message_Destroy((MESSAGE_HANDLE)messageData->properties_owner);
+                }
+                if (messageData->content_handle != NULL)
+                {
+                    /*Codes_SRS_MESSAGE_17_005: [If the ref count is zero and the message was created by Message_CreateFromBuffer, Message_Destroy shall destroy the CONSTBUFFER.]*/
+                    CONSTBUFFER_Destroy(messageData->content_handle);
+                }
+                if (messageData->release != NULL)
+                {
+                    /*Codes_SRS_MESSAGE_13_024: [If the ref count is zero and the message was created by Message_CreateFromByteArrayNoCopy with a non-NULL release, Message_Destroy shall call release with context.]*/
+                    messageData->release(messageData->release_context);
+                }
+            }
+            if (messageData->properties != NULL)
+            {
+                /*Codes_SRS_MESSAGE_13_071: [If the ref count is zero, Message_Destroy shall destroy the CONSTMAP kept by Message_GetProperties.]*/
+                ConstMap_Destroy(messageData->properties);
+            }
+            /*Codes_SRS_MESSAGE_02_021: [If the ref count is zero then the allocated resources are freed.]*/
+            free(message);
+        }
+    }
+}
+
+/*this function parses the buffer pointed to by source, having size sourceSize, starting at index position for a int32_t value*/
+/*if the parsing succeeds then *parsed is updated to reflect how many characters have been consumed*/
+/*and *value is updated to the parsed value and the function return 0*/
+/*if parsing fails, the function returns different than 0*/
+static int parse_int32_t(const unsigned char* source, int32_t sourceSize, int32_t position, int32_t *parsed, int32_t* value)
+{
+    int result;
+    if (position + 4 > sourceSize)
+    {
+        /*Codes_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+        LogError("unable to parse a int32_t because it would go past the end of the source");
+        result = __LINE__;
+    }
+    else
+    {
+        *parsed = 4;
+        *value = 
+            (source[position + 0] << 24) |
+            (source[position + 1] << 16) |
+            (source[position + 2] <<  8) |
+            (source[position + 3]);
+        result = 0;
+    }
+    return result;
+}
+
+static int parse_null_terminated_const_char(const unsigned char* source, int32_t sourceSize, int32_t position, int32_t *parsed, const char** value)
+{
+    int result;
+    const unsigned char* whereIsnull = (unsigned char*)memchr(source + position, '\0', sourceSize - position);
+    
+    if (whereIsnull == NULL)
+    {
+        /*Codes_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+        LogError("was not able to find the end of the string");
+        result = __LINE__;
+    }
+    else
+    {
+        *parsed = whereIsnull - ( source + position - 1);
+        *value = (const char*)source + position;
+        result = 0;
+    }
+    return result;
+}
+
+/*the offsets of a version 2 serialization are smaller than the size of the properties, so they take as few bytes as that size needs*/
+static size_t v2_offset_width(size_t propertiesSize)
+{
+    return
+        (propertiesSize <= 0xFF) ? 1 :
+        (propertiesSize <= 0xFFFF) ? 2 :
+        4;
+}
+
+/*parses a varint: 7 bits per byte, least significant group first, the high bit of a byte is set when more bytes follow*/
+static int parse_varint(const unsigned char* source, int32_t sourceSize, int32_t position, int32_t *parsed, int32_t* value)
+{
+    int result = __LINE__;
+    uint32_t decoded = 0;
+    int32_t i;
+    for (i = 0; (i < MAX_VARINT_LENGTH) && (position + i < sourceSize); i++)
+    {
+        unsigned char byte = source[position + i];
+        if ((i == MAX_VARINT_LENGTH - 1) && ((byte & 0x78) != 0))
+        {
+            /*the value would not fit in an int32_t*/
+            break;
+        }
+        decoded |= (uint32_t)(byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0)
+        {
+            result = 0;
+            break;
+        }
+    }
+
+    if (result != 0)
+    {
+        LogError("unable to parse a varint");
+    }
+    else
+    {
+        *parsed = i + 1;
+        *value = (int32_t)decoded;
+    }
+    return result;
+}
+
+/*parses a string of a version 2 serialization: its length as a varint, its characters and a '\0'*/
+static int parse_length_prefixed_const_char(const unsigned char* source, int32_t sourceSize, int32_t position, int32_t *parsed, const char** value)
+{
+    int result;
+    int32_t length;
+    int32_t lengthSize;
+    if (parse_varint(source, sourceSize, position, &lengthSize, &length) != 0)
+    {
+        result = __LINE__;
+    }
+    else if (
+        (length > sourceSize - position - lengthSize - 1) ||
+        (source[position + lengthSize + length] != '\0')
+        )
+    {
+        LogError("the string does not fit in the source or is not null terminated");
+        result = __LINE__;
+    }
+    else
+    {
+        *parsed = lengthSize + length + 1;
+        *value = (const char*)source + position + lengthSize;
+        result = 0;
+    }
+    return result;
+}
+
+/*where the parts of a version 2 serialization are*/
+typedef struct MESSAGE_V2_LAYOUT_TAG
+{
+    int32_t propertiesCount;
+    int32_t offsetWidth;
+    const unsigned char* offsets;
+    const unsigned char* properties;
+    int32_t propertiesSize;
+    const unsigned char* content;
+    int32_t contentSize;
+} MESSAGE_V2_LAYOUT;
+
+/*validates everything in a version 2 serialization but the properties themselves*/
+static int parse_v2_layout(const unsigned char* source, int32_t size, MESSAGE_V2_LAYOUT* layout)
+{
+    int result;
+    int32_t currentPosition = 2; /*current position is always the first character that "we are about to look at"*/
+    int32_t parsed[3]; /*the number of bytes of the total size, the number of properties and the size of the properties*/
+    int32_t messageSize;
+
+    if (
+        (parse_varint(source, size, currentPosition, &parsed[0], &messageSize) != 0) ||
+        (messageSize != size)
+        )
+    {
+        LogError("message size is inconsistent");
+        result = __LINE__;
+    }
+    else if (
+        (parse_varint(source, size, currentPosition + parsed[0], &parsed[1], &layout->propertiesCount) != 0) ||
+        (parse_varint(source, size, currentPosition + parsed[0] + parsed[1], &parsed[2], &layout->propertiesSize) != 0)
+        )
+    {
+        LogError("unable to parse the number and the size of the properties");
+        result = __LINE__;
+    }
+    else
+    {
+        currentPosition += parsed[0] + parsed[1] + parsed[2];
+        layout->offsetWidth = (int32_t)v2_offset_width((size_t)layout->propertiesSize);
+
+        /*every property takes at least 3 bytes: the length of its name and 2 '\0'*/
+        if (
+            (layout->propertiesCount > layout->propertiesSize / 3) ||
+            (layout->propertiesCount > (size - currentPosition) / layout->offsetWidth) ||
+            (layout->propertiesSize > size - currentPosition - layout->propertiesCount * layout->offsetWidth)
+            )
+        {
+            LogError("invalid message detected with %" PRId32 " properties in %" PRId32 " bytes", layout->propertiesCount, layout->propertiesSize);
+            result = __LINE__;
+        }
+        else
+        {
+            int32_t contentSizeLength;
+            layout->offsets = source + currentPosition;
+            currentPosition += layout->propertiesCount * layout->offsetWidth;
+            layout->properties = source + currentPosition;
+            currentPosition += layout->propertiesSize;
+            if (
+                (parse_varint(source, size, currentPosition, &contentSizeLength, &layout->contentSize) != 0) ||
+                (layout->contentSize != size - currentPosition - contentSizeLength)
+                )
+            {
+                LogError("the message content doesn't add up to the message size %" PRId32, messageSize);
+                result = __LINE__;
+            }
+            else
+            {
+                layout->content = source + currentPosition + contentSizeLength;
+                result = 0;
+            }
+        }
+    }
+    return result;
+}
+
+/*reads entry index of the offset table of a version 2 serialization, offsets are in MSB order*/
+static uint32_t read_v2_offset(const MESSAGE_V2_LAYOUT* layout, int32_t index)
+{
+    const unsigned char* entry = layout->offsets + index * layout->offsetWidth;
+    uint32_t offset = 0;
+    int32_t i;
+    for (i = 0; i < layout->offsetWidth; i++)
+    {
+        offset = (offset << 8) | entry[i];
+    }
+    return offset;
+}
+
+/*finds property index of a version 2 serialization through the offset table, without looking at the other properties.
+A property is the length of its name as a varint, the name, a '\0', the value and a '\0': the value ends where the next property starts.
+lengths receives the length of the name and of the value, without their '\0'*/
+static int parse_v2_property(const MESSAGE_V2_LAYOUT* layout, int32_t index, const char** key, const char** value, size_t lengths[2])
+{
+    int result;
+    uint32_t offset = read_v2_offset(layout, index);
+    uint32_t end = (index + 1 < layout->propertiesCount) ? read_v2_offset(layout, index + 1) : (uint32_t)layout->propertiesSize;
+    int32_t parsed;
+
+    if (
+        (end > (uint32_t)layout->propertiesSize) ||
+        (offset >= end) ||
+        (parse_length_prefixed_const_char(layout->properties, (int32_t)end, (int32_t)offset, &parsed, key) != 0) ||
+        ((int32_t)offset + parsed >= (int32_t)end) ||
+        (layout->properties[end - 1] != '\0')
+        )
+    {
+        LogError("unable to parse property %" PRId32, index);
+        result = __LINE__;
+    }
+    else
+    {
+        *value = (const char*)layout->properties + offset + parsed;
+        lengths[0] = (size_t)(*value - *key) - 1;
+        lengths[1] = (size_t)(end - 1 - (offset + parsed));
+        result = 0;
+    }
+    return result;
+}
+
+/*creates a MESSAGE_HANDLE from a version 2 serialization*/
+static MESSAGE_HANDLE_DATA* Message_CreateFromByteArrayV2(const unsigned char* source, int32_t size)
+{
+    MESSAGE_HANDLE_DATA* result;
+    MESSAGE_V2_LAYOUT layout;
+    if (parse_v2_layout(source, size, &layout) != 0)
+    {
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_02_026: [ A MAP_HANDLE shall be created. ]*/
+        MAP_HANDLE configMap = Map_Create(NULL);
+        if (configMap == NULL)
+        {
+            LogError("failed to create a MAP_HANDLE");
+            result = NULL;
+        }
+        else
+        {
+            int32_t i;
+            for (i = 0; i < layout.propertiesCount; i++)
+            {
+                const char* keyName;
+                const char* keyValue;
+                size_t lengths[2];
+                if (parse_v2_property(&layout, i, &keyName, &keyValue, lengths) != 0)
+                {
+                    break;
+                }
+                /*Codes_SRS_MESSAGE_02_027: [ All the properties of the byte array shall be added to the MAP_HANDLE. ]*/
+                else if (Map_Add(configMap, keyName, keyValue) != MAP_OK)
+                {
+                    LogError("Map_Add failed");
+                    break;
+                }
+            }
+
+            if (i != layout.propertiesCount)
+            {
+                result = NULL;
+            }
+            else
+            {
+                MESSAGE_CONFIG msgConfig = { (size_t)layout.contentSize, layout.content, configMap };
+                result = Message_CreateImpl(&msgConfig);
+            }
+            Map_Destroy(configMap);
+        }
+    }
+    return result;
+}
+
+/*creates a MESSAGE_HANDLE whose properties and content point into a version 2 serialization*/
+static MESSAGE_HANDLE_DATA* Message_CreateFromByteArrayNoCopyV2(const unsigned char* source, int32_t size)
+{
+    MESSAGE_HANDLE_DATA* result;
+    MESSAGE_V2_LAYOUT layout;
+    if (parse_v2_layout(source, size, &layout) != 0)
+    {
+        result = NULL;
+    }
+    else if ((size_t)layout.propertiesCount > SIZE_MAX / (2 * (sizeof(const char*) + sizeof(size_t))))
+    {
+        LogError("invalid message detected with wrong number of properties =%" PRId32, layout.propertiesCount);
+        result = NULL;
+    }
+    else
+    {
+        result = Message_Allocate((size_t)layout.propertiesCount * 2 * (sizeof(const char*) + sizeof(size_t)));
+        if (result != NULL)
+        {
+            const char** keys = (const char**)MESSAGE_INLINE_BYTES(result);
+            const char** values = keys + layout.propertiesCount;
+            size_t* lengths = (size_t*)(values + layout.propertiesCount);
+            int32_t i;
+            for (i = 0; i < layout.propertiesCount; i++)
+            {
+                if (parse_v2_property(&layout, i, &keys[i], &values[i], &lengths[2 * i]) != 0)
+                {
+                    break;
+                }
+            }
+
+            if (i != layout.propertiesCount)
+            {
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                result->keys = keys;
+                result->values = values;
+                result->lengths = lengths;
+                result->property_count = (size_t)layout.propertiesCount;
+                Message_FindWellKnownValues(result, keys, values, result->property_count);
+                result->content.buffer = (layout.contentSize == 0) ? NULL : layout.content;
+                result->content.size = (size_t)layout.contentSize;
+            }
+        }
+    }
+    return result;
+}
+
+/*creates a MESSAGE_HANDLE from a serialized byte array*/
+MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t size)
+{
+    MESSAGE_HANDLE_DATA* result;
+    /*Codes_SRS_MESSAGE_02_022: [ If source is NULL then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    /*Codes_SRS_MESSAGE_13_034: [ If source is not NULL and size parameter is smaller than 6 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    if (
+        (source == NULL) ||
+        (size < MIN_MESSAGE_V2_BUFFER_LENGTH)
+        )
+    {
+        LogError("invalid parameter source=[%p] size=%" PRId32, source, size);
+        result = NULL;
+    }
+    else if (
+        (source[0] == FIRST_MESSAGE_BYTE) &&
+        (source[1] == SECOND_MESSAGE_BYTE_V2)
+        )
+    {
+        /*Codes_SRS_MESSAGE_13_035: [ If the first two bytes of source are 0xA1 0x61 then Message_CreateFromByteArray shall parse source as a version 2 serialization and fail and return NULL if it is not valid. ]*/
+        result = Message_CreateFromByteArrayV2(source, size);
+    }
+    /*Codes_SRS_MESSAGE_02_023: [ If source is not NULL and and size parameter is smaller than 14 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    else if (size < MIN_MESSAGE_BUFFER_LENGTH)
+    {
+        LogError("invalid parameter source=[%p] size=%" PRId32, source, size);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+        if (
+            (source[0] != FIRST_MESSAGE_BYTE) ||
+            (source[1] != SECOND_MESSAGE_BYTE)
+            )
+        {
+            LogError("byte array is not a gateway message serialization");
+            result = NULL;
+        }
+        else
+        {
+            int32_t currentPosition = 2; /*current position is always the first character that "we are about to look at"*/
 
             int32_t parsed; /*reused in all parsings*/
             int32_t messageSize;
@@ -448,21 +1254,274 @@ MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t
                                             /*Codes_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
                                             result = Message_CreateImpl(&msgConfig);
 
-                                            /*return as is*/
-                                            
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                        Map_Destroy(configMap);
-                    }
-                }
-            }
+                                            /*return as is*/
+                                            
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                        Map_Destroy(configMap);
+                    }
+                }
+            }
+        }
+    }
+    return (MESSAGE_HANDLE)result;
+
+}
+
+/*creates a MESSAGE_HANDLE whose properties and content point into a serialized byte array*/
+MESSAGE_HANDLE Message_CreateFromByteArrayNoCopy(const unsigned char* source, int32_t size, MESSAGE_BYTE_ARRAY_RELEASE release, void* context)
+{
+    MESSAGE_HANDLE_DATA* result;
+    int32_t currentPosition = 2; /*current position is always the first character that "we are about to look at"*/
+    int32_t parsed; /*reused in all parsings*/
+    int32_t messageSize;
+    int32_t propertiesCount;
+
+    /*Codes_SRS_MESSAGE_13_019: [If source is NULL, size is smaller than 6, or source is not a version 2 serialization and size is smaller than 14, then Message_CreateFromByteArrayNoCopy shall fail and return NULL.]*/
+    if (
+        (source == NULL) ||
+        (size < MIN_MESSAGE_V2_BUFFER_LENGTH)
+        )
+    {
+        LogError("invalid parameter source=[%p] size=%" PRId32, source, size);
+        result = NULL;
+    }
+    else if (
+        (source[0] == FIRST_MESSAGE_BYTE) &&
+        (source[1] == SECOND_MESSAGE_BYTE_V2)
+        )
+    {
+        /*Codes_SRS_MESSAGE_13_036: [If the first two bytes of source are 0xA1 0x61 then Message_CreateFromByteArrayNoCopy shall parse source as a version 2 serialization and fail and return NULL if it is not valid.]*/
+        result = Message_CreateFromByteArrayNoCopyV2(source, size);
+    }
+    /*Codes_SRS_MESSAGE_13_019: [If source is NULL, size is smaller than 6, or source is not a version 2 serialization and size is smaller than 14, then Message_CreateFromByteArrayNoCopy shall fail and return NULL.]*/
+    else if (size < MIN_MESSAGE_BUFFER_LENGTH)
+    {
+        LogError("invalid parameter source=[%p] size=%" PRId32, source, size);
+        result = NULL;
+    }
+    /*Codes_SRS_MESSAGE_13_020: [If the first two bytes of source are not 0xA1 0x60, the size embedded in the message is not size, or parsing the properties or the content would read past the end of the array, then Message_CreateFromByteArrayNoCopy shall fail and return NULL.]*/
+    else if (
+        (source[0] != FIRST_MESSAGE_BYTE) ||
+        (source[1] != SECOND_MESSAGE_BYTE)
+        )
+    {
+        LogError("byte array is not a gateway message serialization");
+        result = NULL;
+    }
+    else if (
+        (parse_int32_t(source, size, currentPosition, &parsed, &messageSize) != 0) ||
+        (messageSize != size)
+        )
+    {
+        LogError("message size is inconsistent");
+        result = NULL;
+    }
+    else if (parse_int32_t(source, size, currentPosition + parsed, &parsed, &propertiesCount) != 0)
+    {
+        LogError("unable to parse an int32_t");
+        result = NULL;
+    }
+    /*every property takes at least 2 bytes and the content size follows the properties*/
+    else if (
+        (propertiesCount < 0) ||
+        (propertiesCount > (size - MIN_MESSAGE_BUFFER_LENGTH) / 2) ||
+        ((size_t)propertiesCount > SIZE_MAX / (2 * (sizeof(const char*) + sizeof(size_t))))
+        )
+    {
+        LogError("invalid message detected with wrong number of properties =%" PRId32, propertiesCount);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_13_021: [Message_CreateFromByteArrayNoCopy shall allocate the message and the arrays of the keys and values of its properties in a single allocation, and shall not copy the properties and the content out of source.]*/
+        result = Message_Allocate((size_t)propertiesCount * 2 * (sizeof(const char*) + sizeof(size_t)));
+        if (result == NULL)
+        {
+            /*Codes_SRS_MESSAGE_13_022: [If allocating the message fails, Message_CreateFromByteArrayNoCopy shall fail and return NULL.]*/
+            /*return as is*/
+        }
+        else
+        {
+            const char** keys = (const char**)MESSAGE_INLINE_BYTES(result);
+            const char** values = keys + propertiesCount;
+            size_t* lengths = (size_t*)(values + propertiesCount);
+            int32_t messageContentSize;
+            int32_t i;
+
+            currentPosition = 10;
+            for (i = 0; i < propertiesCount; i++)
+            {
+                if (parse_null_terminated_const_char(source, size, currentPosition, &parsed, &keys[i]) != 0)
+                {
+                    LogError("unable to parse the name string of the property");
+                    break;
+                }
+                /*parsed counts the '\0'*/
+                lengths[2 * i] = (size_t)parsed - 1;
+                currentPosition += parsed;
+                if (parse_null_terminated_const_char(source, size, currentPosition, &parsed, &values[i]) != 0)
+                {
+                    LogError("unable to parse the value string of the property");
+                    break;
+                }
+                lengths[2 * i + 1] = (size_t)parsed - 1;
+                currentPosition += parsed;
+            }
+
+            if (i != propertiesCount)
+            {
+                free(result);
+                result = NULL;
+            }
+            else if (parse_int32_t(source, size, currentPosition, &parsed, &messageContentSize) != 0)
+            {
+                LogError("no space to read the number of bytes making the message");
+                free(result);
+                result = NULL;
+            }
+            else if (
+                (messageContentSize < 0) ||
+                (messageContentSize != messageSize - currentPosition - parsed)
+                )
+            {
+                LogError("the message content doesn't add up to the message size %" PRId32, messageSize);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                currentPosition += parsed;
+                result->keys = keys;
+                result->values = values;
+                result->lengths = lengths;
+                result->property_count = (size_t)propertiesCount;
+                Message_FindWellKnownValues(result, keys, values, result->property_count);
+                result->content.buffer = (messageContentSize == 0) ? NULL : source + currentPosition;
+                result->content.size = (size_t)messageContentSize;
+            }
+        }
+    }
+
+    /*Codes_SRS_MESSAGE_13_026: [On failure, Message_CreateFromByteArrayNoCopy shall not call release.]*/
+    if (result != NULL)
+    {
+        /*Codes_SRS_MESSAGE_13_023: [On success, Message_CreateFromByteArrayNoCopy shall return a non-NULL handle with its internal ref count set to "1" that owns source.]*/
+        result->release = release;
+        result->release_context = context;
+    }
+    return (MESSAGE_HANDLE)result;
+}
+
+/*copies the null terminated string source of length characters (and its '\0') at position in buf and returns the position that follows it*/
+static size_t write_string(unsigned char* buf, size_t position, const char* source, size_t length)
+{
+    /*the byte array was sized for source and its '\0', so copy them with one memcpy*/
+    (void)memcpy(buf + position, source, length + 1);
+    return position + length + 1;
+}
+
+/*writes the name and value of a property, whose lengths are lengths[0] and lengths[1], at position in buf and returns the position that follows them*/
+static size_t write_property(unsigned char* buf, size_t position, const char* name, const char* value, const size_t lengths[2])
+{
+    return write_string(buf, write_string(buf, position, name, lengths[0]), value, lengths[1]);
+}
+
+/*describes how a message is serialized: the prefix is everything before the bytes of the content*/
+typedef struct MESSAGE_SERIALIZED_LAYOUT_TAG
+{
+    const char* const* keys;
+    const char* const* values;
+    const size_t* lengths;
+    size_t nProperties;
+    size_t nSerializedProperties;
+    size_t prefixSize;
+    size_t byteArraySize;
+    /*only used by version 2*/
+    size_t propertiesSize;
+    size_t offsetWidth;
+} MESSAGE_SERIALIZED_LAYOUT;
+
+static void Message_GetSerializedLayout(const MESSAGE_HANDLE_DATA* message, MESSAGE_SERIALIZED_LAYOUT* layout)
+{
+    size_t i;
+    layout->keys = message->keys;
+    layout->values = message->values;
+    layout->lengths = message->lengths;
+    layout->nProperties = message->property_count;
+    layout->prefixSize =
+        + 2 /*header*/
+        + 4 /*total size of byte array*/
+        + 4 /*total number of properties*/
+        + 0 /*an unknown at this moment number of bytes for properties*/
+        + 4 /*number of bytes in messageContent*/
+        ;
+    layout->nSerializedProperties = 0;
+    for (i = 0;i < layout->nProperties;i++)
+    {
+        /*Codes_SRS_MESSAGE_13_018: [If the message was created by Message_CloneWithPropertyEdits, Message_ToByteArray shall serialize the properties of the message it was created from, as edited.]*/
+        if (Message_FindEdit(message->edits, message->edit_count, layout->keys[i]) == NULL)
+        {
+            /*add to the needed size the name and value of property i*/
+            layout->prefixSize += (layout->lengths[2 * i] + 1) + (layout->lengths[2 * i + 1] + 1);
+            layout->nSerializedProperties++;
+        }
+    }
+    for (i = 0;i < message->edit_count;i++)
+    {
+        if (message->edits[i].value != NULL)
+        {
+            layout->prefixSize += (message->edit_lengths[2 * i] + 1) + (message->edit_lengths[2 * i + 1] + 1);
+            layout->nSerializedProperties++;
+        }
+    }
+    layout->byteArraySize = layout->prefixSize + message->content.size;
+}
+
+/*writes the header, the properties and the size of the content of a message, buf has to hold at least layout->prefixSize bytes*/
+static void Message_WritePrefix(const MESSAGE_HANDLE_DATA* message, const MESSAGE_SERIALIZED_LAYOUT* layout, unsigned char* buf)
+{
+    size_t i;
+    size_t currentPosition; /*always points to the byte we are about to write*/
+    size_t contentSize = message->content.size;
+    /*a header formed of the following hex characters in this order: 0xA1 0x60*/
+    buf[0] = FIRST_MESSAGE_BYTE;
+    buf[1] = SECOND_MESSAGE_BYTE;
+    /*4 bytes in MSB order representing the total size of the byte array. */
+    buf[2] = (layout->byteArraySize >> 24) & 0xFF;
+    buf[3] = (layout->byteArraySize >> 16) & 0xFF;
+    buf[4] = (layout->byteArraySize >> 8) & 0xFF;
+    buf[5] = (layout->byteArraySize) & 0xFF;
+    /*4 bytes in MSB order representing the number of properties*/
+    buf[6] = (layout->nSerializedProperties >> 24) & 0xFF;
+    buf[7] = (layout->nSerializedProperties >> 16) & 0xFF;
+    buf[8] = (layout->nSerializedProperties >> 8) & 0xFF;
+    buf[9] = layout->nSerializedProperties & 0xFF;
+    /*for every property, 2 arrays of null terminated characters representing the name of the property and the value.*/
+    currentPosition = 10;
+    for (i = 0;i < layout->nProperties;i++)
+    {
+        if (Message_FindEdit(message->edits, message->edit_count, layout->keys[i]) == NULL)
+        {
+            currentPosition = write_property(buf, currentPosition, layout->keys[i], layout->values[i], &layout->lengths[2 * i]);
+        }
+    }
+    for (i = 0;i < message->edit_count;i++)
+    {
+        if (message->edits[i].value != NULL)
+        {
+            currentPosition = write_property(buf, currentPosition, message->edits[i].key, message->edits[i].value, &message->edit_lengths[2 * i]);
         }
     }
-    return (MESSAGE_HANDLE)result;
 
+    /*4 bytes in MSB order representing the number of bytes in the message content array*/
+    buf[currentPosition++] = (contentSize >> 24) & 0xFF;
+    buf[currentPosition++] = (contentSize >> 16) & 0xFF;
+    buf[currentPosition++] = (contentSize >> 8) & 0xFF;
+    buf[currentPosition] = contentSize & 0xFF;
 }
 
 extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char* buf, int32_t size)
@@ -486,97 +1545,519 @@ extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char*
     else
     {
         MESSAGE_HANDLE_DATA* messageHandleData = (MESSAGE_HANDLE_DATA*)messageHandle;
+        MESSAGE_SERIALIZED_LAYOUT layout;
 
         /*Codes_SRS_MESSAGE_02_033: [Message_ToByteArray shall precompute the needed memory size.]*/
-        size_t byteArraySize =
-            + 2 /*header*/
-            + 4 /*total size of byte array*/
-            + 4 /*total number of properties*/
-            + 0 /*an unknown at this moment number of bytes for properties*/
-            + 4 /*number of bytes in messageContent*/
-            + 0 /*an unknown at this moment number of bytes for message content*/
-            ;
-        
-        const char* const * keys;
-        const char* const * values;
-        size_t nProperties;
-
-        /*Codes_SRS_MESSAGE_02_035: [ If any of the above steps fails then Message_ToByteArray shall fail and return -1. ]*/
-        if (ConstMap_GetInternals(messageHandleData->properties, &keys, &values, &nProperties) != CONSTMAP_OK)
-        {
-            LogError("failed to get the keys and values from the message properties");
+        Message_GetSerializedLayout(messageHandleData, &layout);
+        if (size == 0)
+        {
+            /*Codes_SRS_MESSAGE_17_016: [ If buf is NULL and size is equal to zero, Message_ToByteArray shall return the needed memory size. ]*/
+            result = layout.byteArraySize;
+        }
+        else if (layout.byteArraySize > (size_t)size)
+        {
+            /*Codes_SRS_MESSAGE_17_017: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArray shall return -1; ]*/
+            LogError("message is %zu bytes, won't fit in buffer of %d bytes", layout.byteArraySize, size);
             result = -1;
         }
         else
         {
-            size_t i;
-            for (i = 0;i < nProperties;i++)
+            /*Codes_SRS_MESSAGE_02_034: [ Message_ToByteArray shall populate the memory with values as indicated in the implementation details. ]*/
+            Message_WritePrefix(messageHandleData, &layout, buf);
+
+            /*n bytes of message content follows.*/
+            if (messageHandleData->content.size > 0)
             {
-                /*add to the needed size the name and value of property i*/
-                byteArraySize += (strlen(keys[i]) + 1) + (strlen(values[i]) + 1);
+                memcpy(buf + layout.prefixSize, messageHandleData->content.buffer, messageHandleData->content.size);
             }
 
-            const CONSTBUFFER* messageContent = CONSTBUFFER_GetContent(messageHandleData->content);
-            byteArraySize += messageContent->size;
-            
-            if (size == 0)
+            /*Codes_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, and return the byte array size. ]*/
+            result = layout.byteArraySize;
+        }
+    }
+    return result;
+}
+
+/*returns how many bytes write_varint takes to write value*/
+static size_t varint_size(size_t value)
+{
+    size_t result = 1;
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        result++;
+    }
+    return result;
+}
+
+/*writes value as a varint at position in buf and returns the position that follows it, see parse_varint*/
+static size_t write_varint(unsigned char* buf, size_t position, size_t value)
+{
+    while (value >= 0x80)
+    {
+        buf[position++] = (unsigned char)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    buf[position++] = (unsigned char)value;
+    return position;
+}
+
+/*returns how many bytes a property, whose name and value are lengths[0] and lengths[1] characters long, takes in the properties of a version 2 serialization, see parse_v2_property*/
+static size_t v2_property_size(const size_t lengths[2])
+{
+    return varint_size(lengths[0]) + lengths[0] + 1 + lengths[1] + 1;
+}
+
+/*writes a property of a version 2 serialization and its entry in the offset table*/
+static size_t write_v2_property(unsigned char* buf, const MESSAGE_SERIALIZED_LAYOUT* layout, size_t offsetsPosition, size_t index, size_t propertiesPosition, size_t position, const char* name, const char* value, const size_t lengths[2])
+{
+    size_t offset = position - propertiesPosition;
+    size_t entry = offsetsPosition + index * layout->offsetWidth;
+    size_t i;
+    /*offsets are in MSB order*/
+    for (i = layout->offsetWidth; i > 0; i--)
+    {
+        buf[entry + i - 1] = (unsigned char)(offset & 0xFF);
+        offset >>= 8;
+    }
+    position = write_varint(buf, position, lengths[0]);
+    return write_property(buf, position, name, value, lengths);
+}
+
+static void Message_GetSerializedLayoutV2(const MESSAGE_HANDLE_DATA* message, MESSAGE_SERIALIZED_LAYOUT* layout)
+{
+    size_t i;
+    size_t sizeWithoutTotalSize;
+    layout->keys = message->keys;
+    layout->values = message->values;
+    layout->lengths = message->lengths;
+    layout->nProperties = message->property_count;
+    layout->propertiesSize = 0;
+    layout->nSerializedProperties = 0;
+    for (i = 0; i < layout->nProperties; i++)
+    {
+        if (Message_FindEdit(message->edits, message->edit_count, layout->keys[i]) == NULL)
+        {
+            layout->propertiesSize += v2_property_size(&layout->lengths[2 * i]);
+            layout->nSerializedProperties++;
+        }
+    }
+    for (i = 0; i < message->edit_count; i++)
+    {
+        if (message->edits[i].value != NULL)
+        {
+            layout->propertiesSize += v2_property_size(&message->edit_lengths[2 * i]);
+            layout->nSerializedProperties++;
+        }
+    }
+
+    layout->offsetWidth = v2_offset_width(layout->propertiesSize);
+
+    sizeWithoutTotalSize =
+        + 2 /*header*/
+        + varint_size(layout->nSerializedProperties)
+        + varint_size(layout->propertiesSize)
+        + layout->nSerializedProperties * layout->offsetWidth
+        + layout->propertiesSize
+        + varint_size(message->content.size)
+        + message->content.size;
+
+    /*the total size includes its own varint, which may need one more byte once it is added*/
+    layout->byteArraySize = sizeWithoutTotalSize + varint_size(sizeWithoutTotalSize);
+    if (layout->byteArraySize != sizeWithoutTotalSize + varint_size(layout->byteArraySize))
+    {
+        layout->byteArraySize++;
+    }
+}
+
+static void Message_WriteV2(const MESSAGE_HANDLE_DATA* message, const MESSAGE_SERIALIZED_LAYOUT* layout, unsigned char* buf)
+{
+    size_t i;
+    size_t index = 0;
+    size_t offsetsPosition;
+    size_t propertiesPosition;
+    size_t currentPosition; /*always points to the byte we are about to write*/
+
+    buf[0] = FIRST_MESSAGE_BYTE;
+    buf[1] = SECOND_MESSAGE_BYTE_V2;
+    currentPosition = write_varint(buf, 2, layout->byteArraySize);
+    currentPosition = write_varint(buf, currentPosition, layout->nSerializedProperties);
+    currentPosition = write_varint(buf, currentPosition, layout->propertiesSize);
+
+    offsetsPosition = currentPosition;
+    propertiesPosition = offsetsPosition + layout->nSerializedProperties * layout->offsetWidth;
+    currentPosition = propertiesPosition;
+    for (i = 0; i < layout->nProperties; i++)
+    {
+        if (Message_FindEdit(message->edits, message->edit_count, layout->keys[i]) == NULL)
+        {
+            currentPosition = write_v2_property(buf, layout, offsetsPosition, index++, propertiesPosition, currentPosition, layout->keys[i], layout->values[i], &layout->lengths[2 * i]);
+        }
+    }
+    for (i = 0; i < message->edit_count; i++)
+    {
+        if (message->edits[i].value != NULL)
+        {
+            currentPosition = write_v2_property(buf, layout, offsetsPosition, index++, propertiesPosition, currentPosition, message->edits[i].key, message->edits[i].value, &message->edit_lengths[2 * i]);
+        }
+    }
+
+    currentPosition = write_varint(buf, currentPosition, message->content.size);
+    if (message->content.size > 0)
+    {
+        memcpy(buf + currentPosition, message->content.buffer, message->content.size);
+    }
+}
+
+extern int32_t Message_ToByteArrayWithFormat(MESSAGE_HANDLE messageHandle, MESSAGE_WIRE_FORMAT format, unsigned char* buf, int32_t size)
+{
+    int32_t result;
+    if (format == MESSAGE_WIRE_FORMAT_V1)
+    {
+        /*Codes_SRS_MESSAGE_13_037: [ If format is MESSAGE_WIRE_FORMAT_V1, Message_ToByteArrayWithFormat shall return what Message_ToByteArray returns. ]*/
+        result = Message_ToByteArray(messageHandle, buf, size);
+    }
+    else if (
+        (messageHandle == NULL) ||
+        ((buf == NULL) && (size != 0)) ||
+        (format != MESSAGE_WIRE_FORMAT_V2)
+        )
+    {
+        /*Codes_SRS_MESSAGE_13_038: [ If messageHandle is NULL, buf is NULL and size is not equal to zero, or format is not a MESSAGE_WIRE_FORMAT, then Message_ToByteArrayWithFormat shall fail and return -1. ]*/
+        LogError("invalid parameter messageHandle=[%p] format=%d buf=[%p] size=%" PRId32, messageHandle, (int)format, buf, size);
+        result = -1;
+    }
+    else
+    {
+        MESSAGE_HANDLE_DATA* messageHandleData = (MESSAGE_HANDLE_DATA*)messageHandle;
+        MESSAGE_SERIALIZED_LAYOUT layout;
+
+        /*Codes_SRS_MESSAGE_13_039: [ Message_ToByteArrayWithFormat shall precompute the needed memory size and return it if buf is NULL and size is equal to zero. ]*/
+        Message_GetSerializedLayoutV2(messageHandleData, &layout);
+        if (layout.byteArraySize > INT32_MAX)
+        {
+            /*Codes_SRS_MESSAGE_13_042: [ If any of the above steps fails then Message_ToByteArrayWithFormat shall fail and return -1. ]*/
+            LogError("message is %zu bytes, too big to be serialized", layout.byteArraySize);
+            result = -1;
+        }
+        else if (size == 0)
+        {
+            /*Codes_SRS_MESSAGE_13_039: [ Message_ToByteArrayWithFormat shall precompute the needed memory size and return it if buf is NULL and size is equal to zero. ]*/
+            result = (int32_t)layout.byteArraySize;
+        }
+        else if (layout.byteArraySize > (size_t)size)
+        {
+            /*Codes_SRS_MESSAGE_13_040: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArrayWithFormat shall return -1. ]*/
+            LogError("message is %zu bytes, won't fit in buffer of %" PRId32 " bytes", layout.byteArraySize, size);
+            result = -1;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_13_041: [ If format is MESSAGE_WIRE_FORMAT_V2, Message_ToByteArrayWithFormat shall populate the memory with values as indicated in the implementation details of version 2. ]*/
+            Message_WriteV2(messageHandleData, &layout, buf);
+
+            /*Codes_SRS_MESSAGE_13_043: [ Otherwise Message_ToByteArrayWithFormat shall succeed, and return the byte array size. ]*/
+            result = (int32_t)layout.byteArraySize;
+        }
+    }
+    return result;
+}
+
+extern int32_t Message_ToIoVec(MESSAGE_HANDLE messageHandle, MESSAGE_IOVEC segments[MESSAGE_IOVEC_COUNT])
+{
+    int32_t result;
+    if (
+        (messageHandle == NULL) ||
+        (segments == NULL)
+        )
+    {
+        /*Codes_SRS_MESSAGE_13_027: [If messageHandle or segments is NULL then Message_ToIoVec shall fail and return -1.]*/
+        LogError("invalid parameter messageHandle=[%p] segments=[%p]", messageHandle, segments);
+        result = -1;
+    }
+    else
+    {
+        MESSAGE_HANDLE_DATA* messageHandleData = (MESSAGE_HANDLE_DATA*)messageHandle;
+        MESSAGE_SERIALIZED_LAYOUT layout;
+
+        Message_GetSerializedLayout(messageHandleData, &layout);
+        if (layout.byteArraySize > INT32_MAX)
+        {
+            /*Codes_SRS_MESSAGE_13_030: [If any of the above steps fails then Message_ToIoVec shall fail and return -1.]*/
+            LogError("message is %zu bytes, too big to be serialized", layout.byteArraySize);
+            result = -1;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_13_028: [Message_ToIoVec shall allocate a buffer and write to it the header, the properties and the size of the content of the message, in the same format as Message_ToByteArray.]*/
+            unsigned char* prefix = (unsigned char*)malloc(layout.prefixSize);
+            if (prefix == NULL)
             {
-				/*Codes_SRS_MESSAGE_17_016: [ If buf is NULL and size is equal to zero, Message_ToByteArray shall return the needed memory size. ]*/
-				result = byteArraySize;
+                /*Codes_SRS_MESSAGE_13_030: [If any of the above steps fails then Message_ToIoVec shall fail and return -1.]*/
+                LogError("unable to allocate %zu bytes", layout.prefixSize);
+                result = -1;
             }
-			else if (byteArraySize > (size_t)size)
-			{
-				/*Codes_SRS_MESSAGE_17_017: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArray shall return -1; ]*/
-				LogError("message is %u bytes, won't fit in buffer of %u bytes", byteArraySize, size);
-				result = -1;
-			}
             else
             {
-                /*Codes_SRS_MESSAGE_02_034: [ Message_ToByteArray shall populate the memory with values as indicated in the implementation details. ]*/
-
-                size_t currentPosition; /*always points to the byte we are about to write*/
-                /*a header formed of the following hex characters in this order: 0xA1 0x60*/
-				buf[0] = FIRST_MESSAGE_BYTE;
-				buf[1] = SECOND_MESSAGE_BYTE;
-                /*4 bytes in MSB order representing the total size of the byte array. */
-				buf[2] = byteArraySize >> 24;
-				buf[3] = (byteArraySize >> 16) & 0xFF;
-				buf[4] = (byteArraySize >> 8) & 0xFF;
-				buf[5] = (byteArraySize) & 0xFF;
-                /*4 bytes in MSB order representing the number of properties*/
-				buf[6] = nProperties >> 24;
-				buf[7] = (nProperties >> 16) & 0xFF;
-				buf[8] = (nProperties >> 8) & 0xFF;
-				buf[9] = nProperties & 0xFF;
-                /*for every property, 2 arrays of null terminated characters representing the name of the property and the value.*/
-                currentPosition = 10;
-                for (i = 0;i < nProperties;i++)
-                {
-                    size_t nameLength = strlen(keys[i]) + 1;/*the +1 will take care of copying '\0' too*/
-                    size_t valueLength = strlen(values[i]) + 1;/*the +1 will take care of copying '\0' too*/
-
-                    /*copy name*/
-                    memcpy(buf + currentPosition, keys[i], nameLength);
-                    currentPosition += nameLength;
-                    
-                    /*copy value*/
-                    memcpy(buf + currentPosition, values[i], valueLength);
-                    currentPosition += valueLength;
-                }
+                Message_WritePrefix(messageHandleData, &layout, prefix);
+
+                /*Codes_SRS_MESSAGE_13_029: [Message_ToIoVec shall set the first segment to that buffer and the second segment to the content of the message, without copying the content.]*/
+                segments[0].buffer = prefix;
+                segments[0].size = layout.prefixSize;
+                segments[1].buffer = messageHandleData->content.buffer;
+                segments[1].size = messageHandleData->content.size;
+
+                /*Codes_SRS_MESSAGE_13_031: [Otherwise Message_ToIoVec shall succeed and return the total size of the segments.]*/
+                result = (int32_t)layout.byteArraySize;
+            }
+        }
+    }
+    return result;
+}
+
+extern void Message_FreeIoVec(MESSAGE_IOVEC segments[MESSAGE_IOVEC_COUNT])
+{
+    if (segments == NULL)
+    {
+        /*Codes_SRS_MESSAGE_13_032: [If segments is NULL then Message_FreeIoVec shall do nothing.]*/
+        LogError("invalid (NULL) segments parameter detected");
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_13_033: [Message_FreeIoVec shall free the buffer of the first segment, which Message_ToIoVec allocated.]*/
+        free((void*)segments[0].buffer);
+        segments[0].buffer = NULL;
+        segments[0].size = 0;
+        segments[1].buffer = NULL;
+        segments[1].size = 0;
+    }
+}
+#define MESSAGE_BATCH_INITIAL_CAPACITY 16
+
+typedef struct MESSAGE_BATCH_HANDLE_DATA_TAG
+{
+    MESSAGE_HANDLE* messages;
+    size_t count;
+    size_t capacity;
+    /*a message without content holding the shared properties of the batch, NULL when the batch was created without them*/
+    MESSAGE_HANDLE_DATA* prototype;
+}MESSAGE_BATCH_HANDLE_DATA;
+
+MESSAGE_BATCH_HANDLE MessageBatch_Create(MAP_HANDLE sharedProperties)
+{
+    MESSAGE_BATCH_HANDLE_DATA* result = (MESSAGE_BATCH_HANDLE_DATA*)malloc(sizeof(MESSAGE_BATCH_HANDLE_DATA));
+    if (result == NULL)
+    {
+        /*Codes_SRS_MESSAGE_13_045: [If any of the above steps fails, MessageBatch_Create shall fail and return NULL.]*/
+        LogError("malloc failed");
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_13_044: [MessageBatch_Create shall create an empty batch of messages.]*/
+        result->messages = NULL;
+        result->count = 0;
+        result->capacity = 0;
+
+        if (sharedProperties == NULL)
+        {
+            result->prototype = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_13_046: [If sharedProperties is not NULL, MessageBatch_Create shall copy it once for all the messages created by MessageBatch_AddContent.]*/
+            MESSAGE_CONFIG cfg = { 0, NULL, sharedProperties };
+            result->prototype = Message_CreateImpl(&cfg);
+            if (result->prototype == NULL)
+            {
+                /*Codes_SRS_MESSAGE_13_045: [If any of the above steps fails, MessageBatch_Create shall fail and return NULL.]*/
+                LogError("unable to copy the shared properties");
+                free(result);
+                result = NULL;
+            }
+        }
+    }
+    return (MESSAGE_BATCH_HANDLE)result;
+}
+
+/*doubles the capacity of a full batch*/
+static int MessageBatch_Grow(MESSAGE_BATCH_HANDLE_DATA* batch)
+{
+    int result;
+    size_t new_capacity = (batch->capacity == 0) ? MESSAGE_BATCH_INITIAL_CAPACITY : batch->capacity * 2;
+    MESSAGE_HANDLE* new_messages;
+
+    if (new_capacity < batch->capacity || new_capacity > SIZE_MAX / sizeof(MESSAGE_HANDLE))
+    {
+        LogError("message batch capacity overflow");
+        result = __LINE__;
+    }
+    else if ((new_messages = (MESSAGE_HANDLE*)malloc(new_capacity * sizeof(MESSAGE_HANDLE))) == NULL)
+    {
+        LogError("malloc failed");
+        result = __LINE__;
+    }
+    else
+    {
+        if (batch->count > 0)
+        {
+            (void)memcpy(new_messages, batch->messages, batch->count * sizeof(MESSAGE_HANDLE));
+        }
+        free(batch->messages);
+        batch->messages = new_messages;
+        batch->capacity = new_capacity;
+        result = 0;
+    }
+    return result;
+}
+
+/*appends message to the batch, which takes ownership of it upon success*/
+static int MessageBatch_Append(MESSAGE_BATCH_HANDLE_DATA* batch, MESSAGE_HANDLE message)
+{
+    int result;
+    if (batch->count == batch->capacity && MessageBatch_Grow(batch) != 0)
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        batch->messages[batch->count] = message;
+        batch->count++;
+        result = 0;
+    }
+    return result;
+}
+
+int MessageBatch_Add(MESSAGE_BATCH_HANDLE batch, MESSAGE_HANDLE message)
+{
+    int result;
+    if (batch == NULL || message == NULL)
+    {
+        /*Codes_SRS_MESSAGE_13_047: [If batch or message is NULL, MessageBatch_Add shall fail and return a non-zero value.]*/
+        LogError("invalid arg batch=%p, message=%p", batch, message);
+        result = __LINE__;
+    }
+    /*Codes_SRS_MESSAGE_13_048: [MessageBatch_Add shall append a clone of message to the batch, growing the batch when it is full.]*/
+    else if (MessageBatch_Append((MESSAGE_BATCH_HANDLE_DATA*)batch, message) != 0)
+    {
+        /*Codes_SRS_MESSAGE_13_049: [If growing the batch fails, MessageBatch_Add shall fail and return a non-zero value.]*/
+        result = __LINE__;
+    }
+    else
+    {
+        (void)Message_Clone(message);
+        /*Codes_SRS_MESSAGE_13_050: [Otherwise MessageBatch_Add shall succeed and return 0.]*/
+        result = 0;
+    }
+    return result;
+}
 
-                /*4 bytes in MSB order representing the number of bytes in the message content array*/
-				buf[currentPosition++] = (messageContent->size) >> 24;
-				buf[currentPosition++] = ((messageContent->size) >> 16) & 0xFF;
-				buf[currentPosition++] = ((messageContent->size) >> 8) & 0xFF;
-				buf[currentPosition++] = (messageContent->size) & 0xFF;
+int MessageBatch_AddContent(MESSAGE_BATCH_HANDLE batch, const unsigned char* source, size_t size)
+{
+    int result;
+    MESSAGE_BATCH_HANDLE_DATA* batchData = (MESSAGE_BATCH_HANDLE_DATA*)batch;
+    if (batchData == NULL || (source == NULL && size > 0))
+    {
+        /*Codes_SRS_MESSAGE_13_051: [If batch is NULL, or source is NULL and size is not zero, MessageBatch_AddContent shall fail and return a non-zero value.]*/
+        LogError("invalid arg batch=%p, source=%p, size=%zu", batch, source, size);
+        result = __LINE__;
+    }
+    else if (batchData->prototype == NULL)
+    {
+        /*Codes_SRS_MESSAGE_13_052: [If the batch was created without shared properties, MessageBatch_AddContent shall fail and return a non-zero value.]*/
+        LogError("the batch does not have shared properties");
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_13_053: [MessageBatch_AddContent shall create a message with a copy of source in the same allocation as the message.]*/
+        MESSAGE_HANDLE_DATA* message = Message_Allocate(size);
+        if (message == NULL)
+        {
+            /*Codes_SRS_MESSAGE_13_055: [If any of the above steps fails, MessageBatch_AddContent shall fail and return a non-zero value.]*/
+            result = __LINE__;
+        }
+        else
+        {
+            if (size == 0)
+            {
+                message->content.buffer = NULL;
+            }
+            else
+            {
+                memcpy(MESSAGE_INLINE_BYTES(message), source, size);
+                message->content.buffer = MESSAGE_INLINE_BYTES(message);
+            }
+            message->content.size = size;
 
-                /*n bytes of message content follows.*/
-                memcpy(buf + currentPosition, messageContent->buffer, messageContent->size);
+            /*Codes_SRS_MESSAGE_13_054: [The message shall share the shared properties of the batch, and hold a reference to the message holding them until it is destroyed.]*/
+            INC_REF(MESSAGE_HANDLE_DATA, batchData->prototype);
+            message->properties_owner = batchData->prototype;
+            message->keys = batchData->prototype->keys;
+            message->values = batchData->prototype->values;
+            message->lengths = batchData->prototype->lengths;
+            message->property_count = batchData->prototype->property_count;
+            (void)memcpy(message->well_known_values, batchData->prototype->well_known_values, sizeof(message->well_known_values));
 
-				/*Codes_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, and return the byte array size. ]*/
-				result = byteArraySize;
+            /*Codes_SRS_MESSAGE_13_056: [MessageBatch_AddContent shall append the message to the batch, growing the batch when it is full.]*/
+            if (MessageBatch_Append(batchData, (MESSAGE_HANDLE)message) != 0)
+            {
+                /*Codes_SRS_MESSAGE_13_055: [If any of the above steps fails, MessageBatch_AddContent shall fail and return a non-zero value.]*/
+                Message_Destroy((MESSAGE_HANDLE)message);
+                result = __LINE__;
+            }
+            else
+            {
+                /*Codes_SRS_MESSAGE_13_057: [Otherwise MessageBatch_AddContent shall succeed and return 0.]*/
+                result = 0;
             }
         }
     }
     return result;
-}
\ No newline at end of file
+}
+
+size_t MessageBatch_GetCount(MESSAGE_BATCH_HANDLE batch)
+{
+    /*Codes_SRS_MESSAGE_13_058: [MessageBatch_GetCount shall return the number of messages in the batch, or 0 if batch is NULL.]*/
+    return (batch == NULL) ? 0 : ((MESSAGE_BATCH_HANDLE_DATA*)batch)->count;
+}
+
+const MESSAGE_HANDLE* MessageBatch_GetMessages(MESSAGE_BATCH_HANDLE batch)
+{
+    const MESSAGE_HANDLE* result;
+    if (batch == NULL || ((MESSAGE_BATCH_HANDLE_DATA*)batch)->count == 0)
+    {
+        /*Codes_SRS_MESSAGE_13_059: [If batch is NULL or empty, MessageBatch_GetMessages shall return NULL.]*/
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_13_060: [Otherwise MessageBatch_GetMessages shall return the messages of the batch in the order they were added, without cloning them.]*/
+        result = ((MESSAGE_BATCH_HANDLE_DATA*)batch)->messages;
+    }
+    return result;
+}
+
+void MessageBatch_Destroy(MESSAGE_BATCH_HANDLE batch)
+{
+    if (batch == NULL)
+    {
+        /*Codes_SRS_MESSAGE_13_061: [If batch is NULL, MessageBatch_Destroy shall do nothing.]*/
+        LogError("invalid arg: batch is NULL");
+    }
+    else
+    {
+        MESSAGE_BATCH_HANDLE_DATA* batchData = (MESSAGE_BATCH_HANDLE_DATA*)batch;
+        size_t i;
+        /*Codes_SRS_MESSAGE_13_062: [MessageBatch_Destroy shall call Message_Destroy on every message of the batch and free the batch.]*/
+        for (i = 0; i < batchData->count; i++)
+        {
+            Message_Destroy(batchData->messages[i]);
+        }
+        if (batchData->prototype != NULL)
+        {
+            Message_Destroy((MESSAGE_HANDLE)batchData->prototype);
+        }
+        free(batchData->messages);
+        free(batchData);
+    }
+}
@@ -5,6 +5,7 @@
 #include <crtdbg.h>
 #endif
 #include <cstdlib>
+#include <cstdint>
 #include <signal.h>
 
 #include "testrunnerswitcher.h"
@@ -14,7 +15,10 @@
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/list.h"
 #include "message.h"
-#include "azure_c_shared_utility/threadapi.h"
+#include "internal/message_queue.h"
+#include "internal/worker_pool.h"
+#include "internal/routing_table.h"
+#include "internal/link_filter.h"
 #include "azure_c_shared_utility/refcount.h"
 
 static MICROMOCK_MUTEX_HANDLE g_testByTest;
@@ -41,6 +45,23 @@ namespace BASEIMPLEMENTATION
 #undef Lock_Init
 #undef Lock_Deinit
 #include "vector.c"
+#define Lock(x) LOCK_OK
+#define Unlock(x) LOCK_OK
+#define Lock_Init() (LOCK_HANDLE)0x42
+#define Lock_Deinit(x) LOCK_OK
+#define Condition_Init() (COND_HANDLE)0x43
+#define Condition_Post(x) COND_OK
+#define Condition_Wait(x, y, z) COND_OK
+#define Condition_Deinit(x)
+#include "../../src/internal/routing_table.c"
+#undef Lock
+#undef Unlock
+#undef Lock_Init
+#undef Lock_Deinit
+#undef Condition_Init
+#undef Condition_Post
+#undef Condition_Wait
+#undef Condition_Deinit
 };
 
 #include "broker.h"
@@ -60,6 +81,12 @@ static size_t whenShallVECTOR_push_back_fail;
 static size_t currentVECTOR_find_if_call;
 static size_t whenShallVECTOR_find_if_fail;
 
+static size_t currentMessageQueue_Create_call;
+static size_t whenShallMessageQueue_Create_fail;
+
+static size_t currentMessageQueue_Push_call;
+static size_t whenShallMessageQueue_Push_fail;
+
 static size_t currentlist_find_call;
 static size_t whenShalllist_find_fail;
 
@@ -84,8 +111,29 @@ static size_t whenShallCond_Init_fail;
 static size_t currentCond_Post_call;
 static size_t whenShallCond_Post_fail;
 
-static size_t currentThreadAPI_Create_call;
-static size_t whenShallThreadAPI_Create_fail;
+static size_t currentWorkerPool_Create_call;
+static size_t whenShallWorkerPool_Create_fail;
+
+static size_t currentWorkerPool_CreateStrand_call;
+static size_t whenShallWorkerPool_CreateStrand_fail;
+
+static size_t currentWorkerPool_Schedule_call;
+static size_t whenShallWorkerPool_Schedule_fail;
+
+static size_t currentRoutingTable_Create_call;
+static size_t whenShallRoutingTable_Create_fail;
+
+static size_t currentRoutingSnapshot_Create_call;
+static size_t whenShallRoutingSnapshot_Create_fail;
+
+/*a fake link filter is the address of its definition and passes every message but fake_filtered_message*/
+static MESSAGE_HANDLE fake_filtered_message;
+static size_t currentLinkFilter_Matches_call;
+static size_t currentLinkFilter_MatchesMessage_call;
+
+/*the content of every fake message*/
+static const unsigned char fake_content_bytes[] = { 1, 2, 3 };
+static const CONSTBUFFER fake_content = { fake_content_bytes, sizeof(fake_content_bytes) };
 
 typedef struct LIST_ITEM_INSTANCE_TAG
 {
@@ -101,9 +149,13 @@ typedef struct LIST_INSTANCE_TAG
 static size_t current_list_index;
 static const void *fake_list[10];
 
-static bool shouldThreadAPI_Create_invoke_callback;
-static THREAD_START_FUNC thread_func_to_call;
-static void* thread_func_args;
+static STRAND_FUNCTION strand_func_to_call;
+static void* strand_func_args;
+/*when set, a publisher waiting for room runs the strand created last if it was scheduled, as a worker would*/
+static bool run_strand_on_Condition_Wait;
+static size_t currentCondition_Wait_call;
+/*when not 0, Condition_Wait times out from that call on and is signaled before it*/
+static size_t whenShallCondition_Wait_time_out;
 
 struct FakeModule_Receive_Call_Status
 {
@@ -113,12 +165,6 @@ struct FakeModule_Receive_Call_Status
 };
 static FakeModule_Receive_Call_Status call_status_for_FakeModule_Receive;
 
-// intercept variables for Condition_Wait mock
-typedef COND_RESULT(*PFN_CONDITION_WAIT_INTERCEPT)(void);
-static bool shouldIntercept_Condition_Wait;
-static void* interceptArgs_for_Condition_Wait;
-static PFN_CONDITION_WAIT_INTERCEPT intercept_for_Condition_Wait;
-
 static MODULE_HANDLE fake_module_handle = (MODULE_HANDLE)0x42;
 static MODULE_HANDLE FakeModule_Create(BROKER_HANDLE broker, const void* configuration)
 {
@@ -149,6 +195,70 @@ MODULE fake_module =
     fake_module_handle
 };
 
+#define FAKE_BATCH_CALLS_SIZE 4
+static size_t FakeModule_ReceiveBatch_call_count;
+static size_t FakeModule_ReceiveBatch_counts[FAKE_BATCH_CALLS_SIZE];
+
+static MODULE_HANDLE fake_batch_module_handle = (MODULE_HANDLE)0x43;
+static void FakeModule_ReceiveBatch(MODULE_HANDLE module, MESSAGE_HANDLE* messageHandles, size_t messageCount)
+{
+    ASSERT_ARE_EQUAL(void_ptr, fake_batch_module_handle, module);
+    ASSERT_IS_NOT_NULL(messageHandles);
+    if (FakeModule_ReceiveBatch_call_count < FAKE_BATCH_CALLS_SIZE)
+    {
+        FakeModule_ReceiveBatch_counts[FakeModule_ReceiveBatch_call_count] = messageCount;
+    }
+    FakeModule_ReceiveBatch_call_count++;
+}
+
+static MODULE_APIS fake_batch_module_apis =
+{
+    FakeModule_Create,
+    FakeModule_Destroy,
+    FakeModule_Receive,
+    NULL,
+    FakeModule_ReceiveBatch
+};
+
+MODULE fake_batch_module =
+{
+    &fake_batch_module_apis,
+    fake_batch_module_handle
+};
+
+#define FAKE_OWNED_MESSAGES_SIZE 4
+static size_t FakeModule_ReceiveOwned_call_count;
+static MESSAGE_HANDLE FakeModule_ReceiveOwned_messages[FAKE_OWNED_MESSAGES_SIZE];
+
+static MODULE_HANDLE fake_owned_module_handle = (MODULE_HANDLE)0x44;
+static void FakeModule_ReceiveOwned(MODULE_HANDLE module, MESSAGE_HANDLE messageHandle)
+{
+    ASSERT_ARE_EQUAL(void_ptr, fake_owned_module_handle, module);
+    ASSERT_IS_NOT_NULL(messageHandle);
+    if (FakeModule_ReceiveOwned_call_count < FAKE_OWNED_MESSAGES_SIZE)
+    {
+        /*the test destroys the messages the module now owns*/
+        FakeModule_ReceiveOwned_messages[FakeModule_ReceiveOwned_call_count] = messageHandle;
+    }
+    FakeModule_ReceiveOwned_call_count++;
+}
+
+static MODULE_APIS fake_owned_module_apis =
+{
+    FakeModule_Create,
+    FakeModule_Destroy,
+    FakeModule_Receive,
+    NULL,
+    NULL,
+    FakeModule_ReceiveOwned
+};
+
+MODULE fake_owned_module =
+{
+    &fake_owned_module_apis,
+    fake_owned_module_handle
+};
+
 class RefCountObject
 {
 private:
@@ -173,6 +283,13 @@ public:
     }
 };
 
+/*a fake MESSAGE_BATCH_HANDLE*/
+typedef struct FAKE_MESSAGE_BATCH_TAG
+{
+    MESSAGE_HANDLE messages[2];
+    size_t count;
+} FAKE_MESSAGE_BATCH;
+
 TYPED_MOCK_CLASS(CBrokerMocks, CGlobalMock)
 {
 public:
@@ -263,9 +380,15 @@ public:
 
     MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds)
         auto result2 = COND_OK;
-        if (shouldIntercept_Condition_Wait == true)
+        ++currentCondition_Wait_call;
+        if ((whenShallCondition_Wait_time_out > 0) &&
+            (currentCondition_Wait_call >= whenShallCondition_Wait_time_out))
         {
-            result2 = intercept_for_Condition_Wait();
+            result2 = COND_TIMEOUT;
+        }
+        if (run_strand_on_Condition_Wait && currentWorkerPool_Schedule_call > 0)
+        {
+            strand_func_to_call(strand_func_args);
         }
     MOCK_METHOD_END(COND_RESULT, result2)
 
@@ -339,34 +462,205 @@ public:
         size_t result2 = BASEIMPLEMENTATION::VECTOR_size(vector);
     MOCK_METHOD_END(size_t, result2)
 
-    MOCK_STATIC_METHOD_3(, THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg)
-        THREADAPI_RESULT result2;
-        ++currentThreadAPI_Create_call;
-        if ((whenShallThreadAPI_Create_fail > 0) &&
-            (currentThreadAPI_Create_call == whenShallThreadAPI_Create_fail))
+    // message_queue.h
+    // the fake message queue is a VECTOR of MESSAGE_HANDLEs behind one level
+    // of indirection so that two queues can be swapped
+    MOCK_STATIC_METHOD_0(, MESSAGE_QUEUE_HANDLE, MessageQueue_Create)
+        MESSAGE_QUEUE_HANDLE result2;
+        ++currentMessageQueue_Create_call;
+        if ((whenShallMessageQueue_Create_fail > 0) &&
+            (currentMessageQueue_Create_call == whenShallMessageQueue_Create_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            VECTOR_HANDLE* queue = (VECTOR_HANDLE*)malloc(sizeof(VECTOR_HANDLE));
+            *queue = BASEIMPLEMENTATION::VECTOR_create(sizeof(MESSAGE_HANDLE));
+            result2 = (MESSAGE_QUEUE_HANDLE)queue;
+        }
+    MOCK_METHOD_END(MESSAGE_QUEUE_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, MessageQueue_Destroy, MESSAGE_QUEUE_HANDLE, queue)
+        BASEIMPLEMENTATION::VECTOR_destroy(*(VECTOR_HANDLE*)queue);
+        free(queue);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, int, MessageQueue_Push, MESSAGE_QUEUE_HANDLE, queue, MESSAGE_HANDLE, message)
+        int result2;
+        ++currentMessageQueue_Push_call;
+        if ((whenShallMessageQueue_Push_fail > 0) &&
+            (currentMessageQueue_Push_call == whenShallMessageQueue_Push_fail))
         {
-            result2 = THREADAPI_ERROR;
+            result2 = __LINE__;
         }
         else
         {
-            *threadHandle = (THREAD_HANDLE*)malloc(3);
-            thread_func_to_call = func;
-            thread_func_args = arg;
+            result2 = BASEIMPLEMENTATION::VECTOR_push_back(*(VECTOR_HANDLE*)queue, &message, 1);
+        }
+    MOCK_METHOD_END(int, result2)
 
-            result2 = THREADAPI_OK;
-            if (shouldThreadAPI_Create_invoke_callback == true)
-            {
-                func(arg);
-            }
-        
-        
+    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, MessageQueue_Pop, MESSAGE_QUEUE_HANDLE, queue)
+        MESSAGE_HANDLE result2;
+        VECTOR_HANDLE vector = *(VECTOR_HANDLE*)queue;
+        if (BASEIMPLEMENTATION::VECTOR_size(vector) == 0)
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            MESSAGE_HANDLE* front = (MESSAGE_HANDLE*)BASEIMPLEMENTATION::VECTOR_front(vector);
+            result2 = *front;
+            BASEIMPLEMENTATION::VECTOR_erase(vector, front, 1);
+        }
+    MOCK_METHOD_END(MESSAGE_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, size_t, MessageQueue_Size, MESSAGE_QUEUE_HANDLE, queue)
+        size_t result2 = BASEIMPLEMENTATION::VECTOR_size(*(VECTOR_HANDLE*)queue);
+    MOCK_METHOD_END(size_t, result2)
+
+    MOCK_STATIC_METHOD_2(, void, MessageQueue_Swap, MESSAGE_QUEUE_HANDLE, queue1, MESSAGE_QUEUE_HANDLE, queue2)
+        VECTOR_HANDLE temp = *(VECTOR_HANDLE*)queue1;
+        *(VECTOR_HANDLE*)queue1 = *(VECTOR_HANDLE*)queue2;
+        *(VECTOR_HANDLE*)queue2 = temp;
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_1(, WORKER_POOL_HANDLE, WorkerPool_Create, size_t, worker_count)
+        WORKER_POOL_HANDLE result2;
+        ++currentWorkerPool_Create_call;
+        if ((whenShallWorkerPool_Create_fail > 0) &&
+            (currentWorkerPool_Create_call == whenShallWorkerPool_Create_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = (WORKER_POOL_HANDLE)malloc(3);
+        }
+    MOCK_METHOD_END(WORKER_POOL_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, WorkerPool_Destroy, WORKER_POOL_HANDLE, pool)
+        free(pool);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_3(, STRAND_HANDLE, WorkerPool_CreateStrand, WORKER_POOL_HANDLE, pool, STRAND_FUNCTION, function, void*, context)
+        STRAND_HANDLE result2;
+        ++currentWorkerPool_CreateStrand_call;
+        if ((whenShallWorkerPool_CreateStrand_fail > 0) &&
+            (currentWorkerPool_CreateStrand_call == whenShallWorkerPool_CreateStrand_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = (STRAND_HANDLE)malloc(4);
+            strand_func_to_call = function;
+            strand_func_args = context;
+        }
+    MOCK_METHOD_END(STRAND_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, int, WorkerPool_Schedule, STRAND_HANDLE, strand)
+        int result2;
+        ++currentWorkerPool_Schedule_call;
+        if ((whenShallWorkerPool_Schedule_fail > 0) &&
+            (currentWorkerPool_Schedule_call == whenShallWorkerPool_Schedule_fail))
+        {
+            result2 = __LINE__;
+        }
+        else
+        {
+            result2 = 0;
         }
-    MOCK_METHOD_END(THREADAPI_RESULT, result2)
+    MOCK_METHOD_END(int, result2)
+
+    MOCK_STATIC_METHOD_1(, void, WorkerPool_DestroyStrand, STRAND_HANDLE, strand)
+        free(strand);
+    MOCK_VOID_METHOD_END()
+
+    // routing_table.h
+    MOCK_STATIC_METHOD_0(, ROUTING_TABLE_HANDLE, RoutingTable_Create)
+        ROUTING_TABLE_HANDLE result2;
+        ++currentRoutingTable_Create_call;
+        if ((whenShallRoutingTable_Create_fail > 0) &&
+            (currentRoutingTable_Create_call == whenShallRoutingTable_Create_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = BASEIMPLEMENTATION::RoutingTable_Create();
+        }
+    MOCK_METHOD_END(ROUTING_TABLE_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, RoutingTable_Destroy, ROUTING_TABLE_HANDLE, table)
+        BASEIMPLEMENTATION::RoutingTable_Destroy(table);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, void, RoutingTable_Swap, ROUTING_TABLE_HANDLE, table, ROUTING_SNAPSHOT_HANDLE, snapshot)
+        BASEIMPLEMENTATION::RoutingTable_Swap(table, snapshot);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_1(, ROUTING_SNAPSHOT_HANDLE, RoutingTable_Acquire, ROUTING_TABLE_HANDLE, table)
+        ROUTING_SNAPSHOT_HANDLE result2 = BASEIMPLEMENTATION::RoutingTable_Acquire(table);
+    MOCK_METHOD_END(ROUTING_SNAPSHOT_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_2(, void, RoutingTable_Release, ROUTING_TABLE_HANDLE, table, ROUTING_SNAPSHOT_HANDLE, snapshot)
+        BASEIMPLEMENTATION::RoutingTable_Release(table, snapshot);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, ROUTING_SNAPSHOT_HANDLE, RoutingSnapshot_Create, size_t, entry_count, size_t, sink_count)
+        ROUTING_SNAPSHOT_HANDLE result2;
+        ++currentRoutingSnapshot_Create_call;
+        if ((whenShallRoutingSnapshot_Create_fail > 0) &&
+            (currentRoutingSnapshot_Create_call == whenShallRoutingSnapshot_Create_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = BASEIMPLEMENTATION::RoutingSnapshot_Create(entry_count, sink_count);
+        }
+    MOCK_METHOD_END(ROUTING_SNAPSHOT_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, RoutingSnapshot_Destroy, ROUTING_SNAPSHOT_HANDLE, snapshot)
+        BASEIMPLEMENTATION::RoutingSnapshot_Destroy(snapshot);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_4(, ROUTING_SINK*, RoutingSnapshot_AddEntry, ROUTING_SNAPSHOT_HANDLE, snapshot, const void*, key, void*, module, size_t, sink_count)
+        ROUTING_SINK* result2 = BASEIMPLEMENTATION::RoutingSnapshot_AddEntry(snapshot, key, module, sink_count);
+    MOCK_METHOD_END(ROUTING_SINK*, result2)
+
+    MOCK_STATIC_METHOD_2(, const ROUTING_ENTRY*, RoutingSnapshot_Find, ROUTING_SNAPSHOT_HANDLE, snapshot, const void*, key)
+        const ROUTING_ENTRY* result2 = BASEIMPLEMENTATION::RoutingSnapshot_Find(snapshot, key);
+    MOCK_METHOD_END(const ROUTING_ENTRY*, result2)
+
+    MOCK_STATIC_METHOD_2(, const ROUTING_ENTRY*, RoutingSnapshot_GetEntries, ROUTING_SNAPSHOT_HANDLE, snapshot, size_t*, entry_count)
+        const ROUTING_ENTRY* result2 = BASEIMPLEMENTATION::RoutingSnapshot_GetEntries(snapshot, entry_count);
+    MOCK_METHOD_END(const ROUTING_ENTRY*, result2)
+
+    // link_filter.h
+
+    MOCK_STATIC_METHOD_1(, LINK_FILTER_HANDLE, LinkFilter_Create, const BROKER_LINK_FILTER*, definition)
+    MOCK_METHOD_END(LINK_FILTER_HANDLE, (LINK_FILTER_HANDLE)definition)
+
+    MOCK_STATIC_METHOD_1(, void, LinkFilter_Destroy, LINK_FILTER_HANDLE, filter)
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, int, LinkFilter_IsSameAs, LINK_FILTER_HANDLE, filter, const BROKER_LINK_FILTER*, definition)
+    MOCK_METHOD_END(int, (filter == (LINK_FILTER_HANDLE)definition) ? 1 : 0)
+
+    MOCK_STATIC_METHOD_2(, int, LinkFilter_Matches, LINK_FILTER_HANDLE, filter, MESSAGE_HANDLE, message)
+        ++currentLinkFilter_Matches_call;
+    MOCK_METHOD_END(int, (filter == NULL || message != fake_filtered_message) ? 1 : 0)
+
+    MOCK_STATIC_METHOD_2(, void, LinkFilter_InitMessage, LINK_FILTER_MESSAGE*, filter_message, MESSAGE_HANDLE, message)
+        filter_message->message = message;
+        filter_message->property_count = 0;
+    MOCK_VOID_METHOD_END()
 
-    MOCK_STATIC_METHOD_2(, THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res)
-        free(threadHandle);
-        auto result2 = THREADAPI_OK;
-    MOCK_METHOD_END(THREADAPI_RESULT, result2)
+    MOCK_STATIC_METHOD_2(, int, LinkFilter_MatchesMessage, LINK_FILTER_HANDLE, filter, LINK_FILTER_MESSAGE*, filter_message)
+        ++currentLinkFilter_MatchesMessage_call;
+    MOCK_METHOD_END(int, (filter == NULL || filter_message->message != fake_filtered_message) ? 1 : 0)
 
     MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg)
         MESSAGE_HANDLE result2 = (MESSAGE_HANDLE)(new RefCountObject());
@@ -380,6 +674,15 @@ public:
         ((RefCountObject*)message)->dec_ref();
     MOCK_VOID_METHOD_END()
 
+    MOCK_STATIC_METHOD_1(, const CONSTBUFFER*, Message_GetContent, MESSAGE_HANDLE, message)
+    MOCK_METHOD_END(const CONSTBUFFER*, &fake_content)
+
+    MOCK_STATIC_METHOD_1(, size_t, MessageBatch_GetCount, MESSAGE_BATCH_HANDLE, batch)
+    MOCK_METHOD_END(size_t, ((FAKE_MESSAGE_BATCH*)batch)->count)
+
+    MOCK_STATIC_METHOD_1(, const MESSAGE_HANDLE*, MessageBatch_GetMessages, MESSAGE_BATCH_HANDLE, batch)
+    MOCK_METHOD_END(const MESSAGE_HANDLE*, ((FAKE_MESSAGE_BATCH*)batch)->messages)
+
     // list.h
 
     MOCK_STATIC_METHOD_0(, LIST_HANDLE, list_create)
@@ -430,7 +733,19 @@ public:
         }
         else
         {
-            /* do I need anything more compicated here? */
+            /* the routing snapshot is rebuilt from the list, so the item has to go */
+            for (size_t i = 0; i < current_list_index; i++)
+            {
+                if (fake_list[i] == (const void*)item)
+                {
+                    for (size_t j = i; j + 1 < current_list_index; j++)
+                    {
+                        fake_list[j] = fake_list[j + 1];
+                    }
+                    fake_list[--current_list_index] = NULL;
+                    break;
+                }
+            }
             result2 = 0;
         }
 
@@ -483,7 +798,8 @@ public:
                 result1 = NULL;
                 for (size_t i = 0; i < current_list_index; i++)
                 {
-                    if ((void*)fake_list[i] == (void*)match_context)
+                    if (((void*)fake_list[i] == (void*)match_context) ||
+                        (match_function((LIST_ITEM_HANDLE)fake_list[i], match_context)))
                     {
                         result1 = (LIST_ITEM_HANDLE)fake_list[i];
                         break;
@@ -524,17 +840,48 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void*, VECTOR_back, VECTOR_HANDLE,
 DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , void*, VECTOR_find_if, VECTOR_HANDLE, vector, PREDICATE_FUNCTION, pred, const void*, value);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , size_t, VECTOR_size, VECTOR_HANDLE, vector);
 
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , MESSAGE_QUEUE_HANDLE, MessageQueue_Create);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, MessageQueue_Destroy, MESSAGE_QUEUE_HANDLE, queue);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, MessageQueue_Push, MESSAGE_QUEUE_HANDLE, queue, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, MessageQueue_Pop, MESSAGE_QUEUE_HANDLE, queue);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , size_t, MessageQueue_Size, MESSAGE_QUEUE_HANDLE, queue);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , void, MessageQueue_Swap, MESSAGE_QUEUE_HANDLE, queue1, MESSAGE_QUEUE_HANDLE, queue2);
+
 DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , COND_HANDLE, Condition_Init);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , COND_RESULT, Condition_Post, COND_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, Condition_Deinit, COND_HANDLE, handle);
 
-DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg);
-DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , WORKER_POOL_HANDLE, WorkerPool_Create, size_t, worker_count);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, WorkerPool_Destroy, WORKER_POOL_HANDLE, pool);
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , STRAND_HANDLE, WorkerPool_CreateStrand, WORKER_POOL_HANDLE, pool, STRAND_FUNCTION, function, void*, context);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , int, WorkerPool_Schedule, STRAND_HANDLE, strand);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, WorkerPool_DestroyStrand, STRAND_HANDLE, strand);
+
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , ROUTING_TABLE_HANDLE, RoutingTable_Create);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, RoutingTable_Destroy, ROUTING_TABLE_HANDLE, table);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , void, RoutingTable_Swap, ROUTING_TABLE_HANDLE, table, ROUTING_SNAPSHOT_HANDLE, snapshot);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , ROUTING_SNAPSHOT_HANDLE, RoutingTable_Acquire, ROUTING_TABLE_HANDLE, table);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , void, RoutingTable_Release, ROUTING_TABLE_HANDLE, table, ROUTING_SNAPSHOT_HANDLE, snapshot);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , ROUTING_SNAPSHOT_HANDLE, RoutingSnapshot_Create, size_t, entry_count, size_t, sink_count);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, RoutingSnapshot_Destroy, ROUTING_SNAPSHOT_HANDLE, snapshot);
+DECLARE_GLOBAL_MOCK_METHOD_4(CBrokerMocks, , ROUTING_SINK*, RoutingSnapshot_AddEntry, ROUTING_SNAPSHOT_HANDLE, snapshot, const void*, key, void*, module, size_t, sink_count);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , const ROUTING_ENTRY*, RoutingSnapshot_Find, ROUTING_SNAPSHOT_HANDLE, snapshot, const void*, key);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , const ROUTING_ENTRY*, RoutingSnapshot_GetEntries, ROUTING_SNAPSHOT_HANDLE, snapshot, size_t*, entry_count);
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LINK_FILTER_HANDLE, LinkFilter_Create, const BROKER_LINK_FILTER*, definition);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, LinkFilter_Destroy, LINK_FILTER_HANDLE, filter);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, LinkFilter_IsSameAs, LINK_FILTER_HANDLE, filter, const BROKER_LINK_FILTER*, definition);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, LinkFilter_Matches, LINK_FILTER_HANDLE, filter, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , void, LinkFilter_InitMessage, LINK_FILTER_MESSAGE*, filter_message, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, LinkFilter_MatchesMessage, LINK_FILTER_HANDLE, filter, LINK_FILTER_MESSAGE*, filter_message);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, Message_Destroy, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , const CONSTBUFFER*, Message_GetContent, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , size_t, MessageBatch_GetCount, MESSAGE_BATCH_HANDLE, batch);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , const MESSAGE_HANDLE*, MessageBatch_GetMessages, MESSAGE_BATCH_HANDLE, batch);
 
 // list.h
 DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , LIST_HANDLE, list_create);
@@ -546,6 +893,36 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LIST_ITEM_HANDLE, list_get_next_ite
 DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , LIST_ITEM_HANDLE, list_find, LIST_HANDLE, list, LIST_MATCH_FUNCTION, match_function, const void*, match_context);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , const void*, list_item_get_value, LIST_ITEM_HANDLE, item_handle);
 
+/*expectations for rebuilding the routing snapshot of a broker with module_count modules, of which
+modules_with_routes have a route vector, and sink_count routes in total; the routes are counted twice
+before they are copied to the snapshot*/
+static void expectRoutingSnapshotRebuild(CBrokerMocks &mocks, size_t module_count, size_t modules_with_routes, size_t sink_count)
+{
+    EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    if (module_count > 0)
+    {
+        EXPECTED_CALL(mocks, list_get_next_item(IGNORED_PTR_ARG))
+            .ExpectedTimesExactly(2 * module_count);
+        EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+            .ExpectedTimesExactly(2 * module_count);
+        EXPECTED_CALL(mocks, RoutingSnapshot_AddEntry(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+            .ExpectedTimesExactly(module_count);
+    }
+    if (modules_with_routes > 0)
+    {
+        EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+            .ExpectedTimesExactly(3 * modules_with_routes);
+    }
+    if (sink_count > 0)
+    {
+        EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+            .ExpectedTimesExactly(3 * sink_count);
+    }
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_Create(module_count, sink_count));
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Swap(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+}
 
 BEGIN_TEST_SUITE(broadcast_bus_ut)
 
@@ -581,6 +958,12 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     currentVECTOR_find_if_call = 0;
     whenShallVECTOR_find_if_fail = 0;
 
+    currentMessageQueue_Create_call = 0;
+    whenShallMessageQueue_Create_fail = 0;
+
+    currentMessageQueue_Push_call = 0;
+    whenShallMessageQueue_Push_fail = 0;
+
     currentLock_Init_call = 0;
     whenShallLock_Init_fail = 0;
 
@@ -604,8 +987,24 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     currentCond_Post_call = 0;
     whenShallCond_Post_fail = 0;
 
-    currentThreadAPI_Create_call = 0;
-    whenShallThreadAPI_Create_fail = 0;
+    currentWorkerPool_Create_call = 0;
+    whenShallWorkerPool_Create_fail = 0;
+
+    currentWorkerPool_CreateStrand_call = 0;
+    whenShallWorkerPool_CreateStrand_fail = 0;
+
+    currentWorkerPool_Schedule_call = 0;
+    whenShallWorkerPool_Schedule_fail = 0;
+
+    currentRoutingTable_Create_call = 0;
+    whenShallRoutingTable_Create_fail = 0;
+
+    currentRoutingSnapshot_Create_call = 0;
+    whenShallRoutingSnapshot_Create_fail = 0;
+    currentLinkFilter_Matches_call = 0;
+    currentLinkFilter_MatchesMessage_call = 0;
+
+    fake_filtered_message = NULL;
 
     current_list_index = 0;
     for (int l = 0; l < 10; l++)
@@ -613,16 +1012,26 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
         fake_list[l] = NULL;
     }
 
-    shouldThreadAPI_Create_invoke_callback = false;
-    thread_func_to_call = NULL;
-    thread_func_args = NULL;
-
-    shouldIntercept_Condition_Wait = false;
-    interceptArgs_for_Condition_Wait = NULL;
-    intercept_for_Condition_Wait = NULL;
+    strand_func_to_call = NULL;
+    strand_func_args = NULL;
+    run_strand_on_Condition_Wait = false;
+    currentCondition_Wait_call = 0;
+    whenShallCondition_Wait_time_out = 0;
 
     call_status_for_FakeModule_Receive.messageHandle = NULL;
     call_status_for_FakeModule_Receive.module = NULL;
+
+    FakeModule_ReceiveBatch_call_count = 0;
+    for (int b = 0; b < FAKE_BATCH_CALLS_SIZE; b++)
+    {
+        FakeModule_ReceiveBatch_counts[b] = 0;
+    }
+
+    FakeModule_ReceiveOwned_call_count = 0;
+    for (int o = 0; o < FAKE_OWNED_MESSAGES_SIZE; o++)
+    {
+        FakeModule_ReceiveOwned_messages[o] = NULL;
+    }
     call_status_for_FakeModule_Receive.was_called = false;
 }
 
@@ -637,6 +1046,9 @@ TEST_FUNCTION_CLEANUP(TestMethodCleanup)
 //Tests_SRS_BCAST_BROKER_13_001: [This API shall yield a BROKER_HANDLE representing the newly created message broker. This handle value shall not be equal to NULL when the API call is successful.]
 //Tests_SRS_BCAST_BROKER_13_007: [Broker_Create shall initialize BROKER_HANDLE_DATA::modules with a valid VECTOR_HANDLE.]
 //Tests_SRS_BCAST_BROKER_13_023: [Broker_Create shall initialize BROKER_HANDLE_DATA::modules_lock with a valid LOCK_HANDLE.]
+//Tests_SRS_BCAST_BROKER_13_142: [Broker_Create shall behave as Broker_CreateWithOptions called with NULL options.]
+//Tests_SRS_BCAST_BROKER_13_143: [Broker_CreateWithOptions shall initialize BROKER_HANDLE_DATA::worker_pool by calling WorkerPool_Create with options->worker_count, or 0 when options is NULL.]
+//Tests_SRS_BCAST_BROKER_13_152: [Broker_CreateWithOptions shall initialize BROKER_HANDLE_DATA::routing_table by calling RoutingTable_Create.]
 TEST_FUNCTION(Broker_Create_succeeds)
 {
     ///arrange
@@ -646,6 +1058,8 @@ TEST_FUNCTION(Broker_Create_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, list_create());
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Create(0));
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Create());
 
     ///act
     auto r = Broker_Create();
@@ -727,6 +1141,92 @@ TEST_FUNCTION(Broker_Create_fails_when_Lock_Init_fails)
     ///cleanup
 }
 
+//Tests_SRS_BCAST_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
+TEST_FUNCTION(Broker_Create_fails_when_WorkerPool_Create_fails)
+{
+    ///arrange
+
+    CBrokerMocks mocks;
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_create());
+    STRICT_EXPECTED_CALL(mocks, list_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShallWorkerPool_Create_fail = 1;
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Create(0));
+
+    ///act
+    auto r = Broker_Create();
+
+    ///assert
+    ASSERT_IS_NULL(r);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_BCAST_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
+TEST_FUNCTION(Broker_Create_fails_when_RoutingTable_Create_fails)
+{
+    ///arrange
+
+    CBrokerMocks mocks;
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_create());
+    STRICT_EXPECTED_CALL(mocks, list_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Create(0));
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShallRoutingTable_Create_fail = 1;
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Create());
+
+    ///act
+    auto r = Broker_Create();
+
+    ///assert
+    ASSERT_IS_NULL(r);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_BCAST_BROKER_13_143: [Broker_CreateWithOptions shall initialize BROKER_HANDLE_DATA::worker_pool by calling WorkerPool_Create with options->worker_count, or 0 when options is NULL.]
+TEST_FUNCTION(Broker_CreateWithOptions_creates_the_requested_number_of_workers)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_OPTIONS options = { 3 };
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_create());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Create(3));
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Create());
+
+    ///act
+    auto r = Broker_CreateWithOptions(&options);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(r);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(r);
+}
+
 //Tests_SRS_BCAST_BROKER_99_013: [If `broker` or `module` is `NULL` the function shall return `BROKER_INVALIDARG`.]
 TEST_FUNCTION(Broker_AddModule_fails_with_null_broker)
 {
@@ -827,7 +1327,8 @@ TEST_FUNCTION(Broker_AddModule_fails_when_alloc_module_info_fails)
     Broker_Destroy(broker);
 }
 
-TEST_FUNCTION(Broker_AddModule_fails_when_VECTOR_create_fails)
+//Tests_SRS_BCAST_BROKER_13_098: [The function shall initialize BROKER_MODULEINFO::mq and BROKER_MODULEINFO::delivery_mq with valid message queue handles.]
+TEST_FUNCTION(Broker_AddModule_fails_when_MessageQueue_Create_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -842,9 +1343,8 @@ TEST_FUNCTION(Broker_AddModule_fails_when_VECTOR_create_fails)
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    whenShallVECTOR_create_fail = currentVECTOR_create_call + 1;
-    STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
+    whenShallMessageQueue_Create_fail = currentMessageQueue_Create_call + 1;
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
@@ -859,8 +1359,8 @@ TEST_FUNCTION(Broker_AddModule_fails_when_VECTOR_create_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BCAST_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_when_Lock_Init_fails)
+//Tests_SRS_BCAST_BROKER_13_098: [The function shall initialize BROKER_MODULEINFO::mq and BROKER_MODULEINFO::delivery_mq with valid message queue handles.]
+TEST_FUNCTION(Broker_AddModule_fails_when_second_MessageQueue_Create_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -868,18 +1368,18 @@ TEST_FUNCTION(Broker_AddModule_fails_when_Lock_Init_fails)
     mocks.ResetAllCalls();
 
     // this is for the Broker_AddModule call
-    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
-        .IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module*/
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    whenShallMessageQueue_Create_fail = currentMessageQueue_Create_call + 2;
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    whenShallLock_Init_fail = currentLock_Init_call + 1;
-    STRICT_EXPECTED_CALL(mocks, Lock_Init());
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
@@ -895,7 +1395,7 @@ TEST_FUNCTION(Broker_AddModule_fails_when_Lock_Init_fails)
 }
 
 //Tests_SRS_BCAST_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_when_Condition_Init_fails)
+TEST_FUNCTION(Broker_AddModule_fails_when_Lock_Init_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -909,20 +1409,61 @@ TEST_FUNCTION(Broker_AddModule_fails_when_Condition_Init_fails)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    whenShallLock_Init_fail = currentLock_Init_call + 1;
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+//Tests_SRS_BCAST_BROKER_13_136: [If the queue is bounded and the policy is BROKER_QUEUE_BLOCK, the function shall initialize BROKER_MODULEINFO::space_cond with a valid condition handle.]
+TEST_FUNCTION(Broker_AddModuleWithOptions_fails_when_Condition_Init_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_BLOCK, 10 } };
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_AddModule call
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module*/
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 	whenShallCond_Init_fail = 1;
     STRICT_EXPECTED_CALL(mocks, Condition_Init());
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
     ///act
-    auto result = Broker_AddModule(broker, &fake_module);
+    auto result = Broker_AddModuleWithOptions(broker, &fake_module, &options);
 
     ///assert
     ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
@@ -947,9 +1488,11 @@ TEST_FUNCTION(Broker_AddModule_fails_when_list_add_fails)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
@@ -960,9 +1503,6 @@ TEST_FUNCTION(Broker_AddModule_fails_when_list_add_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Init());
-    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     whenShalllist_add_fail = 1;
     STRICT_EXPECTED_CALL(mocks, list_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
@@ -979,7 +1519,7 @@ TEST_FUNCTION(Broker_AddModule_fails_when_list_add_fails)
 }
 
 //Tests_SRS_BCAST_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
+TEST_FUNCTION(Broker_AddModule_fails_when_WorkerPool_CreateStrand_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -993,9 +1533,11 @@ TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
@@ -1006,15 +1548,12 @@ TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Init());
-    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, list_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, list_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    whenShallThreadAPI_Create_fail = 1;
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    whenShallWorkerPool_CreateStrand_fail = 1;
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_CreateStrand(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
 
     ///act
@@ -1043,9 +1582,11 @@ TEST_FUNCTION(Broker_AddModule_fails_when_lock_on_modules_lock_fails)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
     whenShallLock_fail = 1;
@@ -1055,9 +1596,6 @@ TEST_FUNCTION(Broker_AddModule_fails_when_lock_on_modules_lock_fails)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Init());
-    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     ///act
     auto result = Broker_AddModule(broker, &fake_module);
@@ -1075,13 +1613,14 @@ TEST_FUNCTION(Broker_AddModule_fails_when_lock_on_modules_lock_fails)
 //Tests_SRS_BCAST_BROKER_13_107 : [The function shall assign the module handle to BROKER_MODULEINFO::module.]
 //Tests_SRS_BCAST_BROKER_13_098 : [The function shall initialize BROKER_MODULEINFO::mq with a valid vector handle.]
 //Tests_SRS_BCAST_BROKER_13_099 : [The function shall initialize BROKER_MODULEINFO::mq_lock with a valid lock handle.]
-//Tests_SRS_BCAST_BROKER_13_100 : [The function shall initialize BROKER_MODULEINFO::mq_cond with a valid condition handle.]
 //Tests_SRS_BCAST_BROKER_13_101 : [ The function shall assign 0 to BROKER_MODULEINFO::quit_worker. ]
-//Tests_SRS_BCAST_BROKER_13_102 : [The function shall create a new thread for the module by calling ThreadAPI_Create using module_publish_worker as the thread callback and using the newly allocated BROKER_MODULEINFO object as the thread context.]
+//Tests_SRS_BCAST_BROKER_13_102 : [The function shall create a strand for the module on BROKER_HANDLE_DATA::worker_pool by calling WorkerPool_CreateStrand using module_publish_worker as the strand function and using the newly allocated BROKER_MODULEINFO object as the strand context.]
 //Tests_SRS_BCAST_BROKER_13_039 : [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]
 //Tests_SRS_BCAST_BROKER_13_045 : [Broker_AddModule shall append the new instance of BROKER_MODULEINFO to BROKER_HANDLE_DATA::modules.]
 //Tests_SRS_BCAST_BROKER_13_046 : [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]
 //Tests_SRS_BCAST_BROKER_13_047 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+//Tests_SRS_BCAST_BROKER_13_153: [The broker shall rebuild its routing snapshot by calling RoutingSnapshot_Create and RoutingSnapshot_AddEntry with every module of BROKER_HANDLE_DATA::modules, in order, and the sinks of its routes, and install it by calling RoutingTable_Swap.]
+//Tests_SRS_BCAST_BROKER_13_154: [Broker_AddModule shall rebuild the broker's routing snapshot, and remove and free the module and return BROKER_ERROR if it fails.]
 TEST_FUNCTION(Broker_AddModule_succeeds)
 {
     ///arrange
@@ -1094,8 +1633,8 @@ TEST_FUNCTION(Broker_AddModule_succeeds)
         .IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module*/
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
     STRICT_EXPECTED_CALL(mocks, list_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
@@ -1103,9 +1642,9 @@ TEST_FUNCTION(Broker_AddModule_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Init());
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_CreateStrand(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
+    expectRoutingSnapshotRebuild(mocks, 1, 0, 0);
 
     ///act
     auto result = Broker_AddModule(broker, &fake_module);
@@ -1119,160 +1658,63 @@ TEST_FUNCTION(Broker_AddModule_succeeds)
     Broker_Destroy(broker);
 }
 
-struct Condition_Wait_Callback_Input
+//Tests_SRS_BCAST_BROKER_13_154: [Broker_AddModule shall rebuild the broker's routing snapshot, and remove and free the module and return BROKER_ERROR if it fails.]
+TEST_FUNCTION(Broker_AddModule_fails_when_RoutingSnapshot_Create_fails)
 {
-    BROKER_HANDLE broker;
-    MESSAGE_HANDLE message;
-};
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
 
-static COND_RESULT module_publish_worker_calls_module_receive_Condition_Wait2(void)
-{
-    Condition_Wait_Callback_Input* input = (Condition_Wait_Callback_Input*)interceptArgs_for_Condition_Wait;
+    whenShallRoutingSnapshot_Create_fail = 1;
 
-    // cause the worker to quit during the next iteration;
-    // first we get the modules vector from the broker handle
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
 
-    // We added one module for the test, that's our fake list...
-    unsigned char* module_info = (unsigned char*)fake_list[0];
-    sig_atomic_t* quit_worker = (sig_atomic_t*)(module_info + BROKER_offsetof_quit_worker);
-    *quit_worker = 1;
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    ASSERT_ARE_EQUAL(size_t, 0, current_list_index);
+    ASSERT_ARE_EQUAL(size_t, 1, currentRoutingSnapshot_Create_call);
 
-    return COND_OK;
+    ///cleanup
+    Broker_Destroy(broker);
 }
 
-static COND_RESULT module_publish_worker_calls_module_receive_Condition_Wait(void)
+//Tests_SRS_BCAST_BROKER_13_138: [If `options` is not NULL and its queue policy is not a BROKER_QUEUE_POLICY value, or is BROKER_QUEUE_BLOCK with a block_timeout_ms of 0, the function shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_AddModuleWithOptions_fails_when_block_policy_has_no_timeout)
 {
-    // publish a message to the broker
-    Condition_Wait_Callback_Input* input = (Condition_Wait_Callback_Input*)interceptArgs_for_Condition_Wait;
-    auto result = Broker_Publish(input->broker, NULL, input->message);
-    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_BLOCK, 0 } };
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_AddModuleWithOptions(broker, &fake_module, &options);
 
-    // schedule module_publish_worker_calls_module_receive_Condition_Wait2 to be
-    // called during the next intercept of the Condition_Wait mock
-    intercept_for_Condition_Wait = module_publish_worker_calls_module_receive_Condition_Wait2;
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
 
-    return COND_OK;
+    ///cleanup
+    Broker_Destroy(broker);
 }
 
-// Tests_SRS_BCAST_BROKER_13_089: [ This function shall acquire the lock on module_info->mq_lock. ]
-// Tests_SRS_BCAST_BROKER_13_068: [ This function shall run a loop that keeps running while module_info->quit_worker is equal to 0. ]
-// Tests_SRS_BCAST_BROKER_13_071: [ For every iteration of the loop the function will first wait on module_info->mq_cond using module_info->mq_lock as the corresponding mutex to be used by the condition variable. ]
-// Tests_SRS_BCAST_BROKER_13_090: [ When module_info->mq_cond has been signaled this function shall kick off another loop predicated on module_info->quit_worker being equal to 0 and module_info->mq not being empty. This thread has the lock on module_info->mq_lock at this point. ]
-// Tests_SRS_BCAST_BROKER_13_069: [ The function shall dequeue a message from the module's message queue. ]
-// Tests_SRS_BCAST_BROKER_13_091: [ The function shall unlock module_info->mq_lock. ]
-// Tests_SRS_BCAST_BROKER_13_092: [ The function shall deliver the message to the module's callback function via module_info->module_apis. ]
-// Tests_SRS_BCAST_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]
-// Tests_SRS_BCAST_BROKER_13_094: [ The function shall re-acquire the lock on module_info->mq_lock. ]
-// Tests_SRS_BCAST_BROKER_13_095: [ When the function exits the outer loop predicated on module_info->quit_worker being 0 it shall unlock module_info->mq_lock before exiting from the function. ]
-// Tests_SRS_BCAST_BROKER_13_026: [ This function shall assign user_data to a local variable called module_info of type BROKER_MODULEINFO*. ]
-// Tests_SRS_BCAST_BROKER_04_001: [** This function shall immediately start processing messages when `module->mq` is not empty without waiting on `module->mq_cond`.]
-TEST_FUNCTION(module_publish_worker_calls_module_receive)
+//Tests_SRS_BCAST_BROKER_13_136: [If the queue is bounded and the policy is BROKER_QUEUE_BLOCK, the function shall initialize BROKER_MODULEINFO::space_cond with a valid condition handle.]
+TEST_FUNCTION(Broker_AddModuleWithOptions_with_block_policy_succeeds)
 {
-    /**
-    * This test warrants some documentation as to how it works because
-    * we are going to great lengths here to test threaded code without
-    * using threads. Here's what happens:
-    *
-    *  [1] The `ThreadAPI_Create` mock will directly call the callback
-    *      function when `shouldThreadAPI_Create_invoke_callback` is `true`.
-    *      We set this variable to `true` in this test.
-    *
-    *  [2] We call `Broker_AddModule` in this test. That function will eventually
-    *      call `ThreadAPI_Create`. `ThreadAPI_Create` will call the
-    *      `module_publish_worker` function which, among other things, will
-    *      call `Condition_Wait` which we have also mocked.
-    *
-    *  [3] When we receive the call to the mocked version of `Condition_Wait`
-    *      from `module_publish_worker` we have it invoke a function pointed at
-    *      by the variable `intercept_for_Condition_Wait` when `shouldIntercept_Condition_Wait`
-    *      is `true`. We initialize it to true and assign
-    *      `module_publish_worker_calls_module_receive_Condition_Wait` to `intercept_for_Condition_Wait`.
-    *
-    *  [4] Here's what the call stack looks like right now:
-    *
-    *          Broker_AddModule -> ThreadAPI_Create -> module_publish_worker ->
-    *          Condition_Wait -> module_publish_worker_calls_module_receive_Condition_Wait
-    *
-    *  [5] `module_publish_worker_calls_module_receive_Condition_Wait` uses the data pointed at by
-    *      the global variable `interceptArgs_for_Condition_Wait` to get a handle to the
-    *      message broker and the message to be published to the message broker. We assign a pointer to a local
-    *      variable of type `Condition_Wait_Callback_Input` in the test case
-    *      (i.e. `module_publish_worker_calls_module_receive`) to 'interceptArgs_for_Condition_Wait'.
-    *
-    *  [6] `module_publish_worker_calls_module_receive_Condition_Wait` publishes a message to the
-    *      message broker via `Broker_Publish` and replaces `intercept_for_Condition_Wait` so that
-    *      it points to the function `module_publish_worker_calls_module_receive_Condition_Wait2`.
-    *
-    *  [7] Control then goes back to `module_publish_worker` which proceeds to consume the newly
-    *      enqueued message and delivers it to the fake module. `FakeModule_Receive` gets called
-    *      where we verify that the module handle and the message handle have expected values.
-    *
-    *  [8] `module_publish_worker` then loops around and calls `Condition_Wait` again. And this
-    *      time the `module_publish_worker_calls_module_receive_Condition_Wait2` function ends up
-    *      being called. In this function our goal is to assign `1` to the `quit_worker`
-    *      variable in the module's `BROKER_MODULEINFO` struct. Since we don't have access to the
-    *      structs backing the message broker we use the global variables `BROKER_offsetof_modules` and
-    *      `BROKER_offsetof_quit_worker` provided by the message broker API to figure out the location where
-    *      the `quit_worker` variable resides in memory and assign `1` to it.
-    *
-    *  [9] Since `quit_worker` is now `1`, `module_publish_worker` will exit its processing loop
-    *      and the entire stack will unwind and control comes back to the test case when
-    *      `Broker_AddModule` returns.
-    */
-
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
-
-    // make ThreadAPI_Create mock call the callback function
-    shouldThreadAPI_Create_invoke_callback = true;
-
-    // we want to intercept Condition_Wait when it is called
-    shouldIntercept_Condition_Wait = true;
-    Condition_Wait_Callback_Input input{ broker, NULL };
-    interceptArgs_for_Condition_Wait = (void*)&input;
-    intercept_for_Condition_Wait = module_publish_worker_calls_module_receive_Condition_Wait;
-
-    // setup fake module's validation data
-    unsigned char fake;
-    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
-    auto message = Message_Create(&c);
-    input.message = message;
-    call_status_for_FakeModule_Receive.module = fake_module_handle;
-    call_status_for_FakeModule_Receive.messageHandle = message;
-
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_BLOCK, 10 } };
     mocks.ResetAllCalls();
 
-    // this is for Broker_Publish
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_get_next_item(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Message_Clone(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    // this is for the Broker_AddModule call
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
         .IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module*/
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module*/
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
     STRICT_EXPECTED_CALL(mocks, list_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
@@ -1280,78 +1722,58 @@ TEST_FUNCTION(module_publish_worker_calls_module_receive)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Init());
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-
-    // this is for module_publish_worker
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) 
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, Condition_Init()); /*this is for the space_cond*/
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_CreateStrand(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_front(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
+    expectRoutingSnapshotRebuild(mocks, 1, 0, 0);
 
     ///act
-    auto result = Broker_AddModule(broker, &fake_module);
+    auto result = Broker_AddModuleWithOptions(broker, &fake_module, &options);
 
     ///assert
     ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Message_Destroy(message);
     Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-/*Tests_SRS_BCAST_BROKER_02_004: [ If acquiring the lock fails, then module_publish_worker shall return. ]*/
-TEST_FUNCTION(module_publish_worker_fails_when_first_lock_fails)
+//Tests_SRS_BCAST_BROKER_13_147: [If `options` is not NULL and its max_batch_size is too large to allocate BROKER_MODULEINFO::batch, the function shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_AddModuleWithOptions_fails_when_max_batch_size_is_too_large)
 {
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 0, 0, BROKER_QUEUE_DROP_NEWEST, 0, ((size_t)-1) } };
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_AddModuleWithOptions(broker, &fake_batch_module, &options);
 
-    // make ThreadAPI_Create mock call the callback function
-    shouldThreadAPI_Create_invoke_callback = true;
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
 
-    // we want to intercept Condition_Wait when it is called
-    shouldIntercept_Condition_Wait = true;
-    Condition_Wait_Callback_Input input{ broker, NULL };
-    interceptArgs_for_Condition_Wait = (void*)&input;
-    intercept_for_Condition_Wait = module_publish_worker_calls_module_receive_Condition_Wait;
+    ///cleanup
+    Broker_Destroy(broker);
+}
 
+//Tests_SRS_BCAST_BROKER_13_145: [If the module implements Module_ReceiveBatch, the function shall allocate BROKER_MODULEINFO::batch with room for queue_options.max_batch_size message handles, or a default number of handles when it is 0.]
+TEST_FUNCTION(Broker_AddModuleWithOptions_allocates_the_batch_for_Module_ReceiveBatch)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 0, 0, BROKER_QUEUE_DROP_NEWEST, 0, 2 } };
     mocks.ResetAllCalls();
 
-    // this is for the Broker_AddModule call
-	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module*/
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
     STRICT_EXPECTED_CALL(mocks, list_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
@@ -1359,157 +1781,247 @@ TEST_FUNCTION(module_publish_worker_fails_when_first_lock_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Init());
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(2 * sizeof(MESSAGE_HANDLE))); /*this is for the batch*/
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_CreateStrand(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-
-    // this is for module_publish_worker
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn(LOCK_ERROR);
+    expectRoutingSnapshotRebuild(mocks, 1, 0, 0);
 
     ///act
-    auto result = Broker_AddModule(broker, &fake_module);
+    auto result = Broker_AddModuleWithOptions(broker, &fake_batch_module, &options);
 
     ///assert
     ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Broker_RemoveModule(broker, &fake_module);
+    Broker_RemoveModule(broker, &fake_batch_module);
     Broker_Destroy(broker);
 }
 
-
-// Tests_SRS_BCAST_BROKER_04_001: [** This function shall immediately start processing messages when `module->mq` is not empty without waiting on `module->mq_cond`.]
-TEST_FUNCTION(module_publish_worker_clean_message_queue_before_waiting_for_condition)
+//Tests_SRS_BCAST_BROKER_13_146: [If BROKER_MODULEINFO::batch is not NULL, the function shall hand the messages in module_info->delivery_mq to the module's Module_ReceiveBatch in order, at most BROKER_MODULEINFO::batch_capacity at a time, and destroy them after each call.]
+TEST_FUNCTION(module_publish_worker_hands_messages_to_Module_ReceiveBatch)
 {
-    //This test follow the same guideline of test: module_publish_worker_calls_module_receive, with the exception that
-    //module_publish_worker IS NOT called when you call ThreadAPI_Create. This is to simulate the scenario where I have a message published on the
-    //module before thread starts.
-
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 0, 0, BROKER_QUEUE_DROP_NEWEST, 0, 2 } };
+    (void)Broker_AddModuleWithOptions(broker, &fake_batch_module, &options);
 
-    // we want to intercept Condition_Wait when it is called
-    shouldIntercept_Condition_Wait = true;
-    Condition_Wait_Callback_Input input{ broker, NULL };
-    interceptArgs_for_Condition_Wait = (void*)&input;
-    intercept_for_Condition_Wait = module_publish_worker_calls_module_receive_Condition_Wait;
-
-    // setup fake module's validation data
     unsigned char fake;
     MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
     auto message = Message_Create(&c);
-
-    input.message = message;
-    call_status_for_FakeModule_Receive.module = fake_module_handle;
-    call_status_for_FakeModule_Receive.messageHandle = message;
-        
-    auto result = Broker_AddModule(broker, &fake_module);
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
-
-    result = Broker_Publish(broker, NULL, message);
-    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    (void)Broker_Publish(broker, NULL, message);
+    (void)Broker_Publish(broker, NULL, message);
+    (void)Broker_Publish(broker, NULL, message);
 
     mocks.ResetAllCalls();
 
-    // this is for module_publish_worker
-
-    //Calls for the first message before calling Condition_Wait
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_front(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Swap(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG)) /*2 messages, then the last one and an empty queue*/
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(4);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message))
+        .ExpectedTimesExactly(3);
 
+    ///act
+    strand_func_to_call(strand_func_args);
 
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, 2, FakeModule_ReceiveBatch_call_count);
+    ASSERT_ARE_EQUAL(size_t, 2, FakeModule_ReceiveBatch_counts[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, FakeModule_ReceiveBatch_counts[1]);
+    ASSERT_IS_FALSE(call_status_for_FakeModule_Receive.was_called);
 
-    //Calls for when Condition_Wait is Intercepted
-    // this is for Broker_Publish
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_get_next_item(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Message_Clone(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_batch_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_148: [If the module implements Module_ReceiveOwned, the function shall deliver the message through it and shall not destroy the message.]
+TEST_FUNCTION(module_publish_worker_hands_message_ownership_to_Module_ReceiveOwned)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_owned_module);
+
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    (void)Broker_Publish(broker, NULL, message);
+    (void)Broker_Publish(broker, NULL, message);
+
+    mocks.ResetAllCalls();
 
-    // this is for module_publish_worker
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Swap(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_front(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG)) /*2 messages, then an empty queue*/
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+        .ExpectedTimesExactly(3);
 
     ///act
-    thread_func_to_call(thread_func_args);
+    strand_func_to_call(strand_func_args);
 
     ///assert
-    
     mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, 2, FakeModule_ReceiveOwned_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, message, FakeModule_ReceiveOwned_messages[0]);
+    ASSERT_ARE_EQUAL(void_ptr, message, FakeModule_ReceiveOwned_messages[1]);
+    ASSERT_IS_FALSE(call_status_for_FakeModule_Receive.was_called);
 
     ///cleanup
+    Message_Destroy(FakeModule_ReceiveOwned_messages[0]);
+    Message_Destroy(FakeModule_ReceiveOwned_messages[1]);
     Message_Destroy(message);
-    Broker_RemoveModule(broker, &fake_module);
+    Broker_RemoveModule(broker, &fake_owned_module);
     Broker_Destroy(broker);
 }
 
-
-//Tests_SRS_BCAST_BROKER_13_048: [If broker or module is NULL the function shall return BROKER_INVALIDARG.]
-TEST_FUNCTION(Broker_RemoveModule_fails_with_null_broker)
-{
-    ///arrange
-    CBrokerMocks mocks;
+// Tests_SRS_BCAST_BROKER_13_089: [ This function shall acquire the lock on module_info->mq_lock. ]
+// Tests_SRS_BCAST_BROKER_13_090: [ If module_info->quit_worker is equal to 0, this function shall take every message in module_info->mq by swapping it with the empty module_info->delivery_mq. ]
+// Tests_SRS_BCAST_BROKER_13_069: [ The function shall dequeue every message from module_info->delivery_mq without acquiring module_info->mq_lock. ]
+// Tests_SRS_BCAST_BROKER_13_091: [ The function shall unlock module_info->mq_lock. ]
+// Tests_SRS_BCAST_BROKER_13_092: [ The function shall deliver the message to the module's callback function via module_info->module_apis. ]
+// Tests_SRS_BCAST_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]
+// Tests_SRS_BCAST_BROKER_13_026: [ This function shall assign user_data to a local variable called module_info of type BROKER_MODULEINFO*. ]
+TEST_FUNCTION(module_publish_worker_calls_module_receive)
+{
+    /**
+    * The worker pool is mocked, so no worker ever runs the module's strand.
+    * The `WorkerPool_CreateStrand` mock saves the strand function and its
+    * context when `Broker_AddModule` creates the module's strand, and the
+    * test runs the strand by calling the saved function the way a worker
+    * would after `Broker_Publish` scheduled it.
+    */
+
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+
+    // setup fake module's validation data
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    call_status_for_FakeModule_Receive.module = fake_module_handle;
+    call_status_for_FakeModule_Receive.messageHandle = message;
+
+    auto result = Broker_AddModule(broker, &fake_module);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    result = Broker_Publish(broker, NULL, message);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_IS_NOT_NULL(strand_func_to_call);
+
+    mocks.ResetAllCalls();
+
+    // this is for module_publish_worker
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG)) /*mq has the published message*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Swap(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG)) /*delivery_mq is drained*/
+        .IgnoreArgument(1);
+
+    ///act
+    strand_func_to_call(strand_func_args);
+
+    ///assert
+    ASSERT_IS_TRUE(call_status_for_FakeModule_Receive.was_called);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+/*Tests_SRS_BCAST_BROKER_02_004: [ If acquiring the lock fails, then module_publish_worker shall return. ]*/
+TEST_FUNCTION(module_publish_worker_fails_when_first_lock_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+
+    mocks.ResetAllCalls();
+
+    // this is for module_publish_worker
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
+
+    ///act
+    strand_func_to_call(strand_func_args);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+// Tests_SRS_BCAST_BROKER_13_090: [ If module_info->quit_worker is equal to 0, this function shall take every message in module_info->mq by swapping it with the empty module_info->delivery_mq. ]
+TEST_FUNCTION(module_publish_worker_does_nothing_when_queue_is_empty)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+
+    mocks.ResetAllCalls();
+
+    // this is for module_publish_worker
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    strand_func_to_call(strand_func_args);
+
+    ///assert
+    ASSERT_IS_FALSE(call_status_for_FakeModule_Receive.was_called);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_048: [If broker or module is NULL the function shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_RemoveModule_fails_with_null_broker)
+{
+    ///arrange
+    CBrokerMocks mocks;
 
     ///act
     auto r1 = Broker_RemoveModule(NULL, (const MODULE*)0x1);
@@ -1594,7 +2106,7 @@ TEST_FUNCTION(Broker_RemoveModule_fails_when_list_find_fails)
     Broker_Destroy(broker);
 }
 
-/*Tests_SRS_BCAST_BROKER_02_002: [ If locking fails, then terminating the thread shall not be attempted (signalling the condition and joining the thread). ]*/
+/*Tests_SRS_BCAST_BROKER_02_002: [ If locking fails, the function shall still assign 1 to BROKER_MODULEINFO::quit_worker and destroy the strand. ]*/
 //Tests_SRS_BCAST_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
 TEST_FUNCTION(Broker_RemoveModule_fails_when_lock_mq_lock_fails)
 {
@@ -1619,13 +2131,13 @@ TEST_FUNCTION(Broker_RemoveModule_fails_when_lock_mq_lock_fails)
         STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
             .IgnoreArgument(1)
             .SetFailReturn(LOCK_ERROR);
-        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, WorkerPool_DestroyStrand(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
@@ -1636,7 +2148,7 @@ TEST_FUNCTION(Broker_RemoveModule_fails_when_lock_mq_lock_fails)
             .IgnoreArgument(2);
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-
+        expectRoutingSnapshotRebuild(mocks, 0, 0, 0);
 
         ///act
         result = Broker_RemoveModule(broker, &fake_module);
@@ -1655,12 +2167,12 @@ TEST_FUNCTION(Broker_RemoveModule_fails_when_lock_mq_lock_fails)
 //Tests_SRS_BCAST_BROKER_13_052 : [The function shall remove the module from BROKER_HANDLE_DATA::modules.]
 //Tests_SRS_BCAST_BROKER_13_054 : [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]
 /*Tests_SRS_BCAST_BROKER_02_001: [ Broker_RemoveModule shall lock `BROKER_MODULEINFO::mq_lock`. ]*/
-/*Tests_SRS_BCAST_BROKER_02_003: [ After signaling the condition, Broker_RemoveModule shall unlock BROKER_MODULEINFO::mq_lock. ]*/
+/*Tests_SRS_BCAST_BROKER_02_003: [ Broker_RemoveModule shall then unlock BROKER_MODULEINFO::mq_lock. ]*/
 //Tests_SRS_BCAST_BROKER_13_103 : [The function shall assign 1 to BROKER_MODULEINFO::quit_worker.]
-//Tests_SRS_BCAST_BROKER_17_001: [The function shall signal BROKER_MODULEINFO::mq_cond to release module from waiting.]
-//Tests_SRS_BCAST_BROKER_13_104 : [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]
+//Tests_SRS_BCAST_BROKER_13_104 : [The function shall destroy BROKER_MODULEINFO::strand by calling WorkerPool_DestroyStrand, which waits for a delivery in progress to finish.]
 //Tests_SRS_BCAST_BROKER_13_057 : [The function shall free all members of the BROKER_MODULEINFO object.]
 //Tests_SRS_BCAST_BROKER_13_053 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+//Tests_SRS_BCAST_BROKER_13_155: [Broker_RemoveModule shall rebuild the broker's routing snapshot before stopping the module, so that no publisher references the module when it is freed.]
 TEST_FUNCTION(Broker_RemoveModule_succeeds)
 {
     ///arrange
@@ -1684,16 +2196,13 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_DestroyStrand(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
@@ -1704,7 +2213,7 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds)
         .IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-
+    expectRoutingSnapshotRebuild(mocks, 0, 0, 0);
 
     ///act
     result = Broker_RemoveModule(broker, &fake_module);
@@ -1717,38 +2226,163 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BCAST_BROKER_17_003: [ Broker_AddLink shall return BROKER_OK. ]
-TEST_FUNCTION(Broker_AddLink_Returns_OK)
+//Tests_SRS_BCAST_BROKER_13_116: [If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_AddLink shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_AddLink_fails_with_null_link)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    ///act
+    auto r1 = Broker_AddLink((BROKER_HANDLE)0x1, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_BCAST_BROKER_13_118: [Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR.]
+TEST_FUNCTION(Broker_AddLink_fails_when_source_is_not_attached)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA link = { (MODULE_HANDLE)0x4242, fake_module_handle };
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_AddLink(broker, &link);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ADD_LINK_ERROR, result);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_117: [Broker_AddLink shall lock the modules_lock.]
+//Tests_SRS_BCAST_BROKER_13_119: [Broker_AddLink shall find the BROKER_MODULEINFO for link->module_sink_handle and link->module_source_handle.]
+//Tests_SRS_BCAST_BROKER_13_121: [Broker_AddLink shall create BROKER_MODULEINFO::routes of the source if it does not exist yet.]
+//Tests_SRS_BCAST_BROKER_13_122: [Broker_AddLink shall append a new route to the sink to BROKER_MODULEINFO::routes of the source.]
+//Tests_SRS_BCAST_BROKER_13_123: [Broker_AddLink shall unlock the modules_lock.]
+//Tests_SRS_BCAST_BROKER_13_157: [After appending a new route, Broker_AddLink shall rebuild the broker's routing snapshot, and remove the route and return BROKER_ADD_LINK_ERROR if it fails.]
+TEST_FUNCTION(Broker_AddLink_succeeds)
 {
     ///arrange
     CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle };
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, fake_module_handle))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(4);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the counters of the route*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    expectRoutingSnapshotRebuild(mocks, 1, 1, 1);
 
     ///act
-    auto r1 = Broker_AddLink(NULL, NULL);
+    auto result = Broker_AddLink(broker, &link);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_OK);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
 }
 
-//Tests_SRS_BCAST_BROKER_17_004: [ Broker_RemoveLink shall return BROKER_OK. ]
-TEST_FUNCTION(Broker_RemoveLink_Returns_OK)
+//Tests_SRS_BCAST_BROKER_13_124: [If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_RemoveLink shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_RemoveLink_fails_with_null_link)
 {
     ///arrange
     CBrokerMocks mocks;
 
     ///act
-    auto r1 = Broker_RemoveLink(NULL, NULL);
+    auto r1 = Broker_RemoveLink((BROKER_HANDLE)0x1, NULL);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_OK);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_INVALIDARG);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
 }
 
+//Tests_SRS_BCAST_BROKER_13_126: [Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR.]
+TEST_FUNCTION(Broker_RemoveLink_fails_when_link_does_not_exist)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle };
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_RemoveLink(broker, &link);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_REMOVE_LINK_ERROR, result);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_120: [If the route from source to sink already exists, Broker_AddLink shall increment its link count.]
+//Tests_SRS_BCAST_BROKER_13_128: [Broker_RemoveLink shall decrement the link count of the route and remove the route when the count reaches 0.]
+TEST_FUNCTION(Broker_RemoveLink_keeps_route_until_last_link_is_removed)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle };
+    (void)Broker_AddLink(broker, &link);
+    (void)Broker_AddLink(broker, &link);
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result1 = Broker_RemoveLink(broker, &link);
+    (void)Broker_Publish(broker, fake_module_handle, message);
+    size_t schedules_after_first_remove = currentWorkerPool_Schedule_call;
+    auto result2 = Broker_RemoveLink(broker, &link);
+    (void)Broker_Publish(broker, fake_module_handle, message);
+    auto result3 = Broker_RemoveLink(broker, &link);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result1);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result2);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_REMOVE_LINK_ERROR, result3);
+    ASSERT_ARE_EQUAL(size_t, 1, schedules_after_first_remove);
+    ASSERT_ARE_EQUAL(size_t, 1, currentWorkerPool_Schedule_call);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
 /*Tests_SRS_BCAST_BROKER_13_056: [If BROKER_MODULEINFO::mq is not empty then this function shall call Message_Destroy on every message still left in the collection.]*/
 TEST_FUNCTION(Broker_RemoveModule_with_msg_succeeds)
 {
@@ -1779,19 +2413,16 @@ TEST_FUNCTION(Broker_RemoveModule_with_msg_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_DestroyStrand(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
@@ -1802,7 +2433,7 @@ TEST_FUNCTION(Broker_RemoveModule_with_msg_succeeds)
         .IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-
+    expectRoutingSnapshotRebuild(mocks, 0, 0, 0);
 
     ///act
     result = Broker_RemoveModule(broker, &fake_module);
@@ -1899,6 +2530,8 @@ TEST_FUNCTION(Broker_DecRef_does_nothing_with_null_input)
 }
 
 //Tests_SRS_BCAST_BROKER_13_112: [If the ref count is zero then the allocated resources are freed.]
+//Tests_SRS_BCAST_BROKER_13_144: [Broker_Destroy shall destroy BROKER_HANDLE_DATA::worker_pool by calling WorkerPool_Destroy.]
+//Tests_SRS_BCAST_BROKER_13_159: [Broker_Destroy shall destroy BROKER_HANDLE_DATA::routing_table by calling RoutingTable_Destroy.]
 TEST_FUNCTION(Broker_Destroy_works)
 {
     ///arrange
@@ -1907,6 +2540,10 @@ TEST_FUNCTION(Broker_Destroy_works)
     mocks.ResetAllCalls();
 
     // these are for Broker_Destroy
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
@@ -1935,6 +2572,10 @@ TEST_FUNCTION(Broker_DecRef_works)
     mocks.ResetAllCalls();
 
     // these are for Broker_Destroy
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
@@ -1985,8 +2626,8 @@ TEST_FUNCTION(Broker_Publish_fails_with_null_message)
     ///cleanup
 }
 
-//Tests_SRS_BCAST_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_fails_when_lock_on_modules_lock_fails)
+//Tests_SRS_BCAST_BROKER_13_031: [Broker_Publish shall acquire the broker's routing snapshot by calling RoutingTable_Acquire, and shall not acquire BROKER_HANDLE_DATA::modules_lock.]
+TEST_FUNCTION(Broker_Publish_does_not_lock_modules_lock)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -2001,15 +2642,17 @@ TEST_FUNCTION(Broker_Publish_fails_when_lock_on_modules_lock_fails)
     mocks.ResetAllCalls();
 
     // this is for Broker_Publish
-    whenShallLock_fail = 1;
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_GetEntries(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
     ///act
     auto result = Broker_Publish(broker, NULL, message);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_ARE_EQUAL(size_t, 0, currentLock_call);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
@@ -2035,19 +2678,15 @@ TEST_FUNCTION(Broker_Publish_fails_when_lock_on_module_mq_lock_fails)
     mocks.ResetAllCalls();
 
     // this is for Broker_Publish
-    whenShallLock_fail = currentLock_call + 2;
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    whenShallLock_fail = currentLock_call + 1;
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_get_next_item(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_GetEntries(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
     ///act
     result = Broker_Publish(broker, NULL, message);
@@ -2063,7 +2702,7 @@ TEST_FUNCTION(Broker_Publish_fails_when_lock_on_module_mq_lock_fails)
 }
 
 //Tests_SRS_BCAST_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_fails_when_vector_push_back_fails)
+TEST_FUNCTION(Broker_Publish_fails_when_MessageQueue_Push_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -2082,26 +2721,23 @@ TEST_FUNCTION(Broker_Publish_fails_when_vector_push_back_fails)
     // this is for Broker_Publish
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_get_next_item(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    whenShallVECTOR_push_back_fail = currentVECTOR_push_back_call + 1;
-    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_GetEntries(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    whenShallMessageQueue_Push_fail = currentMessageQueue_Push_call + 1;
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Push(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, Message_Clone(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_GetContent(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     ///act
     result = Broker_Publish(broker, NULL, message);
@@ -2117,7 +2753,7 @@ TEST_FUNCTION(Broker_Publish_fails_when_vector_push_back_fails)
 }
 
 //Tests_SRS_BCAST_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_fails_when_vector_condition_post_fails)
+TEST_FUNCTION(Broker_Publish_fails_when_WorkerPool_Schedule_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -2138,23 +2774,22 @@ TEST_FUNCTION(Broker_Publish_fails_when_vector_condition_post_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_get_next_item(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_GetEntries(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Push(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+    whenShallWorkerPool_Schedule_fail = 1;
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Schedule(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Message_Clone(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Message_GetContent(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    whenShallCond_Post_fail = 1;
-    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG)) /*after the message is appended*/
         .IgnoreArgument(1);
 
     ///act
@@ -2170,13 +2805,13 @@ TEST_FUNCTION(Broker_Publish_fails_when_vector_condition_post_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BCAST_BROKER_13_031: [Broker_Publish shall acquire the lock BROKER_HANDLE_DATA::modules_lock.]
-//Tests_SRS_BCAST_BROKER_13_032: [ Broker_Publish shall start a processing loop for every module in BROKER_HANDLE_DATA::modules. ]
+//Tests_SRS_BCAST_BROKER_13_031: [Broker_Publish shall acquire the broker's routing snapshot by calling RoutingTable_Acquire, and shall not acquire BROKER_HANDLE_DATA::modules_lock.]
+//Tests_SRS_BCAST_BROKER_13_032: [If source is NULL, Broker_Publish shall start a processing loop for every module of the routing snapshot, as returned by RoutingSnapshot_GetEntries.]
 //Tests_SRS_BCAST_BROKER_13_033 : [In the loop, the function shall first acquire the lock on BROKER_MODULEINFO::mq_lock.]
 //Tests_SRS_BCAST_BROKER_13_034 : [The function shall then append message to BROKER_MODULEINFO::mq by calling Message_Clone and VECTOR_push_back.]
 //Tests_SRS_BCAST_BROKER_13_035 : [The function shall then release BROKER_MODULEINFO::mq_lock.]
-//Tests_SRS_BCAST_BROKER_13_096 : [The function shall then signal BROKER_MODULEINFO::mq_cond.]
-//Tests_SRS_BCAST_BROKER_13_040 : [Broker_Publish shall release the lock BROKER_HANDLE_DATA::modules_lock after the loop.]
+//Tests_SRS_BCAST_BROKER_13_096 : [The function shall then schedule BROKER_MODULEINFO::strand by calling WorkerPool_Schedule.]
+//Tests_SRS_BCAST_BROKER_13_040 : [Broker_Publish shall release the routing snapshot by calling RoutingTable_Release after the loop.]
 //Tests_SRS_BCAST_BROKER_13_037 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
 TEST_FUNCTION(Broker_Publish_succeeds)
 {
@@ -2199,29 +2834,621 @@ TEST_FUNCTION(Broker_Publish_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_GetEntries(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Push(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Schedule(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_GetContent(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG)) /*after the message is appended*/
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_Publish(broker, NULL, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_141: [If the message still does not fit in BROKER_MODULEINFO::mq, the function shall not enqueue it and shall return BROKER_BUSY.]
+TEST_FUNCTION(Broker_Publish_returns_BUSY_when_drop_newest_queue_is_full)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_DROP_NEWEST, 0 } };
+    auto result = Broker_AddModuleWithOptions(broker, &fake_module, &options);
+    result = Broker_Publish(broker, NULL, message);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_GetEntries(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_GetContent(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_Publish(broker, NULL, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_BUSY);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_149: [If broker or batch is NULL the function shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_PublishBatch_fails_with_null_batch)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_PublishBatch(broker, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_150: [If the batch is empty, Broker_PublishBatch shall return BROKER_OK without acquiring any lock.]
+TEST_FUNCTION(Broker_PublishBatch_with_empty_batch_does_nothing)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    FAKE_MESSAGE_BATCH batch = { { NULL, NULL }, 0 };
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, MessageBatch_GetCount((MESSAGE_BATCH_HANDLE)&batch));
+
+    ///act
+    result = Broker_PublishBatch(broker, NULL, (MESSAGE_BATCH_HANDLE)&batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_151: [Broker_PublishBatch shall publish the messages of the batch as Broker_Publish does, acquiring BROKER_HANDLE_DATA::modules_lock and the BROKER_MODULEINFO::mq_lock of every receiving module once, appending all the messages to the module's queue in order and scheduling the module's strand once.]
+TEST_FUNCTION(Broker_PublishBatch_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+
+    // create the messages to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    FAKE_MESSAGE_BATCH batch = { { Message_Create(&c), Message_Create(&c) }, 2 };
+
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_PublishBatch
+    STRICT_EXPECTED_CALL(mocks, MessageBatch_GetCount((MESSAGE_BATCH_HANDLE)&batch));
+    STRICT_EXPECTED_CALL(mocks, MessageBatch_GetMessages((MESSAGE_BATCH_HANDLE)&batch));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_GetEntries(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Push(IGNORED_PTR_ARG, batch.messages[0]))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(batch.messages[0]));
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Push(IGNORED_PTR_ARG, batch.messages[1]))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(batch.messages[1]));
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Schedule(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_GetContent(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG)) /*after the message is appended*/
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+
+    ///act
+    result = Broker_PublishBatch(broker, NULL, (MESSAGE_BATCH_HANDLE)&batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(batch.messages[0]);
+    Message_Destroy(batch.messages[1]);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_141: [If the message still does not fit in BROKER_MODULEINFO::mq, the function shall not enqueue it and shall return BROKER_BUSY.]
+TEST_FUNCTION(Broker_PublishBatch_returns_BUSY_when_the_batch_does_not_fit)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+
+    // create the messages to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    FAKE_MESSAGE_BATCH batch = { { Message_Create(&c), Message_Create(&c) }, 2 };
+
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_DROP_NEWEST, 0 } };
+    auto result = Broker_AddModuleWithOptions(broker, &fake_module, &options);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_PublishBatch
+    STRICT_EXPECTED_CALL(mocks, MessageBatch_GetCount((MESSAGE_BATCH_HANDLE)&batch));
+    STRICT_EXPECTED_CALL(mocks, MessageBatch_GetMessages((MESSAGE_BATCH_HANDLE)&batch));
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_GetEntries(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Push(IGNORED_PTR_ARG, batch.messages[0]))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(batch.messages[0]));
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Schedule(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_GetContent(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG)) /*after the message is appended*/
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_PublishBatch(broker, NULL, (MESSAGE_BATCH_HANDLE)&batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_BUSY);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(batch.messages[0]);
+    Message_Destroy(batch.messages[1]);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_139: [If the message does not fit in BROKER_MODULEINFO::mq and the policy is BROKER_QUEUE_DROP_OLDEST, the function shall destroy the oldest queued messages until it fits.]
+TEST_FUNCTION(Broker_Publish_drops_oldest_message_when_queue_is_full)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_DROP_OLDEST, 0 } };
+    auto result = Broker_AddModuleWithOptions(broker, &fake_module, &options);
+    result = Broker_Publish(broker, NULL, message);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_GetEntries(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Push(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Schedule(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_GetContent(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG)) /*after the message is appended*/
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_Publish(broker, NULL, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_185: [Before it waits, the function shall schedule BROKER_MODULEINFO::strand by calling WorkerPool_Schedule, so that the module drains the messages already queued, and shall not wait if that fails.]
+//Tests_SRS_BCAST_BROKER_13_140: [If the message does not fit in BROKER_MODULEINFO::mq and the policy is BROKER_QUEUE_BLOCK, the function shall wait on BROKER_MODULEINFO::space_cond until the message fits, the module is being removed or block_timeout_ms has elapsed since it started waiting.]
+//Tests_SRS_BCAST_BROKER_13_141: [If the message still does not fit in BROKER_MODULEINFO::mq, the function shall not enqueue it and shall return BROKER_BUSY.]
+TEST_FUNCTION(Broker_Publish_waits_for_space_when_block_queue_is_full)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_BLOCK, 10 } };
+    auto result = Broker_AddModuleWithOptions(broker, &fake_module, &options);
+    result = Broker_Publish(broker, NULL, message);
+    whenShallCondition_Wait_time_out = 1;
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_GetEntries(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Schedule(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 10))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_GetContent(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_Publish(broker, NULL, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_BUSY);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_140: [If the message does not fit in BROKER_MODULEINFO::mq and the policy is BROKER_QUEUE_BLOCK, the function shall wait on BROKER_MODULEINFO::space_cond until the message fits, the module is being removed or block_timeout_ms has elapsed since it started waiting.]
+TEST_FUNCTION(Broker_Publish_waits_again_when_it_is_signaled_and_the_block_queue_is_still_full)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_BLOCK, 10000 } };
+    auto result = Broker_AddModuleWithOptions(broker, &fake_module, &options);
+    result = Broker_Publish(broker, NULL, message);
+    /*the first wakeup does not make room*/
+    whenShallCondition_Wait_time_out = 2;
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_GetEntries(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Schedule(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 10000))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_GetContent(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_Publish(broker, NULL, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_BUSY);
+    ASSERT_ARE_EQUAL(size_t, 2, currentCondition_Wait_call);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_187: [If BROKER_MODULEINFO::space_cond is not NULL, Broker_RemoveModule shall mark the module as being removed under BROKER_MODULEINFO::mq_lock and signal BROKER_MODULEINFO::space_cond before it rebuilds the routing snapshot, so that the publishers waiting for room in its queue return BROKER_BUSY instead of holding the snapshot until block_timeout_ms elapses.]
+TEST_FUNCTION(Broker_RemoveModule_wakes_the_publishers_waiting_for_room_in_its_queue)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_BLOCK, 10 } };
+    (void)Broker_AddModuleWithOptions(broker, &fake_module, &options);
+    size_t posts_before_remove = currentCond_Post_call;
+
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_RemoveModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, posts_before_remove + 1, currentCond_Post_call);
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_185: [Before it waits, the function shall schedule BROKER_MODULEINFO::strand by calling WorkerPool_Schedule, so that the module drains the messages already queued, and shall not wait if that fails.]
+TEST_FUNCTION(Broker_PublishBatch_larger_than_a_block_queue_is_drained_by_an_idle_module)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+
+    // create the messages to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    FAKE_MESSAGE_BATCH batch = { { message, message }, 2 };
+    call_status_for_FakeModule_Receive.module = fake_module_handle;
+    call_status_for_FakeModule_Receive.messageHandle = message;
+
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_BLOCK, 10 } };
+    auto result = Broker_AddModuleWithOptions(broker, &fake_module, &options);
+    run_strand_on_Condition_Wait = true;
+
+    mocks.ResetAllCalls();
+
+    ///act
+    result = Broker_PublishBatch(broker, NULL, (MESSAGE_BATCH_HANDLE)&batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_IS_TRUE(call_status_for_FakeModule_Receive.was_called);
+    ASSERT_ARE_EQUAL(size_t, 2, currentWorkerPool_Schedule_call); /*before the wait, then for the last message*/
+
+    ///cleanup
+    run_strand_on_Condition_Wait = false;
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_130: [If source is not NULL, Broker_Publish shall find the routing entry of source by calling RoutingSnapshot_Find.]
+//Tests_SRS_BCAST_BROKER_13_132: [Broker_Publish shall start a processing loop for every sink of the routing entry of the source, and shall not publish the message to any other module.]
+TEST_FUNCTION(Broker_Publish_with_source_skips_unlinked_modules)
+{
+	///arrange
+	CBrokerMocks mocks;
+
+	auto broker = Broker_Create();
+
+	// create a message to send
+	unsigned char fake;
+	MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+	auto message = Message_Create(&c);
+
+	auto result = Broker_AddModule(broker, &fake_module);
+
+	mocks.ResetAllCalls();
+
+	// this is for Broker_Publish
+	STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_Find(IGNORED_PTR_ARG, fake_module_handle))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+
+	///act
+	result = Broker_Publish(broker, fake_module_handle, message);
+
+	///assert
+	ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+	ASSERT_ARE_EQUAL(size_t, 0, currentWorkerPool_Schedule_call);
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	Message_Destroy(message);
+	Broker_RemoveModule(broker, &fake_module);
+	Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_132: [Broker_Publish shall start a processing loop for every sink of the routing entry of the source, and shall not publish the message to any other module.]
+TEST_FUNCTION(Broker_Publish_with_source_publishes_to_linked_modules)
+{
+	///arrange
+	CBrokerMocks mocks;
+
+	auto broker = Broker_Create();
+
+	// create a message to send
+	unsigned char fake;
+	MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+	auto message = Message_Create(&c);
+
+	auto result = Broker_AddModule(broker, &fake_module);
+	BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle };
+	result = Broker_AddLink(broker, &link);
+
+	mocks.ResetAllCalls();
+
+	// this is for Broker_Publish
+	STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_Find(IGNORED_PTR_ARG, fake_module_handle))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, MessageQueue_Push(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+	    .IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+	STRICT_EXPECTED_CALL(mocks, WorkerPool_Schedule(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Message_GetContent(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG)) /*after the message is appended*/
+		.IgnoreArgument(1);
+
+	///act
+	result = Broker_Publish(broker, fake_module_handle, message);
+
+	///assert
+	ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	Message_Destroy(message);
+	Broker_RemoveModule(broker, &fake_module);
+	Broker_Destroy(broker);
+}
+
+static const BROKER_FILTER_CONDITION fake_conditions[] = { { BROKER_FILTER_EXISTS, "macAddress", NULL } };
+static const BROKER_LINK_FILTER fake_filter = { fake_conditions, 1 };
+static const BROKER_LINK_FILTER fake_filter2 = { fake_conditions, 1 };
+
+//Tests_SRS_BCAST_BROKER_13_161: [If link->filter is not NULL, Broker_AddLink shall compile it for the new route by calling LinkFilter_Create.]
+//Tests_SRS_BCAST_BROKER_13_186: [If a sink of the routing entry of the source has a filter, Broker_Publish shall initialize a LINK_FILTER_MESSAGE for every message by calling LinkFilter_InitMessage before the loop, so that the filters of all the sinks share the properties and the hashes they look up; if it cannot allocate them for a batch, the function shall test the messages by calling LinkFilter_Matches instead.]
+//Tests_SRS_BCAST_BROKER_13_162: [When it publishes to the sinks of source, if the route has a filter, the function shall test the messages against it by calling LinkFilter_MatchesMessage, skip the sink without acquiring its lock if none of them passes, and only append the messages that pass.]
+TEST_FUNCTION(Broker_Publish_with_source_skips_a_sink_whose_filter_rejects_the_message)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    (void)Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle, &fake_filter };
+    auto add_result = Broker_AddLink(broker, &link);
+    fake_filtered_message = message;
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_get_next_item(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_Find(IGNORED_PTR_ARG, fake_module_handle))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, LinkFilter_InitMessage(IGNORED_PTR_ARG, message))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
+    STRICT_EXPECTED_CALL(mocks, LinkFilter_MatchesMessage((LINK_FILTER_HANDLE)&fake_filter, IGNORED_PTR_ARG))
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Message_Clone(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
 
     ///act
-    result = Broker_Publish(broker, NULL, message);
+    auto result = Broker_Publish(broker, fake_module_handle, message);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, add_result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 0, currentWorkerPool_Schedule_call);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
@@ -2230,8 +3457,96 @@ TEST_FUNCTION(Broker_Publish_succeeds)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BCAST_BROKER_17_002: [ If source is not NULL, Broker_Publish shall not publish the message to the BROKER_MODULEINFO::module which matches source. ]
-TEST_FUNCTION(Broker_Publish_succeeds_skips_self)
+//Tests_SRS_BCAST_BROKER_13_162: [When it publishes to the sinks of source, if the route has a filter, the function shall test the messages against it by calling LinkFilter_MatchesMessage, skip the sink without acquiring its lock if none of them passes, and only append the messages that pass.]
+TEST_FUNCTION(Broker_Publish_without_source_ignores_the_filters)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    (void)Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle, &fake_filter };
+    (void)Broker_AddLink(broker, &link);
+    fake_filtered_message = message;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_Publish(broker, NULL, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, currentWorkerPool_Schedule_call);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_186: [If a sink of the routing entry of the source has a filter, Broker_Publish shall initialize a LINK_FILTER_MESSAGE for every message by calling LinkFilter_InitMessage before the loop, so that the filters of all the sinks share the properties and the hashes they look up; if it cannot allocate them for a batch, the function shall test the messages by calling LinkFilter_Matches instead.]
+TEST_FUNCTION(Broker_PublishBatch_tests_the_messages_with_LinkFilter_Matches_when_malloc_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    FAKE_MESSAGE_BATCH batch = { { Message_Create(&c), Message_Create(&c) }, 2 };
+    (void)Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle, &fake_filter };
+    (void)Broker_AddLink(broker, &link);
+    fake_filtered_message = batch.messages[0];
+    size_t pushes_before_publish = currentMessageQueue_Push_call;
+    whenShallmalloc_fail = currentmalloc_call + 1;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_PublishBatch(broker, fake_module_handle, (MESSAGE_BATCH_HANDLE)&batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, pushes_before_publish + 1, currentMessageQueue_Push_call);
+    ASSERT_ARE_EQUAL(size_t, 2, currentLinkFilter_Matches_call);
+    ASSERT_ARE_EQUAL(size_t, 0, currentLinkFilter_MatchesMessage_call);
+
+    ///cleanup
+    whenShallmalloc_fail = 0;
+    Message_Destroy(batch.messages[0]);
+    Message_Destroy(batch.messages[1]);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_160: [If the route from source to sink already exists and LinkFilter_IsSameAs tells that its filter is not link->filter, Broker_AddLink shall return BROKER_ADD_LINK_ERROR.]
+TEST_FUNCTION(Broker_AddLink_fails_when_the_link_exists_with_another_filter)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle, &fake_filter };
+    BROKER_LINK_DATA other_link = { fake_module_handle, fake_module_handle, &fake_filter2 };
+    (void)Broker_AddLink(broker, &link);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, LinkFilter_IsSameAs((LINK_FILTER_HANDLE)&fake_filter, &fake_filter2));
+
+    ///act
+    auto result = Broker_AddLink(broker, &other_link);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ADD_LINK_ERROR, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_131: [If source is not attached to the broker, Broker_Publish shall return BROKER_ERROR.]
+TEST_FUNCTION(Broker_Publish_fails_when_source_is_not_attached)
 {
 	///arrange
 	CBrokerMocks mocks;
@@ -2243,33 +3558,273 @@ TEST_FUNCTION(Broker_Publish_succeeds_skips_self)
 	MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
 	auto message = Message_Create(&c);
 
-	auto result = Broker_AddModule(broker, &fake_module);
-
 	mocks.ResetAllCalls();
 
-	// this is for Broker_Publish
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, list_get_next_item(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-
 	///act
-	result = Broker_Publish(broker, fake_module_handle, message);
+	auto result = Broker_Publish(broker, fake_module_handle, message);
 
 	///assert
-	ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
-	mocks.AssertActualAndExpectedCalls();
+	ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
 
 	///cleanup
 	Message_Destroy(message);
-	Broker_RemoveModule(broker, &fake_module);
 	Broker_Destroy(broker);
 }
 
+//Tests_SRS_BCAST_BROKER_13_168: [If broker or module_count is NULL, or statistics is NULL and *module_count is not 0, Broker_GetStatistics shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_GetStatistics_fails_with_null_statistics_and_room_for_modules)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    size_t module_count = 1;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_GetStatistics(broker, NULL, &module_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_167: [The function shall count the messages it appends, their bytes, the messages it drops and the highest depth of BROKER_MODULEINFO::mq in BROKER_MODULEINFO::queue_counters, and note when a message is appended to an empty queue.]
+//Tests_SRS_BCAST_BROKER_13_169: [Broker_GetStatistics shall lock BROKER_HANDLE_DATA::modules_lock, so that no module is removed while its counters are read.]
+//Tests_SRS_BCAST_BROKER_13_170: [Broker_GetStatistics shall fill the first *module_count elements of statistics with the counters of the modules of BROKER_HANDLE_DATA::modules, in the order they were added.]
+//Tests_SRS_BCAST_BROKER_13_171: [Broker_GetStatistics shall set *module_count to the number of modules of the broker, unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_OK.]
+//Tests_SRS_BCAST_BROKER_13_172: [Broker_GetStatistics shall read BROKER_MODULEINFO::queue_counters, the depth of BROKER_MODULEINFO::mq and its bytes under BROKER_MODULEINFO::mq_lock, and BROKER_MODULEINFO::delivery_counters without acquiring any lock.]
+TEST_FUNCTION(Broker_GetStatistics_counts_the_messages_queued_and_dropped)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_DROP_OLDEST, 0 } };
+    (void)Broker_AddModuleWithOptions(broker, &fake_module, &options);
+    (void)Broker_Publish(broker, NULL, message);
+    (void)Broker_Publish(broker, NULL, message);
+    BROKER_MODULE_STATISTICS statistics;
+    size_t module_count = 1;
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, list_get_next_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_GetStatistics(broker, &statistics, &module_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, module_count);
+    ASSERT_ARE_EQUAL(void_ptr, fake_module_handle, statistics.module_handle);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics.enqueued);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.dropped);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.delivered);
+    ASSERT_ARE_EQUAL(uint64_t, 2 * sizeof(fake_content_bytes), statistics.enqueued_bytes);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.queue_depth);
+    ASSERT_ARE_EQUAL(size_t, sizeof(fake_content_bytes), statistics.queued_bytes);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.queue_high_water_mark);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_165: [After taking the messages, the function shall record in BROKER_MODULEINFO::delivery_counters how long the oldest of them waited in the queue.]
+//Tests_SRS_BCAST_BROKER_13_166: [The function shall count every message it hands to the module and record how long each call to the module's receive functions took in BROKER_MODULEINFO::delivery_counters.]
+TEST_FUNCTION(module_publish_worker_counts_the_messages_delivered)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_Publish(broker, NULL, message);
+    BROKER_MODULE_STATISTICS statistics;
+    size_t module_count = 1;
+    uint64_t queue_wait_samples = 0;
+    uint64_t receive_duration_samples = 0;
+    mocks.ResetAllCalls();
+
+    ///act
+    strand_func_to_call(strand_func_args);
+    auto result = Broker_GetStatistics(broker, &statistics, &module_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.delivered);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.queue_depth);
+    for (size_t i = 0; i < BROKER_LATENCY_BUCKET_COUNT; i++)
+    {
+        queue_wait_samples += statistics.queue_wait.buckets[i];
+        receive_duration_samples += statistics.receive_duration.buckets[i];
+    }
+    ASSERT_ARE_EQUAL(uint64_t, 1, queue_wait_samples);
+    ASSERT_ARE_EQUAL(uint64_t, 1, receive_duration_samples);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_181: [If broker or module is NULL, Broker_ApplyModuleThreadOptions shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_ApplyModuleThreadOptions_fails_with_null_broker)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    ///act
+    auto result = Broker_ApplyModuleThreadOptions(NULL, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_BCAST_BROKER_13_184: [If the module was not added to the broker, the options cannot be applied or an underlying API call fails, Broker_ApplyModuleThreadOptions shall return BROKER_ERROR.]
+TEST_FUNCTION(Broker_ApplyModuleThreadOptions_fails_for_a_module_not_added)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_ApplyModuleThreadOptions(broker, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, result);
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_180: [The function shall copy the thread options of `options`, when `options` is not NULL, to BROKER_MODULEINFO::thread_options, and set them to 0 otherwise.]
+//Tests_SRS_BCAST_BROKER_13_182: [Broker_ApplyModuleThreadOptions shall lock BROKER_HANDLE_DATA::modules_lock and copy the BROKER_MODULEINFO::thread_options of module.]
+//Tests_SRS_BCAST_BROKER_13_183: [Broker_ApplyModuleThreadOptions shall apply the thread options to the calling thread by calling ThreadOptions_Apply after releasing the lock, and return BROKER_OK.]
+TEST_FUNCTION(Broker_ApplyModuleThreadOptions_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_ApplyModuleThreadOptions(broker, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_176: [If broker, link, link->module_source_handle, link->module_sink_handle or statistics is NULL, Broker_GetLinkStatistics shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_GetLinkStatistics_fails_with_null_link)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_LINK_STATISTICS statistics;
+
+    ///act
+    auto result = Broker_GetLinkStatistics((BROKER_HANDLE)0x1, NULL, &statistics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_BCAST_BROKER_13_174: [Broker_AddLink shall allocate zeroed BROKER_LINK_COUNTERS for the new route.]
+//Tests_SRS_BCAST_BROKER_13_175: [When it publishes over a route, the function shall count the messages it appends and their bytes in the BROKER_LINK_COUNTERS of the route, and the time it appended the last of them.]
+//Tests_SRS_BCAST_BROKER_13_177: [Broker_GetLinkStatistics shall lock BROKER_HANDLE_DATA::modules_lock and find the route from link->module_source_handle to link->module_sink_handle.]
+//Tests_SRS_BCAST_BROKER_13_178: [Broker_GetLinkStatistics shall read the BROKER_LINK_COUNTERS of the route under BROKER_MODULEINFO::mq_lock of the sink, fill statistics by calling BrokerStatistics_FillLink and return BROKER_OK.]
+TEST_FUNCTION(Broker_GetLinkStatistics_counts_the_messages_published_over_the_link_only)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    (void)Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle };
+    (void)Broker_AddLink(broker, &link);
+    (void)Broker_Publish(broker, fake_module_handle, message);
+    (void)Broker_Publish(broker, NULL, message);
+    BROKER_LINK_STATISTICS statistics;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_GetLinkStatistics(broker, &link, &statistics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.messages);
+    ASSERT_ARE_EQUAL(uint64_t, sizeof(fake_content_bytes), statistics.bytes);
+    ASSERT_IS_TRUE(statistics.last_activity != 0);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BCAST_BROKER_13_179: [If the route does not exist or an underlying API call fails, Broker_GetLinkStatistics shall return BROKER_ERROR.]
+TEST_FUNCTION(Broker_GetLinkStatistics_fails_when_the_link_was_removed)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle };
+    (void)Broker_AddLink(broker, &link);
+    (void)Broker_RemoveLink(broker, &link);
+    BROKER_LINK_STATISTICS statistics;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_GetLinkStatistics(broker, &link, &statistics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, result);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
 END_TEST_SUITE(broadcast_bus_ut)
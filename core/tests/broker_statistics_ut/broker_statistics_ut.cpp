@@ -0,0 +1,261 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cstdlib>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#include "testrunnerswitcher.h"
+#include "micromock.h"
+
+#include "internal/broker_statistics.h"
+
+static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
+static MICROMOCK_MUTEX_HANDLE g_testByTest;
+
+/*returns the sum of the buckets of a histogram*/
+static uint64_t count_samples(const BROKER_LATENCY_HISTOGRAM* histogram)
+{
+    uint64_t result = 0;
+    for (size_t i = 0; i < BROKER_LATENCY_BUCKET_COUNT; i++)
+    {
+        result += histogram->buckets[i];
+    }
+    return result;
+}
+
+BEGIN_TEST_SUITE(broker_statistics_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = MicroMockCreateMutex();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    MicroMockDestroyMutex(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (!MicroMockAcquireMutex(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    if (!MicroMockReleaseMutex(g_testByTest))
+    {
+        ASSERT_FAIL("failure in test framework at ReleaseMutex");
+    }
+}
+
+/*Tests_SRS_BROKER_STATISTICS_13_001: [ BrokerStatistics_GetTime shall return the number of microseconds read from a monotonic clock, QueryPerformanceCounter on Windows and clock_gettime with CLOCK_MONOTONIC elsewhere. ]*/
+TEST_FUNCTION(BrokerStatistics_GetTime_does_not_go_back)
+{
+    ///arrange
+    uint64_t first = BrokerStatistics_GetTime();
+
+    ///act
+    uint64_t second = BrokerStatistics_GetTime();
+
+    ///assert
+    ASSERT_IS_TRUE(first != 0);
+    ASSERT_IS_TRUE(second >= first);
+}
+
+/*Tests_SRS_BROKER_STATISTICS_13_003: [ If histogram is NULL, BrokerStatistics_RecordDuration shall do nothing. ]*/
+TEST_FUNCTION(BrokerStatistics_RecordDuration_with_NULL_histogram_does_nothing)
+{
+    ///act
+    BrokerStatistics_RecordDuration(NULL, 0, 10);
+
+    ///assert
+    /*no crash*/
+}
+
+/*Tests_SRS_BROKER_STATISTICS_13_005: [ BrokerStatistics_RecordDuration shall increment bucket 0 for a duration of 0 microseconds, bucket i for a duration of at least 2^(i-1) and less than 2^i microseconds, and the last bucket for the longer durations. ]*/
+TEST_FUNCTION(BrokerStatistics_RecordDuration_counts_durations_in_powers_of_two)
+{
+    ///arrange
+    BROKER_LATENCY_HISTOGRAM histogram;
+    memset(&histogram, 0, sizeof(histogram));
+
+    ///act
+    BrokerStatistics_RecordDuration(&histogram, 100, 100);
+    BrokerStatistics_RecordDuration(&histogram, 100, 101);
+    BrokerStatistics_RecordDuration(&histogram, 100, 102);
+    BrokerStatistics_RecordDuration(&histogram, 100, 103);
+    BrokerStatistics_RecordDuration(&histogram, 100, 104);
+    BrokerStatistics_RecordDuration(&histogram, 100, 100 + 1000);
+
+    ///assert
+    ASSERT_ARE_EQUAL(uint64_t, 1, histogram.buckets[0]);
+    ASSERT_ARE_EQUAL(uint64_t, 1, histogram.buckets[1]);
+    ASSERT_ARE_EQUAL(uint64_t, 2, histogram.buckets[2]);
+    ASSERT_ARE_EQUAL(uint64_t, 1, histogram.buckets[3]);
+    ASSERT_ARE_EQUAL(uint64_t, 1, histogram.buckets[10]);
+    ASSERT_ARE_EQUAL(uint64_t, 6, count_samples(&histogram));
+}
+
+/*Tests_SRS_BROKER_STATISTICS_13_005: [ BrokerStatistics_RecordDuration shall increment bucket 0 for a duration of 0 microseconds, bucket i for a duration of at least 2^(i-1) and less than 2^i microseconds, and the last bucket for the longer durations. ]*/
+TEST_FUNCTION(BrokerStatistics_RecordDuration_counts_long_durations_in_the_last_bucket)
+{
+    ///arrange
+    BROKER_LATENCY_HISTOGRAM histogram;
+    memset(&histogram, 0, sizeof(histogram));
+
+    ///act
+    BrokerStatistics_RecordDuration(&histogram, 0, (uint64_t)1 << (BROKER_LATENCY_BUCKET_COUNT - 2));
+    BrokerStatistics_RecordDuration(&histogram, 0, UINT64_MAX);
+
+    ///assert
+    ASSERT_ARE_EQUAL(uint64_t, 2, histogram.buckets[BROKER_LATENCY_BUCKET_COUNT - 1]);
+    ASSERT_ARE_EQUAL(uint64_t, 2, count_samples(&histogram));
+}
+
+/*Tests_SRS_BROKER_STATISTICS_13_004: [ BrokerStatistics_RecordDuration shall take a duration of 0 when end is before start. ]*/
+TEST_FUNCTION(BrokerStatistics_RecordDuration_counts_an_end_before_the_start_as_no_time)
+{
+    ///arrange
+    BROKER_LATENCY_HISTOGRAM histogram;
+    memset(&histogram, 0, sizeof(histogram));
+
+    ///act
+    BrokerStatistics_RecordDuration(&histogram, 100, 50);
+
+    ///assert
+    ASSERT_ARE_EQUAL(uint64_t, 1, histogram.buckets[0]);
+}
+
+/*Tests_SRS_BROKER_STATISTICS_13_006: [ If statistics or delivery_counters is NULL, BrokerStatistics_Fill shall do nothing. ]*/
+TEST_FUNCTION(BrokerStatistics_Fill_with_NULL_delivery_counters_does_nothing)
+{
+    ///arrange
+    BROKER_MODULE_STATISTICS statistics;
+    memset(&statistics, 0, sizeof(statistics));
+
+    ///act
+    BrokerStatistics_Fill(&statistics, (MODULE_HANDLE)0x42, NULL, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(statistics.module_handle);
+}
+
+/*Tests_SRS_BROKER_STATISTICS_13_008: [ Otherwise, BrokerStatistics_Fill shall copy the messages and bytes enqueued and the high-water mark of queue_counters, and add the messages the delivering thread discarded to its messages dropped. ]*/
+/*Tests_SRS_BROKER_STATISTICS_13_009: [ BrokerStatistics_Fill shall copy the messages delivered and both histograms of delivery_counters, and set the queue depth and the queued bytes to 0. ]*/
+TEST_FUNCTION(BrokerStatistics_Fill_copies_the_queue_and_delivery_counters)
+{
+    ///arrange
+    BROKER_QUEUE_COUNTERS queue_counters;
+    BROKER_DELIVERY_COUNTERS delivery_counters;
+    BROKER_MODULE_STATISTICS statistics;
+    memset(&queue_counters, 0, sizeof(queue_counters));
+    memset(&delivery_counters, 0, sizeof(delivery_counters));
+    memset(&statistics, 0xFF, sizeof(statistics));
+    queue_counters.enqueued = 10;
+    queue_counters.dropped = 2;
+    queue_counters.enqueued_bytes = 1000;
+    queue_counters.high_water_mark = 7;
+    delivery_counters.discarded = 1;
+    delivery_counters.delivered = 8;
+    delivery_counters.queue_wait.buckets[3] = 4;
+    delivery_counters.receive_duration.buckets[5] = 8;
+
+    ///act
+    BrokerStatistics_Fill(&statistics, (MODULE_HANDLE)0x42, &queue_counters, &delivery_counters);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, statistics.module_handle);
+    ASSERT_ARE_EQUAL(uint64_t, 10, statistics.enqueued);
+    ASSERT_ARE_EQUAL(uint64_t, 3, statistics.dropped);
+    ASSERT_ARE_EQUAL(uint64_t, 1000, statistics.enqueued_bytes);
+    ASSERT_ARE_EQUAL(uint64_t, 8, statistics.delivered);
+    ASSERT_ARE_EQUAL(size_t, 7, statistics.queue_high_water_mark);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.queue_depth);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.queued_bytes);
+    ASSERT_ARE_EQUAL(uint64_t, 4, statistics.queue_wait.buckets[3]);
+    ASSERT_ARE_EQUAL(uint64_t, 4, count_samples(&statistics.queue_wait));
+    ASSERT_ARE_EQUAL(uint64_t, 8, statistics.receive_duration.buckets[5]);
+    ASSERT_ARE_EQUAL(uint64_t, 8, count_samples(&statistics.receive_duration));
+}
+
+/*Tests_SRS_BROKER_STATISTICS_13_007: [ If queue_counters is NULL, BrokerStatistics_Fill shall take the messages and bytes received by the delivering thread as the messages and bytes enqueued, the messages it discarded as the messages dropped, and 0 as the high-water mark. ]*/
+TEST_FUNCTION(BrokerStatistics_Fill_without_queue_counters_uses_the_received_messages)
+{
+    ///arrange
+    BROKER_DELIVERY_COUNTERS delivery_counters;
+    BROKER_MODULE_STATISTICS statistics;
+    memset(&delivery_counters, 0, sizeof(delivery_counters));
+    memset(&statistics, 0xFF, sizeof(statistics));
+    delivery_counters.received = 5;
+    delivery_counters.received_bytes = 500;
+    delivery_counters.discarded = 1;
+    delivery_counters.delivered = 4;
+
+    ///act
+    BrokerStatistics_Fill(&statistics, (MODULE_HANDLE)0x42, NULL, &delivery_counters);
+
+    ///assert
+    ASSERT_ARE_EQUAL(uint64_t, 5, statistics.enqueued);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.dropped);
+    ASSERT_ARE_EQUAL(uint64_t, 500, statistics.enqueued_bytes);
+    ASSERT_ARE_EQUAL(uint64_t, 4, statistics.delivered);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.queue_high_water_mark);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.queue_depth);
+    ASSERT_ARE_EQUAL(uint64_t, 0, count_samples(&statistics.queue_wait));
+}
+
+/*Tests_SRS_BROKER_STATISTICS_13_011: [ BrokerStatistics_FillLink shall copy the messages and bytes of link_counters. ]*/
+/*Tests_SRS_BROKER_STATISTICS_13_012: [ If no message was routed over the link, BrokerStatistics_FillLink shall set the last activity to 0. ]*/
+TEST_FUNCTION(BrokerStatistics_FillLink_of_an_idle_link_has_no_last_activity)
+{
+    ///arrange
+    BROKER_LINK_COUNTERS link_counters;
+    BROKER_LINK_STATISTICS statistics;
+    memset(&link_counters, 0, sizeof(link_counters));
+    memset(&statistics, 0xFF, sizeof(statistics));
+
+    ///act
+    BrokerStatistics_FillLink(&statistics, &link_counters);
+
+    ///assert
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.messages);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.bytes);
+    ASSERT_IS_TRUE(statistics.last_activity == 0);
+}
+
+/*Tests_SRS_BROKER_STATISTICS_13_011: [ BrokerStatistics_FillLink shall copy the messages and bytes of link_counters. ]*/
+/*Tests_SRS_BROKER_STATISTICS_13_013: [ Otherwise, BrokerStatistics_FillLink shall set the last activity to the current calendar time minus the seconds elapsed on the monotonic clock since the last message was routed. ]*/
+TEST_FUNCTION(BrokerStatistics_FillLink_converts_the_last_activity_to_the_calendar_time)
+{
+    ///arrange
+    BROKER_LINK_COUNTERS link_counters;
+    BROKER_LINK_STATISTICS statistics;
+    link_counters.messages = 3;
+    link_counters.bytes = 300;
+    link_counters.last_activity_time = BrokerStatistics_GetTime() - 10 * 1000000;
+    time_t before = time(NULL);
+
+    ///act
+    BrokerStatistics_FillLink(&statistics, &link_counters);
+
+    ///assert
+    time_t after = time(NULL);
+    ASSERT_ARE_EQUAL(uint64_t, 3, statistics.messages);
+    ASSERT_ARE_EQUAL(uint64_t, 300, statistics.bytes);
+    ASSERT_IS_TRUE(statistics.last_activity >= before - 11);
+    ASSERT_IS_TRUE(statistics.last_activity <= after - 9);
+}
+
+END_TEST_SUITE(broker_statistics_ut)
@@ -5,7 +5,12 @@
 #include <crtdbg.h>
 #endif
 #include <cstdlib>
+#include <cerrno>
+#include <cstring>
 #include <signal.h>
+#if defined(__linux__)
+#include <pthread.h>
+#endif
 
 #include "testrunnerswitcher.h"
 #include "micromock.h"
@@ -19,6 +24,7 @@
 #include "azure_c_shared_utility/uniqueid.h"
 #include "nn.h"
 #include "pubsub.h"
+#include "internal/link_filter.h"
 
 static MICROMOCK_MUTEX_HANDLE g_testByTest;
 static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
@@ -49,6 +55,7 @@ namespace BASEIMPLEMENTATION
 
 #include "broker.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 
 DEFINE_MICROMOCK_ENUM_TO_STRING(BROKER_RESULT, BROKER_RESULT_VALUES);
 
@@ -91,7 +98,21 @@ static size_t whenShallCond_Post_fail;
 static size_t currentThreadAPI_Create_call;
 static size_t whenShallThreadAPI_Create_fail;
 
+/*a fake link filter is the address of its definition*/
+static size_t currentLinkFilter_Create_call;
+static size_t whenShallLinkFilter_Create_fail;
+static size_t currentLinkFilter_Destroy_call;
+static size_t currentLinkFilter_Matches_call;
+static size_t whenShallLinkFilter_Matches_fail;
+
+/*the source and the sequence number starting every frame*/
+#define TEST_FRAME_HEADER_SIZE (sizeof(MODULE_HANDLE) + sizeof(uint32_t))
+
 static size_t nn_current_msg_size;
+static MESSAGE_BYTE_ARRAY_RELEASE received_buffer_release;
+static void* received_buffer_context;
+static const unsigned char* nn_recv_frame;
+static size_t nn_recv_frame_size;
 
 typedef struct LIST_ITEM_INSTANCE_TAG
 {
@@ -154,6 +175,61 @@ MODULE fake_module =
 	fake_module_handle
 };
 
+static MESSAGE_HANDLE FakeModule_ReceiveOwned_last_message;
+
+static MODULE_HANDLE fake_owned_module_handle = (MODULE_HANDLE)0x43;
+static void FakeModule_ReceiveOwned(MODULE_HANDLE module, MESSAGE_HANDLE messageHandle)
+{
+	ASSERT_ARE_EQUAL(void_ptr, fake_owned_module_handle, module);
+	FakeModule_ReceiveOwned_last_message = messageHandle;
+}
+
+static MODULE_APIS fake_owned_module_apis =
+{
+	FakeModule_Create,
+	FakeModule_Destroy,
+	FakeModule_Receive,
+	NULL,
+	NULL,
+	FakeModule_ReceiveOwned
+};
+
+MODULE fake_owned_module =
+{
+	&fake_owned_module_apis,
+	fake_owned_module_handle
+};
+
+static MODULE_HANDLE fake_batch_module_handle = (MODULE_HANDLE)0x44;
+static size_t FakeModule_ReceiveBatch_last_count;
+static void FakeModule_ReceiveBatch(MODULE_HANDLE module, MESSAGE_HANDLE* messageHandles, size_t messageCount)
+{
+	ASSERT_ARE_EQUAL(void_ptr, fake_batch_module_handle, module);
+	FakeModule_ReceiveBatch_last_count = messageCount;
+}
+
+static MODULE_APIS fake_batch_module_apis =
+{
+	FakeModule_Create,
+	FakeModule_Destroy,
+	FakeModule_Receive,
+	NULL,
+	FakeModule_ReceiveBatch
+};
+
+MODULE fake_batch_module =
+{
+	&fake_batch_module_apis,
+	fake_batch_module_handle
+};
+
+/*a fake MESSAGE_BATCH_HANDLE*/
+typedef struct FAKE_MESSAGE_BATCH_TAG
+{
+	MESSAGE_HANDLE messages[2];
+	size_t count;
+} FAKE_MESSAGE_BATCH;
+
 class RefCountObject
 {
 private:
@@ -238,6 +314,42 @@ public:
         auto result2 = LOCK_OK;
     MOCK_METHOD_END(LOCK_RESULT, result2)
 
+    MOCK_STATIC_METHOD_0(, COND_HANDLE, Condition_Init)
+        COND_HANDLE result2;
+        ++currentCond_Init_call;
+        if ((whenShallCond_Init_fail > 0) &&
+            (currentCond_Init_call == whenShallCond_Init_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = (COND_HANDLE)malloc(2);
+        }
+    MOCK_METHOD_END(COND_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, COND_RESULT, Condition_Post, COND_HANDLE, handle)
+        COND_RESULT result2;
+        ++currentCond_Post_call;
+        if ((whenShallCond_Post_fail > 0) &&
+            (currentCond_Post_call == whenShallCond_Post_fail))
+        {
+            result2 = COND_ERROR;
+        }
+        else
+        {
+            result2 = COND_OK;
+        }
+    MOCK_METHOD_END(COND_RESULT, result2)
+
+    MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds)
+        auto result2 = COND_TIMEOUT;
+    MOCK_METHOD_END(COND_RESULT, result2)
+
+    MOCK_STATIC_METHOD_1(, void, Condition_Deinit, COND_HANDLE, handle)
+        free(handle);
+    MOCK_VOID_METHOD_END()
+
         MOCK_STATIC_METHOD_1(, VECTOR_HANDLE, VECTOR_create, size_t, elementSize)
         VECTOR_HANDLE result2;
         ++currentVECTOR_create_call;
@@ -339,12 +451,39 @@ public:
         ((RefCountObject*)message)->dec_ref();
 	MOCK_VOID_METHOD_END()
 
-	MOCK_STATIC_METHOD_2(, MESSAGE_HANDLE, Message_CreateFromByteArray, const unsigned char*, source, int32_t, size)
+	MOCK_STATIC_METHOD_4(, MESSAGE_HANDLE, Message_CreateFromByteArrayNoCopy, const unsigned char*, source, int32_t, size, MESSAGE_BYTE_ARRAY_RELEASE, release, void*, context)
+		received_buffer_release = release;
+		received_buffer_context = context;
 	MOCK_METHOD_END(MESSAGE_HANDLE, (MESSAGE_HANDLE)(new RefCountObject()))
 
-	MOCK_STATIC_METHOD_3(, int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char *, buffer, int32_t, size)
+	// link_filter.h
+	MOCK_STATIC_METHOD_1(, LINK_FILTER_HANDLE, LinkFilter_Create, const BROKER_LINK_FILTER*, definition)
+		currentLinkFilter_Create_call++;
+	MOCK_METHOD_END(LINK_FILTER_HANDLE, (currentLinkFilter_Create_call == whenShallLinkFilter_Create_fail) ? NULL : (LINK_FILTER_HANDLE)definition)
+
+	MOCK_STATIC_METHOD_1(, void, LinkFilter_Destroy, LINK_FILTER_HANDLE, filter)
+		if (filter != NULL)
+		{
+			currentLinkFilter_Destroy_call++;
+		}
+	MOCK_VOID_METHOD_END()
+
+	MOCK_STATIC_METHOD_2(, int, LinkFilter_IsSameAs, LINK_FILTER_HANDLE, filter, const BROKER_LINK_FILTER*, definition)
+	MOCK_METHOD_END(int, (filter == (LINK_FILTER_HANDLE)definition) ? 1 : 0)
+
+	MOCK_STATIC_METHOD_2(, int, LinkFilter_Matches, LINK_FILTER_HANDLE, filter, MESSAGE_HANDLE, message)
+		currentLinkFilter_Matches_call++;
+	MOCK_METHOD_END(int, (currentLinkFilter_Matches_call == whenShallLinkFilter_Matches_fail) ? 0 : 1)
+
+	MOCK_STATIC_METHOD_4(, int32_t, Message_ToByteArrayWithFormat, MESSAGE_HANDLE, messageHandle, MESSAGE_WIRE_FORMAT, format, unsigned char *, buffer, int32_t, size)
 	MOCK_METHOD_END(int32_t, (int32_t)1)
 
+	MOCK_STATIC_METHOD_1(, size_t, MessageBatch_GetCount, MESSAGE_BATCH_HANDLE, batch)
+	MOCK_METHOD_END(size_t, ((FAKE_MESSAGE_BATCH*)batch)->count)
+
+	MOCK_STATIC_METHOD_1(, const MESSAGE_HANDLE*, MessageBatch_GetMessages, MESSAGE_BATCH_HANDLE, batch)
+	MOCK_METHOD_END(const MESSAGE_HANDLE*, ((FAKE_MESSAGE_BATCH*)batch)->messages)
+
     // list.h
 
     MOCK_STATIC_METHOD_0(, LIST_HANDLE, list_create)
@@ -554,14 +693,29 @@ public:
 		}
 	MOCK_METHOD_END(int, send_length)
 
+	MOCK_STATIC_METHOD_3(, int, nn_poll, struct nn_pollfd*, fds, int, nfds, int, timeout)
+	MOCK_METHOD_END(int, 0)
+
+	MOCK_STATIC_METHOD_0(, int, nn_errno)
+	MOCK_METHOD_END(int, EBADF)
+
 	MOCK_STATIC_METHOD_4(, int, nn_recv, int, s, void*, buf, size_t, len, int, flags)
 		int rcv_length; 
-		if (len == NN_MSG)
+		if (len == NN_MSG && nn_recv_frame != NULL)
+		{
+			(*(void**)buf) = malloc(nn_recv_frame_size);
+			memcpy((*(void**)buf), nn_recv_frame, nn_recv_frame_size);
+			rcv_length = (int)nn_recv_frame_size;
+			nn_recv_frame = NULL;
+		}
+		else if (len == NN_MSG)
 		{
+			/*a frame longer than its header, also big enough for the tests returning the size of a quit message*/
 			char * text = (char*)"nn_recv";
-			(*(void**)buf) = malloc(8);
+			(*(void**)buf) = malloc(64);
+			memset((*(void**)buf), 0, 64);
 			memcpy((*(void**)buf), text, 8);
-			rcv_length = 8;
+			rcv_length = (int)(TEST_FRAME_HEADER_SIZE + 4);
 		}
 		else
 		{
@@ -578,6 +732,11 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Lock, LOCK_HANDLE, loc
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Unlock, LOCK_HANDLE, lock);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, lock);
 
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , COND_HANDLE, Condition_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , COND_RESULT, Condition_Post, COND_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, Condition_Deinit, COND_HANDLE, handle);
+
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , VECTOR_HANDLE, VECTOR_create, size_t, elementSize);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, VECTOR_destroy, VECTOR_HANDLE, vector);
 DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , int, VECTOR_push_back, VECTOR_HANDLE, vector, const void*, elements, size_t, numElements);
@@ -594,8 +753,15 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , THREADAPI_RESULT, ThreadAPI_Join, T
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, Message_Destroy, MESSAGE_HANDLE, message);
-DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , MESSAGE_HANDLE, Message_CreateFromByteArray, const unsigned char*, source, int32_t, size);
-DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char *, buffer, int32_t, size);
+DECLARE_GLOBAL_MOCK_METHOD_4(CBrokerMocks, , MESSAGE_HANDLE, Message_CreateFromByteArrayNoCopy, const unsigned char*, source, int32_t, size, MESSAGE_BYTE_ARRAY_RELEASE, release, void*, context);
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LINK_FILTER_HANDLE, LinkFilter_Create, const BROKER_LINK_FILTER*, definition);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, LinkFilter_Destroy, LINK_FILTER_HANDLE, filter);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, LinkFilter_IsSameAs, LINK_FILTER_HANDLE, filter, const BROKER_LINK_FILTER*, definition);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, LinkFilter_Matches, LINK_FILTER_HANDLE, filter, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_4(CBrokerMocks, , int32_t, Message_ToByteArrayWithFormat, MESSAGE_HANDLE, messageHandle, MESSAGE_WIRE_FORMAT, format, unsigned char *, buffer, int32_t, size);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , size_t, MessageBatch_GetCount, MESSAGE_BATCH_HANDLE, batch);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , const MESSAGE_HANDLE*, MessageBatch_GetMessages, MESSAGE_BATCH_HANDLE, batch);
 
 // list.h
 DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , LIST_HANDLE, list_create);
@@ -626,6 +792,53 @@ DECLARE_GLOBAL_MOCK_METHOD_5(CBrokerMocks, , int, nn_setsockopt, int, s, int, le
 DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, nn_connect, int, s, const char *, addr)
 DECLARE_GLOBAL_MOCK_METHOD_4(CBrokerMocks, , int, nn_send, int, s, const void*, buf, size_t, len, int, flags)
 DECLARE_GLOBAL_MOCK_METHOD_4(CBrokerMocks, , int, nn_recv, int, s, void*, buf, size_t, len, int, flags)
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , int, nn_poll, struct nn_pollfd*, fds, int, nfds, int, timeout)
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , int, nn_errno)
+
+/*builds a frame of fake_module_handle starting with the given sequence number, holding a batch of 2 messages of 1 byte each when batch is true or a message of 1 byte otherwise*/
+static size_t build_test_frame(unsigned char* frame, uint32_t sequence, bool batch)
+{
+    size_t frame_size;
+    memcpy(frame, &fake_module_handle, sizeof(MODULE_HANDLE));
+    memcpy(frame + sizeof(MODULE_HANDLE), &sequence, sizeof(uint32_t));
+    if (batch)
+    {
+        int32_t count = 2;
+        int32_t size = 1;
+        frame[TEST_FRAME_HEADER_SIZE] = 0xBA;
+        memcpy(frame + TEST_FRAME_HEADER_SIZE + 1, &count, sizeof(int32_t));
+        memcpy(frame + TEST_FRAME_HEADER_SIZE + 1 + sizeof(int32_t), &size, sizeof(int32_t));
+        frame[TEST_FRAME_HEADER_SIZE + 1 + 2 * sizeof(int32_t)] = 0xA1;
+        memcpy(frame + TEST_FRAME_HEADER_SIZE + 2 + 2 * sizeof(int32_t), &size, sizeof(int32_t));
+        frame[TEST_FRAME_HEADER_SIZE + 2 + 3 * sizeof(int32_t)] = 0xA1;
+        frame_size = TEST_FRAME_HEADER_SIZE + 1 + sizeof(int32_t) + 2 * (sizeof(int32_t) + 1);
+    }
+    else
+    {
+        frame[TEST_FRAME_HEADER_SIZE] = 0xA1;
+        frame_size = TEST_FRAME_HEADER_SIZE + 1;
+    }
+    return frame_size;
+}
+
+/*runs the worker of the module added last until it receives the frame and then a quit message*/
+static void run_test_worker(CBrokerMocks& mocks, const unsigned char* frame, size_t frame_size)
+{
+    nn_recv_frame = frame;
+    nn_recv_frame_size = frame_size;
+    mocks.ResetAllCalls();
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(37);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn("nn_recv");
+    (void)thread_func_to_call(thread_func_args);
+}
 
 BEGIN_TEST_SUITE(broker_ut)
 
@@ -687,6 +900,12 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     currentThreadAPI_Create_call = 0;
     whenShallThreadAPI_Create_fail = 0;
 
+    currentLinkFilter_Create_call = 0;
+    whenShallLinkFilter_Create_fail = 0;
+    currentLinkFilter_Destroy_call = 0;
+    currentLinkFilter_Matches_call = 0;
+    whenShallLinkFilter_Matches_fail = 0;
+
 	current_nn_socket_index = 0;
 	for (int l = 0; l < 10; l++)
 	{
@@ -694,6 +913,10 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 	}
 
 	nn_current_msg_size = 0;
+	received_buffer_release = NULL;
+	received_buffer_context = NULL;
+	nn_recv_frame = NULL;
+	nn_recv_frame_size = 0;
 
     thread_func_to_call = NULL;
     thread_func_args = NULL;
@@ -702,6 +925,9 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     call_status_for_FakeModule_Receive.messageHandle = NULL;
     call_status_for_FakeModule_Receive.module = NULL;
     call_status_for_FakeModule_Receive.was_called = false;
+
+    FakeModule_ReceiveOwned_last_message = NULL;
+    FakeModule_ReceiveBatch_last_count = 0;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -715,6 +941,7 @@ TEST_FUNCTION_CLEANUP(TestMethodCleanup)
 //Tests_SRS_BROKER_13_001: [This API shall yield a BROKER_HANDLE representing the newly created message broker. This handle value shall not be equal to NULL when the API call is successful.]
 //Tests_SRS_BROKER_13_007: [Broker_Create shall initialize BROKER_HANDLE_DATA::modules with a valid VECTOR_HANDLE.]
 //Tests_SRS_BROKER_13_023: [Broker_Create shall initialize BROKER_HANDLE_DATA::modules_lock with a valid LOCK_HANDLE.]
+//Tests_SRS_BROKER_13_154: [ Broker_Create shall initialize BROKER_HANDLE_DATA::publish_lock with a valid LOCK_HANDLE and set BROKER_HANDLE_DATA::publishers and BROKER_HANDLE_DATA::space_cond to NULL. ]
 //Tests_SRS_BROKER_17_001: [ Broker_Create shall initialize a socket for publishing messages. ]
 //Tests_SRS_BROKER_17_002: [ Broker_Create shall create a unique id. ]
 //Tests_SRS_BROKER_17_003: [ Broker_Create shall initialize a url consisting of "inproc://" + unique id. ]
@@ -727,6 +954,7 @@ TEST_FUNCTION(Broker_Create_succeeds)
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, list_create());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
     STRICT_EXPECTED_CALL(mocks, Lock_Init());
 	STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
 	STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
@@ -751,6 +979,41 @@ TEST_FUNCTION(Broker_Create_succeeds)
     Broker_Destroy(r);
 }
 
+//Tests_SRS_BROKER_13_117: [Broker_CreateWithOptions shall behave as Broker_Create; the worker_count option is ignored because every module has its own receiving thread.]
+TEST_FUNCTION(Broker_CreateWithOptions_ignores_the_worker_count)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_OPTIONS options = { 4 };
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_create());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+	STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
+	STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, STRING_construct("inproc://"));
+	STRICT_EXPECTED_CALL(mocks, STRING_concat(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, nn_bind(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2); 
+	STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+    ///act
+    auto r = Broker_CreateWithOptions(&options);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(r);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(r);
+}
+
 //Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
 /*Tests_SRS_BROKER_13_067: [ Broker_Create shall malloc a new instance of BROKER_HANDLE_DATA and return NULL if it fails. ]*/
 TEST_FUNCTION(Broker_Create_fails_when_malloc_fails)
@@ -822,6 +1085,36 @@ TEST_FUNCTION(Broker_Create_fails_when_Lock_Init_fails)
 }
 
 
+//Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
+TEST_FUNCTION(Broker_Create_fails_when_publish_lock_Init_fails)
+{
+    ///arrange
+
+    CBrokerMocks mocks;
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_create());
+    STRICT_EXPECTED_CALL(mocks, list_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShallLock_Init_fail = 2;
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+
+    ///act
+    auto r = Broker_Create();
+
+    ///assert
+    ASSERT_IS_NULL(r);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+
 //Tests_SRS_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
 TEST_FUNCTION(Broker_Create_fails_when_socket_fails)
 {
@@ -836,6 +1129,9 @@ TEST_FUNCTION(Broker_Create_fails_when_socket_fails)
 	STRICT_EXPECTED_CALL(mocks, list_destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, Lock_Init());
+	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Lock_Init());
 	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB))
@@ -867,6 +1163,9 @@ TEST_FUNCTION(Broker_Create_fails_when_uuid_fails)
 	STRICT_EXPECTED_CALL(mocks, list_destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, Lock_Init());
+	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Lock_Init());
 	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
@@ -902,6 +1201,9 @@ TEST_FUNCTION(Broker_Create_fails_when_url_create_fails)
 	STRICT_EXPECTED_CALL(mocks, list_destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, Lock_Init());
+	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Lock_Init());
 	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
@@ -938,6 +1240,9 @@ TEST_FUNCTION(Broker_Create_fails_when_url_concat_fails)
 	STRICT_EXPECTED_CALL(mocks, list_destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, Lock_Init());
+	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Lock_Init());
 	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
@@ -978,6 +1283,9 @@ TEST_FUNCTION(Broker_Create_fails_when_bind_fails)
 	STRICT_EXPECTED_CALL(mocks, list_destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, Lock_Init());
+	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Lock_Init());
 	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PUB));
@@ -1140,37 +1448,6 @@ TEST_FUNCTION(Broker_AddModule_fails_when_module_struct_alloc_fails)
 	Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_AddModule_fails_when_Lock_Init_fails)
-{
-    ///arrange
-    CBrokerMocks mocks;
-    auto broker = Broker_Create();
-    mocks.ResetAllCalls();
-
-    // this is for the Broker_AddModule call
-    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-    whenShallLock_Init_fail = currentLock_Init_call + 1;
-    STRICT_EXPECTED_CALL(mocks, Lock_Init());
-
-    ///act
-    auto result = Broker_AddModule(broker, &fake_module);
-
-    ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
-    Broker_Destroy(broker);
-}
-
 //Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
 TEST_FUNCTION(Broker_AddModule_fails_quit_uuid_fails)
 {
@@ -1188,9 +1465,6 @@ TEST_FUNCTION(Broker_AddModule_fails_quit_uuid_fails)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock_Init());
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
 		.IgnoreArgument(1)
 		.SetFailReturn(UNIQUEID_ERROR);
@@ -1223,9 +1497,6 @@ TEST_FUNCTION(Broker_AddModule_fails_string_construct_fails)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Lock_Init());
-	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
@@ -1260,9 +1531,6 @@ TEST_FUNCTION(Broker_AddModule_fails_Lock_modules_lock_fails)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Lock_Init());
-	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
@@ -1301,9 +1569,6 @@ TEST_FUNCTION(Broker_AddModule_fails_when_list_add_fails)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Lock_Init());
-	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
@@ -1347,9 +1612,6 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_socket_fails)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Lock_Init());
-	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
@@ -1395,9 +1657,6 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_connect_fails)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Lock_Init());
-	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
@@ -1449,9 +1708,6 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_setSocketOpts_fails)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Lock_Init());
-	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
@@ -1510,9 +1766,6 @@ TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock_Init());
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
@@ -1561,7 +1814,7 @@ TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
 //Tests_SRS_BROKER_13_107 : [The function shall assign the module handle to BROKER_MODULEINFO::module.]
 //Tests_SRS_BROKER_17_013: [ The function shall create a nanomsg socket for reception. ]
 //Tests_SRS_BROKER_17_014: [ The function shall bind the socket to the the BROKER_HANDLE_DATA::url. ]
-//Tests_SRS_BROKER_13_099: [ The function shall initialize BROKER_MODULEINFO::socket_lock with a valid lock handle. ]
+//Tests_SRS_BROKER_13_099: [ The function shall set BROKER_MODULEINFO::quit_requested to 0. ]
 //Tests_SRS_BROKER_17_020: [ The function shall create a unique ID used as a quit signal. ]
 //Tests_SRS_BROKER_13_102 : [The function shall create a new thread for the module by calling ThreadAPI_Create using module_publish_worker as the thread callback and using the newly allocated BROKER_MODULEINFO object as the thread context.]
 //Tests_SRS_BROKER_13_039 : [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]
@@ -1569,6 +1822,7 @@ TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
 //Tests_SRS_BROKER_13_046 : [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]
 //Tests_SRS_BROKER_13_047 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
 //Tests_SRS_BROKER_17_028: [ The function shall subscribe BROKER_MODULEINFO::receive_socket to the quit signal GUID. ]
+//Tests_SRS_BROKER_13_176: [ The first time a module handle is started on the broker, Broker_AddModuleWithOptions shall add to BROKER_HANDLE_DATA::sources an entry with a send_lock numbering the messages the module publishes; the entry is kept until the broker is destroyed. ]
 TEST_FUNCTION(Broker_AddModule_succeeds)
 {
     ///arrange
@@ -1583,13 +1837,19 @@ TEST_FUNCTION(Broker_AddModule_succeeds)
 		.IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, list_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Lock_Init());
 	STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the source numbering*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()); /*this is the send_lock of the source*/
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the publish_lock*/
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_SUB));
@@ -1619,54 +1879,105 @@ TEST_FUNCTION(Broker_AddModule_succeeds)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_026: [ This function shall assign user_data to a local variable called module_info of type BROKER_MODULEINFO*. ]
-//Tests_SRS_BROKER_13_089: [ This function shall acquire the lock on module_info->socket_lock. ]
-//Tests_SRS_BROKER_13_068: [ This function shall run a loop that keeps running until module_info->quit_message_guid is sent to the thread. ]
-//Tests_SRS_BROKER_13_091: [ The function shall unlock module_info->socket_lock. ]
-//Tests_SRS_BROKER_17_005: [ For every iteration of the loop, the function shall wait on the receive_socket for messages. ]
-//Tests_SRS_BROKER_17_017: [ The function shall deserialize the message received. ]
-//Tests_SRS_BROKER_13_092: [ The function shall deliver the message to the module's callback function via module_info->module_apis. ]
-//Tests_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]
-//Tests_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]
-//Tests_SRS_BROKER_17_024: [ The function shall strip off the topic from the message. ]
-TEST_FUNCTION(module_publish_worker_calls_receive_once_then_exits_on_quit_msg)
+//Tests_SRS_BROKER_13_114: [The function shall use the queue's max_bytes, when `options` is not NULL and it is not 0, as the receive buffer size of the module's socket.]
+//Tests_SRS_BROKER_13_115: [If BROKER_MODULEINFO::receive_buffer_size is not 0, the function shall set it as the NN_RCVBUF option of the socket.]
+TEST_FUNCTION(Broker_AddModuleWithOptions_sets_the_receive_buffer_size)
 {
-	CBrokerMocks mocks;
-	auto broker = Broker_Create();
-
-	// setup fake module's validation data
-	unsigned char fake;
-	MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
-	auto message = Message_Create(&c);
-	call_status_for_FakeModule_Receive.module = fake_module.module_handle;
-	call_status_for_FakeModule_Receive.messageHandle = message;
-
-	auto add_result = Broker_AddModule(broker, &fake_module);
-
-	mocks.ResetAllCalls();
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 0, 4096, BROKER_QUEUE_DROP_NEWEST, 0 } };
+    mocks.ResetAllCalls();
 
-	//loop 1
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+    // this is for the Broker_AddModuleWithOptions call
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, list_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the source numbering*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()); /*this is the send_lock of the source*/
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the publish_lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_SUB));
+	STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-
-	//loop 2
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(mocks, nn_connect(IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 36))
+		.IgnoreArgument(1)
+		.IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SOL_SOCKET, NN_RCVBUF, IGNORED_PTR_ARG, sizeof(int)))
+		.IgnoreArgument(1)
+		.IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    auto result = Broker_AddModuleWithOptions(broker, &fake_module, &options);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_026: [ This function shall assign user_data to a local variable called module_info of type BROKER_MODULEINFO*. ]
+//Tests_SRS_BROKER_13_068: [ This function shall run a loop that keeps running until module_info->quit_message_guid is sent to the thread. ]
+//Tests_SRS_BROKER_13_166: [ The function shall stop before receiving the next message once BROKER_MODULEINFO::quit_requested is set. ]
+//Tests_SRS_BROKER_17_005: [ For every iteration of the loop, the function shall receive the next message pending on the receive_socket with NN_DONTWAIT. ]
+//Tests_SRS_BROKER_17_017: [ The function shall deserialize the message received by calling Message_CreateFromByteArrayNoCopy, so that the message references the buffer received instead of copying it. ]
+//Tests_SRS_BROKER_13_092: [ The function shall deliver the message to the module's callback function via module_info->module_apis. ]
+//Tests_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]
+//Tests_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket when no message references it. ]
+//Tests_SRS_BROKER_17_024: [ The function shall strip off the topic and the sequence number from the message. ]
+//Tests_SRS_BROKER_13_120: [ The message shall free the buffer received by calling nn_freemsg when it is destroyed. ]
+TEST_FUNCTION(module_publish_worker_calls_receive_once_then_exits_on_quit_msg)
+{
+	CBrokerMocks mocks;
+	auto broker = Broker_Create();
+
+	// setup fake module's validation data
+	unsigned char fake;
+	MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+	auto message = Message_Create(&c);
+	call_status_for_FakeModule_Receive.module = fake_module.module_handle;
+	call_status_for_FakeModule_Receive.messageHandle = message;
+
+	auto add_result = Broker_AddModule(broker, &fake_module);
+
+	mocks.ResetAllCalls();
+
+	//loop 1
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArrayNoCopy(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+
+	//loop 2
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2)
 		.SetReturn(37);
@@ -1684,87 +1995,299 @@ TEST_FUNCTION(module_publish_worker_calls_receive_once_then_exits_on_quit_msg)
 	ASSERT_ARE_EQUAL(int, result, 0);
 	mocks.AssertActualAndExpectedCalls();
 
+	// the message references the buffer received and frees it when destroyed
+	ASSERT_IS_NOT_NULL(received_buffer_context);
+	mocks.ResetAllCalls();
+	STRICT_EXPECTED_CALL(mocks, nn_freemsg(received_buffer_context));
+	received_buffer_release(received_buffer_context);
+	mocks.AssertActualAndExpectedCalls();
+
 	///cleanup
 	Message_Destroy(message);
 	Broker_RemoveModule(broker, &fake_module);
 	Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_02_004: [ If acquiring the lock fails, then module_publish_worker shall return. ]
-TEST_FUNCTION(module_publish_worker_exits_on_lock_fail)
+//Tests_SRS_BROKER_13_119: [If the module implements Module_ReceiveOwned, the function shall deliver the message through it and shall not destroy the message.]
+TEST_FUNCTION(module_publish_worker_hands_message_ownership_to_Module_ReceiveOwned)
 {
 	CBrokerMocks mocks;
 	auto broker = Broker_Create();
+	auto add_result = Broker_AddModule(broker, &fake_owned_module);
 
-	// setup fake module's validation data
-	unsigned char fake;
-	MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
-	auto message = Message_Create(&c);
-	call_status_for_FakeModule_Receive.module = fake_module.module_handle;
-	call_status_for_FakeModule_Receive.messageHandle = message;
+	mocks.ResetAllCalls();
+
+	//loop 1
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArrayNoCopy(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+
+	//loop 2
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2)
+		.SetReturn(37);
+	STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetFailReturn("nn_recv");
+
+	auto result = thread_func_to_call(thread_func_args);
+
+	ASSERT_ARE_EQUAL(int, result, 0);
+	mocks.AssertActualAndExpectedCalls();
+	ASSERT_IS_NOT_NULL(FakeModule_ReceiveOwned_last_message);
+	ASSERT_IS_FALSE(call_status_for_FakeModule_Receive.was_called);
+
+	///cleanup
+	received_buffer_release(received_buffer_context);
+	Message_Destroy(FakeModule_ReceiveOwned_last_message);
+	Broker_RemoveModule(broker, &fake_owned_module);
+	Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_123: [ If the byte following the header of the frame is the batch frame marker, the function shall deliver the messages of the batch frame. ]
+//Tests_SRS_BROKER_13_124: [ The function shall deserialize every message of the batch frame by calling Message_CreateFromByteArrayNoCopy, so that the messages reference the buffer received, and shall free the buffer when the last of them is destroyed. ]
+//Tests_SRS_BROKER_13_128: [ If the module implements Module_ReceiveBatch, the function shall deliver all the messages of the batch frame through one call to it and shall then destroy them. ]
+TEST_FUNCTION(module_publish_worker_delivers_a_batch_frame_through_one_Module_ReceiveBatch_call)
+{
+	CBrokerMocks mocks;
+	auto broker = Broker_Create();
+	auto add_result = Broker_AddModule(broker, &fake_batch_module);
+
+	// topic, sequence number, marker, 2 messages of 1 byte each
+	unsigned char frame[TEST_FRAME_HEADER_SIZE + 1 + sizeof(int32_t) + 2 * (sizeof(int32_t) + 1)];
+	int32_t count = 2;
+	int32_t size = 1;
+	memcpy(frame, &fake_module_handle, sizeof(MODULE_HANDLE));
+	memset(frame + sizeof(MODULE_HANDLE), 0, sizeof(uint32_t));
+	frame[TEST_FRAME_HEADER_SIZE] = 0xBA;
+	memcpy(frame + TEST_FRAME_HEADER_SIZE + 1, &count, sizeof(int32_t));
+	memcpy(frame + TEST_FRAME_HEADER_SIZE + 1 + sizeof(int32_t), &size, sizeof(int32_t));
+	frame[TEST_FRAME_HEADER_SIZE + 1 + 2 * sizeof(int32_t)] = 0xA1;
+	memcpy(frame + TEST_FRAME_HEADER_SIZE + 2 + 2 * sizeof(int32_t), &size, sizeof(int32_t));
+	frame[sizeof(frame) - 1] = 0xA1;
+	nn_recv_frame = frame;
+	nn_recv_frame_size = sizeof(frame);
+
+	mocks.ResetAllCalls();
+
+	//loop 1
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*the reference to the buffer received*/
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(2 * sizeof(MESSAGE_HANDLE)));
+	STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArrayNoCopy(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(3)
+		.IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArrayNoCopy(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(3)
+		.IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	//loop 2
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2)
+		.SetReturn(37);
+	STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetFailReturn("nn_recv");
+
+	auto result = thread_func_to_call(thread_func_args);
+
+	ASSERT_ARE_EQUAL(int, result, 0);
+	mocks.AssertActualAndExpectedCalls();
+	ASSERT_ARE_EQUAL(size_t, 2, FakeModule_ReceiveBatch_last_count);
+	ASSERT_IS_FALSE(call_status_for_FakeModule_Receive.was_called);
+
+	// both messages reference the buffer received, the last one frees it
+	ASSERT_IS_NOT_NULL(received_buffer_context);
+	mocks.ResetAllCalls();
+	received_buffer_release(received_buffer_context);
+	mocks.AssertActualAndExpectedCalls();
+	STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(received_buffer_context));
+	received_buffer_release(received_buffer_context);
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	Broker_RemoveModule(broker, &fake_batch_module);
+	Broker_Destroy(broker);
+}
 
+//Tests_SRS_BROKER_17_005: [ For every iteration of the loop, the function shall receive the next message pending on the receive_socket with NN_DONTWAIT. ]
+//Tests_SRS_BROKER_13_167: [ Once no message is pending, the function shall wait on the receive_socket with nn_poll for at most MODULE_WORKER_POLL_TIMEOUT_MS milliseconds. ]
+TEST_FUNCTION(module_publish_worker_polls_the_socket_when_no_message_is_pending)
+{
+	CBrokerMocks mocks;
+	auto broker = Broker_Create();
 	auto add_result = Broker_AddModule(broker, &fake_module);
 
 	mocks.ResetAllCalls();
 
 	//loop 1
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
 		.IgnoreArgument(1)
-		.SetFailReturn(LOCK_ERROR);
+		.IgnoreArgument(2)
+		.SetFailReturn(-1);
+	STRICT_EXPECTED_CALL(mocks, nn_errno())
+		.SetReturn(EAGAIN);
+	STRICT_EXPECTED_CALL(mocks, nn_poll(IGNORED_PTR_ARG, 1, 100))
+		.IgnoreArgument(1);
 
+	//loop 2
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2)
+		.SetReturn(37);
+	STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetFailReturn("nn_recv");
 
 	auto result = thread_func_to_call(thread_func_args);
 
 	ASSERT_ARE_EQUAL(int, result, 0);
 	mocks.AssertActualAndExpectedCalls();
+	ASSERT_IS_FALSE(call_status_for_FakeModule_Receive.was_called);
 
 	///cleanup
-	Message_Destroy(message);
 	Broker_RemoveModule(broker, &fake_module);
 	Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_091: [ The function shall unlock module_info->socket_lock. ]
-//Tests_SRS_BROKER_17_016: [ If releasing the lock fails, then module_publish_worker shall return. ]
-TEST_FUNCTION(module_publish_worker_exits_on_Unlock_fail)
+//Tests_SRS_BROKER_13_168: [ An error on waiting for a message, other than an interruption by a signal, shall terminate the loop. ]
+TEST_FUNCTION(module_publish_worker_exits_on_nn_poll_error)
 {
 	CBrokerMocks mocks;
 	auto broker = Broker_Create();
+	auto add_result = Broker_AddModule(broker, &fake_module);
 
-	// setup fake module's validation data
-	unsigned char fake;
-	MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
-	auto message = Message_Create(&c);
-	call_status_for_FakeModule_Receive.module = fake_module.module_handle;
-	call_status_for_FakeModule_Receive.messageHandle = message;
+	mocks.ResetAllCalls();
+
+	//loop 1
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2)
+		.SetFailReturn(-1);
+	STRICT_EXPECTED_CALL(mocks, nn_errno())
+		.SetReturn(EAGAIN);
+	STRICT_EXPECTED_CALL(mocks, nn_poll(IGNORED_PTR_ARG, 1, 100))
+		.IgnoreArgument(1)
+		.SetFailReturn(-1);
+	STRICT_EXPECTED_CALL(mocks, nn_errno())
+		.SetReturn(EBADF);
+
+	auto result = thread_func_to_call(thread_func_args);
+
+	ASSERT_ARE_EQUAL(int, result, 0);
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	Broker_RemoveModule(broker, &fake_module);
+	Broker_Destroy(broker);
+}
 
+//Tests_SRS_BROKER_13_168: [ An error on waiting for a message, other than an interruption by a signal, shall terminate the loop. ]
+TEST_FUNCTION(module_publish_worker_continues_when_nn_poll_is_interrupted)
+{
+	CBrokerMocks mocks;
+	auto broker = Broker_Create();
 	auto add_result = Broker_AddModule(broker, &fake_module);
 
 	mocks.ResetAllCalls();
 
 	//loop 1
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
 		.IgnoreArgument(1)
-		.SetFailReturn(LOCK_ERROR);
-	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+		.IgnoreArgument(2)
+		.SetFailReturn(-1);
+	STRICT_EXPECTED_CALL(mocks, nn_errno())
+		.SetReturn(EAGAIN);
+	STRICT_EXPECTED_CALL(mocks, nn_poll(IGNORED_PTR_ARG, 1, 100))
 		.IgnoreArgument(1)
-		.IgnoreArgument(2);
+		.SetFailReturn(-1);
+	STRICT_EXPECTED_CALL(mocks, nn_errno())
+		.SetReturn(EINTR);
+
+	//loop 2
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2)
+		.SetReturn(37);
 	STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetFailReturn("nn_recv");
+
+	auto result = thread_func_to_call(thread_func_args);
+
+	ASSERT_ARE_EQUAL(int, result, 0);
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	Broker_RemoveModule(broker, &fake_module);
+	Broker_Destroy(broker);
+}
 
+#if defined(__linux__)
+//Tests_SRS_BROKER_13_169: [ The function shall copy the thread options of options, when options is not NULL, to BROKER_MODULEINFO::thread_options, and set them to 0 otherwise. ]
+//Tests_SRS_BROKER_13_170: [ If BROKER_MODULEINFO::thread_options are not the default ones, the function shall apply them to its thread by calling ThreadOptions_Apply before receiving any message, and shall go on receiving messages if they cannot be applied. ]
+TEST_FUNCTION(module_publish_worker_applies_the_thread_options)
+{
+	CBrokerMocks mocks;
+	auto broker = Broker_Create();
+	BROKER_MODULE_OPTIONS options;
+	memset(&options, 0, sizeof(options));
+	strcpy(options.thread.name, "gw-worker");
+	auto add_result = Broker_AddModuleWithOptions(broker, &fake_module, &options);
+	char original_name[BROKER_THREAD_NAME_SIZE];
+	char name[BROKER_THREAD_NAME_SIZE];
+	ASSERT_ARE_EQUAL(int, 0, pthread_getname_np(pthread_self(), original_name, sizeof(original_name)));
+
+	mocks.ResetAllCalls();
+
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2)
+		.SetReturn(37);
+	STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetFailReturn("nn_recv");
 
 	auto result = thread_func_to_call(thread_func_args);
 
 	ASSERT_ARE_EQUAL(int, result, 0);
+	ASSERT_ARE_EQUAL(int, 0, pthread_getname_np(pthread_self(), name, sizeof(name)));
+	ASSERT_ARE_EQUAL(char_ptr, "gw-worker", name);
 	mocks.AssertActualAndExpectedCalls();
 
 	///cleanup
-	Message_Destroy(message);
+	(void)pthread_setname_np(pthread_self(), original_name);
 	Broker_RemoveModule(broker, &fake_module);
 	Broker_Destroy(broker);
 }
+#endif
 
 //Tests_SRS_BROKER_17_006: [ An error on receiving a message shall terminate the loop. ]
 TEST_FUNCTION(module_publish_worker_exits_on_nn_recv_error)
@@ -1784,14 +2307,12 @@ TEST_FUNCTION(module_publish_worker_exits_on_nn_recv_error)
 	mocks.ResetAllCalls();
 
 	//loop 1
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2)
 		.SetFailReturn(-1);
+	STRICT_EXPECTED_CALL(mocks, nn_errno())
+		.SetReturn(EBADF);
 
 
 	auto result = thread_func_to_call(thread_func_args);
@@ -1823,32 +2344,21 @@ TEST_FUNCTION(module_publish_worker_message_size_matches_but_not_quit_for_me)
 	mocks.ResetAllCalls();
 
 	//loop 1
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2)
 		.SetReturn(37);
-	STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	// buf from nn_recv will always be "nn_recv", so force a mismatch
 	STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
 		.SetFailReturn("nn_send");
-	STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArrayNoCopy(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
 	STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 
 	//loop 2
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2)
 		.SetReturn(37);
@@ -1867,6 +2377,7 @@ TEST_FUNCTION(module_publish_worker_message_size_matches_but_not_quit_for_me)
 	mocks.AssertActualAndExpectedCalls();
 
 	///cleanup
+	received_buffer_release(received_buffer_context);
 	Message_Destroy(message);
 	Broker_RemoveModule(broker, &fake_module);
 	Broker_Destroy(broker);
@@ -1890,26 +2401,17 @@ TEST_FUNCTION(module_publish_worker_continue_on_CreateFromByteArray_fails)
 	mocks.ResetAllCalls();
 
 	//loop 1
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2)
+	STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArrayNoCopy(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments()
 		.SetFailReturn((MESSAGE_HANDLE)NULL);
 
 	//loop 2
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+	STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2)
 		.SetReturn(37);
@@ -1970,11 +2472,10 @@ TEST_FUNCTION(Broker_RemoveModule_fails_with_null_module)
 //Tests_SRS_BROKER_13_050 : [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
 //Tests_SRS_BROKER_13_052 : [The function shall remove the module from BROKER_HANDLE_DATA::modules.]
 //Tests_SRS_BROKER_13_054 : [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]
+//Tests_SRS_BROKER_02_001: [ This function shall set BROKER_MODULEINFO::quit_requested. ]
 //Tests_SRS_BROKER_17_021: [ This function shall send a quit signal to the worker thread by sending BROKER_MODULEINFO::quit_message_guid to the publish_socket. ]
-//Tests_SRS_BROKER_02_001: [ Broker_RemoveModule shall lock BROKER_MODULEINFO::socket_lock. ]
-//Tests_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]
-//Tests_SRS_BROKER_02_003: [ After closing the socket, Broker_RemoveModule shall unlock BROKER_MODULEINFO::info_lock. ]
 //Tests_SRS_BROKER_13_104 : [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]
+//Tests_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket once the thread is joined. ]
 //Tests_SRS_BROKER_13_057 : [The function shall free all members of the BROKER_MODULEINFO object.]
 //Tests_SRS_BROKER_13_053 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
 TEST_FUNCTION(Broker_RemoveModule_succeeds)
@@ -2003,16 +2504,14 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds)
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the publish_lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
@@ -2095,6 +2594,7 @@ TEST_FUNCTION(Broker_RemoveModule_fails_when_list_find_fails)
 }
 //Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
 
+//Tests_SRS_BROKER_02_003: [ If sending the quit signal fails, the thread shall stop once its wait on the receive_socket times out. ]
 TEST_FUNCTION(Broker_RemoveModule_succeeds_when_nn_send_fails)
 {
 	///arrange
@@ -2127,66 +2627,10 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_when_nn_send_fails)
 	STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, list_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-
-	///act
-	result = Broker_RemoveModule(broker, &fake_module);
-
-	///assert
-	ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
-	mocks.AssertActualAndExpectedCalls();
-
-	///cleanup
-	Broker_Destroy(broker);
-}
-
-//Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.s]
-TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_Lock_fails)
-{
-	///arrange
-	CBrokerMocks mocks;
-	auto broker = Broker_Create();
-	auto result = Broker_AddModule(broker, &fake_module);
-	mocks.ResetAllCalls();
-
-	// this is for the Broker_RemoveModule call
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the publish_lock*/
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-
-	STRICT_EXPECTED_CALL(mocks, list_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
-		.IgnoreArgument(1)
-		.SetFailReturn(LOCK_ERROR);
-	STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, list_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2235,17 +2679,15 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_nn_close_fails)
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
 		.IgnoreArgument(1)
 		.SetReturn(-1);
 	STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the publish_lock*/
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
@@ -2296,16 +2738,14 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_unlock_fails)
 		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the publish_lock*/
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
@@ -2420,6 +2860,137 @@ TEST_FUNCTION(Broker_AddLink_null_sink_fails)
 
 }
 
+static const BROKER_FILTER_CONDITION fake_conditions[] = { { BROKER_FILTER_EXISTS, "macAddress", NULL } };
+static const BROKER_LINK_FILTER fake_filter = { fake_conditions, 1 };
+static const BROKER_LINK_FILTER fake_filter2 = { fake_conditions, 1 };
+
+//Tests_SRS_BROKER_13_177: [ If the link count of the BROKER_LINK_TRAFFIC is 0 and link->filter is not the filter of its previous links, Broker_AddLink shall compile link->filter by calling LinkFilter_Create before subscribing, and keep the filter it replaces until the sink is removed. ]
+TEST_FUNCTION(Broker_AddLink_with_filter_compiles_it_before_subscribing)
+{
+	///arrange
+	CBrokerMocks mocks;
+	auto broker = Broker_Create();
+	(void)Broker_AddModule(broker, &fake_module);
+	BROKER_LINK_DATA bld = { fake_module_handle, fake_module_handle, &fake_filter };
+	mocks.ResetAllCalls();
+
+	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, list_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, list_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the counters of the link*/
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, LinkFilter_IsSameAs((LINK_FILTER_HANDLE)NULL, &fake_filter));
+	STRICT_EXPECTED_CALL(mocks, LinkFilter_Create(&fake_filter));
+	STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
+		.IgnoreArgument(1)
+		.IgnoreArgument(4);
+
+	///act
+	auto result = Broker_AddLink(broker, &bld);
+
+	///assert
+	ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+	mocks.AssertActualAndExpectedCalls();
+
+	///cleanup
+	Broker_RemoveModule(broker, &fake_module);
+	Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]
+TEST_FUNCTION(Broker_AddLink_fails_when_LinkFilter_Create_fails)
+{
+	///arrange
+	CBrokerMocks mocks;
+	auto broker = Broker_Create();
+	(void)Broker_AddModule(broker, &fake_module);
+	BROKER_LINK_DATA bld = { fake_module_handle, fake_module_handle, &fake_filter };
+	whenShallLinkFilter_Create_fail = currentLinkFilter_Create_call + 1;
+	mocks.ResetAllCalls();
+
+	///act
+	auto result = Broker_AddLink(broker, &bld);
+
+	///assert
+	ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ADD_LINK_ERROR, result);
+
+	///cleanup
+	Broker_RemoveModule(broker, &fake_module);
+	Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_137: [ If the link already exists and LinkFilter_IsSameAs tells that its filter is not link->filter, Broker_AddLink shall return BROKER_ADD_LINK_ERROR without subscribing. ]
+TEST_FUNCTION(Broker_AddLink_with_another_filter_than_the_existing_link_fails)
+{
+	///arrange
+	CBrokerMocks mocks;
+	auto broker = Broker_Create();
+	(void)Broker_AddModule(broker, &fake_module);
+	BROKER_LINK_DATA bld = { fake_module_handle, fake_module_handle, &fake_filter };
+	BROKER_LINK_DATA other_bld = { fake_module_handle, fake_module_handle, &fake_filter2 };
+	BROKER_LINK_DATA unfiltered_bld = { fake_module_handle, fake_module_handle, NULL };
+	(void)Broker_AddLink(broker, &bld);
+	size_t created_filters = currentLinkFilter_Create_call;
+	mocks.ResetAllCalls();
+
+	///act
+	auto other_result = Broker_AddLink(broker, &other_bld);
+	auto unfiltered_result = Broker_AddLink(broker, &unfiltered_bld);
+	auto same_result = Broker_AddLink(broker, &bld);
+
+	///assert
+	ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ADD_LINK_ERROR, other_result);
+	ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ADD_LINK_ERROR, unfiltered_result);
+	ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, same_result);
+	ASSERT_ARE_EQUAL(size_t, created_filters, currentLinkFilter_Create_call);
+
+	///cleanup
+	Broker_RemoveModule(broker, &fake_module);
+	Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_177: [ If the link count of the BROKER_LINK_TRAFFIC is 0 and link->filter is not the filter of its previous links, Broker_AddLink shall compile link->filter by calling LinkFilter_Create before subscribing, and keep the filter it replaces until the sink is removed. ]
+//Tests_SRS_BROKER_13_179: [ The function shall destroy the filters of the links to the module, and the filters they replaced, by calling LinkFilter_Destroy. ]
+TEST_FUNCTION(Broker_RemoveModule_destroys_the_filters_the_links_replaced)
+{
+	///arrange
+	CBrokerMocks mocks;
+	auto broker = Broker_Create();
+	(void)Broker_AddModule(broker, &fake_module);
+	BROKER_LINK_DATA bld = { fake_module_handle, fake_module_handle, &fake_filter };
+	BROKER_LINK_DATA other_bld = { fake_module_handle, fake_module_handle, &fake_filter2 };
+	(void)Broker_AddLink(broker, &bld);
+	(void)Broker_RemoveLink(broker, &bld);
+	auto add_result = Broker_AddLink(broker, &other_bld);
+	size_t destroyed_before_remove = currentLinkFilter_Destroy_call;
+	mocks.ResetAllCalls();
+
+	///act
+	auto result = Broker_RemoveModule(broker, &fake_module);
+
+	///assert
+	ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, add_result);
+	ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+	ASSERT_ARE_EQUAL(size_t, 0, destroyed_before_remove);
+	ASSERT_ARE_EQUAL(size_t, 2, currentLinkFilter_Destroy_call);
+
+	///cleanup
+	Broker_Destroy(broker);
+}
+
 //Tests_SRS_BROKER_17_030: [ Broker_AddLink shall lock the modules_lock. ]
 //Tests_SRS_BROKER_17_031: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->module_sink_handle. ]
 //Tests_SRS_BROKER_17_041: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->module_source_handle. ]
@@ -2453,6 +3024,8 @@ TEST_FUNCTION(Broker_AddLink_succeeds)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the counters of the link*/
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
 		.IgnoreArgument(1)
 		.IgnoreArgument(4);
@@ -2504,6 +3077,8 @@ TEST_FUNCTION(Broker_AddLink_fails_setsocketoption_fails)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the counters of the link*/
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
 		.IgnoreArgument(1)
 		.IgnoreArgument(4)
@@ -3052,6 +3627,8 @@ TEST_FUNCTION(Broker_Destroy_works)
     // these are for Broker_Destroy
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG)) /*this is the publish_lock*/
+        .IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
@@ -3084,6 +3661,8 @@ TEST_FUNCTION(Broker_DecRef_works)
     // these are for Broker_Destroy
     STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG)) /*this is the publish_lock*/
+        .IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
@@ -3151,8 +3730,10 @@ TEST_FUNCTION(Broker_Publish_fails_with_null_source)
 
 	///cleanup
 }
-//Tests_SRS_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_fails_when_Lock_fails)
+//Tests_SRS_BROKER_13_136: [ Broker_Publish and Broker_PublishBatch shall not acquire BROKER_HANDLE_DATA::modules_lock, they only hold the send_lock of the source to number and send the frame, and BROKER_HANDLE_DATA::publish_lock while a lossless module is attached. ]
+//Tests_SRS_BROKER_13_158: [ Broker_Publish and Broker_PublishBatch shall hold the send_lock of the source while they number and send the frame. ]
+//Tests_SRS_BROKER_13_175: [ Broker_Publish and Broker_PublishBatch shall only acquire BROKER_HANDLE_DATA::publish_lock when a module whose messages in flight are bounded is attached to the broker. ]
+TEST_FUNCTION(Broker_Publish_does_not_lock_modules_lock)
 {
 	///arrange
 	CBrokerMocks mocks;
@@ -3169,15 +3750,26 @@ TEST_FUNCTION(Broker_Publish_fails_when_Lock_fails)
 	mocks.ResetAllCalls();
 
 	// this is for Broker_Publish
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the send_lock of the source, the only lock taken*/
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+	STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+	STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, NULL, 0));
+	STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + TEST_FRAME_HEADER_SIZE, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
 		.IgnoreArgument(1)
-		.SetFailReturn(LOCK_ERROR);
+		.IgnoreArgument(2);
 
 	///act
 	result = Broker_Publish(broker, fake_module_handle, message);
 
 	///assert
-	ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+	ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
 	mocks.AssertActualAndExpectedCalls();
 
 	///cleanup
@@ -3187,7 +3779,7 @@ TEST_FUNCTION(Broker_Publish_fails_when_Lock_fails)
 }
 
 //Tests_SRS_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_fails_when_Message_ToByteArray_fails)
+TEST_FUNCTION(Broker_Publish_fails_when_Message_ToByteArrayWithFormat_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -3204,13 +3796,9 @@ TEST_FUNCTION(Broker_Publish_fails_when_Message_ToByteArray_fails)
     mocks.ResetAllCalls();
 
     // this is for Broker_Publish
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
 	STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-	STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0))
+	STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, NULL, 0))
 		.SetFailReturn(-1);
 
     ///act
@@ -3244,14 +3832,10 @@ TEST_FUNCTION(Broker_Publish_fails_when_allocmsg_fails)
     mocks.ResetAllCalls();
 
     // this is for Broker_Publish
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
 	STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-	STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0));
-	STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + sizeof(MODULE_HANDLE), 0))
+	STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, NULL, 0));
+	STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + TEST_FRAME_HEADER_SIZE, 0))
 		.SetFailReturn(nullptr);
 
     ///act
@@ -3285,19 +3869,19 @@ TEST_FUNCTION(Broker_Publish_fails_when_send_fails)
     mocks.ResetAllCalls();
 
     // this is for Broker_Publish
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
 	STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-	STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0));
-	STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + sizeof(MODULE_HANDLE), 0))
+	STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, NULL, 0));
+	STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + TEST_FRAME_HEADER_SIZE, 0))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, IGNORED_PTR_ARG, 1))
+	STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the send_lock of the source*/
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2)
@@ -3316,16 +3900,16 @@ TEST_FUNCTION(Broker_Publish_fails_when_send_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_17_022: [ Broker_Publish shall Lock the modules lock. ]
+//Tests_SRS_BROKER_13_136: [ Broker_Publish and Broker_PublishBatch shall not acquire BROKER_HANDLE_DATA::modules_lock, they only hold the send_lock of the source to number and send the frame, and BROKER_HANDLE_DATA::publish_lock while a lossless module is attached. ]
 //Tests_SRS_BROKER_17_007: [Broker_Publish shall clone the message.]
 //Tests_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message. ]
-//Tests_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE). ]
+//Tests_SRS_BROKER_13_121: [ Broker_Publish shall serialize the message with MESSAGE_WIRE_FORMAT_V2. ]
+//Tests_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE) + sizeof(uint32_t). ]
 //Tests_SRS_BROKER_17_026: [ Broker_Publish shall copy source into the beginning of the nanomsg buffer. ]
 //Tests_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ]
 //Tests_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ]
 //Tests_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ]
 //Tests_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]
-//Tests_SRS_BROKER_17_023: [ Broker_Publish shall Unlock the modules lock. ]
 //Tests_SRS_BROKER_13_037 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
 TEST_FUNCTION(Broker_Publish_succeeds)
 {
@@ -3344,17 +3928,17 @@ TEST_FUNCTION(Broker_Publish_succeeds)
     mocks.ResetAllCalls();
 
     // this is for Broker_Publish
-	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
 	STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-	STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0));
-	STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1+sizeof(MODULE_HANDLE), 0))
+	STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, NULL, 0));
+	STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + TEST_FRAME_HEADER_SIZE, 0))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, IGNORED_PTR_ARG, 1))
+	STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the send_lock of the source*/
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
@@ -3374,4 +3958,669 @@ TEST_FUNCTION(Broker_Publish_succeeds)
 }
 
 
+//Tests_SRS_BROKER_13_122: [ If broker, source or batch is NULL the function shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_PublishBatch_fails_with_null_batch)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_PublishBatch(broker, fake_module_handle, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_130: [ If the batch is empty the function shall return BROKER_OK without sending anything. ]
+TEST_FUNCTION(Broker_PublishBatch_with_empty_batch_sends_nothing)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    FAKE_MESSAGE_BATCH batch = { { NULL, NULL }, 0 };
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, MessageBatch_GetCount((MESSAGE_BATCH_HANDLE)&batch));
+
+    ///act
+    auto result = Broker_PublishBatch(broker, fake_module_handle, (MESSAGE_BATCH_HANDLE)&batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_135: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]
+TEST_FUNCTION(Broker_PublishBatch_fails_when_a_message_cannot_be_serialized)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    FAKE_MESSAGE_BATCH batch = { { Message_Create(&c), Message_Create(&c) }, 2 };
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, MessageBatch_GetCount((MESSAGE_BATCH_HANDLE)&batch));
+    STRICT_EXPECTED_CALL(mocks, MessageBatch_GetMessages((MESSAGE_BATCH_HANDLE)&batch));
+    STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(batch.messages[0], MESSAGE_WIRE_FORMAT_V2, NULL, 0));
+    STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(batch.messages[1], MESSAGE_WIRE_FORMAT_V2, NULL, 0))
+        .SetReturn(-1);
+
+    ///act
+    auto result = Broker_PublishBatch(broker, fake_module_handle, (MESSAGE_BATCH_HANDLE)&batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(batch.messages[0]);
+    Message_Destroy(batch.messages[1]);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_136: [ Broker_Publish and Broker_PublishBatch shall not acquire BROKER_HANDLE_DATA::modules_lock, they only hold the send_lock of the source to number and send the frame, and BROKER_HANDLE_DATA::publish_lock while a lossless module is attached. ]
+//Tests_SRS_BROKER_13_132: [ Broker_PublishBatch shall allocate one nanomsg buffer holding the source, the sequence number, the batch frame marker, the number of messages and, for every message, its size followed by the message serialized with MESSAGE_WIRE_FORMAT_V2. ]
+//Tests_SRS_BROKER_13_133: [ Broker_PublishBatch shall send the whole batch with one call to nn_send on the publish_socket. ]
+TEST_FUNCTION(Broker_PublishBatch_sends_the_batch_in_one_frame)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    FAKE_MESSAGE_BATCH batch = { { Message_Create(&c), Message_Create(&c) }, 2 };
+    (void)Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, MessageBatch_GetCount((MESSAGE_BATCH_HANDLE)&batch));
+    STRICT_EXPECTED_CALL(mocks, MessageBatch_GetMessages((MESSAGE_BATCH_HANDLE)&batch));
+    STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(batch.messages[0], MESSAGE_WIRE_FORMAT_V2, NULL, 0));
+    STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(batch.messages[1], MESSAGE_WIRE_FORMAT_V2, NULL, 0));
+    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(TEST_FRAME_HEADER_SIZE + 1 + sizeof(int32_t) + 2 * (sizeof(int32_t) + 1), 0));
+    STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(batch.messages[0], MESSAGE_WIRE_FORMAT_V2, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(batch.messages[1], MESSAGE_WIRE_FORMAT_V2, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(3)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the send_lock of the source*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    ///act
+    auto result = Broker_PublishBatch(broker, fake_module_handle, (MESSAGE_BATCH_HANDLE)&batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(batch.messages[0]);
+    Message_Destroy(batch.messages[1]);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+
+//Tests_SRS_BROKER_13_141: [ If broker or module_count is NULL, or statistics is NULL and *module_count is not 0, Broker_GetStatistics shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_GetStatistics_fails_with_null_broker)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_MODULE_STATISTICS statistics;
+    size_t module_count = 1;
+
+    ///act
+    auto result = Broker_GetStatistics(NULL, &statistics, &module_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_BROKER_13_140: [ The function shall set BROKER_MODULEINFO::delivery_counters to 0. ]
+//Tests_SRS_BROKER_13_142: [ Broker_GetStatistics shall lock BROKER_HANDLE_DATA::modules_lock, so that no module is removed while its counters are read. ]
+//Tests_SRS_BROKER_13_143: [ Broker_GetStatistics shall fill the first *module_count elements of statistics with the BROKER_MODULEINFO::delivery_counters of the modules of BROKER_HANDLE_DATA::modules, read without acquiring any other lock, and report a queue depth, queued bytes and high-water mark of 0 because the queues are kept by nanomsg. ]
+//Tests_SRS_BROKER_13_144: [ Broker_GetStatistics shall set *module_count to the number of modules of the broker, unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_OK. ]
+TEST_FUNCTION(Broker_GetStatistics_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    BROKER_MODULE_STATISTICS statistics;
+    size_t module_count = 1;
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_get_next_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_GetStatistics(broker, &statistics, &module_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, module_count);
+    ASSERT_ARE_EQUAL(void_ptr, fake_module_handle, statistics.module_handle);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.delivered);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.queue_depth);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.queue_high_water_mark);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_171: [ If broker or module is NULL, Broker_ApplyModuleThreadOptions shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_ApplyModuleThreadOptions_fails_with_null_module)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    ///act
+    auto result = Broker_ApplyModuleThreadOptions((BROKER_HANDLE)0x1, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_BROKER_13_174: [ If the module was not added to the broker, the options cannot be applied or an underlying API call fails, Broker_ApplyModuleThreadOptions shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_ApplyModuleThreadOptions_fails_when_Lock_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
+
+    ///act
+    auto result = Broker_ApplyModuleThreadOptions(broker, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_174: [ If the module was not added to the broker, the options cannot be applied or an underlying API call fails, Broker_ApplyModuleThreadOptions shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_ApplyModuleThreadOptions_fails_for_a_module_not_added)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_ApplyModuleThreadOptions(broker, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_172: [ Broker_ApplyModuleThreadOptions shall lock BROKER_HANDLE_DATA::modules_lock and copy the BROKER_MODULEINFO::thread_options of module. ]
+//Tests_SRS_BROKER_13_173: [ Broker_ApplyModuleThreadOptions shall apply the thread options to the calling thread by calling ThreadOptions_Apply after releasing the lock, and return BROKER_OK. ]
+TEST_FUNCTION(Broker_ApplyModuleThreadOptions_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_ApplyModuleThreadOptions(broker, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_150: [ If broker, link, link->module_source_handle, link->module_sink_handle or statistics is NULL, Broker_GetLinkStatistics shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_GetLinkStatistics_fails_with_null_statistics)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_LINK_DATA link = { fake_module_handle, fake_batch_module_handle };
+
+    ///act
+    auto result = Broker_GetLinkStatistics((BROKER_HANDLE)0x1, &link, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_BROKER_13_149: [ Broker_RemoveLink shall decrement the link count of the BROKER_LINK_TRAFFIC of link->module_source_handle in BROKER_MODULEINFO::links of the sink. ]
+//Tests_SRS_BROKER_13_153: [ If the link does not exist or an underlying API call fails, Broker_GetLinkStatistics shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_GetLinkStatistics_fails_when_the_link_was_removed)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_batch_module);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_batch_module_handle };
+    (void)Broker_AddLink(broker, &link);
+    (void)Broker_RemoveLink(broker, &link);
+    BROKER_LINK_STATISTICS statistics;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_GetLinkStatistics(broker, &link, &statistics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, result);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_batch_module);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_146: [ The function shall count the messages and the bytes it receives from a source in the BROKER_LINK_COUNTERS of the link from that source, and the time it received the last of them. ]
+//Tests_SRS_BROKER_13_147: [ Broker_AddLink shall find or allocate the BROKER_LINK_TRAFFIC of link->module_source_handle in BROKER_MODULEINFO::links of the sink before subscribing. ]
+//Tests_SRS_BROKER_13_148: [ Broker_AddLink shall increment the link count of the BROKER_LINK_TRAFFIC, and reset its counters when the count was 0. ]
+//Tests_SRS_BROKER_13_151: [ Broker_GetLinkStatistics shall lock BROKER_HANDLE_DATA::modules_lock and find the BROKER_LINK_TRAFFIC of link->module_source_handle in BROKER_MODULEINFO::links of link->module_sink_handle. ]
+//Tests_SRS_BROKER_13_152: [ Broker_GetLinkStatistics shall fill statistics by calling BrokerStatistics_FillLink with the counters of the BROKER_LINK_TRAFFIC, read without acquiring any other lock, and return BROKER_OK. ]
+TEST_FUNCTION(Broker_GetLinkStatistics_counts_the_messages_of_a_batch_frame_received_over_the_link)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_batch_module);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_batch_module_handle };
+    (void)Broker_AddLink(broker, &link);
+    BROKER_LINK_STATISTICS statistics;
+
+    // topic, marker, 2 messages of 1 byte each
+    unsigned char frame[TEST_FRAME_HEADER_SIZE + 1 + sizeof(int32_t) + 2 * (sizeof(int32_t) + 1)];
+    int32_t count = 2;
+    int32_t size = 1;
+    memcpy(frame, &fake_module_handle, sizeof(MODULE_HANDLE));
+    memset(frame + sizeof(MODULE_HANDLE), 0, sizeof(uint32_t));
+    frame[TEST_FRAME_HEADER_SIZE] = 0xBA;
+    memcpy(frame + TEST_FRAME_HEADER_SIZE + 1, &count, sizeof(int32_t));
+    memcpy(frame + TEST_FRAME_HEADER_SIZE + 1 + sizeof(int32_t), &size, sizeof(int32_t));
+    frame[TEST_FRAME_HEADER_SIZE + 1 + 2 * sizeof(int32_t)] = 0xA1;
+    memcpy(frame + TEST_FRAME_HEADER_SIZE + 2 + 2 * sizeof(int32_t), &size, sizeof(int32_t));
+    frame[sizeof(frame) - 1] = 0xA1;
+    nn_recv_frame = frame;
+    nn_recv_frame_size = sizeof(frame);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(37);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn("nn_recv");
+    (void)thread_func_to_call(thread_func_args);
+    received_buffer_release(received_buffer_context);
+    received_buffer_release(received_buffer_context);
+
+    ///act
+    auto result = Broker_GetLinkStatistics(broker, &link, &statistics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics.messages);
+    ASSERT_ARE_EQUAL(uint64_t, sizeof(frame), statistics.bytes);
+    ASSERT_IS_TRUE(statistics.last_activity != 0);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_batch_module);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_161: [ The first frame the function receives from a source since the link was added shall set the sequence number it expects next from that source. ]
+//Tests_SRS_BROKER_13_162: [ When the sequence number of a frame is past the one expected, the function shall count the missing messages, dropped by nanomsg, as discarded in BROKER_MODULEINFO::delivery_counters. ]
+TEST_FUNCTION(module_publish_worker_counts_the_messages_missing_from_the_sequence_of_a_source_as_dropped)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_batch_module);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_batch_module_handle };
+    (void)Broker_AddLink(broker, &link);
+    BROKER_MODULE_STATISTICS statistics[2];
+    size_t module_count = 2;
+    unsigned char first_frame[TEST_FRAME_HEADER_SIZE + 1 + sizeof(int32_t) + 2 * (sizeof(int32_t) + 1)];
+    unsigned char second_frame[TEST_FRAME_HEADER_SIZE + 1 + sizeof(int32_t) + 2 * (sizeof(int32_t) + 1)];
+    size_t first_frame_size = build_test_frame(first_frame, 0, true);
+    size_t second_frame_size = build_test_frame(second_frame, 5, true);
+
+    // the first frame carries messages 0 and 1, the second messages 5 and 6
+    run_test_worker(mocks, first_frame, first_frame_size);
+    received_buffer_release(received_buffer_context);
+    received_buffer_release(received_buffer_context);
+    run_test_worker(mocks, second_frame, second_frame_size);
+    received_buffer_release(received_buffer_context);
+    received_buffer_release(received_buffer_context);
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_GetStatistics(broker, statistics, &module_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(void_ptr, fake_batch_module_handle, statistics[1].module_handle);
+    ASSERT_ARE_EQUAL(uint64_t, 4, statistics[1].delivered);
+    ASSERT_ARE_EQUAL(uint64_t, 3, statistics[1].dropped);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_batch_module);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_178: [ If the link a message is received over has a filter, the function shall test the message against it by calling LinkFilter_Matches before delivering it, and shall destroy the messages that do not pass without delivering them. ]
+TEST_FUNCTION(module_publish_worker_does_not_deliver_a_message_the_filter_of_the_link_rejects)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_batch_module);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_batch_module_handle, &fake_filter };
+    (void)Broker_AddLink(broker, &link);
+    BROKER_MODULE_STATISTICS statistics[2];
+    size_t module_count = 2;
+    unsigned char frame[TEST_FRAME_HEADER_SIZE + 1];
+    size_t frame_size = build_test_frame(frame, 0, false);
+    whenShallLinkFilter_Matches_fail = currentLinkFilter_Matches_call + 1;
+
+    ///act
+    run_test_worker(mocks, frame, frame_size);
+    received_buffer_release(received_buffer_context);
+    auto result = Broker_GetStatistics(broker, statistics, &module_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, currentLinkFilter_Matches_call);
+    ASSERT_ARE_EQUAL(size_t, 0, FakeModule_ReceiveBatch_last_count);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics[1].enqueued);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics[1].delivered);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_batch_module);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_178: [ If the link a message is received over has a filter, the function shall test the message against it by calling LinkFilter_Matches before delivering it, and shall destroy the messages that do not pass without delivering them. ]
+TEST_FUNCTION(module_publish_worker_delivers_the_messages_of_a_batch_frame_that_pass_the_filter_of_the_link)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_batch_module);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_batch_module_handle, &fake_filter };
+    (void)Broker_AddLink(broker, &link);
+    BROKER_MODULE_STATISTICS statistics[2];
+    size_t module_count = 2;
+    unsigned char frame[TEST_FRAME_HEADER_SIZE + 1 + sizeof(int32_t) + 2 * (sizeof(int32_t) + 1)];
+    size_t frame_size = build_test_frame(frame, 0, true);
+    whenShallLinkFilter_Matches_fail = currentLinkFilter_Matches_call + 1;
+
+    ///act
+    run_test_worker(mocks, frame, frame_size);
+    received_buffer_release(received_buffer_context);
+    received_buffer_release(received_buffer_context);
+    auto result = Broker_GetStatistics(broker, statistics, &module_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 2, currentLinkFilter_Matches_call);
+    ASSERT_ARE_EQUAL(size_t, 1, FakeModule_ReceiveBatch_last_count);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics[1].enqueued);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics[1].delivered);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics[1].dropped);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_batch_module);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_164: [ If the frame received is shorter than its header, the function shall count it as discarded, free it and the message loop shall continue. ]
+TEST_FUNCTION(module_publish_worker_discards_a_frame_shorter_than_its_header)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    BROKER_MODULE_STATISTICS statistics;
+    size_t module_count = 1;
+    unsigned char frame[sizeof(MODULE_HANDLE)];
+    memcpy(frame, &fake_module_handle, sizeof(MODULE_HANDLE));
+    call_status_for_FakeModule_Receive.was_called = false;
+    nn_recv_frame = frame;
+    nn_recv_frame_size = sizeof(frame);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(37);
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn("nn_recv");
+
+    ///act
+    auto result = thread_func_to_call(thread_func_args);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, result, 0);
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_FALSE(call_status_for_FakeModule_Receive.was_called);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_GetStatistics(broker, &statistics, &module_count));
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.enqueued);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.dropped);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.delivered);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_155: [ Broker_AddModuleWithOptions shall add the started module to BROKER_HANDLE_DATA::publishers under BROKER_HANDLE_DATA::publish_lock, creating BROKER_HANDLE_DATA::space_cond with the first module whose messages in flight are bounded. ]
+//Tests_SRS_BROKER_13_156: [ If options is not NULL, the queue's policy is BROKER_QUEUE_BLOCK and its max_depth is not 0, the function shall bound the messages of every source in flight to the module to max_depth. ]
+//Tests_SRS_BROKER_13_163: [ If the messages in flight to the module are bounded, the function shall signal BROKER_HANDLE_DATA::space_cond with BROKER_HANDLE_DATA::publish_lock held after it counts a frame, once for each publisher waiting on it. ]
+//Tests_SRS_BROKER_13_165: [ Broker_Publish and Broker_PublishBatch shall write after the source the sequence number of the first message of the frame among the messages published by the source, 0 for a source that has never been attached to the broker. ]
+//Tests_SRS_BROKER_13_159: [ If a lossless module linked from the source has max_depth messages of the source in flight, Broker_Publish and Broker_PublishBatch shall wait on BROKER_HANDLE_DATA::space_cond until there is room or the block_timeout_ms of that module has elapsed since they started waiting. ]
+//Tests_SRS_BROKER_13_160: [ If there is still no room, Broker_Publish and Broker_PublishBatch shall not send the frame and shall return BROKER_BUSY. ]
+TEST_FUNCTION(Broker_Publish_returns_BROKER_BUSY_when_a_lossless_module_has_max_depth_messages_in_flight)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_BLOCK, 10 } };
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    (void)Broker_AddModule(broker, &fake_module);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_AddModuleWithOptions(broker, &fake_batch_module, &options));
+    ASSERT_ARE_EQUAL(size_t, 1, currentCond_Init_call);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_batch_module_handle };
+    (void)Broker_AddLink(broker, &link);
+
+    // the sink receives message 0, the first one it sees sets the sequence number expected next
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_Publish(broker, fake_module_handle, message));
+    unsigned char frame[TEST_FRAME_HEADER_SIZE + 1];
+    size_t frame_size = build_test_frame(frame, 0, false);
+    run_test_worker(mocks, frame, frame_size);
+    received_buffer_release(received_buffer_context);
+
+    // message 1 is in flight
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_Publish(broker, fake_module_handle, message));
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+    STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, NULL, 0));
+    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + TEST_FRAME_HEADER_SIZE, 0));
+    STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the publish_lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 10))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_BUSY, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_batch_module);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_159: [ If a lossless module linked from the source has max_depth messages of the source in flight, Broker_Publish and Broker_PublishBatch shall wait on BROKER_HANDLE_DATA::space_cond until there is room or the block_timeout_ms of that module has elapsed since they started waiting. ]
+//Tests_SRS_BROKER_13_160: [ If there is still no room, Broker_Publish and Broker_PublishBatch shall not send the frame and shall return BROKER_BUSY. ]
+TEST_FUNCTION(Broker_Publish_waits_again_when_it_is_signaled_and_the_lossless_module_is_still_full)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_BLOCK, 10 } };
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    (void)Broker_AddModule(broker, &fake_module);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_AddModuleWithOptions(broker, &fake_batch_module, &options));
+    BROKER_LINK_DATA link = { fake_module_handle, fake_batch_module_handle };
+    (void)Broker_AddLink(broker, &link);
+
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_Publish(broker, fake_module_handle, message));
+    unsigned char frame[TEST_FRAME_HEADER_SIZE + 1];
+    size_t frame_size = build_test_frame(frame, 0, false);
+    run_test_worker(mocks, frame, frame_size);
+    received_buffer_release(received_buffer_context);
+
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_Publish(broker, fake_module_handle, message));
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+    STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, NULL, 0));
+    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + TEST_FRAME_HEADER_SIZE, 0));
+    STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the publish_lock*/
+        .IgnoreArgument(1);
+    /*the signal is for another publisher, the module has not received anything*/
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 10))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(COND_OK);
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_BUSY, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_batch_module);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
 END_TEST_SUITE(broker_ut)
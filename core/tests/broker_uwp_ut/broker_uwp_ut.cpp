@@ -14,7 +14,8 @@
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/list.h"
 #include "message.h"
-#include "azure_c_shared_utility/threadapi.h"
+#include "internal/message_queue.h"
+#include "internal/worker_pool.h"
 #include "azure_c_shared_utility/refcount.h"
 
 static MICROMOCK_MUTEX_HANDLE g_testByTest;
@@ -60,6 +61,12 @@ static size_t whenShallVECTOR_push_back_fail;
 static size_t currentVECTOR_find_if_call;
 static size_t whenShallVECTOR_find_if_fail;
 
+static size_t currentMessageQueue_Create_call;
+static size_t whenShallMessageQueue_Create_fail;
+
+static size_t currentMessageQueue_Push_call;
+static size_t whenShallMessageQueue_Push_fail;
+
 static size_t currentlist_find_call;
 static size_t whenShalllist_find_fail;
 
@@ -84,8 +91,14 @@ static size_t whenShallCond_Init_fail;
 static size_t currentCond_Post_call;
 static size_t whenShallCond_Post_fail;
 
-static size_t currentThreadAPI_Create_call;
-static size_t whenShallThreadAPI_Create_fail;
+static size_t currentWorkerPool_Create_call;
+static size_t whenShallWorkerPool_Create_fail;
+
+static size_t currentWorkerPool_CreateStrand_call;
+static size_t whenShallWorkerPool_CreateStrand_fail;
+
+static size_t currentWorkerPool_Schedule_call;
+static size_t whenShallWorkerPool_Schedule_fail;
 
 typedef struct LIST_ITEM_INSTANCE_TAG
 {
@@ -101,9 +114,8 @@ typedef struct LIST_INSTANCE_TAG
 static size_t current_list_index;
 static const void *fake_list[10];
 
-static bool shouldThreadAPI_Create_invoke_callback;
-static THREAD_START_FUNC thread_func_to_call;
-static void* thread_func_args;
+static STRAND_FUNCTION strand_func_to_call;
+static void* strand_func_args;
 
 struct FakeModule_Receive_Call_Status
 {
@@ -112,12 +124,6 @@ struct FakeModule_Receive_Call_Status
 };
 static FakeModule_Receive_Call_Status call_status_for_FakeModule_Receive;
 
-// intercept variables for Condition_Wait mock
-typedef COND_RESULT(*PFN_CONDITION_WAIT_INTERCEPT)(void);
-static bool shouldIntercept_Condition_Wait;
-static void* interceptArgs_for_Condition_Wait;
-static PFN_CONDITION_WAIT_INTERCEPT intercept_for_Condition_Wait;
-
 static MODULE_HANDLE fake_module_handle = (MODULE_HANDLE)0x42;
 class DummyGatewayModule : public IInternalGatewayModule
 {
@@ -250,10 +256,6 @@ public:
 
     MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds)
         auto result2 = COND_OK;
-        if (shouldIntercept_Condition_Wait == true)
-        {
-            result2 = intercept_for_Condition_Wait();
-        }
     MOCK_METHOD_END(COND_RESULT, result2)
 
     MOCK_STATIC_METHOD_1(, void, Condition_Deinit, COND_HANDLE, handle)
@@ -326,34 +328,120 @@ public:
         size_t result2 = BASEIMPLEMENTATION::VECTOR_size(vector);
     MOCK_METHOD_END(size_t, result2)
 
-    MOCK_STATIC_METHOD_3(, THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg)
-        THREADAPI_RESULT result2;
-        ++currentThreadAPI_Create_call;
-        if ((whenShallThreadAPI_Create_fail > 0) &&
-            (currentThreadAPI_Create_call == whenShallThreadAPI_Create_fail))
+    // message_queue.h
+    // the fake message queue is a VECTOR of MESSAGE_HANDLEs behind one level
+    // of indirection so that two queues can be swapped
+    MOCK_STATIC_METHOD_0(, MESSAGE_QUEUE_HANDLE, MessageQueue_Create)
+        MESSAGE_QUEUE_HANDLE result2;
+        ++currentMessageQueue_Create_call;
+        if ((whenShallMessageQueue_Create_fail > 0) &&
+            (currentMessageQueue_Create_call == whenShallMessageQueue_Create_fail))
         {
-            result2 = THREADAPI_ERROR;
+            result2 = NULL;
         }
         else
         {
-            *threadHandle = (THREAD_HANDLE*)malloc(3);
-            thread_func_to_call = func;
-            thread_func_args = arg;
+            VECTOR_HANDLE* queue = (VECTOR_HANDLE*)malloc(sizeof(VECTOR_HANDLE));
+            *queue = BASEIMPLEMENTATION::VECTOR_create(sizeof(MESSAGE_HANDLE));
+            result2 = (MESSAGE_QUEUE_HANDLE)queue;
+        }
+    MOCK_METHOD_END(MESSAGE_QUEUE_HANDLE, result2)
 
-            result2 = THREADAPI_OK;
-            if (shouldThreadAPI_Create_invoke_callback == true)
-            {
-                func(arg);
-            }
-        
-        
+    MOCK_STATIC_METHOD_1(, void, MessageQueue_Destroy, MESSAGE_QUEUE_HANDLE, queue)
+        BASEIMPLEMENTATION::VECTOR_destroy(*(VECTOR_HANDLE*)queue);
+        free(queue);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, int, MessageQueue_Push, MESSAGE_QUEUE_HANDLE, queue, MESSAGE_HANDLE, message)
+        int result2;
+        ++currentMessageQueue_Push_call;
+        if ((whenShallMessageQueue_Push_fail > 0) &&
+            (currentMessageQueue_Push_call == whenShallMessageQueue_Push_fail))
+        {
+            result2 = __LINE__;
         }
-    MOCK_METHOD_END(THREADAPI_RESULT, result2)
+        else
+        {
+            result2 = BASEIMPLEMENTATION::VECTOR_push_back(*(VECTOR_HANDLE*)queue, &message, 1);
+        }
+    MOCK_METHOD_END(int, result2)
 
-    MOCK_STATIC_METHOD_2(, THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res)
-        free(threadHandle);
-        auto result2 = THREADAPI_OK;
-    MOCK_METHOD_END(THREADAPI_RESULT, result2)
+    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, MessageQueue_Pop, MESSAGE_QUEUE_HANDLE, queue)
+        MESSAGE_HANDLE result2;
+        VECTOR_HANDLE vector = *(VECTOR_HANDLE*)queue;
+        if (BASEIMPLEMENTATION::VECTOR_size(vector) == 0)
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            MESSAGE_HANDLE* front = (MESSAGE_HANDLE*)BASEIMPLEMENTATION::VECTOR_front(vector);
+            result2 = *front;
+            BASEIMPLEMENTATION::VECTOR_erase(vector, front, 1);
+        }
+    MOCK_METHOD_END(MESSAGE_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, size_t, MessageQueue_Size, MESSAGE_QUEUE_HANDLE, queue)
+        size_t result2 = BASEIMPLEMENTATION::VECTOR_size(*(VECTOR_HANDLE*)queue);
+    MOCK_METHOD_END(size_t, result2)
+
+    MOCK_STATIC_METHOD_2(, void, MessageQueue_Swap, MESSAGE_QUEUE_HANDLE, queue1, MESSAGE_QUEUE_HANDLE, queue2)
+        VECTOR_HANDLE temp = *(VECTOR_HANDLE*)queue1;
+        *(VECTOR_HANDLE*)queue1 = *(VECTOR_HANDLE*)queue2;
+        *(VECTOR_HANDLE*)queue2 = temp;
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_1(, WORKER_POOL_HANDLE, WorkerPool_Create, size_t, worker_count)
+        WORKER_POOL_HANDLE result2;
+        ++currentWorkerPool_Create_call;
+        if ((whenShallWorkerPool_Create_fail > 0) &&
+            (currentWorkerPool_Create_call == whenShallWorkerPool_Create_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = (WORKER_POOL_HANDLE)malloc(3);
+        }
+    MOCK_METHOD_END(WORKER_POOL_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, WorkerPool_Destroy, WORKER_POOL_HANDLE, pool)
+        free(pool);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_3(, STRAND_HANDLE, WorkerPool_CreateStrand, WORKER_POOL_HANDLE, pool, STRAND_FUNCTION, function, void*, context)
+        STRAND_HANDLE result2;
+        ++currentWorkerPool_CreateStrand_call;
+        if ((whenShallWorkerPool_CreateStrand_fail > 0) &&
+            (currentWorkerPool_CreateStrand_call == whenShallWorkerPool_CreateStrand_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = (STRAND_HANDLE)malloc(4);
+            strand_func_to_call = function;
+            strand_func_args = context;
+        }
+    MOCK_METHOD_END(STRAND_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, int, WorkerPool_Schedule, STRAND_HANDLE, strand)
+        int result2;
+        ++currentWorkerPool_Schedule_call;
+        if ((whenShallWorkerPool_Schedule_fail > 0) &&
+            (currentWorkerPool_Schedule_call == whenShallWorkerPool_Schedule_fail))
+        {
+            result2 = __LINE__;
+        }
+        else
+        {
+            result2 = 0;
+        }
+    MOCK_METHOD_END(int, result2)
+
+    MOCK_STATIC_METHOD_1(, void, WorkerPool_DestroyStrand, STRAND_HANDLE, strand)
+        free(strand);
+    MOCK_VOID_METHOD_END()
 
     MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg)
         MESSAGE_HANDLE result2 = (MESSAGE_HANDLE)(new RefCountObject());
@@ -511,13 +599,23 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void*, VECTOR_back, VECTOR_HANDLE,
 DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , void*, VECTOR_find_if, VECTOR_HANDLE, vector, PREDICATE_FUNCTION, pred, const void*, value);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , size_t, VECTOR_size, VECTOR_HANDLE, vector);
 
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , MESSAGE_QUEUE_HANDLE, MessageQueue_Create);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, MessageQueue_Destroy, MESSAGE_QUEUE_HANDLE, queue);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, MessageQueue_Push, MESSAGE_QUEUE_HANDLE, queue, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, MessageQueue_Pop, MESSAGE_QUEUE_HANDLE, queue);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , size_t, MessageQueue_Size, MESSAGE_QUEUE_HANDLE, queue);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , void, MessageQueue_Swap, MESSAGE_QUEUE_HANDLE, queue1, MESSAGE_QUEUE_HANDLE, queue2);
+
 DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , COND_HANDLE, Condition_Init);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , COND_RESULT, Condition_Post, COND_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, Condition_Deinit, COND_HANDLE, handle);
 
-DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg);
-DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , WORKER_POOL_HANDLE, WorkerPool_Create, size_t, worker_count);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, WorkerPool_Destroy, WORKER_POOL_HANDLE, pool);
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , STRAND_HANDLE, WorkerPool_CreateStrand, WORKER_POOL_HANDLE, pool, STRAND_FUNCTION, function, void*, context);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , int, WorkerPool_Schedule, STRAND_HANDLE, strand);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, WorkerPool_DestroyStrand, STRAND_HANDLE, strand);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message);
@@ -568,6 +666,12 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     currentVECTOR_find_if_call = 0;
     whenShallVECTOR_find_if_fail = 0;
 
+    currentMessageQueue_Create_call = 0;
+    whenShallMessageQueue_Create_fail = 0;
+
+    currentMessageQueue_Push_call = 0;
+    whenShallMessageQueue_Push_fail = 0;
+
     currentLock_Init_call = 0;
     whenShallLock_Init_fail = 0;
 
@@ -591,8 +695,14 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     currentCond_Post_call = 0;
     whenShallCond_Post_fail = 0;
 
-    currentThreadAPI_Create_call = 0;
-    whenShallThreadAPI_Create_fail = 0;
+    currentWorkerPool_Create_call = 0;
+    whenShallWorkerPool_Create_fail = 0;
+
+    currentWorkerPool_CreateStrand_call = 0;
+    whenShallWorkerPool_CreateStrand_fail = 0;
+
+    currentWorkerPool_Schedule_call = 0;
+    whenShallWorkerPool_Schedule_fail = 0;
 
     current_list_index = 0;
     for (int l = 0; l < 10; l++)
@@ -600,13 +710,8 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
         fake_list[l] = NULL;
     }
 
-    shouldThreadAPI_Create_invoke_callback = false;
-    thread_func_to_call = NULL;
-    thread_func_args = NULL;
-
-    shouldIntercept_Condition_Wait = false;
-    interceptArgs_for_Condition_Wait = NULL;
-    intercept_for_Condition_Wait = NULL;
+    strand_func_to_call = NULL;
+    strand_func_args = NULL;
 
     call_status_for_FakeModule_Receive.messageHandle = NULL;
     call_status_for_FakeModule_Receive.was_called = false;
@@ -641,206 +746,63 @@ TEST_FUNCTION(Broker_AddModule_fails_with_null_broker)
     ///cleanup
 }
 
-struct Condition_Wait_Callback_Input
-{
-    BROKER_HANDLE broker;
-    MESSAGE_HANDLE message;
-};
-
-static COND_RESULT module_publish_worker_calls_module_receive_Condition_Wait2(void)
-{
-    Condition_Wait_Callback_Input* input = (Condition_Wait_Callback_Input*)interceptArgs_for_Condition_Wait;
-
-    // cause the worker to quit during the next iteration;
-    // first we get the modules vector from the broker handle
-
-    // We added one module for the test, that's our fake list...
-    unsigned char* module_info = (unsigned char*)fake_list[0];
-    sig_atomic_t* quit_worker = (sig_atomic_t*)(module_info + BROKER_offsetof_quit_worker);
-    *quit_worker = 1;
-
-    return COND_OK;
-}
-
-static COND_RESULT module_publish_worker_calls_module_receive_Condition_Wait(void)
-{
-    // publish a message on to the broker
-    Condition_Wait_Callback_Input* input = (Condition_Wait_Callback_Input*)interceptArgs_for_Condition_Wait;
-    auto result = Broker_Publish(input->broker, NULL, input->message);
-    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
-
-    // schedule module_publish_worker_calls_module_receive_Condition_Wait2 to be
-    // called during the next intercept of the Condition_Wait mock
-    intercept_for_Condition_Wait = module_publish_worker_calls_module_receive_Condition_Wait2;
-
-    return COND_OK;
-}
-
 // Tests_SRS_BCAST_BROKER_13_089: [ This function shall acquire the lock on module_info->mq_lock. ]
-// Tests_SRS_BCAST_BROKER_13_068: [ This function shall run a loop that keeps running while module_info->quit_worker is equal to 0. ]
-// Tests_SRS_BCAST_BROKER_13_071: [ For every iteration of the loop the function will first wait on module_info->mq_cond using module_info->mq_lock as the corresponding mutex to be used by the condition variable. ]
-// Tests_SRS_BCAST_BROKER_13_090: [ When module_info->mq_cond has been signaled this function shall kick off another loop predicated on module_info->quit_worker being equal to 0 and module_info->mq not being empty. This thread has the lock on module_info->mq_lock at this point. ]
-// Tests_SRS_BCAST_BROKER_13_069: [ The function shall dequeue a message from the module's message queue. ]
+// Tests_SRS_BCAST_BROKER_13_090: [ If module_info->quit_worker is equal to 0, this function shall take every message in module_info->mq by swapping it with the empty module_info->delivery_mq. ]
+// Tests_SRS_BCAST_BROKER_13_069: [ The function shall dequeue every message from module_info->delivery_mq without acquiring module_info->mq_lock. ]
 // Tests_SRS_BCAST_BROKER_13_091: [ The function shall unlock module_info->mq_lock. ]
 // Tests_SRS_BCAST_BROKER_99_012: [ The function shall deliver the message to the module's Receive function via the `IInternalGatewayModule` interface. ]
 // Tests_SRS_BROKER_99_012: [ The function shall deliver the message to the module's Receive function via the `IInternalGatewayModule` interface. ]
 // Tests_SRS_BCAST_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]
-// Tests_SRS_BCAST_BROKER_13_094: [ The function shall re-acquire the lock on module_info->mq_lock. ]
-// Tests_SRS_BCAST_BROKER_13_095: [ When the function exits the outer loop predicated on module_info->quit_worker being 0 it shall unlock module_info->mq_lock before exiting from the function. ]
 // Tests_SRS_BCAST_BROKER_13_026: [ This function shall assign user_data to a local variable called module_info of type BROKER_MODULEINFO*. ]
-// Tests_SRS_BCAST_BROKER_04_001: [** This function shall immediately start processing messages when `module->mq` is not empty without waiting on `module->mq_cond`.]
 TEST_FUNCTION(module_publish_worker_calls_module_receive)
 {
     /**
-    * This test warrants some documentation as to how it works because
-    * we are going to great lengths here to test threaded code without
-    * using threads. Here's what happens:
-    *
-    *  [1] The `ThreadAPI_Create` mock will directly call the callback
-    *      function when `shouldThreadAPI_Create_invoke_callback` is `true`.
-    *      We set this variable to `true` in this test.
-    *
-    *  [2] We call `Broker_AddModule` in this test. That function will eventually
-    *      call `ThreadAPI_Create`. `ThreadAPI_Create` will call the
-    *      `module_publish_worker` function which, among other things, will
-    *      call `Condition_Wait` which we have also mocked.
-    *
-    *  [3] When we receive the call to the mocked version of `Condition_Wait`
-    *      from `module_publish_worker` we have it invoke a function pointed at
-    *      by the variable `intercept_for_Condition_Wait` when `shouldIntercept_Condition_Wait`
-    *      is `true`. We initialize it to true and assign
-    *      `module_publish_worker_calls_module_receive_Condition_Wait` to `intercept_for_Condition_Wait`.
-    *
-    *  [4] Here's what the call stack looks like right now:
-    *
-    *          Broker_AddModule -> ThreadAPI_Create -> module_publish_worker ->
-    *          Condition_Wait -> module_publish_worker_calls_module_receive_Condition_Wait
-    *
-    *  [5] `module_publish_worker_calls_module_receive_Condition_Wait` uses the data pointed at by
-    *      the global variable `interceptArgs_for_Condition_Wait` to get a handle to the
-    *      message broker and the message to be published to the message broker. We assign a pointer to a local
-    *      variable of type `Condition_Wait_Callback_Input` in the test case
-    *      (i.e. `module_publish_worker_calls_module_receive`) to 'interceptArgs_for_Condition_Wait'.
-    *
-    *  [6] `module_publish_worker_calls_module_receive_Condition_Wait` publishes a message on to
-    *      the message broker via `Broker_Publish` and replaces `intercept_for_Condition_Wait` so that
-    *      it points to the function `module_publish_worker_calls_module_receive_Condition_Wait2`.
-    *
-    *  [7] Control then goes back to `module_publish_worker` which proceeds to consume the newly
-    *      enqueued message and delivers it to the fake module. `FakeModule_Receive` gets called
-    *      where we verify that the module handle and the message handle have expected values.
-    *
-    *  [8] `module_publish_worker` then loops around and calls `Condition_Wait` again. And this
-    *      time the `module_publish_worker_calls_module_receive_Condition_Wait2` function ends up
-    *      being called. In this function our goal is to assign `1` to the `quit_worker`
-    *      variable in the module's `BROKER_MODULEINFO` struct. Since we don't have access to the
-    *      structs backing the message broker we use the global variables `BROKER_offsetof_modules` and
-    *      `BROKER_offsetof_quit_worker` provided by the message broker API to figure out the location where
-    *      the `quit_worker` variable resides in memory and assign `1` to it.
-    *
-    *  [9] Since `quit_worker` is now `1`, `module_publish_worker` will exit its processing loop
-    *      and the entire stack will unwind and control comes back to the test case when
-    *      `Broker_AddModule` returns.
+    * The worker pool is mocked, so no worker ever runs the module's strand.
+    * The `WorkerPool_CreateStrand` mock saves the strand function and its
+    * context when `Broker_AddModule` creates the module's strand, and the
+    * test runs the strand by calling the saved function the way a worker
+    * would after `Broker_Publish` scheduled it.
     */
 
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
 
-    // make ThreadAPI_Create mock call the callback function
-    shouldThreadAPI_Create_invoke_callback = true;
-
-    // we want to intercept Condition_Wait when it is called
-    shouldIntercept_Condition_Wait = true;
-    Condition_Wait_Callback_Input input{ broker, NULL };
-    interceptArgs_for_Condition_Wait = (void*)&input;
-    intercept_for_Condition_Wait = module_publish_worker_calls_module_receive_Condition_Wait;
-
     // setup fake module's validation data
     unsigned char fake;
     MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
     auto message = Message_Create(&c);
-    input.message = message;
     call_status_for_FakeModule_Receive.messageHandle = message;
 
-    mocks.ResetAllCalls();
-
-    // this is for Broker_Publish
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_get_next_item(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Message_Clone(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+    auto result = Broker_AddModule(broker, &fake_module);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    result = Broker_Publish(broker, NULL, message);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_IS_NOT_NULL(strand_func_to_call);
 
-    // this is for the Broker_AddModule call
-    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
-        .IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module*/
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, list_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Lock_Init());
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Init());
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
+    mocks.ResetAllCalls();
 
     // this is for module_publish_worker
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) 
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG)) /*mq has the published message*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Swap(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_front(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG)) /*delivery_mq is drained*/
+        .IgnoreArgument(1);
 
     ///act
-    auto result = Broker_AddModule(broker, &fake_module);
+    strand_func_to_call(strand_func_args);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_IS_TRUE(call_status_for_FakeModule_Receive.was_called);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
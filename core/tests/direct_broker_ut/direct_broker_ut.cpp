@@ -0,0 +1,2969 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+#include <cstdlib>
+#include <cstdint>
+#include <signal.h>
+
+#include "testrunnerswitcher.h"
+#include "micromock.h"
+#include "micromockcharstararenullterminatedstrings.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/vector.h"
+#include "azure_c_shared_utility/list.h"
+#include "message.h"
+#include "internal/message_queue.h"
+#include "internal/worker_pool.h"
+#include "internal/routing_table.h"
+#include "internal/link_filter.h"
+#include "azure_c_shared_utility/refcount.h"
+
+static MICROMOCK_MUTEX_HANDLE g_testByTest;
+static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
+
+#define GBALLOC_H
+
+extern "C" int gballoc_init(void);
+extern "C" void gballoc_deinit(void);
+extern "C" void* gballoc_malloc(size_t size);
+extern "C" void* gballoc_calloc(size_t nmemb, size_t size);
+extern "C" void* gballoc_realloc(void* ptr, size_t size);
+extern "C" void gballoc_free(void* ptr);
+
+namespace BASEIMPLEMENTATION
+{
+#define Lock(x) (LOCK_OK + gballocState - gballocState) /*compiler warning about constant in if condition*/
+#define Unlock(x) (LOCK_OK + gballocState - gballocState)
+#define Lock_Init() (LOCK_HANDLE)0x42
+#define Lock_Deinit(x) (LOCK_OK + gballocState - gballocState)
+#include "gballoc.c"
+#undef Lock
+#undef Unlock
+#undef Lock_Init
+#undef Lock_Deinit
+#include "vector.c"
+#define Lock(x) LOCK_OK
+#define Unlock(x) LOCK_OK
+#define Lock_Init() (LOCK_HANDLE)0x42
+#define Lock_Deinit(x) LOCK_OK
+#define Condition_Init() (COND_HANDLE)0x43
+#define Condition_Post(x) COND_OK
+#define Condition_Wait(x, y, z) COND_OK
+#define Condition_Deinit(x)
+#include "../../src/internal/routing_table.c"
+#undef Lock
+#undef Unlock
+#undef Lock_Init
+#undef Lock_Deinit
+#undef Condition_Init
+#undef Condition_Post
+#undef Condition_Wait
+#undef Condition_Deinit
+};
+
+#include "broker.h"
+#include "azure_c_shared_utility/lock.h"
+
+DEFINE_MICROMOCK_ENUM_TO_STRING(BROKER_RESULT, BROKER_RESULT_VALUES);
+
+static size_t currentmalloc_call;
+static size_t whenShallmalloc_fail;
+
+static size_t currentVECTOR_create_call;
+static size_t whenShallVECTOR_create_fail;
+
+static size_t currentVECTOR_push_back_call;
+static size_t whenShallVECTOR_push_back_fail;
+
+static size_t currentVECTOR_find_if_call;
+static size_t whenShallVECTOR_find_if_fail;
+
+static size_t currentMessageQueue_Create_call;
+static size_t whenShallMessageQueue_Create_fail;
+
+static size_t currentMessageQueue_Push_call;
+static size_t whenShallMessageQueue_Push_fail;
+
+static size_t currentlist_find_call;
+static size_t whenShalllist_find_fail;
+
+static size_t currentlist_create_call;
+static size_t whenShalllist_create_fail;
+
+static size_t currentlist_add_call;
+static size_t whenShalllist_add_fail;
+
+
+static size_t currentLock_Init_call;
+static size_t whenShallLock_Init_fail;
+
+static size_t currentLock_call;
+static size_t whenShallLock_fail;
+
+static size_t currentUnlock_call;
+
+static size_t currentCond_Init_call;
+static size_t whenShallCond_Init_fail;
+
+static size_t currentCond_Post_call;
+static size_t whenShallCond_Post_fail;
+
+static size_t currentWorkerPool_Create_call;
+static size_t whenShallWorkerPool_Create_fail;
+
+static size_t currentWorkerPool_CreateStrand_call;
+static size_t whenShallWorkerPool_CreateStrand_fail;
+
+static size_t currentWorkerPool_Schedule_call;
+static size_t whenShallWorkerPool_Schedule_fail;
+
+static size_t currentRoutingTable_Create_call;
+static size_t whenShallRoutingTable_Create_fail;
+
+static size_t currentRoutingSnapshot_Create_call;
+static size_t whenShallRoutingSnapshot_Create_fail;
+
+/*a fake link filter is the address of its definition and passes every message but fake_filtered_message*/
+static MESSAGE_HANDLE fake_filtered_message;
+static size_t currentLinkFilter_Destroy_call;
+static size_t currentRoutingTable_Swap_call;
+/*the number of snapshots installed when the last filter was destroyed*/
+static size_t lastLinkFilter_Destroy_swap_count;
+static size_t currentLinkFilter_Matches_call;
+static size_t currentLinkFilter_MatchesMessage_call;
+
+/*a small fake of list.h: items are the addresses of the slots in fake_list*/
+#define FAKE_LIST_SIZE 10
+static size_t current_list_index;
+static const void *fake_list[FAKE_LIST_SIZE];
+
+static STRAND_FUNCTION strand_func_to_call;
+static void* strand_func_args;
+/*when set, a publisher waiting for room runs the strand created last if it was scheduled, as a worker would*/
+static bool run_strand_on_Condition_Wait;
+static size_t currentCondition_Wait_call;
+/*when not 0, Condition_Wait times out from that call on and is signaled before it*/
+static size_t whenShallCondition_Wait_time_out;
+
+static size_t FakeModule_Receive_call_count;
+static MODULE_HANDLE FakeModule_Receive_last_module;
+static MESSAGE_HANDLE FakeModule_Receive_last_message;
+
+static MODULE_HANDLE FakeModule_Create(BROKER_HANDLE broker, const void* configuration)
+{
+    return (MODULE_HANDLE)malloc(1);
+}
+static void FakeModule_Destroy(MODULE_HANDLE module)
+{
+    free(module);
+}
+
+static void FakeModule_Receive(MODULE_HANDLE module, MESSAGE_HANDLE messageHandle)
+{
+    FakeModule_Receive_call_count++;
+    FakeModule_Receive_last_module = module;
+    FakeModule_Receive_last_message = messageHandle;
+}
+
+static MODULE_APIS fake_module_apis =
+{
+    FakeModule_Create,
+    FakeModule_Destroy,
+    FakeModule_Receive
+};
+
+static MODULE_HANDLE fake_module_handle = (MODULE_HANDLE)0x42;
+static MODULE_HANDLE fake_module_handle2 = (MODULE_HANDLE)0x43;
+static MODULE_HANDLE fake_module_handle3 = (MODULE_HANDLE)0x44;
+
+MODULE fake_module =
+{
+    &fake_module_apis,
+    fake_module_handle
+};
+
+MODULE fake_module2 =
+{
+    &fake_module_apis,
+    fake_module_handle2
+};
+
+MODULE fake_module3 =
+{
+    &fake_module_apis,
+    fake_module_handle3
+};
+
+static size_t FakeModule_ReceiveBatch_call_count;
+static size_t FakeModule_ReceiveBatch_last_count;
+
+static MODULE_HANDLE fake_batch_module_handle = (MODULE_HANDLE)0x45;
+static void FakeModule_ReceiveBatch(MODULE_HANDLE module, MESSAGE_HANDLE* messageHandles, size_t messageCount)
+{
+    ASSERT_ARE_EQUAL(void_ptr, fake_batch_module_handle, module);
+    ASSERT_IS_NOT_NULL(messageHandles);
+    FakeModule_ReceiveBatch_call_count++;
+    FakeModule_ReceiveBatch_last_count = messageCount;
+}
+
+static MODULE_APIS fake_batch_module_apis =
+{
+    FakeModule_Create,
+    FakeModule_Destroy,
+    FakeModule_Receive,
+    NULL,
+    FakeModule_ReceiveBatch
+};
+
+MODULE fake_batch_module =
+{
+    &fake_batch_module_apis,
+    fake_batch_module_handle
+};
+
+static size_t FakeModule_ReceiveOwned_call_count;
+static MESSAGE_HANDLE FakeModule_ReceiveOwned_last_message;
+
+static MODULE_HANDLE fake_owned_module_handle = (MODULE_HANDLE)0x46;
+static void FakeModule_ReceiveOwned(MODULE_HANDLE module, MESSAGE_HANDLE messageHandle)
+{
+    ASSERT_ARE_EQUAL(void_ptr, fake_owned_module_handle, module);
+    ASSERT_IS_NOT_NULL(messageHandle);
+    FakeModule_ReceiveOwned_call_count++;
+    FakeModule_ReceiveOwned_last_message = messageHandle;
+}
+
+static MODULE_APIS fake_owned_module_apis =
+{
+    FakeModule_Create,
+    FakeModule_Destroy,
+    FakeModule_Receive,
+    NULL,
+    NULL,
+    FakeModule_ReceiveOwned
+};
+
+MODULE fake_owned_module =
+{
+    &fake_owned_module_apis,
+    fake_owned_module_handle
+};
+
+/*a module that publishes the message it receives from fake_module again, once, while it receives it*/
+static BROKER_HANDLE FakeModule_Republish_broker;
+static BROKER_RESULT FakeModule_Republish_result;
+
+static MODULE_HANDLE fake_republish_module_handle = (MODULE_HANDLE)0x47;
+static void FakeModule_ReceiveAndRepublish(MODULE_HANDLE module, MESSAGE_HANDLE messageHandle)
+{
+    FakeModule_Receive(module, messageHandle);
+    if (FakeModule_Republish_broker != NULL)
+    {
+        BROKER_HANDLE broker = FakeModule_Republish_broker;
+        FakeModule_Republish_broker = NULL;
+        FakeModule_Republish_result = Broker_Publish(broker, fake_module_handle, messageHandle);
+    }
+}
+
+static MODULE_APIS fake_republish_module_apis =
+{
+    FakeModule_Create,
+    FakeModule_Destroy,
+    FakeModule_ReceiveAndRepublish
+};
+
+MODULE fake_republish_module =
+{
+    &fake_republish_module_apis,
+    fake_republish_module_handle
+};
+
+/*a module that tries to change the topology of the broker while it receives a message*/
+static BROKER_HANDLE FakeModule_Relink_broker;
+static BROKER_RESULT FakeModule_Relink_add_module_result;
+static BROKER_RESULT FakeModule_Relink_remove_module_result;
+static BROKER_RESULT FakeModule_Relink_add_link_result;
+static BROKER_RESULT FakeModule_Relink_remove_link_result;
+
+static MODULE_HANDLE fake_relink_module_handle = (MODULE_HANDLE)0x48;
+static void FakeModule_ReceiveAndRelink(MODULE_HANDLE module, MESSAGE_HANDLE messageHandle)
+{
+    FakeModule_Receive(module, messageHandle);
+    if (FakeModule_Relink_broker != NULL)
+    {
+        BROKER_LINK_DATA link = { fake_module_handle, fake_relink_module_handle };
+        FakeModule_Relink_add_module_result = Broker_AddModule(FakeModule_Relink_broker, &fake_module3);
+        FakeModule_Relink_remove_module_result = Broker_RemoveModule(FakeModule_Relink_broker, &fake_module);
+        FakeModule_Relink_add_link_result = Broker_AddLink(FakeModule_Relink_broker, &link);
+        FakeModule_Relink_remove_link_result = Broker_RemoveLink(FakeModule_Relink_broker, &link);
+    }
+}
+
+static MODULE_APIS fake_relink_module_apis =
+{
+    FakeModule_Create,
+    FakeModule_Destroy,
+    FakeModule_ReceiveAndRelink
+};
+
+MODULE fake_relink_module =
+{
+    &fake_relink_module_apis,
+    fake_relink_module_handle
+};
+
+class RefCountObject
+{
+private:
+    size_t ref_count;
+
+public:
+    RefCountObject() : ref_count(1)
+    {
+    }
+
+    size_t inc_ref()
+    {
+        return ++ref_count;
+    }
+
+    void dec_ref()
+    {
+        if (--ref_count == 0)
+        {
+            delete this;
+        }
+    }
+};
+
+/*the content of every fake message*/
+static const unsigned char fake_content_bytes[] = { 1, 2, 3 };
+static const CONSTBUFFER fake_content = { fake_content_bytes, sizeof(fake_content_bytes) };
+
+/*a fake MESSAGE_BATCH_HANDLE*/
+typedef struct FAKE_MESSAGE_BATCH_TAG
+{
+    MESSAGE_HANDLE messages[2];
+    size_t count;
+} FAKE_MESSAGE_BATCH;
+
+TYPED_MOCK_CLASS(CBrokerMocks, CGlobalMock)
+{
+public:
+
+    MOCK_STATIC_METHOD_1(, void*, gballoc_malloc, size_t, size)
+        void* result2;
+        currentmalloc_call++;
+        if (currentmalloc_call == whenShallmalloc_fail)
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = BASEIMPLEMENTATION::gballoc_malloc(size);
+        }
+    MOCK_METHOD_END(void*, result2);
+
+    MOCK_STATIC_METHOD_1(, void, gballoc_free, void*, ptr)
+        BASEIMPLEMENTATION::gballoc_free(ptr);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_0(, LOCK_HANDLE, Lock_Init)
+        LOCK_HANDLE result2;
+        ++currentLock_Init_call;
+        if ((whenShallLock_Init_fail > 0) &&
+            (currentLock_Init_call == whenShallLock_Init_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = (LOCK_HANDLE)malloc(1);
+        }
+    MOCK_METHOD_END(LOCK_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, LOCK_RESULT, Lock, LOCK_HANDLE, lock)
+        LOCK_RESULT result2;
+        ++currentLock_call;
+        if ((whenShallLock_fail > 0) &&
+            (currentLock_call == whenShallLock_fail))
+        {
+            result2 = LOCK_ERROR;
+        }
+        else
+        {
+            result2 = LOCK_OK;
+        }
+    MOCK_METHOD_END(LOCK_RESULT, result2)
+
+    MOCK_STATIC_METHOD_1(, LOCK_RESULT, Unlock, LOCK_HANDLE, lock)
+        ASSERT_IS_TRUE((currentLock_call - currentUnlock_call) > 0);
+        ++currentUnlock_call;
+        auto result2 = LOCK_OK;
+    MOCK_METHOD_END(LOCK_RESULT, result2)
+
+    MOCK_STATIC_METHOD_1(, LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, lock)
+        free(lock);
+        auto result2 = LOCK_OK;
+    MOCK_METHOD_END(LOCK_RESULT, result2)
+
+    MOCK_STATIC_METHOD_0(, COND_HANDLE, Condition_Init)
+        COND_HANDLE result2;
+        ++currentCond_Init_call;
+        if ((whenShallCond_Init_fail > 0) &&
+            (currentCond_Init_call == whenShallCond_Init_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = (COND_HANDLE)malloc(2);
+        }
+    MOCK_METHOD_END(COND_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, COND_RESULT, Condition_Post, COND_HANDLE, handle)
+        COND_RESULT result2;
+        ++currentCond_Post_call;
+        if ((whenShallCond_Post_fail > 0) &&
+            (currentCond_Post_call == whenShallCond_Post_fail))
+        {
+            result2 = COND_ERROR;
+        }
+        else
+        {
+            result2 = COND_OK;
+        }
+    MOCK_METHOD_END(COND_RESULT, result2)
+
+    MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds)
+        auto result2 = COND_OK;
+        ++currentCondition_Wait_call;
+        if ((whenShallCondition_Wait_time_out > 0) &&
+            (currentCondition_Wait_call >= whenShallCondition_Wait_time_out))
+        {
+            result2 = COND_TIMEOUT;
+        }
+        if (run_strand_on_Condition_Wait && currentWorkerPool_Schedule_call > 0)
+        {
+            strand_func_to_call(strand_func_args);
+        }
+    MOCK_METHOD_END(COND_RESULT, result2)
+
+    MOCK_STATIC_METHOD_1(, void, Condition_Deinit, COND_HANDLE, handle)
+        free(handle);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_1(, VECTOR_HANDLE, VECTOR_create, size_t, elementSize)
+        VECTOR_HANDLE result2;
+        ++currentVECTOR_create_call;
+        if ((whenShallVECTOR_create_fail > 0) &&
+            (currentVECTOR_create_call == whenShallVECTOR_create_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = BASEIMPLEMENTATION::VECTOR_create(elementSize);
+        }
+    MOCK_METHOD_END(VECTOR_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, VECTOR_destroy, VECTOR_HANDLE, vector)
+        BASEIMPLEMENTATION::VECTOR_destroy(vector);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_3(, int, VECTOR_push_back, VECTOR_HANDLE, vector, const void*, elements, size_t, numElements)
+        int result2;
+        ++currentVECTOR_push_back_call;
+        if ((whenShallVECTOR_push_back_fail > 0) &&
+            (currentVECTOR_push_back_call == whenShallVECTOR_push_back_fail))
+        {
+            result2 = __LINE__;
+        }
+        else
+        {
+            result2 = BASEIMPLEMENTATION::VECTOR_push_back(vector, elements, numElements);
+        }
+    MOCK_METHOD_END(int, result2)
+
+    MOCK_STATIC_METHOD_3(, void, VECTOR_erase, VECTOR_HANDLE, vector, void*, elements, size_t, numElements)
+        BASEIMPLEMENTATION::VECTOR_erase(vector, elements, numElements);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, void*, VECTOR_element, VECTOR_HANDLE, vector, size_t, index)
+        void* result2 = BASEIMPLEMENTATION::VECTOR_element(vector, index);
+    MOCK_METHOD_END(void*, result2)
+
+    MOCK_STATIC_METHOD_1(, void*, VECTOR_front, VECTOR_HANDLE, vector)
+        void* result2 = BASEIMPLEMENTATION::VECTOR_front(vector);
+    MOCK_METHOD_END(void*, result2)
+
+    MOCK_STATIC_METHOD_1(, void*, VECTOR_back, const VECTOR_HANDLE, vector)
+        void* result2 = BASEIMPLEMENTATION::VECTOR_back(vector);
+    MOCK_METHOD_END(void*, result2)
+
+    MOCK_STATIC_METHOD_3(, void*, VECTOR_find_if, VECTOR_HANDLE, vector, PREDICATE_FUNCTION, pred, const void*, value)
+        void* result2;
+        ++currentVECTOR_find_if_call;
+        if ((whenShallVECTOR_find_if_fail > 0) &&
+            (currentVECTOR_find_if_call == whenShallVECTOR_find_if_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = BASEIMPLEMENTATION::VECTOR_find_if(vector, pred, value);
+        }
+    MOCK_METHOD_END(void*, result2)
+
+    MOCK_STATIC_METHOD_1(, size_t, VECTOR_size, VECTOR_HANDLE, vector)
+        size_t result2 = BASEIMPLEMENTATION::VECTOR_size(vector);
+    MOCK_METHOD_END(size_t, result2)
+
+    // message_queue.h
+    // the fake message queue is a VECTOR of MESSAGE_HANDLEs behind one level
+    // of indirection so that two queues can be swapped
+    MOCK_STATIC_METHOD_0(, MESSAGE_QUEUE_HANDLE, MessageQueue_Create)
+        MESSAGE_QUEUE_HANDLE result2;
+        ++currentMessageQueue_Create_call;
+        if ((whenShallMessageQueue_Create_fail > 0) &&
+            (currentMessageQueue_Create_call == whenShallMessageQueue_Create_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            VECTOR_HANDLE* queue = (VECTOR_HANDLE*)malloc(sizeof(VECTOR_HANDLE));
+            *queue = BASEIMPLEMENTATION::VECTOR_create(sizeof(MESSAGE_HANDLE));
+            result2 = (MESSAGE_QUEUE_HANDLE)queue;
+        }
+    MOCK_METHOD_END(MESSAGE_QUEUE_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, MessageQueue_Destroy, MESSAGE_QUEUE_HANDLE, queue)
+        BASEIMPLEMENTATION::VECTOR_destroy(*(VECTOR_HANDLE*)queue);
+        free(queue);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, int, MessageQueue_Push, MESSAGE_QUEUE_HANDLE, queue, MESSAGE_HANDLE, message)
+        int result2;
+        ++currentMessageQueue_Push_call;
+        if ((whenShallMessageQueue_Push_fail > 0) &&
+            (currentMessageQueue_Push_call == whenShallMessageQueue_Push_fail))
+        {
+            result2 = __LINE__;
+        }
+        else
+        {
+            result2 = BASEIMPLEMENTATION::VECTOR_push_back(*(VECTOR_HANDLE*)queue, &message, 1);
+        }
+    MOCK_METHOD_END(int, result2)
+
+    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, MessageQueue_Pop, MESSAGE_QUEUE_HANDLE, queue)
+        MESSAGE_HANDLE result2;
+        VECTOR_HANDLE vector = *(VECTOR_HANDLE*)queue;
+        if (BASEIMPLEMENTATION::VECTOR_size(vector) == 0)
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            MESSAGE_HANDLE* front = (MESSAGE_HANDLE*)BASEIMPLEMENTATION::VECTOR_front(vector);
+            result2 = *front;
+            BASEIMPLEMENTATION::VECTOR_erase(vector, front, 1);
+        }
+    MOCK_METHOD_END(MESSAGE_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, size_t, MessageQueue_Size, MESSAGE_QUEUE_HANDLE, queue)
+        size_t result2 = BASEIMPLEMENTATION::VECTOR_size(*(VECTOR_HANDLE*)queue);
+    MOCK_METHOD_END(size_t, result2)
+
+    MOCK_STATIC_METHOD_2(, void, MessageQueue_Swap, MESSAGE_QUEUE_HANDLE, queue1, MESSAGE_QUEUE_HANDLE, queue2)
+        VECTOR_HANDLE temp = *(VECTOR_HANDLE*)queue1;
+        *(VECTOR_HANDLE*)queue1 = *(VECTOR_HANDLE*)queue2;
+        *(VECTOR_HANDLE*)queue2 = temp;
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_1(, WORKER_POOL_HANDLE, WorkerPool_Create, size_t, worker_count)
+        WORKER_POOL_HANDLE result2;
+        ++currentWorkerPool_Create_call;
+        if ((whenShallWorkerPool_Create_fail > 0) &&
+            (currentWorkerPool_Create_call == whenShallWorkerPool_Create_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = (WORKER_POOL_HANDLE)malloc(3);
+        }
+    MOCK_METHOD_END(WORKER_POOL_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, WorkerPool_Destroy, WORKER_POOL_HANDLE, pool)
+        free(pool);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_3(, STRAND_HANDLE, WorkerPool_CreateStrand, WORKER_POOL_HANDLE, pool, STRAND_FUNCTION, function, void*, context)
+        STRAND_HANDLE result2;
+        ++currentWorkerPool_CreateStrand_call;
+        if ((whenShallWorkerPool_CreateStrand_fail > 0) &&
+            (currentWorkerPool_CreateStrand_call == whenShallWorkerPool_CreateStrand_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = (STRAND_HANDLE)malloc(4);
+            strand_func_to_call = function;
+            strand_func_args = context;
+        }
+    MOCK_METHOD_END(STRAND_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, int, WorkerPool_Schedule, STRAND_HANDLE, strand)
+        int result2;
+        ++currentWorkerPool_Schedule_call;
+        if ((whenShallWorkerPool_Schedule_fail > 0) &&
+            (currentWorkerPool_Schedule_call == whenShallWorkerPool_Schedule_fail))
+        {
+            result2 = __LINE__;
+        }
+        else
+        {
+            result2 = 0;
+        }
+    MOCK_METHOD_END(int, result2)
+
+    MOCK_STATIC_METHOD_1(, void, WorkerPool_DestroyStrand, STRAND_HANDLE, strand)
+        free(strand);
+    MOCK_VOID_METHOD_END()
+
+    // routing_table.h
+    MOCK_STATIC_METHOD_0(, ROUTING_TABLE_HANDLE, RoutingTable_Create)
+        ROUTING_TABLE_HANDLE result2;
+        ++currentRoutingTable_Create_call;
+        if ((whenShallRoutingTable_Create_fail > 0) &&
+            (currentRoutingTable_Create_call == whenShallRoutingTable_Create_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = BASEIMPLEMENTATION::RoutingTable_Create();
+        }
+    MOCK_METHOD_END(ROUTING_TABLE_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, RoutingTable_Destroy, ROUTING_TABLE_HANDLE, table)
+        BASEIMPLEMENTATION::RoutingTable_Destroy(table);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, void, RoutingTable_Swap, ROUTING_TABLE_HANDLE, table, ROUTING_SNAPSHOT_HANDLE, snapshot)
+        ++currentRoutingTable_Swap_call;
+        BASEIMPLEMENTATION::RoutingTable_Swap(table, snapshot);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_1(, ROUTING_SNAPSHOT_HANDLE, RoutingTable_Acquire, ROUTING_TABLE_HANDLE, table)
+        ROUTING_SNAPSHOT_HANDLE result2 = BASEIMPLEMENTATION::RoutingTable_Acquire(table);
+    MOCK_METHOD_END(ROUTING_SNAPSHOT_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_2(, void, RoutingTable_Release, ROUTING_TABLE_HANDLE, table, ROUTING_SNAPSHOT_HANDLE, snapshot)
+        BASEIMPLEMENTATION::RoutingTable_Release(table, snapshot);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, ROUTING_SNAPSHOT_HANDLE, RoutingSnapshot_Create, size_t, entry_count, size_t, sink_count)
+        ROUTING_SNAPSHOT_HANDLE result2;
+        ++currentRoutingSnapshot_Create_call;
+        if ((whenShallRoutingSnapshot_Create_fail > 0) &&
+            (currentRoutingSnapshot_Create_call == whenShallRoutingSnapshot_Create_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = BASEIMPLEMENTATION::RoutingSnapshot_Create(entry_count, sink_count);
+        }
+    MOCK_METHOD_END(ROUTING_SNAPSHOT_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, void, RoutingSnapshot_Destroy, ROUTING_SNAPSHOT_HANDLE, snapshot)
+        BASEIMPLEMENTATION::RoutingSnapshot_Destroy(snapshot);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_4(, ROUTING_SINK*, RoutingSnapshot_AddEntry, ROUTING_SNAPSHOT_HANDLE, snapshot, const void*, key, void*, module, size_t, sink_count)
+        ROUTING_SINK* result2 = BASEIMPLEMENTATION::RoutingSnapshot_AddEntry(snapshot, key, module, sink_count);
+    MOCK_METHOD_END(ROUTING_SINK*, result2)
+
+    MOCK_STATIC_METHOD_2(, const ROUTING_ENTRY*, RoutingSnapshot_Find, ROUTING_SNAPSHOT_HANDLE, snapshot, const void*, key)
+        const ROUTING_ENTRY* result2 = BASEIMPLEMENTATION::RoutingSnapshot_Find(snapshot, key);
+    MOCK_METHOD_END(const ROUTING_ENTRY*, result2)
+
+    MOCK_STATIC_METHOD_2(, const ROUTING_ENTRY*, RoutingSnapshot_GetEntries, ROUTING_SNAPSHOT_HANDLE, snapshot, size_t*, entry_count)
+        const ROUTING_ENTRY* result2 = BASEIMPLEMENTATION::RoutingSnapshot_GetEntries(snapshot, entry_count);
+    MOCK_METHOD_END(const ROUTING_ENTRY*, result2)
+
+    // link_filter.h
+
+    MOCK_STATIC_METHOD_1(, LINK_FILTER_HANDLE, LinkFilter_Create, const BROKER_LINK_FILTER*, definition)
+    MOCK_METHOD_END(LINK_FILTER_HANDLE, (LINK_FILTER_HANDLE)definition)
+
+    MOCK_STATIC_METHOD_1(, void, LinkFilter_Destroy, LINK_FILTER_HANDLE, filter)
+        if (filter != NULL)
+        {
+            ++currentLinkFilter_Destroy_call;
+            lastLinkFilter_Destroy_swap_count = currentRoutingTable_Swap_call;
+        }
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, int, LinkFilter_IsSameAs, LINK_FILTER_HANDLE, filter, const BROKER_LINK_FILTER*, definition)
+    MOCK_METHOD_END(int, (filter == (LINK_FILTER_HANDLE)definition) ? 1 : 0)
+
+    MOCK_STATIC_METHOD_2(, int, LinkFilter_Matches, LINK_FILTER_HANDLE, filter, MESSAGE_HANDLE, message)
+        ++currentLinkFilter_Matches_call;
+    MOCK_METHOD_END(int, (filter == NULL || message != fake_filtered_message) ? 1 : 0)
+
+    MOCK_STATIC_METHOD_2(, void, LinkFilter_InitMessage, LINK_FILTER_MESSAGE*, filter_message, MESSAGE_HANDLE, message)
+        filter_message->message = message;
+        filter_message->property_count = 0;
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, int, LinkFilter_MatchesMessage, LINK_FILTER_HANDLE, filter, LINK_FILTER_MESSAGE*, filter_message)
+        ++currentLinkFilter_MatchesMessage_call;
+    MOCK_METHOD_END(int, (filter == NULL || filter_message->message != fake_filtered_message) ? 1 : 0)
+
+    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg)
+        MESSAGE_HANDLE result2 = (MESSAGE_HANDLE)(new RefCountObject());
+    MOCK_METHOD_END(MESSAGE_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message)
+        ((RefCountObject*)message)->inc_ref();
+    MOCK_METHOD_END(MESSAGE_HANDLE, message)
+
+    MOCK_STATIC_METHOD_1(, void, Message_Destroy, MESSAGE_HANDLE, message)
+        ((RefCountObject*)message)->dec_ref();
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_1(, const CONSTBUFFER*, Message_GetContent, MESSAGE_HANDLE, message)
+    MOCK_METHOD_END(const CONSTBUFFER*, &fake_content)
+
+    MOCK_STATIC_METHOD_1(, size_t, MessageBatch_GetCount, MESSAGE_BATCH_HANDLE, batch)
+    MOCK_METHOD_END(size_t, ((FAKE_MESSAGE_BATCH*)batch)->count)
+
+    MOCK_STATIC_METHOD_1(, const MESSAGE_HANDLE*, MessageBatch_GetMessages, MESSAGE_BATCH_HANDLE, batch)
+    MOCK_METHOD_END(const MESSAGE_HANDLE*, ((FAKE_MESSAGE_BATCH*)batch)->messages)
+
+    // list.h
+
+    MOCK_STATIC_METHOD_0(, LIST_HANDLE, list_create)
+        ++currentlist_create_call;
+        LIST_HANDLE result1;
+        if (currentlist_create_call == whenShalllist_create_fail)
+        {
+            result1 = NULL;
+        }
+        else
+        {
+            result1 = (LIST_HANDLE)(new RefCountObject());
+        }
+    MOCK_METHOD_END(LIST_HANDLE, result1)
+
+    MOCK_STATIC_METHOD_1(, void, list_destroy, LIST_HANDLE, list)
+        ((RefCountObject*)list)->dec_ref();
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, LIST_ITEM_HANDLE, list_add, LIST_HANDLE, list, const void*, item)
+        LIST_ITEM_HANDLE result1;
+        ++currentlist_add_call;
+        if ((currentlist_add_call == whenShalllist_add_fail) ||
+            (list == NULL) ||
+            (item == NULL) ||
+            (current_list_index == FAKE_LIST_SIZE))
+        {
+            result1 = NULL;
+        }
+        else
+        {
+            fake_list[current_list_index] = item;
+            result1 = (LIST_ITEM_HANDLE)&fake_list[current_list_index];
+            current_list_index++;
+        }
+    MOCK_METHOD_END(LIST_ITEM_HANDLE, result1)
+
+    MOCK_STATIC_METHOD_2(, int, list_remove, LIST_HANDLE, list, LIST_ITEM_HANDLE, item)
+        int result2;
+        if ((list == NULL) ||
+            (item == NULL))
+        {
+            result2 = __LINE__;
+        }
+        else
+        {
+            size_t index = (const void**)item - fake_list;
+            for (size_t i = index; i + 1 < current_list_index; i++)
+            {
+                fake_list[i] = fake_list[i + 1];
+            }
+            fake_list[--current_list_index] = NULL;
+            result2 = 0;
+        }
+    MOCK_METHOD_END(int, result2)
+
+    MOCK_STATIC_METHOD_1(, LIST_ITEM_HANDLE, list_get_head_item, LIST_HANDLE, list)
+        LIST_ITEM_HANDLE result1;
+        if ((list == NULL) || (current_list_index == 0))
+        {
+            result1 = NULL;
+        }
+        else
+        {
+            result1 = (LIST_ITEM_HANDLE)&fake_list[0];
+        }
+    MOCK_METHOD_END(LIST_ITEM_HANDLE, result1)
+
+    MOCK_STATIC_METHOD_1(, LIST_ITEM_HANDLE, list_get_next_item, LIST_ITEM_HANDLE, item_handle)
+        LIST_ITEM_HANDLE result1;
+        size_t index = (const void**)item_handle - fake_list;
+        if ((item_handle == NULL) || (index + 1 >= current_list_index))
+        {
+            result1 = NULL;
+        }
+        else
+        {
+            result1 = (LIST_ITEM_HANDLE)&fake_list[index + 1];
+        }
+    MOCK_METHOD_END(LIST_ITEM_HANDLE, result1)
+
+    MOCK_STATIC_METHOD_3(, LIST_ITEM_HANDLE, list_find, LIST_HANDLE, list, LIST_MATCH_FUNCTION, match_function, const void*, match_context)
+        LIST_ITEM_HANDLE result1 = NULL;
+        currentlist_find_call++;
+        if ((currentlist_find_call != whenShalllist_find_fail) &&
+            (list != NULL) &&
+            (match_function != NULL))
+        {
+            for (size_t i = 0; i < current_list_index; i++)
+            {
+                if (match_function((LIST_ITEM_HANDLE)&fake_list[i], match_context))
+                {
+                    result1 = (LIST_ITEM_HANDLE)&fake_list[i];
+                    break;
+                }
+            }
+        }
+    MOCK_METHOD_END(LIST_ITEM_HANDLE, result1)
+
+    MOCK_STATIC_METHOD_1(, const void*, list_item_get_value, LIST_ITEM_HANDLE, item_handle)
+        const void* result1;
+        if (item_handle == NULL)
+        {
+            result1 = NULL;
+        }
+        else
+        {
+            result1 = *(const void**)item_handle;
+        }
+    MOCK_METHOD_END(const void*, result1)
+};
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void*, gballoc_malloc, size_t, size);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, gballoc_free, void*, ptr);
+
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , LOCK_HANDLE, Lock_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Lock, LOCK_HANDLE, lock);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Unlock, LOCK_HANDLE, lock);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, lock);
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , VECTOR_HANDLE, VECTOR_create, size_t, elementSize);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, VECTOR_destroy, VECTOR_HANDLE, vector);
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , int, VECTOR_push_back, VECTOR_HANDLE, vector, const void*, elements, size_t, numElements);
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , void, VECTOR_erase, VECTOR_HANDLE, vector, void*, elements, size_t, numElements);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , void*, VECTOR_element, VECTOR_HANDLE, vector, size_t, index);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void*, VECTOR_front, VECTOR_HANDLE, vector);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void*, VECTOR_back, VECTOR_HANDLE, vector);
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , void*, VECTOR_find_if, VECTOR_HANDLE, vector, PREDICATE_FUNCTION, pred, const void*, value);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , size_t, VECTOR_size, VECTOR_HANDLE, vector);
+
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , MESSAGE_QUEUE_HANDLE, MessageQueue_Create);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, MessageQueue_Destroy, MESSAGE_QUEUE_HANDLE, queue);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, MessageQueue_Push, MESSAGE_QUEUE_HANDLE, queue, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, MessageQueue_Pop, MESSAGE_QUEUE_HANDLE, queue);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , size_t, MessageQueue_Size, MESSAGE_QUEUE_HANDLE, queue);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , void, MessageQueue_Swap, MESSAGE_QUEUE_HANDLE, queue1, MESSAGE_QUEUE_HANDLE, queue2);
+
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , COND_HANDLE, Condition_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , COND_RESULT, Condition_Post, COND_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, Condition_Deinit, COND_HANDLE, handle);
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , WORKER_POOL_HANDLE, WorkerPool_Create, size_t, worker_count);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, WorkerPool_Destroy, WORKER_POOL_HANDLE, pool);
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , STRAND_HANDLE, WorkerPool_CreateStrand, WORKER_POOL_HANDLE, pool, STRAND_FUNCTION, function, void*, context);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , int, WorkerPool_Schedule, STRAND_HANDLE, strand);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, WorkerPool_DestroyStrand, STRAND_HANDLE, strand);
+
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , ROUTING_TABLE_HANDLE, RoutingTable_Create);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, RoutingTable_Destroy, ROUTING_TABLE_HANDLE, table);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , void, RoutingTable_Swap, ROUTING_TABLE_HANDLE, table, ROUTING_SNAPSHOT_HANDLE, snapshot);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , ROUTING_SNAPSHOT_HANDLE, RoutingTable_Acquire, ROUTING_TABLE_HANDLE, table);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , void, RoutingTable_Release, ROUTING_TABLE_HANDLE, table, ROUTING_SNAPSHOT_HANDLE, snapshot);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , ROUTING_SNAPSHOT_HANDLE, RoutingSnapshot_Create, size_t, entry_count, size_t, sink_count);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, RoutingSnapshot_Destroy, ROUTING_SNAPSHOT_HANDLE, snapshot);
+DECLARE_GLOBAL_MOCK_METHOD_4(CBrokerMocks, , ROUTING_SINK*, RoutingSnapshot_AddEntry, ROUTING_SNAPSHOT_HANDLE, snapshot, const void*, key, void*, module, size_t, sink_count);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , const ROUTING_ENTRY*, RoutingSnapshot_Find, ROUTING_SNAPSHOT_HANDLE, snapshot, const void*, key);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , const ROUTING_ENTRY*, RoutingSnapshot_GetEntries, ROUTING_SNAPSHOT_HANDLE, snapshot, size_t*, entry_count);
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LINK_FILTER_HANDLE, LinkFilter_Create, const BROKER_LINK_FILTER*, definition);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, LinkFilter_Destroy, LINK_FILTER_HANDLE, filter);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, LinkFilter_IsSameAs, LINK_FILTER_HANDLE, filter, const BROKER_LINK_FILTER*, definition);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, LinkFilter_Matches, LINK_FILTER_HANDLE, filter, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , void, LinkFilter_InitMessage, LINK_FILTER_MESSAGE*, filter_message, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, LinkFilter_MatchesMessage, LINK_FILTER_HANDLE, filter, LINK_FILTER_MESSAGE*, filter_message);
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, Message_Destroy, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , const CONSTBUFFER*, Message_GetContent, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , size_t, MessageBatch_GetCount, MESSAGE_BATCH_HANDLE, batch);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , const MESSAGE_HANDLE*, MessageBatch_GetMessages, MESSAGE_BATCH_HANDLE, batch);
+
+// list.h
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , LIST_HANDLE, list_create);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, list_destroy, LIST_HANDLE, list);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , LIST_ITEM_HANDLE, list_add, LIST_HANDLE, list, const void*, item);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, list_remove, LIST_HANDLE, list, LIST_ITEM_HANDLE, item_handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LIST_ITEM_HANDLE, list_get_head_item, LIST_HANDLE, list);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LIST_ITEM_HANDLE, list_get_next_item, LIST_ITEM_HANDLE, item_handle);
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , LIST_ITEM_HANDLE, list_find, LIST_HANDLE, list, LIST_MATCH_FUNCTION, match_function, const void*, match_context);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , const void*, list_item_get_value, LIST_ITEM_HANDLE, item_handle);
+
+
+static MESSAGE_HANDLE create_fake_message(void)
+{
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    return Message_Create(&c);
+}
+
+static void add_link(BROKER_HANDLE broker, MODULE_HANDLE source, MODULE_HANDLE sink)
+{
+    BROKER_LINK_DATA link = { source, sink };
+    auto result = Broker_AddLink(broker, &link);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+}
+
+BEGIN_TEST_SUITE(direct_broker_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = MicroMockCreateMutex();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    MicroMockDestroyMutex(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (!MicroMockAcquireMutex(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    currentmalloc_call = 0;
+    whenShallmalloc_fail = 0;
+
+    currentVECTOR_create_call = 0;
+    whenShallVECTOR_create_fail = 0;
+
+    currentVECTOR_push_back_call = 0;
+    whenShallVECTOR_push_back_fail = 0;
+
+    currentVECTOR_find_if_call = 0;
+    whenShallVECTOR_find_if_fail = 0;
+
+    currentMessageQueue_Create_call = 0;
+    whenShallMessageQueue_Create_fail = 0;
+
+    currentMessageQueue_Push_call = 0;
+    whenShallMessageQueue_Push_fail = 0;
+
+    currentLock_Init_call = 0;
+    whenShallLock_Init_fail = 0;
+
+    currentlist_find_call = 0;
+    whenShalllist_find_fail = 0;
+
+    currentlist_create_call = 0;
+    whenShalllist_create_fail = 0;
+
+    currentlist_add_call = 0;
+    whenShalllist_add_fail = 0;
+
+    currentLock_call = 0;
+    whenShallLock_fail = 0;
+
+    currentUnlock_call = 0;
+
+    currentCond_Init_call = 0;
+    whenShallCond_Init_fail = 0;
+
+    currentCond_Post_call = 0;
+    whenShallCond_Post_fail = 0;
+
+    currentWorkerPool_Create_call = 0;
+    whenShallWorkerPool_Create_fail = 0;
+
+    currentWorkerPool_CreateStrand_call = 0;
+    whenShallWorkerPool_CreateStrand_fail = 0;
+
+    currentWorkerPool_Schedule_call = 0;
+    whenShallWorkerPool_Schedule_fail = 0;
+
+    currentRoutingTable_Create_call = 0;
+    whenShallRoutingTable_Create_fail = 0;
+
+    currentRoutingSnapshot_Create_call = 0;
+    whenShallRoutingSnapshot_Create_fail = 0;
+
+    fake_filtered_message = NULL;
+    currentLinkFilter_Destroy_call = 0;
+    currentRoutingTable_Swap_call = 0;
+    lastLinkFilter_Destroy_swap_count = 0;
+    currentLinkFilter_Matches_call = 0;
+    currentLinkFilter_MatchesMessage_call = 0;
+
+    current_list_index = 0;
+    for (int l = 0; l < FAKE_LIST_SIZE; l++)
+    {
+        fake_list[l] = NULL;
+    }
+
+    strand_func_to_call = NULL;
+    strand_func_args = NULL;
+    run_strand_on_Condition_Wait = false;
+    currentCondition_Wait_call = 0;
+    whenShallCondition_Wait_time_out = 0;
+
+    FakeModule_Receive_call_count = 0;
+    FakeModule_Receive_last_module = NULL;
+    FakeModule_Receive_last_message = NULL;
+
+    FakeModule_ReceiveBatch_call_count = 0;
+    FakeModule_ReceiveBatch_last_count = 0;
+
+    FakeModule_ReceiveOwned_call_count = 0;
+    FakeModule_ReceiveOwned_last_message = NULL;
+
+    FakeModule_Republish_broker = NULL;
+    FakeModule_Republish_result = BROKER_ERROR;
+
+    FakeModule_Relink_broker = NULL;
+    FakeModule_Relink_add_module_result = BROKER_OK;
+    FakeModule_Relink_remove_module_result = BROKER_OK;
+    FakeModule_Relink_add_link_result = BROKER_OK;
+    FakeModule_Relink_remove_link_result = BROKER_OK;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    if (!MicroMockReleaseMutex(g_testByTest))
+    {
+        ASSERT_FAIL("failure in test framework at ReleaseMutex");
+    }
+}
+
+//Tests_SRS_DIRECT_BROKER_13_001: [Broker_Create shall malloc a new instance of BROKER_HANDLE_DATA and return NULL if it fails.]
+//Tests_SRS_DIRECT_BROKER_13_002: [Broker_Create shall initialize BROKER_HANDLE_DATA::modules with a valid LIST_HANDLE.]
+//Tests_SRS_DIRECT_BROKER_13_004: [Broker_Create shall initialize BROKER_HANDLE_DATA::modules_lock with a valid LOCK_HANDLE.]
+//Tests_SRS_DIRECT_BROKER_13_005: [This API shall yield a BROKER_HANDLE representing the newly created message broker. This handle value shall not be equal to NULL when the API call is successful.]
+//Tests_SRS_DIRECT_BROKER_13_083: [Broker_Create shall behave as Broker_CreateWithOptions called with NULL options.]
+//Tests_SRS_DIRECT_BROKER_13_084: [Broker_CreateWithOptions shall initialize BROKER_HANDLE_DATA::worker_pool by calling WorkerPool_Create with options->worker_count, or 0 when options is NULL.]
+//Tests_SRS_DIRECT_BROKER_13_093: [Broker_CreateWithOptions shall initialize BROKER_HANDLE_DATA::routing_table by calling RoutingTable_Create.]
+TEST_FUNCTION(Broker_Create_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_create());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Create(0));
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Create());
+
+    ///act
+    auto r = Broker_Create();
+
+    ///assert
+    ASSERT_IS_NOT_NULL(r);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(r);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
+TEST_FUNCTION(Broker_Create_fails_when_list_create_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShalllist_create_fail = 1;
+    STRICT_EXPECTED_CALL(mocks, list_create());
+
+    ///act
+    auto r = Broker_Create();
+
+    ///assert
+    ASSERT_IS_NULL(r);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_DIRECT_BROKER_13_084: [Broker_CreateWithOptions shall initialize BROKER_HANDLE_DATA::worker_pool by calling WorkerPool_Create with options->worker_count, or 0 when options is NULL.]
+TEST_FUNCTION(Broker_CreateWithOptions_creates_the_requested_number_of_workers)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_OPTIONS options = { 2 };
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_create());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Create(2));
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Create());
+
+    ///act
+    auto r = Broker_CreateWithOptions(&options);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(r);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(r);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
+TEST_FUNCTION(Broker_Create_fails_when_WorkerPool_Create_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    whenShallWorkerPool_Create_fail = 1;
+
+    ///act
+    auto r = Broker_Create();
+
+    ///assert
+    ASSERT_IS_NULL(r);
+    ASSERT_ARE_EQUAL(size_t, 1, currentWorkerPool_Create_call);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_003: [This function shall return NULL if an underlying API call to the platform causes an error.]
+TEST_FUNCTION(Broker_Create_fails_when_RoutingTable_Create_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    whenShallRoutingTable_Create_fail = 1;
+
+    ///act
+    auto r = Broker_Create();
+
+    ///assert
+    ASSERT_IS_NULL(r);
+    ASSERT_ARE_EQUAL(size_t, 1, currentRoutingTable_Create_call);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_061: [If the ref count is zero then the allocated resources are freed.]
+//Tests_SRS_DIRECT_BROKER_13_085: [Broker_Destroy shall destroy BROKER_HANDLE_DATA::worker_pool by calling WorkerPool_Destroy.]
+//Tests_SRS_DIRECT_BROKER_13_100: [Broker_Destroy shall destroy BROKER_HANDLE_DATA::routing_table by calling RoutingTable_Destroy.]
+TEST_FUNCTION(Broker_Destroy_destroys_the_worker_pool)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    Broker_Destroy(broker);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_DIRECT_BROKER_13_031: [If `broker` or `module` is NULL the function shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_AddModule_fails_with_null_module)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_AddModule(broker, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_019: [The function shall make a copy of `module` and assign it to `BROKER_MODULEINFO::module`.]
+//Tests_SRS_DIRECT_BROKER_13_020: [The function shall initialize BROKER_MODULEINFO::mq with a valid vector handle.]
+//Tests_SRS_DIRECT_BROKER_13_021: [The function shall initialize BROKER_MODULEINFO::routes with a valid vector handle.]
+//Tests_SRS_DIRECT_BROKER_13_022: [The function shall initialize BROKER_MODULEINFO::mq_lock with a valid lock handle.]
+//Tests_SRS_DIRECT_BROKER_13_026: [The function shall create a strand for the module on BROKER_HANDLE_DATA::worker_pool by calling WorkerPool_CreateStrand using module_publish_worker as the strand function and using the newly allocated BROKER_MODULEINFO object as the strand context.]
+//Tests_SRS_DIRECT_BROKER_13_035: [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]
+//Tests_SRS_DIRECT_BROKER_13_036: [Broker_AddModule shall append the new instance of BROKER_MODULEINFO to BROKER_HANDLE_DATA::modules.]
+//Tests_SRS_DIRECT_BROKER_13_037: [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]
+//Tests_SRS_DIRECT_BROKER_13_094: [The broker shall rebuild its routing snapshot by calling RoutingSnapshot_Create and RoutingSnapshot_AddEntry with every module of BROKER_HANDLE_DATA::modules and the sinks of its routes, and install it by calling RoutingTable_Swap.]
+//Tests_SRS_DIRECT_BROKER_13_095: [Broker_AddModule shall rebuild the broker's routing snapshot, and remove and free the module and return BROKER_ERROR if it fails.]
+TEST_FUNCTION(Broker_AddModule_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG)) /*this is for the routes*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_CreateStrand(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, list_get_next_item(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(3);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_Create(1, 0));
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_AddEntry(IGNORED_PTR_ARG, fake_module_handle, IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Swap(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_079: [If `options` is not NULL and its queue policy is not a BROKER_QUEUE_POLICY value, or is BROKER_QUEUE_BLOCK with a block_timeout_ms of 0, the function shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_AddModuleWithOptions_fails_when_block_policy_has_no_timeout)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_BLOCK, 0 } };
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_AddModuleWithOptions(broker, &fake_module, &options);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_034: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_AddModule_fails_when_routes_VECTOR_create_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    whenShallVECTOR_create_fail = 1;
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, 0, current_list_index);
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_020: [The function shall initialize BROKER_MODULEINFO::mq and BROKER_MODULEINFO::delivery_mq with valid message queue handles.]
+//Tests_SRS_DIRECT_BROKER_13_034: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_AddModule_fails_when_MessageQueue_Create_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    whenShallMessageQueue_Create_fail = 2;
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Create());
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the module*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, 0, current_list_index);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_046: [If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_AddLink shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_AddLink_fails_with_null_source)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_LINK_DATA link = { NULL, fake_module_handle };
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_AddLink(broker, &link);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_095: [Broker_AddModule shall rebuild the broker's routing snapshot, and remove and free the module and return BROKER_ERROR if it fails.]
+TEST_FUNCTION(Broker_AddModule_fails_when_RoutingSnapshot_Create_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    whenShallRoutingSnapshot_Create_fail = 1;
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
+    auto publish_result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, publish_result);
+    ASSERT_ARE_EQUAL(size_t, 0, current_list_index);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_048: [Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR.]
+TEST_FUNCTION(Broker_AddLink_fails_when_source_is_not_attached)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA link = { fake_module_handle2, fake_module_handle };
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_AddLink(broker, &link);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ADD_LINK_ERROR, result);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_047: [Broker_AddLink shall lock the modules_lock.]
+//Tests_SRS_DIRECT_BROKER_13_049: [Broker_AddLink shall find the BROKER_MODULEINFO for link->module_sink_handle and link->module_source_handle.]
+//Tests_SRS_DIRECT_BROKER_13_051: [Otherwise Broker_AddLink shall append a new route to the sink to BROKER_MODULEINFO::routes of the source.]
+//Tests_SRS_DIRECT_BROKER_13_052: [Broker_AddLink shall unlock the modules_lock.]
+//Tests_SRS_DIRECT_BROKER_13_098: [After appending a new route, Broker_AddLink shall rebuild the broker's routing snapshot, and remove the route and return BROKER_ADD_LINK_ERROR if it fails.]
+TEST_FUNCTION(Broker_AddLink_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2 };
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, fake_module_handle2))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, list_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, fake_module_handle))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(9);
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(7);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the counters of the route*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, list_get_next_item(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(4);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_Create(2, 1));
+    EXPECTED_CALL(mocks, RoutingSnapshot_AddEntry(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(3);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Swap(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_AddLink(broker, &link);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_055: [Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR.]
+TEST_FUNCTION(Broker_RemoveLink_fails_when_link_does_not_exist)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2 };
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_RemoveLink(broker, &link);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_REMOVE_LINK_ERROR, result);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_050: [If the route from source to sink already exists, Broker_AddLink shall increment its link count.]
+//Tests_SRS_DIRECT_BROKER_13_057: [Broker_RemoveLink shall decrement the link count of the route and remove the route when the count reaches 0.]
+TEST_FUNCTION(Broker_RemoveLink_keeps_route_until_last_link_is_removed)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2 };
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result1 = Broker_RemoveLink(broker, &link);
+    auto publish1 = Broker_Publish(broker, fake_module_handle, message);
+    size_t schedules_after_first_remove = currentWorkerPool_Schedule_call;
+    auto result2 = Broker_RemoveLink(broker, &link);
+    auto publish2 = Broker_Publish(broker, fake_module_handle, message);
+    auto result3 = Broker_RemoveLink(broker, &link);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result1);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result2);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_REMOVE_LINK_ERROR, result3);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, publish1);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, publish2);
+    ASSERT_ARE_EQUAL(size_t, 1, schedules_after_first_remove);
+    ASSERT_ARE_EQUAL(size_t, 1, currentWorkerPool_Schedule_call);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_063: [If broker, source or message is NULL the function shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_Publish_fails_with_null_source)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_Publish(broker, NULL, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_066: [If source is not attached to the broker, Broker_Publish shall return BROKER_ERROR.]
+TEST_FUNCTION(Broker_Publish_fails_when_source_is_not_attached)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, result);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_064: [Broker_Publish shall acquire the broker's routing snapshot by calling RoutingTable_Acquire, and shall not acquire BROKER_HANDLE_DATA::modules_lock.]
+//Tests_SRS_DIRECT_BROKER_13_065: [Broker_Publish shall find the routing entry of source by calling RoutingSnapshot_Find.]
+//Tests_SRS_DIRECT_BROKER_13_068: [Broker_Publish shall start a processing loop for every sink of the routing entry of the source.]
+//Tests_SRS_DIRECT_BROKER_13_069: [In the loop, the function shall first acquire the lock on BROKER_MODULEINFO::mq_lock of the sink.]
+//Tests_SRS_DIRECT_BROKER_13_070: [The function shall then append message to BROKER_MODULEINFO::mq of the sink by calling Message_Clone and MessageQueue_Push.]
+//Tests_SRS_DIRECT_BROKER_13_071: [The function shall then schedule BROKER_MODULEINFO::strand of the sink by calling WorkerPool_Schedule, unless it delivers the messages inline.]
+//Tests_SRS_DIRECT_BROKER_13_072: [The function shall then release BROKER_MODULEINFO::mq_lock of the sink.]
+//Tests_SRS_DIRECT_BROKER_13_073: [Broker_Publish shall release the routing snapshot by calling RoutingTable_Release after the loop.]
+TEST_FUNCTION(Broker_Publish_delivers_only_to_linked_sinks)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    (void)Broker_AddModule(broker, &fake_module3);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_Find(IGNORED_PTR_ARG, fake_module_handle))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_GetContent(message));
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Push(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Schedule(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    auto result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module3);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_067: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_Publish_fails_when_MessageQueue_Push_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    whenShallMessageQueue_Push_fail = currentMessageQueue_Push_call + 1;
+
+    ///act
+    auto result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, 0, currentWorkerPool_Schedule_call);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_082: [If the message still does not fit in BROKER_MODULEINFO::mq of the sink, the function shall not enqueue it and Broker_Publish shall return BROKER_BUSY unless an error occurs.]
+TEST_FUNCTION(Broker_Publish_returns_BUSY_when_drop_newest_queue_is_full)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_DROP_NEWEST, 0 } };
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModuleWithOptions(broker, &fake_module2, &options);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result1 = Broker_Publish(broker, fake_module_handle, message);
+    size_t pushes_after_first_publish = currentMessageQueue_Push_call;
+    auto result2 = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result1);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_BUSY, result2);
+    ASSERT_ARE_EQUAL(size_t, pushes_after_first_publish, currentMessageQueue_Push_call);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_080: [If the message does not fit in BROKER_MODULEINFO::mq of the sink and the policy is BROKER_QUEUE_DROP_OLDEST, the function shall destroy the oldest queued messages until it fits.]
+TEST_FUNCTION(Broker_Publish_drops_oldest_message_when_queue_is_full)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_DROP_OLDEST, 0 } };
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModuleWithOptions(broker, &fake_module2, &options);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result1 = Broker_Publish(broker, fake_module_handle, message);
+    size_t pushes_after_first_publish = currentMessageQueue_Push_call;
+    auto result2 = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result1);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result2);
+    ASSERT_ARE_EQUAL(size_t, pushes_after_first_publish + 1, currentMessageQueue_Push_call);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_129: [The broker shall fuse a module with its source when the module's queue options allow inline delivery, exactly one module has a route to it and it has at most one route.]
+//Tests_SRS_DIRECT_BROKER_13_131: [The broker shall mark the route to a fused module as delivering inline in the routing snapshot.]
+//Tests_SRS_DIRECT_BROKER_13_132: [If the route delivers inline, module_info->quit_worker of the sink is 0, its BROKER_MODULEINFO::mq is empty and BROKER_MODULEINFO::receiving is false, the function shall set BROKER_MODULEINFO::receiving to true and append the messages to BROKER_MODULEINFO::delivery_mq of the sink instead of BROKER_MODULEINFO::mq, without applying the bounds of the queue.]
+//Tests_SRS_DIRECT_BROKER_13_133: [After releasing the lock, the function shall deliver the messages in BROKER_MODULEINFO::delivery_mq of the sink on the calling thread, as module_publish_worker does.]
+//Tests_SRS_DIRECT_BROKER_13_134: [The function shall then set BROKER_MODULEINFO::receiving of the sink to false under BROKER_MODULEINFO::mq_lock and, if messages were queued for the sink meanwhile, schedule its strand by calling WorkerPool_Schedule.]
+TEST_FUNCTION(Broker_Publish_delivers_inline_to_a_fused_module)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 0, 0, BROKER_QUEUE_DROP_NEWEST, 0, 0, 1 } };
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModuleWithOptions(broker, &fake_module2, &options);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_Find(IGNORED_PTR_ARG, fake_module_handle))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Push(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_GetContent(message));
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    auto result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, 0, currentWorkerPool_Schedule_call);
+    ASSERT_ARE_EQUAL(size_t, 1, FakeModule_Receive_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, fake_module_handle2, FakeModule_Receive_last_module);
+    ASSERT_ARE_EQUAL(void_ptr, message, FakeModule_Receive_last_message);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_135: [If the calling thread is delivering messages inline for `broker`, the function shall return BROKER_ERROR.]
+//Tests_SRS_DIRECT_BROKER_13_136: [If the calling thread is delivering messages inline for `broker`, the function shall return BROKER_ERROR.]
+//Tests_SRS_DIRECT_BROKER_13_137: [If the calling thread is delivering messages inline for `broker`, Broker_AddLink shall return BROKER_ADD_LINK_ERROR.]
+//Tests_SRS_DIRECT_BROKER_13_138: [If the calling thread is delivering messages inline for `broker`, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR.]
+//Tests_SRS_DIRECT_BROKER_13_139: [While it delivers inline, the function shall record that the calling thread delivers messages inline for the broker.]
+TEST_FUNCTION(Broker_topology_changes_fail_while_a_fused_module_receives)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 0, 0, BROKER_QUEUE_DROP_NEWEST, 0, 0, 1 } };
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModuleWithOptions(broker, &fake_relink_module, &options);
+    add_link(broker, fake_module_handle, fake_relink_module_handle);
+    auto message = create_fake_message();
+    FakeModule_Relink_broker = broker;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, FakeModule_Receive_call_count);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, FakeModule_Relink_add_module_result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, FakeModule_Relink_remove_module_result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ADD_LINK_ERROR, FakeModule_Relink_add_link_result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_REMOVE_LINK_ERROR, FakeModule_Relink_remove_link_result);
+
+    ///cleanup
+    FakeModule_Relink_broker = NULL;
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_relink_module);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_129: [The broker shall fuse a module with its source when the module's queue options allow inline delivery, exactly one module has a route to it and it has at most one route.]
+TEST_FUNCTION(Broker_Publish_queues_for_a_module_linked_from_two_modules)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 0, 0, BROKER_QUEUE_DROP_NEWEST, 0, 0, 1 } };
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module3);
+    (void)Broker_AddModuleWithOptions(broker, &fake_module2, &options);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    add_link(broker, fake_module_handle3, fake_module_handle2);
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, currentWorkerPool_Schedule_call);
+    ASSERT_ARE_EQUAL(size_t, 0, FakeModule_Receive_call_count);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module3);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_130: [The broker shall not fuse a module whose chain of fused sources leads back to it, since publishing from the module would then call the module back on the same thread.]
+TEST_FUNCTION(Broker_Publish_queues_for_modules_linked_in_a_loop)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 0, 0, BROKER_QUEUE_DROP_NEWEST, 0, 0, 1 } };
+    (void)Broker_AddModuleWithOptions(broker, &fake_module, &options);
+    (void)Broker_AddModuleWithOptions(broker, &fake_module2, &options);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    add_link(broker, fake_module_handle2, fake_module_handle);
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, currentWorkerPool_Schedule_call);
+    ASSERT_ARE_EQUAL(size_t, 0, FakeModule_Receive_call_count);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_132: [If the route delivers inline, module_info->quit_worker of the sink is 0, its BROKER_MODULEINFO::mq is empty and BROKER_MODULEINFO::receiving is false, the function shall set BROKER_MODULEINFO::receiving to true and append the messages to BROKER_MODULEINFO::delivery_mq of the sink instead of BROKER_MODULEINFO::mq, without applying the bounds of the queue.]
+//Tests_SRS_DIRECT_BROKER_13_134: [The function shall then set BROKER_MODULEINFO::receiving of the sink to false under BROKER_MODULEINFO::mq_lock and, if messages were queued for the sink meanwhile, schedule its strand by calling WorkerPool_Schedule.]
+//Tests_SRS_DIRECT_BROKER_13_127: [If the module's queue options allow inline delivery, the function shall set BROKER_MODULEINFO::receiving to true when it takes the messages.]
+//Tests_SRS_DIRECT_BROKER_13_128: [If the function set BROKER_MODULEINFO::receiving, it shall set it back to false under module_info->mq_lock once the messages are delivered.]
+TEST_FUNCTION(Broker_Publish_queues_for_a_fused_module_that_is_receiving)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 0, 0, BROKER_QUEUE_DROP_NEWEST, 0, 0, 1 } };
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModuleWithOptions(broker, &fake_republish_module, &options);
+    add_link(broker, fake_module_handle, fake_republish_module_handle);
+    auto message = create_fake_message();
+    FakeModule_Republish_broker = broker;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_Publish(broker, fake_module_handle, message);
+    size_t received_inline = FakeModule_Receive_call_count;
+    size_t schedules_after_publish = currentWorkerPool_Schedule_call;
+
+    // the last strand created belongs to fake_republish_module
+    strand_func_to_call(strand_func_args);
+    size_t received_after_strand = FakeModule_Receive_call_count;
+
+    auto result2 = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, FakeModule_Republish_result);
+    ASSERT_ARE_EQUAL(size_t, 1, received_inline);
+    /*once by the publish made while receiving, once when the inline delivery ends*/
+    ASSERT_ARE_EQUAL(size_t, 2, schedules_after_publish);
+    ASSERT_ARE_EQUAL(size_t, 2, received_after_strand);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result2);
+    ASSERT_ARE_EQUAL(size_t, 3, FakeModule_Receive_call_count);
+    ASSERT_ARE_EQUAL(size_t, 2, currentWorkerPool_Schedule_call);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_republish_module);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_090: [If broker, source or batch is NULL the function shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_PublishBatch_fails_with_null_batch)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_PublishBatch(broker, fake_module_handle, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_091: [If the batch is empty, Broker_PublishBatch shall return BROKER_OK without acquiring any lock.]
+TEST_FUNCTION(Broker_PublishBatch_with_empty_batch_does_nothing)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    FAKE_MESSAGE_BATCH batch = { { NULL, NULL }, 0 };
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, MessageBatch_GetCount((MESSAGE_BATCH_HANDLE)&batch));
+
+    ///act
+    auto result = Broker_PublishBatch(broker, fake_module_handle, (MESSAGE_BATCH_HANDLE)&batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_092: [Broker_PublishBatch shall publish the messages of the batch as Broker_Publish does, acquiring the routing snapshot and the BROKER_MODULEINFO::mq_lock of every sink once, appending all the messages to the sink's queue in order and scheduling the sink's strand once.]
+TEST_FUNCTION(Broker_PublishBatch_enqueues_all_messages_under_one_lock)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    FAKE_MESSAGE_BATCH batch = { { create_fake_message(), create_fake_message() }, 2 };
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, MessageBatch_GetCount((MESSAGE_BATCH_HANDLE)&batch));
+    STRICT_EXPECTED_CALL(mocks, MessageBatch_GetMessages((MESSAGE_BATCH_HANDLE)&batch));
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_Find(IGNORED_PTR_ARG, fake_module_handle))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_GetContent(batch.messages[0]));
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(batch.messages[0]));
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Push(IGNORED_PTR_ARG, batch.messages[0]))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_GetContent(batch.messages[1]));
+    STRICT_EXPECTED_CALL(mocks, Message_Clone(batch.messages[1]));
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Push(IGNORED_PTR_ARG, batch.messages[1]))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, WorkerPool_Schedule(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    auto result = Broker_PublishBatch(broker, fake_module_handle, (MESSAGE_BATCH_HANDLE)&batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(batch.messages[0]);
+    Message_Destroy(batch.messages[1]);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_082: [If the message still does not fit in BROKER_MODULEINFO::mq of the sink, the function shall not enqueue it and Broker_Publish shall return BROKER_BUSY unless an error occurs.]
+TEST_FUNCTION(Broker_PublishBatch_returns_BUSY_when_the_batch_does_not_fit)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_DROP_NEWEST, 0 } };
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModuleWithOptions(broker, &fake_module2, &options);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    FAKE_MESSAGE_BATCH batch = { { create_fake_message(), create_fake_message() }, 2 };
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_PublishBatch(broker, fake_module_handle, (MESSAGE_BATCH_HANDLE)&batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_BUSY, result);
+    ASSERT_ARE_EQUAL(size_t, 1, currentMessageQueue_Push_call);
+    ASSERT_ARE_EQUAL(size_t, 1, currentWorkerPool_Schedule_call);
+
+    ///cleanup
+    Message_Destroy(batch.messages[0]);
+    Message_Destroy(batch.messages[1]);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_140: [Before it waits, the function shall schedule BROKER_MODULEINFO::strand of the sink by calling WorkerPool_Schedule, so that the sink drains the messages already queued, and shall not wait if that fails.]
+//Tests_SRS_DIRECT_BROKER_13_081: [If the message does not fit in BROKER_MODULEINFO::mq of the sink and the policy is BROKER_QUEUE_BLOCK, the function shall wait on BROKER_MODULEINFO::space_cond until the message fits, the sink is being removed or block_timeout_ms has elapsed since it started waiting.]
+TEST_FUNCTION(Broker_PublishBatch_larger_than_a_block_queue_is_drained_by_an_idle_sink)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_BLOCK, 10 } };
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModuleWithOptions(broker, &fake_module2, &options);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    FAKE_MESSAGE_BATCH batch = { { create_fake_message(), create_fake_message() }, 2 };
+    run_strand_on_Condition_Wait = true;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_PublishBatch(broker, fake_module_handle, (MESSAGE_BATCH_HANDLE)&batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 2, currentMessageQueue_Push_call);
+    ASSERT_ARE_EQUAL(size_t, 1, FakeModule_Receive_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, batch.messages[0], FakeModule_Receive_last_message);
+    ASSERT_ARE_EQUAL(size_t, 2, currentWorkerPool_Schedule_call); /*before the wait, then for the last message*/
+
+    ///cleanup
+    run_strand_on_Condition_Wait = false;
+    Message_Destroy(batch.messages[0]);
+    Message_Destroy(batch.messages[1]);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_081: [If the message does not fit in BROKER_MODULEINFO::mq of the sink and the policy is BROKER_QUEUE_BLOCK, the function shall wait on BROKER_MODULEINFO::space_cond until the message fits, the sink is being removed or block_timeout_ms has elapsed since it started waiting.]
+//Tests_SRS_DIRECT_BROKER_13_082: [If the message still does not fit in BROKER_MODULEINFO::mq of the sink, the function shall not enqueue it and Broker_Publish shall return BROKER_BUSY unless an error occurs.]
+TEST_FUNCTION(Broker_Publish_waits_again_when_it_is_signaled_and_the_block_queue_of_the_sink_is_still_full)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_BLOCK, 10000 } };
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModuleWithOptions(broker, &fake_module2, &options);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    auto message = create_fake_message();
+    (void)Broker_Publish(broker, fake_module_handle, message);
+    /*the first wakeup does not make room*/
+    whenShallCondition_Wait_time_out = currentCondition_Wait_call + 2;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_BUSY, result);
+    ASSERT_ARE_EQUAL(size_t, 2, currentCondition_Wait_call);
+    ASSERT_ARE_EQUAL(size_t, 1, currentMessageQueue_Push_call);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_142: [If BROKER_MODULEINFO::space_cond is not NULL, Broker_RemoveModule shall mark the module as being removed under BROKER_MODULEINFO::mq_lock and signal BROKER_MODULEINFO::space_cond before it rebuilds the routing snapshot, so that the publishers waiting for room in its queue return BROKER_BUSY instead of holding the snapshot until block_timeout_ms elapses.]
+TEST_FUNCTION(Broker_RemoveModule_wakes_the_publishers_waiting_for_room_in_its_queue)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_BLOCK, 10 } };
+    (void)Broker_AddModuleWithOptions(broker, &fake_module2, &options);
+    size_t posts_before_remove = currentCond_Post_call;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_RemoveModule(broker, &fake_module2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, posts_before_remove + 1, currentCond_Post_call);
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_098: [After appending a new route, Broker_AddLink shall rebuild the broker's routing snapshot, and remove the route and return BROKER_ADD_LINK_ERROR if it fails.]
+TEST_FUNCTION(Broker_AddLink_removes_the_route_when_RoutingSnapshot_Create_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2 };
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    whenShallRoutingSnapshot_Create_fail = currentRoutingSnapshot_Create_call + 1;
+
+    ///act
+    auto result = Broker_AddLink(broker, &link);
+    auto publish_result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ADD_LINK_ERROR, result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, publish_result);
+    ASSERT_ARE_EQUAL(size_t, 0, currentWorkerPool_Schedule_call);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_097: [If rebuilding the routing snapshot fails, Broker_RemoveModule shall install an empty routing snapshot by calling RoutingTable_Swap with NULL, still remove the module and return BROKER_ERROR.]
+TEST_FUNCTION(Broker_RemoveModule_installs_an_empty_snapshot_when_RoutingSnapshot_Create_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    whenShallRoutingSnapshot_Create_fail = currentRoutingSnapshot_Create_call + 1;
+
+    ///act
+    auto result = Broker_RemoveModule(broker, &fake_module2);
+    auto publish_result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, publish_result);
+    ASSERT_ARE_EQUAL(size_t, 1, current_list_index);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_043: [The function shall remove every route whose sink is the module being removed.]
+TEST_FUNCTION(Broker_RemoveModule_removes_routes_to_the_module)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    auto message = create_fake_message();
+
+    ///act
+    auto result = Broker_RemoveModule(broker, &fake_module2);
+    mocks.ResetAllCalls();
+    auto publish_result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, publish_result);
+    ASSERT_ARE_EQUAL(size_t, 0, currentWorkerPool_Schedule_call);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+static const BROKER_FILTER_CONDITION fake_conditions[] = { { BROKER_FILTER_EQUALS, "source", "bleTelemetry" } };
+static const BROKER_LINK_FILTER fake_filter = { fake_conditions, 1 };
+static const BROKER_LINK_FILTER fake_filter2 = { fake_conditions, 1 };
+
+//Tests_SRS_DIRECT_BROKER_13_102: [If link->filter is not NULL, Broker_AddLink shall compile it for the new route by calling LinkFilter_Create.]
+TEST_FUNCTION(Broker_AddLink_creates_the_filter_of_the_link)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2, &fake_filter };
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, LinkFilter_Create(&fake_filter));
+
+    ///act
+    auto result = Broker_AddLink(broker, &link);
+    auto publish_result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, publish_result);
+    ASSERT_ARE_EQUAL(size_t, 1, currentWorkerPool_Schedule_call);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_048: [Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR.]
+TEST_FUNCTION(Broker_AddLink_fails_when_LinkFilter_Create_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2, &fake_filter };
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, LinkFilter_Create(&fake_filter))
+        .SetFailReturn((LINK_FILTER_HANDLE)NULL);
+
+    ///act
+    auto result = Broker_AddLink(broker, &link);
+    auto publish_result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ADD_LINK_ERROR, result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, publish_result);
+    ASSERT_ARE_EQUAL(size_t, 0, currentWorkerPool_Schedule_call);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_101: [If the route from source to sink already exists and LinkFilter_IsSameAs tells that its filter is not link->filter, Broker_AddLink shall return BROKER_ADD_LINK_ERROR.]
+TEST_FUNCTION(Broker_AddLink_fails_when_the_link_exists_with_another_filter)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2, &fake_filter };
+    BROKER_LINK_DATA other_link = { fake_module_handle, fake_module_handle2, &fake_filter2 };
+    BROKER_LINK_DATA unfiltered_link = { fake_module_handle, fake_module_handle2 };
+    (void)Broker_AddLink(broker, &link);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, LinkFilter_IsSameAs((LINK_FILTER_HANDLE)&fake_filter, &fake_filter2));
+    STRICT_EXPECTED_CALL(mocks, LinkFilter_IsSameAs((LINK_FILTER_HANDLE)&fake_filter, NULL));
+    STRICT_EXPECTED_CALL(mocks, LinkFilter_IsSameAs((LINK_FILTER_HANDLE)&fake_filter, &fake_filter));
+
+    ///act
+    auto other_result = Broker_AddLink(broker, &other_link);
+    auto unfiltered_result = Broker_AddLink(broker, &unfiltered_link);
+    auto same_result = Broker_AddLink(broker, &link);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ADD_LINK_ERROR, other_result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ADD_LINK_ERROR, unfiltered_result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, same_result);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_103: [In the loop, if the route has a filter, the function shall test the messages against it by calling LinkFilter_MatchesMessage, skip the sink without acquiring its lock if none of them passes, and only append the messages that pass.]
+TEST_FUNCTION(Broker_Publish_skips_a_sink_whose_filter_rejects_the_message)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2, &fake_filter };
+    (void)Broker_AddLink(broker, &link);
+    auto message = create_fake_message();
+    fake_filtered_message = message;
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Acquire(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, RoutingSnapshot_Find(IGNORED_PTR_ARG, fake_module_handle))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, LinkFilter_InitMessage(IGNORED_PTR_ARG, message))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, LinkFilter_MatchesMessage((LINK_FILTER_HANDLE)&fake_filter, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, RoutingTable_Release(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    auto result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_103: [In the loop, if the route has a filter, the function shall test the messages against it by calling LinkFilter_MatchesMessage, skip the sink without acquiring its lock if none of them passes, and only append the messages that pass.]
+TEST_FUNCTION(Broker_PublishBatch_only_enqueues_the_messages_that_pass_the_filter)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2, &fake_filter };
+    (void)Broker_AddLink(broker, &link);
+    FAKE_MESSAGE_BATCH batch = { { create_fake_message(), create_fake_message() }, 2 };
+    fake_filtered_message = batch.messages[0];
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_PublishBatch(broker, fake_module_handle, (MESSAGE_BATCH_HANDLE)&batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, currentMessageQueue_Push_call);
+    ASSERT_ARE_EQUAL(size_t, 1, currentWorkerPool_Schedule_call);
+
+    ///cleanup
+    Message_Destroy(batch.messages[0]);
+    Message_Destroy(batch.messages[1]);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_141: [If a sink of the routing entry of the source has a filter, Broker_Publish shall initialize a LINK_FILTER_MESSAGE for every message by calling LinkFilter_InitMessage before the loop, so that the filters of all the sinks share the properties and the hashes they look up; if it cannot allocate them for a batch, the function shall test the messages by calling LinkFilter_Matches instead.]
+TEST_FUNCTION(Broker_PublishBatch_tests_the_messages_with_LinkFilter_Matches_when_malloc_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2, &fake_filter };
+    (void)Broker_AddLink(broker, &link);
+    FAKE_MESSAGE_BATCH batch = { { create_fake_message(), create_fake_message() }, 2 };
+    fake_filtered_message = batch.messages[0];
+    whenShallmalloc_fail = currentmalloc_call + 1;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_PublishBatch(broker, fake_module_handle, (MESSAGE_BATCH_HANDLE)&batch);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, currentMessageQueue_Push_call);
+    ASSERT_ARE_EQUAL(size_t, 2, currentLinkFilter_Matches_call);
+    ASSERT_ARE_EQUAL(size_t, 0, currentLinkFilter_MatchesMessage_call);
+
+    ///cleanup
+    whenShallmalloc_fail = 0;
+    Message_Destroy(batch.messages[0]);
+    Message_Destroy(batch.messages[1]);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_104: [The broker shall destroy the filter of a route by calling LinkFilter_Destroy only after it has installed a routing snapshot that does not reference the route.]
+TEST_FUNCTION(Broker_RemoveLink_destroys_the_filter_after_the_snapshot_is_installed)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2, &fake_filter };
+    (void)Broker_AddLink(broker, &link);
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    size_t swaps_before_remove = currentRoutingTable_Swap_call;
+
+    ///act
+    auto result = Broker_RemoveLink(broker, &link);
+    size_t destroyed_filters = currentLinkFilter_Destroy_call;
+    auto publish_result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, publish_result);
+    ASSERT_ARE_EQUAL(size_t, 1, destroyed_filters);
+    ASSERT_ARE_EQUAL(size_t, swaps_before_remove + 1, lastLinkFilter_Destroy_swap_count);
+    ASSERT_ARE_EQUAL(size_t, 0, currentWorkerPool_Schedule_call);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_009: [This function shall acquire the lock on module_info->mq_lock.]
+//Tests_SRS_DIRECT_BROKER_13_013: [If module_info->quit_worker is equal to 0, the function shall take every message in the module's message queue by swapping module_info->mq with the empty module_info->delivery_mq.]
+//Tests_SRS_DIRECT_BROKER_13_014: [The function shall unlock module_info->mq_lock.]
+//Tests_SRS_DIRECT_BROKER_13_074: [The function shall deliver the messages in module_info->delivery_mq in order and without acquiring module_info->mq_lock, until module_info->quit_worker is not equal to 0.]
+//Tests_SRS_DIRECT_BROKER_13_015: [The function shall deliver the message to the module's Receive function.]
+//Tests_SRS_DIRECT_BROKER_13_016: [The function shall destroy the message that was dequeued by calling Message_Destroy.]
+TEST_FUNCTION(module_publish_worker_delivers_the_published_handle)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    auto message = create_fake_message();
+    (void)Broker_Publish(broker, fake_module_handle, message);
+
+    // the last strand created belongs to fake_module2
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Swap(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    strand_func_to_call(strand_func_args);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, 1, FakeModule_Receive_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, fake_module_handle2, FakeModule_Receive_last_module);
+    ASSERT_ARE_EQUAL(void_ptr, message, FakeModule_Receive_last_message);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_086: [If the module implements Module_ReceiveBatch, the function shall allocate BROKER_MODULEINFO::batch with room for queue_options.max_batch_size message handles, or a default number of handles when it is 0.]
+//Tests_SRS_DIRECT_BROKER_13_087: [If BROKER_MODULEINFO::batch is not NULL, the function shall hand the messages in module_info->delivery_mq to the module's Module_ReceiveBatch in order, at most BROKER_MODULEINFO::batch_capacity at a time, and destroy them after each call.]
+TEST_FUNCTION(module_publish_worker_hands_messages_to_Module_ReceiveBatch)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_batch_module);
+    add_link(broker, fake_module_handle, fake_batch_module_handle);
+    auto message = create_fake_message();
+    (void)Broker_Publish(broker, fake_module_handle, message);
+    (void)Broker_Publish(broker, fake_module_handle, message);
+
+    // the last strand created belongs to fake_batch_module
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Swap(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(3);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(message))
+        .ExpectedTimesExactly(2);
+
+    ///act
+    strand_func_to_call(strand_func_args);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, 1, FakeModule_ReceiveBatch_call_count);
+    ASSERT_ARE_EQUAL(size_t, 2, FakeModule_ReceiveBatch_last_count);
+    ASSERT_ARE_EQUAL(size_t, 0, FakeModule_Receive_call_count);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_batch_module);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_089: [If the module implements Module_ReceiveOwned, the function shall deliver the message through it and shall not destroy the message.]
+TEST_FUNCTION(module_publish_worker_hands_message_ownership_to_Module_ReceiveOwned)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_owned_module);
+    add_link(broker, fake_module_handle, fake_owned_module_handle);
+    auto message = create_fake_message();
+    (void)Broker_Publish(broker, fake_module_handle, message);
+
+    // the last strand created belongs to fake_owned_module
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Swap(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MessageQueue_Pop(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+
+    ///act
+    strand_func_to_call(strand_func_args);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, 1, FakeModule_ReceiveOwned_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, message, FakeModule_ReceiveOwned_last_message);
+    ASSERT_ARE_EQUAL(size_t, 0, FakeModule_Receive_call_count);
+
+    ///cleanup
+    Message_Destroy(FakeModule_ReceiveOwned_last_message);
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_owned_module);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_109: [If broker or module_count is NULL, or statistics is NULL and *module_count is not 0, Broker_GetStatistics shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_GetStatistics_fails_with_null_module_count)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_STATISTICS statistics;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_GetStatistics(broker, &statistics, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_110: [Broker_GetStatistics shall lock BROKER_HANDLE_DATA::modules_lock, so that no module is removed while its counters are read.]
+//Tests_SRS_DIRECT_BROKER_13_112: [Broker_GetStatistics shall set *module_count to the number of modules of the broker, unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_OK.]
+TEST_FUNCTION(Broker_GetStatistics_with_no_room_returns_the_module_count)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    size_t module_count = 0;
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_get_next_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_GetStatistics(broker, NULL, &module_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 2, module_count);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_108: [The function shall count the messages it appends, their bytes, the messages it drops and the highest depth of BROKER_MODULEINFO::mq in BROKER_MODULEINFO::queue_counters, and note when a message is appended to an empty queue.]
+//Tests_SRS_DIRECT_BROKER_13_111: [Broker_GetStatistics shall fill the first *module_count elements of statistics with the counters of the modules of BROKER_HANDLE_DATA::modules, in the order they were added.]
+//Tests_SRS_DIRECT_BROKER_13_113: [Broker_GetStatistics shall read BROKER_MODULEINFO::queue_counters, the depth of BROKER_MODULEINFO::mq and its bytes under BROKER_MODULEINFO::mq_lock, and BROKER_MODULEINFO::delivery_counters without acquiring any lock.]
+TEST_FUNCTION(Broker_GetStatistics_counts_the_messages_queued_and_dropped)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_DROP_NEWEST, 0 } };
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModuleWithOptions(broker, &fake_module2, &options);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    auto message = create_fake_message();
+    (void)Broker_Publish(broker, fake_module_handle, message);
+    (void)Broker_Publish(broker, fake_module_handle, message);
+    BROKER_MODULE_STATISTICS statistics[2];
+    size_t module_count = 2;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_GetStatistics(broker, statistics, &module_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 2, module_count);
+    ASSERT_ARE_EQUAL(void_ptr, fake_module_handle, statistics[0].module_handle);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics[0].enqueued);
+    ASSERT_ARE_EQUAL(void_ptr, fake_module_handle2, statistics[1].module_handle);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics[1].enqueued);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics[1].dropped);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics[1].delivered);
+    ASSERT_ARE_EQUAL(uint64_t, sizeof(fake_content_bytes), statistics[1].enqueued_bytes);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics[1].queue_depth);
+    ASSERT_ARE_EQUAL(size_t, sizeof(fake_content_bytes), statistics[1].queued_bytes);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics[1].queue_high_water_mark);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_144: [The function shall count the messages it appends to BROKER_MODULEINFO::delivery_mq of the sink and their bytes as enqueued in BROKER_MODULEINFO::queue_counters, without changing the high-water mark of BROKER_MODULEINFO::mq.]
+TEST_FUNCTION(Broker_GetStatistics_counts_the_messages_delivered_inline_as_enqueued)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_DROP_NEWEST, 0, 0, 1 } };
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModuleWithOptions(broker, &fake_module2, &options);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    auto message = create_fake_message();
+    FAKE_MESSAGE_BATCH batch = { { message, message }, 2 };
+    (void)Broker_PublishBatch(broker, fake_module_handle, (MESSAGE_BATCH_HANDLE)&batch);
+    BROKER_MODULE_STATISTICS statistics[2];
+    size_t module_count = 2;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_GetStatistics(broker, statistics, &module_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 0, currentWorkerPool_Schedule_call);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics[1].enqueued);
+    ASSERT_ARE_EQUAL(uint64_t, 2 * sizeof(fake_content_bytes), statistics[1].enqueued_bytes);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics[1].delivered);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics[1].dropped);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics[1].queue_depth);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics[1].queue_high_water_mark);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_106: [After taking the messages, the function shall record in BROKER_MODULEINFO::delivery_counters how long the oldest of them waited in the queue.]
+//Tests_SRS_DIRECT_BROKER_13_107: [The function shall count every message it hands to the module and record how long each call to the module's receive functions took in BROKER_MODULEINFO::delivery_counters.]
+TEST_FUNCTION(module_publish_worker_counts_the_messages_delivered)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    auto message = create_fake_message();
+    (void)Broker_Publish(broker, fake_module_handle, message);
+    (void)Broker_Publish(broker, fake_module_handle, message);
+    BROKER_MODULE_STATISTICS statistics[2];
+    size_t module_count = 2;
+    uint64_t queue_wait_samples = 0;
+    uint64_t receive_duration_samples = 0;
+    mocks.ResetAllCalls();
+
+    ///act
+    strand_func_to_call(strand_func_args);
+    auto result = Broker_GetStatistics(broker, statistics, &module_count);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics[1].enqueued);
+    ASSERT_ARE_EQUAL(uint64_t, 2, statistics[1].delivered);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics[1].queue_depth);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics[1].queued_bytes);
+    ASSERT_ARE_EQUAL(size_t, 2, statistics[1].queue_high_water_mark);
+    for (size_t i = 0; i < BROKER_LATENCY_BUCKET_COUNT; i++)
+    {
+        queue_wait_samples += statistics[1].queue_wait.buckets[i];
+        receive_duration_samples += statistics[1].receive_duration.buckets[i];
+    }
+    ASSERT_ARE_EQUAL(uint64_t, 1, queue_wait_samples);
+    ASSERT_ARE_EQUAL(uint64_t, 2, receive_duration_samples);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_048: [Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR.]
+//Tests_SRS_DIRECT_BROKER_13_115: [Broker_AddLink shall allocate zeroed BROKER_LINK_COUNTERS for the new route.]
+TEST_FUNCTION(Broker_AddLink_fails_when_the_counters_cannot_be_allocated)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2 };
+    auto message = create_fake_message();
+    mocks.ResetAllCalls();
+
+    whenShallmalloc_fail = currentmalloc_call + 1;
+
+    ///act
+    auto result = Broker_AddLink(broker, &link);
+    auto publish_result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ADD_LINK_ERROR, result);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, publish_result);
+    ASSERT_ARE_EQUAL(size_t, 0, currentWorkerPool_Schedule_call);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_122: [If broker or module is NULL, Broker_ApplyModuleThreadOptions shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_ApplyModuleThreadOptions_fails_with_null_broker)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    ///act
+    auto result = Broker_ApplyModuleThreadOptions(NULL, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_DIRECT_BROKER_13_125: [If the module was not added to the broker, the options cannot be applied or an underlying API call fails, Broker_ApplyModuleThreadOptions shall return BROKER_ERROR.]
+TEST_FUNCTION(Broker_ApplyModuleThreadOptions_fails_for_a_module_not_added)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_ApplyModuleThreadOptions(broker, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, result);
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_121: [The function shall copy the thread options of `options`, when `options` is not NULL, to BROKER_MODULEINFO::thread_options, and set them to 0 otherwise.]
+//Tests_SRS_DIRECT_BROKER_13_123: [Broker_ApplyModuleThreadOptions shall lock BROKER_HANDLE_DATA::modules_lock and copy the BROKER_MODULEINFO::thread_options of module.]
+//Tests_SRS_DIRECT_BROKER_13_124: [Broker_ApplyModuleThreadOptions shall apply the thread options to the calling thread by calling ThreadOptions_Apply after releasing the lock, and return BROKER_OK.]
+TEST_FUNCTION(Broker_ApplyModuleThreadOptions_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, list_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, list_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_ApplyModuleThreadOptions(broker, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_117: [If broker, link, link->module_source_handle, link->module_sink_handle or statistics is NULL, Broker_GetLinkStatistics shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_GetLinkStatistics_fails_with_null_statistics)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2 };
+
+    ///act
+    auto result = Broker_GetLinkStatistics((BROKER_HANDLE)0x1, &link, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_INVALIDARG, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_DIRECT_BROKER_13_120: [If the route does not exist or an underlying API call fails, Broker_GetLinkStatistics shall return BROKER_ERROR.]
+TEST_FUNCTION(Broker_GetLinkStatistics_fails_when_the_link_does_not_exist)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModule(broker, &fake_module2);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2 };
+    BROKER_LINK_STATISTICS statistics;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_GetLinkStatistics(broker, &link, &statistics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_ERROR, result);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_DIRECT_BROKER_13_116: [The function shall count the messages it appends and their bytes in the BROKER_LINK_COUNTERS of the route, and the time it appended the last of them.]
+//Tests_SRS_DIRECT_BROKER_13_118: [Broker_GetLinkStatistics shall lock BROKER_HANDLE_DATA::modules_lock and find the route from link->module_source_handle to link->module_sink_handle.]
+//Tests_SRS_DIRECT_BROKER_13_119: [Broker_GetLinkStatistics shall read the BROKER_LINK_COUNTERS of the route under BROKER_MODULEINFO::mq_lock of the sink, fill statistics by calling BrokerStatistics_FillLink and return BROKER_OK.]
+TEST_FUNCTION(Broker_GetLinkStatistics_counts_the_messages_queued_over_the_link)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_OPTIONS options = { { 1, 0, BROKER_QUEUE_DROP_NEWEST, 0 } };
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddModuleWithOptions(broker, &fake_module2, &options);
+    add_link(broker, fake_module_handle, fake_module_handle2);
+    BROKER_LINK_DATA link = { fake_module_handle, fake_module_handle2 };
+    auto message = create_fake_message();
+    (void)Broker_Publish(broker, fake_module_handle, message);
+    (void)Broker_Publish(broker, fake_module_handle, message);
+    BROKER_LINK_STATISTICS statistics;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result = Broker_GetLinkStatistics(broker, &link, &statistics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(uint64_t, 1, statistics.messages);
+    ASSERT_ARE_EQUAL(uint64_t, sizeof(fake_content_bytes), statistics.bytes);
+    ASSERT_IS_TRUE(statistics.last_activity != 0);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module2);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+END_TEST_SUITE(direct_broker_ut)
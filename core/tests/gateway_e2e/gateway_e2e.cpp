@@ -188,21 +188,32 @@ BEGIN_TEST_SUITE(gateway_e2e)
 		modules[0].module_configuration = &iotHubConfig;
 		modules[0].module_name = "IoTHub";
 		modules[0].module_path = iothub_module_path();
+		modules[0].module_options = NULL;
+		modules[0].instances = 1;
+		modules[0].partition_key = NULL;
 
 		
 		modules[1].module_configuration = e2eModuleMappingVector;
 		modules[1].module_name = GW_IDMAP_MODULE;
 		modules[1].module_path = identity_map_module_path();
+		modules[1].module_options = NULL;
+		modules[1].instances = 1;
+		modules[1].partition_key = NULL;
 
 		modules[2].module_configuration = &e2eModuleConfiguration;
 		modules[2].module_name = "E2ETest";
 		modules[2].module_path = e2e_module_path();
+		modules[2].module_options = NULL;
+		modules[2].instances = 1;
+		modules[2].partition_key = NULL;
 		
 		links[0].module_source = "E2ETest";
 		links[0].module_sink = GW_IDMAP_MODULE;
+		links[0].filter = NULL;
 
 		links[1].module_source = GW_IDMAP_MODULE;
 		links[1].module_sink = "IoTHub";
+		links[1].filter = NULL;
 		
 		GATEWAY_PROPERTIES m6GatewayProperties;
 		VECTOR_HANDLE gatewayProps = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
@@ -216,6 +227,7 @@ BEGIN_TEST_SUITE(gateway_e2e)
 		///act
 		m6GatewayProperties.gateway_modules = gatewayProps;
 		m6GatewayProperties.gateway_links = gatewayLinks; 
+		m6GatewayProperties.broker_options = NULL;
 		e2eGatewayInstance = Gateway_LL_Create(&m6GatewayProperties);
 		auto start_result = Gateway_LL_Start(e2eGatewayInstance);
 
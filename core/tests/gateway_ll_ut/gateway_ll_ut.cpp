@@ -14,6 +14,7 @@
 #include "gateway_ll.h"
 #include "broker.h"
 #include "internal/event_system.h"
+#include "internal/link_filter.h"
 #include "module_loader.h"
 
 #define DUMMY_LIBRARY_PATH "x.dll"
@@ -72,8 +73,21 @@ static size_t whenShallVECTOR_push_back_fail;
 static size_t currentVECTOR_find_if_call;
 static size_t whenShallVECTOR_find_if_fail;
 
+static size_t currentLinkFilter_Create_call;
+static size_t whenShallLinkFilter_Create_fail;
+static const BROKER_LINK_FILTER* lastBroker_AddLink_filter;
+static BROKER_FILTER_CONDITION lastBroker_AddLink_condition;
+static size_t currentBroker_GetLinkStatistics_call;
+static size_t whenShallBroker_GetLinkStatistics_fail;
+
 static MODULE_APIS dummyAPIs;
 
+static const BROKER_FILTER_CONDITION dummyConditions[] =
+{
+	{ BROKER_FILTER_EQUALS, "macAddress", "00:11:22:33:44:55" }
+};
+static const BROKER_LINK_FILTER dummyFilter = { dummyConditions, 1 };
+
 TYPED_MOCK_CLASS(CGatewayLLMocks, CGlobalMock)
 {
 public:
@@ -130,6 +144,11 @@ public:
 	}
 	MOCK_METHOD_END(BROKER_HANDLE, result1);
 
+	MOCK_STATIC_METHOD_1(, BROKER_HANDLE, Broker_CreateWithOptions, const BROKER_OPTIONS*, options)
+		++currentBroker_ref_count;
+		BROKER_HANDLE result1 = (BROKER_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1);
+	MOCK_METHOD_END(BROKER_HANDLE, result1);
+
 	MOCK_STATIC_METHOD_1(, void, Broker_Destroy, BROKER_HANDLE, broker)
 		if (currentBroker_ref_count > 0)
 		{
@@ -154,6 +173,19 @@ public:
 		}
 	MOCK_METHOD_END(BROKER_RESULT, result1);
 
+	MOCK_STATIC_METHOD_3(, BROKER_RESULT, Broker_AddModuleWithOptions, BROKER_HANDLE, handle, const MODULE*, module, const BROKER_MODULE_OPTIONS*, options)
+		currentBroker_AddModule_call++;
+		BROKER_RESULT result1 = BROKER_ERROR;
+		if (handle != NULL && module != NULL)
+		{
+			if (whenShallBroker_AddModule_fail != currentBroker_AddModule_call)
+			{
+				++currentBroker_module_count;
+				result1 = BROKER_OK;
+			}
+		}
+	MOCK_METHOD_END(BROKER_RESULT, result1);
+
 	MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_RemoveModule, BROKER_HANDLE, handle, const MODULE*, module)
 		currentBroker_RemoveModule_call++;
 		BROKER_RESULT result1 = BROKER_ERROR;
@@ -165,11 +197,32 @@ public:
 	MOCK_METHOD_END(BROKER_RESULT, result1);
 
 	MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_AddLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link)
+		lastBroker_AddLink_filter = link->filter;
+		if (link->filter != NULL && link->filter->condition_count > 0)
+		{
+			lastBroker_AddLink_condition = link->filter->conditions[link->filter->condition_count - 1];
+		}
 	MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
 
 	MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_RemoveLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link)
 	MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
 
+	MOCK_STATIC_METHOD_3(, BROKER_RESULT, Broker_GetLinkStatistics, BROKER_HANDLE, broker, const BROKER_LINK_DATA*, link, BROKER_LINK_STATISTICS*, statistics)
+		BROKER_RESULT result2;
+		currentBroker_GetLinkStatistics_call++;
+		if (whenShallBroker_GetLinkStatistics_fail == currentBroker_GetLinkStatistics_call)
+		{
+			result2 = BROKER_ERROR;
+		}
+		else
+		{
+			statistics->messages = 1;
+			statistics->bytes = 10;
+			statistics->last_activity = (time_t)(currentBroker_GetLinkStatistics_call * 100);
+			result2 = BROKER_OK;
+		}
+	MOCK_METHOD_END(BROKER_RESULT, result2)
+
 	MOCK_STATIC_METHOD_1(, MODULE_LIBRARY_HANDLE, ModuleLoader_Load, const char*, moduleLibraryFileName)
 		currentModuleLoader_Load_call++;
 		MODULE_LIBRARY_HANDLE handle = NULL;
@@ -187,6 +240,22 @@ public:
 		BASEIMPLEMENTATION::gballoc_free(moduleLibraryHandle);
 	MOCK_VOID_METHOD_END();
 
+	MOCK_STATIC_METHOD_1(, LINK_FILTER_HANDLE, LinkFilter_Create, const BROKER_LINK_FILTER*, definition)
+		currentLinkFilter_Create_call++;
+		LINK_FILTER_HANDLE filter = NULL;
+		if (whenShallLinkFilter_Create_fail != currentLinkFilter_Create_call)
+		{
+			filter = (LINK_FILTER_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1);
+		}
+	MOCK_METHOD_END(LINK_FILTER_HANDLE, filter);
+
+	MOCK_STATIC_METHOD_1(, void, LinkFilter_Destroy, LINK_FILTER_HANDLE, filter)
+		BASEIMPLEMENTATION::gballoc_free(filter);
+	MOCK_VOID_METHOD_END();
+
+	MOCK_STATIC_METHOD_1(, const BROKER_LINK_FILTER*, LinkFilter_GetDefinition, LINK_FILTER_HANDLE, filter)
+	MOCK_METHOD_END(const BROKER_LINK_FILTER*, &dummyFilter);
+
 	MOCK_STATIC_METHOD_0(, EVENTSYSTEM_HANDLE, EventSystem_Init)
 	MOCK_METHOD_END(EVENTSYSTEM_HANDLE, (EVENTSYSTEM_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1));
 
@@ -295,11 +364,14 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , void, mock_Module_Receive, MODUL
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, mock_Module_Start, MODULE_HANDLE, moduleHandle);
 
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayLLMocks, , BROKER_HANDLE, Broker_Create);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , BROKER_HANDLE, Broker_CreateWithOptions, const BROKER_OPTIONS*, options);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, Broker_Destroy, BROKER_HANDLE, broker);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_AddModule, BROKER_HANDLE, handle, const MODULE*, module);
+DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , BROKER_RESULT, Broker_AddModuleWithOptions, BROKER_HANDLE, handle, const MODULE*, module, const BROKER_MODULE_OPTIONS*, options);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_RemoveModule, BROKER_HANDLE, handle, const MODULE*, module);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_AddLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_RemoveLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link);
+DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , BROKER_RESULT, Broker_GetLinkStatistics, BROKER_HANDLE, broker, const BROKER_LINK_DATA*, link, BROKER_LINK_STATISTICS*, statistics);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, Broker_IncRef, BROKER_HANDLE, broker);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, Broker_DecRef, BROKER_HANDLE, broker);
 
@@ -307,6 +379,10 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , MODULE_LIBRARY_HANDLE, ModuleLoa
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , const MODULE_APIS*, ModuleLoader_GetModuleAPIs, MODULE_LIBRARY_HANDLE, module_library_handle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, ModuleLoader_Unload, MODULE_LIBRARY_HANDLE, moduleLibraryHandle);
 
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , LINK_FILTER_HANDLE, LinkFilter_Create, const BROKER_LINK_FILTER*, definition);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, LinkFilter_Destroy, LINK_FILTER_HANDLE, filter);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , const BROKER_LINK_FILTER*, LinkFilter_GetDefinition, LINK_FILTER_HANDLE, filter);
+
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayLLMocks, , EVENTSYSTEM_HANDLE, EventSystem_Init);
 DECLARE_GLOBAL_MOCK_METHOD_4(CGatewayLLMocks, , void, EventSystem_AddEventCallback, EVENTSYSTEM_HANDLE, event_system, GATEWAY_EVENT, event_type, GATEWAY_CALLBACK, callback, void*, user_param);
 DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , void, EventSystem_ReportEvent, EVENTSYSTEM_HANDLE, event_system, GATEWAY_HANDLE, gw, GATEWAY_EVENT, event_type);
@@ -407,6 +483,13 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 	currentVECTOR_find_if_call = 0;
 	whenShallVECTOR_find_if_fail = 0;
 
+	currentLinkFilter_Create_call = 0;
+	whenShallLinkFilter_Create_fail = 0;
+	lastBroker_AddLink_filter = NULL;
+	memset(&lastBroker_AddLink_condition, 0, sizeof(lastBroker_AddLink_condition));
+	currentBroker_GetLinkStatistics_call = 0;
+	whenShallBroker_GetLinkStatistics_fail = 0;
+
 	dummyAPIs = {
 		mock_Module_Create,
 		mock_Module_Destroy,
@@ -423,6 +506,7 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 	dummyProps = (GATEWAY_PROPERTIES*)malloc(sizeof(GATEWAY_PROPERTIES));
 	dummyProps->gateway_modules = BASEIMPLEMENTATION::VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
 	dummyProps->gateway_links = BASEIMPLEMENTATION::VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+	dummyProps->broker_options = NULL;
 	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry, 1);
 }
 
@@ -473,6 +557,38 @@ TEST_FUNCTION(Gateway_LL_Create_Creates_Handle_Success)
 	Gateway_LL_Destroy(gateway);
 }
 
+/*Tests_SRS_GATEWAY_LL_13_002: [If properties is not NULL and its broker_options is not NULL, this function shall create the broker with Broker_CreateWithOptions.]*/
+TEST_FUNCTION(Gateway_LL_Create_Creates_Broker_With_Options)
+{
+	//Arrange
+	CGatewayLLMocks mocks;
+	BROKER_OPTIONS broker_options = { 2 };
+	GATEWAY_PROPERTIES props;
+	props.gateway_modules = NULL;
+	props.gateway_links = NULL;
+	props.broker_options = &broker_options;
+
+	//Expectations
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Broker_CreateWithOptions(&broker_options));
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	expectEventSystemInit(mocks);
+
+	//Act
+	GATEWAY_HANDLE gateway = Gateway_LL_Create(&props);
+
+	//Assert
+	ASSERT_IS_NOT_NULL(gateway);
+	mocks.AssertActualAndExpectedCalls();
+
+	//Cleanup
+	Gateway_LL_Destroy(gateway);
+}
+
 /*Tests_SRS_GATEWAY_LL_14_002: [This function shall return NULL upon any memory allocation failure.]*/
 TEST_FUNCTION(Gateway_LL_Create_Creates_Handle_Malloc_Failure)
 {
@@ -1624,6 +1740,60 @@ TEST_FUNCTION(Gateway_LL_AddModule_Loads_Module_From_Library_Path)
 	Gateway_LL_Destroy(gw);
 }
 
+/*Tests_SRS_GATEWAY_LL_13_001: [If the GATEWAY_MODULES_ENTRY's module_options is not NULL, the function shall attach the module using a call to Broker_AddModuleWithOptions instead. ]*/
+TEST_FUNCTION(Gateway_LL_AddModule_Uses_Module_Options)
+{
+	//Arrange
+	CGatewayLLMocks mocks;
+
+	GATEWAY_HANDLE gw = Gateway_LL_Create(NULL);
+	BROKER_MODULE_OPTIONS options;
+	options.queue.max_depth = 10;
+	options.queue.max_bytes = 0;
+	options.queue.policy = BROKER_QUEUE_DROP_OLDEST;
+	options.queue.block_timeout_ms = 0;
+	GATEWAY_MODULES_ENTRY entry = *(GATEWAY_MODULES_ENTRY*)BASEIMPLEMENTATION::VECTOR_front(dummyProps->gateway_modules);
+	entry.module_options = &options;
+	mocks.ResetAllCalls();
+
+	//Expectations
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(mocks, ModuleLoader_Load(DUMMY_LIBRARY_PATH));
+	STRICT_EXPECTED_CALL(mocks, ModuleLoader_GetModuleAPIs(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, Broker_AddModuleWithOptions(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &options))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gw, GATEWAY_MODULE_LIST_CHANGED))
+		.IgnoreArgument(1);
+
+	//Act
+	MODULE_HANDLE handle = Gateway_LL_AddModule(gw, &entry);
+
+	//Assert
+	ASSERT_IS_NOT_NULL(handle);
+	mocks.AssertActualAndExpectedCalls();
+
+	//Cleanup
+	Gateway_LL_Destroy(gw);
+}
+
 /*Tests_SRS_GATEWAY_LL_14_031: [ If unsuccessful, the function shall return NULL. ]*/
 TEST_FUNCTION(Gateway_LL_AddModule_Malloc_data_Fails)
 {
@@ -3611,182 +3781,101 @@ TEST_FUNCTION(Gateway_LL_AddLink_star_failure_to_add)
 	Gateway_LL_Destroy(gateway);
 }
 
-//Tests_SRS_GATEWAY_LL_17_003: [ The gateway shall treat a source of "*" as link to the sink module from every other module in gateway. ]
-TEST_FUNCTION(Gateway_LL_RemoveModule_with_star_links)
+/*Tests_SRS_GATEWAY_LL_13_003: [ If entryLink->filter is not NULL, the function shall copy it by calling LinkFilter_Create. ]*/
+/*Tests_SRS_GATEWAY_LL_13_005: [ The gateway shall pass the copy of the filter of the link to the broker as the filter of every BROKER_LINK_DATA it adds for the link. ]*/
+TEST_FUNCTION(Gateway_LL_AddLink_with_filter_passes_copy_to_broker)
 {
 	//Arrange
 	CGatewayLLMocks mocks;
 
-	//Add another entry to the properties
 	GATEWAY_MODULES_ENTRY dummyEntry2 = {
 		"dummy module 2",
 		"x2.dll",
 		NULL
 	};
-	GATEWAY_MODULES_ENTRY dummyEntry3 = {
-		"dummy module 3",
-		"x2.dll",
-		NULL
-	};
 
-	GATEWAY_LINK_ENTRY dummyLink1 = {
-		"*",
-		"dummy module 2"
-	};
-	GATEWAY_LINK_ENTRY dummyLink2 = {
-		"*",
-		"dummy module"
+	GATEWAY_LINK_ENTRY dummyLink = {
+		"dummy module",
+		"dummy module 2",
+		&dummyFilter
 	};
 
 	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
-	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink1, 1);
-	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink2, 1);
 
 	GATEWAY_HANDLE gateway = Gateway_LL_Create(dummyProps);
-	auto module_handle = Gateway_LL_AddModule(gateway, &dummyEntry3);
-
 	mocks.ResetAllCalls();
 
-	//Expectations
-	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, module_handle))
-		.IgnoreAllArguments();
-	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	// 1st broadcast link
-	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
-	STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
-	// 2nd broadcast link
-	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-		.IgnoreArgument(1);
+		.IgnoreAllArguments();//Check link
+	STRICT_EXPECTED_CALL(mocks, LinkFilter_Create(&dummyFilter));
 	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
-	STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
-	// and the rest of the remove...
+		.IgnoreAllArguments();//Check Source Module.
 	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
-	EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
-	STRICT_EXPECTED_CALL(mocks, Broker_RemoveModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
-	STRICT_EXPECTED_CALL(mocks, Broker_DecRef(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, ModuleLoader_GetModuleAPIs(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, mock_Module_Destroy(module_handle))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, ModuleLoader_Unload(IGNORED_PTR_ARG))
+		.IgnoreAllArguments();//Check Sink Module.
+	STRICT_EXPECTED_CALL(mocks, LinkFilter_GetDefinition(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+	STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gateway, GATEWAY_MODULE_LIST_CHANGED))
-		.IgnoreArgument(1);
 
 	//Act
-	Gateway_LL_RemoveModule(gateway, module_handle);
+	GATEWAY_ADD_LINK_RESULT result = Gateway_LL_AddLink(gateway, &dummyLink);
 
 	//Assert
+	ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_SUCCESS, result);
+	ASSERT_ARE_EQUAL(void_ptr, (void*)&dummyFilter, (void*)lastBroker_AddLink_filter);
 	mocks.AssertActualAndExpectedCalls();
 
 	//Cleanup
 	Gateway_LL_Destroy(gateway);
 }
 
-//Tests_SRS_GATEWAY_LL_17_003: [ The gateway shall treat a source of "*" as link to the sink module from every other module in gateway. ]
-TEST_FUNCTION(Gateway_LL_RemoveModule_with_star_links_has_errors)
+/*Tests_SRS_GATEWAY_LL_13_004: [ If LinkFilter_Create fails, the function shall return GATEWAY_ADD_LINK_ERROR. ]*/
+TEST_FUNCTION(Gateway_LL_AddLink_with_filter_fails_when_copy_fails)
 {
 	//Arrange
 	CGatewayLLMocks mocks;
 
-	//Add another entry to the properties
 	GATEWAY_MODULES_ENTRY dummyEntry2 = {
 		"dummy module 2",
 		"x2.dll",
 		NULL
 	};
-	GATEWAY_MODULES_ENTRY dummyEntry3 = {
-		"dummy module 3",
-		"x2.dll",
-		NULL
-	};
 
-	GATEWAY_LINK_ENTRY dummyLink1 = {
-		"*",
-		"dummy module 2"
-	};
-	GATEWAY_LINK_ENTRY dummyLink2 = {
-		"*",
-		"dummy module"
+	GATEWAY_LINK_ENTRY dummyLink = {
+		"dummy module",
+		"dummy module 2",
+		&dummyFilter
 	};
 
 	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
-	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink1, 1);
-	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink2, 1);
 
 	GATEWAY_HANDLE gateway = Gateway_LL_Create(dummyProps);
-	auto module_handle = Gateway_LL_AddModule(gateway, &dummyEntry3);
-
 	mocks.ResetAllCalls();
 
-	//Expectations
-	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, module_handle))
-		.IgnoreAllArguments();
-	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	// 1st broadcast link
-	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments()
-		.SetFailReturn(nullptr);
-	// 2nd broadcast link
-	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-		.IgnoreArgument(1);
+	whenShallLinkFilter_Create_fail = 1;
 	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
-	EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
-	STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments()
-		.SetFailReturn(BROKER_REMOVE_LINK_ERROR);
-	// and the rest of the remove...
-	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
-	STRICT_EXPECTED_CALL(mocks, Broker_RemoveModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
-	STRICT_EXPECTED_CALL(mocks, Broker_DecRef(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, ModuleLoader_GetModuleAPIs(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, mock_Module_Destroy(module_handle))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, ModuleLoader_Unload(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-		.IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gateway, GATEWAY_MODULE_LIST_CHANGED))
-		.IgnoreArgument(1);
+		.IgnoreAllArguments();//Check link
+	STRICT_EXPECTED_CALL(mocks, LinkFilter_Create(&dummyFilter));
 
 	//Act
-	Gateway_LL_RemoveModule(gateway, module_handle);
+	GATEWAY_ADD_LINK_RESULT result = Gateway_LL_AddLink(gateway, &dummyLink);
 
 	//Assert
+	ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_ERROR, result);
 	mocks.AssertActualAndExpectedCalls();
 
 	//Cleanup
 	Gateway_LL_Destroy(gateway);
 }
 
-//Tests_SRS_GATEWAY_LL_17_003: [ The gateway shall treat a source of "*" as link to the sink module from every other module in gateway. ]
-TEST_FUNCTION(Gateway_LL_RemoveLink_star_link_success)
+/*Tests_SRS_GATEWAY_LL_13_005: [ The gateway shall pass the copy of the filter of the link to the broker as the filter of every BROKER_LINK_DATA it adds for the link. ]*/
+TEST_FUNCTION(Gateway_LL_AddModule_passes_star_link_filter_to_broker)
 {
 	//Arrange
 	CGatewayLLMocks mocks;
@@ -3796,23 +3885,476 @@ TEST_FUNCTION(Gateway_LL_RemoveLink_star_link_success)
 		"x2.dll",
 		NULL
 	};
-	GATEWAY_MODULES_ENTRY dummyEntry3 = {
-		"dummy module 3",
-		"x2.dll",
-		NULL
-	};
 
-	GATEWAY_LINK_ENTRY dummyLink1 = {
-		"*",
-		"dummy module 2"
-	};
-	GATEWAY_LINK_ENTRY dummyLink2 = {
+	GATEWAY_LINK_ENTRY dummyLink = {
 		"*",
-		"dummy module"
-	};
-	GATEWAY_LINK_ENTRY dummyLink3 = {
-		"dummy module 2",
-		"dummy module"
+		"dummy module",
+		&dummyFilter
+	};
+
+	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink, 1);
+
+	GATEWAY_HANDLE gateway = Gateway_LL_Create(dummyProps);
+	mocks.ResetAllCalls();
+	lastBroker_AddLink_filter = NULL;
+
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(mocks, ModuleLoader_Load(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, ModuleLoader_GetModuleAPIs(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, LinkFilter_GetDefinition(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gateway, GATEWAY_MODULE_LIST_CHANGED))
+		.IgnoreArgument(1);
+
+	//Act
+	MODULE_HANDLE handle = Gateway_LL_AddModule(gateway, &dummyEntry2);
+
+	//Assert
+	ASSERT_IS_NOT_NULL(handle);
+	ASSERT_ARE_EQUAL(void_ptr, (void*)&dummyFilter, (void*)lastBroker_AddLink_filter);
+	mocks.AssertActualAndExpectedCalls();
+
+	//Cleanup
+	Gateway_LL_Destroy(gateway);
+}
+
+/*Tests_SRS_GATEWAY_LL_13_013: [ If the GATEWAY_MODULES_ENTRY's instances is more than 1 and its partition_key is NULL, the function shall return NULL. ]*/
+TEST_FUNCTION(Gateway_LL_AddModule_with_instances_and_no_partition_key_fails)
+{
+	//Arrange
+	CGatewayLLMocks mocks;
+
+	GATEWAY_HANDLE gw = Gateway_LL_Create(NULL);
+	mocks.ResetAllCalls();
+	GATEWAY_MODULES_ENTRY entry = {
+		"Test module",
+		DUMMY_LIBRARY_PATH,
+		NULL,
+		NULL,
+		2,
+		NULL
+	};
+
+	//Act
+	MODULE_HANDLE handle = Gateway_LL_AddModule(gw, &entry);
+
+	//Assert
+	ASSERT_IS_NULL(handle);
+	mocks.AssertActualAndExpectedCalls();
+
+	//Cleanup
+	Gateway_LL_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_LL_13_014: [ If the GATEWAY_MODULES_ENTRY's instances is more than 1, the function shall create and attach that many instances of the module, with the same module_configuration and module_options, and return the MODULE_HANDLE of the first one. ]*/
+TEST_FUNCTION(Gateway_LL_AddModule_with_instances_creates_every_instance)
+{
+	//Arrange
+	CGatewayLLMocks mocks;
+
+	GATEWAY_HANDLE gw = Gateway_LL_Create(NULL);
+	mocks.ResetAllCalls();
+	GATEWAY_MODULES_ENTRY entry = {
+		"Test module",
+		DUMMY_LIBRARY_PATH,
+		NULL,
+		NULL,
+		3,
+		"deviceId"
+	};
+
+	//Expectations
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, ModuleLoader_Load(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, ModuleLoader_GetModuleAPIs(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, NULL))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(3 * sizeof(MODULE_HANDLE)));
+	STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, "deviceId"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, NULL))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, NULL))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gw, GATEWAY_MODULE_LIST_CHANGED))
+		.IgnoreArgument(1);
+
+	//Act
+	MODULE_HANDLE handle = Gateway_LL_AddModule(gw, &entry);
+
+	//Assert
+	ASSERT_IS_NOT_NULL(handle);
+	ASSERT_ARE_EQUAL(size_t, 3, currentModule_Create_call);
+	mocks.AssertActualAndExpectedCalls();
+
+	//Cleanup
+	Gateway_LL_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_LL_13_015: [ For a sink with several instances, the gateway shall add the conditions of the filter of the link and a BROKER_FILTER_PARTITION condition on the partition key of the sink to the link to every instance, the instance being the partition. ]*/
+TEST_FUNCTION(Gateway_LL_AddLink_to_instances_adds_a_partitioned_link_to_each)
+{
+	//Arrange
+	CGatewayLLMocks mocks;
+
+	GATEWAY_MODULES_ENTRY dummyEntry2 = {
+		"dummy module 2",
+		"x2.dll",
+		NULL,
+		NULL,
+		2,
+		"deviceId"
+	};
+
+	GATEWAY_LINK_ENTRY dummyLink = {
+		"dummy module",
+		"dummy module 2"
+	};
+
+	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
+
+	GATEWAY_HANDLE gateway = Gateway_LL_Create(dummyProps);
+	mocks.ResetAllCalls();
+
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();//Check link
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();//Check Source Module.
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();//Check Sink Module.
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(BROKER_FILTER_CONDITION)));
+	STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+
+	//Act
+	GATEWAY_ADD_LINK_RESULT result = Gateway_LL_AddLink(gateway, &dummyLink);
+
+	//Assert
+	ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_SUCCESS, result);
+	ASSERT_ARE_EQUAL(int, (int)BROKER_FILTER_PARTITION, (int)lastBroker_AddLink_condition.operation);
+	ASSERT_ARE_EQUAL(char_ptr, "deviceId", lastBroker_AddLink_condition.name);
+	ASSERT_ARE_EQUAL(size_t, 1, lastBroker_AddLink_condition.partition);
+	ASSERT_ARE_EQUAL(size_t, 2, lastBroker_AddLink_condition.partition_count);
+	mocks.AssertActualAndExpectedCalls();
+
+	//Cleanup
+	Gateway_LL_Destroy(gateway);
+}
+
+/*Tests_SRS_GATEWAY_LL_13_006: [ The function shall destroy the copy of the filter of the link by calling LinkFilter_Destroy. ]*/
+TEST_FUNCTION(Gateway_LL_RemoveLink_destroys_link_filter)
+{
+	//Arrange
+	CGatewayLLMocks mocks;
+
+	GATEWAY_MODULES_ENTRY dummyEntry2 = {
+		"dummy module 2",
+		"x2.dll",
+		NULL
+	};
+
+	GATEWAY_LINK_ENTRY dummyLink = {
+		"dummy module 2",
+		"dummy module",
+		&dummyFilter
+	};
+
+	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
+	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink, 1);
+
+	GATEWAY_HANDLE gateway = Gateway_LL_Create(dummyProps);
+	mocks.ResetAllCalls();
+
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &dummyLink))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, LinkFilter_Destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+
+	//Act
+	Gateway_LL_RemoveLink(gateway, &dummyLink);
+
+	//Assert
+	mocks.AssertActualAndExpectedCalls();
+
+	//Cleanup
+	Gateway_LL_Destroy(gateway);
+}
+
+//Tests_SRS_GATEWAY_LL_17_003: [ The gateway shall treat a source of "*" as link to the sink module from every other module in gateway. ]
+TEST_FUNCTION(Gateway_LL_RemoveModule_with_star_links)
+{
+	//Arrange
+	CGatewayLLMocks mocks;
+
+	//Add another entry to the properties
+	GATEWAY_MODULES_ENTRY dummyEntry2 = {
+		"dummy module 2",
+		"x2.dll",
+		NULL
+	};
+	GATEWAY_MODULES_ENTRY dummyEntry3 = {
+		"dummy module 3",
+		"x2.dll",
+		NULL
+	};
+
+	GATEWAY_LINK_ENTRY dummyLink1 = {
+		"*",
+		"dummy module 2"
+	};
+	GATEWAY_LINK_ENTRY dummyLink2 = {
+		"*",
+		"dummy module"
+	};
+
+	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
+	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink1, 1);
+	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink2, 1);
+
+	GATEWAY_HANDLE gateway = Gateway_LL_Create(dummyProps);
+	auto module_handle = Gateway_LL_AddModule(gateway, &dummyEntry3);
+
+	mocks.ResetAllCalls();
+
+	//Expectations
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, module_handle))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	// 1st broadcast link
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	// 2nd broadcast link
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	// and the rest of the remove...
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(mocks, Broker_RemoveModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, Broker_DecRef(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, ModuleLoader_GetModuleAPIs(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, mock_Module_Destroy(module_handle))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, ModuleLoader_Unload(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gateway, GATEWAY_MODULE_LIST_CHANGED))
+		.IgnoreArgument(1);
+
+	//Act
+	Gateway_LL_RemoveModule(gateway, module_handle);
+
+	//Assert
+	mocks.AssertActualAndExpectedCalls();
+
+	//Cleanup
+	Gateway_LL_Destroy(gateway);
+}
+
+//Tests_SRS_GATEWAY_LL_17_003: [ The gateway shall treat a source of "*" as link to the sink module from every other module in gateway. ]
+TEST_FUNCTION(Gateway_LL_RemoveModule_with_star_links_has_errors)
+{
+	//Arrange
+	CGatewayLLMocks mocks;
+
+	//Add another entry to the properties
+	GATEWAY_MODULES_ENTRY dummyEntry2 = {
+		"dummy module 2",
+		"x2.dll",
+		NULL
+	};
+	GATEWAY_MODULES_ENTRY dummyEntry3 = {
+		"dummy module 3",
+		"x2.dll",
+		NULL
+	};
+
+	GATEWAY_LINK_ENTRY dummyLink1 = {
+		"*",
+		"dummy module 2"
+	};
+	GATEWAY_LINK_ENTRY dummyLink2 = {
+		"*",
+		"dummy module"
+	};
+
+	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
+	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink1, 1);
+	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink2, 1);
+
+	GATEWAY_HANDLE gateway = Gateway_LL_Create(dummyProps);
+	auto module_handle = Gateway_LL_AddModule(gateway, &dummyEntry3);
+
+	mocks.ResetAllCalls();
+
+	//Expectations
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, module_handle))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	// 1st broadcast link
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments()
+		.SetFailReturn(nullptr);
+	// 2nd broadcast link
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments()
+		.SetFailReturn(BROKER_REMOVE_LINK_ERROR);
+	// and the rest of the remove...
+	STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, Broker_RemoveModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreAllArguments();
+	STRICT_EXPECTED_CALL(mocks, Broker_DecRef(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, ModuleLoader_GetModuleAPIs(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, mock_Module_Destroy(module_handle))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, ModuleLoader_Unload(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gateway, GATEWAY_MODULE_LIST_CHANGED))
+		.IgnoreArgument(1);
+
+	//Act
+	Gateway_LL_RemoveModule(gateway, module_handle);
+
+	//Assert
+	mocks.AssertActualAndExpectedCalls();
+
+	//Cleanup
+	Gateway_LL_Destroy(gateway);
+}
+
+//Tests_SRS_GATEWAY_LL_17_003: [ The gateway shall treat a source of "*" as link to the sink module from every other module in gateway. ]
+TEST_FUNCTION(Gateway_LL_RemoveLink_star_link_success)
+{
+	//Arrange
+	CGatewayLLMocks mocks;
+
+	GATEWAY_MODULES_ENTRY dummyEntry2 = {
+		"dummy module 2",
+		"x2.dll",
+		NULL
+	};
+	GATEWAY_MODULES_ENTRY dummyEntry3 = {
+		"dummy module 3",
+		"x2.dll",
+		NULL
+	};
+
+	GATEWAY_LINK_ENTRY dummyLink1 = {
+		"*",
+		"dummy module 2"
+	};
+	GATEWAY_LINK_ENTRY dummyLink2 = {
+		"*",
+		"dummy module"
+	};
+	GATEWAY_LINK_ENTRY dummyLink3 = {
+		"dummy module 2",
+		"dummy module"
 	};
 
 	BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
@@ -4018,6 +4560,7 @@ TEST_FUNCTION(Gateway_LL_GetModuleList_Links_basic_tree)
 	GATEWAY_PROPERTIES props;
 	props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
 	props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+	props.broker_options = NULL;
 	VECTOR_push_back(props.gateway_modules, module_entries, module_count);
 	VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4088,6 +4631,7 @@ TEST_FUNCTION(Gateway_LL_GetModuleList_links_cycle)
 	GATEWAY_PROPERTIES props;
 	props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
 	props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+	props.broker_options = NULL;
 	VECTOR_push_back(props.gateway_modules, module_entries, module_count);
 	VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4147,6 +4691,7 @@ TEST_FUNCTION(Gateway_LL_GetModuleList_links_to_itself)
 	GATEWAY_PROPERTIES props;
 	props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
 	props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+	props.broker_options = NULL;
 	VECTOR_push_back(props.gateway_modules, module_entries, module_count);
 	VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4226,6 +4771,7 @@ TEST_FUNCTION(Gateway_LL_GetModuleList_links_star)
 	GATEWAY_PROPERTIES props;
 	props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
 	props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+	props.broker_options = NULL;
 	VECTOR_push_back(props.gateway_modules, module_entries, module_count);
 	VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4274,6 +4820,7 @@ TEST_FUNCTION(Gateway_LL_GetModuleList_calloc_fail)
 	GATEWAY_PROPERTIES props;
 	props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
 	props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+	props.broker_options = NULL;
 	VECTOR_push_back(props.gateway_modules, module_entries, module_count);
 	VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4323,6 +4870,7 @@ TEST_FUNCTION(Gateway_LL_modules_sources_vector_create_fail)
 	GATEWAY_PROPERTIES props;
 	props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
 	props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+	props.broker_options = NULL;
 	VECTOR_push_back(props.gateway_modules, module_entries, module_count);
 	VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4379,6 +4927,7 @@ TEST_FUNCTION(Gateway_LL_GetModuleList_link_push_back_fail)
 	GATEWAY_PROPERTIES props;
 	props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
 	props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+	props.broker_options = NULL;
 	VECTOR_push_back(props.gateway_modules, module_entries, module_count);
 	VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4449,6 +4998,7 @@ TEST_FUNCTION(Gateway_LL_DestroyModuleList_basic)
 	GATEWAY_PROPERTIES props;
 	props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
 	props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+	props.broker_options = NULL;
 	VECTOR_push_back(props.gateway_modules, module_entries, module_count);
 	VECTOR_push_back(props.gateway_links, link_entries, link_count);
 
@@ -4491,6 +5041,155 @@ TEST_FUNCTION(Gateway_LL_DestroyModuleList_null)
 	mocks.AssertActualAndExpectedCalls();
 }
 
+/*Tests_SRS_GATEWAY_LL_13_007: [ If gw is NULL, the function shall return NULL. ]*/
+TEST_FUNCTION(Gateway_LL_GetLinkStatistics_NULL_Gateway)
+{
+	// Arrange
+	CGatewayLLMocks mocks;
+
+	// Expectations
+	// Empty
+
+	// Act
+	VECTOR_HANDLE vector = Gateway_LL_GetLinkStatistics(NULL);
+
+	// Assert
+	ASSERT_IS_NULL(vector);
+	mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_GATEWAY_LL_13_008: [ The function shall return a vector with a GATEWAY_LINK_STATISTICS for every link of the gateway, in the order the links were added. ]*/
+/*Tests_SRS_GATEWAY_LL_13_009: [ The function shall read the messages, bytes and last activity of every link by calling Broker_GetLinkStatistics. ]*/
+/*Tests_SRS_GATEWAY_LL_13_010: [ For a link with "*" as its source, the function shall add up the messages and bytes of the links from every other module to the sink and take the latest of their last activities. ]*/
+TEST_FUNCTION(Gateway_LL_GetLinkStatistics_links_star)
+{
+	//Arrange
+	CGatewayLLMocks mocks;
+	// Using only for implemenation instead of checking calls
+	mocks.SetIgnoreUnexpectedCalls(true);
+
+	GATEWAY_MODULES_ENTRY module_entries[] = {
+		{
+			"module_1",
+			"x.dll",
+			NULL
+		},
+		{
+			"module_2",
+			"x.dll",
+			NULL
+		},
+		{
+			"module_3",
+			"x.dll",
+			NULL
+		}
+	};
+
+	GATEWAY_LINK_ENTRY link_entries[] = {
+		{ "*", "module_1" },
+		{ "module_1", "module_2" }
+	};
+
+	GATEWAY_PROPERTIES props;
+	props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
+	props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+	props.broker_options = NULL;
+	VECTOR_push_back(props.gateway_modules, module_entries, 3);
+	VECTOR_push_back(props.gateway_links, link_entries, 2);
+
+	auto gateway = Gateway_LL_Create(&props);
+
+	//Act
+	auto links = Gateway_LL_GetLinkStatistics(gateway);
+
+	// Assert
+	ASSERT_IS_NOT_NULL(links);
+	ASSERT_ARE_EQUAL(size_t, 2, VECTOR_size(links));
+	auto star = (GATEWAY_LINK_STATISTICS*)VECTOR_element(links, 0);
+	ASSERT_ARE_EQUAL(char_ptr, "*", star->module_source);
+	ASSERT_ARE_EQUAL(char_ptr, "module_1", star->module_sink);
+	ASSERT_ARE_EQUAL(uint64_t, 2, star->messages);
+	ASSERT_ARE_EQUAL(uint64_t, 20, star->bytes);
+	ASSERT_IS_TRUE(star->last_activity == (time_t)200);
+	auto regular = (GATEWAY_LINK_STATISTICS*)VECTOR_element(links, 1);
+	ASSERT_ARE_EQUAL(char_ptr, "module_1", regular->module_source);
+	ASSERT_ARE_EQUAL(char_ptr, "module_2", regular->module_sink);
+	ASSERT_ARE_EQUAL(uint64_t, 1, regular->messages);
+	ASSERT_ARE_EQUAL(uint64_t, 10, regular->bytes);
+	ASSERT_IS_TRUE(regular->last_activity == (time_t)300);
+
+	// Cleanup
+	VECTOR_destroy(props.gateway_modules);
+	VECTOR_destroy(props.gateway_links);
+	Gateway_LL_DestroyLinkStatistics(links);
+	Gateway_LL_Destroy(gateway);
+}
+
+/*Tests_SRS_GATEWAY_LL_13_011: [ If any underlying call fails, the function shall free the vector and return NULL. ]*/
+TEST_FUNCTION(Gateway_LL_GetLinkStatistics_Broker_GetLinkStatistics_fails)
+{
+	//Arrange
+	CGatewayLLMocks mocks;
+	// Using only for implemenation instead of checking calls
+	mocks.SetIgnoreUnexpectedCalls(true);
+
+	GATEWAY_MODULES_ENTRY module_entries[] = {
+		{
+			"module_1",
+			"x.dll",
+			NULL
+		},
+		{
+			"module_2",
+			"x.dll",
+			NULL
+		}
+	};
+
+	GATEWAY_LINK_ENTRY link_entries[] = {
+		{ "module_1", "module_2" },
+		{ "module_2", "module_1" }
+	};
+
+	GATEWAY_PROPERTIES props;
+	props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
+	props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+	props.broker_options = NULL;
+	VECTOR_push_back(props.gateway_modules, module_entries, 2);
+	VECTOR_push_back(props.gateway_links, link_entries, 2);
+
+	auto gateway = Gateway_LL_Create(&props);
+	whenShallBroker_GetLinkStatistics_fail = 2;
+
+	//Act
+	auto links = Gateway_LL_GetLinkStatistics(gateway);
+
+	// Assert
+	ASSERT_IS_NULL(links);
+
+	// Cleanup
+	VECTOR_destroy(props.gateway_modules);
+	VECTOR_destroy(props.gateway_links);
+	Gateway_LL_Destroy(gateway);
+}
+
+/*Tests_SRS_GATEWAY_LL_13_012: [ The function shall destroy the vector returned by Gateway_LL_GetLinkStatistics. ]*/
+TEST_FUNCTION(Gateway_LL_DestroyLinkStatistics_null)
+{
+	//Arrange
+	CGatewayLLMocks mocks;
+
+	//Expect
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(NULL));
+
+	//Act
+	Gateway_LL_DestroyLinkStatistics(NULL);
+
+	//Assert
+	mocks.AssertActualAndExpectedCalls();
+}
+
 /* Tests_SRS_GATEWAY_LL_26_015: [ If `gw` or `module_name` is `NULL` the function shall do nothing and return with non - zero result. ] */
 TEST_FUNCTION(Gateway_LL_RemoveModuleByName_Null_gw)
 {
@@ -4650,6 +5349,7 @@ TEST_FUNCTION(Gateway_LL_RemoveModule_removes_links)
 	GATEWAY_PROPERTIES props;
 	props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
 	props.gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY));
+	props.broker_options = NULL;
 	VECTOR_push_back(props.gateway_modules, modules, 3);
 	VECTOR_push_back(props.gateway_links, links, 3);
 
@@ -4775,6 +5475,7 @@ TEST_FUNCTION(Gateway_LL_AddModule_name_is_copied)
 	GATEWAY_PROPERTIES props;
 	props.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
 	props.gateway_links = NULL;
+	props.broker_options = NULL;
 	VECTOR_push_back(props.gateway_modules, &module, 1);
 
 	// Act
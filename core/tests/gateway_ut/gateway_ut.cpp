@@ -244,6 +244,15 @@ int             json_boolean(const JSON_Value *value);
 #undef parson_parson_h
 #include "parson.h"
 
+static bool hasFirstModuleOptions;
+static BROKER_MODULE_OPTIONS firstModuleOptions;
+static size_t firstModuleInstances;
+static const char* firstModulePartitionKey;
+static bool hasBrokerOptions;
+static BROKER_OPTIONS brokerOptions;
+static size_t firstLinkConditionCount;
+static BROKER_FILTER_CONDITION firstLinkConditions[3];
+
 TYPED_MOCK_CLASS(CGatewayMocks, CGlobalMock)
 {
 public:
@@ -285,6 +294,9 @@ public:
 		}
 	MOCK_METHOD_END(JSON_Object*, object);
 
+	MOCK_STATIC_METHOD_2(, double, json_array_get_number, const JSON_Array*, arr, size_t, index)
+	MOCK_METHOD_END(double, 0);
+
 	MOCK_STATIC_METHOD_2(, const char*, json_object_get_string, const JSON_Object*, object, const char*, name)
 		const char* string = NULL;
 		if (object != NULL && name != NULL)
@@ -293,6 +305,12 @@ public:
 		}
 	MOCK_METHOD_END(const char*, string);
 
+	MOCK_STATIC_METHOD_2(, JSON_Object*, json_object_get_object, const JSON_Object*, object, const char*, name)
+	MOCK_METHOD_END(JSON_Object*, (JSON_Object*)NULL);
+
+	MOCK_STATIC_METHOD_2(, double, json_object_get_number, const JSON_Object*, object, const char*, name)
+	MOCK_METHOD_END(double, 0);
+
 	MOCK_STATIC_METHOD_2(, JSON_Value*, json_object_get_value, const JSON_Object*, object, const char*, name)
 		JSON_Value* value = NULL;
 		if (object != NULL && name != NULL)
@@ -301,6 +319,17 @@ public:
 		}
 	MOCK_METHOD_END(JSON_Value*, value);
 
+	MOCK_STATIC_METHOD_1(, JSON_Array*, json_value_get_array, const JSON_Value*, value)
+		JSON_Array* arr = NULL;
+		if (value != NULL)
+		{
+			arr = (JSON_Array*)0x42;
+		}
+	MOCK_METHOD_END(JSON_Array*, arr);
+
+	MOCK_STATIC_METHOD_2(, int, json_object_get_boolean, const JSON_Object*, object, const char*, name)
+	MOCK_METHOD_END(int, -1);
+
 	MOCK_STATIC_METHOD_1(, char*, json_serialize_to_string, const JSON_Value*, value)
 		char* serialized_string = NULL;
 		const char* text = "[serialized string]";
@@ -321,6 +350,31 @@ public:
 
 	/*Gateway Mocks*/
 	MOCK_STATIC_METHOD_1(, GATEWAY_HANDLE, Gateway_LL_Create, const GATEWAY_PROPERTIES*, properties)
+		if (properties != NULL && properties->gateway_modules != NULL && BASEIMPLEMENTATION::VECTOR_size(properties->gateway_modules) > 0)
+		{
+			GATEWAY_MODULES_ENTRY* entry = (GATEWAY_MODULES_ENTRY*)BASEIMPLEMENTATION::VECTOR_element(properties->gateway_modules, 0);
+			hasFirstModuleOptions = (entry->module_options != NULL);
+			firstModuleInstances = entry->instances;
+			firstModulePartitionKey = entry->partition_key;
+			if (hasFirstModuleOptions)
+			{
+				firstModuleOptions = *(entry->module_options);
+			}
+		}
+		if (properties != NULL && properties->gateway_links != NULL && BASEIMPLEMENTATION::VECTOR_size(properties->gateway_links) > 0)
+		{
+			GATEWAY_LINK_ENTRY* entry = (GATEWAY_LINK_ENTRY*)BASEIMPLEMENTATION::VECTOR_element(properties->gateway_links, 0);
+			firstLinkConditionCount = (entry->filter == NULL) ? 0 : entry->filter->condition_count;
+			for (size_t i = 0; i < firstLinkConditionCount && i < 3; i++)
+			{
+				firstLinkConditions[i] = entry->filter->conditions[i];
+			}
+		}
+		hasBrokerOptions = (properties != NULL && properties->broker_options != NULL);
+		if (hasBrokerOptions)
+		{
+			brokerOptions = *(properties->broker_options);
+		}
 		GATEWAY_HANDLE handle = (GATEWAY_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1);
 	MOCK_METHOD_END(GATEWAY_HANDLE, handle);
 
@@ -383,8 +437,13 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , JSON_Object*, json_value_get_objec
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , JSON_Array*, json_object_get_array, const JSON_Object*, object, const char*, name);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , size_t, json_array_get_count, const JSON_Array*, arr);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , JSON_Object*, json_array_get_object, const JSON_Array*, arr, size_t, index);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , double, json_array_get_number, const JSON_Array*, arr, size_t, index);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , const char*, json_object_get_string, const JSON_Object*, object, const char*, name);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , JSON_Object*, json_object_get_object, const JSON_Object*, object, const char*, name);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , double, json_object_get_number, const JSON_Object*, object, const char*, name);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , JSON_Value*, json_object_get_value, const JSON_Object*, object, const char*, name);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , JSON_Array*, json_value_get_array, const JSON_Value*, value);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , int, json_object_get_boolean, const JSON_Object*, object, const char*, name);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , char*, json_serialize_to_string, const JSON_Value*, value);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , void, json_value_free, JSON_Value*, value);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , void, json_free_serialized_string, char*, string);
@@ -432,6 +491,12 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 	{
 		ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
 	}
+
+	hasFirstModuleOptions = false;
+	firstModuleInstances = 0;
+	firstModulePartitionKey = NULL;
+	hasBrokerOptions = false;
+	firstLinkConditionCount = 0;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -522,8 +587,14 @@ TEST_FUNCTION(Gateway_Create_Parses_Valid_JSON_Configuration_File)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "instances"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
@@ -536,8 +607,14 @@ TEST_FUNCTION(Gateway_Create_Parses_Valid_JSON_Configuration_File)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "instances"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
@@ -553,6 +630,9 @@ TEST_FUNCTION(Gateway_Create_Parses_Valid_JSON_Configuration_File)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "sink"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "filter"))
+		.IgnoreArgument(1)
+		.SetReturn((JSON_Value*)NULL);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
@@ -563,10 +643,15 @@ TEST_FUNCTION(Gateway_Create_Parses_Valid_JSON_Configuration_File)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "sink"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "filter"))
+		.IgnoreArgument(1)
+		.SetReturn((JSON_Value*)NULL);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
 
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "broker"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, Gateway_LL_Create(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
@@ -581,6 +666,12 @@ TEST_FUNCTION(Gateway_Create_Parses_Valid_JSON_Configuration_File)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
@@ -633,8 +724,14 @@ TEST_FUNCTION(Gateway_Create_Traverses_JSON_Value_Success)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "instances"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
@@ -647,8 +744,14 @@ TEST_FUNCTION(Gateway_Create_Traverses_JSON_Value_Success)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "instances"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
@@ -664,6 +767,9 @@ TEST_FUNCTION(Gateway_Create_Traverses_JSON_Value_Success)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "sink"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "filter"))
+		.IgnoreArgument(1)
+		.SetReturn((JSON_Value*)NULL);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
@@ -674,10 +780,15 @@ TEST_FUNCTION(Gateway_Create_Traverses_JSON_Value_Success)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "sink"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "filter"))
+		.IgnoreArgument(1)
+		.SetReturn((JSON_Value*)NULL);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
 
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "broker"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, Gateway_LL_Create(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
@@ -692,6 +803,12 @@ TEST_FUNCTION(Gateway_Create_Traverses_JSON_Value_Success)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
@@ -740,8 +857,14 @@ TEST_FUNCTION(Gateway_Create_Start_fails_returns_null)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "instances"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
@@ -754,8 +877,14 @@ TEST_FUNCTION(Gateway_Create_Start_fails_returns_null)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "instances"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
@@ -771,6 +900,9 @@ TEST_FUNCTION(Gateway_Create_Start_fails_returns_null)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "sink"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "filter"))
+		.IgnoreArgument(1)
+		.SetReturn((JSON_Value*)NULL);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
@@ -781,10 +913,15 @@ TEST_FUNCTION(Gateway_Create_Start_fails_returns_null)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "sink"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "filter"))
+		.IgnoreArgument(1)
+		.SetReturn((JSON_Value*)NULL);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
 
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "broker"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, Gateway_LL_Create(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
@@ -799,6 +936,12 @@ TEST_FUNCTION(Gateway_Create_Start_fails_returns_null)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
@@ -852,8 +995,14 @@ TEST_FUNCTION(Gateway_Create_Traverses_JSON_Push_Back_Fail)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "instances"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
@@ -866,8 +1015,14 @@ TEST_FUNCTION(Gateway_Create_Traverses_JSON_Push_Back_Fail)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "instances"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2)
@@ -984,8 +1139,14 @@ TEST_FUNCTION(Gateway_Create_Traverses_JSON_Value_VECTOR_Create_for_links_Fail)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "instances"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
@@ -998,8 +1159,14 @@ TEST_FUNCTION(Gateway_Create_Traverses_JSON_Value_VECTOR_Create_for_links_Fail)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
 		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "instances"))
+		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
 		.IgnoreArgument(1)
 		.IgnoreArgument(2);
@@ -1108,4 +1275,823 @@ TEST_FUNCTION(Gateway_Create_Fails_For_Missing_Info_In_JSON_Configuration)
 	mocks.AssertActualAndExpectedCalls();
 }
 
+/*Tests_SRS_GATEWAY_13_001: [The function shall set the module_options of the GATEWAY_MODULES_ENTRY from the module's "queue" and "thread" objects, or to NULL if the module has neither.]*/
+/*Tests_SRS_GATEWAY_13_002: [The "max depth", "max bytes", "timeout" and "batch size" values of the "queue" object shall be non-negative numbers, a missing value meaning 0.]*/
+/*Tests_SRS_GATEWAY_13_003: [The "policy" value of the "queue" object shall be "drop newest", "drop oldest" or "block", a missing value meaning "drop newest".]*/
+/*Tests_SRS_GATEWAY_13_014: [The "inline" value of the "queue" object shall let the broker deliver the module's messages inline when it is true, a missing or non-boolean value meaning false.]*/
+TEST_FUNCTION(Gateway_Create_Parses_Module_Queue_Options)
+{
+	//Arrange
+	CGatewayMocks mocks;
+
+	STRICT_EXPECTED_CALL(mocks, json_parse_file(VALID_JSON_PATH));
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(GATEWAY_PROPERTIES)));
+	STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "modules"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "links"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(1);
+
+	STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "module name"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "module path"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1)
+		.SetReturn((JSON_Object*)0x42);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "max depth"))
+		.IgnoreArgument(1)
+		.SetReturn(100);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "max bytes"))
+		.IgnoreArgument(1)
+		.SetReturn(65536);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "timeout"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "batch size"))
+		.IgnoreArgument(1)
+		.SetReturn(16);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "policy"))
+		.IgnoreArgument(1)
+		.SetReturn("drop oldest");
+	STRICT_EXPECTED_CALL(mocks, json_object_get_boolean(IGNORED_PTR_ARG, "inline"))
+		.IgnoreArgument(1)
+		.SetReturn(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(BROKER_MODULE_OPTIONS)));
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "instances"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_LINK_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(0);
+
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "broker"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Gateway_LL_Create(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_free_serialized_string(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	STRICT_EXPECTED_CALL(mocks, Gateway_LL_Start(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	//Act
+	GATEWAY_HANDLE gateway = Gateway_Create_From_JSON(VALID_JSON_PATH);
+
+	//Assert
+	ASSERT_IS_NOT_NULL(gateway);
+	ASSERT_IS_TRUE(hasFirstModuleOptions);
+	ASSERT_ARE_EQUAL(size_t, 100, firstModuleOptions.queue.max_depth);
+	ASSERT_ARE_EQUAL(size_t, 65536, firstModuleOptions.queue.max_bytes);
+	ASSERT_ARE_EQUAL(int, (int)BROKER_QUEUE_DROP_OLDEST, (int)firstModuleOptions.queue.policy);
+	ASSERT_ARE_EQUAL(size_t, 16, firstModuleOptions.queue.max_batch_size);
+	ASSERT_ARE_EQUAL(int, 1, firstModuleOptions.queue.inline_delivery);
+	mocks.AssertActualAndExpectedCalls();
+
+	//Cleanup
+	Gateway_LL_Destroy(gateway);
+}
+
+/*Tests_SRS_GATEWAY_13_015: [The function shall set the instances and partition_key of the GATEWAY_MODULES_ENTRY from the module's "instances" and "partition key" values.]*/
+/*Tests_SRS_GATEWAY_13_016: [The "instances" value of a module shall be a non-negative integer, a missing value or 0 meaning 1, and a module with more than 1 instance shall have a "partition key" string.]*/
+TEST_FUNCTION(Gateway_Create_Parses_Module_Instances)
+{
+	//Arrange
+	CGatewayMocks mocks;
+
+	STRICT_EXPECTED_CALL(mocks, json_parse_file(VALID_JSON_PATH));
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(GATEWAY_PROPERTIES)));
+	STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "modules"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "links"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(1);
+
+	STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "module name"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "module path"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "instances"))
+		.IgnoreArgument(1)
+		.SetReturn(4);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "partition key"))
+		.IgnoreArgument(1)
+		.SetReturn("deviceId");
+	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_LINK_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(0);
+
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "broker"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Gateway_LL_Create(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_free_serialized_string(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	STRICT_EXPECTED_CALL(mocks, Gateway_LL_Start(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	//Act
+	GATEWAY_HANDLE gateway = Gateway_Create_From_JSON(VALID_JSON_PATH);
+
+	//Assert
+	ASSERT_IS_NOT_NULL(gateway);
+	ASSERT_IS_FALSE(hasFirstModuleOptions);
+	ASSERT_ARE_EQUAL(size_t, 4, firstModuleInstances);
+	ASSERT_ARE_EQUAL(char_ptr, "deviceId", firstModulePartitionKey);
+	mocks.AssertActualAndExpectedCalls();
+
+	//Cleanup
+	Gateway_LL_Destroy(gateway);
+}
+
+/*Tests_SRS_GATEWAY_13_003: [The "policy" value of the "queue" object shall be "drop newest", "drop oldest" or "block", a missing value meaning "drop newest".]*/
+TEST_FUNCTION(Gateway_Create_Fails_For_Unknown_Queue_Policy)
+{
+	//Arrange
+	CGatewayMocks mocks;
+
+	STRICT_EXPECTED_CALL(mocks, json_parse_file(VALID_JSON_PATH));
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(GATEWAY_PROPERTIES)));
+	STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "modules"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "links"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(1);
+
+	STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "module name"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "module path"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1)
+		.SetReturn((JSON_Object*)0x42);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "max depth"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "max bytes"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "timeout"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "batch size"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "policy"))
+		.IgnoreArgument(1)
+		.SetReturn("sometimes");
+	STRICT_EXPECTED_CALL(mocks, json_object_get_boolean(IGNORED_PTR_ARG, "inline"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_free_serialized_string(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	//Act
+	GATEWAY_HANDLE gateway = Gateway_Create_From_JSON(VALID_JSON_PATH);
+
+	//Assert
+	ASSERT_IS_NULL(gateway);
+	mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_GATEWAY_13_001: [The function shall set the module_options of the GATEWAY_MODULES_ENTRY from the module's "queue" and "thread" objects, or to NULL if the module has neither.]*/
+/*Tests_SRS_GATEWAY_13_011: [The "cpu affinity" value of the "thread" object shall be a non-empty array of processor indices from 0 to 63, a missing value meaning any processor.]*/
+/*Tests_SRS_GATEWAY_13_012: [The "policy" value of the "thread" object shall be "default", "fifo" or "round robin", a missing value meaning "default", and its "priority" value shall be an integer, a missing value meaning 0.]*/
+/*Tests_SRS_GATEWAY_13_013: [The "name" value of the "thread" object shall be a string shorter than BROKER_THREAD_NAME_SIZE characters, a missing value keeping the names of the threads.]*/
+TEST_FUNCTION(Gateway_Create_Parses_Module_Thread_Options)
+{
+	//Arrange
+	CGatewayMocks mocks;
+
+	STRICT_EXPECTED_CALL(mocks, json_parse_file(VALID_JSON_PATH));
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(GATEWAY_PROPERTIES)));
+	STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "modules"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "links"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(1);
+
+	STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "module name"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "module path"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1)
+		.SetReturn((JSON_Object*)0x42);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "name"))
+		.IgnoreArgument(1)
+		.SetReturn("bar-worker");
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "cpu affinity"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "policy"))
+		.IgnoreArgument(1)
+		.SetReturn("fifo");
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "priority"))
+		.IgnoreArgument(1)
+		.SetReturn(50);
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(2);
+	STRICT_EXPECTED_CALL(mocks, json_array_get_number(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1)
+		.SetReturn(2);
+	STRICT_EXPECTED_CALL(mocks, json_array_get_number(IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.SetReturn(3);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(BROKER_MODULE_OPTIONS)));
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "instances"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_LINK_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(0);
+
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "broker"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Gateway_LL_Create(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_free_serialized_string(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	STRICT_EXPECTED_CALL(mocks, Gateway_LL_Start(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	//Act
+	GATEWAY_HANDLE gateway = Gateway_Create_From_JSON(VALID_JSON_PATH);
+
+	//Assert
+	ASSERT_IS_NOT_NULL(gateway);
+	ASSERT_IS_TRUE(hasFirstModuleOptions);
+	ASSERT_ARE_EQUAL(size_t, 0, firstModuleOptions.queue.max_depth);
+	ASSERT_ARE_EQUAL(int, (int)BROKER_QUEUE_DROP_NEWEST, (int)firstModuleOptions.queue.policy);
+	ASSERT_ARE_EQUAL(int, 0, firstModuleOptions.queue.inline_delivery);
+	ASSERT_ARE_EQUAL(uint64_t, (uint64_t)0xC, firstModuleOptions.thread.cpu_affinity);
+	ASSERT_ARE_EQUAL(int, (int)BROKER_THREAD_POLICY_FIFO, (int)firstModuleOptions.thread.policy);
+	ASSERT_ARE_EQUAL(int, 50, firstModuleOptions.thread.priority);
+	ASSERT_ARE_EQUAL(char_ptr, "bar-worker", firstModuleOptions.thread.name);
+	mocks.AssertActualAndExpectedCalls();
+
+	//Cleanup
+	Gateway_LL_Destroy(gateway);
+}
+
+/*Tests_SRS_GATEWAY_13_011: [The "cpu affinity" value of the "thread" object shall be a non-empty array of processor indices from 0 to 63, a missing value meaning any processor.]*/
+TEST_FUNCTION(Gateway_Create_Fails_For_Out_Of_Range_Cpu_Affinity)
+{
+	//Arrange
+	CGatewayMocks mocks;
+
+	STRICT_EXPECTED_CALL(mocks, json_parse_file(VALID_JSON_PATH));
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(GATEWAY_PROPERTIES)));
+	STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "modules"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "links"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(1);
+
+	STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "module name"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "module path"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "queue"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "thread"))
+		.IgnoreArgument(1)
+		.SetReturn((JSON_Object*)0x42);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "name"))
+		.IgnoreArgument(1)
+		.SetReturn("bar-worker");
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "cpu affinity"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "policy"))
+		.IgnoreArgument(1)
+		.SetReturn("fifo");
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "priority"))
+		.IgnoreArgument(1)
+		.SetReturn(50);
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(2);
+	STRICT_EXPECTED_CALL(mocks, json_array_get_number(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1)
+		.SetReturn(2);
+	STRICT_EXPECTED_CALL(mocks, json_array_get_number(IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.SetReturn(64);
+	STRICT_EXPECTED_CALL(mocks, json_free_serialized_string(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	//Act
+	GATEWAY_HANDLE gateway = Gateway_Create_From_JSON(VALID_JSON_PATH);
+
+	//Assert
+	ASSERT_IS_NULL(gateway);
+	mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_GATEWAY_13_005: [The function shall set the broker_options of the GATEWAY_PROPERTIES from the top level "broker" object, or to NULL if the configuration has none.]*/
+/*Tests_SRS_GATEWAY_13_006: [The "workers" value of the "broker" object shall be a non-negative number, a missing value meaning 0.]*/
+TEST_FUNCTION(Gateway_Create_Parses_Broker_Options)
+{
+	//Arrange
+	CGatewayMocks mocks;
+
+	STRICT_EXPECTED_CALL(mocks, json_parse_file(VALID_JSON_PATH));
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(GATEWAY_PROPERTIES)));
+	STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "modules"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "links"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_LINK_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "broker"))
+		.IgnoreArgument(1)
+		.SetReturn((JSON_Object*)0x42);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "workers"))
+		.IgnoreArgument(1)
+		.SetReturn(4);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(BROKER_OPTIONS)));
+
+	STRICT_EXPECTED_CALL(mocks, Gateway_LL_Create(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	STRICT_EXPECTED_CALL(mocks, Gateway_LL_Start(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	//Act
+	GATEWAY_HANDLE gateway = Gateway_Create_From_JSON(VALID_JSON_PATH);
+
+	//Assert
+	ASSERT_IS_NOT_NULL(gateway);
+	ASSERT_IS_TRUE(hasBrokerOptions);
+	ASSERT_ARE_EQUAL(size_t, 4, brokerOptions.worker_count);
+	mocks.AssertActualAndExpectedCalls();
+
+	//Cleanup
+	Gateway_LL_Destroy(gateway);
+}
+
+/*Tests_SRS_GATEWAY_13_006: [The "workers" value of the "broker" object shall be a non-negative number, a missing value meaning 0.]*/
+TEST_FUNCTION(Gateway_Create_Fails_For_Negative_Broker_Workers)
+{
+	//Arrange
+	CGatewayMocks mocks;
+
+	STRICT_EXPECTED_CALL(mocks, json_parse_file(VALID_JSON_PATH));
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(GATEWAY_PROPERTIES)));
+	STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "modules"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "links"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_LINK_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "broker"))
+		.IgnoreArgument(1)
+		.SetReturn((JSON_Object*)0x42);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_number(IGNORED_PTR_ARG, "workers"))
+		.IgnoreArgument(1)
+		.SetReturn(-1);
+
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	//Act
+	GATEWAY_HANDLE gateway = Gateway_Create_From_JSON(VALID_JSON_PATH);
+
+	//Assert
+	ASSERT_IS_NULL(gateway);
+	mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_GATEWAY_13_007: [The function shall set the filter of the GATEWAY_LINK_ENTRY from the link's "filter" array, or to NULL if the link has none.]*/
+/*Tests_SRS_GATEWAY_13_009: [Every object of the "filter" array shall have a "property" string and exactly one of an "equals" string, a "prefix" string or an "exists" value of true.]*/
+/*Tests_SRS_GATEWAY_13_010: [The operation of the condition shall be BROKER_FILTER_EQUALS, BROKER_FILTER_PREFIX or BROKER_FILTER_EXISTS respectively.]*/
+TEST_FUNCTION(Gateway_Create_Parses_Link_Filter)
+{
+	//Arrange
+	CGatewayMocks mocks;
+
+	STRICT_EXPECTED_CALL(mocks, json_parse_file(VALID_JSON_PATH));
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(GATEWAY_PROPERTIES)));
+	STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "modules"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "links"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_LINK_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(1);
+
+	STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "source"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "sink"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "filter"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_value_get_array(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(3);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(BROKER_LINK_FILTER) + 3 * sizeof(BROKER_FILTER_CONDITION)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "equals"))
+		.IgnoreArgument(1)
+		.SetReturn("00:11:22:33:44:55");
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "prefix"))
+		.IgnoreArgument(1)
+		.SetReturn((const char*)NULL);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_boolean(IGNORED_PTR_ARG, "exists"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "property"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "equals"))
+		.IgnoreArgument(1)
+		.SetReturn((const char*)NULL);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "prefix"))
+		.IgnoreArgument(1)
+		.SetReturn("sensor");
+	STRICT_EXPECTED_CALL(mocks, json_object_get_boolean(IGNORED_PTR_ARG, "exists"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "property"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 2))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "equals"))
+		.IgnoreArgument(1)
+		.SetReturn((const char*)NULL);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "prefix"))
+		.IgnoreArgument(1)
+		.SetReturn((const char*)NULL);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_boolean(IGNORED_PTR_ARG, "exists"))
+		.IgnoreArgument(1)
+		.SetReturn(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "property"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+
+	STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "broker"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, Gateway_LL_Create(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	STRICT_EXPECTED_CALL(mocks, Gateway_LL_Start(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	//Act
+	GATEWAY_HANDLE gateway = Gateway_Create_From_JSON(VALID_JSON_PATH);
+
+	//Assert
+	ASSERT_IS_NOT_NULL(gateway);
+	ASSERT_ARE_EQUAL(size_t, 3, firstLinkConditionCount);
+	ASSERT_ARE_EQUAL(int, (int)BROKER_FILTER_EQUALS, (int)firstLinkConditions[0].operation);
+	ASSERT_ARE_EQUAL(char_ptr, "property", firstLinkConditions[0].name);
+	ASSERT_ARE_EQUAL(char_ptr, "00:11:22:33:44:55", firstLinkConditions[0].value);
+	ASSERT_ARE_EQUAL(int, (int)BROKER_FILTER_PREFIX, (int)firstLinkConditions[1].operation);
+	ASSERT_ARE_EQUAL(char_ptr, "sensor", firstLinkConditions[1].value);
+	ASSERT_ARE_EQUAL(int, (int)BROKER_FILTER_EXISTS, (int)firstLinkConditions[2].operation);
+	ASSERT_IS_NULL(firstLinkConditions[2].value);
+	mocks.AssertActualAndExpectedCalls();
+
+	//Cleanup
+	Gateway_LL_Destroy(gateway);
+}
+
+/*Tests_SRS_GATEWAY_13_009: [Every object of the "filter" array shall have a "property" string and exactly one of an "equals" string, a "prefix" string or an "exists" value of true.]*/
+TEST_FUNCTION(Gateway_Create_Fails_For_Link_Filter_Condition_With_Two_Operations)
+{
+	//Arrange
+	CGatewayMocks mocks;
+
+	STRICT_EXPECTED_CALL(mocks, json_parse_file(VALID_JSON_PATH));
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(GATEWAY_PROPERTIES)));
+	STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "modules"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "links"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_LINK_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(1);
+
+	STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "source"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "sink"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "filter"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_value_get_array(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(BROKER_LINK_FILTER) + sizeof(BROKER_FILTER_CONDITION)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "equals"))
+		.IgnoreArgument(1)
+		.SetReturn("00:11:22:33:44:55");
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "prefix"))
+		.IgnoreArgument(1)
+		.SetReturn("00:11");
+	STRICT_EXPECTED_CALL(mocks, json_object_get_boolean(IGNORED_PTR_ARG, "exists"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "property"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	//Act
+	GATEWAY_HANDLE gateway = Gateway_Create_From_JSON(VALID_JSON_PATH);
+
+	//Assert
+	ASSERT_IS_NULL(gateway);
+	mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_GATEWAY_13_008: [The "filter" value of a link shall be a non-empty array.]*/
+TEST_FUNCTION(Gateway_Create_Fails_For_Empty_Link_Filter)
+{
+	//Arrange
+	CGatewayMocks mocks;
+
+	STRICT_EXPECTED_CALL(mocks, json_parse_file(VALID_JSON_PATH));
+	STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(GATEWAY_PROPERTIES)));
+	STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "modules"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "links"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(0);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_LINK_ENTRY)));
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(1);
+
+	STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 0))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "source"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "sink"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "filter"))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_value_get_array(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.SetReturn(0);
+
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	//Act
+	GATEWAY_HANDLE gateway = Gateway_Create_From_JSON(VALID_JSON_PATH);
+
+	//Assert
+	ASSERT_IS_NULL(gateway);
+	mocks.AssertActualAndExpectedCalls();
+}
+
 END_TEST_SUITE(gateway_ut)
@@ -29,9 +29,6 @@ static size_t whenShallmalloc_fail;
 static size_t currentConstMap_Create_call;
 static size_t whenShallConstMap_Create_fail;
 
-static size_t currentConstMap_Clone_call;
-static size_t whenShallConstMap_Clone_fail;
-
 static size_t currentCONSTBUFFER_Create_call;
 static size_t whenShallCONSTBUFFER_Create_fail;
 static size_t currentCONSTBUFFER_refCount;
@@ -62,6 +59,14 @@ static void* my_gballoc_malloc(size_t size)
 }
 
 
+static size_t test_release_calls;
+static void* test_release_context;
+static void test_release(void* context)
+{
+    test_release_calls++;
+    test_release_context = context;
+}
+
 static void my_gballoc_free(void* ptr)
 {
     free(ptr);
@@ -83,20 +88,24 @@ static CONSTMAP_HANDLE my_ConstMap_Create(MAP_HANDLE sourceMap)
     return result2;
 }
 
-static CONSTMAP_HANDLE my_ConstMap_Clone(CONSTMAP_HANDLE handle)
+/*the properties returned by Map_GetInternals, none unless a test sets them*/
+static const char* const* currentMap_keys;
+static const char* const* currentMap_values;
+static size_t currentMap_count;
+
+static MAP_RESULT my_Map_GetInternals(MAP_HANDLE handle, const char*const** keys, const char*const** values, size_t* count)
 {
-    CONSTMAP_HANDLE result3;
-    currentConstMap_Clone_call++;
-    if (whenShallConstMap_Clone_fail == currentConstMap_Clone_call)
-    {
-        result3 = NULL;
-    }
-    else
-    {
-        result3 = handle;
-        *(unsigned char*)result3 += 1;
-    }
-    return result3;
+    (void)handle;
+    *keys = currentMap_keys;
+    *values = currentMap_values;
+    *count = currentMap_count;
+    return MAP_OK;
+}
+
+static CONSTMAP_HANDLE my_ConstMap_Clone(CONSTMAP_HANDLE map)
+{
+    ++(*(unsigned char*)map);
+    return map;
 }
 
 static void my_ConstMap_Destroy(CONSTMAP_HANDLE map)
@@ -271,6 +280,41 @@ static const unsigned char notFail__2Property_2bytes[] =
     '3', '4'
 };
 
+static const unsigned char notFail____minimalMessage_v2[] =
+{
+    0xA1, 0x61,             /*header, version 2*/
+    6,                      /*size of this array*/
+    0,                      /*zero properties*/
+    0,                      /*zero bytes of properties*/
+    0                       /*zero message content size*/
+};
+
+static const unsigned char notFail__2Property_2bytes_v2[] =
+{
+    0xA1, 0x61,             /*header, version 2*/
+    60,                     /*size of this array*/
+    2,                      /*two properties*/
+    50,                     /*50 bytes of properties*/
+    0, 20,                  /*offsets of the properties*/
+    12, 'B','l','e','e','d','i','n','g','E','d','g','e','\0','r','o','c','k','s','\0',
+    20, 'A', 'z','u','r','e',' ','I','o','T',' ','G','a','t','e','w','a','y',' ','i','s','\0','a','w','e','s','o','m','e','\0',
+    2,                      /*2 message content size*/
+    '3', '4'
+};
+
+static const unsigned char fail_v2_secondPropertyOffsetOutOfRange[] =
+{
+    0xA1, 0x61,             /*header, version 2*/
+    60,                     /*size of this array*/
+    2,                      /*two properties*/
+    50,                     /*50 bytes of properties*/
+    0, 50,                  /*offsets of the properties - wrong*/
+    12, 'B','l','e','e','d','i','n','g','E','d','g','e','\0','r','o','c','k','s','\0',
+    20, 'A', 'z','u','r','e',' ','I','o','T',' ','G','a','t','e','w','a','y',' ','i','s','\0','a','w','e','s','o','m','e','\0',
+    2,                      /*2 message content size*/
+    '3', '4'
+};
+
 static const unsigned char fail_____firstByteNot0xA1[] =
 {
     0xA2, 0x60,             /*header - wrong*/
@@ -284,7 +328,7 @@ static const unsigned char fail_____firstByteNot0xA1[] =
 
 static const unsigned char fail____secondByteNot0x60[] =
 {
-    0xA1, 0x61,             /*header - wrong*/
+    0xA1, 0x62,             /*header - wrong*/
     0x00, 0x00, 0x00, 64,   /*size of this array*/
     0x00, 0x00, 0x00, 0x02, /*two properties*/
     'B','l','e','e','d','i','n','g','E','d','g','e','\0','r','o','c','k','s','\0',
@@ -358,8 +402,9 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
 
         REGISTER_GLOBAL_MOCK_HOOK(ConstMap_Create, my_ConstMap_Create);
-        REGISTER_GLOBAL_MOCK_HOOK(ConstMap_Clone, my_ConstMap_Clone);
         REGISTER_GLOBAL_MOCK_HOOK(ConstMap_Destroy, my_ConstMap_Destroy);
+        REGISTER_GLOBAL_MOCK_HOOK(ConstMap_Clone, my_ConstMap_Clone);
+        REGISTER_GLOBAL_MOCK_HOOK(Map_GetInternals, my_Map_GetInternals);
 
         REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_Create, my_CONSTBUFFER_Create);
         REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_Clone, my_CONSTBUFFER_Clone);
@@ -400,11 +445,14 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
         currentmalloc_call = 0;
         whenShallmalloc_fail = 0;
+        test_release_calls = 0;
+        test_release_context = NULL;
 
 		currentConstMap_Create_call = 0;
 		whenShallConstMap_Create_fail = 0;
-		currentConstMap_Clone_call = 0;
-		whenShallConstMap_Clone_fail = 0;
+		currentMap_keys = NULL;
+		currentMap_values = NULL;
+		currentMap_count = 0;
 		currentCONSTBUFFER_Create_call = 0;
 		whenShallCONSTBUFFER_Create_fail = 0;
 		currentCONSTBUFFER_refCount = 0;
@@ -450,27 +498,31 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_006: [Otherwise, Message_Create shall return a non-NULL handle and shall set the internal ref count to "1".]*/
-    /*Tests_SRS_MESSAGE_02_019: [Message_Create shall clone the sourceProperties to a readonly CONSTMAP.] */
-	/*Tests_SRS_MESSAGE_17_003: [Message_Create shall copy the source to a readonly CONSTBUFFER.]*/
+    /*Tests_SRS_MESSAGE_02_019: [Message_Create shall copy the properties of sourceProperties into the same allocation as the message.]*/
+	/*Tests_SRS_MESSAGE_17_003: [Message_Create shall copy the source into the same allocation as the message.]*/
     TEST_FUNCTION(Message_Create_happy_path)
     {
         ///arrange
-        unsigned char fake;
+        unsigned char fake = '3';
         MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake};
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure, the content and the properties*/
             .IgnoreArgument(1);
 
-		STRICT_EXPECTED_CALL(CONSTBUFFER_Create(&fake, 1)); /*this is copying the buffer*/
-
-		STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
-
         ///act
         MESSAGE_HANDLE r = Message_Create(&c);
 
         ///assert
         ASSERT_IS_NOT_NULL(r);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        const CONSTBUFFER* content = Message_GetContent(r);
+        ASSERT_ARE_EQUAL(size_t, 1, content->size);
+        ASSERT_ARE_NOT_EQUAL(void_ptr, &fake, content->buffer);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(content->buffer, &fake, 1));
 
         ///cleanup
         Message_Destroy(r);
@@ -483,13 +535,13 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         unsigned char fake;
         MESSAGE_CONFIG c = { 0, &fake, (MAP_HANDLE)&fake };
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure and the properties*/
             .IgnoreArgument(1);
 
-		STRICT_EXPECTED_CALL(CONSTBUFFER_Create(&fake, 0)); /* this is copying the (empty buffer)*/
-
-		STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
-
         ///act
         MESSAGE_HANDLE r = Message_Create(&c);
 
@@ -508,13 +560,13 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         unsigned char fake;
         MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&fake }; /*<---- this is NULL , in the testbefore it was non-NULL*/
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure and the properties*/
             .IgnoreArgument(1);
 
-		STRICT_EXPECTED_CALL(CONSTBUFFER_Create(NULL, 0)); /* this is copying the (empty buffer)*/
-
-		STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
-
         ///act
         MESSAGE_HANDLE r = Message_Create(&c);
 
@@ -527,27 +579,18 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_005: [If Message_Create encounters an error while building the internal structures of the message, then it shall return NULL.]*/
-    TEST_FUNCTION(Message_Create_zero_size_fails_when_Map_Clone_fails)
+    TEST_FUNCTION(Message_Create_zero_size_fails_when_Map_GetInternals_fails)
     {
         ///arrange
         unsigned char fake;
         MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&fake }; /*<---- this is NULL , in the testbefore it was non-NULL*/
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
-            .IgnoreArgument(1);
-        {
-            STRICT_EXPECTED_CALL(CONSTBUFFER_Create(NULL, 0)); /* this is copying the (empty buffer)*/
-            {
-                whenShallConstMap_Create_fail = 1;
-                STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)) /*this is copying the properties*/
-                    .IgnoreArgument(1);
-
-                STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG)) /* this is copying the (empty buffer)*/
-                    .IgnoreArgument(1);
-            }
-            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
-        }
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count()
+            .SetReturn(MAP_ERROR);
+
         ///act
         MESSAGE_HANDLE r = Message_Create(&c);
 
@@ -566,6 +609,10 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&fake }; /*<---- this is NULL , in the testbefore it was non-NULL*/
 
         whenShallmalloc_fail = 1;
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
@@ -580,52 +627,18 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_005: [If Message_Create encounters an error while building the internal structures of the message, then it shall return NULL.]*/
-    TEST_FUNCTION(Message_Create_nonzero_size_fails_when_Map_Clone_fails)
-    {
-        ///arrange
-        unsigned char fake;
-        MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
-
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
-            .IgnoreArgument(1);
-        {
-            STRICT_EXPECTED_CALL(CONSTBUFFER_Create(&fake, 1)); /* this is copying the buffer*/
-            {
-
-                whenShallConstMap_Create_fail = 1;
-                STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
-
-                STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
-                    .IgnoreArgument(1);
-            }
-            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
-        }
-        ///act
-        MESSAGE_HANDLE r = Message_Create(&c);
-
-        ///assert
-        ASSERT_IS_NULL(r);
-        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-        ///cleanup
-    }
-
-    /*Tests_SRS_MESSAGE_02_005: [If Message_Create encounters an error while building the internal structures of the message, then it shall return NULL.]*/
-    TEST_FUNCTION(Message_Create_nonzero_size_fails_when_CONSTBUFFER_fails_1)
+    /*Tests_SRS_MESSAGE_13_004: [If Map_GetInternals fails, then creating the message shall fail.]*/
+    TEST_FUNCTION(Message_Create_nonzero_size_fails_when_Map_GetInternals_fails)
     {
         ///arrange
         unsigned char fake;
         MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
-            .IgnoreArgument(1);
-
-        whenShallCONSTBUFFER_Create_fail = 1;
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(&fake, 1)); /* this is copying the buffer*/
-        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count()
+            .SetReturn(MAP_ERROR);
 
         ///act
         MESSAGE_HANDLE r = Message_Create(&c);
@@ -645,6 +658,10 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
 
         whenShallmalloc_fail = 1;
+        STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
             .IgnoreArgument(1);
 
@@ -725,7 +742,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 	}
 
 	/*Tests_SRS_MESSAGE_17_014: [On success, Message_CreateFromBuffer shall return a non-NULL handle and set the internal ref count to "1".]*/
-	/*Tests_SRS_MESSAGE_17_012: [Message_CreateFromBuffer shall copy the sourceProperties to a readonly CONSTMAP.]*/
+	/*Tests_SRS_MESSAGE_17_012: [Message_CreateFromBuffer shall copy the properties of sourceProperties into the same allocation as the message.]*/
 	/*Tests_SRS_MESSAGE_17_013: [Message_CreateFromBuffer shall clone the CONSTBUFFER sourceBuffer.]*/
 	TEST_FUNCTION(Message_CreateFromBuffer_Success)
 	{
@@ -740,13 +757,15 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
 		umock_c_reset_all_calls();
 
-		STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
+		STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+			.IgnoreArgument_keys()
+			.IgnoreArgument_values()
+			.IgnoreArgument_count();
+		STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure and the properties*/
 			.IgnoreArgument(1);
 
 		STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(buffer)); /*this is copying the buffer*/
-
-		STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
-
+		STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(buffer));
 
 		///act
 		MESSAGE_HANDLE r = Message_CreateFromBuffer(&cfg);
@@ -777,6 +796,10 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
 		umock_c_reset_all_calls();
 
+		STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+			.IgnoreArgument_keys()
+			.IgnoreArgument_values()
+			.IgnoreArgument_count();
 		STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
 			.IgnoreArgument(1);
 
@@ -807,6 +830,10 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 		whenShallCONSTBUFFER_Clone_fail = 1;
 		umock_c_reset_all_calls();
 
+		STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+			.IgnoreArgument_keys()
+			.IgnoreArgument_values()
+			.IgnoreArgument_count();
 		STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
 			.IgnoreArgument(1);
 
@@ -837,23 +864,13 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 			(MAP_HANDLE)&fake
 		};
 
-		whenShallConstMap_Create_fail = 1;
 		umock_c_reset_all_calls();
 
-		STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure*/
-			.IgnoreArgument(1);
-        {
-            
-            STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(buffer)); /*this is copying the buffer*/
-            {
-                STRICT_EXPECTED_CALL(ConstMap_Create((MAP_HANDLE)&fake)); /*this is copying the properties*/
-                STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(buffer));
-            }
-
-            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-                .IgnoreArgument(1);
-        }
-
+		STRICT_EXPECTED_CALL(Map_GetInternals((MAP_HANDLE)&fake, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+			.IgnoreArgument_keys()
+			.IgnoreArgument_values()
+			.IgnoreArgument_count()
+			.SetReturn(MAP_ERROR);
 
 		///act
 		MESSAGE_HANDLE r = Message_CreateFromBuffer(&cfg);
@@ -882,8 +899,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_010: [Message_Clone shall return messageHandle.]*/
-	/*Tests_SRS_MESSAGE_17_001: [Message_Clone shall clone the CONSTMAP handle.]*/
-	/*Tests_SRS_MESSAGE_17_004: [Message_Clone shall clone the CONSTBUFFER handle]*/
+	/*Tests_SRS_MESSAGE_13_001: [Message_Clone shall not copy the properties and shall not clone the CONSTBUFFER handle held by the message.]*/
     TEST_FUNCTION(Message_Clone_increments_ref_count_1)
     {
         ///arrange
@@ -891,11 +907,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE aMessage = Message_Create(&c);
         umock_c_reset_all_calls();
 
-		STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
-
         ///act
         MESSAGE_HANDLE r = Message_Clone(aMessage);
 
@@ -917,11 +928,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE r = Message_Clone(aMessage);
         umock_c_reset_all_calls();
 
-		STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
-
         ///act
         Message_Destroy(r);
 
@@ -942,11 +948,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         Message_Destroy(r);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*only 1 because the message is 0 size*/
+		STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*only 1 because the content and the properties are stored with the message*/
 			.IgnoreArgument(1);
 
         ///act
@@ -958,14 +960,14 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         ///cleanup
     }
 
-    /*Tests_SRS_MESSAGE_02_011: [If message is NULL then Message_GetProperties shall return NULL.] */
-    TEST_FUNCTION(Message_GetProperties_with_NULL_messageHandle_returns_NULL)
+    /*Tests_SRS_MESSAGE_13_008: [If message is NULL, or edits is NULL and editCount is not zero, then Message_CloneWithPropertyEdits shall fail and return NULL.]*/
+    TEST_FUNCTION(Message_CloneWithPropertyEdits_with_NULL_message_fails)
     {
         ///arrange
-        umock_c_reset_all_calls();
+        MESSAGE_PROPERTY_EDIT edits[] = { { "source", "mapping" } };
 
         ///act
-        CONSTMAP_HANDLE r = Message_GetProperties(NULL);
+        MESSAGE_HANDLE r = Message_CloneWithPropertyEdits(NULL, edits, 1);
 
         ///assert
         ASSERT_IS_NULL(r);
@@ -974,570 +976,1167 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         ///cleanup
     }
 
-    /*Tests_SRS_MESSAGE_02_012: [Otherwise, Message_GetProperties shall shall clone and return the CONSTMAP handle representing the properties of the message.]*/
-    TEST_FUNCTION(Message_GetProperties_happy_path)
+    /*Tests_SRS_MESSAGE_13_008: [If message is NULL, or edits is NULL and editCount is not zero, then Message_CloneWithPropertyEdits shall fail and return NULL.]*/
+    TEST_FUNCTION(Message_CloneWithPropertyEdits_with_NULL_edits_and_nonzero_count_fails)
     {
         ///arrange
         MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
         MESSAGE_HANDLE aMessage = Message_Create(&c);
         umock_c_reset_all_calls();
 
-		STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
         ///act
-        CONSTMAP_HANDLE theProperties = Message_GetProperties(aMessage);
+        MESSAGE_HANDLE r = Message_CloneWithPropertyEdits(aMessage, NULL, 1);
 
         ///assert
-        ASSERT_IS_NOT_NULL(theProperties);
+        ASSERT_IS_NULL(r);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
         Message_Destroy(aMessage);
-		ConstMap_Destroy(theProperties);
     }
 
-    /*Tests_SRS_MESSAGE_02_013: [If message is NULL then Message_GetContent shall return NULL.] */
-    TEST_FUNCTION(Message_GetContent_with_NULL_message_returns_NULL)
+    /*Tests_SRS_MESSAGE_13_009: [If the key of an edit is NULL then Message_CloneWithPropertyEdits shall fail and return NULL.]*/
+    TEST_FUNCTION(Message_CloneWithPropertyEdits_with_NULL_key_fails)
     {
         ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        MESSAGE_PROPERTY_EDIT edits[] = { { "source", "mapping" }, { NULL, "value" } };
+        umock_c_reset_all_calls();
 
         ///act
-        const CONSTBUFFER* content = Message_GetContent(NULL);
+        MESSAGE_HANDLE r = Message_CloneWithPropertyEdits(aMessage, edits, 2);
 
         ///assert
-        ASSERT_IS_NULL(content);
+        ASSERT_IS_NULL(r);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        Message_Destroy(aMessage);
     }
 
-    /*Tests_SRS_MESSAGE_02_014: [Otherwise, Message_GetContent shall return a non-NULL const pointer to a structure of type CONSTBUFFER.]*/
-    /*Tests_SRS_MESSAGE_02_015: [The MESSAGE_CONTENT's field size shall have the same value as the cfg's field size.]*/
-    /*Tests_SRS_MESSAGE_02_016: [The MESSAGE_CONTENT's field data shall compare equal byte-by-byte to the cfg's field source.]*/
-    TEST_FUNCTION(Message_GetContent_with_non_NULL_message_zero_size_succeeds)
+    /*Tests_SRS_MESSAGE_13_012: [If Message_CloneWithPropertyEdits fails to allocate the new message, it shall return NULL.]*/
+    TEST_FUNCTION(Message_CloneWithPropertyEdits_fails_when_malloc_fails)
     {
         ///arrange
-        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c};
-        MESSAGE_HANDLE msg = Message_Create(&c);
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        MESSAGE_PROPERTY_EDIT edits[] = { { "source", "mapping" } };
         umock_c_reset_all_calls();
 
-		STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
+        whenShallmalloc_fail = currentmalloc_call + 1;
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
 
         ///act
-        const CONSTBUFFER* content = Message_GetContent(msg);
+        MESSAGE_HANDLE r = Message_CloneWithPropertyEdits(aMessage, edits, 1);
 
         ///assert
-        ASSERT_IS_NOT_NULL(content);
-        ASSERT_ARE_EQUAL(size_t, 0, content->size);
-        ASSERT_IS_NULL(content->buffer);
+        ASSERT_IS_NULL(r);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        Message_Destroy(msg);
+        Message_Destroy(aMessage);
     }
 
-    /*Tests_SRS_MESSAGE_02_014: [Otherwise, Message_GetContent shall return a non-NULL const pointer to a structure of type CONSTBUFFER.]*/
-    /*Tests_SRS_MESSAGE_02_015: [The MESSAGE_CONTENT's field size shall have the same value as the cfg's field size.]*/
-    /*Tests_SRS_MESSAGE_02_016: [The MESSAGE_CONTENT's field data shall compare equal byte-by-byte to the cfg's field source.]*/
-    TEST_FUNCTION(Message_GetContent_with_non_NULL_message_nonzero_size_succeeds)
+    /*Tests_SRS_MESSAGE_13_011: [Message_CloneWithPropertyEdits shall copy the edits into the same allocation as the new message.]*/
+    /*Tests_SRS_MESSAGE_13_013: [Message_GetPropertyById shall return the values of the well-known properties of the new message as edited.]*/
+    /*Tests_SRS_MESSAGE_13_014: [The new message shall share the properties and the content of message, and hold a reference to it until the new message is destroyed.]*/
+    /*Tests_SRS_MESSAGE_13_015: [On success, Message_CloneWithPropertyEdits shall return a non-NULL handle with its internal ref count set to "1".]*/
+    TEST_FUNCTION(Message_CloneWithPropertyEdits_happy_path)
     {
         ///arrange
-        char t ='3';
-        MESSAGE_CONFIG c = { sizeof(t), (unsigned char*)&t, (MAP_HANDLE)&c};
-        MESSAGE_HANDLE msg = Message_Create(&c);
+        const char* keys[] = { "macAddress", "source" };
+        const char* values[] = { "01:01:01:01:01:01", "bleTelemetry" };
+        char t = '3';
+        MESSAGE_CONFIG c = { sizeof(t), (unsigned char*)&t, (MAP_HANDLE)&c };
+        currentMap_keys = keys;
+        currentMap_values = values;
+        currentMap_count = 2;
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        char deviceName[] = "firstDevice";
+        MESSAGE_PROPERTY_EDIT edits[] =
+        {
+            { "deviceName", deviceName },
+            { "source", "iothub" },
+            { "macAddress", NULL },
+            { "source", "mapping" }
+        };
         umock_c_reset_all_calls();
 
-		STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the structure and the edits*/
+            .IgnoreArgument(1);
 
         ///act
-        const CONSTBUFFER* content = Message_GetContent(msg);
+        MESSAGE_HANDLE r = Message_CloneWithPropertyEdits(aMessage, edits, sizeof(edits) / sizeof(edits[0]));
+        deviceName[0] = 'F';
 
         ///assert
-        ASSERT_IS_NOT_NULL(content);
-        ASSERT_ARE_EQUAL(size_t, 1, content->size);
-        ASSERT_ARE_EQUAL(int, 0, memcmp(content->buffer, &t, 1));
+        ASSERT_IS_NOT_NULL(r);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(char_ptr, "mapping", Message_GetPropertyById(r, MESSAGE_PROPERTY_SOURCE));
+        ASSERT_ARE_EQUAL(char_ptr, "firstDevice", Message_GetPropertyById(r, MESSAGE_PROPERTY_DEVICENAME));
+        ASSERT_IS_NULL(Message_GetPropertyById(r, MESSAGE_PROPERTY_MAC_ADDRESS));
+        ASSERT_ARE_EQUAL(char_ptr, "bleTelemetry", Message_GetPropertyById(aMessage, MESSAGE_PROPERTY_SOURCE));
+        ASSERT_ARE_EQUAL(void_ptr, Message_GetContent(aMessage)->buffer, Message_GetContent(r)->buffer);
 
         ///cleanup
-        Message_Destroy(msg);
+        Message_Destroy(r);
+        Message_Destroy(aMessage);
     }
 
-	/*Tests_SRS_MESSAGE_17_006: [If message is NULL then Message_GetContentHandle shall return NULL.]*/
-	TEST_FUNCTION(Message_GetContentHandle_with_NULL_message_returns_NULL)
-	{
-		///arrange
-
-		///act
-		CONSTBUFFER_HANDLE content = Message_GetContentHandle(NULL);
-
-		///assert
-		ASSERT_IS_NULL(content);
-		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-		///cleanup
-	}
-
-	/*Tests_SRS_MESSAGE_17_007: [Otherwise, Message_GetContentHandle shall shall clone and return the CONSTBUFFER_HANDLE representing the message content.]*/
-	TEST_FUNCTION(Message_GetContentHandle_with_non_NULL_message_zero_size_succeeds)
-	{
-		///arrange
-		MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c};
-		MESSAGE_HANDLE msg = Message_Create(&c);
-		umock_c_reset_all_calls();
-
-		STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
-
-		///act
-        CONSTBUFFER_HANDLE content = Message_GetContentHandle(msg);
-
-		///assert
-		ASSERT_IS_NOT_NULL(content);
-		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-		const CONSTBUFFER * contentBuffer = CONSTBUFFER_GetContent(content);
-		ASSERT_ARE_EQUAL(size_t, 0, contentBuffer->size);
-		ASSERT_IS_NULL(contentBuffer->buffer);
-
-		///cleanup
-		Message_Destroy(msg);
-		CONSTBUFFER_Destroy(content);
-
-	}
-
-	/*Tests_SRS_MESSAGE_17_007: [Otherwise, Message_GetContentHandle shall shall clone and return the CONSTBUFFER_HANDLE representing the message content.]*/
-	TEST_FUNCTION(Message_GetContentHandle_with_non_NULL_message_nonzero_size_succeeds)
-	{
-		///arrange
-		char t = '3';
-		MESSAGE_CONFIG c = { sizeof(t), (unsigned char*)&t, (MAP_HANDLE)&c};
-		MESSAGE_HANDLE msg = Message_Create(&c);
-		umock_c_reset_all_calls();
-
-		STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
-
-		///act
-        CONSTBUFFER_HANDLE content = Message_GetContentHandle(msg);
+    /*Tests_SRS_MESSAGE_13_010: [If message was itself created by Message_CloneWithPropertyEdits, the new message shall share the properties and content of the message message was created from, and apply the edits of message that edits does not override.]*/
+    TEST_FUNCTION(Message_CloneWithPropertyEdits_of_an_edited_message_combines_the_edits)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        MESSAGE_PROPERTY_EDIT edits1[] = { { "deviceName", "firstDevice" }, { "deviceKey", "key" } };
+        MESSAGE_PROPERTY_EDIT edits2[] = { { "deviceKey", NULL }, { "source", "mapping" } };
+        MESSAGE_HANDLE edited = Message_CloneWithPropertyEdits(aMessage, edits1, 2);
+        Message_Destroy(aMessage);
+        umock_c_reset_all_calls();
 
-		///assert
-		ASSERT_IS_NOT_NULL(content);
-		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ///act
+        MESSAGE_HANDLE r = Message_CloneWithPropertyEdits(edited, edits2, 2);
+        Message_Destroy(edited);
 
-		const CONSTBUFFER * contentBuffer = CONSTBUFFER_GetContent(content);
-		ASSERT_ARE_EQUAL(size_t, 1, contentBuffer->size);
-		ASSERT_ARE_EQUAL(int, 0, memcmp(contentBuffer->buffer, &t, 1));
+        ///assert
+        ASSERT_IS_NOT_NULL(r);
+        ASSERT_ARE_EQUAL(char_ptr, "firstDevice", Message_GetPropertyById(r, MESSAGE_PROPERTY_DEVICENAME));
+        ASSERT_ARE_EQUAL(char_ptr, "mapping", Message_GetPropertyById(r, MESSAGE_PROPERTY_SOURCE));
+        ASSERT_IS_NULL(Message_GetPropertyById(r, MESSAGE_PROPERTY_DEVICEKEY));
 
-		///cleanup
-		Message_Destroy(msg);
-		CONSTBUFFER_Destroy(content);
-	}
+        ///cleanup
+        Message_Destroy(r);
+    }
 
-    /*Tests_SRS_MESSAGE_02_017: [If message is NULL then Message_Destroy shall do nothing.] */
-    TEST_FUNCTION(Message_Destroy_with_NULL_argument_does_nothing)
+    /*Tests_SRS_MESSAGE_13_017: [If the ref count is zero and the message was created by Message_CloneWithPropertyEdits, Message_Destroy shall destroy the message it was created from.]*/
+    TEST_FUNCTION(Message_Destroy_of_an_edited_message_destroys_the_message_it_was_created_from)
     {
         ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        MESSAGE_PROPERTY_EDIT edits[] = { { "source", "mapping" } };
+        MESSAGE_HANDLE r = Message_CloneWithPropertyEdits(aMessage, edits, 1);
+        Message_Destroy(aMessage);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is aMessage*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is r*/
+            .IgnoreArgument(1);
 
         ///act
-        Message_Destroy(NULL);
+        Message_Destroy(r);
 
         ///assert
-        
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
     }
 
-    /*Tests_SRS_MESSAGE_02_020: [Otherwise, Message_Destroy shall decrement the internal ref count of the message.] 
-    /*Tests_SRS_MESSAGE_02_021: [If the ref count is zero then the allocated resources are freed.]*/
-	/*Tests_SRS_MESSAGE_17_002: [Message_Destroy shall destroy the CONSTMAP properties.]*/
-	/*Tests_SRS_MESSAGE_17_005: [Message_Destroy shall destroy the CONSTBUFFER.]*/
-    TEST_FUNCTION(Message_Destroy_happy_path)
+    /*Tests_SRS_MESSAGE_13_016: [If the message was created by Message_CloneWithPropertyEdits, the CONSTMAP shall hold the properties of the message it was created from, as edited.]*/
+    TEST_FUNCTION(Message_GetProperties_of_an_edited_message_merges_the_edits)
     {
         ///arrange
-        char t = '3';
-        MESSAGE_CONFIG c = { sizeof(t), (unsigned char*)&t, (MAP_HANDLE)&c };
-        MESSAGE_HANDLE msg = Message_Create(&c);
+        const char* keys[] = { "macAddress", "somethingExtra" };
+        const char* values[] = { "01:01:01:01:01:01", "blue" };
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        currentMap_keys = keys;
+        currentMap_values = values;
+        currentMap_count = 2;
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        MESSAGE_PROPERTY_EDIT edits[] = { { "macAddress", NULL }, { "source", "mapping" } };
+        MESSAGE_HANDLE r = Message_CloneWithPropertyEdits(aMessage, edits, 2);
         umock_c_reset_all_calls();
 
-		STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG)) /*this is the map*/
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG)) /*this is the buffer*/
-			.IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the handle*/
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "somethingExtra", "blue"));
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "source", "mapping"));
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
 
         ///act
-        Message_Destroy(msg);
+        CONSTMAP_HANDLE properties = Message_GetProperties(r);
 
         ///assert
+        ASSERT_IS_NOT_NULL(properties);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        ConstMap_Destroy(properties);
+        Message_Destroy(r);
+        Message_Destroy(aMessage);
     }
 
-    /*Tests_SRS_MESSAGE_02_022: [ If source is NULL then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_with_NULL_source_fails)
+    /*Tests_SRS_MESSAGE_13_018: [If the message was created by Message_CloneWithPropertyEdits, Message_ToByteArray shall serialize the properties of the message it was created from, as edited.]*/
+    TEST_FUNCTION(Message_ToByteArray_of_an_edited_message_serializes_the_edits)
     {
         ///arrange
+        const unsigned char expected[] =
+        {
+            0xA1, 0x60,             /*header*/
+            0x00, 0x00, 0x00, 18,   /*size of byte array*/
+            0x00, 0x00, 0x00, 0x01, /*one property*/
+            'a', '\0', 'b', '\0',
+            0x00, 0x00, 0x00, 0x00  /*no content*/
+        };
+        unsigned char buf[sizeof(expected)];
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        MESSAGE_PROPERTY_EDIT edits[] = { { "a", "b" }, { "c", NULL } };
+        MESSAGE_HANDLE r = Message_CloneWithPropertyEdits(aMessage, edits, 2);
+        umock_c_reset_all_calls();
 
         ///act
-        
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(NULL, 1);
+        int32_t nbytes = Message_ToByteArray(r, buf, sizeof(buf));
 
         ///assert
-
-        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(int32_t, sizeof(expected), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, expected, sizeof(expected)));
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-        
-        ///cleanup
 
+        ///cleanup
+        Message_Destroy(r);
+        Message_Destroy(aMessage);
     }
 
-
-
-    /*Tests_SRS_MESSAGE_02_023: [ If source is not NULL and and size parameter is smaller than 14 then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_with_13_size_fails)
+    /*Tests_SRS_MESSAGE_02_011: [If message is NULL then Message_GetProperties shall return NULL.] */
+    TEST_FUNCTION(Message_GetProperties_with_NULL_messageHandle_returns_NULL)
     {
         ///arrange
+        umock_c_reset_all_calls();
 
         ///act
-
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage, 13);
+        CONSTMAP_HANDLE r = Message_GetProperties(NULL);
 
         ///assert
-
-        ASSERT_IS_NULL(handle);
+        ASSERT_IS_NULL(r);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
     }
 
-    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
-    /*Tests_SRS_MESSAGE_02_026: [ A MAP_HANDLE shall be created. ]*/
-    /*Tests_SRS_MESSAGE_02_028: [ A structure of type MESSAGE_CONFIG shall be populated with the MAP_HANDLE previously constructed and the message content ]*/
-    /*Tests_SRS_MESSAGE_02_029: [ A MESSAGE_HANDLE shall be constructed from the MESSAGE_CONFIG. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_notFail____minimalMessage)
+    /*Tests_SRS_MESSAGE_02_012: [Otherwise, the first call to Message_GetProperties shall build a CONSTMAP holding copies of the properties of the message and keep it in the message.]*/
+    /*Tests_SRS_MESSAGE_13_068: [Message_GetProperties shall return a clone of the CONSTMAP kept in the message, obtained by calling ConstMap_Clone.]*/
+    TEST_FUNCTION(Message_GetProperties_happy_path)
     {
-
         ///arrange
+        const char* keys[] = { "macAddress", "somethingExtra" };
+        const char* values[] = { "01:01:01:01:01:01", "blue" };
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        currentMap_keys = keys;
+        currentMap_values = values;
+        currentMap_count = 2;
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        umock_c_reset_all_calls();
 
         STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
             .IgnoreArgument_mapFilterFunc()
             .SetReturn(TEST_MAP_HANDLE);
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(notFail____minimalMessage + 14, 0));
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "macAddress", "01:01:01:01:01:01"));
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "somethingExtra", "blue"));
         STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
-        
+        CONSTMAP_HANDLE theProperties = Message_GetProperties(aMessage);
+
         ///assert
-        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_IS_NOT_NULL(theProperties);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        Message_Destroy(handle);
+        Message_Destroy(aMessage);
+		ConstMap_Destroy(theProperties);
     }
 
-    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
-    /*Tests_SRS_MESSAGE_02_027: [ All the properties of the byte array shall be added to the MAP_HANDLE. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_notFail__1Property_0bytes)
+    /*Tests_SRS_MESSAGE_13_067: [If building the CONSTMAP fails, Message_GetProperties shall return NULL.]*/
+    TEST_FUNCTION(Message_GetProperties_fails_when_ConstMap_Create_fails)
     {
-
         ///arrange
+        const char* keys[] = { "color" };
+        const char* values[] = { "blue" };
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        currentMap_keys = keys;
+        currentMap_values = values;
+        currentMap_count = 1;
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        umock_c_reset_all_calls();
 
+        whenShallConstMap_Create_fail = currentConstMap_Create_call + 1;
         STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
             .IgnoreArgument_mapFilterFunc()
             .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "3", "3"))
-            .SetReturn(MAP_OK);
-
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument_source();
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "color", "blue"));
         STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__1Property_0bytes, sizeof(notFail__1Property_0bytes));
+        CONSTMAP_HANDLE theProperties = Message_GetProperties(aMessage);
 
         ///assert
-        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_IS_NULL(theProperties);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        Message_Destroy(handle);
+        Message_Destroy(aMessage);
     }
 
-    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_notFail__2Property_0bytes)
+    /*Tests_SRS_MESSAGE_13_068: [Message_GetProperties shall return a clone of the CONSTMAP kept in the message, obtained by calling ConstMap_Clone.]*/
+    TEST_FUNCTION(Message_GetProperties_called_again_clones_the_kept_CONSTMAP)
     {
-
         ///arrange
+        const char* keys[] = { "color" };
+        const char* values[] = { "blue" };
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        currentMap_keys = keys;
+        currentMap_values = values;
+        currentMap_count = 1;
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        CONSTMAP_HANDLE first = Message_GetProperties(aMessage);
+        umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "3", "3"))
-            .SetReturn(MAP_OK);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "ab", "a"))
-            .SetReturn(MAP_OK);
-
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_Clone(first));
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__2Property_0bytes, sizeof(notFail__2Property_0bytes));
+        CONSTMAP_HANDLE second = Message_GetProperties(aMessage);
 
         ///assert
-        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)first, (void*)second);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        Message_Destroy(handle);
+        ConstMap_Destroy(second);
+        ConstMap_Destroy(first);
+        Message_Destroy(aMessage);
     }
 
-    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_notFail__0Property_1bytes)
+    /*Tests_SRS_MESSAGE_13_069: [If the message was created by MessageBatch_AddContent, Message_GetProperties shall use the CONSTMAP of the message holding the shared properties of the batch.]*/
+    TEST_FUNCTION(Message_GetProperties_of_batch_messages_share_one_CONSTMAP)
     {
-
         ///arrange
+        const char* keys[] = { "color" };
+        const char* values[] = { "blue" };
+        char t = '3';
+        currentMap_keys = keys;
+        currentMap_values = values;
+        currentMap_count = 1;
+        MESSAGE_BATCH_HANDLE batch = MessageBatch_Create((MAP_HANDLE)&t);
+        (void)MessageBatch_AddContent(batch, (const unsigned char*)&t, sizeof(t));
+        (void)MessageBatch_AddContent(batch, (const unsigned char*)&t, sizeof(t));
+        CONSTMAP_HANDLE first = Message_GetProperties(MessageBatch_GetMessages(batch)[0]);
+        umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 1))
-            .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_Clone(first));
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__0Property_1bytes, sizeof(notFail__0Property_1bytes));
+        CONSTMAP_HANDLE second = Message_GetProperties(MessageBatch_GetMessages(batch)[1]);
 
         ///assert
-        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)first, (void*)second);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        Message_Destroy(handle);
+        ConstMap_Destroy(second);
+        ConstMap_Destroy(first);
+        MessageBatch_Destroy(batch);
     }
 
-    
-    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_notFail__1Property_1bytes)
+    /*Tests_SRS_MESSAGE_13_071: [If the ref count is zero, Message_Destroy shall destroy the CONSTMAP kept by Message_GetProperties.]*/
+    TEST_FUNCTION(Message_Destroy_destroys_the_CONSTMAP_kept_by_Message_GetProperties)
     {
-
         ///arrange
+        const char* keys[] = { "color" };
+        const char* values[] = { "blue" };
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        currentMap_keys = keys;
+        currentMap_values = values;
+        currentMap_count = 1;
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        CONSTMAP_HANDLE properties = Message_GetProperties(aMessage);
+        umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
-
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 1))
-            .ValidateArgumentBuffer(1, "3", 1);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_Destroy(properties));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__1Property_1bytes, sizeof(notFail__1Property_1bytes));
+        Message_Destroy(aMessage);
 
         ///assert
-        ASSERT_IS_NOT_NULL(handle);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        Message_Destroy(handle);
+        ConstMap_Destroy(properties);
     }
 
-    
-    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_notFail__2Property_1bytes)
+    /*Tests_SRS_MESSAGE_13_005: [If message is NULL then Message_GetPropertyById shall return NULL.]*/
+    TEST_FUNCTION(Message_GetPropertyById_with_NULL_message_returns_NULL)
     {
-
         ///arrange
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "BleedingEdge", "rocks"));
-
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 1))
-            .ValidateArgumentBuffer(1, "3", 1);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
-
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__2Property_1bytes, sizeof(notFail__2Property_1bytes));
+        const char* value = Message_GetPropertyById(NULL, MESSAGE_PROPERTY_SOURCE);
 
         ///assert
-        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_IS_NULL(value);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        Message_Destroy(handle);
     }
 
-    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_notFail__0Property_2bytes)
+    /*Tests_SRS_MESSAGE_13_006: [If id is not a well-known property then Message_GetPropertyById shall return NULL.]*/
+    TEST_FUNCTION(Message_GetPropertyById_with_invalid_id_returns_NULL)
     {
-
         ///arrange
-
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
-            .ValidateArgumentBuffer(1, "34", 2);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        umock_c_reset_all_calls();
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__0Property_2bytes, sizeof(notFail__0Property_2bytes));
+        const char* value = Message_GetPropertyById(aMessage, MESSAGE_PROPERTY_ID_COUNT);
 
         ///assert
-        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_IS_NULL(value);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        Message_Destroy(handle);
+        Message_Destroy(aMessage);
     }
 
-    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_notFail__1Property_2bytes)
+    /*Tests_SRS_MESSAGE_13_003: [Message_Create, Message_CreateFromBuffer and Message_CreateFromByteArray shall get the properties of sourceProperties by calling Map_GetInternals.]*/
+    /*Tests_SRS_MESSAGE_13_007: [Otherwise, Message_GetPropertyById shall return the value of the property, or NULL if the message does not have it, without copying the properties of the message.]*/
+    TEST_FUNCTION(Message_GetPropertyById_returns_well_known_properties)
     {
-
         ///arrange
-
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
-            .ValidateArgumentBuffer(1, "34", 2);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        const char* keys[] = { "somethingElse", "deviceName", "source" };
+        const char* values[] = { "blue", "firstDevice", "mapping" };
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        currentMap_keys = keys;
+        currentMap_values = values;
+        currentMap_count = 3;
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        umock_c_reset_all_calls();
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__1Property_2bytes, sizeof(notFail__1Property_2bytes));
+        const char* source = Message_GetPropertyById(aMessage, MESSAGE_PROPERTY_SOURCE);
+        const char* deviceName = Message_GetPropertyById(aMessage, MESSAGE_PROPERTY_DEVICENAME);
+        const char* deviceKey = Message_GetPropertyById(aMessage, MESSAGE_PROPERTY_DEVICEKEY);
 
         ///assert
-        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, "mapping", source);
+        ASSERT_ARE_NOT_EQUAL(void_ptr, values[2], source);
+        ASSERT_ARE_EQUAL(char_ptr, "firstDevice", deviceName);
+        ASSERT_IS_NULL(deviceKey);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        Message_Destroy(handle);
+        Message_Destroy(aMessage);
     }
 
-    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_notFail__2Property_2bytes)
+    /*Tests_SRS_MESSAGE_13_063: [If message or key is NULL then Message_GetProperty shall return NULL.]*/
+    TEST_FUNCTION(Message_GetProperty_with_NULL_message_returns_NULL)
     {
-
         ///arrange
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "BleedingEdge", "rocks"));
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
-            .ValidateArgumentBuffer(1, "34", 2);
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
-
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        const char* value = Message_GetProperty(NULL, "deviceName");
 
         ///assert
-        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_IS_NULL(value);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        Message_Destroy(handle);
     }
 
-    /*Tests_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_when_first_byte_is_not_0xA1_fails)
+    /*Tests_SRS_MESSAGE_13_063: [If message or key is NULL then Message_GetProperty shall return NULL.]*/
+    TEST_FUNCTION(Message_GetProperty_with_NULL_key_returns_NULL)
     {
-
         ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        umock_c_reset_all_calls();
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_____firstByteNot0xA1, sizeof(fail_____firstByteNot0xA1));
+        const char* value = Message_GetProperty(aMessage, NULL);
 
         ///assert
-        ASSERT_IS_NULL(handle);
+        ASSERT_IS_NULL(value);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        Message_Destroy(aMessage);
     }
 
-    /*Tests_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_when_second_byte_is_not_0x60_fails)
+    /*Tests_SRS_MESSAGE_13_065: [Otherwise Message_GetProperty shall search the properties of the message for key, without copying them, and return its value, or NULL if the message does not have it.]*/
+    TEST_FUNCTION(Message_GetProperty_returns_the_value_of_the_property)
     {
-
         ///arrange
+        const char* keys[] = { "somethingElse", "deviceName" };
+        const char* values[] = { "blue", "firstDevice" };
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        currentMap_keys = keys;
+        currentMap_values = values;
+        currentMap_count = 2;
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        umock_c_reset_all_calls();
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail____secondByteNot0x60, sizeof(fail____secondByteNot0x60));
+        const char* somethingElse = Message_GetProperty(aMessage, "somethingElse");
+        const char* deviceKey = Message_GetProperty(aMessage, "deviceKey");
 
         ///assert
-        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, "blue", somethingElse);
+        ASSERT_IS_NULL(deviceKey);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        Message_Destroy(aMessage);
     }
 
-    /*Tests_SRS_MESSAGE_02_037: [ If the size embedded in the message is not the same as size parameter then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    
-    TEST_FUNCTION(Message_CreateFromByteArray_when_message_sizes_not_math_fails)
+    /*Tests_SRS_MESSAGE_13_064: [If the message was created by Message_CloneWithPropertyEdits and key is edited, Message_GetProperty shall return the value of the edit.]*/
+    TEST_FUNCTION(Message_GetProperty_returns_the_edited_value)
     {
         ///arrange
+        const char* keys[] = { "somethingElse", "color" };
+        const char* values[] = { "blue", "red" };
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        currentMap_keys = keys;
+        currentMap_values = values;
+        currentMap_count = 2;
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        MESSAGE_PROPERTY_EDIT edits[] = { { "somethingElse", "green" }, { "color", NULL } };
+        MESSAGE_HANDLE edited = Message_CloneWithPropertyEdits(aMessage, edits, 2);
+        umock_c_reset_all_calls();
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage,1+ sizeof(notFail____minimalMessage));
+        const char* somethingElse = Message_GetProperty(edited, "somethingElse");
+        const char* color = Message_GetProperty(edited, "color");
 
         ///assert
-        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, "green", somethingElse);
+        ASSERT_IS_NULL(color);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        Message_Destroy(edited);
+        Message_Destroy(aMessage);
     }
 
-    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_with_1_property_when_1st_property_doesnt_end_fails)
+    /*Tests_SRS_MESSAGE_02_013: [If message is NULL then Message_GetContent shall return NULL.] */
+    TEST_FUNCTION(Message_GetContent_with_NULL_message_returns_NULL)
     {
         ///arrange
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        const CONSTBUFFER* content = Message_GetContent(NULL);
+
+        ///assert
+        ASSERT_IS_NULL(content);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_014: [Otherwise, Message_GetContent shall return a non-NULL const pointer to a structure of type CONSTBUFFER.]*/
+    /*Tests_SRS_MESSAGE_02_015: [The MESSAGE_CONTENT's field size shall have the same value as the cfg's field size.]*/
+    /*Tests_SRS_MESSAGE_02_016: [The MESSAGE_CONTENT's field data shall compare equal byte-by-byte to the cfg's field source.]*/
+    TEST_FUNCTION(Message_GetContent_with_non_NULL_message_zero_size_succeeds)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c};
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        ///act
+        const CONSTBUFFER* content = Message_GetContent(msg);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(content);
+        ASSERT_ARE_EQUAL(size_t, 0, content->size);
+        ASSERT_IS_NULL(content->buffer);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
+    /*Tests_SRS_MESSAGE_02_014: [Otherwise, Message_GetContent shall return a non-NULL const pointer to a structure of type CONSTBUFFER.]*/
+    /*Tests_SRS_MESSAGE_02_015: [The MESSAGE_CONTENT's field size shall have the same value as the cfg's field size.]*/
+    /*Tests_SRS_MESSAGE_02_016: [The MESSAGE_CONTENT's field data shall compare equal byte-by-byte to the cfg's field source.]*/
+    TEST_FUNCTION(Message_GetContent_with_non_NULL_message_nonzero_size_succeeds)
+    {
+        ///arrange
+        char t ='3';
+        MESSAGE_CONFIG c = { sizeof(t), (unsigned char*)&t, (MAP_HANDLE)&c};
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        ///act
+        const CONSTBUFFER* content = Message_GetContent(msg);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(content);
+        ASSERT_ARE_EQUAL(size_t, 1, content->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(content->buffer, &t, 1));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
+	/*Tests_SRS_MESSAGE_17_006: [If message is NULL then Message_GetContentHandle shall return NULL.]*/
+	TEST_FUNCTION(Message_GetContentHandle_with_NULL_message_returns_NULL)
+	{
+		///arrange
+
+		///act
+		CONSTBUFFER_HANDLE content = Message_GetContentHandle(NULL);
+
+		///assert
+		ASSERT_IS_NULL(content);
+		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+		///cleanup
+	}
+
+	/*Tests_SRS_MESSAGE_13_002: [Otherwise, Message_GetContentHandle shall return a new CONSTBUFFER_HANDLE holding a copy of the message content.]*/
+	TEST_FUNCTION(Message_GetContentHandle_with_non_NULL_message_zero_size_succeeds)
+	{
+		///arrange
+		MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c};
+		MESSAGE_HANDLE msg = Message_Create(&c);
+		umock_c_reset_all_calls();
+
+		STRICT_EXPECTED_CALL(CONSTBUFFER_Create(NULL, 0));
+
+		///act
+        CONSTBUFFER_HANDLE content = Message_GetContentHandle(msg);
+
+		///assert
+		ASSERT_IS_NOT_NULL(content);
+		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+		const CONSTBUFFER * contentBuffer = CONSTBUFFER_GetContent(content);
+		ASSERT_ARE_EQUAL(size_t, 0, contentBuffer->size);
+		ASSERT_IS_NULL(contentBuffer->buffer);
+
+		///cleanup
+		Message_Destroy(msg);
+		CONSTBUFFER_Destroy(content);
+
+	}
+
+	/*Tests_SRS_MESSAGE_13_002: [Otherwise, Message_GetContentHandle shall return a new CONSTBUFFER_HANDLE holding a copy of the message content.]*/
+	TEST_FUNCTION(Message_GetContentHandle_with_non_NULL_message_nonzero_size_succeeds)
+	{
+		///arrange
+		char t = '3';
+		MESSAGE_CONFIG c = { sizeof(t), (unsigned char*)&t, (MAP_HANDLE)&c};
+		MESSAGE_HANDLE msg = Message_Create(&c);
+		umock_c_reset_all_calls();
+
+		STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 1))
+			.IgnoreArgument(1);
+
+		///act
+        CONSTBUFFER_HANDLE content = Message_GetContentHandle(msg);
+
+		///assert
+		ASSERT_IS_NOT_NULL(content);
+		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+		const CONSTBUFFER * contentBuffer = CONSTBUFFER_GetContent(content);
+		ASSERT_ARE_EQUAL(size_t, 1, contentBuffer->size);
+		ASSERT_ARE_EQUAL(int, 0, memcmp(contentBuffer->buffer, &t, 1));
+
+		///cleanup
+		Message_Destroy(msg);
+		CONSTBUFFER_Destroy(content);
+	}
+
+	/*Tests_SRS_MESSAGE_17_007: [If the message was created by Message_CreateFromBuffer, Message_GetContentHandle shall clone and return the CONSTBUFFER_HANDLE representing the message content.]*/
+	TEST_FUNCTION(Message_GetContentHandle_with_message_from_buffer_clones_the_buffer)
+	{
+		///arrange
+		unsigned char fake = '3';
+		CONSTBUFFER_HANDLE buffer = CONSTBUFFER_Create(&fake, 1);
+		MESSAGE_BUFFER_CONFIG cfg =
+		{
+			buffer,
+			(MAP_HANDLE)&fake
+		};
+		MESSAGE_HANDLE msg = Message_CreateFromBuffer(&cfg);
+		umock_c_reset_all_calls();
+
+		STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(buffer));
+
+		///act
+		CONSTBUFFER_HANDLE content = Message_GetContentHandle(msg);
+
+		///assert
+		ASSERT_ARE_EQUAL(void_ptr, buffer, content);
+		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+		///cleanup
+		Message_Destroy(msg);
+		CONSTBUFFER_Destroy(content);
+		CONSTBUFFER_Destroy(buffer);
+	}
+
+    /*Tests_SRS_MESSAGE_02_017: [If message is NULL then Message_Destroy shall do nothing.] */
+    TEST_FUNCTION(Message_Destroy_with_NULL_argument_does_nothing)
+    {
+        ///arrange
+
+        ///act
+        Message_Destroy(NULL);
+
+        ///assert
+        
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_020: [Otherwise, Message_Destroy shall decrement the internal ref count of the message.] 
+    /*Tests_SRS_MESSAGE_02_021: [If the ref count is zero then the allocated resources are freed.]*/
+    TEST_FUNCTION(Message_Destroy_happy_path)
+    {
+        ///arrange
+        char t = '3';
+        MESSAGE_CONFIG c = { sizeof(t), (unsigned char*)&t, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the handle, the content and the properties*/
+            .IgnoreArgument(1);
+
+        ///act
+        Message_Destroy(msg);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+	/*Tests_SRS_MESSAGE_17_005: [If the ref count is zero and the message was created by Message_CreateFromBuffer, Message_Destroy shall destroy the CONSTBUFFER.]*/
+	TEST_FUNCTION(Message_Destroy_with_message_from_buffer_destroys_the_buffer)
+	{
+		///arrange
+		unsigned char fake = '3';
+		CONSTBUFFER_HANDLE buffer = CONSTBUFFER_Create(&fake, 1);
+		MESSAGE_BUFFER_CONFIG cfg =
+		{
+			buffer,
+			(MAP_HANDLE)&fake
+		};
+		MESSAGE_HANDLE msg = Message_CreateFromBuffer(&cfg);
+		umock_c_reset_all_calls();
+
+		STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(buffer)); /*this is the buffer*/
+		STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the handle and the properties*/
+			.IgnoreArgument(1);
+
+		///act
+		Message_Destroy(msg);
+
+		///assert
+		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+		///cleanup
+		CONSTBUFFER_Destroy(buffer);
+	}
+
+    /*Tests_SRS_MESSAGE_02_022: [ If source is NULL then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_with_NULL_source_fails)
+    {
+        ///arrange
+
+        ///act
+        
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(NULL, 1);
+
+        ///assert
+
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        
+        ///cleanup
+
+    }
+
+
+
+    /*Tests_SRS_MESSAGE_02_023: [ If source is not NULL and and size parameter is smaller than 14 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_with_13_size_fails)
+    {
+        ///arrange
+
+        ///act
+
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage, 13);
+
+        ///assert
+
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
+    /*Tests_SRS_MESSAGE_02_026: [ A MAP_HANDLE shall be created. ]*/
+    /*Tests_SRS_MESSAGE_02_028: [ A structure of type MESSAGE_CONFIG shall be populated with the MAP_HANDLE previously constructed and the message content ]*/
+    /*Tests_SRS_MESSAGE_02_029: [ A MESSAGE_HANDLE shall be constructed from the MESSAGE_CONFIG. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_notFail____minimalMessage)
+    {
+
+        ///arrange
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+        
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
+    /*Tests_SRS_MESSAGE_02_027: [ All the properties of the byte array shall be added to the MAP_HANDLE. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_notFail__1Property_0bytes)
+    {
+
+        ///arrange
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "3", "3"))
+            .SetReturn(MAP_OK);
+
+        STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__1Property_0bytes, sizeof(notFail__1Property_0bytes));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_notFail__2Property_0bytes)
+    {
+
+        ///arrange
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "3", "3"))
+            .SetReturn(MAP_OK);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "ab", "a"))
+            .SetReturn(MAP_OK);
+
+        STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__2Property_0bytes, sizeof(notFail__2Property_0bytes));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_notFail__0Property_1bytes)
+    {
+
+        ///arrange
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+
+        STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__0Property_1bytes, sizeof(notFail__0Property_1bytes));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    
+    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_notFail__1Property_1bytes)
+    {
+
+        ///arrange
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
+
+        STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__1Property_1bytes, sizeof(notFail__1Property_1bytes));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 1, Message_GetContent(handle)->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(Message_GetContent(handle)->buffer, "3", 1));
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    
+    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_notFail__2Property_1bytes)
+    {
+
+        ///arrange
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "BleedingEdge", "rocks"));
+
+        STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__2Property_1bytes, sizeof(notFail__2Property_1bytes));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 1, Message_GetContent(handle)->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(Message_GetContent(handle)->buffer, "3", 1));
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_notFail__0Property_2bytes)
+    {
+
+        ///arrange
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+
+        STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__0Property_2bytes, sizeof(notFail__0Property_2bytes));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 2, Message_GetContent(handle)->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(Message_GetContent(handle)->buffer, "34", 2));
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_notFail__1Property_2bytes)
+    {
+
+        ///arrange
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
+        STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__1Property_2bytes, sizeof(notFail__1Property_2bytes));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 2, Message_GetContent(handle)->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(Message_GetContent(handle)->buffer, "34", 2));
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_notFail__2Property_2bytes)
+    {
+
+        ///arrange
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "BleedingEdge", "rocks"));
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
+        STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 2, Message_GetContent(handle)->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(Message_GetContent(handle)->buffer, "34", 2));
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_when_first_byte_is_not_0xA1_fails)
+    {
+
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_____firstByteNot0xA1, sizeof(fail_____firstByteNot0xA1));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_when_second_byte_is_not_0x60_fails)
+    {
+
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail____secondByteNot0x60, sizeof(fail____secondByteNot0x60));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_037: [ If the size embedded in the message is not the same as size parameter then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    
+    TEST_FUNCTION(Message_CreateFromByteArray_when_message_sizes_not_math_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage,1+ sizeof(notFail____minimalMessage));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_with_1_property_when_1st_property_doesnt_end_fails)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
         MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_firstPropertyNameTooBig, sizeof(fail_firstPropertyNameTooBig));
@@ -1549,18 +2148,399 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         ///cleanup
     }
 
-    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_with_1_property_when_1st_property_value_doesnt_start_fails)
+    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_with_1_property_when_1st_property_value_doesnt_start_fails)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_firstPropertyValueDoesNotExist, sizeof(fail_firstPropertyValueDoesNotExist));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+    
+    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_with_1_property_when_1st_property_value_doesnt_end_fails)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_firstPropertyValueDoesNotEnd, sizeof(fail_firstPropertyValueDoesNotEnd));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_with_1_byte_of_content_size_fails)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsOnly1ByteOfcontentSize, sizeof(fail_whenThereIsOnly1ByteOfcontentSize));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_with_2_byte_of_content_size_fails)
+    {
+        ///arrange
+
+        const unsigned char fail_whenThereIsOnly2ByteOfcontentSize[] =
+        {
+            0xA1, 0x60,             /*header*/
+            0x00, 0x00, 0x00, 20,   /*size of this array*/
+            0x00, 0x00, 0x00, 0x01, /*one property*/
+            '3', '3', '3', '\0',
+            '3', '3', '3', '\0',
+            0x00, 0x00              /*not enough bytes for contentSize*/
+        };
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsOnly2ByteOfcontentSize, sizeof(fail_whenThereIsOnly2ByteOfcontentSize));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_with_3_byte_of_content_size_fails)
+    {
+        ///arrange
+
+        const unsigned char fail_whenThereIsOnly3ByteOfcontentSize[] =
+        {
+            0xA1, 0x60,             /*header*/
+            0x00, 0x00, 0x00, 21,   /*size of this array*/
+            0x00, 0x00, 0x00, 0x01, /*one property*/
+            '3', '3', '3', '\0',
+            '3', '3', '3', '\0',
+            0x00, 0x00, 0x00        /*not enough bytes for contentSize*/
+        };
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsOnly3ByteOfcontentSize, sizeof(fail_whenThereIsOnly3ByteOfcontentSize));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_with_1_byte_of_content_size_but_no_content_fails)
+    {
+        ///arrange
+
+        const unsigned char fail_whenThereIsNotEnoughContent[] =
+        {
+            0xA1, 0x60,             /*header*/
+            0x00, 0x00, 0x00, 22,   /*size of this array*/
+            0x00, 0x00, 0x00, 0x01, /*one property*/
+            '3', '3', '3', '\0',
+            '3', '3', '3', '\0',
+            0x00, 0x00, 0x00, 0x01  /*no further content*/
+        };
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsNotEnoughContent, sizeof(fail_whenThereIsNotEnoughContent));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_with_1_byte_of_content_size_but_2_bytes_of_content_fails)
+    {
+        ///arrange
+
+        const unsigned char fail_whenThereIsTooMuchContent[] =
+        {
+            0xA1, 0x60,             /*header*/
+            0x00, 0x00, 0x00, 24,   /*size of this array*/
+            0x00, 0x00, 0x00, 0x01, /*one property*/
+            '3', '3', '3', '\0',
+            '3', '3', '3', '\0',
+            0x00, 0x00, 0x00, 0x01,  /*no further content*/
+            '3', '3'
+        };
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsTooMuchContent, sizeof(fail_whenThereIsTooMuchContent));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_fails_when_Map_Create_fails)
+    {
+        ///arrange
+
+        const unsigned char notFail____minimalMessage[] =
+        {
+            0xA1, 0x60,             /*header*/
+            0x00, 0x00, 0x00, 14,   /*size of this array*/
+            0x00, 0x00, 0x00, 0x00, /*zero properties*/
+            0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+        };
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(NULL);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_fails_when_numberOfProperties_is_negative)
+    {
+        ///arrange
+
+        const unsigned char notFail____minimalMessage[] =
+        {
+            0xA1, 0x60,             /*header*/
+            0x00, 0x00, 0x00, 14,   /*size of this array*/
+            0xFF, 0xFF, 0xFF, 0xFF, /*-1 properties*/
+            0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+        };
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_fails_when_numberOfProperties_is_int32_max)
+    {
+        ///arrange
+
+        const unsigned char notFail____minimalMessage[] =
+        {
+            0xA1, 0x60,             /*header*/
+            0x00, 0x00, 0x00, 14,   /*size of this array*/
+            0x7F, 0xFF, 0xFF, 0xFF, /*INT32_MAX properties*/
+            0x00, 0x00, 0x00, 0x00  /*zero message content size*/
+        };
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_fails_when_Map_Add_fails)
+    {
+
+        ///arrange
+
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "3", "3"))
+            .SetReturn(MAP_ERROR);
+
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__1Property_0bytes, sizeof(notFail__1Property_0bytes));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_13_034: [ If source is not NULL and size parameter is smaller than 6 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_with_5_size_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage_v2, 5);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_13_035: [ If the first two bytes of source are 0xA1 0x61 then Message_CreateFromByteArray shall parse source as a version 2 serialization and fail and return NULL if it is not valid. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_notFail____minimalMessage_v2)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage_v2, sizeof(notFail____minimalMessage_v2));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, Message_GetContent(handle)->size);
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_13_035: [ If the first two bytes of source are 0xA1 0x61 then Message_CreateFromByteArray shall parse source as a version 2 serialization and fail and return NULL if it is not valid. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_notFail__2Property_2bytes_v2)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "BleedingEdge", "rocks"));
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
+        STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__2Property_2bytes_v2, sizeof(notFail__2Property_2bytes_v2));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 2, Message_GetContent(handle)->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(Message_GetContent(handle)->buffer, "34", 2));
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_13_035: [ If the first two bytes of source are 0xA1 0x61 then Message_CreateFromByteArray shall parse source as a version 2 serialization and fail and return NULL if it is not valid. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_v2_when_message_sizes_not_match_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__2Property_2bytes_v2, sizeof(notFail__2Property_2bytes_v2) - 1);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_13_035: [ If the first two bytes of source are 0xA1 0x61 then Message_CreateFromByteArray shall parse source as a version 2 serialization and fail and return NULL if it is not valid. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_v2_with_offset_out_of_range_fails)
     {
         ///arrange
         STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
             .IgnoreArgument_mapFilterFunc()
             .SetReturn(TEST_MAP_HANDLE);
-
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "BleedingEdge", "rocks"));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_firstPropertyValueDoesNotExist, sizeof(fail_firstPropertyValueDoesNotExist));
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_v2_secondPropertyOffsetOutOfRange, sizeof(fail_v2_secondPropertyOffsetOutOfRange));
 
         ///assert
         ASSERT_IS_NULL(handle);
@@ -1568,588 +2548,882 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
         ///cleanup
     }
-    
-    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_with_1_property_when_1st_property_value_doesnt_end_fails)
+
+    /*Tests_SRS_MESSAGE_13_019: [If source is NULL, size is smaller than 6, or source is not a version 2 serialization and size is smaller than 14, then Message_CreateFromByteArrayNoCopy shall fail and return NULL.]*/
+    TEST_FUNCTION(Message_CreateFromByteArrayNoCopy_with_NULL_source_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArrayNoCopy(NULL, 14, test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, test_release_calls);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_13_019: [If source is NULL, size is smaller than 6, or source is not a version 2 serialization and size is smaller than 14, then Message_CreateFromByteArrayNoCopy shall fail and return NULL.]*/
+    TEST_FUNCTION(Message_CreateFromByteArrayNoCopy_with_13_size_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArrayNoCopy(notFail____minimalMessage, 13, test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_13_020: [If the first two bytes of source are not 0xA1 0x60, the size embedded in the message is not size, or parsing the properties or the content would read past the end of the array, then Message_CreateFromByteArrayNoCopy shall fail and return NULL.]*/
+    TEST_FUNCTION(Message_CreateFromByteArrayNoCopy_when_first_byte_is_not_0xA1_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArrayNoCopy(fail_____firstByteNot0xA1, sizeof(fail_____firstByteNot0xA1), test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_13_020: [If the first two bytes of source are not 0xA1 0x60, the size embedded in the message is not size, or parsing the properties or the content would read past the end of the array, then Message_CreateFromByteArrayNoCopy shall fail and return NULL.]*/
+    TEST_FUNCTION(Message_CreateFromByteArrayNoCopy_when_message_sizes_not_match_fails)
+    {
+        ///arrange
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArrayNoCopy(notFail____minimalMessage, 1 + sizeof(notFail____minimalMessage), test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_13_020: [If the first two bytes of source are not 0xA1 0x60, the size embedded in the message is not size, or parsing the properties or the content would read past the end of the array, then Message_CreateFromByteArrayNoCopy shall fail and return NULL.]*/
+    /*Tests_SRS_MESSAGE_13_026: [On failure, Message_CreateFromByteArrayNoCopy shall not call release.]*/
+    TEST_FUNCTION(Message_CreateFromByteArrayNoCopy_with_1_property_when_1st_property_doesnt_end_fails)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArrayNoCopy(fail_firstPropertyNameTooBig, sizeof(fail_firstPropertyNameTooBig), test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, test_release_calls);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_13_036: [If the first two bytes of source are 0xA1 0x61 then Message_CreateFromByteArrayNoCopy shall parse source as a version 2 serialization and fail and return NULL if it is not valid.]*/
+    TEST_FUNCTION(Message_CreateFromByteArrayNoCopy_v2_happy_path)
+    {
+        ///arrange
+        unsigned char serialized[sizeof(notFail__2Property_2bytes)];
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes_v2, sizeof(notFail__2Property_2bytes_v2), test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 2, Message_GetContent(handle)->size);
+        ASSERT_ARE_EQUAL(void_ptr, notFail__2Property_2bytes_v2 + sizeof(notFail__2Property_2bytes_v2) - 2, Message_GetContent(handle)->buffer);
+        ASSERT_ARE_EQUAL(int32_t, sizeof(serialized), Message_ToByteArray(handle, serialized, sizeof(serialized)));
+        ASSERT_ARE_EQUAL(int, 0, memcmp(serialized, notFail__2Property_2bytes, sizeof(serialized)));
+
+        ///cleanup
+        Message_Destroy(handle);
+        ASSERT_ARE_EQUAL(size_t, 1, test_release_calls);
+    }
+
+    /*Tests_SRS_MESSAGE_13_036: [If the first two bytes of source are 0xA1 0x61 then Message_CreateFromByteArrayNoCopy shall parse source as a version 2 serialization and fail and return NULL if it is not valid.]*/
+    /*Tests_SRS_MESSAGE_13_026: [On failure, Message_CreateFromByteArrayNoCopy shall not call release.]*/
+    TEST_FUNCTION(Message_CreateFromByteArrayNoCopy_v2_with_offset_out_of_range_fails)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArrayNoCopy(fail_v2_secondPropertyOffsetOutOfRange, sizeof(fail_v2_secondPropertyOffsetOutOfRange), test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, test_release_calls);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_13_022: [If allocating the message fails, Message_CreateFromByteArrayNoCopy shall fail and return NULL.]*/
+    TEST_FUNCTION(Message_CreateFromByteArrayNoCopy_fails_when_malloc_fails)
+    {
+        ///arrange
+        whenShallmalloc_fail = currentmalloc_call + 1;
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes), test_release, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, test_release_calls);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_13_021: [Message_CreateFromByteArrayNoCopy shall allocate the message and the arrays of the keys and values of its properties in a single allocation, and shall not copy the properties and the content out of source.]*/
+    /*Tests_SRS_MESSAGE_13_023: [On success, Message_CreateFromByteArrayNoCopy shall return a non-NULL handle with its internal ref count set to "1" that owns source.]*/
+    TEST_FUNCTION(Message_CreateFromByteArrayNoCopy_happy_path)
+    {
+        ///arrange
+        unsigned char serialized[sizeof(notFail__2Property_2bytes)];
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes), test_release, (void*)notFail__2Property_2bytes);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 2, Message_GetContent(handle)->size);
+        ASSERT_ARE_EQUAL(void_ptr, notFail__2Property_2bytes + sizeof(notFail__2Property_2bytes) - 2, Message_GetContent(handle)->buffer);
+        ASSERT_ARE_EQUAL(int32_t, sizeof(serialized), Message_ToByteArray(handle, serialized, sizeof(serialized)));
+        ASSERT_ARE_EQUAL(int, 0, memcmp(serialized, notFail__2Property_2bytes, sizeof(serialized)));
+        ASSERT_ARE_EQUAL(size_t, 0, test_release_calls);
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_13_024: [If the ref count is zero and the message was created by Message_CreateFromByteArrayNoCopy with a non-NULL release, Message_Destroy shall call release with context.]*/
+    TEST_FUNCTION(Message_Destroy_with_message_from_byte_array_no_copy_calls_release)
+    {
+        ///arrange
+        MESSAGE_HANDLE handle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes), test_release, (void*)notFail__2Property_2bytes);
+        MESSAGE_HANDLE clone = Message_Clone(handle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_free(handle));
+
+        ///act
+        Message_Destroy(handle);
+        ASSERT_ARE_EQUAL(size_t, 0, test_release_calls);
+        Message_Destroy(clone);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 1, test_release_calls);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)notFail__2Property_2bytes, test_release_context);
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_13_025: [If the message was created by Message_CreateFromByteArrayNoCopy, the CONSTMAP shall hold copies of its properties.]*/
+    TEST_FUNCTION(Message_GetProperties_with_message_from_byte_array_no_copy_copies_the_properties)
     {
         ///arrange
+        MESSAGE_HANDLE handle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes), NULL, NULL);
+        umock_c_reset_all_calls();
+
         STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
             .IgnoreArgument_mapFilterFunc()
             .SetReturn(TEST_MAP_HANDLE);
-
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "BleedingEdge", "rocks"))
+            .SetReturn(MAP_OK);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"))
+            .SetReturn(MAP_OK);
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_firstPropertyValueDoesNotEnd, sizeof(fail_firstPropertyValueDoesNotEnd));
+        CONSTMAP_HANDLE properties = Message_GetProperties(handle);
 
         ///assert
-        ASSERT_IS_NULL(handle);
+        ASSERT_IS_NOT_NULL(properties);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        ConstMap_Destroy(properties);
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_02_032: [ If messageHandle is NULL then Message_ToByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_ToByteArray_fails_with_NULL_messageHandle_parameter)
+    {
+
+        ///arrange
+        int32_t size;
+
+        ///act
+        size = Message_ToByteArray(NULL, NULL, 0);
+
+        ///assert
+		ASSERT_IS_TRUE(size < 0);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
     }
 
-    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_with_1_byte_of_content_size_fails)
-    {
-        ///arrange
+    /*Tests_SRS_MESSAGE_17_015: [ if buf is NULL and size is not equal to zero, Message_ToByteArray shall return -1; ]*/
+    TEST_FUNCTION(Message_ToByteArray_fails_with_NULL_buffer_and_nonzero_size1)
+    {
+
+        ///arrange
+
+        ///act
+		int32_t size = Message_ToByteArray(TEST_MESSAGE_HANDLE, NULL, -1);
+
+        ///assert
+		ASSERT_IS_TRUE(size < 0);
+		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+	/*Tests_SRS_MESSAGE_17_015: [ if buf is NULL and size is not equal to zero, Message_ToByteArray shall return -1; ]*/
+	TEST_FUNCTION(Message_ToByteArray_fails_with_NULL_buffer_and_nonzero_size2)
+	{
+
+		///arrange
+
+		///act
+		int32_t size = Message_ToByteArray(TEST_MESSAGE_HANDLE, NULL, 1);
+
+		///assert
+		ASSERT_IS_TRUE(size < 0);
+		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+		///cleanup
+	}
+
+    /*Tests_SRS_MESSAGE_17_016: [ If buf is NULL and size is equal to zero, Message_ToByteArray shall return the needed memory size. ]*/
+	TEST_FUNCTION(Message_ToByteArray_returns_correct_size)
+	{
+		///arrange
+		int32_t size = 0;
+		unsigned char * buf = NULL;
+
+		STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+			.IgnoreArgument_mapFilterFunc()
+			.SetReturn(TEST_MAP_HANDLE);
+		STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+			.IgnoreArgument_keys()
+			.IgnoreArgument_values()
+			.IgnoreArgument_count();
+		EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+			.IgnoreAllCalls();
+		STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+		MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+
+		///act
+		int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
+
+		///assert
+		ASSERT_ARE_EQUAL(int32_t, sizeof(notFail____minimalMessage), nbytes);
+		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+		///cleanup
+		Message_Destroy(messageHandle);
+	}
+
+    /*Tests_SRS_MESSAGE_02_033: [ Message_ToByteArray shall precompute the needed memory size and shall pre allocate it. ]*/
+    /*Tests_SRS_MESSAGE_02_034: [ Message_ToByteArray shall populate the memory with values as indicated in the implementation details. ]*/
+    /*Tests_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, write in *size the byte array size and return a non-NULL result. ]*/
+    TEST_FUNCTION(Message_ToByteArray_no_properties_no_content_happy_path)
+    {
+
+        ///arrange
+        int32_t size = sizeof(notFail____minimalMessage);
+		unsigned char * buf = (unsigned char *)malloc(sizeof(notFail____minimalMessage));
+		ASSERT_IS_NOT_NULL(buf);
+		umock_c_reset_all_calls();
+
         STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
             .IgnoreArgument_mapFilterFunc()
             .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
+        STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .IgnoreArgument_count();
+		EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+			.IgnoreAllCalls();
         STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
 
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsOnly1ByteOfcontentSize, sizeof(fail_whenThereIsOnly1ByteOfcontentSize));
+		int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
 
         ///assert
-        ASSERT_IS_NULL(handle);
+		ASSERT_ARE_EQUAL(int32_t, sizeof(notFail____minimalMessage), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail____minimalMessage, size));
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        free((void*)buf);
+        Message_Destroy(messageHandle);
     }
 
-    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_with_2_byte_of_content_size_fails)
-    {
-        ///arrange
+    /*Tests_SRS_MESSAGE_02_033: [ Message_ToByteArray shall precompute the needed memory size and shall pre allocate it. ]*/
+    /*Tests_SRS_MESSAGE_02_034: [ Message_ToByteArray shall populate the memory with values as indicated in the implementation details. ]*/
+    /*Tests_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, write in *size the byte array size and return a non-NULL result. ]*/
+	TEST_FUNCTION(Message_ToByteArray_with_properties_and_content_happy_path)
+	{
 
-        const unsigned char fail_whenThereIsOnly2ByteOfcontentSize[] =
-        {
-            0xA1, 0x60,             /*header*/
-            0x00, 0x00, 0x00, 20,   /*size of this array*/
-            0x00, 0x00, 0x00, 0x01, /*one property*/
-            '3', '3', '3', '\0',
-            '3', '3', '3', '\0',
-            0x00, 0x00              /*not enough bytes for contentSize*/
-        };
+		///arrange
+		int32_t size = sizeof(notFail__2Property_2bytes);
+		unsigned char * buf = (unsigned char *)malloc(sizeof(notFail__2Property_2bytes));
+		ASSERT_IS_NOT_NULL(buf);
+		const char* keys[] = { "BleedingEdge", "Azure IoT Gateway is" };
+		const char* values[] = { "rocks", "awesome" };
+		currentMap_keys = keys;
+		currentMap_values = values;
+		currentMap_count = 2;
+		umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+		STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+			.IgnoreArgument_mapFilterFunc()
+			.SetReturn(TEST_MAP_HANDLE);
+		STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+			.IgnoreAllArguments();
+		STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+			.IgnoreAllArguments();
+		STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+			.IgnoreArgument_keys()
+			.IgnoreArgument_values()
+			.IgnoreArgument_count();
+		EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+			.IgnoreAllCalls();
+		STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+		MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+
+		///act
+		int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
+
+		///assert
+		ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__2Property_2bytes), nbytes);
+		ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail__2Property_2bytes, size));
+		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+		///cleanup
+		free((void*)buf);
+		Message_Destroy(messageHandle);
+	}
+
+
+    /*Tests_SRS_MESSAGE_17_017: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArray shall return -1; ]*/
+	TEST_FUNCTION(Message_ToByteArray_with_properties_and_content_fails_size_too_small)
+	{
+
+		///arrange
+		int32_t size = sizeof(notFail__2Property_2bytes)-1;
+		unsigned char * buf = (unsigned char *)malloc(sizeof(notFail__2Property_2bytes));
+		ASSERT_IS_NOT_NULL(buf);
+		const char* keys[] = { "BleedingEdge", "Azure IoT Gateway is" };
+		const char* values[] = { "rocks", "awesome" };
+		currentMap_keys = keys;
+		currentMap_values = values;
+		currentMap_count = 2;
+		umock_c_reset_all_calls();
+
+		STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+			.IgnoreArgument_mapFilterFunc()
+			.SetReturn(TEST_MAP_HANDLE);
+		STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+			.IgnoreAllArguments();
+		STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+			.IgnoreAllArguments();
+		STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is getting the properties*/
+			.IgnoreArgument_keys()
+			.IgnoreArgument_values()
+			.IgnoreArgument_count();
+		EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+			.IgnoreAllCalls();
+		STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+		MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+
+		///act
+		int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
+
+		///assert
+		ASSERT_IS_TRUE(nbytes < 0);
+		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+		///cleanup
+		free((void*)buf);
+		Message_Destroy(messageHandle);
+	}
+
+    /*Tests_SRS_MESSAGE_13_038: [ If messageHandle is NULL, buf is NULL and size is not equal to zero, or format is not a MESSAGE_WIRE_FORMAT, then Message_ToByteArrayWithFormat shall fail and return -1. ]*/
+    TEST_FUNCTION(Message_ToByteArrayWithFormat_fails_with_NULL_messageHandle_parameter)
+    {
+        ///arrange
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsOnly2ByteOfcontentSize, sizeof(fail_whenThereIsOnly2ByteOfcontentSize));
+        int32_t nbytes = Message_ToByteArrayWithFormat(NULL, MESSAGE_WIRE_FORMAT_V2, NULL, 0);
 
         ///assert
-        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(int32_t, -1, nbytes);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
     }
 
-    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_with_3_byte_of_content_size_fails)
+    /*Tests_SRS_MESSAGE_13_038: [ If messageHandle is NULL, buf is NULL and size is not equal to zero, or format is not a MESSAGE_WIRE_FORMAT, then Message_ToByteArrayWithFormat shall fail and return -1. ]*/
+    TEST_FUNCTION(Message_ToByteArrayWithFormat_fails_with_NULL_buffer_and_nonzero_size)
     {
         ///arrange
-
-        const unsigned char fail_whenThereIsOnly3ByteOfcontentSize[] =
-        {
-            0xA1, 0x60,             /*header*/
-            0x00, 0x00, 0x00, 21,   /*size of this array*/
-            0x00, 0x00, 0x00, 0x01, /*one property*/
-            '3', '3', '3', '\0',
-            '3', '3', '3', '\0',
-            0x00, 0x00, 0x00        /*not enough bytes for contentSize*/
-        };
-
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes_v2, sizeof(notFail__2Property_2bytes_v2), NULL, NULL);
+        umock_c_reset_all_calls();
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsOnly3ByteOfcontentSize, sizeof(fail_whenThereIsOnly3ByteOfcontentSize));
+        int32_t nbytes = Message_ToByteArrayWithFormat(messageHandle, MESSAGE_WIRE_FORMAT_V2, NULL, 1);
 
         ///assert
-        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(int32_t, -1, nbytes);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        Message_Destroy(messageHandle);
     }
 
-    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_with_1_byte_of_content_size_but_no_content_fails)
+    /*Tests_SRS_MESSAGE_13_038: [ If messageHandle is NULL, buf is NULL and size is not equal to zero, or format is not a MESSAGE_WIRE_FORMAT, then Message_ToByteArrayWithFormat shall fail and return -1. ]*/
+    TEST_FUNCTION(Message_ToByteArrayWithFormat_fails_with_unknown_format)
     {
         ///arrange
-
-        const unsigned char fail_whenThereIsNotEnoughContent[] =
-        {
-            0xA1, 0x60,             /*header*/
-            0x00, 0x00, 0x00, 22,   /*size of this array*/
-            0x00, 0x00, 0x00, 0x01, /*one property*/
-            '3', '3', '3', '\0',
-            '3', '3', '3', '\0',
-            0x00, 0x00, 0x00, 0x01  /*no further content*/
-        };
-
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes_v2, sizeof(notFail__2Property_2bytes_v2), NULL, NULL);
+        umock_c_reset_all_calls();
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsNotEnoughContent, sizeof(fail_whenThereIsNotEnoughContent));
+        int32_t nbytes = Message_ToByteArrayWithFormat(messageHandle, (MESSAGE_WIRE_FORMAT)(MESSAGE_WIRE_FORMAT_V2 + 1), NULL, 0);
 
         ///assert
-        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(int32_t, -1, nbytes);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        Message_Destroy(messageHandle);
     }
 
-    /*Tests_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_with_1_byte_of_content_size_but_2_bytes_of_content_fails)
+    /*Tests_SRS_MESSAGE_13_037: [ If format is MESSAGE_WIRE_FORMAT_V1, Message_ToByteArrayWithFormat shall return what Message_ToByteArray returns. ]*/
+    TEST_FUNCTION(Message_ToByteArrayWithFormat_v1_serializes_as_Message_ToByteArray)
     {
         ///arrange
-
-        const unsigned char fail_whenThereIsTooMuchContent[] =
-        {
-            0xA1, 0x60,             /*header*/
-            0x00, 0x00, 0x00, 24,   /*size of this array*/
-            0x00, 0x00, 0x00, 0x01, /*one property*/
-            '3', '3', '3', '\0',
-            '3', '3', '3', '\0',
-            0x00, 0x00, 0x00, 0x01,  /*no further content*/
-            '3', '3'
-        };
-
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "333", "333"));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        unsigned char serialized[sizeof(notFail__2Property_2bytes)];
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes_v2, sizeof(notFail__2Property_2bytes_v2), NULL, NULL);
+        umock_c_reset_all_calls();
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_whenThereIsTooMuchContent, sizeof(fail_whenThereIsTooMuchContent));
+        int32_t nbytes = Message_ToByteArrayWithFormat(messageHandle, MESSAGE_WIRE_FORMAT_V1, serialized, sizeof(serialized));
 
         ///assert
-        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__2Property_2bytes), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(serialized, notFail__2Property_2bytes, sizeof(serialized)));
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        Message_Destroy(messageHandle);
     }
 
-    /*Tests_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_fails_when_Map_Create_fails)
+    /*Tests_SRS_MESSAGE_13_039: [ Message_ToByteArrayWithFormat shall precompute the needed memory size and return it if buf is NULL and size is equal to zero. ]*/
+    TEST_FUNCTION(Message_ToByteArrayWithFormat_v2_returns_correct_size)
     {
         ///arrange
-
-        const unsigned char notFail____minimalMessage[] =
-        {
-            0xA1, 0x60,             /*header*/
-            0x00, 0x00, 0x00, 14,   /*size of this array*/
-            0x00, 0x00, 0x00, 0x00, /*zero properties*/
-            0x00, 0x00, 0x00, 0x00  /*zero message content size*/
-        };
-
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(NULL);
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes), NULL, NULL);
+        umock_c_reset_all_calls();
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+        int32_t nbytes = Message_ToByteArrayWithFormat(messageHandle, MESSAGE_WIRE_FORMAT_V2, NULL, 0);
 
         ///assert
-        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__2Property_2bytes_v2), nbytes);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        Message_Destroy(messageHandle);
     }
 
-    /*Tests_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_fails_when_numberOfProperties_is_negative)
+    /*Tests_SRS_MESSAGE_13_040: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArrayWithFormat shall return -1. ]*/
+    TEST_FUNCTION(Message_ToByteArrayWithFormat_v2_fails_size_too_small)
     {
         ///arrange
-
-        const unsigned char notFail____minimalMessage[] =
-        {
-            0xA1, 0x60,             /*header*/
-            0x00, 0x00, 0x00, 14,   /*size of this array*/
-            0xFF, 0xFF, 0xFF, 0xFF, /*-1 properties*/
-            0x00, 0x00, 0x00, 0x00  /*zero message content size*/
-        };
-
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        unsigned char serialized[sizeof(notFail__2Property_2bytes_v2)];
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes), NULL, NULL);
+        umock_c_reset_all_calls();
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+        int32_t nbytes = Message_ToByteArrayWithFormat(messageHandle, MESSAGE_WIRE_FORMAT_V2, serialized, sizeof(serialized) - 1);
 
         ///assert
-        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(int32_t, -1, nbytes);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        Message_Destroy(messageHandle);
     }
 
-    /*Tests_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_fails_when_numberOfProperties_is_int32_max)
+    /*Tests_SRS_MESSAGE_13_041: [ If format is MESSAGE_WIRE_FORMAT_V2, Message_ToByteArrayWithFormat shall populate the memory with values as indicated in the implementation details of version 2. ]*/
+    /*Tests_SRS_MESSAGE_13_043: [ Otherwise Message_ToByteArrayWithFormat shall succeed, and return the byte array size. ]*/
+    TEST_FUNCTION(Message_ToByteArrayWithFormat_v2_with_properties_and_content_happy_path)
     {
         ///arrange
-
-        const unsigned char notFail____minimalMessage[] =
-        {
-            0xA1, 0x60,             /*header*/
-            0x00, 0x00, 0x00, 14,   /*size of this array*/
-            0x7F, 0xFF, 0xFF, 0xFF, /*INT32_MAX properties*/
-            0x00, 0x00, 0x00, 0x00  /*zero message content size*/
-        };
-
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        unsigned char serialized[sizeof(notFail__2Property_2bytes_v2)];
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes), NULL, NULL);
+        umock_c_reset_all_calls();
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+        int32_t nbytes = Message_ToByteArrayWithFormat(messageHandle, MESSAGE_WIRE_FORMAT_V2, serialized, sizeof(serialized));
 
         ///assert
-        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__2Property_2bytes_v2), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(serialized, notFail__2Property_2bytes_v2, sizeof(serialized)));
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        Message_Destroy(messageHandle);
     }
 
-    /*Tests_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_CreateFromByteArray_fails_when_Map_Add_fails)
-    {
-
-        ///arrange
-
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "3", "3"))
-            .SetReturn(MAP_ERROR);
-
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+    /*Tests_SRS_MESSAGE_13_027: [If messageHandle or segments is NULL then Message_ToIoVec shall fail and return -1.]*/
+    TEST_FUNCTION(Message_ToIoVec_fails_with_NULL_messageHandle_parameter)
+    {
+        ///arrange
+        MESSAGE_IOVEC segments[MESSAGE_IOVEC_COUNT];
 
         ///act
-        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__1Property_0bytes, sizeof(notFail__1Property_0bytes));
+        int32_t nbytes = Message_ToIoVec(NULL, segments);
 
         ///assert
-        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(int32_t, -1, nbytes);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        Message_Destroy(handle);
     }
 
-    /*Tests_SRS_MESSAGE_02_032: [ If messageHandle is NULL then Message_ToByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_ToByteArray_fails_with_NULL_messageHandle_parameter)
+    /*Tests_SRS_MESSAGE_13_027: [If messageHandle or segments is NULL then Message_ToIoVec shall fail and return -1.]*/
+    TEST_FUNCTION(Message_ToIoVec_fails_with_NULL_segments_parameter)
     {
-
         ///arrange
-        int32_t size;
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes), NULL, NULL);
+        umock_c_reset_all_calls();
 
         ///act
-        size = Message_ToByteArray(NULL, NULL, 0);
+        int32_t nbytes = Message_ToIoVec(messageHandle, NULL);
 
         ///assert
-		ASSERT_IS_TRUE(size < 0);
+        ASSERT_ARE_EQUAL(int32_t, -1, nbytes);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        Message_Destroy(messageHandle);
     }
 
-    /*Tests_SRS_MESSAGE_17_015: [ if buf is NULL and size is not equal to zero, Message_ToByteArray shall return -1; ]*/
-    TEST_FUNCTION(Message_ToByteArray_fails_with_NULL_buffer_and_nonzero_size1)
+    /*Tests_SRS_MESSAGE_13_028: [Message_ToIoVec shall allocate a buffer and write to it the header, the properties and the size of the content of the message, in the same format as Message_ToByteArray.]*/
+    /*Tests_SRS_MESSAGE_13_029: [Message_ToIoVec shall set the first segment to that buffer and the second segment to the content of the message, without copying the content.]*/
+    /*Tests_SRS_MESSAGE_13_031: [Otherwise Message_ToIoVec shall succeed and return the total size of the segments.]*/
+    TEST_FUNCTION(Message_ToIoVec_with_properties_and_content_happy_path)
     {
-
         ///arrange
+        MESSAGE_IOVEC segments[MESSAGE_IOVEC_COUNT];
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes), NULL, NULL);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(notFail__2Property_2bytes) - 2));
 
         ///act
-		int32_t size = Message_ToByteArray(TEST_MESSAGE_HANDLE, NULL, -1);
+        int32_t nbytes = Message_ToIoVec(messageHandle, segments);
 
         ///assert
-		ASSERT_IS_TRUE(size < 0);
-		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__2Property_2bytes), nbytes);
+        ASSERT_ARE_EQUAL(size_t, sizeof(notFail__2Property_2bytes) - 2, segments[0].size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(segments[0].buffer, notFail__2Property_2bytes, segments[0].size));
+        ASSERT_ARE_EQUAL(size_t, 2, segments[1].size);
+        ASSERT_ARE_EQUAL(void_ptr, notFail__2Property_2bytes + sizeof(notFail__2Property_2bytes) - 2, segments[1].buffer);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        Message_FreeIoVec(segments);
+        Message_Destroy(messageHandle);
     }
 
-	/*Tests_SRS_MESSAGE_17_015: [ if buf is NULL and size is not equal to zero, Message_ToByteArray shall return -1; ]*/
-	TEST_FUNCTION(Message_ToByteArray_fails_with_NULL_buffer_and_nonzero_size2)
-	{
+    /*Tests_SRS_MESSAGE_13_030: [If any of the above steps fails then Message_ToIoVec shall fail and return -1.]*/
+    TEST_FUNCTION(Message_ToIoVec_fails_when_malloc_fails)
+    {
+        ///arrange
+        MESSAGE_IOVEC segments[MESSAGE_IOVEC_COUNT];
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes), NULL, NULL);
+        umock_c_reset_all_calls();
 
-		///arrange
+        whenShallmalloc_fail = currentmalloc_call + 1;
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
 
-		///act
-		int32_t size = Message_ToByteArray(TEST_MESSAGE_HANDLE, NULL, 1);
+        ///act
+        int32_t nbytes = Message_ToIoVec(messageHandle, segments);
 
-		///assert
-		ASSERT_IS_TRUE(size < 0);
-		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ///assert
+        ASSERT_ARE_EQUAL(int32_t, -1, nbytes);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-		///cleanup
-	}
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
 
-    /*Tests_SRS_MESSAGE_17_016: [ If buf is NULL and size is equal to zero, Message_ToByteArray shall return the needed memory size. ]*/
-	TEST_FUNCTION(Message_ToByteArray_returns_correct_size)
-	{
-		///arrange
-		int32_t size = 0;
-		unsigned char * buf = NULL;
+    /*Tests_SRS_MESSAGE_13_032: [If segments is NULL then Message_FreeIoVec shall do nothing.]*/
+    TEST_FUNCTION(Message_FreeIoVec_with_NULL_segments_does_nothing)
+    {
+        ///arrange
 
-		STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-			.IgnoreArgument_mapFilterFunc()
-			.SetReturn(TEST_MAP_HANDLE);
-		EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-			.IgnoreAllCalls();
-		STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
-			.IgnoreArgument_source();
-		STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-		STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        ///act
+        Message_FreeIoVec(NULL);
 
-		MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-		size_t zero = 0;
-		const CONSTBUFFER bufferContent = { NULL, 0 };
+        ///cleanup
+    }
 
-		STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreArgument_handle()
-			.IgnoreArgument_keys()
-			.IgnoreArgument_values()
-			.CopyOutArgumentBuffer(4, &zero, sizeof(zero));
-		STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
-			.IgnoreArgument_constbufferHandle()
-			.SetReturn(&bufferContent);
+    /*Tests_SRS_MESSAGE_13_033: [Message_FreeIoVec shall free the buffer of the first segment, which Message_ToIoVec allocated.]*/
+    TEST_FUNCTION(Message_FreeIoVec_frees_the_first_segment)
+    {
+        ///arrange
+        MESSAGE_IOVEC segments[MESSAGE_IOVEC_COUNT];
+        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArrayNoCopy(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes), NULL, NULL);
+        (void)Message_ToIoVec(messageHandle, segments);
+        umock_c_reset_all_calls();
 
+        STRICT_EXPECTED_CALL(gballoc_free((void*)segments[0].buffer));
 
-		///act
-		int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
+        ///act
+        Message_FreeIoVec(segments);
 
-		///assert
-		ASSERT_ARE_EQUAL(int32_t, sizeof(notFail____minimalMessage), nbytes);
-		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_IS_NULL(segments[0].buffer);
 
-		///cleanup
-		Message_Destroy(messageHandle);
-	}
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
 
-    /*Tests_SRS_MESSAGE_02_033: [ Message_ToByteArray shall precompute the needed memory size and shall pre allocate it. ]*/
-    /*Tests_SRS_MESSAGE_02_034: [ Message_ToByteArray shall populate the memory with values as indicated in the implementation details. ]*/
-    /*Tests_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, write in *size the byte array size and return a non-NULL result. ]*/
-    TEST_FUNCTION(Message_ToByteArray_no_properties_no_content_happy_path)
+    /*Tests_SRS_MESSAGE_13_044: [MessageBatch_Create shall create an empty batch of messages.]*/
+    /*Tests_SRS_MESSAGE_13_058: [MessageBatch_GetCount shall return the number of messages in the batch, or 0 if batch is NULL.]*/
+    /*Tests_SRS_MESSAGE_13_059: [If batch is NULL or empty, MessageBatch_GetMessages shall return NULL.]*/
+    TEST_FUNCTION(MessageBatch_Create_with_NULL_properties_creates_an_empty_batch)
     {
-
         ///arrange
-        int32_t size = sizeof(notFail____minimalMessage);
-		unsigned char * buf = (unsigned char *)malloc(sizeof(notFail____minimalMessage));
-		ASSERT_IS_NOT_NULL(buf);
-		umock_c_reset_all_calls();
-
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-		EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-			.IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0))
-            .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
 
-        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail____minimalMessage, sizeof(notFail____minimalMessage));
+        ///act
+        MESSAGE_BATCH_HANDLE batch = MessageBatch_Create(NULL);
 
-        size_t zero = 0;
-        const CONSTBUFFER bufferContent = { NULL, 0 };
+        ///assert
+        ASSERT_IS_NOT_NULL(batch);
+        ASSERT_ARE_EQUAL(size_t, 0, MessageBatch_GetCount(batch));
+        ASSERT_IS_NULL(MessageBatch_GetMessages(batch));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .IgnoreArgument_keys()
-            .IgnoreArgument_values()
-            .CopyOutArgumentBuffer(4, &zero, sizeof(zero));
-        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
-            .IgnoreArgument_constbufferHandle()
-            .SetReturn(&bufferContent);
+        ///cleanup
+        MessageBatch_Destroy(batch);
+    }
 
+    /*Tests_SRS_MESSAGE_13_045: [If any of the above steps fails, MessageBatch_Create shall fail and return NULL.]*/
+    TEST_FUNCTION(MessageBatch_Create_fails_when_malloc_fails)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1)
+            .SetReturn(NULL);
 
         ///act
-		int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
+        MESSAGE_BATCH_HANDLE batch = MessageBatch_Create(NULL);
 
         ///assert
-		ASSERT_ARE_EQUAL(int32_t, sizeof(notFail____minimalMessage), nbytes);
-        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail____minimalMessage, size));
+        ASSERT_IS_NULL(batch);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        free((void*)buf);
-        Message_Destroy(messageHandle);
     }
 
-    /*Tests_SRS_MESSAGE_02_033: [ Message_ToByteArray shall precompute the needed memory size and shall pre allocate it. ]*/
-    /*Tests_SRS_MESSAGE_02_034: [ Message_ToByteArray shall populate the memory with values as indicated in the implementation details. ]*/
-    /*Tests_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, write in *size the byte array size and return a non-NULL result. ]*/
-	TEST_FUNCTION(Message_ToByteArray_with_properties_and_content_happy_path)
-	{
-
-		///arrange
-		int32_t size = sizeof(notFail__2Property_2bytes);
-		unsigned char * buf = (unsigned char *)malloc(sizeof(notFail__2Property_2bytes));
-		ASSERT_IS_NOT_NULL(buf);
-		umock_c_reset_all_calls();
-
-		STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-			.IgnoreArgument_mapFilterFunc()
-			.SetReturn(TEST_MAP_HANDLE);
-		STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreAllArguments();
-		STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreAllArguments();
-		EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-			.IgnoreAllCalls();
-		STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
-			.IgnoreArgument_source();
-		STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-		STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+    /*Tests_SRS_MESSAGE_13_047: [If batch or message is NULL, MessageBatch_Add shall fail and return a non-zero value.]*/
+    TEST_FUNCTION(MessageBatch_Add_with_NULL_message_fails)
+    {
+        ///arrange
+        MESSAGE_BATCH_HANDLE batch = MessageBatch_Create(NULL);
+        umock_c_reset_all_calls();
 
-		MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        ///act
+        int result = MessageBatch_Add(batch, NULL);
 
-		size_t two = 2;
-		const char* keys[] = { "BleedingEdge", "Azure IoT Gateway is" };
-		const char* values[] = { "rocks", "awesome" };
-		const char* const* *pkeys = (const char* const* *)&keys;
-		const char* const* *pvalues = (const char* const* *)&values;
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, 0, MessageBatch_GetCount(batch));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-		const CONSTBUFFER bufferContent = { (const unsigned char*)"34", 2 };
+        ///cleanup
+        MessageBatch_Destroy(batch);
+    }
 
-		STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreArgument_handle()
-			.CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
-			.CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
-			.CopyOutArgumentBuffer(4, &two, sizeof(two));
-		STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
-			.IgnoreArgument_constbufferHandle()
-			.SetReturn(&bufferContent);
+    /*Tests_SRS_MESSAGE_13_048: [MessageBatch_Add shall append a clone of message to the batch, growing the batch when it is full.]*/
+    /*Tests_SRS_MESSAGE_13_050: [Otherwise MessageBatch_Add shall succeed and return 0.]*/
+    /*Tests_SRS_MESSAGE_13_060: [Otherwise MessageBatch_GetMessages shall return the messages of the batch in the order they were added, without cloning them.]*/
+    TEST_FUNCTION(MessageBatch_Add_appends_a_clone_of_the_message)
+    {
+        ///arrange
+        char t = '3';
+        MESSAGE_CONFIG c = { sizeof(t), (unsigned char*)&t, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        MESSAGE_BATCH_HANDLE batch = MessageBatch_Create(NULL);
+        umock_c_reset_all_calls();
 
-		///act
-		int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the array of messages*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(NULL));
 
-		///assert
-		ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__2Property_2bytes), nbytes);
-		ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail__2Property_2bytes, size));
-		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ///act
+        int result = MessageBatch_Add(batch, msg);
 
-		///cleanup
-		free((void*)buf);
-		Message_Destroy(messageHandle);
-	}
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, 1, MessageBatch_GetCount(batch));
+        ASSERT_ARE_EQUAL(void_ptr, msg, MessageBatch_GetMessages(batch)[0]);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
+        ///cleanup
+        Message_Destroy(msg);
+        MessageBatch_Destroy(batch);
+    }
 
-    /*Tests_SRS_MESSAGE_02_035: [ If any of the above steps fails then Message_ToByteArray shall fail and return NULL. ]*/
-    TEST_FUNCTION(Message_ToByteArray_with_properties_and_content_fails_when_ConstMap_GetInternals_fails)
+    /*Tests_SRS_MESSAGE_13_052: [If the batch was created without shared properties, MessageBatch_AddContent shall fail and return a non-zero value.]*/
+    TEST_FUNCTION(MessageBatch_AddContent_without_shared_properties_fails)
     {
-
         ///arrange
-		int32_t size = sizeof(notFail__2Property_2bytes);
-		unsigned char * buf = (unsigned char *)malloc(sizeof(notFail__2Property_2bytes));
-		ASSERT_IS_NOT_NULL(buf);
-		umock_c_reset_all_calls();
+        char t = '3';
+        MESSAGE_BATCH_HANDLE batch = MessageBatch_Create(NULL);
+        umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-            .IgnoreArgument_mapFilterFunc()
-            .SetReturn(TEST_MAP_HANDLE);
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreAllCalls();
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
-            .IgnoreArgument_source();
-        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        ///act
+        int result = MessageBatch_AddContent(batch, (const unsigned char*)&t, sizeof(t));
 
-        MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        size_t two = 2;
-        const char* keys[] = { "BleedingEdge", "Azure IoT Gateway is" };
-        const char* values[] = { "rocks", "awesome" };
-        const char* const* *pkeys = (const char* const* *)&keys;
-        const char* const* *pvalues = (const char* const* *)&values;
+        ///cleanup
+        MessageBatch_Destroy(batch);
+    }
 
-        const CONSTBUFFER bufferContent = { (const unsigned char*)"34", 2 };
+    /*Tests_SRS_MESSAGE_13_053: [MessageBatch_AddContent shall create a message with a copy of source in the same allocation as the message.]*/
+    /*Tests_SRS_MESSAGE_13_054: [The message shall share the shared properties of the batch, and hold a reference to the message holding them until it is destroyed.]*/
+    /*Tests_SRS_MESSAGE_13_056: [MessageBatch_AddContent shall append the message to the batch, growing the batch when it is full.]*/
+    /*Tests_SRS_MESSAGE_13_057: [Otherwise MessageBatch_AddContent shall succeed and return 0.]*/
+    TEST_FUNCTION(MessageBatch_AddContent_shares_the_properties_of_the_batch)
+    {
+        ///arrange
+        const char* keys[] = { "source", "color" };
+        const char* values[] = { "mapping", "blue" };
+        char t = '3';
+        currentMap_keys = keys;
+        currentMap_values = values;
+        currentMap_count = 2;
+        MESSAGE_BATCH_HANDLE batch = MessageBatch_Create((MAP_HANDLE)&t);
+        umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_handle()
-            .CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
-            .CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
-            .CopyOutArgumentBuffer(4, &two, sizeof(two))
-            .SetReturn(CONSTMAP_ERROR);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the handle and the content*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the array of messages*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(NULL));
 
         ///act
-		int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
+        int result = MessageBatch_AddContent(batch, (const unsigned char*)&t, sizeof(t));
 
         ///assert
-		ASSERT_IS_TRUE(nbytes < 0);
-		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(size_t, 1, MessageBatch_GetCount(batch));
+        ASSERT_ARE_EQUAL(int, '3', Message_GetContent(MessageBatch_GetMessages(batch)[0])->buffer[0]);
+        ASSERT_ARE_EQUAL(char_ptr, "mapping", Message_GetPropertyById(MessageBatch_GetMessages(batch)[0], MESSAGE_PROPERTY_SOURCE));
+        ASSERT_ARE_EQUAL(char_ptr, "blue", Message_GetProperty(MessageBatch_GetMessages(batch)[0], "color"));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
-        free((void*)buf);
-        Message_Destroy(messageHandle);
+        MessageBatch_Destroy(batch);
     }
 
-    /*Tests_SRS_MESSAGE_17_017: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArray shall return -1; ]*/
-	TEST_FUNCTION(Message_ToByteArray_with_properties_and_content_fails_size_too_small)
-	{
+    /*Tests_SRS_MESSAGE_17_002: [If the ref count is zero and the message was created by MessageBatch_AddContent, Message_Destroy shall destroy the message holding the shared properties of the batch.]*/
+    TEST_FUNCTION(Message_Destroy_of_a_batch_message_that_outlives_its_batch_destroys_the_shared_properties)
+    {
+        ///arrange
+        const char* keys[] = { "color" };
+        const char* values[] = { "blue" };
+        char t = '3';
+        currentMap_keys = keys;
+        currentMap_values = values;
+        currentMap_count = 1;
+        MESSAGE_BATCH_HANDLE batch = MessageBatch_Create((MAP_HANDLE)&t);
+        (void)MessageBatch_AddContent(batch, (const unsigned char*)&t, sizeof(t));
+        MESSAGE_HANDLE msg = Message_Clone(MessageBatch_GetMessages(batch)[0]);
+        MessageBatch_Destroy(batch);
+        const char* color = Message_GetProperty(msg, "color");
+        umock_c_reset_all_calls();
 
-		///arrange
-		int32_t size = sizeof(notFail__2Property_2bytes)-1;
-		unsigned char * buf = (unsigned char *)malloc(sizeof(notFail__2Property_2bytes));
-		ASSERT_IS_NOT_NULL(buf);
-		umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the message holding the shared properties*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is the handle and the content*/
+            .IgnoreArgument(1);
 
-		STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
-			.IgnoreArgument_mapFilterFunc()
-			.SetReturn(TEST_MAP_HANDLE);
-		STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreAllArguments();
-		STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreAllArguments();
-		EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-			.IgnoreAllCalls();
-		STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 2))
-			.IgnoreArgument_source();
-		STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
-		STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        ///act
+        Message_Destroy(msg);
 
-		MESSAGE_HANDLE messageHandle = Message_CreateFromByteArray(notFail__2Property_2bytes, sizeof(notFail__2Property_2bytes));
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, "blue", color);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-		size_t two = 2;
-		const char* keys[] = { "BleedingEdge", "Azure IoT Gateway is" };
-		const char* values[] = { "rocks", "awesome" };
-		const char* const* *pkeys = (const char* const* *)&keys;
-		const char* const* *pvalues = (const char* const* *)&values;
+        ///cleanup
+    }
 
-		const CONSTBUFFER bufferContent = { (const unsigned char*)"34", 2 };
+    /*Tests_SRS_MESSAGE_13_061: [If batch is NULL, MessageBatch_Destroy shall do nothing.]*/
+    TEST_FUNCTION(MessageBatch_Destroy_with_NULL_batch_does_nothing)
+    {
+        ///arrange
 
-		STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreArgument_handle()
-			.CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
-			.CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
-			.CopyOutArgumentBuffer(4, &two, sizeof(two));
-		STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
-			.IgnoreArgument_constbufferHandle()
-			.SetReturn(&bufferContent);
+        ///act
+        MessageBatch_Destroy(NULL);
 
-		///act
-		int32_t nbytes = Message_ToByteArray(messageHandle, buf, size);
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-		///assert
-		ASSERT_IS_TRUE(nbytes < 0);
-		ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ///cleanup
+    }
 
-		///cleanup
-		free((void*)buf);
-		Message_Destroy(messageHandle);
-	}
 
 END_TEST_SUITE(gwmessage_ut)
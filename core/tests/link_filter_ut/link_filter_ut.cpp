@@ -0,0 +1,685 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cstdlib>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <cstdint>
+#include <cstring>
+
+#include "testrunnerswitcher.h"
+#include "micromock.h"
+#include "micromockcharstararenullterminatedstrings.h"
+
+#include "internal/link_filter.h"
+
+#define GBALLOC_H
+
+extern "C" int gballoc_init(void);
+extern "C" void gballoc_deinit(void);
+extern "C" void* gballoc_malloc(size_t size);
+extern "C" void* gballoc_calloc(size_t nmemb, size_t size);
+extern "C" void* gballoc_realloc(void* ptr, size_t size);
+extern "C" void gballoc_free(void* ptr);
+
+namespace BASEIMPLEMENTATION
+{
+    /*if malloc is defined as gballoc_malloc at this moment, there'd be serious trouble*/
+
+#define Lock(x) (LOCK_OK + gballocState - gballocState) /*compiler warning about constant in if condition*/
+#define Unlock(x) (LOCK_OK + gballocState - gballocState)
+#define Lock_Init() (LOCK_HANDLE)0x42
+#define Lock_Deinit(x) (LOCK_OK + gballocState - gballocState)
+#include "gballoc.c"
+#undef Lock
+#undef Unlock
+#undef Lock_Init
+#undef Lock_Deinit
+};
+
+static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
+static MICROMOCK_MUTEX_HANDLE g_testByTest;
+
+/*the messages of the tests are arrays of properties ending with a NULL key*/
+typedef struct FAKE_PROPERTY_TAG
+{
+    const char* key;
+    const char* value;
+} FAKE_PROPERTY;
+
+static const FAKE_PROPERTY ble_message[] =
+{
+    { "source", "bleTelemetry" },
+    { "macAddress", "01:02:03:04:05:06" },
+    { "deviceName", "sensor-kitchen" },
+    { NULL, NULL }
+};
+
+static const BROKER_FILTER_CONDITION ble_conditions[] =
+{
+    { BROKER_FILTER_EQUALS, "source", "bleTelemetry" },
+    { BROKER_FILTER_PREFIX, "deviceName", "sensor-" },
+    { BROKER_FILTER_EXISTS, "macAddress", NULL }
+};
+
+static const BROKER_LINK_FILTER ble_filter = { ble_conditions, sizeof(ble_conditions) / sizeof(ble_conditions[0]) };
+
+TYPED_MOCK_CLASS(CLinkFilterMocks, CGlobalMock)
+{
+public:
+    MOCK_STATIC_METHOD_1(, void*, gballoc_malloc, size_t, size)
+    MOCK_METHOD_END(void*, BASEIMPLEMENTATION::gballoc_malloc(size));
+
+    MOCK_STATIC_METHOD_1(, void, gballoc_free, void*, ptr)
+        BASEIMPLEMENTATION::gballoc_free(ptr);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, const char*, Message_GetProperty, MESSAGE_HANDLE, message, const char*, key)
+        const char* value = NULL;
+        const FAKE_PROPERTY* property;
+        for (property = (const FAKE_PROPERTY*)message; property->key != NULL; property++)
+        {
+            if (strcmp(property->key, key) == 0)
+            {
+                value = property->value;
+                break;
+            }
+        }
+    MOCK_METHOD_END(const char*, value);
+};
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CLinkFilterMocks, , void*, gballoc_malloc, size_t, size);
+DECLARE_GLOBAL_MOCK_METHOD_1(CLinkFilterMocks, , void, gballoc_free, void*, ptr);
+
+DECLARE_GLOBAL_MOCK_METHOD_2(CLinkFilterMocks, , const char*, Message_GetProperty, MESSAGE_HANDLE, message, const char*, key);
+
+BEGIN_TEST_SUITE(link_filter_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = MicroMockCreateMutex();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    MicroMockDestroyMutex(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (!MicroMockAcquireMutex(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    if (!MicroMockReleaseMutex(g_testByTest))
+    {
+        ASSERT_FAIL("failure in test framework at ReleaseMutex");
+    }
+}
+
+/*Tests_SRS_LINK_FILTER_13_001: [ If definition is NULL, or it has no condition, LinkFilter_Create shall return NULL. ]*/
+TEST_FUNCTION(LinkFilter_Create_with_NULL_definition_returns_NULL)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+
+    ///act
+    auto filter = LinkFilter_Create(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(filter);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_LINK_FILTER_13_001: [ If definition is NULL, or it has no condition, LinkFilter_Create shall return NULL. ]*/
+TEST_FUNCTION(LinkFilter_Create_without_conditions_returns_NULL)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    BROKER_LINK_FILTER definition = { ble_conditions, 0 };
+
+    ///act
+    auto filter = LinkFilter_Create(&definition);
+
+    ///assert
+    ASSERT_IS_NULL(filter);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_LINK_FILTER_13_002: [ If a condition has no name, has an operation that is not a BROKER_FILTER_OPERATION or, unless its operation is BROKER_FILTER_EXISTS or BROKER_FILTER_PARTITION, has no value, LinkFilter_Create shall return NULL. ]*/
+TEST_FUNCTION(LinkFilter_Create_with_a_condition_without_name_returns_NULL)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    BROKER_FILTER_CONDITION conditions[] = { { BROKER_FILTER_EXISTS, NULL, NULL } };
+    BROKER_LINK_FILTER definition = { conditions, 1 };
+
+    ///act
+    auto filter = LinkFilter_Create(&definition);
+
+    ///assert
+    ASSERT_IS_NULL(filter);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_LINK_FILTER_13_002: [ If a condition has no name, has an operation that is not a BROKER_FILTER_OPERATION or, unless its operation is BROKER_FILTER_EXISTS or BROKER_FILTER_PARTITION, has no value, LinkFilter_Create shall return NULL. ]*/
+TEST_FUNCTION(LinkFilter_Create_with_an_invalid_operation_returns_NULL)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    BROKER_FILTER_CONDITION conditions[] = { { (BROKER_FILTER_OPERATION)42, "source", "bleTelemetry" } };
+    BROKER_LINK_FILTER definition = { conditions, 1 };
+
+    ///act
+    auto filter = LinkFilter_Create(&definition);
+
+    ///assert
+    ASSERT_IS_NULL(filter);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_LINK_FILTER_13_002: [ If a condition has no name, has an operation that is not a BROKER_FILTER_OPERATION or, unless its operation is BROKER_FILTER_EXISTS or BROKER_FILTER_PARTITION, has no value, LinkFilter_Create shall return NULL. ]*/
+TEST_FUNCTION(LinkFilter_Create_with_an_equality_without_value_returns_NULL)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    BROKER_FILTER_CONDITION conditions[] = { { BROKER_FILTER_EXISTS, "macAddress", NULL }, { BROKER_FILTER_EQUALS, "source", NULL } };
+    BROKER_LINK_FILTER definition = { conditions, 2 };
+
+    ///act
+    auto filter = LinkFilter_Create(&definition);
+
+    ///assert
+    ASSERT_IS_NULL(filter);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_LINK_FILTER_13_003: [ If the size of the filter overflows or the allocation fails, LinkFilter_Create shall return NULL. ]*/
+TEST_FUNCTION(LinkFilter_Create_fails_when_malloc_fails)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn((void*)NULL);
+
+    ///act
+    auto filter = LinkFilter_Create(&ble_filter);
+
+    ///assert
+    ASSERT_IS_NULL(filter);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_LINK_FILTER_13_003: [ If the size of the filter overflows or the allocation fails, LinkFilter_Create shall return NULL. ]*/
+TEST_FUNCTION(LinkFilter_Create_fails_when_the_size_overflows)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    BROKER_LINK_FILTER definition = { ble_conditions, SIZE_MAX / sizeof(BROKER_FILTER_CONDITION) };
+
+    ///act
+    auto filter = LinkFilter_Create(&definition);
+
+    ///assert
+    ASSERT_IS_NULL(filter);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_LINK_FILTER_13_004: [ LinkFilter_Create shall copy the conditions of definition, their strings and the lengths of their values in one allocation. ]*/
+/*Tests_SRS_LINK_FILTER_13_006: [ LinkFilter_GetDefinition shall return the copy of the definition held by filter, or NULL if filter is NULL. ]*/
+TEST_FUNCTION(LinkFilter_Create_copies_the_definition)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    char device_name[] = "sensor-";
+    BROKER_FILTER_CONDITION conditions[] = { { BROKER_FILTER_PREFIX, "deviceName", device_name }, { BROKER_FILTER_EXISTS, "macAddress", "ignored" } };
+    BROKER_LINK_FILTER definition = { conditions, 2 };
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto filter = LinkFilter_Create(&definition);
+    device_name[0] = 'S';
+
+    ///assert
+    ASSERT_IS_NOT_NULL(filter);
+    mocks.AssertActualAndExpectedCalls();
+    auto copy = LinkFilter_GetDefinition(filter);
+    ASSERT_IS_NOT_NULL(copy);
+    ASSERT_ARE_EQUAL(size_t, 2, copy->condition_count);
+    ASSERT_ARE_EQUAL(int, (int)BROKER_FILTER_PREFIX, (int)copy->conditions[0].operation);
+    ASSERT_ARE_EQUAL(char_ptr, "deviceName", copy->conditions[0].name);
+    ASSERT_ARE_EQUAL(char_ptr, "sensor-", copy->conditions[0].value);
+    ASSERT_ARE_EQUAL(int, (int)BROKER_FILTER_EXISTS, (int)copy->conditions[1].operation);
+    ASSERT_ARE_EQUAL(char_ptr, "macAddress", copy->conditions[1].name);
+    ASSERT_ARE_EQUAL(char_ptr, "", copy->conditions[1].value);
+
+    ///cleanup
+    LinkFilter_Destroy(filter);
+}
+
+/*Tests_SRS_LINK_FILTER_13_005: [ LinkFilter_Destroy shall free the filter, and do nothing if it is NULL. ]*/
+TEST_FUNCTION(LinkFilter_Destroy_frees_the_filter)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    auto filter = LinkFilter_Create(&ble_filter);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(filter));
+
+    ///act
+    LinkFilter_Destroy(filter);
+    LinkFilter_Destroy(NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_LINK_FILTER_13_006: [ LinkFilter_GetDefinition shall return the copy of the definition held by filter, or NULL if filter is NULL. ]*/
+TEST_FUNCTION(LinkFilter_GetDefinition_with_NULL_filter_returns_NULL)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+
+    ///act
+    auto definition = LinkFilter_GetDefinition(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(definition);
+}
+
+/*Tests_SRS_LINK_FILTER_13_007: [ If filter or definition is NULL, LinkFilter_IsSameAs shall return a non-zero value if both are NULL and 0 otherwise. ]*/
+TEST_FUNCTION(LinkFilter_IsSameAs_compares_NULL_filters)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    auto filter = LinkFilter_Create(&ble_filter);
+    mocks.ResetAllCalls();
+
+    ///act
+    auto both_null = LinkFilter_IsSameAs(NULL, NULL);
+    auto null_filter = LinkFilter_IsSameAs(NULL, &ble_filter);
+    auto null_definition = LinkFilter_IsSameAs(filter, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, both_null);
+    ASSERT_ARE_EQUAL(int, 0, null_filter);
+    ASSERT_ARE_EQUAL(int, 0, null_definition);
+
+    ///cleanup
+    LinkFilter_Destroy(filter);
+}
+
+/*Tests_SRS_LINK_FILTER_13_008: [ Otherwise LinkFilter_IsSameAs shall return a non-zero value if definition has the same number of conditions as filter and each of them has the same operation, name and, unless the operation is BROKER_FILTER_EXISTS or BROKER_FILTER_PARTITION, value as the condition of filter at the same position, and 0 otherwise. ]*/
+TEST_FUNCTION(LinkFilter_IsSameAs_compares_the_conditions)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    auto filter = LinkFilter_Create(&ble_filter);
+    BROKER_FILTER_CONDITION same[] =
+    {
+        { BROKER_FILTER_EQUALS, "source", "bleTelemetry" },
+        { BROKER_FILTER_PREFIX, "deviceName", "sensor-" },
+        { BROKER_FILTER_EXISTS, "macAddress", "whatever" }
+    };
+    BROKER_FILTER_CONDITION other_value[] =
+    {
+        { BROKER_FILTER_EQUALS, "source", "bleTelemetry" },
+        { BROKER_FILTER_PREFIX, "deviceName", "probe-" },
+        { BROKER_FILTER_EXISTS, "macAddress", NULL }
+    };
+    BROKER_LINK_FILTER same_definition = { same, 3 };
+    BROKER_LINK_FILTER other_value_definition = { other_value, 3 };
+    BROKER_LINK_FILTER fewer_conditions = { same, 2 };
+    mocks.ResetAllCalls();
+
+    ///act
+    auto is_same = LinkFilter_IsSameAs(filter, &same_definition);
+    auto is_other_value = LinkFilter_IsSameAs(filter, &other_value_definition);
+    auto is_fewer_conditions = LinkFilter_IsSameAs(filter, &fewer_conditions);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, is_same);
+    ASSERT_ARE_EQUAL(int, 0, is_other_value);
+    ASSERT_ARE_EQUAL(int, 0, is_fewer_conditions);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    LinkFilter_Destroy(filter);
+}
+
+/*Tests_SRS_LINK_FILTER_13_009: [ If filter is NULL, LinkFilter_Matches shall return a non-zero value. ]*/
+TEST_FUNCTION(LinkFilter_Matches_with_NULL_filter_passes_every_message)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+
+    ///act
+    auto result = LinkFilter_Matches(NULL, (MESSAGE_HANDLE)ble_message);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_LINK_FILTER_13_010: [ LinkFilter_Matches shall get the value of the property of every condition by calling Message_GetProperty, in order, and return 0 as soon as a condition does not pass. ]*/
+/*Tests_SRS_LINK_FILTER_13_011: [ A BROKER_FILTER_EXISTS condition shall pass when the message has the property, a BROKER_FILTER_EQUALS condition when the value of the property is the value of the condition and a BROKER_FILTER_PREFIX condition when the value of the property starts with the value of the condition. ]*/
+/*Tests_SRS_LINK_FILTER_13_012: [ LinkFilter_Matches shall return a non-zero value if all the conditions pass. ]*/
+TEST_FUNCTION(LinkFilter_Matches_passes_a_message_that_passes_all_the_conditions)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    auto filter = LinkFilter_Create(&ble_filter);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Message_GetProperty((MESSAGE_HANDLE)ble_message, "source"));
+    STRICT_EXPECTED_CALL(mocks, Message_GetProperty((MESSAGE_HANDLE)ble_message, "deviceName"));
+    STRICT_EXPECTED_CALL(mocks, Message_GetProperty((MESSAGE_HANDLE)ble_message, "macAddress"));
+
+    ///act
+    auto result = LinkFilter_Matches(filter, (MESSAGE_HANDLE)ble_message);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    LinkFilter_Destroy(filter);
+}
+
+/*Tests_SRS_LINK_FILTER_13_010: [ LinkFilter_Matches shall get the value of the property of every condition by calling Message_GetProperty, in order, and return 0 as soon as a condition does not pass. ]*/
+/*Tests_SRS_LINK_FILTER_13_011: [ A BROKER_FILTER_EXISTS condition shall pass when the message has the property, a BROKER_FILTER_EQUALS condition when the value of the property is the value of the condition and a BROKER_FILTER_PREFIX condition when the value of the property starts with the value of the condition. ]*/
+TEST_FUNCTION(LinkFilter_Matches_stops_at_a_value_that_differs)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    FAKE_PROPERTY message[] = { { "source", "bleTelemetry" }, { "deviceName", "probe-kitchen" }, { NULL, NULL } };
+    auto filter = LinkFilter_Create(&ble_filter);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Message_GetProperty((MESSAGE_HANDLE)message, "source"));
+    STRICT_EXPECTED_CALL(mocks, Message_GetProperty((MESSAGE_HANDLE)message, "deviceName"));
+
+    ///act
+    auto result = LinkFilter_Matches(filter, (MESSAGE_HANDLE)message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    LinkFilter_Destroy(filter);
+}
+
+/*Tests_SRS_LINK_FILTER_13_011: [ A BROKER_FILTER_EXISTS condition shall pass when the message has the property, a BROKER_FILTER_EQUALS condition when the value of the property is the value of the condition and a BROKER_FILTER_PREFIX condition when the value of the property starts with the value of the condition. ]*/
+TEST_FUNCTION(LinkFilter_Matches_fails_a_message_without_the_property)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    FAKE_PROPERTY message[] = { { "source", "bleTelemetry" }, { "deviceName", "sensor-kitchen" }, { NULL, NULL } };
+    auto filter = LinkFilter_Create(&ble_filter);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Message_GetProperty((MESSAGE_HANDLE)message, "source"));
+    STRICT_EXPECTED_CALL(mocks, Message_GetProperty((MESSAGE_HANDLE)message, "deviceName"));
+    STRICT_EXPECTED_CALL(mocks, Message_GetProperty((MESSAGE_HANDLE)message, "macAddress"));
+
+    ///act
+    auto result = LinkFilter_Matches(filter, (MESSAGE_HANDLE)message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    LinkFilter_Destroy(filter);
+}
+
+/*Tests_SRS_LINK_FILTER_13_011: [ A BROKER_FILTER_EXISTS condition shall pass when the message has the property, a BROKER_FILTER_EQUALS condition when the value of the property is the value of the condition and a BROKER_FILTER_PREFIX condition when the value of the property starts with the value of the condition. ]*/
+TEST_FUNCTION(LinkFilter_Matches_compares_the_whole_value_for_equality)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    FAKE_PROPERTY message[] = { { "source", "bleTelemetryV2" }, { NULL, NULL } };
+    auto filter = LinkFilter_Create(&ble_filter);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Message_GetProperty((MESSAGE_HANDLE)message, "source"));
+
+    ///act
+    auto result = LinkFilter_Matches(filter, (MESSAGE_HANDLE)message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    LinkFilter_Destroy(filter);
+}
+
+/*Tests_SRS_LINK_FILTER_13_013: [ If a condition has the operation BROKER_FILTER_PARTITION and its partition_count is 0 or its partition is not less than its partition_count, LinkFilter_Create shall return NULL. ]*/
+TEST_FUNCTION(LinkFilter_Create_with_an_invalid_partition_returns_NULL)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    BROKER_FILTER_CONDITION no_partitions[] = { { BROKER_FILTER_PARTITION, "macAddress", NULL, 0, 0 } };
+    BROKER_FILTER_CONDITION out_of_range[] = { { BROKER_FILTER_PARTITION, "macAddress", NULL, 4, 4 } };
+    BROKER_LINK_FILTER no_partitions_definition = { no_partitions, 1 };
+    BROKER_LINK_FILTER out_of_range_definition = { out_of_range, 1 };
+
+    ///act
+    auto no_partitions_filter = LinkFilter_Create(&no_partitions_definition);
+    auto out_of_range_filter = LinkFilter_Create(&out_of_range_definition);
+
+    ///assert
+    ASSERT_IS_NULL(no_partitions_filter);
+    ASSERT_IS_NULL(out_of_range_filter);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_LINK_FILTER_13_015: [ Two BROKER_FILTER_PARTITION conditions shall only be the same if they have the same partition and partition_count. ]*/
+TEST_FUNCTION(LinkFilter_IsSameAs_compares_the_partitions)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    BROKER_FILTER_CONDITION partition[] = { { BROKER_FILTER_PARTITION, "macAddress", NULL, 1, 4 } };
+    BROKER_FILTER_CONDITION same[] = { { BROKER_FILTER_PARTITION, "macAddress", "ignored", 1, 4 } };
+    BROKER_FILTER_CONDITION other_partition[] = { { BROKER_FILTER_PARTITION, "macAddress", NULL, 2, 4 } };
+    BROKER_FILTER_CONDITION other_count[] = { { BROKER_FILTER_PARTITION, "macAddress", NULL, 1, 3 } };
+    BROKER_LINK_FILTER definition = { partition, 1 };
+    BROKER_LINK_FILTER same_definition = { same, 1 };
+    BROKER_LINK_FILTER other_partition_definition = { other_partition, 1 };
+    BROKER_LINK_FILTER other_count_definition = { other_count, 1 };
+    auto filter = LinkFilter_Create(&definition);
+    mocks.ResetAllCalls();
+
+    ///act
+    auto is_same = LinkFilter_IsSameAs(filter, &same_definition);
+    auto is_other_partition = LinkFilter_IsSameAs(filter, &other_partition_definition);
+    auto is_other_count = LinkFilter_IsSameAs(filter, &other_count_definition);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, is_same);
+    ASSERT_ARE_EQUAL(int, 0, is_other_partition);
+    ASSERT_ARE_EQUAL(int, 0, is_other_count);
+
+    ///cleanup
+    LinkFilter_Destroy(filter);
+}
+
+/*Tests_SRS_LINK_FILTER_13_014: [ A BROKER_FILTER_PARTITION condition shall pass when the 32 bit FNV-1a hash of the value of the property, or of an empty value if the message does not have the property, modulo partition_count is partition. ]*/
+TEST_FUNCTION(LinkFilter_Matches_puts_a_value_in_exactly_one_partition)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    FAKE_PROPERTY no_key_message[] = { { "source", "bleTelemetry" }, { NULL, NULL } };
+    BROKER_FILTER_CONDITION conditions[4];
+    LINK_FILTER_HANDLE filters[4];
+    size_t matches = 0;
+    size_t no_key_partition = 4;
+    size_t i;
+    for (i = 0; i < 4; i++)
+    {
+        BROKER_LINK_FILTER definition = { &conditions[i], 1 };
+        conditions[i].operation = BROKER_FILTER_PARTITION;
+        conditions[i].name = "macAddress";
+        conditions[i].value = NULL;
+        conditions[i].partition = i;
+        conditions[i].partition_count = 4;
+        filters[i] = LinkFilter_Create(&definition);
+    }
+    mocks.ResetAllCalls();
+
+    ///act
+    for (i = 0; i < 4; i++)
+    {
+        if (LinkFilter_Matches(filters[i], (MESSAGE_HANDLE)ble_message) != 0)
+        {
+            matches++;
+        }
+        if (LinkFilter_Matches(filters[i], (MESSAGE_HANDLE)no_key_message) != 0)
+        {
+            no_key_partition = i;
+        }
+    }
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, matches);
+    /*the FNV-1a hash of an empty value is its offset basis, 2166136261*/
+    ASSERT_ARE_EQUAL(size_t, (size_t)(2166136261u % 4), no_key_partition);
+
+    ///cleanup
+    for (i = 0; i < 4; i++)
+    {
+        LinkFilter_Destroy(filters[i]);
+    }
+}
+
+/*Tests_SRS_LINK_FILTER_13_016: [ LinkFilter_InitMessage shall set the message of filter_message and forget every property, and do nothing if filter_message is NULL. ]*/
+/*Tests_SRS_LINK_FILTER_13_019: [ LinkFilter_MatchesMessage shall call Message_GetProperty only for the properties filter_message does not remember, and shall remember the first LINK_FILTER_MESSAGE_PROPERTY_COUNT properties it looks up. ]*/
+TEST_FUNCTION(LinkFilter_MatchesMessage_looks_a_property_up_once_for_all_the_filters)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    BROKER_FILTER_CONDITION source_condition[] = { { BROKER_FILTER_EQUALS, "source", "bleTelemetry" } };
+    BROKER_FILTER_CONDITION other_source_condition[] = { { BROKER_FILTER_EQUALS, "source", "simulator" } };
+    BROKER_LINK_FILTER source_definition = { source_condition, 1 };
+    BROKER_LINK_FILTER other_source_definition = { other_source_condition, 1 };
+    auto filter = LinkFilter_Create(&ble_filter);
+    auto source_filter = LinkFilter_Create(&source_definition);
+    auto other_source_filter = LinkFilter_Create(&other_source_definition);
+    LINK_FILTER_MESSAGE filter_message;
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Message_GetProperty((MESSAGE_HANDLE)ble_message, "source"));
+    STRICT_EXPECTED_CALL(mocks, Message_GetProperty((MESSAGE_HANDLE)ble_message, "deviceName"));
+    STRICT_EXPECTED_CALL(mocks, Message_GetProperty((MESSAGE_HANDLE)ble_message, "macAddress"));
+
+    ///act
+    LinkFilter_InitMessage(&filter_message, (MESSAGE_HANDLE)ble_message);
+    auto result = LinkFilter_MatchesMessage(filter, &filter_message);
+    auto source_result = LinkFilter_MatchesMessage(source_filter, &filter_message);
+    auto other_source_result = LinkFilter_MatchesMessage(other_source_filter, &filter_message);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_NOT_EQUAL(int, 0, source_result);
+    ASSERT_ARE_EQUAL(int, 0, other_source_result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    LinkFilter_Destroy(filter);
+    LinkFilter_Destroy(source_filter);
+    LinkFilter_Destroy(other_source_filter);
+}
+
+/*Tests_SRS_LINK_FILTER_13_017: [ LinkFilter_MatchesMessage shall hash the value of a property at most once per LINK_FILTER_MESSAGE, and test every BROKER_FILTER_PARTITION condition on that property against the same hash. ]*/
+TEST_FUNCTION(LinkFilter_MatchesMessage_puts_a_message_in_the_same_partition_as_LinkFilter_Matches)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    BROKER_FILTER_CONDITION conditions[4];
+    LINK_FILTER_HANDLE filters[4];
+    int expected[4];
+    LINK_FILTER_MESSAGE filter_message;
+    size_t i;
+    for (i = 0; i < 4; i++)
+    {
+        BROKER_LINK_FILTER definition = { &conditions[i], 1 };
+        conditions[i].operation = BROKER_FILTER_PARTITION;
+        conditions[i].name = "macAddress";
+        conditions[i].value = NULL;
+        conditions[i].partition = i;
+        conditions[i].partition_count = 4;
+        filters[i] = LinkFilter_Create(&definition);
+        expected[i] = (LinkFilter_Matches(filters[i], (MESSAGE_HANDLE)ble_message) != 0);
+    }
+    LinkFilter_InitMessage(&filter_message, (MESSAGE_HANDLE)ble_message);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Message_GetProperty((MESSAGE_HANDLE)ble_message, "macAddress"));
+
+    ///act
+    size_t matches = 0;
+    int same_partition = 1;
+    for (i = 0; i < 4; i++)
+    {
+        int matched = LinkFilter_MatchesMessage(filters[i], &filter_message);
+        if (matched != 0)
+        {
+            matches++;
+        }
+        if ((matched != 0) != expected[i])
+        {
+            same_partition = 0;
+        }
+    }
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, matches);
+    ASSERT_ARE_NOT_EQUAL(int, 0, same_partition);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    for (i = 0; i < 4; i++)
+    {
+        LinkFilter_Destroy(filters[i]);
+    }
+}
+
+/*Tests_SRS_LINK_FILTER_13_009: [ If filter is NULL, LinkFilter_Matches shall return a non-zero value. ]*/
+/*Tests_SRS_LINK_FILTER_13_018: [ If filter is not NULL and filter_message is NULL, LinkFilter_MatchesMessage shall return 0. ]*/
+TEST_FUNCTION(LinkFilter_MatchesMessage_with_NULL_filter_message_fails_a_filter)
+{
+    ///arrange
+    CLinkFilterMocks mocks;
+    auto filter = LinkFilter_Create(&ble_filter);
+    mocks.ResetAllCalls();
+
+    ///act
+    auto no_filter_result = LinkFilter_MatchesMessage(NULL, NULL);
+    auto result = LinkFilter_MatchesMessage(filter, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, no_filter_result);
+    ASSERT_ARE_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    LinkFilter_Destroy(filter);
+}
+
+END_TEST_SUITE(link_filter_ut)
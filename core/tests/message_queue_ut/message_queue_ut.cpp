@@ -0,0 +1,375 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cstdlib>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "micromock.h"
+#include "micromockcharstararenullterminatedstrings.h"
+#include "azure_c_shared_utility/lock.h"
+
+#include "message.h"
+#include "internal/message_queue.h"
+
+#define GBALLOC_H
+
+extern "C" int gballoc_init(void);
+extern "C" void gballoc_deinit(void);
+extern "C" void* gballoc_malloc(size_t size);
+extern "C" void* gballoc_calloc(size_t nmemb, size_t size);
+extern "C" void* gballoc_realloc(void* ptr, size_t size);
+extern "C" void gballoc_free(void* ptr);
+
+namespace BASEIMPLEMENTATION
+{
+    /*if malloc is defined as gballoc_malloc at this moment, there'd be serious trouble*/
+
+#define Lock(x) (LOCK_OK + gballocState - gballocState) /*compiler warning about constant in if condition*/
+#define Unlock(x) (LOCK_OK + gballocState - gballocState)
+#define Lock_Init() (LOCK_HANDLE)0x42
+#define Lock_Deinit(x) (LOCK_OK + gballocState - gballocState)
+#include "gballoc.c"
+#undef Lock
+#undef Unlock
+#undef Lock_Init
+#undef Lock_Deinit
+};
+
+static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
+static MICROMOCK_MUTEX_HANDLE g_testByTest;
+
+#define FAKE_MESSAGE(i) ((MESSAGE_HANDLE)(uintptr_t)(0x1000 + (i)))
+
+TYPED_MOCK_CLASS(CMessageQueueMocks, CGlobalMock)
+{
+public:
+    MOCK_STATIC_METHOD_1(, void*, gballoc_malloc, size_t, size)
+    MOCK_METHOD_END(void*, BASEIMPLEMENTATION::gballoc_malloc(size));
+
+    MOCK_STATIC_METHOD_2(, void*, gballoc_realloc, void*, ptr, size_t, size)
+    MOCK_METHOD_END(void*, BASEIMPLEMENTATION::gballoc_realloc(ptr, size));
+
+    MOCK_STATIC_METHOD_1(, void, gballoc_free, void*, ptr)
+        BASEIMPLEMENTATION::gballoc_free(ptr);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_1(, void, Message_Destroy, MESSAGE_HANDLE, message)
+    MOCK_VOID_METHOD_END()
+};
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CMessageQueueMocks, , void*, gballoc_malloc, size_t, size);
+DECLARE_GLOBAL_MOCK_METHOD_2(CMessageQueueMocks, , void*, gballoc_realloc, void*, ptr, size_t, size);
+DECLARE_GLOBAL_MOCK_METHOD_1(CMessageQueueMocks, , void, gballoc_free, void*, ptr);
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CMessageQueueMocks, , void, Message_Destroy, MESSAGE_HANDLE, message);
+
+BEGIN_TEST_SUITE(message_queue_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = MicroMockCreateMutex();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    MicroMockDestroyMutex(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (!MicroMockAcquireMutex(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    if (!MicroMockReleaseMutex(g_testByTest))
+    {
+        ASSERT_FAIL("failure in test framework at ReleaseMutex");
+    }
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_13_001: [MessageQueue_Create shall allocate a new MESSAGE_QUEUE and return NULL if it fails.]*/
+/*Tests_SRS_MESSAGE_QUEUE_13_002: [MessageQueue_Create shall return an empty queue that has no storage allocated.]*/
+TEST_FUNCTION(MessageQueue_Create_succeeds)
+{
+    ///arrange
+    CMessageQueueMocks mocks;
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto queue = MessageQueue_Create();
+
+    ///assert
+    ASSERT_IS_NOT_NULL(queue);
+    ASSERT_ARE_EQUAL(size_t, 0, MessageQueue_Size(queue));
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    MessageQueue_Destroy(queue);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_13_001: [MessageQueue_Create shall allocate a new MESSAGE_QUEUE and return NULL if it fails.]*/
+TEST_FUNCTION(MessageQueue_Create_fails_when_malloc_fails)
+{
+    ///arrange
+    CMessageQueueMocks mocks;
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn((void*)NULL);
+
+    ///act
+    auto queue = MessageQueue_Create();
+
+    ///assert
+    ASSERT_IS_NULL(queue);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_13_003: [If queue is NULL, MessageQueue_Destroy shall do nothing.]*/
+TEST_FUNCTION(MessageQueue_Destroy_does_nothing_with_null_queue)
+{
+    ///arrange
+    CMessageQueueMocks mocks;
+
+    ///act
+    MessageQueue_Destroy(NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_13_004: [MessageQueue_Destroy shall call Message_Destroy on every message still in the queue.]*/
+/*Tests_SRS_MESSAGE_QUEUE_13_005: [MessageQueue_Destroy shall free all the resources used by the queue.]*/
+TEST_FUNCTION(MessageQueue_Destroy_destroys_queued_messages)
+{
+    ///arrange
+    CMessageQueueMocks mocks;
+    auto queue = MessageQueue_Create();
+    (void)MessageQueue_Push(queue, FAKE_MESSAGE(1));
+    (void)MessageQueue_Push(queue, FAKE_MESSAGE(2));
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(FAKE_MESSAGE(1)));
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(FAKE_MESSAGE(2)));
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(queue));
+
+    ///act
+    MessageQueue_Destroy(queue);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_13_006: [If queue or message is NULL, MessageQueue_Push shall fail and return a non-zero value.]*/
+TEST_FUNCTION(MessageQueue_Push_fails_with_null_args)
+{
+    ///arrange
+    CMessageQueueMocks mocks;
+    auto queue = MessageQueue_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto r1 = MessageQueue_Push(NULL, FAKE_MESSAGE(1));
+    auto r2 = MessageQueue_Push(queue, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, r1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, r2);
+    ASSERT_ARE_EQUAL(size_t, 0, MessageQueue_Size(queue));
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    MessageQueue_Destroy(queue);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_13_007: [If the queue is full, MessageQueue_Push shall double its capacity, keeping the messages in order.]*/
+/*Tests_SRS_MESSAGE_QUEUE_13_009: [MessageQueue_Push shall store message at the back of the queue and return 0.]*/
+TEST_FUNCTION(MessageQueue_Push_grows_only_when_full)
+{
+    ///arrange
+    CMessageQueueMocks mocks;
+    auto queue = MessageQueue_Create();
+    mocks.ResetAllCalls();
+
+    /*the first push allocates room for 16 messages, the 17th push doubles it*/
+    EXPECTED_CALL(mocks, gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .ExpectedTimesExactly(2);
+
+    ///act
+    for (size_t i = 0; i < 17; i++)
+    {
+        ASSERT_ARE_EQUAL(int, 0, MessageQueue_Push(queue, FAKE_MESSAGE(i)));
+    }
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 17, MessageQueue_Size(queue));
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    while (MessageQueue_Pop(queue) != NULL);
+    MessageQueue_Destroy(queue);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_13_007: [If the queue is full, MessageQueue_Push shall double its capacity, keeping the messages in order.]*/
+/*Tests_SRS_MESSAGE_QUEUE_13_011: [MessageQueue_Pop shall remove the message at the front of the queue and return it.]*/
+TEST_FUNCTION(MessageQueue_keeps_order_when_growing_a_wrapped_queue)
+{
+    ///arrange
+    CMessageQueueMocks mocks;
+    auto queue = MessageQueue_Create();
+    size_t next_push = 0, next_pop = 0;
+
+    /*fill the queue, pop a few so that head moves and then wrap around*/
+    for (; next_push < 16; next_push++)
+    {
+        (void)MessageQueue_Push(queue, FAKE_MESSAGE(next_push));
+    }
+    for (; next_pop < 5; next_pop++)
+    {
+        ASSERT_ARE_EQUAL(void_ptr, FAKE_MESSAGE(next_pop), MessageQueue_Pop(queue));
+    }
+    for (; next_push < 21; next_push++)
+    {
+        (void)MessageQueue_Push(queue, FAKE_MESSAGE(next_push));
+    }
+
+    ///act
+    for (; next_push < 40; next_push++)
+    {
+        ASSERT_ARE_EQUAL(int, 0, MessageQueue_Push(queue, FAKE_MESSAGE(next_push)));
+    }
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, next_push - next_pop, MessageQueue_Size(queue));
+    for (; next_pop < next_push; next_pop++)
+    {
+        ASSERT_ARE_EQUAL(void_ptr, FAKE_MESSAGE(next_pop), MessageQueue_Pop(queue));
+    }
+    ASSERT_IS_NULL(MessageQueue_Pop(queue));
+
+    ///cleanup
+    MessageQueue_Destroy(queue);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_13_008: [If growing the queue fails, MessageQueue_Push shall fail and return a non-zero value, leaving the queue unchanged.]*/
+TEST_FUNCTION(MessageQueue_Push_fails_when_realloc_fails)
+{
+    ///arrange
+    CMessageQueueMocks mocks;
+    auto queue = MessageQueue_Create();
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_realloc(NULL, IGNORED_NUM_ARG))
+        .IgnoreArgument(2)
+        .SetFailReturn((void*)NULL);
+
+    ///act
+    auto result = MessageQueue_Push(queue, FAKE_MESSAGE(1));
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, MessageQueue_Size(queue));
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    MessageQueue_Destroy(queue);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_13_010: [If queue is NULL or empty, MessageQueue_Pop shall return NULL.]*/
+TEST_FUNCTION(MessageQueue_Pop_returns_NULL_when_empty)
+{
+    ///arrange
+    CMessageQueueMocks mocks;
+    auto queue = MessageQueue_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto m1 = MessageQueue_Pop(NULL);
+    auto m2 = MessageQueue_Pop(queue);
+
+    ///assert
+    ASSERT_IS_NULL(m1);
+    ASSERT_IS_NULL(m2);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    MessageQueue_Destroy(queue);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_13_012: [MessageQueue_Size shall return the number of messages in the queue, or 0 if queue is NULL.]*/
+TEST_FUNCTION(MessageQueue_Size_returns_0_with_null_queue)
+{
+    ///arrange
+    CMessageQueueMocks mocks;
+
+    ///act
+    auto result = MessageQueue_Size(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_13_013: [If queue1 or queue2 is NULL, MessageQueue_Swap shall do nothing.]*/
+TEST_FUNCTION(MessageQueue_Swap_does_nothing_with_null_queue)
+{
+    ///arrange
+    CMessageQueueMocks mocks;
+    auto queue = MessageQueue_Create();
+    (void)MessageQueue_Push(queue, FAKE_MESSAGE(1));
+    mocks.ResetAllCalls();
+
+    ///act
+    MessageQueue_Swap(queue, NULL);
+    MessageQueue_Swap(NULL, queue);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, MessageQueue_Size(queue));
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    (void)MessageQueue_Pop(queue);
+    MessageQueue_Destroy(queue);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_13_014: [MessageQueue_Swap shall exchange the content of queue1 and queue2 without copying any message.]*/
+TEST_FUNCTION(MessageQueue_Swap_exchanges_the_queues)
+{
+    ///arrange
+    CMessageQueueMocks mocks;
+    auto queue1 = MessageQueue_Create();
+    auto queue2 = MessageQueue_Create();
+    (void)MessageQueue_Push(queue1, FAKE_MESSAGE(1));
+    (void)MessageQueue_Push(queue1, FAKE_MESSAGE(2));
+    mocks.ResetAllCalls();
+
+    ///act
+    MessageQueue_Swap(queue1, queue2);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, 0, MessageQueue_Size(queue1));
+    ASSERT_ARE_EQUAL(size_t, 2, MessageQueue_Size(queue2));
+    ASSERT_ARE_EQUAL(void_ptr, FAKE_MESSAGE(1), MessageQueue_Pop(queue2));
+    ASSERT_ARE_EQUAL(void_ptr, FAKE_MESSAGE(2), MessageQueue_Pop(queue2));
+
+    ///cleanup
+    MessageQueue_Destroy(queue1);
+    MessageQueue_Destroy(queue2);
+}
+
+END_TEST_SUITE(message_queue_ut)
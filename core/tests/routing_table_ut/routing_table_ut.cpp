@@ -0,0 +1,745 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cstdlib>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <cstdint>
+
+#include "testrunnerswitcher.h"
+#include "micromock.h"
+#include "micromockcharstararenullterminatedstrings.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+
+#include "internal/routing_table.h"
+
+#define GBALLOC_H
+
+extern "C" int gballoc_init(void);
+extern "C" void gballoc_deinit(void);
+extern "C" void* gballoc_malloc(size_t size);
+extern "C" void* gballoc_calloc(size_t nmemb, size_t size);
+extern "C" void* gballoc_realloc(void* ptr, size_t size);
+extern "C" void gballoc_free(void* ptr);
+
+namespace BASEIMPLEMENTATION
+{
+    /*if malloc is defined as gballoc_malloc at this moment, there'd be serious trouble*/
+
+#define Lock(x) (LOCK_OK + gballocState - gballocState) /*compiler warning about constant in if condition*/
+#define Unlock(x) (LOCK_OK + gballocState - gballocState)
+#define Lock_Init() (LOCK_HANDLE)0x42
+#define Lock_Deinit(x) (LOCK_OK + gballocState - gballocState)
+#include "gballoc.c"
+#undef Lock
+#undef Unlock
+#undef Lock_Init
+#undef Lock_Deinit
+};
+
+static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
+static MICROMOCK_MUTEX_HANDLE g_testByTest;
+
+/*a mocked wait cannot block: it plays the publisher that releases the snapshot RoutingTable_Swap waits for*/
+static ROUTING_TABLE_HANDLE table_to_release;
+static ROUTING_SNAPSHOT_HANDLE snapshot_to_release;
+static size_t condition_wait_calls;
+static COND_RESULT condition_wait_result;
+
+static void* sink1 = (void*)0x101;
+static void* sink2 = (void*)0x102;
+
+TYPED_MOCK_CLASS(CRoutingTableMocks, CGlobalMock)
+{
+public:
+    MOCK_STATIC_METHOD_1(, void*, gballoc_malloc, size_t, size)
+    MOCK_METHOD_END(void*, BASEIMPLEMENTATION::gballoc_malloc(size));
+
+    MOCK_STATIC_METHOD_1(, void, gballoc_free, void*, ptr)
+        BASEIMPLEMENTATION::gballoc_free(ptr);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_0(, LOCK_HANDLE, Lock_Init)
+    MOCK_METHOD_END(LOCK_HANDLE, (LOCK_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1));
+
+    MOCK_STATIC_METHOD_1(, LOCK_RESULT, Lock, LOCK_HANDLE, handle)
+    MOCK_METHOD_END(LOCK_RESULT, LOCK_OK);
+
+    MOCK_STATIC_METHOD_1(, LOCK_RESULT, Unlock, LOCK_HANDLE, handle)
+    MOCK_METHOD_END(LOCK_RESULT, LOCK_OK);
+
+    MOCK_STATIC_METHOD_1(, LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle)
+        BASEIMPLEMENTATION::gballoc_free(handle);
+    MOCK_METHOD_END(LOCK_RESULT, LOCK_OK);
+
+    MOCK_STATIC_METHOD_0(, COND_HANDLE, Condition_Init)
+    MOCK_METHOD_END(COND_HANDLE, (COND_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1));
+
+    MOCK_STATIC_METHOD_1(, COND_RESULT, Condition_Post, COND_HANDLE, handle)
+    MOCK_METHOD_END(COND_RESULT, COND_OK);
+
+    MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds)
+        condition_wait_calls++;
+        if (snapshot_to_release != NULL)
+        {
+            ROUTING_SNAPSHOT_HANDLE snapshot = snapshot_to_release;
+            snapshot_to_release = NULL;
+            RoutingTable_Release(table_to_release, snapshot);
+        }
+    MOCK_METHOD_END(COND_RESULT, condition_wait_result);
+
+    MOCK_STATIC_METHOD_1(, void, Condition_Deinit, COND_HANDLE, handle)
+        BASEIMPLEMENTATION::gballoc_free(handle);
+    MOCK_VOID_METHOD_END()
+};
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CRoutingTableMocks, , void*, gballoc_malloc, size_t, size);
+DECLARE_GLOBAL_MOCK_METHOD_1(CRoutingTableMocks, , void, gballoc_free, void*, ptr);
+
+DECLARE_GLOBAL_MOCK_METHOD_0(CRoutingTableMocks, , LOCK_HANDLE, Lock_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CRoutingTableMocks, , LOCK_RESULT, Lock, LOCK_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CRoutingTableMocks, , LOCK_RESULT, Unlock, LOCK_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CRoutingTableMocks, , LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle);
+
+DECLARE_GLOBAL_MOCK_METHOD_0(CRoutingTableMocks, , COND_HANDLE, Condition_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CRoutingTableMocks, , COND_RESULT, Condition_Post, COND_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_3(CRoutingTableMocks, , COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
+DECLARE_GLOBAL_MOCK_METHOD_1(CRoutingTableMocks, , void, Condition_Deinit, COND_HANDLE, handle);
+
+/*builds a snapshot of two modules, the first one routing to both sinks*/
+static ROUTING_SNAPSHOT_HANDLE create_two_module_snapshot(void)
+{
+    ROUTING_SNAPSHOT_HANDLE snapshot = RoutingSnapshot_Create(2, 2);
+    ROUTING_SINK* sinks = RoutingSnapshot_AddEntry(snapshot, (const void*)0x1, (void*)0x11, 2);
+    sinks[0].sink = sink1;
+    sinks[0].filter = NULL;
+    sinks[1].sink = sink2;
+    sinks[1].filter = (const void*)0x201;
+    (void)RoutingSnapshot_AddEntry(snapshot, (const void*)0x2, (void*)0x12, 0);
+    return snapshot;
+}
+
+BEGIN_TEST_SUITE(routing_table_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = MicroMockCreateMutex();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    MicroMockDestroyMutex(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (!MicroMockAcquireMutex(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    table_to_release = NULL;
+    snapshot_to_release = NULL;
+    condition_wait_calls = 0;
+    condition_wait_result = COND_OK;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    if (!MicroMockReleaseMutex(g_testByTest))
+    {
+        ASSERT_FAIL("failure in test framework at ReleaseMutex");
+    }
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_001: [ RoutingTable_Create shall allocate the table and create its lock and condition. ]*/
+/*Tests_SRS_ROUTING_TABLE_13_003: [ The table shall not have a snapshot. ]*/
+TEST_FUNCTION(RoutingTable_Create_succeeds_without_a_snapshot)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+
+    ///act
+    auto table = RoutingTable_Create();
+
+    ///assert
+    ASSERT_IS_NOT_NULL(table);
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_NULL(RoutingTable_Acquire(table));
+
+    ///cleanup
+    RoutingTable_Destroy(table);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_002: [ If any allocation or resource creation fails, RoutingTable_Create shall free every resource it created and return NULL. ]*/
+TEST_FUNCTION(RoutingTable_Create_fails_when_malloc_fails)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn((void*)NULL);
+
+    ///act
+    auto table = RoutingTable_Create();
+
+    ///assert
+    ASSERT_IS_NULL(table);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_002: [ If any allocation or resource creation fails, RoutingTable_Create shall free every resource it created and return NULL. ]*/
+TEST_FUNCTION(RoutingTable_Create_fails_when_Condition_Init_fails)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init())
+        .SetFailReturn((COND_HANDLE)NULL);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto table = RoutingTable_Create();
+
+    ///assert
+    ASSERT_IS_NULL(table);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_004: [ If table is NULL, RoutingTable_Destroy shall do nothing. ]*/
+TEST_FUNCTION(RoutingTable_Destroy_with_NULL_table_does_nothing)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+
+    ///act
+    RoutingTable_Destroy(NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_005: [ RoutingTable_Destroy shall free the current snapshot and all the resources used by the table. ]*/
+TEST_FUNCTION(RoutingTable_Destroy_frees_the_current_snapshot)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto table = RoutingTable_Create();
+    auto snapshot = create_two_module_snapshot();
+    RoutingTable_Swap(table, snapshot);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(snapshot));
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(table));
+
+    ///act
+    RoutingTable_Destroy(table);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_006: [ If table is NULL, RoutingTable_Swap shall destroy snapshot and return. ]*/
+TEST_FUNCTION(RoutingTable_Swap_with_NULL_table_destroys_the_snapshot)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto snapshot = RoutingSnapshot_Create(1, 0);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(snapshot));
+
+    ///act
+    RoutingTable_Swap(NULL, snapshot);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_007: [ RoutingTable_Swap shall make snapshot the current snapshot of the table with an atomic exchange under the table lock. ]*/
+/*Tests_SRS_ROUTING_TABLE_13_009: [ RoutingTable_Swap shall then free the previous snapshot. ]*/
+TEST_FUNCTION(RoutingTable_Swap_installs_the_snapshot_and_frees_the_previous_one)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto table = RoutingTable_Create();
+    auto previous = RoutingSnapshot_Create(1, 0);
+    auto snapshot = RoutingSnapshot_Create(1, 0);
+    RoutingTable_Swap(table, previous);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(previous));
+
+    ///act
+    RoutingTable_Swap(table, snapshot);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+    auto acquired = RoutingTable_Acquire(table);
+    ASSERT_ARE_EQUAL(void_ptr, snapshot, acquired);
+
+    ///cleanup
+    RoutingTable_Release(table, acquired);
+    RoutingTable_Destroy(table);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_008: [ RoutingTable_Swap shall drop the reference of the table to the previous snapshot and wait on the table condition until the previous snapshot has no reader. ]*/
+/*Tests_SRS_ROUTING_TABLE_13_015: [ If that drops the last reference to snapshot, which is then no longer current, RoutingTable_Release shall signal the table condition under the table lock. ]*/
+TEST_FUNCTION(RoutingTable_Swap_waits_for_the_readers_of_the_previous_snapshot)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto table = RoutingTable_Create();
+    auto previous = RoutingSnapshot_Create(1, 0);
+    RoutingTable_Swap(table, previous);
+    table_to_release = table;
+    snapshot_to_release = RoutingTable_Acquire(table);
+    mocks.ResetAllCalls();
+
+    ///act
+    RoutingTable_Swap(table, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, condition_wait_calls);
+    ASSERT_IS_NULL(snapshot_to_release);
+    ASSERT_IS_NULL(RoutingTable_Acquire(table));
+
+    ///cleanup
+    RoutingTable_Destroy(table);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_027: [ If waiting on the table condition fails, RoutingTable_Swap shall check the ref count of the previous snapshot again. ]*/
+TEST_FUNCTION(RoutingTable_Swap_frees_the_previous_snapshot_when_Condition_Wait_fails)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto table = RoutingTable_Create();
+    auto previous = RoutingSnapshot_Create(1, 0);
+    RoutingTable_Swap(table, previous);
+    table_to_release = table;
+    snapshot_to_release = RoutingTable_Acquire(table);
+    condition_wait_result = COND_ERROR;
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(previous));
+
+    ///act
+    RoutingTable_Swap(table, NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(size_t, 1, condition_wait_calls);
+
+    ///cleanup
+    RoutingTable_Destroy(table);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_026: [ If acquiring the table lock fails, RoutingTable_Swap shall still make snapshot the current snapshot and leak the previous snapshot instead of freeing it. ]*/
+TEST_FUNCTION(RoutingTable_Swap_leaks_the_previous_snapshot_when_Lock_fails)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto table = RoutingTable_Create();
+    auto previous = RoutingSnapshot_Create(1, 0);
+    auto snapshot = RoutingSnapshot_Create(1, 0);
+    RoutingTable_Swap(table, previous);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
+
+    ///act
+    RoutingTable_Swap(table, snapshot);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+    auto acquired = RoutingTable_Acquire(table);
+    ASSERT_ARE_EQUAL(void_ptr, snapshot, acquired);
+
+    ///cleanup
+    RoutingTable_Release(table, acquired);
+    RoutingTable_Destroy(table);
+    RoutingSnapshot_Destroy(previous);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_008: [ RoutingTable_Swap shall drop the reference of the table to the previous snapshot and wait on the table condition until the previous snapshot has no reader. ]*/
+TEST_FUNCTION(RoutingTable_Swap_does_not_wait_when_the_previous_snapshot_has_no_reader)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto table = RoutingTable_Create();
+    RoutingTable_Swap(table, RoutingSnapshot_Create(1, 0));
+    RoutingTable_Release(table, RoutingTable_Acquire(table));
+    mocks.ResetAllCalls();
+
+    ///act
+    RoutingTable_Swap(table, RoutingSnapshot_Create(1, 0));
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, condition_wait_calls);
+
+    ///cleanup
+    RoutingTable_Destroy(table);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_010: [ If table is NULL, RoutingTable_Acquire shall return NULL. ]*/
+TEST_FUNCTION(RoutingTable_Acquire_with_NULL_table_returns_NULL)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+
+    ///act
+    auto snapshot = RoutingTable_Acquire(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(snapshot);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_011: [ RoutingTable_Acquire shall not take the table lock. ]*/
+/*Tests_SRS_ROUTING_TABLE_13_012: [ RoutingTable_Acquire shall count itself in the publishers of the current phase of the table that are acquiring, read the current snapshot with an atomic load, increment its ref count, stop counting itself and return it, or return NULL if the table has no snapshot. ]*/
+/*Tests_SRS_ROUTING_TABLE_13_014: [ RoutingTable_Release shall decrement the ref count of snapshot without taking the table lock. ]*/
+TEST_FUNCTION(RoutingTable_Acquire_and_Release_do_not_lock_the_table)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto table = RoutingTable_Create();
+    auto snapshot = RoutingSnapshot_Create(1, 0);
+    RoutingTable_Swap(table, snapshot);
+    mocks.ResetAllCalls();
+
+    ///act
+    auto acquired = RoutingTable_Acquire(table);
+    RoutingTable_Release(table, acquired);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, snapshot, acquired);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    RoutingTable_Destroy(table);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_012: [ RoutingTable_Acquire shall count itself in the publishers of the current phase of the table that are acquiring, read the current snapshot with an atomic load, increment its ref count, stop counting itself and return it, or return NULL if the table has no snapshot. ]*/
+TEST_FUNCTION(RoutingTable_Acquire_without_a_snapshot_returns_NULL)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto table = RoutingTable_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto acquired = RoutingTable_Acquire(table);
+
+    ///assert
+    ASSERT_IS_NULL(acquired);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    RoutingTable_Destroy(table);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_013: [ If table or snapshot is NULL, RoutingTable_Release shall do nothing. ]*/
+TEST_FUNCTION(RoutingTable_Release_with_NULL_snapshot_does_nothing)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto table = RoutingTable_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    RoutingTable_Release(table, NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    RoutingTable_Destroy(table);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_015: [ If that drops the last reference to snapshot, which is then no longer current, RoutingTable_Release shall signal the table condition under the table lock. ]*/
+TEST_FUNCTION(RoutingTable_Release_of_the_current_snapshot_does_not_signal)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto table = RoutingTable_Create();
+    RoutingTable_Swap(table, RoutingSnapshot_Create(1, 0));
+    auto acquired = RoutingTable_Acquire(table);
+    mocks.ResetAllCalls();
+
+    ///act
+    RoutingTable_Release(table, acquired);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    RoutingTable_Destroy(table);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_029: [ If acquiring the table lock fails, RoutingTable_Release shall signal the table condition without it. ]*/
+TEST_FUNCTION(RoutingTable_Release_of_the_last_reference_signals_when_Lock_fails)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto table = RoutingTable_Create();
+    auto previous = RoutingSnapshot_Create(1, 0);
+    RoutingTable_Swap(table, previous);
+    table_to_release = table;
+    snapshot_to_release = RoutingTable_Acquire(table);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(previous));
+
+    ///act
+    RoutingTable_Swap(table, NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    RoutingTable_Destroy(table);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_016: [ RoutingSnapshot_Create shall allocate an empty snapshot with room for entry_count entries and sink_count sinks in one allocation. ]*/
+TEST_FUNCTION(RoutingSnapshot_Create_allocates_once)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    size_t entry_count;
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto snapshot = RoutingSnapshot_Create(3, 5);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(snapshot);
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_NULL(RoutingSnapshot_GetEntries(snapshot, &entry_count));
+    ASSERT_ARE_EQUAL(size_t, 0, entry_count);
+
+    ///cleanup
+    RoutingSnapshot_Destroy(snapshot);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_017: [ If the size of the snapshot overflows or the allocation fails, RoutingSnapshot_Create shall return NULL. ]*/
+TEST_FUNCTION(RoutingSnapshot_Create_fails_when_the_size_overflows)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+
+    ///act
+    auto snapshot = RoutingSnapshot_Create(1, SIZE_MAX / sizeof(ROUTING_SINK));
+
+    ///assert
+    ASSERT_IS_NULL(snapshot);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_017: [ If the size of the snapshot overflows or the allocation fails, RoutingSnapshot_Create shall return NULL. ]*/
+TEST_FUNCTION(RoutingSnapshot_Create_fails_when_malloc_fails)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn((void*)NULL);
+
+    ///act
+    auto snapshot = RoutingSnapshot_Create(1, 1);
+
+    ///assert
+    ASSERT_IS_NULL(snapshot);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_018: [ RoutingSnapshot_Destroy shall free the snapshot, and do nothing if it is NULL. ]*/
+TEST_FUNCTION(RoutingSnapshot_Destroy_frees_the_snapshot)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto snapshot = create_two_module_snapshot();
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(snapshot));
+
+    ///act
+    RoutingSnapshot_Destroy(snapshot);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_019: [ If snapshot is NULL, or it has no room for one more entry or for sink_count more sinks, RoutingSnapshot_AddEntry shall return NULL. ]*/
+TEST_FUNCTION(RoutingSnapshot_AddEntry_fails_without_room)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto snapshot = RoutingSnapshot_Create(2, 1);
+
+    ///act
+    auto too_many_sinks = RoutingSnapshot_AddEntry(snapshot, (const void*)0x1, NULL, 2);
+    auto first = RoutingSnapshot_AddEntry(snapshot, (const void*)0x1, NULL, 1);
+    auto second = RoutingSnapshot_AddEntry(snapshot, (const void*)0x2, NULL, 0);
+    auto too_many_entries = RoutingSnapshot_AddEntry(snapshot, (const void*)0x3, NULL, 0);
+
+    ///assert
+    ASSERT_IS_NULL(too_many_sinks);
+    ASSERT_IS_NOT_NULL(first);
+    ASSERT_IS_NOT_NULL(second);
+    ASSERT_IS_NULL(too_many_entries);
+
+    ///cleanup
+    RoutingSnapshot_Destroy(snapshot);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_020: [ RoutingSnapshot_AddEntry shall append an entry with key, module and the next sink_count sinks of the snapshot, and return those sinks. ]*/
+/*Tests_SRS_ROUTING_TABLE_13_022: [ RoutingSnapshot_Find shall return the first entry of the snapshot whose key is key, or NULL if there is none. ]*/
+TEST_FUNCTION(RoutingSnapshot_Find_returns_the_entry_of_the_key)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto snapshot = create_two_module_snapshot();
+
+    ///act
+    auto first = RoutingSnapshot_Find(snapshot, (const void*)0x1);
+    auto second = RoutingSnapshot_Find(snapshot, (const void*)0x2);
+    auto missing = RoutingSnapshot_Find(snapshot, (const void*)0x3);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(first);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x11, first->module);
+    ASSERT_ARE_EQUAL(size_t, 2, first->sink_count);
+    ASSERT_ARE_EQUAL(void_ptr, sink1, first->sinks[0].sink);
+    ASSERT_IS_NULL(first->sinks[0].filter);
+    ASSERT_ARE_EQUAL(void_ptr, sink2, first->sinks[1].sink);
+    ASSERT_ARE_EQUAL(void_ptr, (const void*)0x201, first->sinks[1].filter);
+    ASSERT_IS_NOT_NULL(second);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x12, second->module);
+    ASSERT_ARE_EQUAL(size_t, 0, second->sink_count);
+    ASSERT_IS_NULL(missing);
+
+    ///cleanup
+    RoutingSnapshot_Destroy(snapshot);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_021: [ If snapshot is NULL, RoutingSnapshot_Find shall return NULL. ]*/
+TEST_FUNCTION(RoutingSnapshot_Find_with_NULL_snapshot_returns_NULL)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+
+    ///act
+    auto entry = RoutingSnapshot_Find(NULL, (const void*)0x1);
+
+    ///assert
+    ASSERT_IS_NULL(entry);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_023: [ If entry_count is NULL, RoutingSnapshot_GetEntries shall return NULL. ]*/
+TEST_FUNCTION(RoutingSnapshot_GetEntries_with_NULL_entry_count_returns_NULL)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    auto snapshot = create_two_module_snapshot();
+
+    ///act
+    auto entries = RoutingSnapshot_GetEntries(snapshot, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(entries);
+
+    ///cleanup
+    RoutingSnapshot_Destroy(snapshot);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_024: [ If snapshot is NULL or empty, RoutingSnapshot_GetEntries shall set entry_count to 0 and return NULL. ]*/
+TEST_FUNCTION(RoutingSnapshot_GetEntries_with_NULL_snapshot_returns_no_entry)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    size_t entry_count = 42;
+
+    ///act
+    auto entries = RoutingSnapshot_GetEntries(NULL, &entry_count);
+
+    ///assert
+    ASSERT_IS_NULL(entries);
+    ASSERT_ARE_EQUAL(size_t, 0, entry_count);
+}
+
+/*Tests_SRS_ROUTING_TABLE_13_025: [ Otherwise RoutingSnapshot_GetEntries shall set entry_count to the number of entries and return them in the order they were added. ]*/
+TEST_FUNCTION(RoutingSnapshot_GetEntries_returns_the_entries_in_order)
+{
+    ///arrange
+    CRoutingTableMocks mocks;
+    size_t entry_count;
+    auto snapshot = create_two_module_snapshot();
+
+    ///act
+    auto entries = RoutingSnapshot_GetEntries(snapshot, &entry_count);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(entries);
+    ASSERT_ARE_EQUAL(size_t, 2, entry_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x1, (void*)entries[0].key);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x2, (void*)entries[1].key);
+
+    ///cleanup
+    RoutingSnapshot_Destroy(snapshot);
+}
+
+END_TEST_SUITE(routing_table_ut)
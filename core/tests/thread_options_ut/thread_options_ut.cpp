@@ -0,0 +1,212 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cstdlib>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <cstring>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "micromock.h"
+
+#include "internal/thread_options.h"
+
+static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
+static MICROMOCK_MUTEX_HANDLE g_testByTest;
+
+BEGIN_TEST_SUITE(thread_options_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = MicroMockCreateMutex();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    MicroMockDestroyMutex(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (!MicroMockAcquireMutex(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    if (!MicroMockReleaseMutex(g_testByTest))
+    {
+        ASSERT_FAIL("failure in test framework at ReleaseMutex");
+    }
+}
+
+/*Tests_SRS_THREAD_OPTIONS_13_001: [ ThreadOptions_IsDefault shall return nonzero if options is NULL, or if its cpu_affinity is 0, its policy is BROKER_THREAD_POLICY_DEFAULT and its name is empty, and 0 otherwise. ]*/
+TEST_FUNCTION(ThreadOptions_IsDefault_returns_nonzero_for_NULL)
+{
+    ///act
+    int result = ThreadOptions_IsDefault(NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+/*Tests_SRS_THREAD_OPTIONS_13_001: [ ThreadOptions_IsDefault shall return nonzero if options is NULL, or if its cpu_affinity is 0, its policy is BROKER_THREAD_POLICY_DEFAULT and its name is empty, and 0 otherwise. ]*/
+TEST_FUNCTION(ThreadOptions_IsDefault_returns_nonzero_for_zeroed_options)
+{
+    ///arrange
+    BROKER_THREAD_OPTIONS options;
+    memset(&options, 0, sizeof(options));
+
+    ///act
+    int result = ThreadOptions_IsDefault(&options);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+/*Tests_SRS_THREAD_OPTIONS_13_001: [ ThreadOptions_IsDefault shall return nonzero if options is NULL, or if its cpu_affinity is 0, its policy is BROKER_THREAD_POLICY_DEFAULT and its name is empty, and 0 otherwise. ]*/
+TEST_FUNCTION(ThreadOptions_IsDefault_returns_0_when_an_option_is_set)
+{
+    ///arrange
+    BROKER_THREAD_OPTIONS affinity;
+    BROKER_THREAD_OPTIONS policy;
+    BROKER_THREAD_OPTIONS name;
+    memset(&affinity, 0, sizeof(affinity));
+    memset(&policy, 0, sizeof(policy));
+    memset(&name, 0, sizeof(name));
+    affinity.cpu_affinity = 1;
+    policy.policy = BROKER_THREAD_POLICY_FIFO;
+    strcpy(name.name, "worker");
+
+    ///act
+    int affinity_result = ThreadOptions_IsDefault(&affinity);
+    int policy_result = ThreadOptions_IsDefault(&policy);
+    int name_result = ThreadOptions_IsDefault(&name);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, affinity_result);
+    ASSERT_ARE_EQUAL(int, 0, policy_result);
+    ASSERT_ARE_EQUAL(int, 0, name_result);
+}
+
+/*Tests_SRS_THREAD_OPTIONS_13_002: [ If options is NULL, ThreadOptions_Apply shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(ThreadOptions_Apply_fails_with_NULL_options)
+{
+    ///act
+    int result = ThreadOptions_Apply(NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+/*Tests_SRS_THREAD_OPTIONS_13_003: [ If cpu_affinity is not 0, ThreadOptions_Apply shall restrict the calling thread to the processors of cpu_affinity, with SetThreadAffinityMask on Windows and pthread_setaffinity_np on Linux. ]*/
+/*Tests_SRS_THREAD_OPTIONS_13_004: [ If policy is not BROKER_THREAD_POLICY_DEFAULT, ThreadOptions_Apply shall set the scheduling class of the calling thread to SCHED_FIFO or SCHED_RR with priority as its priority, and on Windows only set its priority with SetThreadPriority. ]*/
+TEST_FUNCTION(ThreadOptions_Apply_with_default_options_succeeds)
+{
+    ///arrange
+    BROKER_THREAD_OPTIONS options;
+    memset(&options, 0, sizeof(options));
+
+    ///act
+    int result = ThreadOptions_Apply(&options);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+}
+
+#if defined(__linux__)
+
+/*Tests_SRS_THREAD_OPTIONS_13_005: [ If name is not empty, ThreadOptions_Apply shall name the calling thread with pthread_setname_np on Linux. ]*/
+TEST_FUNCTION(ThreadOptions_Apply_names_the_thread)
+{
+    ///arrange
+    BROKER_THREAD_OPTIONS options;
+    char original_name[BROKER_THREAD_NAME_SIZE];
+    char name[BROKER_THREAD_NAME_SIZE];
+    memset(&options, 0, sizeof(options));
+    strcpy(options.name, "gw-test");
+    ASSERT_ARE_EQUAL(int, 0, pthread_getname_np(pthread_self(), original_name, sizeof(original_name)));
+
+    ///act
+    int result = ThreadOptions_Apply(&options);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, pthread_getname_np(pthread_self(), name, sizeof(name)));
+    ASSERT_ARE_EQUAL(char_ptr, "gw-test", name);
+
+    ///cleanup
+    (void)pthread_setname_np(pthread_self(), original_name);
+}
+
+/*Tests_SRS_THREAD_OPTIONS_13_005: [ If name is not empty, ThreadOptions_Apply shall name the calling thread with pthread_setname_np on Linux. ]*/
+TEST_FUNCTION(ThreadOptions_Apply_truncates_a_name_without_terminator)
+{
+    ///arrange
+    BROKER_THREAD_OPTIONS options;
+    char original_name[BROKER_THREAD_NAME_SIZE];
+    char name[BROKER_THREAD_NAME_SIZE];
+    memset(&options, 0, sizeof(options));
+    memset(options.name, 'a', BROKER_THREAD_NAME_SIZE);
+    ASSERT_ARE_EQUAL(int, 0, pthread_getname_np(pthread_self(), original_name, sizeof(original_name)));
+
+    ///act
+    int result = ThreadOptions_Apply(&options);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, pthread_getname_np(pthread_self(), name, sizeof(name)));
+    ASSERT_ARE_EQUAL(size_t, (size_t)(BROKER_THREAD_NAME_SIZE - 1), strlen(name));
+
+    ///cleanup
+    (void)pthread_setname_np(pthread_self(), original_name);
+}
+
+/*Tests_SRS_THREAD_OPTIONS_13_003: [ If cpu_affinity is not 0, ThreadOptions_Apply shall restrict the calling thread to the processors of cpu_affinity, with SetThreadAffinityMask on Windows and pthread_setaffinity_np on Linux. ]*/
+TEST_FUNCTION(ThreadOptions_Apply_restricts_the_thread_to_its_processors)
+{
+    ///arrange
+    BROKER_THREAD_OPTIONS options;
+    cpu_set_t original_cpus;
+    cpu_set_t cpus;
+    int first_cpu = -1;
+    memset(&options, 0, sizeof(options));
+    ASSERT_ARE_EQUAL(int, 0, pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &original_cpus));
+    for (int cpu = 0; cpu < 64 && first_cpu < 0; cpu++)
+    {
+        if (CPU_ISSET(cpu, &original_cpus))
+        {
+            first_cpu = cpu;
+        }
+    }
+    ASSERT_IS_TRUE(first_cpu >= 0);
+    options.cpu_affinity = (uint64_t)1 << first_cpu;
+
+    ///act
+    int result = ThreadOptions_Apply(&options);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus));
+    ASSERT_ARE_EQUAL(int, 1, CPU_COUNT(&cpus));
+    ASSERT_IS_TRUE(CPU_ISSET(first_cpu, &cpus) != 0);
+
+    ///cleanup
+    (void)pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &original_cpus);
+}
+
+#endif
+
+END_TEST_SUITE(thread_options_ut)
@@ -0,0 +1,700 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cstdlib>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <vector>
+
+#include "testrunnerswitcher.h"
+#include "micromock.h"
+#include "micromockcharstararenullterminatedstrings.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/condition.h"
+
+#include "internal/worker_pool.h"
+
+#define GBALLOC_H
+
+extern "C" int gballoc_init(void);
+extern "C" void gballoc_deinit(void);
+extern "C" void* gballoc_malloc(size_t size);
+extern "C" void* gballoc_calloc(size_t nmemb, size_t size);
+extern "C" void* gballoc_realloc(void* ptr, size_t size);
+extern "C" void gballoc_free(void* ptr);
+
+namespace BASEIMPLEMENTATION
+{
+    /*if malloc is defined as gballoc_malloc at this moment, there'd be serious trouble*/
+
+#define Lock(x) (LOCK_OK + gballocState - gballocState) /*compiler warning about constant in if condition*/
+#define Unlock(x) (LOCK_OK + gballocState - gballocState)
+#define Lock_Init() (LOCK_HANDLE)0x42
+#define Lock_Deinit(x) (LOCK_OK + gballocState - gballocState)
+#include "gballoc.c"
+#undef Lock
+#undef Unlock
+#undef Lock_Init
+#undef Lock_Deinit
+};
+
+static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
+static MICROMOCK_MUTEX_HANDLE g_testByTest;
+
+/*the worker threads are never started; the tests run a worker by calling its thread function*/
+static std::vector<THREAD_START_FUNC> thread_funcs;
+static std::vector<void*> thread_args;
+
+static size_t currentThreadAPI_Create_call;
+static size_t whenShallThreadAPI_Create_fail;
+
+/*a mocked wait cannot block, so it fails and the worker run by a test returns once it finds no work*/
+static COND_RESULT condition_wait_result;
+
+static size_t strand_runs;
+static STRAND_HANDLE strand_to_reschedule;
+
+static void counting_strand(void* context)
+{
+    size_t* runs = (size_t*)context;
+    (*runs)++;
+}
+
+static void rescheduling_strand(void* context)
+{
+    size_t* runs = (size_t*)context;
+    (*runs)++;
+    if (*runs == 1)
+    {
+        (void)WorkerPool_Schedule(strand_to_reschedule);
+    }
+}
+
+static int run_worker(size_t index)
+{
+    return thread_funcs[index](thread_args[index]);
+}
+
+TYPED_MOCK_CLASS(CWorkerPoolMocks, CGlobalMock)
+{
+public:
+    MOCK_STATIC_METHOD_1(, void*, gballoc_malloc, size_t, size)
+    MOCK_METHOD_END(void*, BASEIMPLEMENTATION::gballoc_malloc(size));
+
+    MOCK_STATIC_METHOD_1(, void, gballoc_free, void*, ptr)
+        BASEIMPLEMENTATION::gballoc_free(ptr);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_0(, LOCK_HANDLE, Lock_Init)
+    MOCK_METHOD_END(LOCK_HANDLE, (LOCK_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1));
+
+    MOCK_STATIC_METHOD_1(, LOCK_RESULT, Lock, LOCK_HANDLE, handle)
+    MOCK_METHOD_END(LOCK_RESULT, LOCK_OK);
+
+    MOCK_STATIC_METHOD_1(, LOCK_RESULT, Unlock, LOCK_HANDLE, handle)
+    MOCK_METHOD_END(LOCK_RESULT, LOCK_OK);
+
+    MOCK_STATIC_METHOD_1(, LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle)
+        BASEIMPLEMENTATION::gballoc_free(handle);
+    MOCK_METHOD_END(LOCK_RESULT, LOCK_OK);
+
+    MOCK_STATIC_METHOD_3(, THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg)
+        THREADAPI_RESULT result2;
+        currentThreadAPI_Create_call++;
+        if (currentThreadAPI_Create_call == whenShallThreadAPI_Create_fail)
+        {
+            result2 = THREADAPI_ERROR;
+        }
+        else
+        {
+            thread_funcs.push_back(func);
+            thread_args.push_back(arg);
+            *threadHandle = (THREAD_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1);
+            result2 = THREADAPI_OK;
+        }
+    MOCK_METHOD_END(THREADAPI_RESULT, result2);
+
+    MOCK_STATIC_METHOD_2(, THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res)
+        BASEIMPLEMENTATION::gballoc_free(threadHandle);
+        *res = 0;
+    MOCK_METHOD_END(THREADAPI_RESULT, THREADAPI_OK);
+
+    MOCK_STATIC_METHOD_0(, COND_HANDLE, Condition_Init)
+    MOCK_METHOD_END(COND_HANDLE, (COND_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1));
+
+    MOCK_STATIC_METHOD_1(, COND_RESULT, Condition_Post, COND_HANDLE, handle)
+    MOCK_METHOD_END(COND_RESULT, COND_OK);
+
+    MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds)
+    MOCK_METHOD_END(COND_RESULT, condition_wait_result);
+
+    MOCK_STATIC_METHOD_1(, void, Condition_Deinit, COND_HANDLE, handle)
+        BASEIMPLEMENTATION::gballoc_free(handle);
+    MOCK_VOID_METHOD_END()
+};
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CWorkerPoolMocks, , void*, gballoc_malloc, size_t, size);
+DECLARE_GLOBAL_MOCK_METHOD_1(CWorkerPoolMocks, , void, gballoc_free, void*, ptr);
+
+DECLARE_GLOBAL_MOCK_METHOD_0(CWorkerPoolMocks, , LOCK_HANDLE, Lock_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CWorkerPoolMocks, , LOCK_RESULT, Lock, LOCK_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CWorkerPoolMocks, , LOCK_RESULT, Unlock, LOCK_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_1(CWorkerPoolMocks, , LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, handle);
+
+DECLARE_GLOBAL_MOCK_METHOD_3(CWorkerPoolMocks, , THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg);
+DECLARE_GLOBAL_MOCK_METHOD_2(CWorkerPoolMocks, , THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res);
+
+DECLARE_GLOBAL_MOCK_METHOD_0(CWorkerPoolMocks, , COND_HANDLE, Condition_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CWorkerPoolMocks, , COND_RESULT, Condition_Post, COND_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_3(CWorkerPoolMocks, , COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
+DECLARE_GLOBAL_MOCK_METHOD_1(CWorkerPoolMocks, , void, Condition_Deinit, COND_HANDLE, handle);
+
+BEGIN_TEST_SUITE(worker_pool_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = MicroMockCreateMutex();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    MicroMockDestroyMutex(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (!MicroMockAcquireMutex(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    thread_funcs.clear();
+    thread_args.clear();
+    currentThreadAPI_Create_call = 0;
+    whenShallThreadAPI_Create_fail = 0;
+    condition_wait_result = COND_ERROR;
+    strand_runs = 0;
+    strand_to_reschedule = NULL;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    if (!MicroMockReleaseMutex(g_testByTest))
+    {
+        ASSERT_FAIL("failure in test framework at ReleaseMutex");
+    }
+}
+
+/*Tests_SRS_WORKER_POOL_13_002: [ WorkerPool_Create shall allocate the pool and an array of worker_count workers. ]*/
+/*Tests_SRS_WORKER_POOL_13_004: [ WorkerPool_Create shall create the pool lock and work condition. ]*/
+/*Tests_SRS_WORKER_POOL_13_005: [ WorkerPool_Create shall start one thread per worker, each with an empty run queue. ]*/
+TEST_FUNCTION(WorkerPool_Create_starts_one_thread_per_worker)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    auto pool = WorkerPool_Create(3);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(pool);
+    ASSERT_ARE_EQUAL(size_t, 3, WorkerPool_GetWorkerCount(pool));
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    WorkerPool_Destroy(pool);
+}
+
+/*Tests_SRS_WORKER_POOL_13_001: [ If worker_count is 0, WorkerPool_Create shall create one worker per online processor, and at least one worker. ]*/
+TEST_FUNCTION(WorkerPool_Create_with_0_workers_creates_at_least_one_worker)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+
+    ///act
+    auto pool = WorkerPool_Create(0);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(pool);
+    ASSERT_IS_TRUE(WorkerPool_GetWorkerCount(pool) >= 1);
+    ASSERT_ARE_EQUAL(size_t, WorkerPool_GetWorkerCount(pool), thread_funcs.size());
+
+    ///cleanup
+    WorkerPool_Destroy(pool);
+}
+
+/*Tests_SRS_WORKER_POOL_13_003: [ If any allocation or resource creation fails, WorkerPool_Create shall free every resource it created and return NULL. ]*/
+TEST_FUNCTION(WorkerPool_Create_fails_when_malloc_fails)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn((void*)NULL);
+
+    ///act
+    auto pool = WorkerPool_Create(2);
+
+    ///assert
+    ASSERT_IS_NULL(pool);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_WORKER_POOL_13_003: [ If any allocation or resource creation fails, WorkerPool_Create shall free every resource it created and return NULL. ]*/
+TEST_FUNCTION(WorkerPool_Create_fails_when_Condition_Init_fails)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init())
+        .SetFailReturn((COND_HANDLE)NULL);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto pool = WorkerPool_Create(2);
+
+    ///assert
+    ASSERT_IS_NULL(pool);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_WORKER_POOL_13_003: [ If any allocation or resource creation fails, WorkerPool_Create shall free every resource it created and return NULL. ]*/
+TEST_FUNCTION(WorkerPool_Create_joins_started_workers_when_ThreadAPI_Create_fails)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+    whenShallThreadAPI_Create_fail = 2;
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto pool = WorkerPool_Create(3);
+
+    ///assert
+    ASSERT_IS_NULL(pool);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_WORKER_POOL_13_006: [ If pool is NULL, WorkerPool_Destroy shall do nothing. ]*/
+TEST_FUNCTION(WorkerPool_Destroy_with_NULL_does_nothing)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+
+    ///act
+    WorkerPool_Destroy(NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_WORKER_POOL_13_007: [ WorkerPool_Destroy shall signal every worker to stop and join its thread. ]*/
+/*Tests_SRS_WORKER_POOL_13_008: [ WorkerPool_Destroy shall free all the resources used by the pool. ]*/
+TEST_FUNCTION(WorkerPool_Destroy_stops_and_joins_every_worker)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+    auto pool = WorkerPool_Create(2);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    WorkerPool_Destroy(pool);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_WORKER_POOL_13_009: [ WorkerPool_GetWorkerCount shall return the number of workers of the pool, or 0 if pool is NULL. ]*/
+TEST_FUNCTION(WorkerPool_GetWorkerCount_with_NULL_returns_0)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+
+    ///act
+    auto count = WorkerPool_GetWorkerCount(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, count);
+}
+
+/*Tests_SRS_WORKER_POOL_13_010: [ If pool or function is NULL, WorkerPool_CreateStrand shall fail and return NULL. ]*/
+TEST_FUNCTION(WorkerPool_CreateStrand_with_NULL_function_fails)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+    auto pool = WorkerPool_Create(1);
+    mocks.ResetAllCalls();
+
+    ///act
+    auto strand = WorkerPool_CreateStrand(pool, NULL, &strand_runs);
+
+    ///assert
+    ASSERT_IS_NULL(strand);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    WorkerPool_Destroy(pool);
+}
+
+/*Tests_SRS_WORKER_POOL_13_011: [ WorkerPool_CreateStrand shall allocate a new strand and create its idle condition. ]*/
+/*Tests_SRS_WORKER_POOL_13_013: [ WorkerPool_CreateStrand shall return an idle strand that runs function with context. ]*/
+TEST_FUNCTION(WorkerPool_CreateStrand_succeeds)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+    auto pool = WorkerPool_Create(1);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+
+    ///act
+    auto strand = WorkerPool_CreateStrand(pool, counting_strand, &strand_runs);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(strand);
+    ASSERT_ARE_EQUAL(size_t, 0, strand_runs);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    WorkerPool_DestroyStrand(strand);
+    WorkerPool_Destroy(pool);
+}
+
+/*Tests_SRS_WORKER_POOL_13_012: [ If any allocation or resource creation fails, WorkerPool_CreateStrand shall free every resource it created and return NULL. ]*/
+TEST_FUNCTION(WorkerPool_CreateStrand_fails_when_Condition_Init_fails)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+    auto pool = WorkerPool_Create(1);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Init())
+        .SetFailReturn((COND_HANDLE)NULL);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto strand = WorkerPool_CreateStrand(pool, counting_strand, &strand_runs);
+
+    ///assert
+    ASSERT_IS_NULL(strand);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    WorkerPool_Destroy(pool);
+}
+
+/*Tests_SRS_WORKER_POOL_13_014: [ If strand is NULL, WorkerPool_Schedule shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(WorkerPool_Schedule_with_NULL_strand_fails)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+
+    ///act
+    auto result = WorkerPool_Schedule(NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_WORKER_POOL_13_015: [ If the pool lock cannot be acquired, WorkerPool_Schedule shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(WorkerPool_Schedule_fails_when_Lock_fails)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+    auto pool = WorkerPool_Create(1);
+    auto strand = WorkerPool_CreateStrand(pool, counting_strand, &strand_runs);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
+
+    ///act
+    auto result = WorkerPool_Schedule(strand);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    WorkerPool_DestroyStrand(strand);
+    WorkerPool_Destroy(pool);
+}
+
+/*Tests_SRS_WORKER_POOL_13_016: [ If the strand is idle, WorkerPool_Schedule shall queue it at the back of the next worker's run queue in round-robin order. ]*/
+/*Tests_SRS_WORKER_POOL_13_017: [ WorkerPool_Schedule shall signal the work condition if any worker is waiting for work. ]*/
+/*Tests_SRS_WORKER_POOL_13_020: [ WorkerPool_Schedule shall return 0 upon success. ]*/
+TEST_FUNCTION(WorkerPool_Schedule_queues_an_idle_strand)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+    auto pool = WorkerPool_Create(1);
+    auto strand = WorkerPool_CreateStrand(pool, counting_strand, &strand_runs);
+    mocks.ResetAllCalls();
+
+    /*no worker is waiting, so the work condition is not signaled*/
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = WorkerPool_Schedule(strand);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, strand_runs);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    WorkerPool_DestroyStrand(strand);
+    WorkerPool_Destroy(pool);
+}
+
+/*Tests_SRS_WORKER_POOL_13_021: [ A worker shall run until the pool is destroyed. ]*/
+/*Tests_SRS_WORKER_POOL_13_022: [ A worker shall take the strand at the front of its own run queue or, if that queue is empty, steal the strand at the front of another worker's run queue. ]*/
+/*Tests_SRS_WORKER_POOL_13_024: [ A worker shall call the strand function with the strand context without holding the pool lock. ]*/
+/*Tests_SRS_WORKER_POOL_13_026: [ Otherwise the worker shall mark the strand idle and, if the strand is being destroyed, signal its idle condition. ]*/
+TEST_FUNCTION(worker_runs_a_scheduled_strand)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+    auto pool = WorkerPool_Create(1);
+    auto strand = WorkerPool_CreateStrand(pool, counting_strand, &strand_runs);
+    (void)WorkerPool_Schedule(strand);
+
+    ///act
+    (void)run_worker(0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, strand_runs);
+
+    ///cleanup
+    WorkerPool_DestroyStrand(strand);
+    WorkerPool_Destroy(pool);
+}
+
+/*Tests_SRS_WORKER_POOL_13_019: [ If the strand is already queued or rescheduled, WorkerPool_Schedule shall leave it unchanged. ]*/
+TEST_FUNCTION(WorkerPool_Schedule_of_a_queued_strand_runs_it_once)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+    auto pool = WorkerPool_Create(1);
+    auto strand = WorkerPool_CreateStrand(pool, counting_strand, &strand_runs);
+    (void)WorkerPool_Schedule(strand);
+
+    ///act
+    auto result = WorkerPool_Schedule(strand);
+    (void)run_worker(0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, strand_runs);
+
+    ///cleanup
+    WorkerPool_DestroyStrand(strand);
+    WorkerPool_Destroy(pool);
+}
+
+/*Tests_SRS_WORKER_POOL_13_022: [ A worker shall take the strand at the front of its own run queue or, if that queue is empty, steal the strand at the front of another worker's run queue. ]*/
+TEST_FUNCTION(worker_steals_a_strand_queued_on_another_worker)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+    auto pool = WorkerPool_Create(2);
+    auto strand = WorkerPool_CreateStrand(pool, counting_strand, &strand_runs);
+
+    /*the first strand scheduled goes to worker 0*/
+    (void)WorkerPool_Schedule(strand);
+
+    ///act
+    (void)run_worker(1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, strand_runs);
+
+    ///cleanup
+    WorkerPool_DestroyStrand(strand);
+    WorkerPool_Destroy(pool);
+}
+
+/*Tests_SRS_WORKER_POOL_13_018: [ If the strand is running, WorkerPool_Schedule shall mark it to run once more after the strand function returns. ]*/
+/*Tests_SRS_WORKER_POOL_13_025: [ If the strand was scheduled while it ran, the worker shall queue it at the back of its own run queue. ]*/
+TEST_FUNCTION(strand_scheduled_while_running_runs_once_more)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+    auto pool = WorkerPool_Create(2);
+    auto strand = WorkerPool_CreateStrand(pool, rescheduling_strand, &strand_runs);
+    strand_to_reschedule = strand;
+    (void)WorkerPool_Schedule(strand);
+
+    ///act
+    (void)run_worker(0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, strand_runs);
+
+    ///cleanup
+    WorkerPool_DestroyStrand(strand);
+    WorkerPool_Destroy(pool);
+}
+
+/*Tests_SRS_WORKER_POOL_13_023: [ A worker that finds no queued strand shall wait on the pool's work condition. ]*/
+/*Tests_SRS_WORKER_POOL_13_031: [ If waiting on the work condition fails, the worker shall stop; the strands queued on it are run by the other workers. ]*/
+TEST_FUNCTION(worker_without_work_waits_on_the_work_condition)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+    auto pool = WorkerPool_Create(1);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = run_worker(0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    WorkerPool_Destroy(pool);
+}
+
+/*Tests_SRS_WORKER_POOL_13_027: [ If strand is NULL, WorkerPool_DestroyStrand shall do nothing. ]*/
+TEST_FUNCTION(WorkerPool_DestroyStrand_with_NULL_does_nothing)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+
+    ///act
+    WorkerPool_DestroyStrand(NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_WORKER_POOL_13_028: [ If the strand is queued, WorkerPool_DestroyStrand shall remove it from its run queue. ]*/
+/*Tests_SRS_WORKER_POOL_13_030: [ WorkerPool_DestroyStrand shall free all the resources used by the strand. ]*/
+TEST_FUNCTION(WorkerPool_DestroyStrand_removes_a_queued_strand)
+{
+    ///arrange
+    CWorkerPoolMocks mocks;
+    auto pool = WorkerPool_Create(1);
+    auto strand1 = WorkerPool_CreateStrand(pool, counting_strand, &strand_runs);
+    auto strand2 = WorkerPool_CreateStrand(pool, counting_strand, &strand_runs);
+    (void)WorkerPool_Schedule(strand1);
+    (void)WorkerPool_Schedule(strand2);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(strand1));
+
+    ///act
+    WorkerPool_DestroyStrand(strand1);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+    (void)run_worker(0);
+    ASSERT_ARE_EQUAL(size_t, 1, strand_runs);
+
+    ///cleanup
+    WorkerPool_DestroyStrand(strand2);
+    WorkerPool_Destroy(pool);
+}
+
+END_TEST_SUITE(worker_pool_ut)
@@ -77,13 +77,12 @@ static void PiGpio_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHan
 {
 	PIGPIO_DATA* module_data = (PIGPIO_DATA*)moduleHandle;
 
-	CONSTMAP_HANDLE properties = Message_GetProperties(messageHandle);
-	const char * source = ConstMap_GetValue(properties, GW_SOURCE_PROPERTY);
+	const char * source = Message_GetPropertyById(messageHandle, MESSAGE_PROPERTY_SOURCE);
 	if(strcmp(source,GW_IOTHUB_MODULE)!=0){
 		return;
 	}
 
-	const char* deviceId = ConstMap_GetValue(properties, GW_DEVICENAME_PROPERTY);
+	const char* deviceId = Message_GetPropertyById(messageHandle, MESSAGE_PROPERTY_DEVICENAME);
 	if(strcmp(deviceId,module_data->deviceId) != 0){
 		//LogInfo("this %s deviceId %s",module_data->deviceId,deviceId);
 		return;
@@ -241,6 +240,9 @@ static int pi_gpio_worker(void * user_data)
 		LogError("user_data is null");
 		return 0;
 	}
+	if(Broker_ApplyModuleThreadOptions(module_data->broker, (MODULE_HANDLE)module_data) != BROKER_OK){
+		LogError("Can't apply the thread options of the Pi_GPIO module");
+	}
 	
 	if(bcm2835_init()==0){
 		LogInfo("Can't init raspbarry pi GPIO");
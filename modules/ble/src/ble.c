@@ -43,6 +43,7 @@ typedef struct BLE_HANDLE_DATA_TAG
 #if __linux__
     GMainLoop*          main_loop;
     THREAD_HANDLE       event_thread;
+    GSource*            start_source;
 #endif
 }BLE_HANDLE_DATA;
 
@@ -98,6 +99,10 @@ static int event_dispatcher(
 static bool terminate_event_dispatcher(
     BLE_HANDLE_DATA* handle_data
 );
+
+static gboolean apply_thread_options(
+    gpointer user_data
+);
 #endif
 
 static MODULE_HANDLE BLE_Create(BROKER_HANDLE broker, const void* configuration)
@@ -177,6 +182,7 @@ static MODULE_HANDLE BLE_Create(BROKER_HANDLE broker, const void* configuration)
                         result->is_destroy_complete = false;
 
 #if __linux__
+                        result->start_source = NULL;
                         if (init_glib_loop(result) == false)
                         {
                             LogError("init_glib_loop returned false");
@@ -517,7 +523,13 @@ static void on_read_complete(
                             | source                  | This property will always have the value `bleTelemetry`.      |
 
                             ]*/
-                            if (Broker_Publish(handle_data->broker, (MODULE_HANDLE)handle_data, message) != BROKER_OK)
+                            BROKER_RESULT publish_result = Broker_Publish(handle_data->broker, (MODULE_HANDLE)handle_data, message);
+                            if (publish_result == BROKER_BUSY)
+                            {
+                                /*a downstream queue is full, shed this reading*/
+                                LogInfo("Broker is busy, dropping BLE telemetry");
+                            }
+                            else if (publish_result != BROKER_OK)
                             {
                                 LogError("Broker_Publish() failed");
                             }
@@ -730,6 +742,13 @@ static void BLE_Destroy(MODULE_HANDLE module)
                 {
                     LogError("ThreadAPI_Join() returned an error");
                 }
+
+                // drop the thread options call if the loop never got to it
+                if (handle_data->start_source != NULL)
+                {
+                    g_source_destroy(handle_data->start_source);
+                    g_source_unref(handle_data->start_source);
+                }
             }
 #endif
         }
@@ -742,12 +761,69 @@ static void BLE_Destroy(MODULE_HANDLE module)
     }
 }
 
+static void BLE_Start(MODULE_HANDLE module)
+{
+    /*Codes_SRS_BLE_13_023: [ If module is NULL BLE_Start shall do nothing. ]*/
+    if (module == NULL)
+    {
+        LogError("module handle is NULL");
+    }
+    else
+    {
+#if __linux__
+        BLE_HANDLE_DATA* handle_data = (BLE_HANDLE_DATA*)module;
+        GMainContext* loop_context = g_main_loop_get_context(handle_data->main_loop);
+        if (loop_context == NULL)
+        {
+            LogError("g_main_loop_get_context returned NULL");
+        }
+        else
+        {
+            /*Codes_SRS_BLE_13_024: [ BLE_Start shall schedule apply_thread_options on the thread running the GLIB loop by attaching an idle source to the context of the loop. ]*/
+            GSource* source = g_idle_source_new();
+            if (source == NULL)
+            {
+                LogError("g_idle_source_new returned NULL");
+            }
+            else
+            {
+                g_source_set_callback(source, apply_thread_options, (gpointer)handle_data, NULL);
+                if (g_source_attach(source, loop_context) == 0)
+                {
+                    LogError("g_source_attach failed");
+                    g_source_unref(source);
+                }
+                else
+                {
+                    handle_data->start_source = source;
+                }
+            }
+        }
+#endif
+    }
+}
+
+#if __linux__
+static gboolean apply_thread_options(gpointer user_data)
+{
+    BLE_HANDLE_DATA* handle_data = (BLE_HANDLE_DATA*)user_data;
+
+    /*Codes_SRS_BLE_13_025: [ apply_thread_options shall apply the thread options of the module to the thread running the GLIB loop by calling Broker_ApplyModuleThreadOptions, and shall run only once. ]*/
+    if (Broker_ApplyModuleThreadOptions(handle_data->broker, (MODULE_HANDLE)handle_data) != BROKER_OK)
+    {
+        LogError("Broker_ApplyModuleThreadOptions failed");
+    }
+
+    return FALSE;
+}
+#endif
+
 static const MODULE_APIS Module_GetAPIS_Impl =
 {
     BLE_Create,
     BLE_Destroy,
     BLE_Receive, 
-	NULL
+    BLE_Start
 };
 
 /*Codes_SRS_BLE_26_001: [ `Module_GetAPIS` shall fill the provided `MODULE_APIS` function with the required function pointers. ]*/
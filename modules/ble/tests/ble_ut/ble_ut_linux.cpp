@@ -40,6 +40,7 @@ static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
 static pfModule_Create  BLE_Create = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
 static pfModule_Destroy BLE_Destroy = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
 static pfModule_Receive BLE_Receive = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
+static pfModule_Start   BLE_Start = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
 
 #define GBALLOC_H
 
@@ -93,6 +94,8 @@ static bool shouldThreadAPI_Create_invoke_callback = false;
 static bool should_g_main_loop_quit_call_thread_func = false;
 static THREAD_START_FUNC thread_start_func = NULL;
 static void* thread_func_arg = NULL;
+static GSourceFunc g_source_callback = NULL;
+static gpointer g_source_callback_data = NULL;
 
 class CBLEIOSequence
 {
@@ -327,6 +330,10 @@ public:
     MOCK_STATIC_METHOD_3(, BROKER_RESULT, Broker_Publish, BROKER_HANDLE, broker, MODULE_HANDLE, source, MESSAGE_HANDLE, message)
         auto result2 = BROKER_OK;
     MOCK_METHOD_END(BROKER_RESULT, result2)
+
+    MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_ApplyModuleThreadOptions, BROKER_HANDLE, broker, MODULE_HANDLE, module)
+        auto result2 = BROKER_OK;
+    MOCK_METHOD_END(BROKER_RESULT, result2)
     
     MOCK_STATIC_METHOD_1(, CONSTMAP_HANDLE, ConstMap_Create, MAP_HANDLE, sourceMap)
         auto result2 = BASEIMPLEMENTATION::ConstMap_Create(sourceMap);
@@ -481,6 +488,26 @@ public:
     MOCK_STATIC_METHOD_2(, gboolean, g_main_context_iteration, GMainContext*, context, gboolean, may_block)
         gboolean result2 = TRUE;
     MOCK_METHOD_END(gboolean, result2);
+
+    MOCK_STATIC_METHOD_0(, GSource*, g_idle_source_new)
+        GSource* result2 = (GSource*)malloc(1);
+    MOCK_METHOD_END(GSource*, result2);
+
+    MOCK_STATIC_METHOD_4(, void, g_source_set_callback, GSource*, source, GSourceFunc, func, gpointer, data, GDestroyNotify, notify)
+        g_source_callback = func;
+        g_source_callback_data = data;
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, guint, g_source_attach, GSource*, source, GMainContext*, context)
+        guint result2 = 1;
+    MOCK_METHOD_END(guint, result2);
+
+    MOCK_STATIC_METHOD_1(, void, g_source_destroy, GSource*, source)
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_1(, void, g_source_unref, GSource*, source)
+        free(source);
+    MOCK_VOID_METHOD_END()
 };
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , void*, gballoc_malloc, size_t, size);
@@ -555,6 +582,7 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , BLEIO_SEQ_RESULT, BLEIO_Seq_Run, BLEIO
 DECLARE_GLOBAL_MOCK_METHOD_2(CBLEMocks, , BLEIO_SEQ_RESULT, BLEIO_Seq_AddInstruction, BLEIO_SEQ_HANDLE, bleio_seq_handle, BLEIO_SEQ_INSTRUCTION*, instruction);
 
 DECLARE_GLOBAL_MOCK_METHOD_3(CBLEMocks, , BROKER_RESULT, Broker_Publish, BROKER_HANDLE, broker, MODULE_HANDLE, source, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBLEMocks, , BROKER_RESULT, Broker_ApplyModuleThreadOptions, BROKER_HANDLE, broker, MODULE_HANDLE, module);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , time_t, gb_time, time_t*, timer);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , struct tm*, gb_localtime, const time_t*, timer);
@@ -570,6 +598,11 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , void, g_main_loop_unref, GMainLoop*, l
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , void, g_main_loop_run, GMainLoop*, loop);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , gboolean, g_main_loop_is_running, GMainLoop*, loop);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , void, g_main_loop_quit, GMainLoop*, loop);
+DECLARE_GLOBAL_MOCK_METHOD_0(CBLEMocks, , GSource*, g_idle_source_new);
+DECLARE_GLOBAL_MOCK_METHOD_4(CBLEMocks, , void, g_source_set_callback, GSource*, source, GSourceFunc, func, gpointer, data, GDestroyNotify, notify);
+DECLARE_GLOBAL_MOCK_METHOD_2(CBLEMocks, , guint, g_source_attach, GSource*, source, GMainContext*, context);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , void, g_source_destroy, GSource*, source);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBLEMocks, , void, g_source_unref, GSource*, source);
 
 BEGIN_TEST_SUITE(ble_ut)
     TEST_SUITE_INITIALIZE(TestClassInitialize)
@@ -584,6 +617,7 @@ BEGIN_TEST_SUITE(ble_ut)
         BLE_Create = apis.Module_Create;
         BLE_Destroy = apis.Module_Destroy;
         BLE_Receive = apis.Module_Receive;
+        BLE_Start = apis.Module_Start;
     }
 
     TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -604,6 +638,8 @@ BEGIN_TEST_SUITE(ble_ut)
         shouldThreadAPI_Create_invoke_callback = false;
         thread_start_func = NULL;
         should_g_main_loop_quit_call_thread_func = false;
+        g_source_callback = NULL;
+        g_source_callback_data = NULL;
     }
 
     TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -2476,6 +2512,67 @@ BEGIN_TEST_SUITE(ble_ut)
         VECTOR_destroy(instructions);
     }
 
+    /*Tests_SRS_BLE_13_023: [ If module is NULL BLE_Start shall do nothing. ]*/
+    TEST_FUNCTION(BLE_Start_does_nothing_with_NULL_input)
+    {
+        ///arrange
+        CBLEMocks mocks;
+
+        ///act
+        BLE_Start(NULL);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+    }
+
+    /*Tests_SRS_BLE_13_024: [ BLE_Start shall schedule apply_thread_options on the thread running the GLIB loop by attaching an idle source to the context of the loop. ]*/
+    /*Tests_SRS_BLE_13_025: [ apply_thread_options shall apply the thread options of the module to the thread running the GLIB loop by calling Broker_ApplyModuleThreadOptions, and shall run only once. ]*/
+    TEST_FUNCTION(BLE_Start_applies_the_thread_options_on_the_event_thread)
+    {
+        ///arrange
+        CBLEMocks mocks;
+        VECTOR_HANDLE instructions = VECTOR_create(sizeof(BLE_INSTRUCTION));
+        BLE_INSTRUCTION instr1 =
+        {
+            READ_ONCE,
+            STRING_construct("fake_char_id"),
+            { 500 }
+        };
+        VECTOR_push_back(instructions, &instr1, 1);
+        BLE_CONFIG config =
+        {
+            { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF },
+            instructions
+        };
+        auto module = BLE_Create((BROKER_HANDLE)0x42, &config);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, g_main_loop_get_context(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, g_idle_source_new());
+        STRICT_EXPECTED_CALL(mocks, g_source_set_callback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, g_source_attach(IGNORED_PTR_ARG, (GMainContext*)0x42))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Broker_ApplyModuleThreadOptions((BROKER_HANDLE)0x42, module));
+
+        ///act
+        BLE_Start(module);
+        ASSERT_IS_NOT_NULL((void*)g_source_callback);
+        gboolean keep_source = g_source_callback(g_source_callback_data);
+
+        ///assert
+        ASSERT_IS_FALSE(keep_source != FALSE);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        should_g_main_loop_quit_call_thread_func = true;
+        BLE_Destroy(module);
+        VECTOR_destroy(instructions);
+    }
+
     /*Tests_SRS_BLE_26_001: [ `Module_GetAPIS` shall fill the provided `MODULE_APIS` function with the required function pointers. ]*/
     TEST_FUNCTION(Module_GetAPIS_returns_non_NULL_and_non_NULL_fields)
     {
@@ -2489,6 +2586,7 @@ BEGIN_TEST_SUITE(ble_ut)
         ASSERT_IS_TRUE(apis.Module_Create != NULL);
         ASSERT_IS_TRUE(apis.Module_Destroy != NULL);
         ASSERT_IS_TRUE(apis.Module_Receive != NULL);
+        ASSERT_IS_TRUE(apis.Module_Start != NULL);
     }
 
     /*Tests_SRS_BLE_13_018: [ BLE_Receive shall do nothing if module is NULL or if message is NULL. ]*/
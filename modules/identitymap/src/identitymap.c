@@ -16,8 +16,6 @@
 #include "message.h"
 #include "broker.h"
 #include "identitymap.h"
-#include "azure_c_shared_utility/constmap.h"
-#include "azure_c_shared_utility/constbuffer.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/vector.h"
 
@@ -359,42 +357,25 @@ static void IdentityMap_Destroy(MODULE_HANDLE moduleHandle)
 	}
 }
 
-static void publish_with_new_properties(MAP_HANDLE newProperties, MESSAGE_HANDLE messageHandle, IDENTITY_MAP_DATA * idModule)
+static void publish_with_property_edits(const MESSAGE_PROPERTY_EDIT * edits, size_t editCount, MESSAGE_HANDLE messageHandle, IDENTITY_MAP_DATA * idModule)
 {
-	/*Codes_SRS_IDMAP_17_034: [IdentityMap_Receive shall clone message content.] */ 
-	CONSTBUFFER_HANDLE content = Message_GetContentHandle(messageHandle);
-	if (content == NULL)
+	MESSAGE_HANDLE newMessage = Message_CloneWithPropertyEdits(messageHandle, edits, editCount);
+	if (newMessage == NULL)
 	{
-		/*Codes_SRS_IDMAP_17_035: [If cloning message content fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-		LogError("Could not extract message content");
+		/*Codes_SRS_IDMAP_17_061: [If Message_CloneWithPropertyEdits fails, IdentityMap_Receive shall deallocate all resources and return.]*/
+		LogError("Could not create new message to publish");
 	}
 	else
 	{
-		MESSAGE_BUFFER_CONFIG newMessageConfig =
+		BROKER_RESULT brokerStatus;
+		/*Codes_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
+		brokerStatus = Broker_Publish(idModule->broker, (MODULE_HANDLE)idModule, newMessage);
+		if (brokerStatus != BROKER_OK)
 		{
-			content,
-			newProperties
-		};
-		/*Codes_SRS_IDMAP_17_036: [IdentityMap_Receive shall create a new message by calling Message_CreateFromBuffer with new map and cloned content.]*/
-		MESSAGE_HANDLE newMessage = Message_CreateFromBuffer(&newMessageConfig);
-		if (newMessage == NULL)
-		{
-			/*Codes_SRS_IDMAP_17_037: [If creating new message fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-			LogError("Could not create new message to publish");
-		}
-		else
-		{
-			BROKER_RESULT brokerStatus;
-			/*Codes_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
-			brokerStatus = Broker_Publish(idModule->broker, (MODULE_HANDLE)idModule, newMessage);
-			if (brokerStatus != BROKER_OK)
-			{
-				LogError("Message broker publish failure: %s", ENUM_TO_STRING(BROKER_RESULT, brokerStatus));
-			}
-			Message_Destroy(newMessage);
+			LogError("Message broker publish failure: %s", ENUM_TO_STRING(BROKER_RESULT, brokerStatus));
 		}
 		/*Codes_SRS_IDMAP_17_039: [IdentityMap_Receive will destroy all resources it created.]*/
-		CONSTBUFFER_Destroy(content);
+		Message_Destroy(newMessage);
 	}
 }
 
@@ -406,55 +387,15 @@ static void IdentityMap_RepublishD2C(
 	MESSAGE_HANDLE messageHandle,
 	IDENTITY_MAP_CONFIG * match)
 {
-	CONSTMAP_HANDLE properties = Message_GetProperties(messageHandle);
-	if (properties == NULL)
+	/*Codes_SRS_IDMAP_17_059: [IdentityMap_Receive shall call Message_CloneWithPropertyEdits with edits that set "deviceName" to the found deviceId, "deviceKey" to the found deviceKey and "source" to "mapping", and that remove the "macAddress" property.]*/
+	MESSAGE_PROPERTY_EDIT edits[] =
 	{
-
-		LogError("Could not extract message properties");
-	}
-	else
-	{
-		/*Codes_SRS_IDMAP_17_026: [On a message which passes all checks, IdentityMap_Receive shall call ConstMap_CloneWriteable on the message properties.]*/
-		MAP_HANDLE newProperties = ConstMap_CloneWriteable(properties);
-		if (newProperties == NULL)
-		{
-			/*Codes_SRS_IDMAP_17_027: [If ConstMap_CloneWriteable fails, IdentityMap_Receive shall deallocate any resources and return.] */
-			LogError("Could not make writeable new properties map");
-		}
-		else
-		{
-			/*Codes_SRS_IDMAP_17_028: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "deviceName" and value of found deviceId.]*/
-			if (Map_AddOrUpdate(newProperties, GW_DEVICENAME_PROPERTY, match->deviceId) != MAP_OK)
-			{
-				/*Codes_SRS_IDMAP_17_029: [If adding deviceName fails,IdentityMap_Receive shall deallocate all resources and return.]*/
-				LogError("Could not attach %s property to message", GW_DEVICENAME_PROPERTY);
-			}
-			/*Codes_SRS_IDMAP_17_030: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "deviceKey" and value of found deviceKey.]*/
-			else if (Map_AddOrUpdate(newProperties, GW_DEVICEKEY_PROPERTY, match->deviceKey) != MAP_OK)
-			{
-				/*Codes_SRS_IDMAP_17_031: [If adding deviceKey fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-				LogError("Could not attach %s property to message", GW_DEVICEKEY_PROPERTY);
-			}
-			/*Codes_SRS_IDMAP_17_032: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "source" and value of "mapping".]*/
-			else if (Map_AddOrUpdate(newProperties, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE) != MAP_OK)
-			{
-				/*Codes_SRS_IDMAP_17_033: [If adding source fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-				LogError("Could not attach %s property to message", GW_SOURCE_PROPERTY);
-			}
-			/*Codes_SRS_IDMAP_17_053: [ IdentityMap_Receive shall call Map_Delete to remove the "macAddress" property. ]*/
-			else if (Map_Delete(newProperties, GW_MAC_ADDRESS_PROPERTY) != MAP_OK)
-			{
-				/*Codes_SRS_IDMAP_17_054: [ If deleting the MAC Address fails, IdentityMap_Receive shall deallocate all resources and return. ]*/
-				LogError("Could not remove %s property from message", GW_MAC_ADDRESS_PROPERTY);
-			}
-			else
-			{
-				publish_with_new_properties(newProperties, messageHandle, idModule);
-			}
-			Map_Destroy(newProperties);
-		}
-		ConstMap_Destroy(properties);
-	}
+		{ GW_DEVICENAME_PROPERTY, match->deviceId },
+		{ GW_DEVICEKEY_PROPERTY, match->deviceKey },
+		{ GW_SOURCE_PROPERTY, GW_IDMAP_MODULE },
+		{ GW_MAC_ADDRESS_PROPERTY, NULL }
+	};
+	publish_with_property_edits(edits, sizeof(edits) / sizeof(edits[0]), messageHandle, idModule);
 }
 
 /*
@@ -465,55 +406,15 @@ static void IdentityMap_RepublishC2D(
 	MESSAGE_HANDLE messageHandle,
 	IDENTITY_MAP_CONFIG * match)
 {
-	CONSTMAP_HANDLE properties = Message_GetProperties(messageHandle);
-	if (properties == NULL)
+	/*Codes_SRS_IDMAP_17_060: [IdentityMap_Receive shall call Message_CloneWithPropertyEdits with edits that set "macAddress" to the found macAddress and "source" to "mapping", and that remove the "deviceName" and "deviceKey" properties.]*/
+	MESSAGE_PROPERTY_EDIT edits[] =
 	{
-
-		LogError("Could not extract message properties");
-	}
-	else
-	{
-		/*Codes_SRS_IDMAP_17_049: [ On a C2D message received, IdentityMap_Receive shall call ConstMap_CloneWriteable on the message properties. ]*/
-		MAP_HANDLE newProperties = ConstMap_CloneWriteable(properties);
-		if (newProperties == NULL)
-		{
-			/*Codes_SRS_IDMAP_17_050: [ If ConstMap_CloneWriteable fails, IdentityMap_Receive shall deallocate any resources and return. ]*/
-			LogError("Could not make writeable new properties map");
-		}
-		else
-		{
-			/*Codes_SRS_IDMAP_17_051: [ IdentityMap_Receive shall call Map_AddOrUpdate with key of "macAddress" and value of found macAddress. ]*/
-			if (Map_AddOrUpdate(newProperties, GW_MAC_ADDRESS_PROPERTY, match->macAddress) != MAP_OK)
-			{
-				/*Codes_SRS_IDMAP_17_052: [ If adding macAddress fails, IdentityMap_Receive shall deallocate all resources and return. ]*/
-				LogError("Could not attach %s property to message", GW_MAC_ADDRESS_PROPERTY);
-			}
-			/*Codes_SRS_IDMAP_17_032: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "source" and value of "mapping".]*/
-			else if (Map_AddOrUpdate(newProperties, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE) != MAP_OK)
-			{
-				/*Codes_SRS_IDMAP_17_033: [If adding source fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-				LogError("Could not attach %s property to message", GW_SOURCE_PROPERTY);
-			}
-			/*Codes_SRS_IDMAP_17_055: [ IdentityMap_Receive shall call Map_Delete to remove the "deviceName" property. ]*/
-			else if (Map_Delete(newProperties, GW_DEVICENAME_PROPERTY) != MAP_OK)
-			{
-				/*Codes_SRS_IDMAP_17_056: [ If deleting the device name fails, IdentityMap_Receive shall deallocate all resources and return. ]*/
-				LogError("Could not remove %s property from message", GW_DEVICENAME_PROPERTY);
-			}
-			/*Codes_SRS_IDMAP_17_057: [ IdentityMap_Receive shall call Map_Delete to remove the "deviceKey" property. ]*/
-			else if (Map_Delete(newProperties, GW_DEVICEKEY_PROPERTY) == MAP_INVALIDARG)
-			{
-				/*Codes_SRS_IDMAP_17_058: [ If deleting the device key does not return MAP_OK or MAP_KEYNOTFOUND, IdentityMap_Receive shall deallocate all resources and return. ]*/
-				LogError("Could not remove %s property from message", GW_DEVICEKEY_PROPERTY);
-			}
-			else
-			{
-				publish_with_new_properties(newProperties, messageHandle, idModule);
-			}
-			Map_Destroy(newProperties);
-		}
-		ConstMap_Destroy(properties);
-	}
+		{ GW_MAC_ADDRESS_PROPERTY, match->macAddress },
+		{ GW_SOURCE_PROPERTY, GW_IDMAP_MODULE },
+		{ GW_DEVICENAME_PROPERTY, NULL },
+		{ GW_DEVICEKEY_PROPERTY, NULL }
+	};
+	publish_with_property_edits(edits, sizeof(edits) / sizeof(edits[0]), messageHandle, idModule);
 }
 
 /* returns true if the message should continue to be processed, sets direction */
@@ -563,15 +464,14 @@ static void IdentityMap_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messa
 	{
 		IDENTITY_MAP_DATA * idModule = (IDENTITY_MAP_DATA*)moduleHandle;
 
-		CONSTMAP_HANDLE properties = Message_GetProperties(messageHandle);
-
-		const char * source = ConstMap_GetValue(properties, GW_SOURCE_PROPERTY);
+		/*Codes_SRS_IDMAP_17_062: [IdentityMap_Receive shall read the "source", "deviceName", "deviceKey" and "macAddress" properties of messageHandle with Message_GetPropertyById.]*/
+		const char * source = Message_GetPropertyById(messageHandle, MESSAGE_PROPERTY_SOURCE);
 		bool isC2DMessage;
 		if (determine_message_direction(source, &isC2DMessage))
 		{
 			if (isC2DMessage == true)
 			{
-				const char * deviceName = ConstMap_GetValue(properties, GW_DEVICENAME_PROPERTY);
+				const char * deviceName = Message_GetPropertyById(messageHandle, MESSAGE_PROPERTY_DEVICENAME);
 				/*Codes_SRS_IDMAP_17_045: [ If messageHandle properties does not contain "deviceName" property, then the message shall not be marked as a C2D message. */
 				if (deviceName != NULL)
 				{
@@ -595,14 +495,14 @@ static void IdentityMap_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messa
 			else
 			{
 				const char * messageMac = IdentityMapConfig_ToUpperCase(
-					ConstMap_GetValue(properties, GW_MAC_ADDRESS_PROPERTY));
+					Message_GetPropertyById(messageHandle, MESSAGE_PROPERTY_MAC_ADDRESS));
 
 				/*Codes_SRS_IDMAP_17_021: [If messageHandle properties does not contain "macAddress" property, then the function shall return.]*/
 				if (messageMac != NULL)
 				{
 					/*Codes_SRS_IDMAP_17_024: [If messageHandle properties contains properties "deviceName" and "deviceKey", then this function shall return.] */
-					if ((ConstMap_GetValue(properties, GW_DEVICENAME_PROPERTY) == NULL ||
-						ConstMap_GetValue(properties, GW_DEVICEKEY_PROPERTY) == NULL))
+					if ((Message_GetPropertyById(messageHandle, MESSAGE_PROPERTY_DEVICENAME) == NULL ||
+						Message_GetPropertyById(messageHandle, MESSAGE_PROPERTY_DEVICEKEY) == NULL))
 					{
 						if (IdentityMapConfig_IsCanonicalMAC(messageMac) == false)
 						{
@@ -633,8 +533,6 @@ static void IdentityMap_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messa
 				}
 			}
 		}
-		ConstMap_Destroy(properties);
-
 	}
 }
 
@@ -80,6 +80,8 @@ static size_t whenShallVectorElement_fail;
 
 static size_t currentMessage_call;
 static size_t whenShallMessage_fail;
+static MESSAGE_PROPERTY_EDIT clonedEdits[4];
+static size_t clonedEditCount;
 static CONSTBUFFER messageContent;
 
 class RefCountObject
@@ -310,6 +312,24 @@ TYPED_MOCK_CLASS(CIdentitymapMocks, CGlobalMock)
 			}
 	MOCK_METHOD_END(MESSAGE_HANDLE, result1)
 
+	MOCK_STATIC_METHOD_3(, MESSAGE_HANDLE, Message_CloneWithPropertyEdits, MESSAGE_HANDLE, message, const MESSAGE_PROPERTY_EDIT*, edits, size_t, editCount)
+			MESSAGE_HANDLE result1;
+			currentMessage_call++;
+			if (currentMessage_call == whenShallMessage_fail)
+			{
+				result1 = NULL;
+			}
+			else
+			{
+				clonedEditCount = editCount < 4 ? editCount : 4;
+				for (size_t i = 0; i < clonedEditCount; i++)
+				{
+					clonedEdits[i] = edits[i];
+				}
+				result1 = (MESSAGE_HANDLE)(new RefCountObject());
+			}
+	MOCK_METHOD_END(MESSAGE_HANDLE, result1)
+
 	MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message)
 		((RefCountObject*)message)->inc_ref();
 	MOCK_METHOD_END(MESSAGE_HANDLE, message)
@@ -327,6 +347,28 @@ TYPED_MOCK_CLASS(CIdentitymapMocks, CGlobalMock)
 		}
 	MOCK_METHOD_END(CONSTMAP_HANDLE, result1)
 
+	MOCK_STATIC_METHOD_2(, const char*, Message_GetPropertyById, MESSAGE_HANDLE, message, MESSAGE_PROPERTY_ID, id)
+		const char * result1;
+		switch (id)
+		{
+		case MESSAGE_PROPERTY_MAC_ADDRESS:
+			result1 = macAddressProperties;
+			break;
+		case MESSAGE_PROPERTY_SOURCE:
+			result1 = sourceProperties;
+			break;
+		case MESSAGE_PROPERTY_DEVICENAME:
+			result1 = deviceNameProperties;
+			break;
+		case MESSAGE_PROPERTY_DEVICEKEY:
+			result1 = deviceKeyProperties;
+			break;
+		default:
+			result1 = VALID_VALUE;
+			break;
+		}
+	MOCK_METHOD_END(const char *, result1)
+
 	MOCK_STATIC_METHOD_1(, const CONSTBUFFER*, Message_GetContent, MESSAGE_HANDLE, message)
 		CONSTBUFFER* result1 = &messageContent;
 	MOCK_METHOD_END(const CONSTBUFFER*, result1)
@@ -458,7 +500,9 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CIdentitymapMocks, , MAP_RESULT, Map_Delete, MAP_HA
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , MESSAGE_HANDLE, Message_CreateFromBuffer, const MESSAGE_BUFFER_CONFIG*, cfg);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_3(CIdentitymapMocks, , MESSAGE_HANDLE, Message_CloneWithPropertyEdits, MESSAGE_HANDLE, message, const MESSAGE_PROPERTY_EDIT*, edits, size_t, editCount);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , CONSTMAP_HANDLE, Message_GetProperties, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIdentitymapMocks, , const char*, Message_GetPropertyById, MESSAGE_HANDLE, message, MESSAGE_PROPERTY_ID, id);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , const CONSTBUFFER*, Message_GetContent, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , CONSTBUFFER_HANDLE, Message_GetContentHandle, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , void, Message_Destroy, MESSAGE_HANDLE, message);
@@ -524,6 +568,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 		deviceKeyProperties = NULL;
 		currentMessage_call = 0;
 		whenShallMessage_fail = 0;
+		clonedEditCount = 0;
 		currentConstMap_CloneWriteable_call = 0;
 		whenShallConstMap_CloneWriteable_fail = 0;
 		currentMap_call = 0;
@@ -977,6 +1022,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 		///Ablution
 	}
+
 	/*Tests_SRS_IDMAP_17_012: [If IdentityMap_Create fails to add a MAC address triplet to the macToDeviceArray, then this function shall fail, release all resources, and return NULL.]*/
 	TEST_FUNCTION(IdentityMap_Create_DeepCopy_fail_mac1)
 	{
@@ -1520,6 +1566,8 @@ BEGIN_TEST_SUITE(idmap_ut)
 		///Ablution
 	}
 
+	/*Tests_SRS_IDMAP_17_062: [IdentityMap_Receive shall read the "source", "deviceName", "deviceKey" and "macAddress" properties of messageHandle with Message_GetPropertyById.]*/
+	/*Tests_SRS_IDMAP_17_046: [ If messageHandle properties does not contain a "source" property, then the message shall not be marked as a C2D message. ]*/
 	TEST_FUNCTION(IdentityMap_Receive_no_source)
 	{
 		///Arrange
@@ -1536,11 +1584,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 		mocks.ResetAllCalls();
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
 
 
 		///Act
@@ -1555,6 +1599,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 		Broker_Destroy(broker);
 
 	}
+
 	/*Tests_SRS_IDMAP_17_021: [If messageHandle properties does not contain "macAddress" property, then the function shall return.]*/
 	TEST_FUNCTION(IdentityMap_Receive_D2C_no_Mac)
 	{
@@ -1574,13 +1619,8 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 		mocks.ResetAllCalls();
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_MAC_ADDRESS));
 		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 			.IgnoreAllArguments();
 
@@ -1620,20 +1660,13 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 		mocks.ResetAllCalls();
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_MAC_ADDRESS));
 		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 			.IgnoreAllArguments();
 		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
-			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICENAME));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICEKEY));
 
 
 		///Act
@@ -1671,20 +1704,13 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 		mocks.ResetAllCalls();
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_MAC_ADDRESS));
 		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 			.IgnoreAllArguments();
 		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
-			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICENAME));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICEKEY));
 
 
 		///Act
@@ -1722,20 +1748,13 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 		mocks.ResetAllCalls();
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_MAC_ADDRESS));
 		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 			.IgnoreAllArguments();
 		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
-			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICENAME));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICEKEY));
 
 
 
@@ -1773,20 +1792,13 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 		mocks.ResetAllCalls();
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_MAC_ADDRESS));
 		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 			.IgnoreAllArguments();
 		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
-			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICENAME));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICEKEY));
 
 
 		///Act
@@ -1802,8 +1814,8 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 	}
 
-	/*Tests_SRS_IDMAP_17_021: [If messageHandle properties does not contain "macAddress" property, then the function shall return.]*/
-	TEST_FUNCTION(IdentityMap_Receive_D2C_get_properties_2_fail)
+	/*Tests_SRS_IDMAP_17_061: [If Message_CloneWithPropertyEdits fails, IdentityMap_Receive shall deallocate all resources and return.]*/
+	TEST_FUNCTION(IdentityMap_Receive_D2C_CloneWithPropertyEdits_fail)
 	{
 		///Arrange
 		CIdentitymapMocks mocks;
@@ -1822,22 +1834,16 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 		mocks.ResetAllCalls();
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
+
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_MAC_ADDRESS));
 		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 			.IgnoreAllArguments();
 		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICENAME));
 		whenShallMessage_fail = 2;
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-
+		STRICT_EXPECTED_CALL(mocks, Message_CloneWithPropertyEdits(m, IGNORED_PTR_ARG, 4))
+			.IgnoreArgument(2);
 
 		///Act
 		theAPIS.Module_Receive(n, m);
@@ -1852,8 +1858,8 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 	}
 
-	/*Tests_SRS_IDMAP_17_027: [If ConstMap_CloneWriteable fails, IdentityMap_Receive shall deallocate any resources and return.]*/
-	TEST_FUNCTION(IdentityMap_Receive_D2C_CloneWriteable_fails)
+	/*Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
+	TEST_FUNCTION(IdentityMap_Receive_D2C_Broker_Publish_fail)
 	{
 		///Arrange
 		CIdentitymapMocks mocks;
@@ -1873,24 +1879,19 @@ BEGIN_TEST_SUITE(idmap_ut)
 		mocks.ResetAllCalls();
 
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
+
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_MAC_ADDRESS));
 		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 			.IgnoreAllArguments();
 		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		whenShallConstMap_CloneWriteable_fail = 1;
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICENAME));
+		STRICT_EXPECTED_CALL(mocks, Message_CloneWithPropertyEdits(m, IGNORED_PTR_ARG, 4))
+			.IgnoreArgument(2);
+		STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+		currentBrokerResult = BROKER_ERROR;
+		STRICT_EXPECTED_CALL(mocks, Broker_Publish(broker, n, IGNORED_PTR_ARG))
+			.IgnoreArgument(3);
 
 		///Act
 		theAPIS.Module_Receive(n, m);
@@ -1905,8 +1906,8 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 	}
 
-	/*Tests_SRS_IDMAP_17_029: [If adding deviceName fails,IdentityMap_Receive shall deallocate all resources and return.]*/
-	TEST_FUNCTION(IdentityMap_Receive_D2C_MapAdd1_fail)
+	/*Tests_SRS_IDMAP_17_061: [If Message_CloneWithPropertyEdits fails, IdentityMap_Receive shall deallocate all resources and return.]*/
+	TEST_FUNCTION(IdentityMap_Receive_C2D_CloneWithPropertyEdits_fail)
 	{
 		///Arrange
 		CIdentitymapMocks mocks;
@@ -1920,34 +1921,16 @@ BEGIN_TEST_SUITE(idmap_ut)
 		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
 		auto m = Message_Create(&cfg);
 
-		macAddressProperties = "aa:aa:bb:bb:cc:cc";
-		sourceProperties = GW_SOURCE_BLE_TELEMETRY;
+		deviceNameProperties = "aNiceDevice";
+		sourceProperties = GW_IOTHUB_MODULE;
 
 		mocks.ResetAllCalls();
 
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreAllArguments();
-		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		whenShallMap_fail = 1;
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice")).IgnoreArgument(1);
-
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICENAME));
+		whenShallMessage_fail = 2;
+		STRICT_EXPECTED_CALL(mocks, Message_CloneWithPropertyEdits(m, IGNORED_PTR_ARG, 4))
+			.IgnoreArgument(2);
 
 		///Act
 		theAPIS.Module_Receive(n, m);
@@ -1962,8 +1945,9 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 	}
 
-	/*Tests_SRS_IDMAP_17_031: [If adding deviceKey fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-	TEST_FUNCTION(IdentityMap_Receive_D2C_MapAdd2_fail)
+	/*Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
+	/*Tests_SRS_IDMAP_17_039: [IdentityMap_Receive will destroy all resources it created.]*/
+	TEST_FUNCTION(IdentityMap_Receive_C2D_Broker_Publish_fail)
 	{
 		///Arrange
 		CIdentitymapMocks mocks;
@@ -1977,34 +1961,19 @@ BEGIN_TEST_SUITE(idmap_ut)
 		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
 		auto m = Message_Create(&cfg);
 
-		macAddressProperties = "aa:aa:bb:bb:cc:cc";
-		sourceProperties = GW_SOURCE_BLE_TELEMETRY;
+		deviceNameProperties = "aNiceDevice";
+		sourceProperties = GW_IOTHUB_MODULE;
 
 		mocks.ResetAllCalls();
 
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreAllArguments();
-		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		whenShallMap_fail = 2;
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice")).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "aNiceKey")).IgnoreArgument(1);
-
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICENAME));
+		STRICT_EXPECTED_CALL(mocks, Message_CloneWithPropertyEdits(m, IGNORED_PTR_ARG, 4))
+			.IgnoreArgument(2);
+		STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+		currentBrokerResult = BROKER_ERROR;
+		STRICT_EXPECTED_CALL(mocks, Broker_Publish(broker, n, IGNORED_PTR_ARG))
+			.IgnoreArgument(3);
 
 		///Act
 		theAPIS.Module_Receive(n, m);
@@ -2019,8 +1988,10 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 	}
 
-	/*Tests_SRS_IDMAP_17_033: [If adding source fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-	TEST_FUNCTION(IdentityMap_Receive_D2C_MapAdd3_fail)
+	/*Tests_SRS_IDMAP_17_059: [IdentityMap_Receive shall call Message_CloneWithPropertyEdits with edits that set "deviceName" to the found deviceId, "deviceKey" to the found deviceKey and "source" to "mapping", and that remove the "macAddress" property.]*/
+	/*Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
+	/*Tests_SRS_IDMAP_17_039: [IdentityMap_Receive will destroy all resources it created.]*/
+	TEST_FUNCTION(IdentityMap_Receive_D2C_Success)
 	{
 		///Arrange
 		CIdentitymapMocks mocks;
@@ -2028,56 +1999,75 @@ BEGIN_TEST_SUITE(idmap_ut)
 		Module_GetAPIS(&theAPIS);
 
 		unsigned char fake;
-		BROKER_HANDLE broker = Broker_Create();
-		auto n = theAPIS.Module_Create(broker, testVector2);
+		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
+		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
+
+		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
+		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
+		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
+		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
+		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
+		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
+		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7"	};
+		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
+		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
+		VECTOR_push_back(v, &c1, 1);
+		VECTOR_push_back(v, &c2, 1);
+		VECTOR_push_back(v, &c3, 1);
+		VECTOR_push_back(v, &c4, 1);
+		VECTOR_push_back(v, &c5, 1);
+		VECTOR_push_back(v, &c6, 1);
+		VECTOR_push_back(v, &c7, 1);
+		VECTOR_push_back(v, &c8, 1);
+		VECTOR_push_back(v, &c9, 1);
+		auto n = theAPIS.Module_Create(broker, v);
 
 		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
 		auto m = Message_Create(&cfg);
 
-		macAddressProperties = "aa:aa:bb:bb:cc:cc";
+		macAddressProperties = "07:07:07:07:07:07";
 		sourceProperties = GW_SOURCE_BLE_TELEMETRY;
 
 		mocks.ResetAllCalls();
 
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_MAC_ADDRESS));
 		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 			.IgnoreAllArguments();
 		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		whenShallMap_fail = 3;
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice")).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "aNiceKey")).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE)).IgnoreArgument(1);
-
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICENAME));
+		STRICT_EXPECTED_CALL(mocks, Message_CloneWithPropertyEdits(m, IGNORED_PTR_ARG, 4))
+			.IgnoreArgument(2);
+		STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)&fake, n, IGNORED_PTR_ARG))
+			.IgnoreArgument(3);
 
 		///Act
 		theAPIS.Module_Receive(n, m);
 
 		///Assert
 		mocks.AssertActualAndExpectedCalls();
+		ASSERT_ARE_EQUAL(size_t, 4, clonedEditCount);
+		ASSERT_ARE_EQUAL(char_ptr, GW_DEVICENAME_PROPERTY, clonedEdits[0].key);
+		ASSERT_ARE_EQUAL(char_ptr, "Sensor7", clonedEdits[0].value);
+		ASSERT_ARE_EQUAL(char_ptr, GW_DEVICEKEY_PROPERTY, clonedEdits[1].key);
+		ASSERT_ARE_EQUAL(char_ptr, "theKeyFor7", clonedEdits[1].value);
+		ASSERT_ARE_EQUAL(char_ptr, GW_SOURCE_PROPERTY, clonedEdits[2].key);
+		ASSERT_ARE_EQUAL(char_ptr, GW_IDMAP_MODULE, clonedEdits[2].value);
+		ASSERT_ARE_EQUAL(char_ptr, GW_MAC_ADDRESS_PROPERTY, clonedEdits[3].key);
+		ASSERT_IS_NULL(clonedEdits[3].value);
 
 		///Ablution
 		Message_Destroy(m);
+		VECTOR_destroy(v);
 		theAPIS.Module_Destroy(n);
-		Broker_Destroy(broker);
 
 	}
 
-	/*Tests_SRS_IDMAP_17_035: [If cloning message content fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-	TEST_FUNCTION(IdentityMap_Receive_D2C_Message_GetContent_fail)
+	//Tests_SRS_IDMAP_17_060: [ IdentityMap_Receive shall call Message_CloneWithPropertyEdits with edits that set "macAddress" to the found macAddress and "source" to "mapping", and that remove the "deviceName" and "deviceKey" properties. ]
+	//Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]
+	TEST_FUNCTION(IdentityMap_Receive_C2D_Success)
 	{
 		///Arrange
 		CIdentitymapMocks mocks;
@@ -2085,59 +2075,71 @@ BEGIN_TEST_SUITE(idmap_ut)
 		Module_GetAPIS(&theAPIS);
 
 		unsigned char fake;
-		BROKER_HANDLE broker = Broker_Create();
-		auto n = theAPIS.Module_Create(broker, testVector2);
+		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
+		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
+
+		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
+		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
+		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
+		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
+		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
+		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
+		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
+		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
+		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
+		VECTOR_push_back(v, &c1, 1);
+		VECTOR_push_back(v, &c2, 1);
+		VECTOR_push_back(v, &c3, 1);
+		VECTOR_push_back(v, &c4, 1);
+		VECTOR_push_back(v, &c5, 1);
+		VECTOR_push_back(v, &c6, 1);
+		VECTOR_push_back(v, &c7, 1);
+		VECTOR_push_back(v, &c8, 1);
+		VECTOR_push_back(v, &c9, 1);
+		auto n = theAPIS.Module_Create(broker, v);
 
 		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
 		auto m = Message_Create(&cfg);
 
-		macAddressProperties = "aa:aa:bb:bb:cc:cc";
-		sourceProperties = GW_SOURCE_BLE_TELEMETRY;
+		deviceNameProperties = "Sensor7";
+		sourceProperties = GW_IOTHUB_MODULE;
 
 		mocks.ResetAllCalls();
 
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreAllArguments();
-		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice")).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "aNiceKey")).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
-		whenShallMessage_fail = 3;
-		STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICENAME));
+            
+		STRICT_EXPECTED_CALL(mocks, Message_CloneWithPropertyEdits(m, IGNORED_PTR_ARG, 4))
+			.IgnoreArgument(2);
+		STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)&fake, n, IGNORED_PTR_ARG))
+			.IgnoreArgument(3);
 
 		///Act
 		theAPIS.Module_Receive(n, m);
 
 		///Assert
 		mocks.AssertActualAndExpectedCalls();
+		ASSERT_ARE_EQUAL(size_t, 4, clonedEditCount);
+		ASSERT_ARE_EQUAL(char_ptr, GW_MAC_ADDRESS_PROPERTY, clonedEdits[0].key);
+		ASSERT_ARE_EQUAL(char_ptr, "07:07:07:07:07:07", clonedEdits[0].value);
+		ASSERT_ARE_EQUAL(char_ptr, GW_SOURCE_PROPERTY, clonedEdits[1].key);
+		ASSERT_ARE_EQUAL(char_ptr, GW_IDMAP_MODULE, clonedEdits[1].value);
+		ASSERT_ARE_EQUAL(char_ptr, GW_DEVICENAME_PROPERTY, clonedEdits[2].key);
+		ASSERT_IS_NULL(clonedEdits[2].value);
+		ASSERT_ARE_EQUAL(char_ptr, GW_DEVICEKEY_PROPERTY, clonedEdits[3].key);
+		ASSERT_IS_NULL(clonedEdits[3].value);
 
 		///Ablution
 		Message_Destroy(m);
+		VECTOR_destroy(v);
 		theAPIS.Module_Destroy(n);
-		Broker_Destroy(broker);
 
 	}
 
-	/*Tests_SRS_IDMAP_17_037: [If creating new message fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-	TEST_FUNCTION(IdentityMap_Receive_D2C_Message_CreateFromBuffer_fail)
+	//Tests_SRS_IDMAP_17_048: [ If the deviceName of the message is not found in deviceToMacArray, then the message shall not be marked as a C2D message. ]
+	TEST_FUNCTION(IdentityMap_Receive_C2D_id_no_match_no_new_msg)
 	{
 		///Arrange
 		CIdentitymapMocks mocks;
@@ -2145,50 +2147,40 @@ BEGIN_TEST_SUITE(idmap_ut)
 		Module_GetAPIS(&theAPIS);
 
 		unsigned char fake;
-		BROKER_HANDLE broker = Broker_Create();
-		auto n = theAPIS.Module_Create(broker, testVector2);
+		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
+		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
+
+		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
+		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
+		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
+		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
+		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
+		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
+		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
+		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
+		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
+		VECTOR_push_back(v, &c1, 1);
+		VECTOR_push_back(v, &c2, 1);
+		VECTOR_push_back(v, &c3, 1);
+		VECTOR_push_back(v, &c4, 1);
+		VECTOR_push_back(v, &c5, 1);
+		VECTOR_push_back(v, &c6, 1);
+		VECTOR_push_back(v, &c7, 1);
+		VECTOR_push_back(v, &c8, 1);
+		VECTOR_push_back(v, &c9, 1);
+		auto n = theAPIS.Module_Create(broker, v);
 
 		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
 		auto m = Message_Create(&cfg);
 
-		macAddressProperties = "aa:aa:bb:bb:cc:cc";
-		sourceProperties = GW_SOURCE_BLE_TELEMETRY;
+		deviceNameProperties = "Sensor13";
+		sourceProperties = GW_IOTHUB_MODULE;
 
 		mocks.ResetAllCalls();
 
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreAllArguments();
-		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice"))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "aNiceKey"))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-		whenShallMessage_fail = 4;
-		STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-			.IgnoreAllArguments();
-		STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICENAME));
 
 		///Act
 		theAPIS.Module_Receive(n, m);
@@ -2198,13 +2190,14 @@ BEGIN_TEST_SUITE(idmap_ut)
 
 		///Ablution
 		Message_Destroy(m);
+		VECTOR_destroy(v);
 		theAPIS.Module_Destroy(n);
-		Broker_Destroy(broker);
 
 	}
 
-	/*Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
-	TEST_FUNCTION(IdentityMap_Receive_D2C_Broker_Publish_fail)
+	//Tests_SRS_IDMAP_17_048: [ If the deviceName of the message is not found in deviceToMacArray, then the message shall not be marked as a C2D message. ]
+	//Tests_SRS_IDMAP_17_045: [ If messageHandle properties does not contain "deviceName" property, then the message shall not be marked as a C2D message. ]
+	TEST_FUNCTION(IdentityMap_Receive_C2D_no_id_no_new_msg)
 	{
 		///Arrange
 		CIdentitymapMocks mocks;
@@ -2212,975 +2205,40 @@ BEGIN_TEST_SUITE(idmap_ut)
 		Module_GetAPIS(&theAPIS);
 
 		unsigned char fake;
-		BROKER_HANDLE broker = Broker_Create();
-		auto n = theAPIS.Module_Create(broker, testVector2);
+		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
+		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
+
+		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
+		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
+		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
+		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
+		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
+		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
+		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
+		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
+		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
+		VECTOR_push_back(v, &c1, 1);
+		VECTOR_push_back(v, &c2, 1);
+		VECTOR_push_back(v, &c3, 1);
+		VECTOR_push_back(v, &c4, 1);
+		VECTOR_push_back(v, &c5, 1);
+		VECTOR_push_back(v, &c6, 1);
+		VECTOR_push_back(v, &c7, 1);
+		VECTOR_push_back(v, &c8, 1);
+		VECTOR_push_back(v, &c9, 1);
+		auto n = theAPIS.Module_Create(broker, v);
 
 		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
 		auto m = Message_Create(&cfg);
 
-		macAddressProperties = "aa:aa:bb:bb:cc:cc";
-		sourceProperties = GW_SOURCE_BLE_TELEMETRY;
+		deviceNameProperties = NULL;
+		sourceProperties = GW_IOTHUB_MODULE;
 
 		mocks.ResetAllCalls();
 
 
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreAllArguments();
-		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice"))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "aNiceKey"))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-		STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-			.IgnoreAllArguments();
-		STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		currentBrokerResult = BROKER_ERROR;
-		STRICT_EXPECTED_CALL(mocks, Broker_Publish(broker, n, IGNORED_PTR_ARG))
-			.IgnoreArgument(3);
-
-
-		///Act
-		theAPIS.Module_Receive(n, m);
-
-		///Assert
-		mocks.AssertActualAndExpectedCalls();
-
-		///Ablution
-		Message_Destroy(m);
-		theAPIS.Module_Destroy(n);
-		Broker_Destroy(broker);
-
-	}
-
-	//Tests_SRS_IDMAP_17_054: [ If deleting the MAC Address fails, IdentityMap_Receive shall deallocate all resources and return. ]
-	TEST_FUNCTION(IdentityMap_Receive_D2C_macaddress_delete_fails)
-	{
-		///Arrange
-		CIdentitymapMocks mocks;
-		MODULE_APIS theAPIS;
-		Module_GetAPIS(&theAPIS);
-
-		unsigned char fake;
-		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
-		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
-		VECTOR_push_back(v, &c1, 1);
-		VECTOR_push_back(v, &c2, 1);
-		VECTOR_push_back(v, &c3, 1);
-		VECTOR_push_back(v, &c4, 1);
-		VECTOR_push_back(v, &c5, 1);
-		VECTOR_push_back(v, &c6, 1);
-		VECTOR_push_back(v, &c7, 1);
-		VECTOR_push_back(v, &c8, 1);
-		VECTOR_push_back(v, &c9, 1);
-		auto n = theAPIS.Module_Create(broker, v);
-
-		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-		auto m = Message_Create(&cfg);
-
-		macAddressProperties = "07:07:07:07:07:07";
-		sourceProperties = GW_SOURCE_BLE_TELEMETRY;
-
-		mocks.ResetAllCalls();
-
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreAllArguments();
-		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "Sensor7"))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "theKeyFor7"))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1)
-			.SetFailReturn((MAP_RESULT)MAP_KEYNOTFOUND);
-
-
-		///Act
-		theAPIS.Module_Receive(n, m);
-
-		///Assert
-		mocks.AssertActualAndExpectedCalls();
-
-		///Ablution
-		Message_Destroy(m);
-		VECTOR_destroy(v);
-		theAPIS.Module_Destroy(n);
-
-	}
-
-	/*Tests_SRS_IDMAP_17_026: [On a message which passes all checks, IdentityMap_Receive shall call ConstMap_CloneWriteable on the message properties.]*/
-	/*Tests_SRS_IDMAP_17_028: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "deviceName" and value of found deviceId.]*/
-	/*Tests_SRS_IDMAP_17_032: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "source" and value of "mapping".]*/
-	/*Tests_SRS_IDMAP_17_030: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "deviceKey" and value of found deviceKey.]*/
-	/*Tests_SRS_IDMAP_17_053: [ IdentityMap_Receive shall call Map_Delete to remove the "macAddress" property. ]*/
-	/*Tests_SRS_IDMAP_17_034: [IdentityMap_Receive shall clone message content.]*/
-	/*Tests_SRS_IDMAP_17_036: [IdentityMap_Receive shall create a new message by calling Message_Create with new map and cloned content.]*/
-	/*Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
-	/*Tests_SRS_IDMAP_17_039: [IdentityMap_Receive will destroy all resources it created.]*/
-	TEST_FUNCTION(IdentityMap_Receive_D2C_Success)
-	{
-		///Arrange
-		CIdentitymapMocks mocks;
-		MODULE_APIS theAPIS;
-		Module_GetAPIS(&theAPIS);
-
-		unsigned char fake;
-		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7"	};
-		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
-		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
-		VECTOR_push_back(v, &c1, 1);
-		VECTOR_push_back(v, &c2, 1);
-		VECTOR_push_back(v, &c3, 1);
-		VECTOR_push_back(v, &c4, 1);
-		VECTOR_push_back(v, &c5, 1);
-		VECTOR_push_back(v, &c6, 1);
-		VECTOR_push_back(v, &c7, 1);
-		VECTOR_push_back(v, &c8, 1);
-		VECTOR_push_back(v, &c9, 1);
-		auto n = theAPIS.Module_Create(broker, v);
-
-		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-		auto m = Message_Create(&cfg);
-
-		macAddressProperties = "07:07:07:07:07:07";
-		sourceProperties = GW_SOURCE_BLE_TELEMETRY;
-
-		mocks.ResetAllCalls();
-
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-			.IgnoreAllArguments();
-		STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "Sensor7"))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "theKeyFor7"))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-		STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-			.IgnoreAllArguments();
-		STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)&fake, n, IGNORED_PTR_ARG))
-			.IgnoreArgument(3);
-
-
-		///Act
-		theAPIS.Module_Receive(n, m);
-
-		///Assert
-		mocks.AssertActualAndExpectedCalls();
-
-		///Ablution
-		Message_Destroy(m);
-		VECTOR_destroy(v);
-		theAPIS.Module_Destroy(n);
-
-	}
-
-	//Tests_SRS_IDMAP_17_049: [ On a C2D message received, IdentityMap_Receive shall call ConstMap_CloneWriteable on the message properties. ]
-	//Tests_SRS_IDMAP_17_051: [ IdentityMap_Receive shall call Map_AddOrUpdate with key of "macAddress" and value of found macAddress. ]
-	//Tests_SRS_IDMAP_17_055: [ IdentityMap_Receive shall call Map_Delete to remove the "deviceName" property. ]
-	//Tests_SRS_IDMAP_17_057: [ IdentityMap_Receive shall call Map_Delete to remove the "deviceKey" property. ]
-	//Tests_SRS_IDMAP_17_032: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "source" and value of "mapping".]
-	//Tests_SRS_IDMAP_17_034: [IdentityMap_Receive shall clone message content.]
-	//Tests_SRS_IDMAP_17_036: [IdentityMap_Receive shall create a new message by calling Message_CreateFromBuffer with new map and cloned content.]
-	//Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]
-	TEST_FUNCTION(IdentityMap_Receive_C2D_Success)
-	{
-		///Arrange
-		CIdentitymapMocks mocks;
-		MODULE_APIS theAPIS;
-		Module_GetAPIS(&theAPIS);
-
-		unsigned char fake;
-		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
-		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
-		VECTOR_push_back(v, &c1, 1);
-		VECTOR_push_back(v, &c2, 1);
-		VECTOR_push_back(v, &c3, 1);
-		VECTOR_push_back(v, &c4, 1);
-		VECTOR_push_back(v, &c5, 1);
-		VECTOR_push_back(v, &c6, 1);
-		VECTOR_push_back(v, &c7, 1);
-		VECTOR_push_back(v, &c8, 1);
-		VECTOR_push_back(v, &c9, 1);
-		auto n = theAPIS.Module_Create(broker, v);
-
-		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-		auto m = Message_Create(&cfg);
-
-		deviceNameProperties = "Sensor7";
-		sourceProperties = GW_IOTHUB_MODULE;
-
-		mocks.ResetAllCalls();
-
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-            
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-		STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-			.IgnoreAllArguments();
-		STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)&fake, n, IGNORED_PTR_ARG))
-			.IgnoreArgument(3);
-
-
-		///Act
-		theAPIS.Module_Receive(n, m);
-
-		///Assert
-		mocks.AssertActualAndExpectedCalls();
-
-		///Ablution
-		Message_Destroy(m);
-		VECTOR_destroy(v);
-		theAPIS.Module_Destroy(n);
-
-	}
-
-	//Tests_SRS_IDMAP_17_057: [ IdentityMap_Receive shall call Map_Delete to remove the "deviceKey" property. ]
-	TEST_FUNCTION(IdentityMap_Receive_C2D_no_key_key_delete)
-	{
-		///Arrange
-		CIdentitymapMocks mocks;
-		MODULE_APIS theAPIS;
-		Module_GetAPIS(&theAPIS);
-
-		unsigned char fake;
-		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
-		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
-		VECTOR_push_back(v, &c1, 1);
-		VECTOR_push_back(v, &c2, 1);
-		VECTOR_push_back(v, &c3, 1);
-		VECTOR_push_back(v, &c4, 1);
-		VECTOR_push_back(v, &c5, 1);
-		VECTOR_push_back(v, &c6, 1);
-		VECTOR_push_back(v, &c7, 1);
-		VECTOR_push_back(v, &c8, 1);
-		VECTOR_push_back(v, &c9, 1);
-		auto n = theAPIS.Module_Create(broker, v);
-
-		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-		auto m = Message_Create(&cfg);
-
-		deviceNameProperties = "Sensor7";
-		sourceProperties = GW_IOTHUB_MODULE;
-
-		mocks.ResetAllCalls();
-
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
-			.IgnoreArgument(1)
-			.SetFailReturn((MAP_RESULT)MAP_KEYNOTFOUND);
-		STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-		STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-			.IgnoreAllArguments();
-		STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)&fake, n, IGNORED_PTR_ARG))
-			.IgnoreArgument(3);
-
-
-		///Act
-		theAPIS.Module_Receive(n, m);
-
-		///Assert
-		mocks.AssertActualAndExpectedCalls();
-
-		///Ablution
-		Message_Destroy(m);
-		VECTOR_destroy(v);
-		theAPIS.Module_Destroy(n);
-
-	}
-
-	//Tests_SRS_IDMAP_17_058: [ If deleting the device key does not return MAP_OK or MAP_KEYNOTFOUND, IdentityMap_Receive shall deallocate all resources and return. ]
-	TEST_FUNCTION(IdentityMap_Receive_C2D_key_delete_fails)
-	{
-		///Arrange
-		CIdentitymapMocks mocks;
-		MODULE_APIS theAPIS;
-		Module_GetAPIS(&theAPIS);
-
-		unsigned char fake;
-		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
-		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
-		VECTOR_push_back(v, &c1, 1);
-		VECTOR_push_back(v, &c2, 1);
-		VECTOR_push_back(v, &c3, 1);
-		VECTOR_push_back(v, &c4, 1);
-		VECTOR_push_back(v, &c5, 1);
-		VECTOR_push_back(v, &c6, 1);
-		VECTOR_push_back(v, &c7, 1);
-		VECTOR_push_back(v, &c8, 1);
-		VECTOR_push_back(v, &c9, 1);
-		auto n = theAPIS.Module_Create(broker, v);
-
-		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-		auto m = Message_Create(&cfg);
-
-		deviceNameProperties = "Sensor7";
-		sourceProperties = GW_IOTHUB_MODULE;
-
-		mocks.ResetAllCalls();
-
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
-			.IgnoreArgument(1)
-			.SetFailReturn((MAP_RESULT)MAP_INVALIDARG);
-
-		///Act
-		theAPIS.Module_Receive(n, m);
-
-		///Assert
-		mocks.AssertActualAndExpectedCalls();
-
-		///Ablution
-		Message_Destroy(m);
-		VECTOR_destroy(v);
-		theAPIS.Module_Destroy(n);
-
-	}
-
-	//Tests_SRS_IDMAP_17_056: [ If deleting the device name fails, IdentityMap_Receive shall deallocate all resources and return. ]
-	TEST_FUNCTION(IdentityMap_Receive_C2D_devicename_delete_fails)
-	{
-		///Arrange
-		CIdentitymapMocks mocks;
-		MODULE_APIS theAPIS;
-		Module_GetAPIS(&theAPIS);
-
-		unsigned char fake;
-		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
-		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
-		VECTOR_push_back(v, &c1, 1);
-		VECTOR_push_back(v, &c2, 1);
-		VECTOR_push_back(v, &c3, 1);
-		VECTOR_push_back(v, &c4, 1);
-		VECTOR_push_back(v, &c5, 1);
-		VECTOR_push_back(v, &c6, 1);
-		VECTOR_push_back(v, &c7, 1);
-		VECTOR_push_back(v, &c8, 1);
-		VECTOR_push_back(v, &c9, 1);
-		auto n = theAPIS.Module_Create(broker, v);
-
-		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-		auto m = Message_Create(&cfg);
-
-		deviceNameProperties = "Sensor7";
-		sourceProperties = GW_IOTHUB_MODULE;
-
-		mocks.ResetAllCalls();
-
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1)
-			.SetFailReturn((MAP_RESULT)MAP_INVALIDARG);
-
-		///Act
-		theAPIS.Module_Receive(n, m);
-
-		///Assert
-		mocks.AssertActualAndExpectedCalls();
-
-		///Ablution
-		Message_Destroy(m);
-		VECTOR_destroy(v);
-		theAPIS.Module_Destroy(n);
-
-	}
-
-	//Tests_SRS_IDMAP_17_044: [ If messageHandle properties contains a "source" property that is set to "mapping", the message shall not be marked as a D2C message. ] 
-	TEST_FUNCTION(IdentityMap_Receive_C2D_MapUpdate_source_fails)
-	{
-		///Arrange
-		CIdentitymapMocks mocks;
-		MODULE_APIS theAPIS;
-		Module_GetAPIS(&theAPIS);
-
-		unsigned char fake;
-		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
-		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
-		VECTOR_push_back(v, &c1, 1);
-		VECTOR_push_back(v, &c2, 1);
-		VECTOR_push_back(v, &c3, 1);
-		VECTOR_push_back(v, &c4, 1);
-		VECTOR_push_back(v, &c5, 1);
-		VECTOR_push_back(v, &c6, 1);
-		VECTOR_push_back(v, &c7, 1);
-		VECTOR_push_back(v, &c8, 1);
-		VECTOR_push_back(v, &c9, 1);
-		auto n = theAPIS.Module_Create(broker, v);
-
-		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-		auto m = Message_Create(&cfg);
-
-		deviceNameProperties = "Sensor7";
-		sourceProperties = GW_IOTHUB_MODULE;
-
-		mocks.ResetAllCalls();
-
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-			.IgnoreArgument(1)
-			.SetFailReturn(MAP_ERROR);
-
-
-		///Act
-		theAPIS.Module_Receive(n, m);
-
-		///Assert
-		mocks.AssertActualAndExpectedCalls();
-
-		///Ablution
-		Message_Destroy(m);
-		VECTOR_destroy(v);
-		theAPIS.Module_Destroy(n);
-
-	}
-
-	//Tests_SRS_IDMAP_17_052: [ If adding macAddress fails, IdentityMap_Receive shall deallocate all resources and return. ]
-
-	TEST_FUNCTION(IdentityMap_Receive_C2D_MapUpdate_mac_fails)
-	{
-		///Arrange
-		CIdentitymapMocks mocks;
-		MODULE_APIS theAPIS;
-		Module_GetAPIS(&theAPIS);
-
-		unsigned char fake;
-		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
-		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
-		VECTOR_push_back(v, &c1, 1);
-		VECTOR_push_back(v, &c2, 1);
-		VECTOR_push_back(v, &c3, 1);
-		VECTOR_push_back(v, &c4, 1);
-		VECTOR_push_back(v, &c5, 1);
-		VECTOR_push_back(v, &c6, 1);
-		VECTOR_push_back(v, &c7, 1);
-		VECTOR_push_back(v, &c8, 1);
-		VECTOR_push_back(v, &c9, 1);
-		auto n = theAPIS.Module_Create(broker, v);
-
-		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-		auto m = Message_Create(&cfg);
-
-		deviceNameProperties = "Sensor7";
-		sourceProperties = GW_IOTHUB_MODULE;
-
-		mocks.ResetAllCalls();
-
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-			.IgnoreArgument(1)
-			.SetFailReturn(MAP_ERROR);
-
-
-		///Act
-		theAPIS.Module_Receive(n, m);
-
-		///Assert
-		mocks.AssertActualAndExpectedCalls();
-
-		///Ablution
-		Message_Destroy(m);
-		VECTOR_destroy(v);
-		theAPIS.Module_Destroy(n);
-
-	}
-
-	//Tests_SRS_IDMAP_17_050: [ If ConstMap_CloneWriteable fails, IdentityMap_Receive shall deallocate any resources and return. ]
-	TEST_FUNCTION(IdentityMap_Receive_C2D_clone_writeable_fails)
-	{
-		///Arrange
-		CIdentitymapMocks mocks;
-		MODULE_APIS theAPIS;
-		Module_GetAPIS(&theAPIS);
-
-		unsigned char fake;
-		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
-		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
-		VECTOR_push_back(v, &c1, 1);
-		VECTOR_push_back(v, &c2, 1);
-		VECTOR_push_back(v, &c3, 1);
-		VECTOR_push_back(v, &c4, 1);
-		VECTOR_push_back(v, &c5, 1);
-		VECTOR_push_back(v, &c6, 1);
-		VECTOR_push_back(v, &c7, 1);
-		VECTOR_push_back(v, &c8, 1);
-		VECTOR_push_back(v, &c9, 1);
-		auto n = theAPIS.Module_Create(broker, v);
-
-		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-		auto m = Message_Create(&cfg);
-
-		deviceNameProperties = "Sensor7";
-		sourceProperties = GW_IOTHUB_MODULE;
-
-		mocks.ResetAllCalls();
-
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG))
-			.IgnoreArgument(1)
-			.SetFailReturn((MAP_HANDLE)NULL);
-
-
-		///Act
-		theAPIS.Module_Receive(n, m);
-
-		///Assert
-		mocks.AssertActualAndExpectedCalls();
-
-		///Ablution
-		Message_Destroy(m);
-		VECTOR_destroy(v);
-		theAPIS.Module_Destroy(n);
-
-	}
-
-	//Tests_SRS_IDMAP_17_046: [ If messageHandle properties does not contain a "source" property, then the message shall not be marked as a C2D message. ]
-	TEST_FUNCTION(IdentityMap_Receive_C2D_getproperties_fails)
-	{
-		///Arrange
-		CIdentitymapMocks mocks;
-		MODULE_APIS theAPIS;
-		Module_GetAPIS(&theAPIS);
-
-		unsigned char fake;
-		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
-		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
-		VECTOR_push_back(v, &c1, 1);
-		VECTOR_push_back(v, &c2, 1);
-		VECTOR_push_back(v, &c3, 1);
-		VECTOR_push_back(v, &c4, 1);
-		VECTOR_push_back(v, &c5, 1);
-		VECTOR_push_back(v, &c6, 1);
-		VECTOR_push_back(v, &c7, 1);
-		VECTOR_push_back(v, &c8, 1);
-		VECTOR_push_back(v, &c9, 1);
-		auto n = theAPIS.Module_Create(broker, v);
-
-		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-		auto m = Message_Create(&cfg);
-
-		deviceNameProperties = "Sensor7";
-		sourceProperties = GW_IOTHUB_MODULE;
-
-		mocks.ResetAllCalls();
-
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m))
-			.SetFailReturn((CONSTMAP_HANDLE)NULL);
-
-		///Act
-		theAPIS.Module_Receive(n, m);
-
-		///Assert
-		mocks.AssertActualAndExpectedCalls();
-
-		///Ablution
-		Message_Destroy(m);
-		VECTOR_destroy(v);
-		theAPIS.Module_Destroy(n);
-
-	}
-
-	//Tests_SRS_IDMAP_17_048: [ If the deviceName of the message is not found in deviceToMacArray, then the message shall not be marked as a C2D message. ]
-	TEST_FUNCTION(IdentityMap_Receive_C2D_id_no_match_no_new_msg)
-	{
-		///Arrange
-		CIdentitymapMocks mocks;
-		MODULE_APIS theAPIS;
-		Module_GetAPIS(&theAPIS);
-
-		unsigned char fake;
-		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
-		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
-		VECTOR_push_back(v, &c1, 1);
-		VECTOR_push_back(v, &c2, 1);
-		VECTOR_push_back(v, &c3, 1);
-		VECTOR_push_back(v, &c4, 1);
-		VECTOR_push_back(v, &c5, 1);
-		VECTOR_push_back(v, &c6, 1);
-		VECTOR_push_back(v, &c7, 1);
-		VECTOR_push_back(v, &c8, 1);
-		VECTOR_push_back(v, &c9, 1);
-		auto n = theAPIS.Module_Create(broker, v);
-
-		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-		auto m = Message_Create(&cfg);
-
-		deviceNameProperties = "Sensor13";
-		sourceProperties = GW_IOTHUB_MODULE;
-
-		mocks.ResetAllCalls();
-
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
-
-		///Act
-		theAPIS.Module_Receive(n, m);
-
-		///Assert
-		mocks.AssertActualAndExpectedCalls();
-
-		///Ablution
-		Message_Destroy(m);
-		VECTOR_destroy(v);
-		theAPIS.Module_Destroy(n);
-
-	}
-
-	//Tests_SRS_IDMAP_17_048: [ If the deviceName of the message is not found in deviceToMacArray, then the message shall not be marked as a C2D message. ]
-	//Tests_SRS_IDMAP_17_045: [ If messageHandle properties does not contain "deviceName" property, then the message shall not be marked as a C2D message. ]
-	TEST_FUNCTION(IdentityMap_Receive_C2D_no_id_no_new_msg)
-	{
-		///Arrange
-		CIdentitymapMocks mocks;
-		MODULE_APIS theAPIS;
-		Module_GetAPIS(&theAPIS);
-
-		unsigned char fake;
-		BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-		VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-		IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-		IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-		IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-		IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-		IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-		IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-		IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-		IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08",	"Sensor8", "theKeyFor8" };
-		IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9",  "theKeyFor9" };
-		VECTOR_push_back(v, &c1, 1);
-		VECTOR_push_back(v, &c2, 1);
-		VECTOR_push_back(v, &c3, 1);
-		VECTOR_push_back(v, &c4, 1);
-		VECTOR_push_back(v, &c5, 1);
-		VECTOR_push_back(v, &c6, 1);
-		VECTOR_push_back(v, &c7, 1);
-		VECTOR_push_back(v, &c8, 1);
-		VECTOR_push_back(v, &c9, 1);
-		auto n = theAPIS.Module_Create(broker, v);
-
-		MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-		auto m = Message_Create(&cfg);
-
-		deviceNameProperties = NULL;
-		sourceProperties = GW_IOTHUB_MODULE;
-
-		mocks.ResetAllCalls();
-
-
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_DEVICENAME));
 
 		///Act
 		theAPIS.Module_Receive(n, m);
@@ -3236,11 +2294,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 		mocks.ResetAllCalls();
 
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
 
 
 		///Act
@@ -3299,11 +2353,7 @@ BEGIN_TEST_SUITE(idmap_ut)
 		mocks.ResetAllCalls();
 
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-			.IgnoreArgument(1);
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(m, MESSAGE_PROPERTY_SOURCE));
 
 
 		///Act
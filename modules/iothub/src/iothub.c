@@ -39,10 +39,7 @@ typedef struct IOTHUB_HANDLE_DATA_TAG
     BROKER_HANDLE broker;
 }IOTHUB_HANDLE_DATA;
 
-#define SOURCE "source"
 #define MAPPING "mapping"
-#define DEVICENAME "deviceName"
-#define DEVICEKEY "deviceKey"
 
 static MODULE_HANDLE IotHub_Create(BROKER_HANDLE broker, const void* configuration)
 {
@@ -482,8 +479,7 @@ static void IotHub_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHan
     }
     else
     {
-        CONSTMAP_HANDLE properties = Message_GetProperties(messageHandle);
-        const char* source = ConstMap_GetValue(properties, SOURCE); /*properties is !=NULL by contract of Message*/
+        const char* source = Message_GetPropertyById(messageHandle, MESSAGE_PROPERTY_SOURCE);
 
         /*Codes_SRS_IOTHUBMODULE_02_010: [ If message properties do not contain a property called "source" having the value set to "mapping" then `IotHub_Receive` shall do nothing. ]*/
         if (
@@ -496,7 +492,7 @@ static void IotHub_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHan
         else
         {
             /*Codes_SRS_IOTHUBMODULE_02_011: [ If message properties do not contain a property called "deviceName" having a non-`NULL` value then `IotHub_Receive` shall do nothing. ]*/
-            const char* deviceName = ConstMap_GetValue(properties, DEVICENAME);
+            const char* deviceName = Message_GetPropertyById(messageHandle, MESSAGE_PROPERTY_DEVICENAME);
             if (deviceName == NULL)
             {
                 /*do nothing, not a message for this module*/
@@ -504,7 +500,7 @@ static void IotHub_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHan
             else
             {
                 /*Codes_SRS_IOTHUBMODULE_02_012: [ If message properties do not contain a property called "deviceKey" having a non-`NULL` value then `IotHub_Receive` shall do nothing. ]*/
-                const char* deviceKey = ConstMap_GetValue(properties, DEVICEKEY);
+                const char* deviceKey = Message_GetPropertyById(messageHandle, MESSAGE_PROPERTY_DEVICEKEY);
                 if (deviceKey == NULL)
                 {
                     /*do nothing, missing device key*/
@@ -546,7 +542,6 @@ static void IotHub_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHan
                 }
             }
         }
-        ConstMap_Destroy(properties);
     }
     /*Codes_SRS_IOTHUBMODULE_02_022: [ If `IoTHubClient_SendEventAsync` succeeds then `IotHub_Receive` shall return. ]*/
 }
@@ -149,6 +149,33 @@ static MAP_HANDLE MAP_HANDLE_VALID_2 = ((MAP_HANDLE)(7));
 static const char* CONSTMAP_KEYS_VALID_2[3] = { "source", "deviceName", "deviceKey"};
 static const char* CONSTMAP_VALUES_VALID_2[3] = { "mapping", "secondDevice", "red"};
 
+/*the keys of the well-known message properties, indexed by MESSAGE_PROPERTY_ID*/
+static const char* MESSAGE_PROPERTY_KEYS[MESSAGE_PROPERTY_ID_COUNT] =
+{
+    GW_SOURCE_PROPERTY,
+    GW_MAC_ADDRESS_PROPERTY,
+    GW_DEVICENAME_PROPERTY,
+    GW_DEVICEKEY_PROPERTY,
+    GW_BLE_CONTROLLER_INDEX_PROPERTY,
+    GW_TIMESTAMP_PROPERTY,
+    GW_CHARACTERISTIC_UUID_PROPERTY
+};
+
+static const char* find_property_value(const char** keys, const char** values, size_t count, const char* key)
+{
+    const char* result = NULL;
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        if (strcmp(keys[i], key) == 0)
+        {
+            result = values[i];
+            break;
+        }
+    }
+    return result;
+}
+
 /*these are simple cached variables*/
 static pfModule_Create Module_Create = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
 static pfModule_Destroy Module_Destroy = NULL; /*gets assigned in TEST_SUITE_INITIALIZE*/
@@ -432,6 +459,26 @@ public:
         }
     MOCK_METHOD_END(CONSTMAP_HANDLE, result2)
 
+    MOCK_STATIC_METHOD_2(, const char*, Message_GetPropertyById, MESSAGE_HANDLE, message, MESSAGE_PROPERTY_ID, id)
+        const char* result2;
+        if (message == MESSAGE_HANDLE_WITH_SOURCE_NOT_SET_TO_MAPPING)
+        {
+            result2 = (id == MESSAGE_PROPERTY_SOURCE) ? "notMapping" : NULL;
+        }
+        else if (message == MESSAGE_HANDLE_VALID_1)
+        {
+            result2 = find_property_value(CONSTMAP_KEYS_VALID_1, CONSTMAP_VALUES_VALID_1, sizeof(CONSTMAP_KEYS_VALID_1) / sizeof(CONSTMAP_KEYS_VALID_1[0]), MESSAGE_PROPERTY_KEYS[id]);
+        }
+        else if (message == MESSAGE_HANDLE_VALID_2)
+        {
+            result2 = find_property_value(CONSTMAP_KEYS_VALID_2, CONSTMAP_VALUES_VALID_2, sizeof(CONSTMAP_KEYS_VALID_2) / sizeof(CONSTMAP_KEYS_VALID_2[0]), MESSAGE_PROPERTY_KEYS[id]);
+        }
+        else
+        {
+            result2 = NULL;
+        }
+    MOCK_METHOD_END(const char*, result2)
+
     MOCK_STATIC_METHOD_2(, const char*, ConstMap_GetValue, CONSTMAP_HANDLE, handle, const char*, key)
         const char* result2;
         if (handle == CONSTMAP_HANDLE_WITHOUT_SOURCE)
@@ -613,6 +660,7 @@ DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void, IoTHubClient_Destroy, IOTHUB_C
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , CONSTMAP_HANDLE, Message_GetProperties, MESSAGE_HANDLE, message)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg)
 DECLARE_GLOBAL_MOCK_METHOD_1(IotHubMocks, , void, Message_Destroy, MESSAGE_HANDLE, message)
+DECLARE_GLOBAL_MOCK_METHOD_2(IotHubMocks, , const char*, Message_GetPropertyById, MESSAGE_HANDLE, message, MESSAGE_PROPERTY_ID, id)
 DECLARE_GLOBAL_MOCK_METHOD_2(IotHubMocks, , const char*, ConstMap_GetValue, CONSTMAP_HANDLE, handle, const char*, key)
 DECLARE_GLOBAL_MOCK_METHOD_3(IotHubMocks, , MAP_RESULT, Map_AddOrUpdate, MAP_HANDLE, handle, const char*, key, const char*, value);
 DECLARE_GLOBAL_MOCK_METHOD_3(IotHubMocks, , MAP_RESULT, Map_Add, MAP_HANDLE, handle, const char*, key, const char*, value);
@@ -1328,15 +1376,11 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICEKEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -1515,15 +1559,11 @@ BEGIN_TEST_SUITE(iothub_ut)
         Module_Receive(module, MESSAGE_HANDLE_VALID_1);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICEKEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. One in this test*/
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
@@ -1598,15 +1638,11 @@ BEGIN_TEST_SUITE(iothub_ut)
         Module_Receive(module, MESSAGE_HANDLE_VALID_1);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_2));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_2, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_2, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_2, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_2, MESSAGE_PROPERTY_DEVICENAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_2, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_2, MESSAGE_PROPERTY_DEVICEKEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. One in this test*/
         STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
@@ -1711,15 +1747,11 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICEKEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -1826,15 +1858,11 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICEKEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -1937,15 +1965,11 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICEKEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2044,15 +2068,11 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICEKEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2145,15 +2165,11 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICEKEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2226,15 +2242,11 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICEKEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2302,15 +2314,11 @@ BEGIN_TEST_SUITE(iothub_ut)
 		auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
 		mocks.ResetAllCalls();
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME));
 
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICEKEY));
 
 		/*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
 		STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2348,15 +2356,11 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICEKEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2413,15 +2417,11 @@ BEGIN_TEST_SUITE(iothub_ut)
 		auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
 		mocks.ResetAllCalls();
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME));
 
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICEKEY));
 
 		/*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
 		STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2484,15 +2484,11 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICEKEY));
 
         /*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
         STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2534,15 +2530,11 @@ BEGIN_TEST_SUITE(iothub_ut)
 		auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
 		mocks.ResetAllCalls();
 
-		STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-		STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-			.IgnoreArgument(1);
-
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME));
 
-		STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"));
+		STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICEKEY));
 
 		/*VECTOR_find_if incurs a STRING_c_str until it find the deviceName. None in this test*/
 		STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2574,15 +2566,11 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"));
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceKey"))
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICEKEY))
             .SetReturn((const char*)NULL);
 
         ///act
@@ -2603,13 +2591,9 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE));
 
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "deviceName"))
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_DEVICENAME))
             .SetReturn((const char*)NULL);
 
         ///act
@@ -2630,11 +2614,7 @@ BEGIN_TEST_SUITE(iothub_ut)
         auto module = Module_Create(BROKER_HANDLE_VALID, &config_valid);
         mocks.ResetAllCalls();
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(MESSAGE_HANDLE_VALID_1));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(CONSTMAP_HANDLE_VALID_1, "source"))
+        STRICT_EXPECTED_CALL(mocks, Message_GetPropertyById(MESSAGE_HANDLE_VALID_1, MESSAGE_PROPERTY_SOURCE))
             .SetReturn((const char*)NULL);
 
         ///act
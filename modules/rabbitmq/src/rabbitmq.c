@@ -36,10 +36,9 @@ static void RabbitMQ_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageH
 {
 	char buf[16];
 	RabbitMQ_Data * mq = (RabbitMQ_Data*)moduleHandle;	
-	CONSTMAP_HANDLE properties = Message_GetProperties(messageHandle);
-	//const char * source = ConstMap_GetValue(properties, GW_SOURCE_PROPERTY);
+	//const char * source = Message_GetPropertyById(messageHandle, MESSAGE_PROPERTY_SOURCE);
 	
-	const char* deviceId = ConstMap_GetValue(properties, GW_DEVICENAME_PROPERTY);
+	const char* deviceId = Message_GetPropertyById(messageHandle, MESSAGE_PROPERTY_DEVICENAME);
 	if(deviceId == NULL) return;
 	
 	const CONSTBUFFER * message_content = Message_GetContent(messageHandle);
@@ -91,7 +90,10 @@ static void RabbitMQ_Destroy(MODULE_HANDLE moduleHandle)
 		return;
 	}
 	module_data->DeviceRunning = 0;
-	ThreadAPI_Join(module_data->DeviceThread, &result);
+	if (module_data->DeviceThread != NULL)
+	{
+		ThreadAPI_Join(module_data->DeviceThread, &result);
+	}
 	freeRabbitMQ_Data(module_data);
 	free(module_data);
 }
@@ -150,6 +152,10 @@ static int RabbitMQ_worker(void * user_data)
 	int ret;
 	char buf[128];
 	int fd = rabbitmq_data->client_fd;
+
+	if (Broker_ApplyModuleThreadOptions(rabbitmq_data->broker, (MODULE_HANDLE)rabbitmq_data) != BROKER_OK) {
+		LogError("Can't apply the thread options of the RabbitMQ module");
+	}
 	
 	while(rabbitmq_data->DeviceRunning) {
 		tv.tv_sec = 0;
@@ -260,10 +266,6 @@ static MODULE_HANDLE RabbitMQ_Create(BROKER_HANDLE broker, const void* configura
 		LogError("Can't run backend");
 		goto EXIT;
 	}
-	if (ThreadAPI_Create(&(result->DeviceThread),RabbitMQ_worker,(void*)result) != THREADAPI_OK) {
-		LogError("ThreadAPI_Create failed");
-		goto EXIT;
-	}
 	return result;	
 EXIT:
 	if(result) freeRabbitMQ_Data(result);
@@ -271,6 +273,23 @@ EXIT:
 	return NULL;
 }
 
+static void RabbitMQ_Start(MODULE_HANDLE moduleHandle)
+{
+	if (moduleHandle == NULL)
+	{
+		LogError("Attempt to start NULL module");
+	}
+	else
+	{
+		RabbitMQ_Data* module_data = (RabbitMQ_Data*)moduleHandle;
+		/* the worker publishes, so it only starts once the module was added to the broker */
+		if (ThreadAPI_Create(&(module_data->DeviceThread),RabbitMQ_worker,(void*)module_data) != THREADAPI_OK) {
+			LogError("ThreadAPI_Create failed");
+			module_data->DeviceThread = NULL;
+		}
+	}
+}
+
 /*
  *	Required for all modules:  the public API and the designated implementation functions.
  */
@@ -278,7 +297,8 @@ static const MODULE_APIS RabbitMQ_APIS_all =
 {
 	RabbitMQ_Create,
 	RabbitMQ_Destroy,
-	RabbitMQ_Receive
+	RabbitMQ_Receive,
+	RabbitMQ_Start
 };
 
 #ifdef BUILD_MODULE_TYPE_STATIC
@@ -0,0 +1,653 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "message.h"
+#include "remote_module_channel.h"
+#include "remote_module_ring.h"
+
+/*"RING", stored last by the creator so that the opener knows the segment is initialized*/
+#define RING_MAGIC 0x474E4952u
+#define RING_CACHE_LINE_SIZE 64
+#define RING_RECORD_ALIGNMENT 8
+#define RING_RECORD_HEADER_SIZE 8
+/*the size of a record that tells the consumer to go back to the start of the ring*/
+#define RING_WRAP_MARKER 0xFFFFFFFFu
+/*how often the host looks for a ring the remote module has not created yet*/
+#define RING_OPEN_POLL_MS 100
+
+#define RING_ALIGN(size, alignment) (((size) + (alignment) - 1) & ~((size_t)(alignment) - 1))
+
+/*the head and the tail of a ring are written by different processes, they do not share a cache line*/
+typedef union RING_INDEX_TAG
+{
+    uint64_t        value;
+    unsigned char   pad[RING_CACHE_LINE_SIZE];
+} RING_INDEX;
+
+/*one way of the ring, head and tail count the bytes ever written and read*/
+typedef struct RING_DIRECTION_TAG
+{
+    RING_INDEX  head;
+    RING_INDEX  tail;
+    /*set by the consumer before it sleeps on wakeup, the producer only posts wakeup when it is set*/
+    int         consumer_waiting;
+    sem_t       wakeup;
+    /*set by the producer before it sleeps on room, the consumer only posts room when it is set*/
+    int         producer_waiting;
+    sem_t       room;
+} RING_DIRECTION;
+
+/*the start of the segment, the frames of both ways follow at RING_DATA_OFFSET*/
+typedef struct RING_SEGMENT_TAG
+{
+    uint32_t        magic;
+    uint32_t        reserved;
+    uint64_t        capacity;
+    RING_DIRECTION  directions[2];
+} RING_SEGMENT;
+
+#define RING_DATA_OFFSET RING_ALIGN(sizeof(RING_SEGMENT), RING_CACHE_LINE_SIZE)
+
+typedef struct RING_RECORD_HEADER_TAG
+{
+    uint32_t    size;
+    uint8_t     type;
+    uint8_t     reserved[3];
+} RING_RECORD_HEADER;
+
+typedef struct REMOTE_MODULE_RING_TAG
+{
+    RING_SEGMENT*   segment;
+    size_t          segment_size;
+    /*the shared memory name, kept by the creator to remove it*/
+    char*           path;
+    int             is_creator;
+    RING_DIRECTION* out;
+    unsigned char*  out_data;
+    RING_DIRECTION* in;
+    unsigned char*  in_data;
+    /*serializes the threads of this process that send*/
+    LOCK_HANDLE     send_lock;
+} REMOTE_MODULE_RING;
+
+static char* get_shm_path(const char* name)
+{
+    size_t name_length = strlen(name);
+    char* result = (char*)malloc(name_length + 2);
+    if (result == NULL)
+    {
+        LogError("malloc failed");
+    }
+    else
+    {
+        result[0] = '/';
+        (void)memcpy(result + 1, name, name_length + 1);
+    }
+    return result;
+}
+
+/*each side writes to one direction and reads from the other*/
+static void set_directions(REMOTE_MODULE_RING* ring)
+{
+    unsigned char* data = (unsigned char*)ring->segment + RING_DATA_OFFSET;
+    size_t capacity = (size_t)ring->segment->capacity;
+    size_t out_index = ring->is_creator ? 0 : 1;
+    ring->out = &ring->segment->directions[out_index];
+    ring->out_data = data + out_index * capacity;
+    ring->in = &ring->segment->directions[1 - out_index];
+    ring->in_data = data + (1 - out_index) * capacity;
+}
+
+static REMOTE_MODULE_RING* create_ring_data(const char* name, int is_creator)
+{
+    REMOTE_MODULE_RING* result = (REMOTE_MODULE_RING*)malloc(sizeof(REMOTE_MODULE_RING));
+    if (result == NULL)
+    {
+        LogError("malloc failed");
+    }
+    else if ((result->path = get_shm_path(name)) == NULL)
+    {
+        free(result);
+        result = NULL;
+    }
+    else if ((result->send_lock = Lock_Init()) == NULL)
+    {
+        LogError("unable to create the send lock of ring [%s]", name);
+        free(result->path);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        result->segment = NULL;
+        result->segment_size = 0;
+        result->is_creator = is_creator;
+    }
+    return result;
+}
+
+static void destroy_ring_data(REMOTE_MODULE_RING* ring)
+{
+    (void)Lock_Deinit(ring->send_lock);
+    free(ring->path);
+    free(ring);
+}
+
+/*initializes the semaphores of both ways, returns non-zero and destroys those it created if one fails*/
+static int init_semaphores(RING_SEGMENT* segment)
+{
+    int result = 0;
+    size_t initialized = 0;
+    while (result == 0 && initialized < 2)
+    {
+        RING_DIRECTION* direction = &segment->directions[initialized];
+        if (sem_init(&direction->wakeup, 1, 0) != 0)
+        {
+            result = __LINE__;
+        }
+        else if (sem_init(&direction->room, 1, 0) != 0)
+        {
+            (void)sem_destroy(&direction->wakeup);
+            result = __LINE__;
+        }
+        else
+        {
+            initialized++;
+        }
+    }
+
+    while (result != 0 && initialized > 0)
+    {
+        initialized--;
+        (void)sem_destroy(&segment->directions[initialized].wakeup);
+        (void)sem_destroy(&segment->directions[initialized].room);
+    }
+    return result;
+}
+
+REMOTE_MODULE_RING_HANDLE RemoteModuleRing_Create(const char* name, size_t capacity)
+{
+    REMOTE_MODULE_RING* result;
+    /*Codes_SRS_REMOTE_MODULE_RING_13_001: [ If name is NULL, or capacity is 0 or not a multiple of 8, RemoteModuleRing_Create shall fail and return NULL. ]*/
+    if (name == NULL || capacity == 0 || capacity % RING_RECORD_ALIGNMENT != 0)
+    {
+        LogError("invalid arg name=%p capacity=%zu", name, capacity);
+        result = NULL;
+    }
+    else if ((result = create_ring_data(name, 1)) == NULL)
+    {
+        /*Codes_SRS_REMOTE_MODULE_RING_13_004: [ If any underlying call fails, RemoteModuleRing_Create shall release the resources it acquired and return NULL. ]*/
+        LogError("unable to create ring [%s]", name);
+    }
+    else
+    {
+        int fd;
+        result->segment_size = RING_DATA_OFFSET + 2 * capacity;
+
+        /*Codes_SRS_REMOTE_MODULE_RING_13_002: [ RemoteModuleRing_Create shall remove a shared memory segment left with the same name by a gateway that did not exit, create a new one sized for a RING_SEGMENT and both ways of capacity bytes and map it. ]*/
+        (void)shm_unlink(result->path);
+        fd = shm_open(result->path, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0)
+        {
+            /*Codes_SRS_REMOTE_MODULE_RING_13_004: [ If any underlying call fails, RemoteModuleRing_Create shall release the resources it acquired and return NULL. ]*/
+            LogError("unable to create the shared memory segment [%s], errno=%d", result->path, errno);
+            destroy_ring_data(result);
+            result = NULL;
+        }
+        else
+        {
+            void* segment;
+            if (ftruncate(fd, (off_t)result->segment_size) != 0)
+            {
+                LogError("unable to size the shared memory segment [%s], errno=%d", result->path, errno);
+                segment = MAP_FAILED;
+            }
+            else
+            {
+                segment = mmap(NULL, result->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            (void)close(fd);
+
+            if (segment == MAP_FAILED)
+            {
+                /*Codes_SRS_REMOTE_MODULE_RING_13_004: [ If any underlying call fails, RemoteModuleRing_Create shall release the resources it acquired and return NULL. ]*/
+                LogError("unable to map the shared memory segment [%s]", result->path);
+                (void)shm_unlink(result->path);
+                destroy_ring_data(result);
+                result = NULL;
+            }
+            else
+            {
+                result->segment = (RING_SEGMENT*)segment;
+                result->segment->capacity = capacity;
+                result->segment->directions[0].head.value = 0;
+                result->segment->directions[0].tail.value = 0;
+                result->segment->directions[0].consumer_waiting = 0;
+                result->segment->directions[0].producer_waiting = 0;
+                result->segment->directions[1].head.value = 0;
+                result->segment->directions[1].tail.value = 0;
+                result->segment->directions[1].consumer_waiting = 0;
+                result->segment->directions[1].producer_waiting = 0;
+
+                /*Codes_SRS_REMOTE_MODULE_RING_13_003: [ RemoteModuleRing_Create shall initialize two process shared semaphores for each way, one the consumer sleeps on and one the producer sleeps on, and shall store the magic number of the segment last, so that RemoteModuleRing_Open only uses an initialized segment. ]*/
+                if (init_semaphores(result->segment) != 0)
+                {
+                    /*Codes_SRS_REMOTE_MODULE_RING_13_004: [ If any underlying call fails, RemoteModuleRing_Create shall release the resources it acquired and return NULL. ]*/
+                    LogError("unable to create the semaphores of ring [%s], errno=%d", result->path, errno);
+                    (void)munmap(segment, result->segment_size);
+                    (void)shm_unlink(result->path);
+                    destroy_ring_data(result);
+                    result = NULL;
+                }
+                else
+                {
+                    set_directions(result);
+                    __atomic_store_n(&result->segment->magic, RING_MAGIC, __ATOMIC_RELEASE);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+/*maps the segment once it exists, is sized and is initialized, returns 0 when it is not ready yet*/
+static int try_map_segment(REMOTE_MODULE_RING* ring, int* failed)
+{
+    int result = 0;
+    int fd = shm_open(ring->path, O_RDWR, 0);
+    if (fd < 0)
+    {
+        *failed = (errno != ENOENT);
+        if (*failed)
+        {
+            LogError("unable to open the shared memory segment [%s], errno=%d", ring->path, errno);
+        }
+    }
+    else
+    {
+        struct stat segment_stat;
+        if (fstat(fd, &segment_stat) != 0)
+        {
+            LogError("unable to read the size of the shared memory segment [%s], errno=%d", ring->path, errno);
+            *failed = 1;
+        }
+        else if ((size_t)segment_stat.st_size < RING_DATA_OFFSET)
+        {
+            /*the remote module has not sized it yet*/
+        }
+        else
+        {
+            void* segment = mmap(NULL, (size_t)segment_stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (segment == MAP_FAILED)
+            {
+                LogError("unable to map the shared memory segment [%s], errno=%d", ring->path, errno);
+                *failed = 1;
+            }
+            else if (__atomic_load_n(&((RING_SEGMENT*)segment)->magic, __ATOMIC_ACQUIRE) != RING_MAGIC)
+            {
+                /*the remote module has not initialized it yet*/
+                (void)munmap(segment, (size_t)segment_stat.st_size);
+            }
+            else if (RING_DATA_OFFSET + 2 * ((RING_SEGMENT*)segment)->capacity != (uint64_t)segment_stat.st_size)
+            {
+                LogError("the shared memory segment [%s] is not a ring", ring->path);
+                (void)munmap(segment, (size_t)segment_stat.st_size);
+                *failed = 1;
+            }
+            else
+            {
+                ring->segment = (RING_SEGMENT*)segment;
+                ring->segment_size = (size_t)segment_stat.st_size;
+                result = 1;
+            }
+        }
+        (void)close(fd);
+    }
+    return result;
+}
+
+REMOTE_MODULE_RING_HANDLE RemoteModuleRing_Open(const char* name)
+{
+    REMOTE_MODULE_RING* result;
+    /*Codes_SRS_REMOTE_MODULE_RING_13_005: [ If name is NULL, RemoteModuleRing_Open shall fail and return NULL. ]*/
+    if (name == NULL)
+    {
+        LogError("invalid arg name=NULL");
+        result = NULL;
+    }
+    else if ((result = create_ring_data(name, 0)) == NULL)
+    {
+        /*Codes_SRS_REMOTE_MODULE_RING_13_007: [ If any underlying call fails, or the segment is not a ring, RemoteModuleRing_Open shall release the resources it acquired and return NULL. ]*/
+        LogError("unable to open ring [%s]", name);
+    }
+    else
+    {
+        int failed = 0;
+        /*Codes_SRS_REMOTE_MODULE_RING_13_006: [ RemoteModuleRing_Open shall wait until the shared memory segment of name exists and its magic number is set, and map it. ]*/
+        while (!try_map_segment(result, &failed) && !failed)
+        {
+            ThreadAPI_Sleep(RING_OPEN_POLL_MS);
+        }
+
+        if (failed)
+        {
+            /*Codes_SRS_REMOTE_MODULE_RING_13_007: [ If any underlying call fails, or the segment is not a ring, RemoteModuleRing_Open shall release the resources it acquired and return NULL. ]*/
+            destroy_ring_data(result);
+            result = NULL;
+        }
+        else
+        {
+            set_directions(result);
+        }
+    }
+    return result;
+}
+
+void RemoteModuleRing_Destroy(REMOTE_MODULE_RING_HANDLE ring)
+{
+    /*Codes_SRS_REMOTE_MODULE_RING_13_008: [ If ring is NULL, RemoteModuleRing_Destroy shall do nothing. ]*/
+    if (ring != NULL)
+    {
+        /*Codes_SRS_REMOTE_MODULE_RING_13_009: [ RemoteModuleRing_Destroy shall unmap the segment, remove its name if ring was created by RemoteModuleRing_Create, and free ring. ]*/
+        /*the semaphores are not destroyed, the peer may still be using them until it unmaps the segment*/
+        (void)munmap(ring->segment, ring->segment_size);
+        if (ring->is_creator)
+        {
+            (void)shm_unlink(ring->path);
+        }
+        destroy_ring_data(ring);
+    }
+}
+
+/*sem_timedwait takes a CLOCK_REALTIME deadline*/
+static void get_deadline(int timeout_ms, struct timespec* deadline)
+{
+    (void)clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/*sleeps until the peer posts semaphore, the deadline passes or a signal comes*/
+static REMOTE_MODULE_CHANNEL_RESULT wait_for_peer(sem_t* semaphore, const struct timespec* deadline)
+{
+    REMOTE_MODULE_CHANNEL_RESULT result;
+    int wait_result = (deadline == NULL) ? sem_wait(semaphore) : sem_timedwait(semaphore, deadline);
+    if (wait_result == 0 || errno == EINTR)
+    {
+        result = REMOTE_MODULE_CHANNEL_OK;
+    }
+    else if (errno == ETIMEDOUT)
+    {
+        result = REMOTE_MODULE_CHANNEL_TIMEOUT;
+    }
+    else
+    {
+        LogError("unable to wait on a ring, errno=%d", errno);
+        result = REMOTE_MODULE_CHANNEL_ERROR;
+    }
+    return result;
+}
+
+/*waits until the consumer has read enough of the way for its head to move to new_head*/
+static REMOTE_MODULE_CHANNEL_RESULT wait_for_room(RING_DIRECTION* out, size_t capacity, uint64_t new_head, int timeout_ms)
+{
+    REMOTE_MODULE_CHANNEL_RESULT result = REMOTE_MODULE_CHANNEL_OK;
+    struct timespec deadline;
+    int has_deadline = (timeout_ms >= 0);
+    if (has_deadline)
+    {
+        get_deadline(timeout_ms, &deadline);
+    }
+
+    while (result == REMOTE_MODULE_CHANNEL_OK &&
+           new_head - __atomic_load_n(&out->tail.value, __ATOMIC_ACQUIRE) > capacity)
+    {
+        if (timeout_ms == 0)
+        {
+            /*Codes_SRS_REMOTE_MODULE_RING_13_013: [ If the ring has no room for the record and timeout_ms is 0, RemoteModuleRing_Send shall return REMOTE_MODULE_CHANNEL_TIMEOUT without waiting. ]*/
+            result = REMOTE_MODULE_CHANNEL_TIMEOUT;
+        }
+        else
+        {
+            /*Codes_SRS_REMOTE_MODULE_RING_13_022: [ Otherwise, while the ring has no room for the record, RemoteModuleRing_Send shall mark the producer waiting, check the ring again and sleep on the other semaphore of the way until the consumer frees a record or timeout_ms passes, forever if timeout_ms is negative, and shall return REMOTE_MODULE_CHANNEL_TIMEOUT if there is still no room then. ]*/
+            __atomic_store_n(&out->producer_waiting, 1, __ATOMIC_SEQ_CST);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (new_head - __atomic_load_n(&out->tail.value, __ATOMIC_ACQUIRE) > capacity)
+            {
+                result = wait_for_peer(&out->room, has_deadline ? &deadline : NULL);
+            }
+            /*a post left over from a wakeup that raced with this store only makes the next wait check the ring once more*/
+            __atomic_store_n(&out->producer_waiting, 0, __ATOMIC_SEQ_CST);
+        }
+    }
+    return result;
+}
+
+static void write_record_header(unsigned char* position, uint32_t size, REMOTE_MODULE_FRAME_TYPE type)
+{
+    RING_RECORD_HEADER* header = (RING_RECORD_HEADER*)position;
+    header->size = size;
+    header->type = (uint8_t)type;
+}
+
+REMOTE_MODULE_CHANNEL_RESULT RemoteModuleRing_Send(REMOTE_MODULE_RING_HANDLE ring, REMOTE_MODULE_FRAME_TYPE type, MESSAGE_HANDLE message, int timeout_ms)
+{
+    REMOTE_MODULE_CHANNEL_RESULT result;
+    int32_t payload_size = 0;
+    if (ring == NULL)
+    {
+        /*Codes_SRS_REMOTE_MODULE_RING_13_010: [ If ring is NULL, RemoteModuleRing_Send shall return REMOTE_MODULE_CHANNEL_ERROR. ]*/
+        LogError("invalid arg ring=NULL");
+        result = REMOTE_MODULE_CHANNEL_ERROR;
+    }
+    else if (message != NULL && (payload_size = Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, NULL, 0)) < 0)
+    {
+        /*Codes_SRS_REMOTE_MODULE_RING_13_014: [ If the message cannot be serialized, or its record is larger than the ring, RemoteModuleRing_Send shall return REMOTE_MODULE_CHANNEL_ERROR. ]*/
+        LogError("unable to serialize message [%p]", message);
+        result = REMOTE_MODULE_CHANNEL_ERROR;
+    }
+    else if (Lock(ring->send_lock) != LOCK_OK)
+    {
+        LogError("unable to lock ring [%p]", ring);
+        result = REMOTE_MODULE_CHANNEL_ERROR;
+    }
+    else
+    {
+        RING_DIRECTION* out = ring->out;
+        size_t capacity = (size_t)ring->segment->capacity;
+        /*Codes_SRS_REMOTE_MODULE_RING_13_011: [ RemoteModuleRing_Send shall write a record of an 8 byte header holding the size and the type of the frame, followed by the message serialized with MESSAGE_WIRE_FORMAT_V2 straight into the ring, aligned to 8 bytes. ]*/
+        size_t record_size = RING_ALIGN(RING_RECORD_HEADER_SIZE + (size_t)payload_size, RING_RECORD_ALIGNMENT);
+        /*the send lock is held while waiting for room, the head only moves under it*/
+        uint64_t head = out->head.value;
+        size_t offset = (size_t)(head % capacity);
+        size_t to_end = capacity - offset;
+        /*Codes_SRS_REMOTE_MODULE_RING_13_012: [ A record that does not fit before the end of the ring shall be preceded by a wrap marker and written at its start. ]*/
+        size_t needed = record_size + ((record_size > to_end) ? to_end : 0);
+
+        if (record_size > capacity)
+        {
+            /*Codes_SRS_REMOTE_MODULE_RING_13_014: [ If the message cannot be serialized, or its record is larger than the ring, RemoteModuleRing_Send shall return REMOTE_MODULE_CHANNEL_ERROR. ]*/
+            LogError("a frame of %zu bytes does not fit in ring [%p]", record_size, ring);
+            result = REMOTE_MODULE_CHANNEL_ERROR;
+        }
+        else if ((result = wait_for_room(out, capacity, head + needed, timeout_ms)) != REMOTE_MODULE_CHANNEL_OK)
+        {
+            /*the ring stayed full, or the wait failed*/
+        }
+        else
+        {
+            if (record_size > to_end)
+            {
+                write_record_header(ring->out_data + offset, RING_WRAP_MARKER, type);
+                head += to_end;
+                offset = 0;
+            }
+
+            if (message != NULL &&
+                Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, ring->out_data + offset + RING_RECORD_HEADER_SIZE, payload_size) != payload_size)
+            {
+                /*Codes_SRS_REMOTE_MODULE_RING_13_014: [ If the message cannot be serialized, or its record is larger than the ring, RemoteModuleRing_Send shall return REMOTE_MODULE_CHANNEL_ERROR. ]*/
+                LogError("unable to serialize message [%p]", message);
+                result = REMOTE_MODULE_CHANNEL_ERROR;
+            }
+            else
+            {
+                write_record_header(ring->out_data + offset, (uint32_t)payload_size, type);
+
+                /*Codes_SRS_REMOTE_MODULE_RING_13_015: [ RemoteModuleRing_Send shall publish the record by storing the new head with release semantics, and shall post the semaphore of the way only if the consumer is waiting on it. ]*/
+                __atomic_store_n(&out->head.value, head + record_size, __ATOMIC_RELEASE);
+                __atomic_thread_fence(__ATOMIC_SEQ_CST);
+                if (__atomic_exchange_n(&out->consumer_waiting, 0, __ATOMIC_SEQ_CST) != 0 &&
+                    sem_post(&out->wakeup) != 0)
+                {
+                    LogError("unable to wake up the peer of ring [%p], errno=%d", ring, errno);
+                }
+                result = REMOTE_MODULE_CHANNEL_OK;
+            }
+        }
+        (void)Unlock(ring->send_lock);
+    }
+    return result;
+}
+
+/*frees what the consumer has read up to tail, and wakes up a producer that waits for room*/
+static void free_records(RING_DIRECTION* in, uint64_t tail)
+{
+    /*Codes_SRS_REMOTE_MODULE_RING_13_023: [ RemoteModuleRing_Receive shall post the other semaphore of the way after it stores a new tail only if the producer is waiting on it. ]*/
+    __atomic_store_n(&in->tail.value, tail, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&in->producer_waiting, __ATOMIC_RELAXED) != 0 &&
+        __atomic_exchange_n(&in->producer_waiting, 0, __ATOMIC_SEQ_CST) != 0 &&
+        sem_post(&in->room) != 0)
+    {
+        LogError("unable to wake up the producer of a ring, errno=%d", errno);
+    }
+}
+
+static int is_known_frame_type(uint8_t type)
+{
+    return type == REMOTE_MODULE_FRAME_HELLO ||
+        type == REMOTE_MODULE_FRAME_START ||
+        type == REMOTE_MODULE_FRAME_MESSAGE ||
+        type == REMOTE_MODULE_FRAME_DESTROY;
+}
+
+REMOTE_MODULE_CHANNEL_RESULT RemoteModuleRing_Receive(REMOTE_MODULE_RING_HANDLE ring, int timeout_ms, REMOTE_MODULE_FRAME_TYPE* type, MESSAGE_HANDLE* message)
+{
+    REMOTE_MODULE_CHANNEL_RESULT result;
+    if (ring == NULL || type == NULL || message == NULL)
+    {
+        /*Codes_SRS_REMOTE_MODULE_RING_13_016: [ If ring, type or message is NULL, RemoteModuleRing_Receive shall return REMOTE_MODULE_CHANNEL_ERROR. ]*/
+        LogError("invalid arg ring=%p type=%p message=%p", ring, type, message);
+        result = REMOTE_MODULE_CHANNEL_ERROR;
+    }
+    else
+    {
+        RING_DIRECTION* in = ring->in;
+        size_t capacity = (size_t)ring->segment->capacity;
+        struct timespec deadline;
+        int has_deadline = (timeout_ms >= 0);
+
+        *message = NULL;
+        if (has_deadline)
+        {
+            get_deadline(timeout_ms, &deadline);
+        }
+
+        result = REMOTE_MODULE_CHANNEL_TIMEOUT;
+        for (;;)
+        {
+            uint64_t tail = in->tail.value;
+            uint64_t head = __atomic_load_n(&in->head.value, __ATOMIC_ACQUIRE);
+            if (head == tail)
+            {
+                /*Codes_SRS_REMOTE_MODULE_RING_13_017: [ If the ring is empty, RemoteModuleRing_Receive shall mark the consumer waiting, check the ring again and sleep on the semaphore of the way until a record comes or timeout_ms passes, forever if timeout_ms is negative. ]*/
+                __atomic_store_n(&in->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+                __atomic_thread_fence(__ATOMIC_SEQ_CST);
+                if (__atomic_load_n(&in->head.value, __ATOMIC_ACQUIRE) != tail)
+                {
+                    __atomic_store_n(&in->consumer_waiting, 0, __ATOMIC_SEQ_CST);
+                }
+                else if ((result = wait_for_peer(&in->wakeup, has_deadline ? &deadline : NULL)) != REMOTE_MODULE_CHANNEL_OK)
+                {
+                    /*Codes_SRS_REMOTE_MODULE_RING_13_018: [ If no record comes in time, RemoteModuleRing_Receive shall return REMOTE_MODULE_CHANNEL_TIMEOUT. ]*/
+                    __atomic_store_n(&in->consumer_waiting, 0, __ATOMIC_SEQ_CST);
+                    break;
+                }
+                else
+                {
+                    /*woken up, the ring is checked again*/
+                }
+            }
+            else
+            {
+                size_t offset = (size_t)(tail % capacity);
+                const RING_RECORD_HEADER* header = (const RING_RECORD_HEADER*)(ring->in_data + offset);
+                uint32_t size = header->size;
+                if (size == RING_WRAP_MARKER)
+                {
+                    free_records(in, tail + (capacity - offset));
+                }
+                else if (RING_RECORD_HEADER_SIZE + (size_t)size > capacity - offset)
+                {
+                    /*Codes_SRS_REMOTE_MODULE_RING_13_021: [ If a record overruns the ring, RemoteModuleRing_Receive shall return REMOTE_MODULE_CHANNEL_ERROR. ]*/
+                    LogError("ring [%p] is corrupt, a record of %u bytes overruns it", ring, (unsigned int)size);
+                    result = REMOTE_MODULE_CHANNEL_ERROR;
+                    break;
+                }
+                else
+                {
+                    uint8_t record_type = header->type;
+                    if (!is_known_frame_type(record_type) ||
+                        (record_type == REMOTE_MODULE_FRAME_MESSAGE) != (size != 0))
+                    {
+                        /*Codes_SRS_REMOTE_MODULE_RING_13_020: [ If the record has an unknown type, is a control frame with a payload or is a message frame that cannot be deserialized, RemoteModuleRing_Receive shall skip it and return REMOTE_MODULE_CHANNEL_INVALID_FRAME. ]*/
+                        LogError("ring [%p] drops a frame of type 0x%02x and %u bytes", ring, (unsigned int)record_type, (unsigned int)size);
+                        result = REMOTE_MODULE_CHANNEL_INVALID_FRAME;
+                    }
+                    else if (record_type == REMOTE_MODULE_FRAME_MESSAGE &&
+                        /*Codes_SRS_REMOTE_MODULE_RING_13_019: [ RemoteModuleRing_Receive shall copy the message of a REMOTE_MODULE_FRAME_MESSAGE record out of the ring with Message_CreateFromByteArray, and shall then free the record by storing the new tail with release semantics. ]*/
+                        (*message = Message_CreateFromByteArray((const unsigned char*)header + RING_RECORD_HEADER_SIZE, (int32_t)size)) == NULL)
+                    {
+                        /*Codes_SRS_REMOTE_MODULE_RING_13_020: [ If the record has an unknown type, is a control frame with a payload or is a message frame that cannot be deserialized, RemoteModuleRing_Receive shall skip it and return REMOTE_MODULE_CHANNEL_INVALID_FRAME. ]*/
+                        LogError("ring [%p] drops a message frame of %u bytes that cannot be deserialized", ring, (unsigned int)size);
+                        result = REMOTE_MODULE_CHANNEL_INVALID_FRAME;
+                    }
+                    else
+                    {
+                        *type = (REMOTE_MODULE_FRAME_TYPE)record_type;
+                        result = REMOTE_MODULE_CHANNEL_OK;
+                    }
+                    free_records(in, tail + RING_ALIGN(RING_RECORD_HEADER_SIZE + (size_t)size, RING_RECORD_ALIGNMENT));
+                    break;
+                }
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,52 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "message.h"
+#include "remote_module_channel.h"
+#include "remote_module_ring.h"
+
+/*shm:// urls are not supported on Windows yet, ipc:// and tcp:// urls are*/
+
+REMOTE_MODULE_RING_HANDLE RemoteModuleRing_Create(const char* name, size_t capacity)
+{
+    (void)capacity;
+    LogError("shared memory rings are not supported on this platform, unable to create [%s]", name);
+    return NULL;
+}
+
+REMOTE_MODULE_RING_HANDLE RemoteModuleRing_Open(const char* name)
+{
+    LogError("shared memory rings are not supported on this platform, unable to open [%s]", name);
+    return NULL;
+}
+
+void RemoteModuleRing_Destroy(REMOTE_MODULE_RING_HANDLE ring)
+{
+    (void)ring;
+}
+
+REMOTE_MODULE_CHANNEL_RESULT RemoteModuleRing_Send(REMOTE_MODULE_RING_HANDLE ring, REMOTE_MODULE_FRAME_TYPE type, MESSAGE_HANDLE message, int timeout_ms)
+{
+    (void)ring;
+    (void)type;
+    (void)message;
+    (void)timeout_ms;
+    return REMOTE_MODULE_CHANNEL_ERROR;
+}
+
+REMOTE_MODULE_CHANNEL_RESULT RemoteModuleRing_Receive(REMOTE_MODULE_RING_HANDLE ring, int timeout_ms, REMOTE_MODULE_FRAME_TYPE* type, MESSAGE_HANDLE* message)
+{
+    (void)ring;
+    (void)timeout_ms;
+    (void)type;
+    (void)message;
+    return REMOTE_MODULE_CHANNEL_ERROR;
+}
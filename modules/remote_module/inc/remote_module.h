@@ -0,0 +1,28 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef REMOTE_MODULE_H
+#define REMOTE_MODULE_H
+
+#include "module.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** @brief  The configuration of a remote module. */
+typedef struct REMOTE_MODULE_CONFIG_TAG
+{
+    /** @brief  The nanomsg address the remote module host connects to, an
+    *           @c ipc:// or @c tcp:// url. */
+    const char* url;
+} REMOTE_MODULE_CONFIG;
+
+MODULE_EXPORT void MODULE_STATIC_GETAPIS(REMOTE_MODULE)(MODULE_APIS* apis);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*REMOTE_MODULE_H*/
@@ -0,0 +1,134 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       remote_module_channel.h
+*   @brief      Frames exchanged between a remote module and its host process.
+*
+*   @details    The remote module and the remote module host talk over a
+*               channel, either a nanomsg @c NN_PAIR socket for @c ipc:// and
+*               @c tcp:// urls or a shared memory ring for @c shm:// urls.
+*               Every frame has a #REMOTE_MODULE_FRAME_TYPE. A message frame
+*               carries the message serialized with #MESSAGE_WIRE_FORMAT_V2,
+*               the other frames carry nothing else.
+*/
+
+#ifndef REMOTE_MODULE_CHANNEL_H
+#define REMOTE_MODULE_CHANNEL_H
+
+#include "azure_c_shared_utility/macro_utils.h"
+#include "message.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** @brief  The url prefix that selects a shared memory ring, followed by the
+*           name of the ring. */
+#define REMOTE_MODULE_SHM_URL_HEAD "shm://"
+
+/** @brief  A side that drops the messages its peer does not keep up with
+*           logs the first one it drops and then one in this many.
+*/
+#define REMOTE_MODULE_DROP_LOG_INTERVAL 1000
+
+typedef struct REMOTE_MODULE_CHANNEL_TAG* REMOTE_MODULE_CHANNEL_HANDLE;
+
+/** @brief  The first byte of a frame. */
+typedef enum REMOTE_MODULE_FRAME_TYPE_TAG
+{
+    /** @brief  Sent by the host once it is connected, the remote module answers with #REMOTE_MODULE_FRAME_START if it is already started. */
+    REMOTE_MODULE_FRAME_HELLO = 'H',
+    /** @brief  Sent by the remote module when the gateway starts it. */
+    REMOTE_MODULE_FRAME_START = 'S',
+    /** @brief  A message, sent both ways. */
+    REMOTE_MODULE_FRAME_MESSAGE = 'M',
+    /** @brief  Sent by the remote module when the gateway destroys it, the host exits. */
+    REMOTE_MODULE_FRAME_DESTROY = 'D'
+} REMOTE_MODULE_FRAME_TYPE;
+
+#define REMOTE_MODULE_CHANNEL_RESULT_VALUES \
+    REMOTE_MODULE_CHANNEL_OK, \
+    REMOTE_MODULE_CHANNEL_TIMEOUT, \
+    REMOTE_MODULE_CHANNEL_INVALID_FRAME, \
+    REMOTE_MODULE_CHANNEL_ERROR
+
+DEFINE_ENUM(REMOTE_MODULE_CHANNEL_RESULT, REMOTE_MODULE_CHANNEL_RESULT_VALUES);
+
+/** @brief      Creates the channel of a remote module.
+*
+*   @param      url                 An @c ipc:// or @c tcp:// url to bind a
+*                                   nanomsg socket to, or a @c shm:// url
+*                                   naming the shared memory ring to create.
+*   @param      receive_timeout_ms  How long ::RemoteModuleChannel_Receive
+*                                   waits for a frame.
+*
+*   @return     A non-NULL #REMOTE_MODULE_CHANNEL_HANDLE upon success, @c NULL
+*               upon failure.
+*/
+extern REMOTE_MODULE_CHANNEL_HANDLE RemoteModuleChannel_Bind(const char* url, int receive_timeout_ms);
+
+/** @brief      Creates the channel of a remote module host.
+*
+*   @details    A nanomsg socket connects in the background. Opening a shared
+*               memory ring waits until the remote module has created it.
+*
+*   @param      url     The url the remote module is bound to.
+*
+*   @return     A non-NULL #REMOTE_MODULE_CHANNEL_HANDLE upon success, @c NULL
+*               upon failure.
+*/
+extern REMOTE_MODULE_CHANNEL_HANDLE RemoteModuleChannel_Connect(const char* url);
+
+/** @brief      Closes a channel.
+*
+*   @param      channel     The #REMOTE_MODULE_CHANNEL_HANDLE to close.
+*/
+extern void RemoteModuleChannel_Close(REMOTE_MODULE_CHANNEL_HANDLE channel);
+
+/** @brief      Sends a frame that carries no message.
+*
+*   @param      channel     The #REMOTE_MODULE_CHANNEL_HANDLE.
+*   @param      type        The #REMOTE_MODULE_FRAME_TYPE of the frame.
+*   @param      wait        Non-zero to wait until the peer can take the
+*                           frame, 0 to fail at once. A control frame on a
+*                           full ring waits up to a second even with 0.
+*
+*   @return     #REMOTE_MODULE_CHANNEL_OK if the frame was sent,
+*               #REMOTE_MODULE_CHANNEL_TIMEOUT if the peer could not take it
+*               in time and #REMOTE_MODULE_CHANNEL_ERROR otherwise.
+*/
+extern REMOTE_MODULE_CHANNEL_RESULT RemoteModuleChannel_SendControl(REMOTE_MODULE_CHANNEL_HANDLE channel, REMOTE_MODULE_FRAME_TYPE type, int wait);
+
+/** @brief      Sends a message frame.
+*
+*   @param      channel     The #REMOTE_MODULE_CHANNEL_HANDLE.
+*   @param      message     The #MESSAGE_HANDLE to serialize.
+*   @param      wait        As for ::RemoteModuleChannel_SendControl.
+*
+*   @return     A #REMOTE_MODULE_CHANNEL_RESULT, as for
+*               ::RemoteModuleChannel_SendControl.
+*/
+extern REMOTE_MODULE_CHANNEL_RESULT RemoteModuleChannel_SendMessage(REMOTE_MODULE_CHANNEL_HANDLE channel, MESSAGE_HANDLE message, int wait);
+
+/** @brief      Receives a frame.
+*
+*   @param      channel     The #REMOTE_MODULE_CHANNEL_HANDLE.
+*   @param      type        Receives the #REMOTE_MODULE_FRAME_TYPE of the frame.
+*   @param      message     Receives the message of a
+*                           #REMOTE_MODULE_FRAME_MESSAGE frame, which the caller
+*                           destroys, or @c NULL.
+*
+*   @return     #REMOTE_MODULE_CHANNEL_OK if a frame was received,
+*               #REMOTE_MODULE_CHANNEL_TIMEOUT if none came before the receive
+*               timeout of the channel, #REMOTE_MODULE_CHANNEL_INVALID_FRAME if
+*               the frame was dropped because it could not be read and
+*               #REMOTE_MODULE_CHANNEL_ERROR if the channel failed.
+*/
+extern REMOTE_MODULE_CHANNEL_RESULT RemoteModuleChannel_Receive(REMOTE_MODULE_CHANNEL_HANDLE channel, REMOTE_MODULE_FRAME_TYPE* type, MESSAGE_HANDLE* message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*REMOTE_MODULE_CHANNEL_H*/
@@ -0,0 +1,20 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef REMOTE_MODULE_HL_H
+#define REMOTE_MODULE_HL_H
+
+#include "module.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+MODULE_EXPORT void MODULE_STATIC_GETAPIS(REMOTE_MODULE_HL)(MODULE_APIS* apis);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*REMOTE_MODULE_HL_H*/
@@ -0,0 +1,56 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       remote_module_host.h
+*   @brief      Hosts the module behind a remote module in its own process.
+*
+*   @details    The host reads the gateway JSON file, finds the remote module
+*               it hosts by name and loads the module named by the
+*               "module path" of the remote module's "args" with the "args"
+*               nested in them. It gives that module a broker of its own,
+*               linked both ways with a connection that forwards its messages
+*               to the remote module over the remote module's "url", and
+*               publishes the messages of the remote module to it.
+*/
+
+#ifndef REMOTE_MODULE_HOST_H
+#define REMOTE_MODULE_HOST_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct REMOTE_MODULE_HOST_DATA_TAG* REMOTE_MODULE_HOST_HANDLE;
+
+/** @brief      Creates the host of a remote module and its module.
+*
+*   @param      file_path       Path to the gateway JSON file.
+*   @param      module_name     The "module name" of the remote module to host.
+*
+*   @return     A non-NULL #REMOTE_MODULE_HOST_HANDLE upon success, @c NULL
+*               upon failure.
+*/
+extern REMOTE_MODULE_HOST_HANDLE RemoteModuleHost_Create(const char* file_path, const char* module_name);
+
+/** @brief      Connects to the remote module and forwards messages until the
+*               remote module is destroyed.
+*
+*   @param      host    The #REMOTE_MODULE_HOST_HANDLE to run.
+*
+*   @return     0 when the remote module is destroyed, non-zero if @c host is
+*               @c NULL or the connection fails.
+*/
+extern int RemoteModuleHost_Run(REMOTE_MODULE_HOST_HANDLE host);
+
+/** @brief      Destroys the hosted module and the host.
+*
+*   @param      host    The #REMOTE_MODULE_HOST_HANDLE to destroy.
+*/
+extern void RemoteModuleHost_Destroy(REMOTE_MODULE_HOST_HANDLE host);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*REMOTE_MODULE_HOST_H*/
@@ -0,0 +1,96 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       remote_module_ring.h
+*   @brief      Shared memory rings between a remote module and its host.
+*
+*   @details    A ring is a named shared memory segment holding two single
+*               producer, single consumer rings of frames, one each way. A
+*               message is serialized with #MESSAGE_WIRE_FORMAT_V2 straight
+*               into the ring, so it is not copied through the kernel, and a
+*               consumer that finds its ring empty sleeps on a process shared
+*               semaphore that the producer posts only when the consumer is
+*               sleeping; a producer that finds its ring full sleeps the same
+*               way on a second semaphore. Sends from several threads of one
+*               process are serialized by a lock.
+*/
+
+#ifndef REMOTE_MODULE_RING_H
+#define REMOTE_MODULE_RING_H
+
+#include <stddef.h>
+
+#include "message.h"
+#include "remote_module_channel.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** @brief  The bytes of frames each way of a ring holds. */
+#define REMOTE_MODULE_RING_CAPACITY (4 * 1024 * 1024)
+
+typedef struct REMOTE_MODULE_RING_TAG* REMOTE_MODULE_RING_HANDLE;
+
+/** @brief      Creates a ring, the side of the remote module.
+*
+*   @param      name        The name of the ring, unique on the machine.
+*   @param      capacity    The bytes of frames each way holds, a multiple of 8.
+*
+*   @return     A non-NULL #REMOTE_MODULE_RING_HANDLE upon success, @c NULL
+*               upon failure.
+*/
+extern REMOTE_MODULE_RING_HANDLE RemoteModuleRing_Create(const char* name, size_t capacity);
+
+/** @brief      Opens a ring, the side of the host. Waits until the remote
+*               module has created it.
+*
+*   @param      name        The name of the ring.
+*
+*   @return     A non-NULL #REMOTE_MODULE_RING_HANDLE upon success, @c NULL
+*               upon failure.
+*/
+extern REMOTE_MODULE_RING_HANDLE RemoteModuleRing_Open(const char* name);
+
+/** @brief      Unmaps a ring. The side that created it also removes its name.
+*
+*   @param      ring    The #REMOTE_MODULE_RING_HANDLE to destroy.
+*/
+extern void RemoteModuleRing_Destroy(REMOTE_MODULE_RING_HANDLE ring);
+
+/** @brief      Writes a frame to the ring towards the peer.
+*
+*   @param      ring        The #REMOTE_MODULE_RING_HANDLE.
+*   @param      type        The #REMOTE_MODULE_FRAME_TYPE of the frame.
+*   @param      message     The message of a #REMOTE_MODULE_FRAME_MESSAGE
+*                           frame, @c NULL for the other frames.
+*   @param      timeout_ms  How long to wait for room when the ring is full,
+*                           0 to fail at once, negative to wait until the
+*                           peer frees some.
+*
+*   @return     #REMOTE_MODULE_CHANNEL_OK if the frame was written,
+*               #REMOTE_MODULE_CHANNEL_TIMEOUT if the ring stayed full and
+*               #REMOTE_MODULE_CHANNEL_ERROR otherwise.
+*/
+extern REMOTE_MODULE_CHANNEL_RESULT RemoteModuleRing_Send(REMOTE_MODULE_RING_HANDLE ring, REMOTE_MODULE_FRAME_TYPE type, MESSAGE_HANDLE message, int timeout_ms);
+
+/** @brief      Reads a frame from the ring of the peer.
+*
+*   @param      ring        The #REMOTE_MODULE_RING_HANDLE.
+*   @param      timeout_ms  How long to wait for a frame, negative to wait
+*                           until one comes.
+*   @param      type        Receives the #REMOTE_MODULE_FRAME_TYPE of the frame.
+*   @param      message     Receives the message of a
+*                           #REMOTE_MODULE_FRAME_MESSAGE frame, or @c NULL.
+*
+*   @return     A #REMOTE_MODULE_CHANNEL_RESULT, as for
+*               ::RemoteModuleChannel_Receive.
+*/
+extern REMOTE_MODULE_CHANNEL_RESULT RemoteModuleRing_Receive(REMOTE_MODULE_RING_HANDLE ring, int timeout_ms, REMOTE_MODULE_FRAME_TYPE* type, MESSAGE_HANDLE* message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*REMOTE_MODULE_RING_H*/
@@ -0,0 +1,232 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <signal.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "module.h"
+#include "broker.h"
+#include "message.h"
+#include "remote_module.h"
+#include "remote_module_channel.h"
+
+/*how long the receiving thread waits for a frame before it checks whether the module is being destroyed*/
+#define REMOTE_MODULE_RECEIVE_TIMEOUT_MS 100
+
+typedef struct REMOTE_MODULE_DATA_TAG
+{
+    BROKER_HANDLE                   broker;
+    REMOTE_MODULE_CHANNEL_HANDLE    channel;
+    THREAD_HANDLE                   receive_thread;
+    volatile sig_atomic_t           running;
+    volatile sig_atomic_t           started;
+    /*the messages RemoteModule_Receive dropped, only the thread that delivers to the module updates it*/
+    size_t                          dropped_messages;
+} REMOTE_MODULE_DATA;
+
+static int remote_module_receiver(void* user_data)
+{
+    REMOTE_MODULE_DATA* module_data = (REMOTE_MODULE_DATA*)user_data;
+
+    /*Codes_SRS_REMOTE_MODULE_13_009: [ The receiving thread shall receive frames from the channel until the module is destroyed or the channel fails. ]*/
+    while (module_data->running)
+    {
+        REMOTE_MODULE_FRAME_TYPE type;
+        MESSAGE_HANDLE message;
+        REMOTE_MODULE_CHANNEL_RESULT receive_result = RemoteModuleChannel_Receive(module_data->channel, &type, &message);
+        if (receive_result == REMOTE_MODULE_CHANNEL_ERROR)
+        {
+            LogError("the channel of remote module [%p] failed, it no longer receives messages from its host", module_data);
+            break;
+        }
+        else if (receive_result == REMOTE_MODULE_CHANNEL_OK)
+        {
+            if (type == REMOTE_MODULE_FRAME_MESSAGE)
+            {
+                /*Codes_SRS_REMOTE_MODULE_13_010: [ The receiving thread shall publish the message of a REMOTE_MODULE_FRAME_MESSAGE frame with the module as its source, and shall then destroy it. ]*/
+                if (Broker_Publish(module_data->broker, (MODULE_HANDLE)module_data, message) != BROKER_OK)
+                {
+                    LogError("unable to publish a message received from the host of remote module [%p]", module_data);
+                }
+                Message_Destroy(message);
+            }
+            else if (type == REMOTE_MODULE_FRAME_HELLO)
+            {
+                /*Codes_SRS_REMOTE_MODULE_13_011: [ When the host says hello, the receiving thread shall send it a REMOTE_MODULE_FRAME_START frame if the module is started. ]*/
+                if (module_data->started &&
+                    RemoteModuleChannel_SendControl(module_data->channel, REMOTE_MODULE_FRAME_START, 0) != REMOTE_MODULE_CHANNEL_OK)
+                {
+                    LogError("unable to start the host of remote module [%p]", module_data);
+                }
+            }
+            else
+            {
+                LogError("remote module [%p] ignores a frame of type 0x%02x from its host", module_data, (unsigned int)type);
+            }
+        }
+        else
+        {
+            /*a timeout, or a frame that was dropped, the loop checks whether the module is still running*/
+        }
+    }
+
+    return 0;
+}
+
+static MODULE_HANDLE RemoteModule_Create(BROKER_HANDLE broker, const void* configuration)
+{
+    REMOTE_MODULE_DATA* result;
+    const REMOTE_MODULE_CONFIG* config = (const REMOTE_MODULE_CONFIG*)configuration;
+    /*Codes_SRS_REMOTE_MODULE_13_001: [ If broker, configuration or the url of configuration is NULL, RemoteModule_Create shall fail and return NULL. ]*/
+    if (broker == NULL || config == NULL || config->url == NULL)
+    {
+        LogError("invalid arg broker=%p configuration=%p", broker, configuration);
+        result = NULL;
+    }
+    else
+    {
+        result = (REMOTE_MODULE_DATA*)malloc(sizeof(REMOTE_MODULE_DATA));
+        if (result == NULL)
+        {
+            /*Codes_SRS_REMOTE_MODULE_13_006: [ If any underlying call fails, RemoteModule_Create shall release the resources it acquired and return NULL. ]*/
+            LogError("malloc failed");
+        }
+        else
+        {
+            result->broker = broker;
+            result->running = 1;
+            result->started = 0;
+            result->dropped_messages = 0;
+            /*Codes_SRS_REMOTE_MODULE_13_002: [ RemoteModule_Create shall create the channel to the host by calling RemoteModuleChannel_Bind with the url of configuration and a receive timeout, so that the receiving thread notices when the module is destroyed. ]*/
+            result->channel = RemoteModuleChannel_Bind(config->url, REMOTE_MODULE_RECEIVE_TIMEOUT_MS);
+            if (result->channel == NULL)
+            {
+                /*Codes_SRS_REMOTE_MODULE_13_006: [ If any underlying call fails, RemoteModule_Create shall release the resources it acquired and return NULL. ]*/
+                LogError("unable to create the channel of the remote module for [%s]", config->url);
+                free(result);
+                result = NULL;
+            }
+            /*Codes_SRS_REMOTE_MODULE_13_005: [ RemoteModule_Create shall start a thread that receives the frames of the host. ]*/
+            else if (ThreadAPI_Create(&result->receive_thread, remote_module_receiver, result) != THREADAPI_OK)
+            {
+                /*Codes_SRS_REMOTE_MODULE_13_006: [ If any underlying call fails, RemoteModule_Create shall release the resources it acquired and return NULL. ]*/
+                LogError("unable to start the receiving thread of the remote module for [%s]", config->url);
+                RemoteModuleChannel_Close(result->channel);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_REMOTE_MODULE_13_007: [ RemoteModule_Create shall return a non-NULL MODULE_HANDLE on success. ]*/
+            }
+        }
+    }
+    return result;
+}
+
+static void RemoteModule_Destroy(MODULE_HANDLE moduleHandle)
+{
+    /*Codes_SRS_REMOTE_MODULE_13_016: [ If moduleHandle is NULL, RemoteModule_Destroy shall do nothing. ]*/
+    if (moduleHandle == NULL)
+    {
+        LogError("Attempt to destroy NULL module");
+    }
+    else
+    {
+        REMOTE_MODULE_DATA* module_data = (REMOTE_MODULE_DATA*)moduleHandle;
+        int thread_result;
+
+        /*Codes_SRS_REMOTE_MODULE_13_017: [ RemoteModule_Destroy shall send a REMOTE_MODULE_FRAME_DESTROY frame to the host with wait 0, so that the host destroys its module and exits. ]*/
+        if (RemoteModuleChannel_SendControl(module_data->channel, REMOTE_MODULE_FRAME_DESTROY, 0) != REMOTE_MODULE_CHANNEL_OK)
+        {
+            LogInfo("the host of remote module [%p] is not connected, it is not told to exit", module_data);
+        }
+
+        /*Codes_SRS_REMOTE_MODULE_13_018: [ RemoteModule_Destroy shall stop and join the receiving thread, close the channel by calling RemoteModuleChannel_Close and free the module. ]*/
+        module_data->running = 0;
+        if (ThreadAPI_Join(module_data->receive_thread, &thread_result) != THREADAPI_OK)
+        {
+            LogError("unable to join the receiving thread of remote module [%p]", module_data);
+        }
+        RemoteModuleChannel_Close(module_data->channel);
+        free(module_data);
+    }
+}
+
+static void RemoteModule_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    /*Codes_SRS_REMOTE_MODULE_13_012: [ If moduleHandle or messageHandle is NULL, RemoteModule_Receive shall do nothing. ]*/
+    if (moduleHandle == NULL || messageHandle == NULL)
+    {
+        LogError("invalid arg moduleHandle=%p messageHandle=%p", moduleHandle, messageHandle);
+    }
+    else
+    {
+        REMOTE_MODULE_DATA* module_data = (REMOTE_MODULE_DATA*)moduleHandle;
+        /*Codes_SRS_REMOTE_MODULE_13_013: [ RemoteModule_Receive shall send the message to the host in a REMOTE_MODULE_FRAME_MESSAGE frame without waiting, and drop it if the host is not connected or does not keep up. ]*/
+        if (RemoteModuleChannel_SendMessage(module_data->channel, messageHandle, 0) != REMOTE_MODULE_CHANNEL_OK)
+        {
+            /*Codes_SRS_REMOTE_MODULE_13_019: [ RemoteModule_Receive shall count the messages it drops, and shall log the first one and then one in REMOTE_MODULE_DROP_LOG_INTERVAL with the count. ]*/
+            module_data->dropped_messages++;
+            if (module_data->dropped_messages % REMOTE_MODULE_DROP_LOG_INTERVAL == 1)
+            {
+                LogError("remote module [%p] has dropped %zu messages, its host is not connected or does not keep up", module_data, module_data->dropped_messages);
+            }
+        }
+    }
+}
+
+static void RemoteModule_Start(MODULE_HANDLE moduleHandle)
+{
+    /*Codes_SRS_REMOTE_MODULE_13_014: [ If moduleHandle is NULL, RemoteModule_Start shall do nothing. ]*/
+    if (moduleHandle == NULL)
+    {
+        LogError("Attempt to start NULL module");
+    }
+    else
+    {
+        REMOTE_MODULE_DATA* module_data = (REMOTE_MODULE_DATA*)moduleHandle;
+        /*Codes_SRS_REMOTE_MODULE_13_015: [ RemoteModule_Start shall mark the module started and send a REMOTE_MODULE_FRAME_START frame to the host with wait 0; a host that is not connected yet is started when it says hello. ]*/
+        module_data->started = 1;
+        if (RemoteModuleChannel_SendControl(module_data->channel, REMOTE_MODULE_FRAME_START, 0) != REMOTE_MODULE_CHANNEL_OK)
+        {
+            LogInfo("the host of remote module [%p] is not connected yet, it starts when it connects", module_data);
+        }
+    }
+}
+
+/*
+ *	Required for all modules:  the public API and the designated implementation functions.
+ */
+static const MODULE_APIS RemoteModule_APIS_all =
+{
+    RemoteModule_Create,
+    RemoteModule_Destroy,
+    RemoteModule_Receive,
+    RemoteModule_Start
+};
+
+#ifdef BUILD_MODULE_TYPE_STATIC
+MODULE_EXPORT void MODULE_STATIC_GETAPIS(REMOTE_MODULE)(MODULE_APIS* apis)
+#else
+MODULE_EXPORT void Module_GetAPIS(MODULE_APIS* apis)
+#endif
+{
+    if (!apis)
+    {
+        LogError("NULL passed to Module_GetAPIS");
+    }
+    else
+    {
+        /*Codes_SRS_REMOTE_MODULE_13_008: [ Module_GetAPIS shall fill the provided MODULE_APIS with the function pointers of the remote module. ]*/
+        (*apis) = RemoteModule_APIS_all;
+    }
+}
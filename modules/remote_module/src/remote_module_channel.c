@@ -0,0 +1,294 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "nn.h"
+#include "pair.h"
+
+#include "message.h"
+#include "remote_module_channel.h"
+#include "remote_module_ring.h"
+
+#define FRAME_HEADER_SIZE 1
+#define SHM_URL_HEAD_SIZE (sizeof(REMOTE_MODULE_SHM_URL_HEAD) - 1)
+/*how long a control frame that is not sent with wait waits for room in a full ring, a lost START or DESTROY leaves the host stuck*/
+#define RING_CONTROL_FRAME_TIMEOUT_MS 1000
+
+typedef struct REMOTE_MODULE_CHANNEL_TAG
+{
+    /*the nanomsg socket of ipc:// and tcp:// urls*/
+    int                         socket;
+    /*the ring of shm:// urls, NULL for a socket*/
+    REMOTE_MODULE_RING_HANDLE   ring;
+    int                         receive_timeout_ms;
+} REMOTE_MODULE_CHANNEL;
+
+/*maps the error of a failed nn_send or nn_recv*/
+static REMOTE_MODULE_CHANNEL_RESULT get_socket_error(void)
+{
+    int error = nn_errno();
+    return (error == EAGAIN || error == ETIMEDOUT) ? REMOTE_MODULE_CHANNEL_TIMEOUT : REMOTE_MODULE_CHANNEL_ERROR;
+}
+
+static void release_received_frame(void* context)
+{
+    (void)nn_freemsg(context);
+}
+
+static int is_shm_url(const char* url)
+{
+    return strncmp(url, REMOTE_MODULE_SHM_URL_HEAD, SHM_URL_HEAD_SIZE) == 0;
+}
+
+static int get_send_flags(int wait)
+{
+    return (wait != 0) ? 0 : NN_DONTWAIT;
+}
+
+static int get_ring_send_timeout(int wait, int no_wait_timeout_ms)
+{
+    return (wait != 0) ? -1 : no_wait_timeout_ms;
+}
+
+/*creates the channel of either side, bind tells which*/
+static REMOTE_MODULE_CHANNEL* create_channel(const char* url, int receive_timeout_ms, int bind)
+{
+    REMOTE_MODULE_CHANNEL* result;
+    if (url == NULL)
+    {
+        /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_011: [ If url is NULL, RemoteModuleChannel_Bind and RemoteModuleChannel_Connect shall fail and return NULL. ]*/
+        LogError("invalid arg url=NULL");
+        result = NULL;
+    }
+    else if ((result = (REMOTE_MODULE_CHANNEL*)malloc(sizeof(REMOTE_MODULE_CHANNEL))) == NULL)
+    {
+        /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_014: [ If any underlying call fails, RemoteModuleChannel_Bind and RemoteModuleChannel_Connect shall release the resources they acquired and return NULL. ]*/
+        LogError("malloc failed");
+    }
+    else
+    {
+        result->socket = -1;
+        result->ring = NULL;
+        result->receive_timeout_ms = receive_timeout_ms;
+        if (is_shm_url(url))
+        {
+            /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_012: [ If url starts with "shm://", RemoteModuleChannel_Bind shall create the shared memory ring named by the rest of url with a capacity of REMOTE_MODULE_RING_CAPACITY, and RemoteModuleChannel_Connect shall open it. ]*/
+            const char* name = url + SHM_URL_HEAD_SIZE;
+            result->ring = bind ? RemoteModuleRing_Create(name, REMOTE_MODULE_RING_CAPACITY) : RemoteModuleRing_Open(name);
+            if (result->ring == NULL)
+            {
+                /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_014: [ If any underlying call fails, RemoteModuleChannel_Bind and RemoteModuleChannel_Connect shall release the resources they acquired and return NULL. ]*/
+                LogError("unable to %s the shared memory ring [%s]", bind ? "create" : "open", name);
+                free(result);
+                result = NULL;
+            }
+        }
+        /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_013: [ Otherwise RemoteModuleChannel_Bind shall create a nanomsg NN_PAIR socket, set its NN_RCVTIMEO to receive_timeout_ms and bind it to url, and RemoteModuleChannel_Connect shall create a nanomsg NN_PAIR socket and connect it to url. ]*/
+        else if ((result->socket = nn_socket(AF_SP, NN_PAIR)) < 0)
+        {
+            /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_014: [ If any underlying call fails, RemoteModuleChannel_Bind and RemoteModuleChannel_Connect shall release the resources they acquired and return NULL. ]*/
+            LogError("unable to create the socket for [%s]", url);
+            free(result);
+            result = NULL;
+        }
+        else if (bind &&
+                 (nn_setsockopt(result->socket, NN_SOL_SOCKET, NN_RCVTIMEO, &receive_timeout_ms, sizeof(receive_timeout_ms)) < 0 ||
+                  nn_bind(result->socket, url) < 0))
+        {
+            /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_014: [ If any underlying call fails, RemoteModuleChannel_Bind and RemoteModuleChannel_Connect shall release the resources they acquired and return NULL. ]*/
+            LogError("unable to bind the socket to [%s]", url);
+            (void)nn_close(result->socket);
+            free(result);
+            result = NULL;
+        }
+        else if (!bind && nn_connect(result->socket, url) < 0)
+        {
+            /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_014: [ If any underlying call fails, RemoteModuleChannel_Bind and RemoteModuleChannel_Connect shall release the resources they acquired and return NULL. ]*/
+            LogError("unable to connect the socket to [%s]", url);
+            (void)nn_close(result->socket);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            /*all good*/
+        }
+    }
+    return result;
+}
+
+REMOTE_MODULE_CHANNEL_HANDLE RemoteModuleChannel_Bind(const char* url, int receive_timeout_ms)
+{
+    return create_channel(url, receive_timeout_ms, 1);
+}
+
+REMOTE_MODULE_CHANNEL_HANDLE RemoteModuleChannel_Connect(const char* url)
+{
+    /*a host waits for frames as long as it takes*/
+    return create_channel(url, -1, 0);
+}
+
+void RemoteModuleChannel_Close(REMOTE_MODULE_CHANNEL_HANDLE channel)
+{
+    /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_015: [ RemoteModuleChannel_Close shall destroy the ring or close the socket of channel and free it, and do nothing if channel is NULL. ]*/
+    if (channel != NULL)
+    {
+        if (channel->ring != NULL)
+        {
+            RemoteModuleRing_Destroy(channel->ring);
+        }
+        else
+        {
+            (void)nn_close(channel->socket);
+        }
+        free(channel);
+    }
+}
+
+REMOTE_MODULE_CHANNEL_RESULT RemoteModuleChannel_SendControl(REMOTE_MODULE_CHANNEL_HANDLE channel, REMOTE_MODULE_FRAME_TYPE type, int wait)
+{
+    REMOTE_MODULE_CHANNEL_RESULT result;
+    unsigned char frame = (unsigned char)type;
+    if (channel->ring != NULL)
+    {
+        /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_016: [ The frames of a ring channel shall be sent with RemoteModuleRing_Send, waiting for room as long as it takes if wait is non-zero, and received with RemoteModuleRing_Receive and the receive timeout of the channel. ]*/
+        /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_017: [ If wait is 0, RemoteModuleChannel_SendControl shall still wait up to RING_CONTROL_FRAME_TIMEOUT_MS for room in a full ring, and RemoteModuleChannel_SendMessage shall not wait. ]*/
+        result = RemoteModuleRing_Send(channel->ring, type, NULL, get_ring_send_timeout(wait, RING_CONTROL_FRAME_TIMEOUT_MS));
+    }
+    /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_001: [ RemoteModuleChannel_SendControl shall send a frame of the one byte type by calling nn_send, with NN_DONTWAIT unless wait is non-zero. ]*/
+    else if (nn_send(channel->socket, &frame, FRAME_HEADER_SIZE, get_send_flags(wait)) != FRAME_HEADER_SIZE)
+    {
+        /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_002: [ If nn_send fails, the functions shall return REMOTE_MODULE_CHANNEL_TIMEOUT when the error is EAGAIN or ETIMEDOUT and REMOTE_MODULE_CHANNEL_ERROR otherwise. ]*/
+        result = get_socket_error();
+    }
+    else
+    {
+        result = REMOTE_MODULE_CHANNEL_OK;
+    }
+    return result;
+}
+
+REMOTE_MODULE_CHANNEL_RESULT RemoteModuleChannel_SendMessage(REMOTE_MODULE_CHANNEL_HANDLE channel, MESSAGE_HANDLE message, int wait)
+{
+    REMOTE_MODULE_CHANNEL_RESULT result;
+    int32_t msg_size;
+    if (channel->ring != NULL)
+    {
+        /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_016: [ The frames of a ring channel shall be sent with RemoteModuleRing_Send, waiting for room as long as it takes if wait is non-zero, and received with RemoteModuleRing_Receive and the receive timeout of the channel. ]*/
+        /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_017: [ If wait is 0, RemoteModuleChannel_SendControl shall still wait up to RING_CONTROL_FRAME_TIMEOUT_MS for room in a full ring, and RemoteModuleChannel_SendMessage shall not wait. ]*/
+        result = RemoteModuleRing_Send(channel->ring, REMOTE_MODULE_FRAME_MESSAGE, message, get_ring_send_timeout(wait, 0));
+    }
+    else if ((msg_size = Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, NULL, 0)) < 0)
+    {
+        /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_005: [ If the message cannot be serialized or the buffer cannot be allocated, RemoteModuleChannel_SendMessage shall return REMOTE_MODULE_CHANNEL_ERROR. ]*/
+        LogError("unable to serialize message [%p]", message);
+        result = REMOTE_MODULE_CHANNEL_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_003: [ RemoteModuleChannel_SendMessage shall allocate a nanomsg buffer of the size of the message serialized with MESSAGE_WIRE_FORMAT_V2 plus one byte, and shall serialize the message after the REMOTE_MODULE_FRAME_MESSAGE byte. ]*/
+        size_t frame_size = FRAME_HEADER_SIZE + (size_t)msg_size;
+        unsigned char* frame = (unsigned char*)nn_allocmsg(frame_size, 0);
+        if (frame == NULL)
+        {
+            /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_005: [ If the message cannot be serialized or the buffer cannot be allocated, RemoteModuleChannel_SendMessage shall return REMOTE_MODULE_CHANNEL_ERROR. ]*/
+            LogError("unable to allocate a frame of %zu bytes", frame_size);
+            result = REMOTE_MODULE_CHANNEL_ERROR;
+        }
+        else
+        {
+            frame[0] = (unsigned char)REMOTE_MODULE_FRAME_MESSAGE;
+            if (Message_ToByteArrayWithFormat(message, MESSAGE_WIRE_FORMAT_V2, frame + FRAME_HEADER_SIZE, msg_size) != msg_size)
+            {
+                /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_005: [ If the message cannot be serialized or the buffer cannot be allocated, RemoteModuleChannel_SendMessage shall return REMOTE_MODULE_CHANNEL_ERROR. ]*/
+                LogError("unable to serialize message [%p]", message);
+                (void)nn_freemsg(frame);
+                result = REMOTE_MODULE_CHANNEL_ERROR;
+            }
+            /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_004: [ RemoteModuleChannel_SendMessage shall send the buffer with nn_send and NN_MSG, so that nanomsg frees it. ]*/
+            else if (nn_send(channel->socket, &frame, NN_MSG, get_send_flags(wait)) != (int)frame_size)
+            {
+                /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_002: [ If nn_send fails, the functions shall return REMOTE_MODULE_CHANNEL_TIMEOUT when the error is EAGAIN or ETIMEDOUT and REMOTE_MODULE_CHANNEL_ERROR otherwise. ]*/
+                result = get_socket_error();
+                (void)nn_freemsg(frame);
+            }
+            else
+            {
+                result = REMOTE_MODULE_CHANNEL_OK;
+            }
+        }
+    }
+    return result;
+}
+
+REMOTE_MODULE_CHANNEL_RESULT RemoteModuleChannel_Receive(REMOTE_MODULE_CHANNEL_HANDLE channel, REMOTE_MODULE_FRAME_TYPE* type, MESSAGE_HANDLE* message)
+{
+    REMOTE_MODULE_CHANNEL_RESULT result;
+    unsigned char* frame = NULL;
+    int nbytes;
+
+    *message = NULL;
+    if (channel->ring != NULL)
+    {
+        /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_016: [ The frames of a ring channel shall be sent with RemoteModuleRing_Send, waiting for room as long as it takes if wait is non-zero, and received with RemoteModuleRing_Receive and the receive timeout of the channel. ]*/
+        result = RemoteModuleRing_Receive(channel->ring, channel->receive_timeout_ms, type, message);
+    }
+    /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_006: [ RemoteModuleChannel_Receive shall receive a frame by calling nn_recv with NN_MSG. ]*/
+    else if ((nbytes = nn_recv(channel->socket, &frame, NN_MSG, 0)) < 0)
+    {
+        /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_007: [ If nn_recv fails, RemoteModuleChannel_Receive shall return REMOTE_MODULE_CHANNEL_TIMEOUT when the error is EAGAIN or ETIMEDOUT and REMOTE_MODULE_CHANNEL_ERROR otherwise. ]*/
+        result = get_socket_error();
+    }
+    else if (nbytes < FRAME_HEADER_SIZE)
+    {
+        /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_010: [ If the frame is empty, has an unknown type, is a message frame that cannot be deserialized or is a control frame with a payload, RemoteModuleChannel_Receive shall free it and return REMOTE_MODULE_CHANNEL_INVALID_FRAME. ]*/
+        LogError("received an empty frame");
+        (void)nn_freemsg(frame);
+        result = REMOTE_MODULE_CHANNEL_INVALID_FRAME;
+    }
+    else
+    {
+        *type = (REMOTE_MODULE_FRAME_TYPE)frame[0];
+        if (*type == REMOTE_MODULE_FRAME_MESSAGE)
+        {
+            /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_008: [ RemoteModuleChannel_Receive shall deserialize the message of a REMOTE_MODULE_FRAME_MESSAGE frame by calling Message_CreateFromByteArrayNoCopy, so that the message frees the frame with nn_freemsg when it is destroyed. ]*/
+            *message = Message_CreateFromByteArrayNoCopy(frame + FRAME_HEADER_SIZE, nbytes - FRAME_HEADER_SIZE, release_received_frame, frame);
+            if (*message == NULL)
+            {
+                /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_010: [ If the frame is empty, has an unknown type, is a message frame that cannot be deserialized or is a control frame with a payload, RemoteModuleChannel_Receive shall free it and return REMOTE_MODULE_CHANNEL_INVALID_FRAME. ]*/
+                LogError("unable to deserialize a message frame of %d bytes", nbytes);
+                (void)nn_freemsg(frame);
+                result = REMOTE_MODULE_CHANNEL_INVALID_FRAME;
+            }
+            else
+            {
+                result = REMOTE_MODULE_CHANNEL_OK;
+            }
+        }
+        else if ((*type == REMOTE_MODULE_FRAME_HELLO || *type == REMOTE_MODULE_FRAME_START || *type == REMOTE_MODULE_FRAME_DESTROY) &&
+                 nbytes == FRAME_HEADER_SIZE)
+        {
+            /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_009: [ RemoteModuleChannel_Receive shall free a control frame and return REMOTE_MODULE_CHANNEL_OK. ]*/
+            (void)nn_freemsg(frame);
+            result = REMOTE_MODULE_CHANNEL_OK;
+        }
+        else
+        {
+            /*Codes_SRS_REMOTE_MODULE_CHANNEL_13_010: [ If the frame is empty, has an unknown type, is a message frame that cannot be deserialized or is a control frame with a payload, RemoteModuleChannel_Receive shall free it and return REMOTE_MODULE_CHANNEL_INVALID_FRAME. ]*/
+            LogError("received an invalid frame of type 0x%02x and %d bytes", frame[0], nbytes);
+            (void)nn_freemsg(frame);
+            result = REMOTE_MODULE_CHANNEL_INVALID_FRAME;
+        }
+    }
+    return result;
+}
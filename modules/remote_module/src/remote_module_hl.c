@@ -0,0 +1,130 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+#include "azure_c_shared_utility/gballoc.h"
+
+/*because it is linked statically, this include will bring in some uniquely (by convention) named functions*/
+#include "remote_module.h"
+
+#include "remote_module_hl.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "parson.h"
+
+#define URL_KEY "url"
+
+static MODULE_HANDLE RemoteModule_HL_Create(BROKER_HANDLE broker, const void* configuration)
+{
+    MODULE_HANDLE result;
+    /*Codes_SRS_REMOTE_MODULE_HL_13_001: [ If broker or configuration is NULL then RemoteModule_HL_Create shall fail and return NULL. ]*/
+    if (
+        (broker == NULL) ||
+        (configuration == NULL)
+    )
+    {
+        LogError("NULL parameter detected broker=%p configuration=%p", broker, configuration);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_REMOTE_MODULE_HL_13_002: [ If configuration is not a JSON object, then RemoteModule_HL_Create shall fail and return NULL. ]*/
+        JSON_Value* json = json_parse_string((const char*)configuration);
+        if (json == NULL)
+        {
+            LogError("unable to json_parse_string");
+            result = NULL;
+        }
+        else
+        {
+            JSON_Object* obj = json_value_get_object(json);
+            if (obj == NULL)
+            {
+                LogError("unable to json_value_get_object");
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_REMOTE_MODULE_HL_13_003: [ If the JSON object does not contain a string named "url" then RemoteModule_HL_Create shall fail and return NULL. ]*/
+                const char* url = json_object_get_string(obj, URL_KEY);
+                if (url == NULL)
+                {
+                    LogError("the remote module has no \"%s\"", URL_KEY);
+                    result = NULL;
+                }
+                else
+                {
+                    /*the "module path" and "args" of the object are read by the remote module host, not here*/
+                    REMOTE_MODULE_CONFIG config;
+                    MODULE_APIS apis;
+                    config.url = url;
+
+                    MODULE_STATIC_GETAPIS(REMOTE_MODULE)(&apis);
+                    /*Codes_SRS_REMOTE_MODULE_HL_13_004: [ RemoteModule_HL_Create shall pass broker and the url to RemoteModule_Create, and return what it returns. ]*/
+                    result = apis.Module_Create(broker, &config);
+                    if (result == NULL)
+                    {
+                        LogError("unable to create the remote module for [%s]", url);
+                    }
+                }
+            }
+            json_value_free(json);
+        }
+    }
+
+    return result;
+}
+
+static void RemoteModule_HL_Destroy(MODULE_HANDLE moduleHandle)
+{
+    MODULE_APIS apis;
+    MODULE_STATIC_GETAPIS(REMOTE_MODULE)(&apis);
+    /*Codes_SRS_REMOTE_MODULE_HL_13_005: [ RemoteModule_HL_Destroy, RemoteModule_HL_Receive and RemoteModule_HL_Start shall pass their parameters to the underlying remote module. ]*/
+    apis.Module_Destroy(moduleHandle);
+}
+
+static void RemoteModule_HL_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    MODULE_APIS apis;
+    MODULE_STATIC_GETAPIS(REMOTE_MODULE)(&apis);
+    /*Codes_SRS_REMOTE_MODULE_HL_13_005: [ RemoteModule_HL_Destroy, RemoteModule_HL_Receive and RemoteModule_HL_Start shall pass their parameters to the underlying remote module. ]*/
+    apis.Module_Receive(moduleHandle, messageHandle);
+}
+
+static void RemoteModule_HL_Start(MODULE_HANDLE moduleHandle)
+{
+    MODULE_APIS apis;
+    MODULE_STATIC_GETAPIS(REMOTE_MODULE)(&apis);
+    /*Codes_SRS_REMOTE_MODULE_HL_13_005: [ RemoteModule_HL_Destroy, RemoteModule_HL_Receive and RemoteModule_HL_Start shall pass their parameters to the underlying remote module. ]*/
+    apis.Module_Start(moduleHandle);
+}
+
+/*
+ *	Required for all modules:  the public API and the designated implementation functions.
+ */
+static const MODULE_APIS RemoteModule_HL_APIS_all =
+{
+    RemoteModule_HL_Create,
+    RemoteModule_HL_Destroy,
+    RemoteModule_HL_Receive,
+    RemoteModule_HL_Start
+};
+
+#ifdef BUILD_MODULE_TYPE_STATIC
+MODULE_EXPORT void MODULE_STATIC_GETAPIS(REMOTE_MODULE_HL)(MODULE_APIS* apis)
+#else
+MODULE_EXPORT void Module_GetAPIS(MODULE_APIS* apis)
+#endif
+{
+    if (!apis)
+    {
+        LogError("NULL passed to Module_GetAPIS");
+    }
+    else
+    {
+        /*Codes_SRS_REMOTE_MODULE_HL_13_006: [ Module_GetAPIS shall fill the provided MODULE_APIS with the function pointers of the remote module HL. ]*/
+        (*apis) = RemoteModule_HL_APIS_all;
+    }
+}
@@ -0,0 +1,365 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "parson.h"
+
+#include "module.h"
+#include "module_loader.h"
+#include "broker.h"
+#include "message.h"
+#include "remote_module_host.h"
+#include "remote_module_channel.h"
+
+#define MODULES_KEY "modules"
+#define MODULE_NAME_KEY "module name"
+#define MODULE_PATH_KEY "module path"
+#define ARG_KEY "args"
+#define URL_KEY "url"
+
+typedef struct REMOTE_MODULE_HOST_DATA_TAG
+{
+    REMOTE_MODULE_CHANNEL_HANDLE channel;
+    BROKER_HANDLE           broker;
+    MODULE_LIBRARY_HANDLE   module_library_handle;
+    /*the hosted module*/
+    MODULE                  module;
+    /*the module of the host in its broker, it forwards what the hosted module publishes to the channel*/
+    MODULE                  connection;
+    int                     started;
+    /*the messages the connection dropped, only the thread that delivers to the connection updates it*/
+    size_t                  dropped_messages;
+} REMOTE_MODULE_HOST_DATA;
+
+static void Connection_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    REMOTE_MODULE_HOST_DATA* host = (REMOTE_MODULE_HOST_DATA*)moduleHandle;
+    /*Codes_SRS_REMOTE_MODULE_HOST_13_010: [ The connection shall send every message the hosted module publishes to the remote module in a REMOTE_MODULE_FRAME_MESSAGE frame without waiting, and drop it if the remote module does not keep up. ]*/
+    if (RemoteModuleChannel_SendMessage(host->channel, messageHandle, 0) != REMOTE_MODULE_CHANNEL_OK)
+    {
+        /*Codes_SRS_REMOTE_MODULE_HOST_13_019: [ The connection shall count the messages it drops, and shall log the first one and then one in REMOTE_MODULE_DROP_LOG_INTERVAL with the count. ]*/
+        host->dropped_messages++;
+        if (host->dropped_messages % REMOTE_MODULE_DROP_LOG_INTERVAL == 1)
+        {
+            LogError("the host has dropped %zu messages, the remote module is not connected or does not keep up", host->dropped_messages);
+        }
+    }
+}
+
+/*only Module_Receive is called, the connection is not created or destroyed by the broker*/
+static const MODULE_APIS Connection_APIS_all =
+{
+    NULL,
+    NULL,
+    Connection_Receive
+};
+
+/*returns the "args" of the module named module_name in the gateway JSON*/
+static JSON_Object* find_remote_module_args(JSON_Object* root, const char* module_name)
+{
+    JSON_Object* result = NULL;
+    JSON_Array* modules = json_object_get_array(root, MODULES_KEY);
+    if (modules == NULL)
+    {
+        LogError("the gateway JSON has no \"%s\" array", MODULES_KEY);
+    }
+    else
+    {
+        size_t module_count = json_array_get_count(modules);
+        size_t i;
+        for (i = 0; i < module_count; i++)
+        {
+            JSON_Object* module = json_array_get_object(modules, i);
+            const char* name = (module == NULL) ? NULL : json_object_get_string(module, MODULE_NAME_KEY);
+            if (name != NULL && strcmp(name, module_name) == 0)
+            {
+                result = json_object_get_object(module, ARG_KEY);
+                if (result == NULL)
+                {
+                    LogError("the module [%s] has no \"%s\" object", module_name, ARG_KEY);
+                }
+                break;
+            }
+        }
+        if (i == module_count)
+        {
+            LogError("the gateway JSON has no module named [%s]", module_name);
+        }
+    }
+    return result;
+}
+
+/*loads the hosted module and adds it to the broker of the host, returns 0 on success*/
+static int create_hosted_module(REMOTE_MODULE_HOST_DATA* host, const char* module_path, JSON_Value* module_args)
+{
+    int result;
+    host->module_library_handle = ModuleLoader_Load(module_path);
+    if (host->module_library_handle == NULL)
+    {
+        LogError("unable to load the module library [%s]", module_path);
+        result = __LINE__;
+    }
+    else
+    {
+        const MODULE_APIS* module_apis = ModuleLoader_GetModuleAPIs(host->module_library_handle);
+        char* args_str = json_serialize_to_string(module_args);
+        host->module.module_apis = module_apis;
+        host->module.module_handle = module_apis->Module_Create(host->broker, args_str);
+        json_free_serialized_string(args_str);
+        if (host->module.module_handle == NULL)
+        {
+            LogError("unable to create the module of [%s]", module_path);
+            ModuleLoader_Unload(host->module_library_handle);
+            result = __LINE__;
+        }
+        else if (Broker_AddModule(host->broker, &host->module) != BROKER_OK)
+        {
+            LogError("unable to add the module of [%s] to the broker of the host", module_path);
+            module_apis->Module_Destroy(host->module.module_handle);
+            ModuleLoader_Unload(host->module_library_handle);
+            result = __LINE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static void destroy_hosted_module(REMOTE_MODULE_HOST_DATA* host)
+{
+    (void)Broker_RemoveModule(host->broker, &host->module);
+    host->module.module_apis->Module_Destroy(host->module.module_handle);
+    ModuleLoader_Unload(host->module_library_handle);
+}
+
+/*adds the connection to the broker of the host and links it both ways with the hosted module, returns 0 on success*/
+static int link_connection(REMOTE_MODULE_HOST_DATA* host)
+{
+    int result;
+    BROKER_LINK_DATA to_connection;
+    BROKER_LINK_DATA from_connection;
+
+    to_connection.module_source_handle = host->module.module_handle;
+    to_connection.module_sink_handle = host->connection.module_handle;
+    to_connection.filter = NULL;
+    from_connection.module_source_handle = host->connection.module_handle;
+    from_connection.module_sink_handle = host->module.module_handle;
+    from_connection.filter = NULL;
+
+    if (Broker_AddModule(host->broker, &host->connection) != BROKER_OK)
+    {
+        LogError("unable to add the connection to the broker of the host");
+        result = __LINE__;
+    }
+    else if (Broker_AddLink(host->broker, &to_connection) != BROKER_OK)
+    {
+        LogError("unable to link the hosted module to the connection");
+        (void)Broker_RemoveModule(host->broker, &host->connection);
+        result = __LINE__;
+    }
+    else if (Broker_AddLink(host->broker, &from_connection) != BROKER_OK)
+    {
+        LogError("unable to link the connection to the hosted module");
+        (void)Broker_RemoveLink(host->broker, &to_connection);
+        (void)Broker_RemoveModule(host->broker, &host->connection);
+        result = __LINE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+static void unlink_connection(REMOTE_MODULE_HOST_DATA* host)
+{
+    BROKER_LINK_DATA link;
+    link.filter = NULL;
+
+    link.module_source_handle = host->connection.module_handle;
+    link.module_sink_handle = host->module.module_handle;
+    (void)Broker_RemoveLink(host->broker, &link);
+    link.module_source_handle = host->module.module_handle;
+    link.module_sink_handle = host->connection.module_handle;
+    (void)Broker_RemoveLink(host->broker, &link);
+    (void)Broker_RemoveModule(host->broker, &host->connection);
+}
+
+REMOTE_MODULE_HOST_HANDLE RemoteModuleHost_Create(const char* file_path, const char* module_name)
+{
+    REMOTE_MODULE_HOST_DATA* result;
+    /*Codes_SRS_REMOTE_MODULE_HOST_13_001: [ If file_path or module_name is NULL, RemoteModuleHost_Create shall fail and return NULL. ]*/
+    if (file_path == NULL || module_name == NULL)
+    {
+        LogError("invalid arg file_path=%p module_name=%p", file_path, module_name);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_REMOTE_MODULE_HOST_13_002: [ RemoteModuleHost_Create shall read the gateway JSON file and find the "args" object of the module named module_name. ]*/
+        JSON_Value* json = json_parse_file(file_path);
+        JSON_Object* root = (json == NULL) ? NULL : json_value_get_object(json);
+        JSON_Object* remote_args = (root == NULL) ? NULL : find_remote_module_args(root, module_name);
+        /*Codes_SRS_REMOTE_MODULE_HOST_13_003: [ RemoteModuleHost_Create shall read the "url" and "module path" strings of that object. ]*/
+        const char* url = (remote_args == NULL) ? NULL : json_object_get_string(remote_args, URL_KEY);
+        const char* module_path = (remote_args == NULL) ? NULL : json_object_get_string(remote_args, MODULE_PATH_KEY);
+
+        if (url == NULL || module_path == NULL)
+        {
+            /*Codes_SRS_REMOTE_MODULE_HOST_13_004: [ If the file cannot be read, has no module named module_name or its "args" have no "url" or "module path", RemoteModuleHost_Create shall fail and return NULL. ]*/
+            LogError("unable to read the \"%s\" and \"%s\" of the remote module [%s] from [%s]", URL_KEY, MODULE_PATH_KEY, module_name, file_path);
+            result = NULL;
+        }
+        else if ((result = (REMOTE_MODULE_HOST_DATA*)malloc(sizeof(REMOTE_MODULE_HOST_DATA))) == NULL)
+        {
+            /*Codes_SRS_REMOTE_MODULE_HOST_13_009: [ If any underlying call fails, RemoteModuleHost_Create shall release the resources it acquired and return NULL. ]*/
+            LogError("malloc failed");
+        }
+        else
+        {
+            result->started = 0;
+            result->dropped_messages = 0;
+            result->connection.module_apis = &Connection_APIS_all;
+            result->connection.module_handle = (MODULE_HANDLE)result;
+
+            /*Codes_SRS_REMOTE_MODULE_HOST_13_005: [ RemoteModuleHost_Create shall create a broker for the hosted module. ]*/
+            result->broker = Broker_Create();
+            if (result->broker == NULL)
+            {
+                /*Codes_SRS_REMOTE_MODULE_HOST_13_009: [ If any underlying call fails, RemoteModuleHost_Create shall release the resources it acquired and return NULL. ]*/
+                LogError("unable to create the broker of the host");
+                free(result);
+                result = NULL;
+            }
+            /*Codes_SRS_REMOTE_MODULE_HOST_13_006: [ RemoteModuleHost_Create shall load the library of "module path", create its module with the "args" nested in the remote module's "args" serialized to a string, and add it to the broker. ]*/
+            else if (create_hosted_module(result, module_path, json_object_get_value(remote_args, ARG_KEY)) != 0)
+            {
+                /*Codes_SRS_REMOTE_MODULE_HOST_13_009: [ If any underlying call fails, RemoteModuleHost_Create shall release the resources it acquired and return NULL. ]*/
+                Broker_Destroy(result->broker);
+                free(result);
+                result = NULL;
+            }
+            /*Codes_SRS_REMOTE_MODULE_HOST_13_007: [ RemoteModuleHost_Create shall add the connection to the broker and link it with the hosted module both ways. ]*/
+            else if (link_connection(result) != 0)
+            {
+                /*Codes_SRS_REMOTE_MODULE_HOST_13_009: [ If any underlying call fails, RemoteModuleHost_Create shall release the resources it acquired and return NULL. ]*/
+                destroy_hosted_module(result);
+                Broker_Destroy(result->broker);
+                free(result);
+                result = NULL;
+            }
+            /*Codes_SRS_REMOTE_MODULE_HOST_13_008: [ RemoteModuleHost_Create shall create the channel to the remote module by calling RemoteModuleChannel_Connect with "url". ]*/
+            else if ((result->channel = RemoteModuleChannel_Connect(url)) == NULL)
+            {
+                /*Codes_SRS_REMOTE_MODULE_HOST_13_009: [ If any underlying call fails, RemoteModuleHost_Create shall release the resources it acquired and return NULL. ]*/
+                LogError("unable to connect the channel to [%s]", url);
+                unlink_connection(result);
+                destroy_hosted_module(result);
+                Broker_Destroy(result->broker);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*all good*/
+            }
+        }
+
+        json_value_free(json);
+    }
+    return result;
+}
+
+int RemoteModuleHost_Run(REMOTE_MODULE_HOST_HANDLE host)
+{
+    int result;
+    /*Codes_SRS_REMOTE_MODULE_HOST_13_011: [ If host is NULL, RemoteModuleHost_Run shall return a non-zero value. ]*/
+    if (host == NULL)
+    {
+        LogError("invalid arg host=NULL");
+        result = __LINE__;
+    }
+    /*Codes_SRS_REMOTE_MODULE_HOST_13_012: [ RemoteModuleHost_Run shall send a REMOTE_MODULE_FRAME_HELLO frame, waiting until the remote module is listening. ]*/
+    else if (RemoteModuleChannel_SendControl(host->channel, REMOTE_MODULE_FRAME_HELLO, 1) != REMOTE_MODULE_CHANNEL_OK)
+    {
+        /*Codes_SRS_REMOTE_MODULE_HOST_13_016: [ If the channel fails, RemoteModuleHost_Run shall return a non-zero value. ]*/
+        LogError("unable to say hello to the remote module");
+        result = __LINE__;
+    }
+    else
+    {
+        result = __LINE__;
+        for (;;)
+        {
+            REMOTE_MODULE_FRAME_TYPE type;
+            MESSAGE_HANDLE message;
+            REMOTE_MODULE_CHANNEL_RESULT receive_result = RemoteModuleChannel_Receive(host->channel, &type, &message);
+            if (receive_result == REMOTE_MODULE_CHANNEL_ERROR)
+            {
+                /*Codes_SRS_REMOTE_MODULE_HOST_13_016: [ If the channel fails, RemoteModuleHost_Run shall return a non-zero value. ]*/
+                LogError("the channel to the remote module failed");
+                break;
+            }
+            else if (receive_result != REMOTE_MODULE_CHANNEL_OK)
+            {
+                /*a frame that was dropped, keep on receiving*/
+            }
+            else if (type == REMOTE_MODULE_FRAME_MESSAGE)
+            {
+                /*Codes_SRS_REMOTE_MODULE_HOST_13_013: [ RemoteModuleHost_Run shall publish the message of a REMOTE_MODULE_FRAME_MESSAGE frame to the broker of the host with the connection as its source, and shall then destroy it. ]*/
+                if (Broker_Publish(host->broker, host->connection.module_handle, message) != BROKER_OK)
+                {
+                    LogError("unable to publish a message of the remote module to the hosted module");
+                }
+                Message_Destroy(message);
+            }
+            else if (type == REMOTE_MODULE_FRAME_START)
+            {
+                /*Codes_SRS_REMOTE_MODULE_HOST_13_014: [ On the first REMOTE_MODULE_FRAME_START frame, RemoteModuleHost_Run shall call the Module_Start of the hosted module, if it has one. ]*/
+                if (!host->started)
+                {
+                    host->started = 1;
+                    if (host->module.module_apis->Module_Start != NULL)
+                    {
+                        host->module.module_apis->Module_Start(host->module.module_handle);
+                    }
+                }
+            }
+            else if (type == REMOTE_MODULE_FRAME_DESTROY)
+            {
+                /*Codes_SRS_REMOTE_MODULE_HOST_13_015: [ On a REMOTE_MODULE_FRAME_DESTROY frame, RemoteModuleHost_Run shall return 0. ]*/
+                result = 0;
+                break;
+            }
+            else
+            {
+                LogError("the host ignores a frame of type 0x%02x", (unsigned int)type);
+            }
+        }
+    }
+    return result;
+}
+
+void RemoteModuleHost_Destroy(REMOTE_MODULE_HOST_HANDLE host)
+{
+    /*Codes_SRS_REMOTE_MODULE_HOST_13_017: [ If host is NULL, RemoteModuleHost_Destroy shall do nothing. ]*/
+    if (host != NULL)
+    {
+        /*Codes_SRS_REMOTE_MODULE_HOST_13_018: [ RemoteModuleHost_Destroy shall unlink and remove the connection, remove, destroy and unload the hosted module, destroy the broker, close the channel and free the host. ]*/
+        unlink_connection(host);
+        destroy_hosted_module(host);
+        Broker_Destroy(host->broker);
+        RemoteModuleChannel_Close(host->channel);
+        free(host);
+    }
+}
@@ -0,0 +1,31 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdio.h>
+
+#include "remote_module_host.h"
+
+int main(int argc, char** argv)
+{
+    int result;
+    REMOTE_MODULE_HOST_HANDLE host;
+    if (argc != 3)
+    {
+        printf("usage: remote_module_host configFile moduleName\n");
+        printf("where configFile is the name of the file that contains the Gateway configuration\n");
+        printf("and moduleName is the \"module name\" of the remote module whose module this process hosts\n");
+        result = 1;
+    }
+    else if ((host = RemoteModuleHost_Create(argv[1], argv[2])) == NULL)
+    {
+        printf("failed to host the module of [%s] from JSON\n", argv[2]);
+        result = 1;
+    }
+    else
+    {
+        printf("hosting the module of [%s], the process runs until the gateway destroys the remote module\n", argv[2]);
+        result = (RemoteModuleHost_Run(host) == 0) ? 0 : 1;
+        RemoteModuleHost_Destroy(host);
+    }
+    return result;
+}
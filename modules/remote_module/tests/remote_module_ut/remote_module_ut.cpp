@@ -0,0 +1,700 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <cstdlib>
+#ifdef _CRTDBG_MAP_ALLOC
+#include <crtdbg.h>
+#endif
+#include <cstring>
+
+#include "testrunnerswitcher.h"
+#include "micromock.h"
+#include "micromockcharstararenullterminatedstrings.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "nn.h"
+#include "pair.h"
+#include "message.h"
+#include "module.h"
+#include "broker.h"
+
+static MICROMOCK_MUTEX_HANDLE g_testByTest;
+static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
+
+#define GBALLOC_H
+
+extern "C" int gballoc_init(void);
+extern "C" void gballoc_deinit(void);
+extern "C" void* gballoc_malloc(size_t size);
+extern "C" void* gballoc_calloc(size_t nmemb, size_t size);
+extern "C" void* gballoc_realloc(void* ptr, size_t size);
+extern "C" void gballoc_free(void* ptr);
+
+namespace BASEIMPLEMENTATION
+{
+#include "gballoc.c"
+};
+
+#include "remote_module.h"
+#include "remote_module_channel.h"
+#include "remote_module_ring.h"
+
+DEFINE_MICROMOCK_ENUM_TO_STRING(BROKER_RESULT, BROKER_RESULT_VALUES);
+
+#define FAKE_BROKER ((BROKER_HANDLE)0x42)
+#define FAKE_MESSAGE ((MESSAGE_HANDLE)0x43)
+#define FAKE_RECEIVED_MESSAGE ((MESSAGE_HANDLE)0x44)
+#define FAKE_CHANNEL 3
+#define FAKE_MESSAGE_SIZE 10
+#define TEST_URL "ipc:///tmp/remote_module_ut.ipc"
+#define TEST_SHM_URL "shm://remote_module_ut"
+/*the bounded wait of a control frame in remote_module_channel.c*/
+#define RING_CONTROL_FRAME_TIMEOUT_MS 1000
+#define FAKE_RING ((REMOTE_MODULE_RING_HANDLE)0x45)
+
+static size_t currentmalloc_call;
+static size_t whenShallmalloc_fail;
+
+static THREAD_START_FUNC thread_func_to_call;
+static void* thread_func_args;
+
+/*the frames nn_recv returns in order, it fails with nn_errno_value once they are all received*/
+static const unsigned char* nn_recv_frames[4];
+static size_t nn_recv_frame_sizes[4];
+static size_t nn_recv_frame_count;
+static size_t nn_recv_frame_index;
+static int nn_errno_value;
+
+static MESSAGE_BYTE_ARRAY_RELEASE received_buffer_release;
+static void* received_buffer_context;
+
+static const unsigned char message_frame[] = { 'M', 0xA1, 0x60, 0x00, 0x00, 0x00, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+static const unsigned char hello_frame[] = { 'H' };
+static const unsigned char invalid_frame[] = { 'Z', 0x01 };
+
+static REMOTE_MODULE_CONFIG test_config = { TEST_URL };
+static REMOTE_MODULE_CONFIG test_shm_config = { TEST_SHM_URL };
+
+static MODULE_APIS apis;
+
+TYPED_MOCK_CLASS(CRemoteModuleMocks, CGlobalMock)
+{
+public:
+    MOCK_STATIC_METHOD_1(, void*, gballoc_malloc, size_t, size)
+        void* result2;
+        currentmalloc_call++;
+        if (currentmalloc_call == whenShallmalloc_fail)
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = BASEIMPLEMENTATION::gballoc_malloc(size);
+        }
+    MOCK_METHOD_END(void*, result2);
+
+    MOCK_STATIC_METHOD_1(, void, gballoc_free, void*, ptr)
+        BASEIMPLEMENTATION::gballoc_free(ptr);
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_3(, THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg)
+        *threadHandle = (THREAD_HANDLE)malloc(3);
+        thread_func_to_call = func;
+        thread_func_args = arg;
+    MOCK_METHOD_END(THREADAPI_RESULT, THREADAPI_OK)
+
+    MOCK_STATIC_METHOD_2(, THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res)
+        free(threadHandle);
+    MOCK_METHOD_END(THREADAPI_RESULT, THREADAPI_OK)
+
+    MOCK_STATIC_METHOD_3(, BROKER_RESULT, Broker_Publish, BROKER_HANDLE, broker, MODULE_HANDLE, source, MESSAGE_HANDLE, message)
+    MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
+
+    MOCK_STATIC_METHOD_4(, int32_t, Message_ToByteArrayWithFormat, MESSAGE_HANDLE, messageHandle, MESSAGE_WIRE_FORMAT, format, unsigned char*, buffer, int32_t, size)
+    MOCK_METHOD_END(int32_t, (int32_t)FAKE_MESSAGE_SIZE)
+
+    MOCK_STATIC_METHOD_4(, MESSAGE_HANDLE, Message_CreateFromByteArrayNoCopy, const unsigned char*, source, int32_t, size, MESSAGE_BYTE_ARRAY_RELEASE, release, void*, context)
+        received_buffer_release = release;
+        received_buffer_context = context;
+    MOCK_METHOD_END(MESSAGE_HANDLE, FAKE_RECEIVED_MESSAGE)
+
+    MOCK_STATIC_METHOD_1(, void, Message_Destroy, MESSAGE_HANDLE, message)
+        if (message == FAKE_RECEIVED_MESSAGE && received_buffer_release != NULL)
+        {
+            received_buffer_release(received_buffer_context);
+            received_buffer_release = NULL;
+        }
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_2(, int, nn_socket, int, domain, int, protocol)
+    MOCK_METHOD_END(int, FAKE_CHANNEL)
+
+    MOCK_STATIC_METHOD_1(, int, nn_close, int, s)
+    MOCK_METHOD_END(int, 0)
+
+    MOCK_STATIC_METHOD_5(, int, nn_setsockopt, int, s, int, level, int, option, const void*, optval, size_t, optvallen)
+    MOCK_METHOD_END(int, 0)
+
+    MOCK_STATIC_METHOD_2(, int, nn_bind, int, s, const char*, addr)
+    MOCK_METHOD_END(int, 1)
+
+    MOCK_STATIC_METHOD_2(, void*, nn_allocmsg, size_t, size, int, type)
+    MOCK_METHOD_END(void*, malloc(size))
+
+    MOCK_STATIC_METHOD_1(, int, nn_freemsg, void*, msg)
+        free(msg);
+    MOCK_METHOD_END(int, 0)
+
+    MOCK_STATIC_METHOD_4(, int, nn_send, int, s, const void*, buf, size_t, len, int, flags)
+        int send_length;
+        if (len == NN_MSG)
+        {
+            send_length = FAKE_MESSAGE_SIZE + 1;
+            free(*(void**)buf); // send is supposed to free auto created buffer on success
+        }
+        else
+        {
+            send_length = (int)len;
+        }
+    MOCK_METHOD_END(int, send_length)
+
+    MOCK_STATIC_METHOD_4(, int, nn_recv, int, s, void*, buf, size_t, len, int, flags)
+        int rcv_length;
+        if (nn_recv_frame_index < nn_recv_frame_count)
+        {
+            size_t size = nn_recv_frame_sizes[nn_recv_frame_index];
+            (*(void**)buf) = malloc(size);
+            memcpy((*(void**)buf), nn_recv_frames[nn_recv_frame_index], size);
+            rcv_length = (int)size;
+            nn_recv_frame_index++;
+        }
+        else
+        {
+            rcv_length = -1;
+        }
+    MOCK_METHOD_END(int, rcv_length)
+
+    MOCK_STATIC_METHOD_0(, int, nn_errno)
+    MOCK_METHOD_END(int, nn_errno_value)
+
+    MOCK_STATIC_METHOD_2(, REMOTE_MODULE_RING_HANDLE, RemoteModuleRing_Create, const char*, name, size_t, capacity)
+    MOCK_METHOD_END(REMOTE_MODULE_RING_HANDLE, FAKE_RING)
+
+    MOCK_STATIC_METHOD_1(, REMOTE_MODULE_RING_HANDLE, RemoteModuleRing_Open, const char*, name)
+    MOCK_METHOD_END(REMOTE_MODULE_RING_HANDLE, FAKE_RING)
+
+    MOCK_STATIC_METHOD_1(, void, RemoteModuleRing_Destroy, REMOTE_MODULE_RING_HANDLE, ring)
+    MOCK_VOID_METHOD_END()
+
+    MOCK_STATIC_METHOD_4(, REMOTE_MODULE_CHANNEL_RESULT, RemoteModuleRing_Send, REMOTE_MODULE_RING_HANDLE, ring, REMOTE_MODULE_FRAME_TYPE, type, MESSAGE_HANDLE, message, int, timeout_ms)
+    MOCK_METHOD_END(REMOTE_MODULE_CHANNEL_RESULT, REMOTE_MODULE_CHANNEL_OK)
+
+    MOCK_STATIC_METHOD_4(, REMOTE_MODULE_CHANNEL_RESULT, RemoteModuleRing_Receive, REMOTE_MODULE_RING_HANDLE, ring, int, timeout_ms, REMOTE_MODULE_FRAME_TYPE*, type, MESSAGE_HANDLE*, message)
+    MOCK_METHOD_END(REMOTE_MODULE_CHANNEL_RESULT, REMOTE_MODULE_CHANNEL_ERROR)
+};
+
+DECLARE_GLOBAL_MOCK_METHOD_1(CRemoteModuleMocks, , void*, gballoc_malloc, size_t, size);
+DECLARE_GLOBAL_MOCK_METHOD_1(CRemoteModuleMocks, , void, gballoc_free, void*, ptr);
+DECLARE_GLOBAL_MOCK_METHOD_3(CRemoteModuleMocks, , THREADAPI_RESULT, ThreadAPI_Create, THREAD_HANDLE*, threadHandle, THREAD_START_FUNC, func, void*, arg);
+DECLARE_GLOBAL_MOCK_METHOD_2(CRemoteModuleMocks, , THREADAPI_RESULT, ThreadAPI_Join, THREAD_HANDLE, threadHandle, int*, res);
+DECLARE_GLOBAL_MOCK_METHOD_3(CRemoteModuleMocks, , BROKER_RESULT, Broker_Publish, BROKER_HANDLE, broker, MODULE_HANDLE, source, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_4(CRemoteModuleMocks, , int32_t, Message_ToByteArrayWithFormat, MESSAGE_HANDLE, messageHandle, MESSAGE_WIRE_FORMAT, format, unsigned char*, buffer, int32_t, size);
+DECLARE_GLOBAL_MOCK_METHOD_4(CRemoteModuleMocks, , MESSAGE_HANDLE, Message_CreateFromByteArrayNoCopy, const unsigned char*, source, int32_t, size, MESSAGE_BYTE_ARRAY_RELEASE, release, void*, context);
+DECLARE_GLOBAL_MOCK_METHOD_1(CRemoteModuleMocks, , void, Message_Destroy, MESSAGE_HANDLE, message);
+DECLARE_GLOBAL_MOCK_METHOD_2(CRemoteModuleMocks, , int, nn_socket, int, domain, int, protocol);
+DECLARE_GLOBAL_MOCK_METHOD_1(CRemoteModuleMocks, , int, nn_close, int, s);
+DECLARE_GLOBAL_MOCK_METHOD_5(CRemoteModuleMocks, , int, nn_setsockopt, int, s, int, level, int, option, const void*, optval, size_t, optvallen);
+DECLARE_GLOBAL_MOCK_METHOD_2(CRemoteModuleMocks, , int, nn_bind, int, s, const char*, addr);
+DECLARE_GLOBAL_MOCK_METHOD_2(CRemoteModuleMocks, , void*, nn_allocmsg, size_t, size, int, type);
+DECLARE_GLOBAL_MOCK_METHOD_1(CRemoteModuleMocks, , int, nn_freemsg, void*, msg);
+DECLARE_GLOBAL_MOCK_METHOD_4(CRemoteModuleMocks, , int, nn_send, int, s, const void*, buf, size_t, len, int, flags);
+DECLARE_GLOBAL_MOCK_METHOD_4(CRemoteModuleMocks, , int, nn_recv, int, s, void*, buf, size_t, len, int, flags);
+DECLARE_GLOBAL_MOCK_METHOD_0(CRemoteModuleMocks, , int, nn_errno);
+DECLARE_GLOBAL_MOCK_METHOD_2(CRemoteModuleMocks, , REMOTE_MODULE_RING_HANDLE, RemoteModuleRing_Create, const char*, name, size_t, capacity);
+DECLARE_GLOBAL_MOCK_METHOD_1(CRemoteModuleMocks, , REMOTE_MODULE_RING_HANDLE, RemoteModuleRing_Open, const char*, name);
+DECLARE_GLOBAL_MOCK_METHOD_1(CRemoteModuleMocks, , void, RemoteModuleRing_Destroy, REMOTE_MODULE_RING_HANDLE, ring);
+DECLARE_GLOBAL_MOCK_METHOD_4(CRemoteModuleMocks, , REMOTE_MODULE_CHANNEL_RESULT, RemoteModuleRing_Send, REMOTE_MODULE_RING_HANDLE, ring, REMOTE_MODULE_FRAME_TYPE, type, MESSAGE_HANDLE, message, int, timeout_ms);
+DECLARE_GLOBAL_MOCK_METHOD_4(CRemoteModuleMocks, , REMOTE_MODULE_CHANNEL_RESULT, RemoteModuleRing_Receive, REMOTE_MODULE_RING_HANDLE, ring, int, timeout_ms, REMOTE_MODULE_FRAME_TYPE*, type, MESSAGE_HANDLE*, message);
+
+static void add_recv_frame(const unsigned char* frame, size_t size)
+{
+    nn_recv_frames[nn_recv_frame_count] = frame;
+    nn_recv_frame_sizes[nn_recv_frame_count] = size;
+    nn_recv_frame_count++;
+}
+
+BEGIN_TEST_SUITE(remote_module_ut)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+        g_testByTest = MicroMockCreateMutex();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+        Module_GetAPIS(&apis);
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+        MicroMockDestroyMutex(g_testByTest);
+        TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        if (!MicroMockAcquireMutex(g_testByTest))
+        {
+            ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+        }
+
+        currentmalloc_call = 0;
+        whenShallmalloc_fail = 0;
+        thread_func_to_call = NULL;
+        thread_func_args = NULL;
+        nn_recv_frame_count = 0;
+        nn_recv_frame_index = 0;
+        nn_errno_value = EBADF;
+        received_buffer_release = NULL;
+        received_buffer_context = NULL;
+    }
+
+    TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+    {
+        if (!MicroMockReleaseMutex(g_testByTest))
+        {
+            ASSERT_FAIL("failure in test framework at ReleaseMutex");
+        }
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_13_008: [ Module_GetAPIS shall fill the provided MODULE_APIS with the function pointers of the remote module. ]*/
+    TEST_FUNCTION(Module_GetAPIS_returns_non_NULL_fields)
+    {
+        ///arrange
+        MODULE_APIS result = { 0 };
+
+        ///act
+        Module_GetAPIS(&result);
+
+        ///assert
+        ASSERT_IS_NOT_NULL((void*)result.Module_Create);
+        ASSERT_IS_NOT_NULL((void*)result.Module_Destroy);
+        ASSERT_IS_NOT_NULL((void*)result.Module_Receive);
+        ASSERT_IS_NOT_NULL((void*)result.Module_Start);
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_13_001: [ If broker, configuration or the url of configuration is NULL, RemoteModule_Create shall fail and return NULL. ]*/
+    TEST_FUNCTION(RemoteModule_Create_with_NULL_broker_fails)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+
+        ///act
+        auto result = apis.Module_Create(NULL, &test_config);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        mocks.AssertActualAndExpectedCalls();
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_13_001: [ If broker, configuration or the url of configuration is NULL, RemoteModule_Create shall fail and return NULL. ]*/
+    TEST_FUNCTION(RemoteModule_Create_with_NULL_url_fails)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+        REMOTE_MODULE_CONFIG config = { NULL };
+
+        ///act
+        auto result = apis.Module_Create(FAKE_BROKER, &config);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        mocks.AssertActualAndExpectedCalls();
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_13_002: [ RemoteModule_Create shall create the channel to the host by calling RemoteModuleChannel_Bind with the url of configuration and a receive timeout, so that the receiving thread notices when the module is destroyed. ]*/
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_013: [ Otherwise RemoteModuleChannel_Bind shall create a nanomsg NN_PAIR socket, set its NN_RCVTIMEO to receive_timeout_ms and bind it to url, and RemoteModuleChannel_Connect shall create a nanomsg NN_PAIR socket and connect it to url. ]*/
+    /*Tests_SRS_REMOTE_MODULE_13_005: [ RemoteModule_Create shall start a thread that receives the frames of the host. ]*/
+    /*Tests_SRS_REMOTE_MODULE_13_007: [ RemoteModule_Create shall return a non-NULL MODULE_HANDLE on success. ]*/
+    TEST_FUNCTION(RemoteModule_Create_succeeds)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PAIR));
+        STRICT_EXPECTED_CALL(mocks, nn_setsockopt(FAKE_CHANNEL, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, sizeof(int)))
+            .IgnoreArgument(4);
+        STRICT_EXPECTED_CALL(mocks, nn_bind(FAKE_CHANNEL, TEST_URL));
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        ///act
+        auto result = apis.Module_Create(FAKE_BROKER, &test_config);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(void_ptr, result, thread_func_args);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        apis.Module_Destroy(result);
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_13_006: [ If any underlying call fails, RemoteModule_Create shall release the resources it acquired and return NULL. ]*/
+    TEST_FUNCTION(RemoteModule_Create_fails_when_nn_bind_fails)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PAIR));
+        STRICT_EXPECTED_CALL(mocks, nn_setsockopt(FAKE_CHANNEL, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, sizeof(int)))
+            .IgnoreArgument(4);
+        STRICT_EXPECTED_CALL(mocks, nn_bind(FAKE_CHANNEL, TEST_URL))
+            .SetReturn(-1);
+        STRICT_EXPECTED_CALL(mocks, nn_close(FAKE_CHANNEL));
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        auto result = apis.Module_Create(FAKE_BROKER, &test_config);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        mocks.AssertActualAndExpectedCalls();
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_13_006: [ If any underlying call fails, RemoteModule_Create shall release the resources it acquired and return NULL. ]*/
+    TEST_FUNCTION(RemoteModule_Create_fails_when_ThreadAPI_Create_fails)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, nn_socket(AF_SP, NN_PAIR));
+        STRICT_EXPECTED_CALL(mocks, nn_setsockopt(FAKE_CHANNEL, NN_SOL_SOCKET, NN_RCVTIMEO, IGNORED_PTR_ARG, sizeof(int)))
+            .IgnoreArgument(4);
+        STRICT_EXPECTED_CALL(mocks, nn_bind(FAKE_CHANNEL, TEST_URL));
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments()
+            .SetFailReturn(THREADAPI_ERROR);
+        STRICT_EXPECTED_CALL(mocks, nn_close(FAKE_CHANNEL));
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        auto result = apis.Module_Create(FAKE_BROKER, &test_config);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        mocks.AssertActualAndExpectedCalls();
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_012: [ If url starts with "shm://", RemoteModuleChannel_Bind shall create the shared memory ring named by the rest of url with a capacity of REMOTE_MODULE_RING_CAPACITY, and RemoteModuleChannel_Connect shall open it. ]*/
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_016: [ The frames of a ring channel shall be sent with RemoteModuleRing_Send, waiting for room as long as it takes if wait is non-zero, and received with RemoteModuleRing_Receive and the receive timeout of the channel. ]*/
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_017: [ If wait is 0, RemoteModuleChannel_SendControl shall still wait up to RING_CONTROL_FRAME_TIMEOUT_MS for room in a full ring, and RemoteModuleChannel_SendMessage shall not wait. ]*/
+    TEST_FUNCTION(RemoteModule_with_a_shm_url_talks_over_a_ring)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, RemoteModuleRing_Create("remote_module_ut", REMOTE_MODULE_RING_CAPACITY));
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mocks, RemoteModuleRing_Send(FAKE_RING, REMOTE_MODULE_FRAME_MESSAGE, FAKE_MESSAGE, 0));
+
+        ///act
+        auto module = apis.Module_Create(FAKE_BROKER, &test_shm_config);
+        apis.Module_Receive(module, FAKE_MESSAGE);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(module);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        apis.Module_Destroy(module);
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_015: [ RemoteModuleChannel_Close shall destroy the ring or close the socket of channel and free it, and do nothing if channel is NULL. ]*/
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_017: [ If wait is 0, RemoteModuleChannel_SendControl shall still wait up to RING_CONTROL_FRAME_TIMEOUT_MS for room in a full ring, and RemoteModuleChannel_SendMessage shall not wait. ]*/
+    TEST_FUNCTION(RemoteModule_Destroy_with_a_shm_url_destroys_the_ring)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+        auto module = apis.Module_Create(FAKE_BROKER, &test_shm_config);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, RemoteModuleRing_Send(FAKE_RING, REMOTE_MODULE_FRAME_DESTROY, NULL, RING_CONTROL_FRAME_TIMEOUT_MS));
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mocks, RemoteModuleRing_Destroy(FAKE_RING));
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(module));
+
+        ///act
+        apis.Module_Destroy(module);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_13_013: [ RemoteModule_Receive shall send the message to the host in a REMOTE_MODULE_FRAME_MESSAGE frame without waiting, and drop it if the host is not connected or does not keep up. ]*/
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_003: [ RemoteModuleChannel_SendMessage shall allocate a nanomsg buffer of the size of the message serialized with MESSAGE_WIRE_FORMAT_V2 plus one byte, and shall serialize the message after the REMOTE_MODULE_FRAME_MESSAGE byte. ]*/
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_004: [ RemoteModuleChannel_SendMessage shall send the buffer with nn_send and NN_MSG, so that nanomsg frees it. ]*/
+    TEST_FUNCTION(RemoteModule_Receive_sends_a_message_frame)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+        auto module = apis.Module_Create(FAKE_BROKER, &test_config);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(FAKE_MESSAGE, MESSAGE_WIRE_FORMAT_V2, NULL, 0));
+        STRICT_EXPECTED_CALL(mocks, nn_allocmsg(FAKE_MESSAGE_SIZE + 1, 0));
+        STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(FAKE_MESSAGE, MESSAGE_WIRE_FORMAT_V2, IGNORED_PTR_ARG, FAKE_MESSAGE_SIZE))
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, nn_send(FAKE_CHANNEL, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+            .IgnoreArgument(2);
+
+        ///act
+        apis.Module_Receive(module, FAKE_MESSAGE);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        apis.Module_Destroy(module);
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_13_013: [ RemoteModule_Receive shall send the message to the host in a REMOTE_MODULE_FRAME_MESSAGE frame without waiting, and drop it if the host is not connected or does not keep up. ]*/
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_002: [ If nn_send fails, the functions shall return REMOTE_MODULE_CHANNEL_TIMEOUT when the error is EAGAIN or ETIMEDOUT and REMOTE_MODULE_CHANNEL_ERROR otherwise. ]*/
+    TEST_FUNCTION(RemoteModule_Receive_drops_the_message_when_the_host_does_not_keep_up)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+        auto module = apis.Module_Create(FAKE_BROKER, &test_config);
+        mocks.ResetAllCalls();
+        nn_errno_value = EAGAIN;
+
+        STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(FAKE_MESSAGE, MESSAGE_WIRE_FORMAT_V2, NULL, 0));
+        STRICT_EXPECTED_CALL(mocks, nn_allocmsg(FAKE_MESSAGE_SIZE + 1, 0));
+        STRICT_EXPECTED_CALL(mocks, Message_ToByteArrayWithFormat(FAKE_MESSAGE, MESSAGE_WIRE_FORMAT_V2, IGNORED_PTR_ARG, FAKE_MESSAGE_SIZE))
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, nn_send(FAKE_CHANNEL, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+            .IgnoreArgument(2)
+            .SetReturn(-1);
+        STRICT_EXPECTED_CALL(mocks, nn_errno());
+        STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        apis.Module_Receive(module, FAKE_MESSAGE);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        apis.Module_Destroy(module);
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_13_015: [ RemoteModule_Start shall mark the module started and send a REMOTE_MODULE_FRAME_START frame to the host with wait 0; a host that is not connected yet is started when it says hello. ]*/
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_001: [ RemoteModuleChannel_SendControl shall send a frame of the one byte type by calling nn_send, with NN_DONTWAIT unless wait is non-zero. ]*/
+    TEST_FUNCTION(RemoteModule_Start_sends_a_start_frame)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+        auto module = apis.Module_Create(FAKE_BROKER, &test_config);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, nn_send(FAKE_CHANNEL, IGNORED_PTR_ARG, 1, NN_DONTWAIT))
+            .IgnoreArgument(2);
+
+        ///act
+        apis.Module_Start(module);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        apis.Module_Destroy(module);
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_13_017: [ RemoteModule_Destroy shall send a REMOTE_MODULE_FRAME_DESTROY frame to the host with wait 0, so that the host destroys its module and exits. ]*/
+    /*Tests_SRS_REMOTE_MODULE_13_018: [ RemoteModule_Destroy shall stop and join the receiving thread, close the channel by calling RemoteModuleChannel_Close and free the module. ]*/
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_015: [ RemoteModuleChannel_Close shall destroy the ring or close the socket of channel and free it, and do nothing if channel is NULL. ]*/
+    TEST_FUNCTION(RemoteModule_Destroy_tells_the_host_to_exit_and_frees_the_module)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+        auto module = apis.Module_Create(FAKE_BROKER, &test_config);
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, nn_send(FAKE_CHANNEL, IGNORED_PTR_ARG, 1, NN_DONTWAIT))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mocks, nn_close(FAKE_CHANNEL));
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(module));
+
+        ///act
+        apis.Module_Destroy(module);
+
+        ///assert
+        mocks.AssertActualAndExpectedCalls();
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_13_009: [ The receiving thread shall receive frames from the channel until the module is destroyed or the channel fails. ]*/
+    /*Tests_SRS_REMOTE_MODULE_13_010: [ The receiving thread shall publish the message of a REMOTE_MODULE_FRAME_MESSAGE frame with the module as its source, and shall then destroy it. ]*/
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_006: [ RemoteModuleChannel_Receive shall receive a frame by calling nn_recv with NN_MSG. ]*/
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_008: [ RemoteModuleChannel_Receive shall deserialize the message of a REMOTE_MODULE_FRAME_MESSAGE frame by calling Message_CreateFromByteArrayNoCopy, so that the message frees the frame with nn_freemsg when it is destroyed. ]*/
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_007: [ If nn_recv fails, RemoteModuleChannel_Receive shall return REMOTE_MODULE_CHANNEL_TIMEOUT when the error is EAGAIN or ETIMEDOUT and REMOTE_MODULE_CHANNEL_ERROR otherwise. ]*/
+    TEST_FUNCTION(RemoteModule_receiver_publishes_the_messages_of_the_host)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+        auto module = apis.Module_Create(FAKE_BROKER, &test_config);
+        add_recv_frame(message_frame, sizeof(message_frame));
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, nn_recv(FAKE_CHANNEL, IGNORED_PTR_ARG, NN_MSG, 0))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArrayNoCopy(IGNORED_PTR_ARG, sizeof(message_frame) - 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3)
+            .IgnoreArgument(4);
+        STRICT_EXPECTED_CALL(mocks, Broker_Publish(FAKE_BROKER, module, FAKE_RECEIVED_MESSAGE));
+        STRICT_EXPECTED_CALL(mocks, Message_Destroy(FAKE_RECEIVED_MESSAGE));
+        STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, nn_recv(FAKE_CHANNEL, IGNORED_PTR_ARG, NN_MSG, 0))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, nn_errno());
+
+        ///act
+        auto result = thread_func_to_call(thread_func_args);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        apis.Module_Destroy(module);
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_13_011: [ When the host says hello, the receiving thread shall send it a REMOTE_MODULE_FRAME_START frame if the module is started. ]*/
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_009: [ RemoteModuleChannel_Receive shall free a control frame and return REMOTE_MODULE_CHANNEL_OK. ]*/
+    TEST_FUNCTION(RemoteModule_receiver_starts_a_host_that_connects_late)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+        auto module = apis.Module_Create(FAKE_BROKER, &test_config);
+        apis.Module_Start(module);
+        add_recv_frame(hello_frame, sizeof(hello_frame));
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, nn_recv(FAKE_CHANNEL, IGNORED_PTR_ARG, NN_MSG, 0))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, nn_send(FAKE_CHANNEL, IGNORED_PTR_ARG, 1, NN_DONTWAIT))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, nn_recv(FAKE_CHANNEL, IGNORED_PTR_ARG, NN_MSG, 0))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, nn_errno());
+
+        ///act
+        auto result = thread_func_to_call(thread_func_args);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        apis.Module_Destroy(module);
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_13_011: [ When the host says hello, the receiving thread shall send it a REMOTE_MODULE_FRAME_START frame if the module is started. ]*/
+    TEST_FUNCTION(RemoteModule_receiver_does_not_start_the_host_before_the_module_starts)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+        auto module = apis.Module_Create(FAKE_BROKER, &test_config);
+        add_recv_frame(hello_frame, sizeof(hello_frame));
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, nn_recv(FAKE_CHANNEL, IGNORED_PTR_ARG, NN_MSG, 0))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, nn_recv(FAKE_CHANNEL, IGNORED_PTR_ARG, NN_MSG, 0))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, nn_errno());
+
+        ///act
+        auto result = thread_func_to_call(thread_func_args);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        apis.Module_Destroy(module);
+    }
+
+    /*Tests_SRS_REMOTE_MODULE_CHANNEL_13_010: [ If the frame is empty, has an unknown type, is a message frame that cannot be deserialized or is a control frame with a payload, RemoteModuleChannel_Receive shall free it and return REMOTE_MODULE_CHANNEL_INVALID_FRAME. ]*/
+    TEST_FUNCTION(RemoteModule_receiver_drops_invalid_frames_and_keeps_receiving)
+    {
+        ///arrange
+        CRemoteModuleMocks mocks;
+        auto module = apis.Module_Create(FAKE_BROKER, &test_config);
+        add_recv_frame(invalid_frame, sizeof(invalid_frame));
+        add_recv_frame(message_frame, sizeof(message_frame));
+        mocks.ResetAllCalls();
+
+        STRICT_EXPECTED_CALL(mocks, nn_recv(FAKE_CHANNEL, IGNORED_PTR_ARG, NN_MSG, 0))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, nn_recv(FAKE_CHANNEL, IGNORED_PTR_ARG, NN_MSG, 0))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArrayNoCopy(IGNORED_PTR_ARG, sizeof(message_frame) - 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3)
+            .IgnoreArgument(4);
+        STRICT_EXPECTED_CALL(mocks, Broker_Publish(FAKE_BROKER, module, FAKE_RECEIVED_MESSAGE));
+        STRICT_EXPECTED_CALL(mocks, Message_Destroy(FAKE_RECEIVED_MESSAGE));
+        STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, nn_recv(FAKE_CHANNEL, IGNORED_PTR_ARG, NN_MSG, 0))
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(mocks, nn_errno());
+
+        ///act
+        auto result = thread_func_to_call(thread_func_args);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        mocks.AssertActualAndExpectedCalls();
+
+        ///cleanup
+        apis.Module_Destroy(module);
+    }
+
+END_TEST_SUITE(remote_module_ut)
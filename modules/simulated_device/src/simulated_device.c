@@ -58,6 +58,10 @@ static int simulated_device_worker(void * user_data)
 
 	if (user_data != NULL)
 	{
+		if (Broker_ApplyModuleThreadOptions(module_data->broker, (MODULE_HANDLE)module_data) != BROKER_OK)
+		{
+			LogError("Failed to apply the thread options of the module");
+		}
 
 		while (module_data->simulatedDeviceRunning)
 		{
@@ -100,9 +104,15 @@ static int simulated_device_worker(void * user_data)
 						}
 						else
 						{
-							if (Broker_Publish(module_data->broker, (MODULE_HANDLE)module_data, newMessage) != BROKER_OK)
+							BROKER_RESULT publish_result = Broker_Publish(module_data->broker, (MODULE_HANDLE)module_data, newMessage);
+							if (publish_result == BROKER_BUSY)
+							{
+								/*a downstream queue is full, shed this reading*/
+								LogInfo("Broker is busy, dropping reading");
+							}
+							else if (publish_result != BROKER_OK)
 							{
-								LogError("Failed to create new message");
+								LogError("Failed to publish new message");
 							}
 
 							additionalTemp += 1.0;